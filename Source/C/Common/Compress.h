@@ -60,6 +60,140 @@ EfiCompress (
   )
 ;
 
+//
+// Opaque encoder state for the context based compression interfaces. A
+// context owns its working buffers, so several contexts can be used from
+// different threads at the same time. A single context is not thread safe.
+//
+typedef struct _EFI_COMPRESS_CONTEXT    EFI_COMPRESS_CONTEXT;
+typedef struct _TIANO_COMPRESS_CONTEXT  TIANO_COMPRESS_CONTEXT;
+
+//
+// Compression levels accepted by [Efi/Tiano]CompressSetLevel(). The
+// default level is the original encoder; lower levels trade ratio for speed.
+//
+#define COMPRESS_LEVEL_MIN      1
+#define COMPRESS_LEVEL_MAX      9
+#define COMPRESS_LEVEL_DEFAULT  COMPRESS_LEVEL_MAX
+
+/*++
+
+Routine Description:
+
+  Create a Tiano compression context.
+
+--*/
+EFI_STATUS
+TianoCompressCreateContext (
+  OUT TIANO_COMPRESS_CONTEXT  **Context
+  )
+;
+
+/*++
+
+Routine Description:
+
+  Tiano compression routine using the state held in Context. At the default
+  level the output is exactly the same as TianoCompress().
+
+--*/
+EFI_STATUS
+TianoCompressWithContext (
+  IN      TIANO_COMPRESS_CONTEXT  *Context,
+  IN      UINT8                   *SrcBuffer,
+  IN      UINT32                  SrcSize,
+  IN      UINT8                   *DstBuffer,
+  IN OUT  UINT32                  *DstSize
+  )
+;
+
+/*++
+
+Routine Description:
+
+  Select the compression level, COMPRESS_LEVEL_MIN to COMPRESS_LEVEL_MAX,
+  used by later TianoCompressWithContext() calls on this context.
+
+--*/
+EFI_STATUS
+TianoCompressSetLevel (
+  IN TIANO_COMPRESS_CONTEXT  *Context,
+  IN UINT32                 Level
+  )
+;
+
+/*++
+
+Routine Description:
+
+  Free a context created by TianoCompressCreateContext().
+
+--*/
+VOID
+TianoCompressDestroyContext (
+  IN TIANO_COMPRESS_CONTEXT  *Context
+  )
+;
+
+/*++
+
+Routine Description:
+
+  Create an Efi compression context.
+
+--*/
+EFI_STATUS
+EfiCompressCreateContext (
+  OUT EFI_COMPRESS_CONTEXT  **Context
+  )
+;
+
+/*++
+
+Routine Description:
+
+  Efi compression routine using the state held in Context. At the default
+  level the output is exactly the same as EfiCompress().
+
+--*/
+EFI_STATUS
+EfiCompressWithContext (
+  IN      EFI_COMPRESS_CONTEXT  *Context,
+  IN      UINT8                 *SrcBuffer,
+  IN      UINT32                SrcSize,
+  IN      UINT8                 *DstBuffer,
+  IN OUT  UINT32                *DstSize
+  )
+;
+
+/*++
+
+Routine Description:
+
+  Select the compression level, COMPRESS_LEVEL_MIN to COMPRESS_LEVEL_MAX,
+  used by later EfiCompressWithContext() calls on this context.
+
+--*/
+EFI_STATUS
+EfiCompressSetLevel (
+  IN EFI_COMPRESS_CONTEXT  *Context,
+  IN UINT32               Level
+  )
+;
+
+/*++
+
+Routine Description:
+
+  Free a context created by EfiCompressCreateContext().
+
+--*/
+VOID
+EfiCompressDestroyContext (
+  IN EFI_COMPRESS_CONTEXT  *Context
+  )
+;
+
 /*++
 
 Routine Description:
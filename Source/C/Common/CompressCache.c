@@ -0,0 +1,851 @@
+/** @file
+
+Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+Module Name:
+
+  CompressCache.c
+
+Abstract:
+
+  Content addressed on-disk cache of compression results.
+
+  Every entry is a file named by the hexadecimal key digest. It holds a
+  COMPRESS_CACHE_ENTRY_HEADER followed by the compressed data. The file
+  modification time records the last use and drives LRU eviction.
+
+**/
+
+#include "WinNtInclude.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __GNUC__
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <utime.h>
+#else
+#include <windows.h>
+#include <io.h>
+#include <direct.h>
+#include <process.h>
+#include <sys/utime.h>
+#endif
+
+#include "CommonLib.h"
+#include "Sha256.h"
+#include "CompressCache.h"
+
+#ifndef __GNUC__
+#define getpid  _getpid
+#define utime   _utime
+#endif
+
+//
+// Temporary file numbers are taken by every thread storing an entry
+//
+#ifdef __GNUC__
+#define NEXT_TEMP_NUMBER()  __sync_fetch_and_add (&mCacheTempCount, 1)
+#else
+#define NEXT_TEMP_NUMBER()  InterlockedIncrement ((volatile LONG *) &mCacheTempCount)
+#endif
+
+//
+// The lock protects the running size of the cache
+//
+#ifndef __GNUC__
+#define CACHE_LOCK()    EnterCriticalSection (&mCacheLock)
+#define CACHE_UNLOCK()  LeaveCriticalSection (&mCacheLock)
+#else
+#define CACHE_LOCK()    pthread_mutex_lock (&mCacheLock)
+#define CACHE_UNLOCK()  pthread_mutex_unlock (&mCacheLock)
+#endif
+
+#define COMPRESS_CACHE_SIGNATURE    0x31454343    // "CCE1"
+#define COMPRESS_CACHE_KEY_PREFIX   "EdkCompressCache1"
+#define COMPRESS_CACHE_NAME_LENGTH  (SHA256_DIGEST_SIZE * 2)
+
+//
+// Eviction removes entries until the cache is back under this share of the
+// limit, so that a full cache is not trimmed again by every store.
+//
+#define COMPRESS_CACHE_LOW_WATER(Limit)   ((Limit) / 10 * 9)
+
+//
+// Temporary files left behind by killed processes are removed after an hour
+//
+#define COMPRESS_CACHE_STALE_TEMP_AGE     (60 * 60)
+
+typedef struct {
+  UINT32  Signature;
+  UINT32  Reserved;
+  UINT64  InputSize;
+  UINT64  OutputSize;
+  UINT8   Digest[SHA256_DIGEST_SIZE];
+} COMPRESS_CACHE_ENTRY_HEADER;
+
+typedef struct {
+  CHAR8   Name[COMPRESS_CACHE_NAME_LENGTH + 1];
+  UINT64  Size;
+  time_t  Time;
+} COMPRESS_CACHE_FILE;
+
+typedef struct {
+  COMPRESS_CACHE_FILE *Files;
+  UINTN               Count;
+  UINTN               Capacity;
+  UINT64              TotalSize;
+} COMPRESS_CACHE_FILE_LIST;
+
+#ifndef __GNUC__
+STATIC INIT_ONCE        mCacheOnce = INIT_ONCE_STATIC_INIT;
+STATIC CRITICAL_SECTION mCacheLock;
+#else
+STATIC pthread_once_t   mCacheOnce = PTHREAD_ONCE_INIT;
+STATIC pthread_mutex_t  mCacheLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+STATIC CHAR8    *mCacheDir        = NULL;
+STATIC UINT64   mCacheLimit       = COMPRESS_CACHE_DEFAULT_SIZE;
+STATIC volatile UINT32 mCacheTempCount = 0;
+
+//
+// Bytes in the cache as seen by this process: the size left by the last
+// trim plus every entry stored since. Stores of other processes sharing the
+// directory are only seen by the next trim.
+//
+STATIC UINT64   mCacheSize        = 0;
+STATIC BOOLEAN  mCacheSizeKnown   = FALSE;
+STATIC BOOLEAN  mCacheTrimming    = FALSE;
+
+STATIC
+BOOLEAN
+ParseCacheSize (
+  IN  CONST CHAR8   *String,
+  OUT UINT64        *Size
+  )
+/*++
+
+Routine Description:
+
+  Parse a decimal byte count with an optional K, M or G suffix.
+
+Arguments:
+
+  String      - The string to parse
+  Size        - The parsed size
+
+Returns:
+
+  TRUE if String is a valid size, FALSE otherwise.
+
+--*/
+{
+  UINT64  Value;
+
+  if (*String < '0' || *String > '9') {
+    return FALSE;
+  }
+  for (Value = 0; *String >= '0' && *String <= '9'; String++) {
+    Value = Value * 10 + (*String - '0');
+  }
+  switch (*String) {
+  case 'G': case 'g':
+    Value <<= 10;
+  case 'M': case 'm':
+    Value <<= 10;
+  case 'K': case 'k':
+    Value <<= 10;
+    String++;
+    break;
+  default:
+    break;
+  }
+  if (*String != '\0') {
+    return FALSE;
+  }
+  *Size = Value;
+  return TRUE;
+}
+
+STATIC
+VOID
+CompressCacheInitialize (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Read the cache configuration from the environment and create the cache
+  directory if needed. Runs exactly once, before any thread uses mCacheDir.
+
+Arguments:
+
+  None
+
+Returns:
+
+  None
+
+--*/
+{
+  CONST CHAR8 *Dir;
+  CONST CHAR8 *Size;
+  UINTN       Length;
+  struct stat StatBuf;
+
+  Dir = getenv (COMPRESS_CACHE_DIR_VARIABLE);
+  if (Dir == NULL || *Dir == '\0') {
+    return;
+  }
+
+  Size = getenv (COMPRESS_CACHE_SIZE_VARIABLE);
+  if (Size != NULL && *Size != '\0' && !ParseCacheSize (Size, &mCacheLimit)) {
+    return;
+  }
+  if (mCacheLimit == 0) {
+    return;
+  }
+
+  Length = strlen (Dir);
+  while (Length > 1 && (Dir[Length - 1] == '/' || Dir[Length - 1] == '\\')) {
+    Length--;
+  }
+  mCacheDir = malloc (Length + 1);
+  if (mCacheDir == NULL) {
+    return;
+  }
+  memcpy (mCacheDir, Dir, Length);
+  mCacheDir[Length] = '\0';
+
+  if (stat (mCacheDir, &StatBuf) != 0) {
+#ifdef __GNUC__
+    mkdir (mCacheDir, 0777);
+#else
+    _mkdir (mCacheDir);
+#endif
+  }
+}
+
+#ifndef __GNUC__
+STATIC
+BOOL
+CALLBACK
+CompressCacheInitOnce (
+  IN OUT PINIT_ONCE  InitOnce,
+  IN     PVOID       Parameter,
+  OUT    PVOID       *Context
+  )
+{
+  InitializeCriticalSection (&mCacheLock);
+  CompressCacheInitialize ();
+  return TRUE;
+}
+#endif
+
+STATIC
+VOID
+CompressCacheDigest (
+  IN  CONST CHAR8   *Codec,
+  IN  CONST CHAR8   *Params,
+  IN  CONST VOID    *Input,
+  IN  UINTN         InputSize,
+  OUT UINT8         *Digest
+  )
+/*++
+
+Routine Description:
+
+  Compute the key of a cache entry.
+
+Arguments:
+
+  Codec       - Name of the compression format
+  Params      - Encoder parameters
+  Input       - The uncompressed data
+  InputSize   - The size of Input
+  Digest      - Receives the SHA256_DIGEST_SIZE byte key
+
+Returns:
+
+  None
+
+--*/
+{
+  SHA256_CONTEXT  Context;
+  UINT8           Length[8];
+  UINTN           Index;
+
+  //
+  // The strings are hashed with their terminators so that the boundaries
+  // between the key fields are unambiguous.
+  //
+  for (Index = 0; Index < sizeof (Length); Index++) {
+    Length[Index] = (UINT8) ((UINT64) InputSize >> (Index * 8));
+  }
+  Sha256Init (&Context);
+  Sha256Update (&Context, COMPRESS_CACHE_KEY_PREFIX, sizeof (COMPRESS_CACHE_KEY_PREFIX));
+  Sha256Update (&Context, Codec, strlen (Codec) + 1);
+  Sha256Update (&Context, Params, strlen (Params) + 1);
+  Sha256Update (&Context, Length, sizeof (Length));
+  Sha256Update (&Context, Input, InputSize);
+  Sha256Final (&Context, Digest);
+}
+
+STATIC
+CHAR8 *
+CompressCacheEntryPath (
+  IN  CONST UINT8   *Digest,
+  IN  BOOLEAN       Temporary
+  )
+/*++
+
+Routine Description:
+
+  Build the path of an entry file, or of a temporary file that is renamed
+  to the entry file once it is complete.
+
+Arguments:
+
+  Digest      - The key of the entry
+  Temporary   - TRUE for a name unique to this process and call, also
+                when several threads store entries at once
+
+Returns:
+
+  The path, which the caller releases with free(), or NULL if out of memory.
+
+--*/
+{
+  CHAR8   *Path;
+  CHAR8   *Ptr;
+  UINTN   Index;
+
+  Path = malloc (strlen (mCacheDir) + COMPRESS_CACHE_NAME_LENGTH + 40);
+  if (Path == NULL) {
+    return NULL;
+  }
+  Ptr = Path + sprintf (Path, "%s/", mCacheDir);
+  for (Index = 0; Index < SHA256_DIGEST_SIZE; Index++) {
+    Ptr += sprintf (Ptr, "%02x", Digest[Index]);
+  }
+  if (Temporary) {
+    sprintf (Ptr, ".%u.%u.tmp", (unsigned) getpid (), (unsigned) NEXT_TEMP_NUMBER ());
+  }
+  return Path;
+}
+
+STATIC
+EFI_STATUS
+CompressCacheReadEntry (
+  IN  CONST UINT8   *Digest,
+  IN  UINTN         InputSize,
+  OUT VOID          **Output,
+  OUT UINTN         *OutputSize
+  )
+/*++
+
+Routine Description:
+
+  Read and verify the entry for Digest and mark it as recently used.
+
+Arguments:
+
+  Digest      - The key of the entry
+  InputSize   - The size of the uncompressed data
+  Output      - Receives the compressed data, released with free()
+  OutputSize  - Receives the size of Output
+
+Returns:
+
+  EFI_SUCCESS               - The entry was read.
+  EFI_NOT_FOUND             - The entry does not exist or is not valid.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+{
+  COMPRESS_CACHE_ENTRY_HEADER Header;
+  CHAR8                       *Path;
+  FILE                        *File;
+  UINT8                       *Buffer;
+  EFI_STATUS                  Status;
+
+  Path = CompressCacheEntryPath (Digest, FALSE);
+  if (Path == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Buffer = NULL;
+  Status = EFI_NOT_FOUND;
+  File   = fopen (Path, "rb");
+  if (File == NULL) {
+    free (Path);
+    return EFI_NOT_FOUND;
+  }
+
+  if (fread (&Header, sizeof (Header), 1, File) != 1 ||
+      Header.Signature != COMPRESS_CACHE_SIGNATURE ||
+      Header.InputSize != (UINT64) InputSize ||
+      Header.OutputSize != (UINTN) Header.OutputSize ||
+      memcmp (Header.Digest, Digest, SHA256_DIGEST_SIZE) != 0) {
+    goto Done;
+  }
+
+  Buffer = malloc ((UINTN) Header.OutputSize + 1);
+  if (Buffer == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  //
+  // A complete entry ends exactly after the compressed data
+  //
+  if (fread (Buffer, 1, (UINTN) Header.OutputSize, File) != (UINTN) Header.OutputSize ||
+      fgetc (File) != EOF) {
+    goto Done;
+  }
+
+  *Output     = Buffer;
+  *OutputSize = (UINTN) Header.OutputSize;
+  Buffer      = NULL;
+  Status      = EFI_SUCCESS;
+
+Done:
+  fclose (File);
+  if (Status == EFI_SUCCESS) {
+    utime (Path, NULL);
+  }
+  free (Buffer);
+  free (Path);
+  return Status;
+}
+
+STATIC
+VOID
+CompressCacheAddFile (
+  IN OUT COMPRESS_CACHE_FILE_LIST *List,
+  IN     CONST CHAR8              *Name,
+  IN     UINT64                   Size,
+  IN     time_t                   Time
+  )
+/*++
+
+Routine Description:
+
+  Account for one directory entry while trimming the cache. Entry files
+  are collected for eviction and stale temporary files are removed.
+
+Arguments:
+
+  List        - The entry files found so far
+  Name        - The file name, without the directory
+  Size        - The file size
+  Time        - The file modification time
+
+Returns:
+
+  None
+
+--*/
+{
+  COMPRESS_CACHE_FILE *Files;
+  CHAR8               *Path;
+  UINTN               Index;
+  UINTN               Length;
+
+  Length = strlen (Name);
+  if (Length > 4 && strcmp (Name + Length - 4, ".tmp") == 0) {
+    if (difftime (time (NULL), Time) > COMPRESS_CACHE_STALE_TEMP_AGE) {
+      Path = malloc (strlen (mCacheDir) + Length + 2);
+      if (Path != NULL) {
+        sprintf (Path, "%s/%s", mCacheDir, Name);
+        remove (Path);
+        free (Path);
+      }
+    }
+    return;
+  }
+
+  if (Length != COMPRESS_CACHE_NAME_LENGTH) {
+    return;
+  }
+  for (Index = 0; Index < Length; Index++) {
+    if (!((Name[Index] >= '0' && Name[Index] <= '9') || (Name[Index] >= 'a' && Name[Index] <= 'f'))) {
+      return;
+    }
+  }
+
+  if (List->Count == List->Capacity) {
+    List->Capacity = List->Capacity == 0 ? 256 : List->Capacity * 2;
+    Files = realloc (List->Files, List->Capacity * sizeof (COMPRESS_CACHE_FILE));
+    if (Files == NULL) {
+      List->Capacity = List->Count;
+      return;
+    }
+    List->Files = Files;
+  }
+  strcpy (List->Files[List->Count].Name, Name);
+  List->Files[List->Count].Size = Size;
+  List->Files[List->Count].Time = Time;
+  List->Count++;
+  List->TotalSize += Size;
+}
+
+STATIC
+int
+CompareCacheFiles (
+  IN CONST VOID *Left,
+  IN CONST VOID *Right
+  )
+{
+  CONST COMPRESS_CACHE_FILE *A;
+  CONST COMPRESS_CACHE_FILE *B;
+
+  A = (CONST COMPRESS_CACHE_FILE *) Left;
+  B = (CONST COMPRESS_CACHE_FILE *) Right;
+  if (A->Time != B->Time) {
+    return A->Time < B->Time ? -1 : 1;
+  }
+  return strcmp (A->Name, B->Name);
+}
+
+STATIC
+UINT64
+CompressCacheTrim (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Remove the least recently used entries while the cache is larger than
+  its limit. Entries removed by a concurrent trim are simply skipped.
+
+Arguments:
+
+  None
+
+Returns:
+
+  The size of the entries left in the cache.
+
+--*/
+{
+  COMPRESS_CACHE_FILE_LIST  List;
+  CHAR8                     *Path;
+  UINTN                     Index;
+#ifdef __GNUC__
+  DIR                       *Dir;
+  struct dirent             *Entry;
+  struct stat               StatBuf;
+#else
+  struct _finddata_t        FindData;
+  intptr_t                  FindHandle;
+#endif
+
+  memset (&List, 0, sizeof (List));
+  Path = malloc (strlen (mCacheDir) + 260);
+  if (Path == NULL) {
+    return 0;
+  }
+
+#ifdef __GNUC__
+  Dir = opendir (mCacheDir);
+  if (Dir != NULL) {
+    while ((Entry = readdir (Dir)) != NULL) {
+      if (strlen (Entry->d_name) >= 256) {
+        continue;
+      }
+      sprintf (Path, "%s/%s", mCacheDir, Entry->d_name);
+      if (stat (Path, &StatBuf) == 0 && S_ISREG (StatBuf.st_mode)) {
+        CompressCacheAddFile (&List, Entry->d_name, (UINT64) StatBuf.st_size, StatBuf.st_mtime);
+      }
+    }
+    closedir (Dir);
+  }
+#else
+  sprintf (Path, "%s/*", mCacheDir);
+  FindHandle = _findfirst (Path, &FindData);
+  if (FindHandle != -1) {
+    do {
+      if ((FindData.attrib & _A_SUBDIR) == 0) {
+        CompressCacheAddFile (&List, FindData.name, (UINT64) FindData.size, FindData.time_write);
+      }
+    } while (_findnext (FindHandle, &FindData) == 0);
+    _findclose (FindHandle);
+  }
+#endif
+
+  if (List.TotalSize > mCacheLimit) {
+    qsort (List.Files, List.Count, sizeof (COMPRESS_CACHE_FILE), CompareCacheFiles);
+    for (Index = 0; Index < List.Count && List.TotalSize > COMPRESS_CACHE_LOW_WATER (mCacheLimit); Index++) {
+      sprintf (Path, "%s/%s", mCacheDir, List.Files[Index].Name);
+      remove (Path);
+      List.TotalSize -= List.Files[Index].Size;
+    }
+  }
+
+  free (List.Files);
+  free (Path);
+  return List.TotalSize;
+}
+
+STATIC
+VOID
+CompressCacheAccount (
+  IN  UINT64        EntrySize
+  )
+/*++
+
+Routine Description:
+
+  Add a stored entry to the running size of the cache and trim the cache
+  whenever the size crosses the limit. The first store of the process
+  trims to learn the size of the directory.
+
+  Only one thread trims at a time. Entries stored meanwhile are counted
+  on top of what the trim leaves, which at worst trims a little early.
+
+Arguments:
+
+  EntrySize   - The size of the entry file
+
+Returns:
+
+  None
+
+--*/
+{
+  BOOLEAN Trim;
+  UINT64  Remaining;
+
+  CACHE_LOCK ();
+  mCacheSize += EntrySize;
+  Trim = (BOOLEAN) (!mCacheTrimming && (!mCacheSizeKnown || mCacheSize > mCacheLimit));
+  if (Trim) {
+    mCacheTrimming = TRUE;
+    mCacheSize     = 0;
+  }
+  CACHE_UNLOCK ();
+
+  if (!Trim) {
+    return;
+  }
+
+  Remaining = CompressCacheTrim ();
+
+  CACHE_LOCK ();
+  mCacheSize     += Remaining;
+  mCacheSizeKnown = TRUE;
+  mCacheTrimming  = FALSE;
+  CACHE_UNLOCK ();
+}
+
+STATIC
+EFI_STATUS
+CompressCacheWriteEntry (
+  IN  CONST UINT8   *Digest,
+  IN  UINTN         InputSize,
+  IN  CONST VOID    *Output,
+  IN  UINTN         OutputSize
+  )
+/*++
+
+Routine Description:
+
+  Atomically create the entry for Digest, then trim the cache if it grew
+  beyond its limit.
+
+Arguments:
+
+  Digest      - The key of the entry
+  InputSize   - The size of the uncompressed data
+  Output      - The compressed data
+  OutputSize  - The size of Output
+
+Returns:
+
+  EFI_SUCCESS               - The entry was written.
+  EFI_BAD_BUFFER_SIZE       - The entry is larger than the cache.
+  EFI_ABORTED               - The entry could not be written.
+
+--*/
+{
+  COMPRESS_CACHE_ENTRY_HEADER Header;
+  CHAR8                       *Path;
+  CHAR8                       *TempPath;
+  FILE                        *File;
+  BOOLEAN                     Written;
+  struct stat                 StatBuf;
+  EFI_STATUS                  Status;
+
+  if ((UINT64) OutputSize + sizeof (Header) > mCacheLimit) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  Path     = CompressCacheEntryPath (Digest, FALSE);
+  TempPath = CompressCacheEntryPath (Digest, TRUE);
+  if (Path == NULL || TempPath == NULL) {
+    free (Path);
+    free (TempPath);
+    return EFI_ABORTED;
+  }
+
+  memset (&Header, 0, sizeof (Header));
+  Header.Signature  = COMPRESS_CACHE_SIGNATURE;
+  Header.InputSize  = InputSize;
+  Header.OutputSize = OutputSize;
+  memcpy (Header.Digest, Digest, SHA256_DIGEST_SIZE);
+
+  Status = EFI_ABORTED;
+  File   = fopen (TempPath, "wb");
+  if (File != NULL) {
+    Written = (BOOLEAN) (fwrite (&Header, sizeof (Header), 1, File) == 1 &&
+                         fwrite (Output, 1, OutputSize, File) == OutputSize);
+    if (fclose (File) == 0 && Written) {
+      //
+      // Readers only ever see complete entries. If another process stored
+      // the same key first, its entry has the same content.
+      //
+      if (rename (TempPath, Path) == 0 || stat (Path, &StatBuf) == 0) {
+        Status = EFI_SUCCESS;
+      }
+    }
+    remove (TempPath);
+  }
+
+  free (Path);
+  free (TempPath);
+
+  if (Status == EFI_SUCCESS) {
+    CompressCacheAccount (sizeof (Header) + (UINT64) OutputSize);
+  }
+  return Status;
+}
+
+BOOLEAN
+CompressCacheEnabled (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Report whether a cache directory is configured.
+
+Arguments:
+
+  None
+
+Returns:
+
+  TRUE if lookups and stores use the cache, FALSE otherwise.
+
+--*/
+{
+#ifndef __GNUC__
+  InitOnceExecuteOnce (&mCacheOnce, CompressCacheInitOnce, NULL, NULL);
+#else
+  pthread_once (&mCacheOnce, CompressCacheInitialize);
+#endif
+  return (BOOLEAN) (mCacheDir != NULL);
+}
+
+EFI_STATUS
+CompressCacheLookup (
+  IN  CONST CHAR8                       *Codec,
+  IN  CONST CHAR8                       *Params,
+  IN  CONST VOID                        *Input,
+  IN  UINTN                             InputSize,
+  OUT VOID                              **Output,
+  OUT UINTN                             *OutputSize
+  )
+/*++
+
+Routine Description:
+
+  Find the stored output of an earlier compression of the same input.
+
+Arguments:
+
+  Codec       - Name of the compression format, including anything that
+                changes the encoder output such as the tool version
+  Params      - Encoder parameters that change the output, or "" for none
+  Input       - The uncompressed data
+  InputSize   - The size of Input
+  Output      - On success, a buffer holding the compressed data. The
+                caller releases it with free().
+  OutputSize  - On success, the size of Output
+
+Returns:
+
+  EFI_SUCCESS               - The entry was found and verified.
+  EFI_NOT_FOUND             - No usable entry exists, or the cache is disabled.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+{
+  UINT8 Digest[SHA256_DIGEST_SIZE];
+
+  if (!CompressCacheEnabled ()) {
+    return EFI_NOT_FOUND;
+  }
+  CompressCacheDigest (Codec, Params, Input, InputSize, Digest);
+  return CompressCacheReadEntry (Digest, InputSize, Output, OutputSize);
+}
+
+EFI_STATUS
+CompressCacheStore (
+  IN  CONST CHAR8                       *Codec,
+  IN  CONST CHAR8                       *Params,
+  IN  CONST VOID                        *Input,
+  IN  UINTN                             InputSize,
+  IN  CONST VOID                        *Output,
+  IN  UINTN                             OutputSize
+  )
+/*++
+
+Routine Description:
+
+  Add the output of a compression to the cache and evict the least
+  recently used entries if the cache grew beyond its size limit.
+
+Arguments:
+
+  Codec       - Name of the compression format, as for CompressCacheLookup
+  Params      - Encoder parameters, as for CompressCacheLookup
+  Input       - The uncompressed data
+  InputSize   - The size of Input
+  Output      - The compressed data
+  OutputSize  - The size of Output
+
+Returns:
+
+  EFI_SUCCESS               - The entry was written.
+  EFI_NOT_STARTED           - The cache is disabled.
+  EFI_BAD_BUFFER_SIZE       - The entry is larger than the cache.
+  EFI_ABORTED               - The entry could not be written.
+
+--*/
+{
+  UINT8 Digest[SHA256_DIGEST_SIZE];
+
+  if (!CompressCacheEnabled ()) {
+    return EFI_NOT_STARTED;
+  }
+  CompressCacheDigest (Codec, Params, Input, InputSize, Digest);
+  return CompressCacheWriteEntry (Digest, InputSize, Output, OutputSize);
+}
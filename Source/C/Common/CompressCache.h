@@ -0,0 +1,139 @@
+/** @file
+
+Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+Module Name:
+
+  CompressCache.h
+
+Abstract:
+
+  Header file for the on-disk compression cache shared by the compression
+  tools. Entries are keyed by the SHA-256 of the codec name, the encoder
+  parameters and the uncompressed data, so an unchanged section is not
+  compressed again by a later build.
+
+  The cache is disabled unless the COMPRESS_CACHE_DIR environment variable
+  names a directory. COMPRESS_CACHE_SIZE bounds its size in bytes, with an
+  optional K, M or G suffix; the least recently used entries are removed
+  when it is exceeded. Entries are written to a temporary file and renamed
+  into place, so parallel builds may share one cache directory.
+
+**/
+
+#ifndef _COMPRESS_CACHE_H
+#define _COMPRESS_CACHE_H
+
+#include <Common/UefiBaseTypes.h>
+
+#define COMPRESS_CACHE_DIR_VARIABLE       "COMPRESS_CACHE_DIR"
+#define COMPRESS_CACHE_SIZE_VARIABLE      "COMPRESS_CACHE_SIZE"
+#define COMPRESS_CACHE_DEFAULT_SIZE       (512 * 1024 * 1024)
+
+//
+// Codec names shared by the tools producing the same format. The revision
+// suffix must change whenever the encoder output changes.
+//
+#define COMPRESS_CACHE_CODEC_EFI          "efi-1"
+#define COMPRESS_CACHE_CODEC_TIANO        "tiano-1"
+#define COMPRESS_CACHE_CODEC_LZMA         "lzma-1"
+
+BOOLEAN
+CompressCacheEnabled (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Report whether a cache directory is configured.
+
+Arguments:
+
+  None
+
+Returns:
+
+  TRUE if lookups and stores use the cache, FALSE otherwise.
+
+--*/
+;
+
+EFI_STATUS
+CompressCacheLookup (
+  IN  CONST CHAR8                       *Codec,
+  IN  CONST CHAR8                       *Params,
+  IN  CONST VOID                        *Input,
+  IN  UINTN                             InputSize,
+  OUT VOID                              **Output,
+  OUT UINTN                             *OutputSize
+  )
+/*++
+
+Routine Description:
+
+  Find the stored output of an earlier compression of the same input.
+
+Arguments:
+
+  Codec       - Name of the compression format, including anything that
+                changes the encoder output such as the tool version
+  Params      - Encoder parameters that change the output, or "" for none
+  Input       - The uncompressed data
+  InputSize   - The size of Input
+  Output      - On success, a buffer holding the compressed data. The
+                caller releases it with free().
+  OutputSize  - On success, the size of Output
+
+Returns:
+
+  EFI_SUCCESS               - The entry was found and verified.
+  EFI_NOT_FOUND             - No usable entry exists, or the cache is disabled.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+;
+
+EFI_STATUS
+CompressCacheStore (
+  IN  CONST CHAR8                       *Codec,
+  IN  CONST CHAR8                       *Params,
+  IN  CONST VOID                        *Input,
+  IN  UINTN                             InputSize,
+  IN  CONST VOID                        *Output,
+  IN  UINTN                             OutputSize
+  )
+/*++
+
+Routine Description:
+
+  Add the output of a compression to the cache and evict the least
+  recently used entries if the cache grew beyond its size limit.
+
+Arguments:
+
+  Codec       - Name of the compression format, as for CompressCacheLookup
+  Params      - Encoder parameters, as for CompressCacheLookup
+  Input       - The uncompressed data
+  InputSize   - The size of Input
+  Output      - The compressed data
+  OutputSize  - The size of Output
+
+Returns:
+
+  EFI_SUCCESS               - The entry was written.
+  EFI_NOT_STARTED           - The cache is disabled.
+  EFI_BAD_BUFFER_SIZE       - The entry is larger than the cache.
+  EFI_ABORTED               - The entry could not be written.
+
+--*/
+;
+
+#endif
@@ -15,7 +15,7 @@ Module Name:
 
 Abstract:
 
-  Header file for CalcuateCrc32 routine
+  Header file for CalcuateCrc32 routine and the incremental CRC32 interface
   
 **/
 
@@ -51,4 +51,113 @@ Returns:
 --*/
 ;
 
+//
+// Available CRC32 engines. All engines produce identical results.
+//
+typedef enum {
+  Crc32EngineAuto,
+  Crc32EngineTable,
+  Crc32EngineSlice16,
+  Crc32EnginePclmul,
+  Crc32EngineMax
+} CRC32_ENGINE;
+
+typedef struct {
+  UINT32  Crc;
+} CRC32_CONTEXT;
+
+EFI_STATUS
+Crc32SetEngine (
+  IN  CRC32_ENGINE                      Engine
+  )
+/*++
+
+Routine Description:
+
+  Select the engine used by Crc32Update and CalculateCrc32. The first CRC
+  calculation selects Crc32EngineAuto if no engine is selected yet. The
+  selection is atomic, so it may change while other threads calculate
+  CRCs; each update uses either the old or the new engine.
+
+Arguments:
+
+  Engine      - The engine to use. Crc32EngineAuto picks the fastest
+                engine supported by the processor.
+
+Returns:
+
+  EFI_SUCCESS               - The engine is selected.
+  EFI_UNSUPPORTED           - The engine is not available on this processor.
+  EFI_INVALID_PARAMETER     - Engine is not a valid engine.
+
+--*/
+;
+
+VOID
+Crc32Init (
+  OUT CRC32_CONTEXT                     *Context
+  )
+/*++
+
+Routine Description:
+
+  Start an incremental CRC32 calculation.
+
+Arguments:
+
+  Context     - The caller allocated context to initialize
+
+Returns:
+
+  None
+
+--*/
+;
+
+VOID
+Crc32Update (
+  IN OUT CRC32_CONTEXT                  *Context,
+  IN     CONST VOID                     *Data,
+  IN     UINTN                          DataSize
+  )
+/*++
+
+Routine Description:
+
+  Add a block of data to an incremental CRC32 calculation.
+
+Arguments:
+
+  Context     - The context started by Crc32Init
+  Data        - The buffer containing the next part of the data
+  DataSize    - The size of Data, which may be zero
+
+Returns:
+
+  None
+
+--*/
+;
+
+UINT32
+Crc32Final (
+  IN  CRC32_CONTEXT                     *Context
+  )
+/*++
+
+Routine Description:
+
+  Finish an incremental CRC32 calculation.
+
+Arguments:
+
+  Context     - The context started by Crc32Init
+
+Returns:
+
+  The CRC32 checksum of all the data passed to Crc32Update.
+
+--*/
+;
+
 #endif
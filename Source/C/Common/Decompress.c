@@ -49,15 +49,36 @@ Abstract:
 #define NPT MAXNP
 #endif
 
+//
+// Fast Char&Len lookup. mCFast is indexed by the next CFASTBIT bits of input
+// and holds up to two symbols those bits fully determine, so that the common
+// short codes (and pairs of short literals) are resolved in a single probe.
+// A symbol count of zero sends the decoder to the DecodeC() slow path.
+//
+//   bits  0..8   first symbol
+//   bits  9..16  second symbol, always an Original character
+//   bits 17..21  code length of the first symbol
+//   bits 22..26  code length of both symbols
+//   bits 27..28  number of symbols
+//
+#define CFASTBIT              12
+#define CFAST_ENTRY(c1, c2, l1, l2, n) \
+  ((UINT32) (c1) | ((UINT32) (c2) << 9) | ((UINT32) (l1) << 17) | ((UINT32) (l2) << 22) | ((UINT32) (n) << 27))
+#define CFAST_CHAR1(e)        ((UINT16) ((e) & 0x1FF))
+#define CFAST_CHAR2(e)        ((UINT8) ((e) >> 9))
+#define CFAST_LEN1(e)         ((UINT16) (((e) >> 17) & 0x1F))
+#define CFAST_LEN2(e)         ((UINT16) (((e) >> 22) & 0x1F))
+#define CFAST_COUNT(e)        ((e) >> 27)
+
 typedef struct {
   UINT8   *mSrcBase;  // Starting address of compressed data
   UINT8   *mDstBase;  // Starting address of decompressed data
   UINT32  mOutBuf;
   UINT32  mInBuf;
 
-  UINT16  mBitCount;
-  UINT32  mBitBuf;
-  UINT32  mSubBitBuf;
+  UINT16  mBitCount;  // Valid bits in mBitBuf64
+  UINT32  mBitBuf;    // The next BITBUFSIZ bits, the top of mBitBuf64
+  UINT64  mBitBuf64;
   UINT16  mBlockSize;
   UINT32  mCompSize;
   UINT32  mOrigSize;
@@ -70,9 +91,43 @@ typedef struct {
   UINT8   mPTLen[NPT];
   UINT16  mCTable[4096];
   UINT16  mPTTable[256];
+  UINT32  mCFast[1U << CFASTBIT];
+
+  //
+  // The length of the field 'Position Set Code Length Array Size' in Block Header.
+  // For EFI 1.1 de/compression algorithm, mPBit = 4
+  // For Tiano de/compression algorithm, mPBit = 5
+  //
+  UINT16  mPBit;
 } SCRATCH_DATA;
 
-STATIC UINT16 mPbit = EFIPBIT;
+//
+// Streaming decompression. Compressed input is staged in a bounded buffer
+// and decoded one symbol at a time, but only while enough of it is staged
+// that FillBuf() cannot run dry in the middle of a symbol (or of a block
+// header), so the bit level decoder never has to be suspended. Decoded
+// data goes through a ring holding the match window, from which Pointers
+// are copied; the caller's output buffer may be any size.
+//
+#define STREAM_INPUT_SIZE     0x2000
+#define STREAM_BLOCK_MARGIN   0x1000
+#define STREAM_SYMBOL_MARGIN  64
+#define EFI_WINDOW_BITS       14
+#define TIANO_WINDOW_BITS     19
+
+struct _DECOMPRESS_STREAM {
+  SCRATCH_DATA  mSd;
+  UINT8         mHeader[8];
+  UINT32        mHeaderSize;  // Bytes of mHeader received so far
+  UINT32        mCompRemain;  // Compressed bytes not yet staged
+  BOOLEAN       mPrimed;      // mBitBuf has been filled
+  EFI_STATUS    mStatus;      // Sticky error
+  UINT32        mMatchRemain; // Bytes of the current Pointer still to copy
+  UINT32        mMatchIdx;    // Position they are copied from
+  UINT32        mWindowMask;
+  UINT8         *mWindow;
+  UINT8         mInput[STREAM_INPUT_SIZE];
+};
 
 STATIC
 VOID
@@ -86,42 +141,59 @@ Routine Description:
 
   Shift mBitBuf NumOfBits left. Read in NumOfBits of bits from source.
 
+  Input is staged in the 64 bit mBitBuf64, which is topped up a word at a
+  time once fewer than BITBUFSIZ bits remain, so mBitBuf always holds the
+  next BITBUFSIZ bits of the stream. Past the end of the compressed data
+  the stream is padded with zero bits.
+
 Arguments:
 
   Sd        - The global scratch data
-  NumOfBit  - The number of bits to shift and read.
+  NumOfBit  - The number of bits to shift and read, at most BITBUFSIZ.
 
 Returns: (VOID)
 
 --*/
 {
-  Sd->mBitBuf = (UINT32) (Sd->mBitBuf << NumOfBits);
-
-  while (NumOfBits > Sd->mBitCount) {
+  UINT8   *Src;
+  UINT32  Bytes;
 
-    Sd->mBitBuf |= (UINT32) (Sd->mSubBitBuf << (NumOfBits = (UINT16) (NumOfBits - Sd->mBitCount)));
+  Sd->mBitBuf64 <<= NumOfBits;
+  Sd->mBitCount   = (UINT16) (Sd->mBitCount - NumOfBits);
 
-    if (Sd->mCompSize > 0) {
+  if (Sd->mBitCount < BITBUFSIZ) {
+    Src = &Sd->mSrcBase[Sd->mInBuf];
+    if (Sd->mCompSize >= 8) {
       //
-      // Get 1 byte into SubBitBuf
+      // Load 8 bytes and keep the whole ones that fit. The bits of the
+      // partial byte that spill over are the same stream bits the next
+      // load ORs in at the same place, so they do no harm.
       //
-      Sd->mCompSize--;
-      Sd->mSubBitBuf  = 0;
-      Sd->mSubBitBuf  = Sd->mSrcBase[Sd->mInBuf++];
-      Sd->mBitCount   = 8;
-
+      Sd->mBitBuf64 |= (((UINT64) Src[0] << 56) | ((UINT64) Src[1] << 48) |
+                        ((UINT64) Src[2] << 40) | ((UINT64) Src[3] << 32) |
+                        ((UINT64) Src[4] << 24) | ((UINT64) Src[5] << 16) |
+                        ((UINT64) Src[6] << 8)  | (UINT64) Src[7]) >> Sd->mBitCount;
+      Bytes          = (63 - Sd->mBitCount) >> 3;
+      Sd->mInBuf    += Bytes;
+      Sd->mCompSize -= Bytes;
+      Sd->mBitCount  = (UINT16) (Sd->mBitCount + Bytes * 8);
     } else {
-      //
-      // No more bits from the source, just pad zero bit.
-      //
-      Sd->mSubBitBuf  = 0;
-      Sd->mBitCount   = 8;
-
+      while (Sd->mBitCount <= 56) {
+        if (Sd->mCompSize > 0) {
+          Sd->mCompSize--;
+          Sd->mBitBuf64 |= (UINT64) Src[0] << (56 - Sd->mBitCount);
+          Src++;
+          Sd->mInBuf++;
+        }
+        //
+        // No more bits from the source, just pad zero bit.
+        //
+        Sd->mBitCount = (UINT16) (Sd->mBitCount + 8);
+      }
     }
   }
 
-  Sd->mBitCount = (UINT16) (Sd->mBitCount - NumOfBits);
-  Sd->mBitBuf |= Sd->mSubBitBuf >> Sd->mBitCount;
+  Sd->mBitBuf = (UINT32) (Sd->mBitBuf64 >> (64 - BITBUFSIZ));
 }
 
 STATIC
@@ -527,6 +599,68 @@ Returns: (VOID)
   return ;
 }
 
+STATIC
+VOID
+MakeFastCTable (
+  SCRATCH_DATA  *Sd
+  )
+/*++
+
+Routine Description:
+
+  Build the mCFast lookup table from mCTable and mCLen. The first symbol of
+  every entry is exactly what DecodeC() reads from mCTable, so corrupted
+  tables decode as before. A second literal is only paired up when the
+  code lengths form a complete prefix code; then any input beginning with
+  the bits seen so far decodes to that literal.
+
+Arguments:
+
+  Sd    - the global scratch data
+
+Returns: (VOID)
+
+--*/
+{
+  UINT32  Index;
+  UINT32  Kraft;
+  UINT16  Char;
+  UINT16  Char2;
+  UINT16  Len;
+  UINT16  Len2;
+
+  Kraft = 0;
+  for (Index = 0; Index < NC; Index++) {
+    if (Sd->mCLen[Index] != 0) {
+      Kraft += 1U << (16 - Sd->mCLen[Index]);
+    }
+  }
+
+  for (Index = 0; Index < (1U << CFASTBIT); Index++) {
+    Char = Sd->mCTable[Index];
+    if (Char >= NC) {
+      //
+      // Code longer than CFASTBIT, walk the tree in DecodeC()
+      //
+      Sd->mCFast[Index] = 0;
+      continue;
+    }
+
+    Len               = Sd->mCLen[Char];
+    Sd->mCFast[Index] = CFAST_ENTRY (Char, 0, Len, Len, 1);
+
+    if (Kraft == (1U << 16) && Char < 256 && Len < CFASTBIT) {
+      Char2 = Sd->mCTable[(Index << Len) & ((1U << CFASTBIT) - 1)];
+      if (Char2 < 256) {
+        Len2 = (UINT16) (Len + Sd->mCLen[Char2]);
+        if (Len2 <= CFASTBIT) {
+          Sd->mCFast[Index] = CFAST_ENTRY (Char, Char2, Len, Len2, 2);
+        }
+      }
+    }
+  }
+}
+
 STATIC
 UINT16
 DecodeC (
@@ -563,10 +697,12 @@ Returns:
 
     ReadCLen (Sd);
 
-    Sd->mBadTableFlag = ReadPTLen (Sd, MAXNP, mPbit, (UINT16) (-1));
+    Sd->mBadTableFlag = ReadPTLen (Sd, MAXNP, Sd->mPBit, (UINT16) (-1));
     if (Sd->mBadTableFlag != 0) {
       return 0;
     }
+
+    MakeFastCTable (Sd);
   }
 
   Sd->mBlockSize--;
@@ -615,15 +751,48 @@ Returns: (VOID)
   UINT16  BytesRemain;
   UINT32  DataIdx;
   UINT16  CharC;
+  UINT32  Entry;
 
   BytesRemain = (UINT16) (-1);
 
   DataIdx     = 0;
 
   for (;;) {
-    CharC = DecodeC (Sd);
-    if (Sd->mBadTableFlag != 0) {
-      return ;
+    //
+    // Within a block, short codes come straight from mCFast; a pair of
+    // literals is taken in one go when the block has room for both.
+    //
+    Entry = 0;
+    if (Sd->mBlockSize != 0) {
+      Entry = Sd->mCFast[Sd->mBitBuf >> (BITBUFSIZ - CFASTBIT)];
+    }
+
+    if (CFAST_COUNT (Entry) == 2 && Sd->mBlockSize >= 2) {
+      Sd->mBlockSize = (UINT16) (Sd->mBlockSize - 2);
+      FillBuf (Sd, CFAST_LEN2 (Entry));
+
+      Sd->mDstBase[Sd->mOutBuf++] = (UINT8) CFAST_CHAR1 (Entry);
+      if (Sd->mOutBuf >= Sd->mOrigSize) {
+        return ;
+      }
+
+      Sd->mDstBase[Sd->mOutBuf++] = CFAST_CHAR2 (Entry);
+      if (Sd->mOutBuf >= Sd->mOrigSize) {
+        return ;
+      }
+
+      continue;
+    }
+
+    if (CFAST_COUNT (Entry) != 0) {
+      Sd->mBlockSize--;
+      FillBuf (Sd, CFAST_LEN1 (Entry));
+      CharC = CFAST_CHAR1 (Entry);
+    } else {
+      CharC = DecodeC (Sd);
+      if (Sd->mBadTableFlag != 0) {
+        return ;
+      }
     }
 
     if (CharC < 256) {
@@ -645,14 +814,25 @@ Returns: (VOID)
 
       DataIdx     = Sd->mOutBuf - DecodeP (Sd) - 1;
 
-      BytesRemain--;
-      while ((INT16) (BytesRemain) >= 0) {
-        Sd->mDstBase[Sd->mOutBuf++] = Sd->mDstBase[DataIdx++];
-        if (Sd->mOutBuf >= Sd->mOrigSize) {
-          return ;
+      if (BytesRemain > Sd->mOrigSize - Sd->mOutBuf) {
+        BytesRemain = (UINT16) (Sd->mOrigSize - Sd->mOutBuf);
+      }
+
+      if (Sd->mOutBuf - DataIdx >= BytesRemain) {
+        //
+        // Source and destination do not overlap
+        //
+        memcpy (&Sd->mDstBase[Sd->mOutBuf], &Sd->mDstBase[DataIdx], BytesRemain);
+        Sd->mOutBuf += BytesRemain;
+      } else {
+        while (BytesRemain != 0) {
+          Sd->mDstBase[Sd->mOutBuf++] = Sd->mDstBase[DataIdx++];
+          BytesRemain--;
         }
+      }
 
-        BytesRemain--;
+      if (Sd->mOutBuf >= Sd->mOrigSize) {
+        return ;
       }
     }
   }
@@ -707,7 +887,8 @@ Decompress (
   IN OUT  VOID    *Destination,
   IN      UINT32  DstSize,
   IN OUT  VOID    *Scratch,
-  IN      UINT32  ScratchSize
+  IN      UINT32  ScratchSize,
+  IN      UINT32  Version
   )
 /*++
 
@@ -723,6 +904,8 @@ Arguments:
   DstSize     - The size of destination buffer.
   Scratch     - The buffer used internally by the decompress routine. This  buffer is needed to store intermediate data.
   ScratchSize - The size of scratch buffer.
+  Version     - 1 for EFI 1.1 de/compression algorithm,
+                2 for Tiano de/compression algorithm.
 
 Returns:
 
@@ -774,11 +957,12 @@ Returns:
   Sd->mDstBase  = Dst;
   Sd->mCompSize = CompSize;
   Sd->mOrigSize = OrigSize;
+  Sd->mPBit     = (UINT16) ((Version == 2) ? MAXPBIT : EFIPBIT);
 
   //
   // Fill the first BITBUFSIZ bits
   //
-  FillBuf (Sd, BITBUFSIZ);
+  FillBuf (Sd, 0);
 
   //
   // Decompress it
@@ -886,8 +1070,7 @@ Returns:
 
 --*/
 {
-  mPbit = EFIPBIT;
-  return Decompress (Source, SrcSize, Destination, DstSize, Scratch, ScratchSize);
+  return Decompress (Source, SrcSize, Destination, DstSize, Scratch, ScratchSize, 1);
 }
 
 EFI_STATUS
@@ -921,8 +1104,402 @@ Returns:
 
 --*/
 {
-  mPbit = MAXPBIT;
-  return Decompress (Source, SrcSize, Destination, DstSize, Scratch, ScratchSize);
+  return Decompress (Source, SrcSize, Destination, DstSize, Scratch, ScratchSize, 2);
+}
+
+STATIC
+EFI_STATUS
+DecodeStream (
+  IN OUT  DECOMPRESS_STREAM  *Stream,
+  OUT     UINT8              *Destination,
+  IN      UINT32             DstSize,
+  OUT     UINT32             *Produced
+  )
+/*++
+
+Routine Description:
+
+  Decode as much of the staged input as is safe into Destination. This is
+  Decode() with the output going through the window ring, and with every
+  symbol preceded by a check that it can be decoded and stored.
+
+Arguments:
+
+  Stream      - The decompression stream
+  Destination - Where to store the decompressed data
+  DstSize     - The size of Destination
+  Produced    - On output, the number of bytes stored in Destination
+
+Returns:
+
+  EFI_SUCCESS           - All the decompressed data has been produced.
+  EFI_BUFFER_TOO_SMALL  - Destination is full.
+  EFI_NOT_READY         - More input must be staged first.
+  EFI_INVALID_PARAMETER - The source data is corrupted.
+
+--*/
+{
+  SCRATCH_DATA  *Sd;
+  UINT8         *Window;
+  UINT32        Mask;
+  UINT32        Count;
+  UINT32        Pos;
+  UINT32        Entry;
+  UINT16        CharC;
+  UINT8         Byte;
+
+  Sd        = &Stream->mSd;
+  Window    = Stream->mWindow;
+  Mask      = Stream->mWindowMask;
+  Count     = 0;
+  *Produced = 0;
+
+  while (Sd->mOutBuf < Sd->mOrigSize) {
+    if (Stream->mMatchRemain != 0) {
+      //
+      // Finish copying the current Pointer
+      //
+      while (Stream->mMatchRemain != 0 && Count < DstSize) {
+        Byte                          = Window[Stream->mMatchIdx++ & Mask];
+        Window[Sd->mOutBuf++ & Mask]  = Byte;
+        Destination[Count++]          = Byte;
+        Stream->mMatchRemain--;
+      }
+
+      if (Stream->mMatchRemain != 0) {
+        *Produced = Count;
+        return EFI_BUFFER_TOO_SMALL;
+      }
+
+      continue;
+    }
+
+    if (Count == DstSize) {
+      *Produced = Count;
+      return EFI_BUFFER_TOO_SMALL;
+    }
+
+    if (Stream->mCompRemain != 0 &&
+        Sd->mCompSize < ((Sd->mBlockSize == 0) ? STREAM_BLOCK_MARGIN : STREAM_SYMBOL_MARGIN)) {
+      *Produced = Count;
+      return EFI_NOT_READY;
+    }
+
+    if (!Stream->mPrimed) {
+      //
+      // Fill the first BITBUFSIZ bits
+      //
+      FillBuf (Sd, 0);
+      Stream->mPrimed = TRUE;
+    }
+
+    Entry = 0;
+    if (Sd->mBlockSize != 0) {
+      Entry = Sd->mCFast[Sd->mBitBuf >> (BITBUFSIZ - CFASTBIT)];
+    }
+
+    if (CFAST_COUNT (Entry) == 2 && Sd->mBlockSize >= 2 && DstSize - Count >= 2) {
+      Sd->mBlockSize = (UINT16) (Sd->mBlockSize - 2);
+      FillBuf (Sd, CFAST_LEN2 (Entry));
+
+      Window[Sd->mOutBuf++ & Mask] = (UINT8) CFAST_CHAR1 (Entry);
+      Destination[Count++]         = (UINT8) CFAST_CHAR1 (Entry);
+      if (Sd->mOutBuf >= Sd->mOrigSize) {
+        break;
+      }
+
+      Window[Sd->mOutBuf++ & Mask] = CFAST_CHAR2 (Entry);
+      Destination[Count++]         = CFAST_CHAR2 (Entry);
+      continue;
+    }
+
+    if (CFAST_COUNT (Entry) != 0) {
+      Sd->mBlockSize--;
+      FillBuf (Sd, CFAST_LEN1 (Entry));
+      CharC = CFAST_CHAR1 (Entry);
+    } else {
+      CharC = DecodeC (Sd);
+      if (Sd->mBadTableFlag != 0) {
+        *Produced = Count;
+        return EFI_INVALID_PARAMETER;
+      }
+    }
+
+    if (CharC < 256) {
+      //
+      // Process an Original character
+      //
+      Window[Sd->mOutBuf++ & Mask] = (UINT8) CharC;
+      Destination[Count++]         = (UINT8) CharC;
+    } else {
+      //
+      // Process a Pointer. It must stay inside the data decoded so far and
+      // inside the window.
+      //
+      Pos = DecodeP (Sd);
+      if (Pos >= Sd->mOutBuf || Pos > Mask) {
+        *Produced = Count;
+        return EFI_INVALID_PARAMETER;
+      }
+
+      Stream->mMatchIdx    = Sd->mOutBuf - Pos - 1;
+      Stream->mMatchRemain = (UINT32) (CharC - (UINT8_MAX + 1 - THRESHOLD));
+      if (Stream->mMatchRemain > Sd->mOrigSize - Sd->mOutBuf) {
+        Stream->mMatchRemain = Sd->mOrigSize - Sd->mOutBuf;
+      }
+    }
+  }
+
+  *Produced = Count;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+DecompressStreamCreate (
+  IN      UINT32             Version,
+     OUT  DECOMPRESS_STREAM  **Stream
+  )
+/*++
+
+Routine Description:
+
+  Create a stream for decompressing data that arrives in pieces. Memory
+  use is bounded by the match window, whatever the size of the data.
+
+Arguments:
+
+  Version     - 1 for EFI 1.1 de/compression algorithm,
+                2 for Tiano de/compression algorithm.
+  Stream      - On output, the new stream.
+
+Returns:
+
+  EFI_SUCCESS           - The stream was created.
+  EFI_OUT_OF_RESOURCES  - No resource to complete function.
+  EFI_INVALID_PARAMETER - Version is unknown or Stream is NULL.
+
+--*/
+{
+  DECOMPRESS_STREAM *NewStream;
+  UINT32            WindowBits;
+
+  if (Stream == NULL || (Version != 1 && Version != 2)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Stream   = NULL;
+  NewStream = (DECOMPRESS_STREAM *) calloc (1, sizeof (DECOMPRESS_STREAM));
+  if (NewStream == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  WindowBits            = (Version == 2) ? TIANO_WINDOW_BITS : EFI_WINDOW_BITS;
+  NewStream->mWindow    = (UINT8 *) malloc (1U << WindowBits);
+  if (NewStream->mWindow == NULL) {
+    free (NewStream);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  NewStream->mWindowMask    = (1U << WindowBits) - 1;
+  NewStream->mStatus        = EFI_SUCCESS;
+  NewStream->mSd.mSrcBase   = NewStream->mInput;
+  NewStream->mSd.mPBit      = (UINT16) ((Version == 2) ? MAXPBIT : EFIPBIT);
+
+  *Stream = NewStream;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+DecompressStreamProcess (
+  IN      DECOMPRESS_STREAM  *Stream,
+  IN      VOID               *Source,
+  IN OUT  UINT32             *SrcSize,
+     OUT  VOID               *Destination,
+  IN OUT  UINT32             *DstSize
+  )
+/*++
+
+Routine Description:
+
+  Feed the next piece of compressed data to a stream and collect the data
+  decompressed so far. Input that cannot be used yet is not consumed and
+  must be passed again; bytes following the end of the compressed data
+  are never consumed.
+
+Arguments:
+
+  Stream      - The stream from DecompressStreamCreate()
+  Source      - The next piece of compressed data
+  SrcSize     - On input, the size of Source; On output, the number of
+                bytes consumed.
+  Destination - The buffer to store the decompressed data
+  DstSize     - On input, the size of Destination; On output, the number
+                of bytes stored.
+
+Returns:
+
+  EFI_SUCCESS           - All the decompressed data has been returned.
+  EFI_NOT_READY         - Call again with more input or more output space.
+  EFI_INVALID_PARAMETER - The source data is corrupted, or a parameter is wrong.
+
+--*/
+{
+  SCRATCH_DATA  *Sd;
+  UINT8         *Src;
+  UINT32        Consumed;
+  UINT32        Produced;
+  UINT32        Count;
+  EFI_STATUS    Status;
+
+  if (Stream == NULL || SrcSize == NULL || DstSize == NULL ||
+      (Source == NULL && *SrcSize != 0) || (Destination == NULL && *DstSize != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (EFI_ERROR (Stream->mStatus)) {
+    *SrcSize = 0;
+    *DstSize = 0;
+    return Stream->mStatus;
+  }
+
+  Sd        = &Stream->mSd;
+  Src       = Source;
+  Consumed  = 0;
+  Produced  = 0;
+
+  //
+  // Collect the compressed size and original size
+  //
+  while (Stream->mHeaderSize < 8 && Consumed < *SrcSize) {
+    Stream->mHeader[Stream->mHeaderSize++] = Src[Consumed++];
+    if (Stream->mHeaderSize == 8) {
+      Stream->mCompRemain = Stream->mHeader[0] + (Stream->mHeader[1] << 8) + (Stream->mHeader[2] << 16) + (Stream->mHeader[3] << 24);
+      Sd->mOrigSize       = Stream->mHeader[4] + (Stream->mHeader[5] << 8) + (Stream->mHeader[6] << 16) + (Stream->mHeader[7] << 24);
+    }
+  }
+
+  if (Stream->mHeaderSize < 8) {
+    *SrcSize = Consumed;
+    *DstSize = 0;
+    return EFI_NOT_READY;
+  }
+
+  for (;;) {
+    //
+    // Stage as much input as fits
+    //
+    Count = *SrcSize - Consumed;
+    if (Count > STREAM_INPUT_SIZE - Sd->mCompSize) {
+      Count = STREAM_INPUT_SIZE - Sd->mCompSize;
+    }
+
+    if (Count > Stream->mCompRemain) {
+      Count = Stream->mCompRemain;
+    }
+
+    if (Count != 0) {
+      if (Sd->mInBuf != 0) {
+        memmove (Stream->mInput, Stream->mInput + Sd->mInBuf, Sd->mCompSize);
+        Sd->mInBuf = 0;
+      }
+
+      memcpy (Stream->mInput + Sd->mCompSize, Src + Consumed, Count);
+      Consumed            += Count;
+      Sd->mCompSize       += Count;
+      Stream->mCompRemain -= Count;
+    }
+
+    Status    = DecodeStream (Stream, (UINT8 *) Destination + Produced, *DstSize - Produced, &Count);
+    Produced += Count;
+
+    if (Status != EFI_NOT_READY || Consumed == *SrcSize || Stream->mCompRemain == 0) {
+      break;
+    }
+  }
+
+  if (Status == EFI_SUCCESS) {
+    //
+    // Skip whatever is left of the compressed data
+    //
+    Count = *SrcSize - Consumed;
+    if (Count > Stream->mCompRemain) {
+      Count = Stream->mCompRemain;
+    }
+
+    Consumed            += Count;
+    Stream->mCompRemain -= Count;
+  } else if (Status == EFI_INVALID_PARAMETER) {
+    Stream->mStatus = Status;
+  } else {
+    Status = EFI_NOT_READY;
+  }
+
+  *SrcSize = Consumed;
+  *DstSize = Produced;
+  return Status;
+}
+
+EFI_STATUS
+DecompressStreamGetInfo (
+  IN      DECOMPRESS_STREAM  *Stream,
+     OUT  UINT32             *DstSize
+  )
+/*++
+
+Routine Description:
+
+  Get the size of the decompressed data, known once the first 8 bytes of
+  compressed data have been fed to the stream.
+
+Arguments:
+
+  Stream      - The stream from DecompressStreamCreate()
+  DstSize     - The size of the decompressed data
+
+Returns:
+
+  EFI_SUCCESS           - DstSize is returned.
+  EFI_NOT_READY         - The header has not been seen yet.
+  EFI_INVALID_PARAMETER - A parameter is NULL.
+
+--*/
+{
+  if (Stream == NULL || DstSize == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Stream->mHeaderSize < 8) {
+    return EFI_NOT_READY;
+  }
+
+  *DstSize = Stream->mSd.mOrigSize;
+  return EFI_SUCCESS;
+}
+
+VOID
+DecompressStreamDestroy (
+  IN      DECOMPRESS_STREAM  *Stream
+  )
+/*++
+
+Routine Description:
+
+  Free a stream created by DecompressStreamCreate().
+
+Arguments:
+
+  Stream      - The stream to free. NULL is ignored.
+
+Returns: (VOID)
+
+--*/
+{
+  if (Stream == NULL) {
+    return ;
+  }
+
+  free (Stream->mWindow);
+  free (Stream);
 }
 
 EFI_STATUS
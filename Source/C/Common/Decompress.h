@@ -160,6 +160,113 @@ EFI_STATUS
   IN      UINT32  ScratchSize
   );
 
+//
+// Incremental decompression. Input is fed in pieces of any size and output
+// is collected into caller buffers of any size; memory use is bounded by
+// the match window of the algorithm, not by the size of the data.
+//
+typedef struct _DECOMPRESS_STREAM  DECOMPRESS_STREAM;
+
+EFI_STATUS
+DecompressStreamCreate (
+  IN      UINT32             Version,
+     OUT  DECOMPRESS_STREAM  **Stream
+  );
+/**
+
+Routine Description:
+
+  Create a decompression stream.
+
+Arguments:
+
+  Version     - 1 for EFI 1.1 de/compression algorithm,
+                2 for Tiano de/compression algorithm.
+  Stream      - On output, the new stream.
+
+Returns:
+
+  EFI_SUCCESS           - The stream was created.
+  EFI_OUT_OF_RESOURCES  - No resource to complete function.
+  EFI_INVALID_PARAMETER - Version is unknown or Stream is NULL.
+
+**/
+
+EFI_STATUS
+DecompressStreamProcess (
+  IN      DECOMPRESS_STREAM  *Stream,
+  IN      VOID               *Source,
+  IN OUT  UINT32             *SrcSize,
+     OUT  VOID               *Destination,
+  IN OUT  UINT32             *DstSize
+  );
+/**
+
+Routine Description:
+
+  Feed the next piece of compressed data to a stream and collect the data
+  decompressed so far.
+
+Arguments:
+
+  Stream      - The stream from DecompressStreamCreate()
+  Source      - The next piece of compressed data
+  SrcSize     - On input, the size of Source; On output, the number of
+                bytes consumed. Unconsumed bytes must be passed again.
+  Destination - The buffer to store the decompressed data
+  DstSize     - On input, the size of Destination; On output, the number
+                of bytes stored.
+
+Returns:
+
+  EFI_SUCCESS           - All the decompressed data has been returned.
+  EFI_NOT_READY         - Call again with more input or more output space.
+  EFI_INVALID_PARAMETER - The source data is corrupted, or a parameter is wrong.
+
+**/
+
+EFI_STATUS
+DecompressStreamGetInfo (
+  IN      DECOMPRESS_STREAM  *Stream,
+     OUT  UINT32             *DstSize
+  );
+/**
+
+Routine Description:
+
+  Get the size of the decompressed data.
+
+Arguments:
+
+  Stream      - The stream from DecompressStreamCreate()
+  DstSize     - The size of the decompressed data
+
+Returns:
+
+  EFI_SUCCESS           - DstSize is returned.
+  EFI_NOT_READY         - The first 8 bytes have not been fed to the stream yet.
+  EFI_INVALID_PARAMETER - A parameter is NULL.
+
+**/
+
+VOID
+DecompressStreamDestroy (
+  IN      DECOMPRESS_STREAM  *Stream
+  );
+/**
+
+Routine Description:
+
+  Free a stream created by DecompressStreamCreate().
+
+Arguments:
+
+  Stream      - The stream to free. NULL is ignored.
+
+Returns: (VOID)
+
+**/
+
 EFI_STATUS
 Extract (
   IN      VOID    *Source,
@@ -45,7 +45,14 @@ typedef INT16             NODE;
 #define MAX_HASH_VAL      (3 * WNDSIZ + (WNDSIZ / 512 + 1) * UINT8_MAX)
 #define HASH(p, c)        ((p) + ((c) << (WNDBIT - 9)) + WNDSIZ * 2)
 #define CRCPOLY           0xA001
-#define UPDATE_CRC(c)     mCrc = mCrcTable[(mCrc ^ (c)) & 0xFF] ^ (mCrc >> UINT8_BIT)
+#define UPDATE_CRC(c)     Ctx->mCrc = Ctx->mCrcTable[(Ctx->mCrc ^ (c)) & 0xFF] ^ (Ctx->mCrc >> UINT8_BIT)
+
+//
+// Hash chain match finder (compression levels below COMPRESS_LEVEL_MAX)
+//
+#define CHAIN_HASH_BITS   15
+#define CHAIN_HASH_SIZE   (1U << CHAIN_HASH_BITS)
+#define CHAIN_HASH(p)     ((((UINT32) (p)[0] | ((UINT32) (p)[1] << 8) | ((UINT32) (p)[2] << 16)) * 2654435761U) >> (32 - CHAIN_HASH_BITS))
 
 //
 // C: the Char&Len Set; P: the Position Set; T: the exTra Set
@@ -69,28 +76,33 @@ typedef INT16             NODE;
 
 STATIC
 VOID 
-PutDword(
+PutDword (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 Data
   );
 
 STATIC
 EFI_STATUS 
 AllocateMemory (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 FreeMemory (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC 
 VOID 
 InitSlide (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC 
 NODE 
 Child (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN NODE q, 
   IN UINT8 c
   );
@@ -98,6 +110,7 @@ Child (
 STATIC 
 VOID 
 MakeChild (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN NODE q, 
   IN UINT8 c, 
   IN NODE r
@@ -106,37 +119,69 @@ MakeChild (
 STATIC 
 VOID 
 Split (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN NODE Old
   );
 
 STATIC 
 VOID 
 InsertNode (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
   
 STATIC 
 VOID 
 DeleteNode (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC 
 VOID 
 GetNextMatch (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  );
+
+STATIC
+VOID
+SkipNextMatch (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  );
+
+STATIC
+VOID
+AdvancePosition (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  );
+
+STATIC
+VOID
+InitHashChain (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  );
+
+STATIC
+VOID
+ChainInsertNode (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
+  IN BOOLEAN FindMatch
   );
   
 STATIC 
-EFI_STATUS 
+VOID 
 Encode (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC 
 VOID 
 CountTFreq (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC 
 VOID 
 WritePTLen (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 n, 
   IN INT32 nbit, 
   IN INT32 Special
@@ -145,28 +190,33 @@ WritePTLen (
 STATIC 
 VOID 
 WriteCLen (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
   
 STATIC 
 VOID 
 EncodeC (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 c
   );
 
 STATIC 
 VOID 
 EncodeP (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 p
   );
 
 STATIC 
 VOID 
 SendBlock (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
   
 STATIC 
 VOID 
 Output (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 c, 
   IN UINT32 p
   );
@@ -174,21 +224,25 @@ Output (
 STATIC 
 VOID 
 HufEncodeStart (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
   
 STATIC 
 VOID 
 HufEncodeEnd (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
   
 STATIC 
 VOID 
 MakeCrcTable (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
   
 STATIC 
 VOID 
 PutBits (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 n, 
   IN UINT32 x
   );
@@ -196,6 +250,7 @@ PutBits (
 STATIC 
 INT32 
 FreadCrc (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   OUT UINT8 *p, 
   IN  INT32 n
   );
@@ -203,29 +258,34 @@ FreadCrc (
 STATIC 
 VOID 
 InitPutBits (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
   );
   
 STATIC 
 VOID 
 CountLen (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 i
   );
 
 STATIC 
 VOID 
 MakeLen (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Root
   );
   
 STATIC 
 VOID 
 DownHeap (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 i
   );
 
 STATIC 
 VOID 
 MakeCode (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN  INT32 n, 
   IN  UINT8 Len[], 
   OUT UINT16 Code[]
@@ -234,6 +294,7 @@ MakeCode (
 STATIC 
 INT32 
 MakeTree (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN  INT32   NParm, 
   IN  UINT16  FreqParm[], 
   OUT UINT8   LenParm[], 
@@ -242,43 +303,245 @@ MakeTree (
 
 
 //
-//  Global Variables
+// Compression context. Everything the encoder used to keep in file scope
+// globals lives here, so independent contexts may run concurrently.
 //
+struct _EFI_COMPRESS_CONTEXT {
+  UINT8   *mSrc;
+  UINT8   *mDst;
+  UINT8   *mSrcUpperLimit;
+  UINT8   *mDstUpperLimit;
+
+  UINT8   *mLevel;
+  UINT8   *mText;
+  UINT8   *mChildCount;
+  UINT8   *mBuf;
+  UINT8   mCLen[NC];
+  UINT8   mPTLen[NPT];
+  UINT8   *mLen;
+  INT16   mHeap[NC + 1];
+  INT32   mRemainder;
+  INT32   mMatchLen;
+  INT32   mBitCount;
+  INT32   mHeapSize;
+  INT32   mN;
+  INT32   mDepth;
+  UINT32  mBufSiz;
+  UINT32  mOutputPos;
+  UINT32  mOutputMask;
+  UINT32  mSubBitBuf;
+  UINT32  mCrc;
+  UINT32  mCPos;
+  UINT32  mCompSize;
+  UINT32  mOrigSize;
+
+  UINT16  *mFreq;
+  UINT16  *mSortPtr;
+  UINT16  mLenCnt[17];
+  UINT16  mLeft[2 * NC - 1];
+  UINT16  mRight[2 * NC - 1];
+  UINT16  mCrcTable[UINT8_MAX + 1];
+  UINT16  mCFreq[2 * NC - 1];
+  UINT16  mCCode[NC];
+  UINT16  mPFreq[2 * NP - 1];
+  UINT16  mPTCode[NPT];
+  UINT16  mTFreq[2 * NT - 1];
+
+  NODE    mPos;
+  NODE    mMatchPos;
+  NODE    mAvail;
+  NODE    *mPosition;
+  NODE    *mParent;
+  NODE    *mPrev;
+  NODE    *mNext;
+
+  UINT32  mChainDepth;
+  INT32   mNiceMatch;
+  NODE    *mHashHead;
+  NODE    *mHashPrev;
+};
 
-STATIC UINT8  *mSrc, *mDst, *mSrcUpperLimit, *mDstUpperLimit;
+//
+// Match finder settings for each compression level. A chain depth of 0
+// selects the original binary tree search; otherwise hash chains are
+// searched for at most ChainDepth candidates, and the search stops as
+// soon as a match of NiceMatch bytes is found.
+//
+typedef struct {
+  UINT32  ChainDepth;
+  INT32   NiceMatch;
+} COMPRESS_LEVEL_SETTING;
+
+STATIC CONST COMPRESS_LEVEL_SETTING mLevelSetting[COMPRESS_LEVEL_MAX] = {
+  {    4,    8 },
+  {    8,   16 },
+  {   12,   32 },
+  {   16,   64 },
+  {   24,  128 },
+  {   32,  256 },
+  {   48,  256 },
+  {   64,  256 },
+  {    0,    0 }
+};
 
-STATIC UINT8  *mLevel, *mText, *mChildCount, *mBuf, mCLen[NC], mPTLen[NPT], *mLen;
-STATIC INT16  mHeap[NC + 1];
-STATIC INT32  mRemainder, mMatchLen, mBitCount, mHeapSize, mN;
-STATIC UINT32 mBufSiz = 0, mOutputPos, mOutputMask, mSubBitBuf, mCrc;
-STATIC UINT32 mCompSize, mOrigSize;
+//
+// functions
+//
 
-STATIC UINT16 *mFreq, *mSortPtr, mLenCnt[17], mLeft[2 * NC - 1], mRight[2 * NC - 1],
-              mCrcTable[UINT8_MAX + 1], mCFreq[2 * NC - 1],mCCode[NC],
-              mPFreq[2 * NP - 1], mPTCode[NPT], mTFreq[2 * NT - 1];
+EFI_STATUS
+EfiCompressCreateContext (
+  OUT EFI_COMPRESS_CONTEXT  **Context
+  )
+/*++
 
-STATIC NODE   mPos, mMatchPos, mAvail, *mPosition, *mParent, *mPrev, *mNext = NULL;
+Routine Description:
 
+  Allocate a EFI compression context together with the sliding window
+  and tree buffers it needs. The context can be used for any number of
+  EfiCompressWithContext() calls, but only by one thread at a time.
 
-//
-// functions
-//
+Arguments:
+
+  Context     - On output, the newly created context.
+
+Returns:
+
+  EFI_SUCCESS           - The context was created.
+  EFI_OUT_OF_RESOURCES  - No resource to complete function.
+  EFI_INVALID_PARAMETER - Context is NULL.
+
+--*/
+{
+  EFI_COMPRESS_CONTEXT  *Ctx;
+  EFI_STATUS            Status;
+
+  if (Context == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Context = NULL;
+  Ctx      = calloc (1, sizeof (EFI_COMPRESS_CONTEXT));
+  if (Ctx == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = AllocateMemory (Ctx);
+  if (EFI_ERROR (Status)) {
+    FreeMemory (Ctx);
+    free (Ctx);
+    return Status;
+  }
+
+  MakeCrcTable (Ctx);
+
+  *Context = Ctx;
+  return EFI_SUCCESS;
+}
+
+VOID
+EfiCompressDestroyContext (
+  IN EFI_COMPRESS_CONTEXT  *Context
+  )
+/*++
+
+Routine Description:
+
+  Free a context created by EfiCompressCreateContext().
+
+Arguments:
+
+  Context     - The context to free. NULL is ignored.
+
+Returns: (VOID)
+
+--*/
+{
+  if (Context == NULL) {
+    return ;
+  }
+
+  FreeMemory (Context);
+  free (Context);
+}
 
 EFI_STATUS
-EfiCompress (
-  IN      UINT8   *SrcBuffer,
-  IN      UINT32  SrcSize,
-  IN      UINT8   *DstBuffer,
-  IN OUT  UINT32  *DstSize
+EfiCompressSetLevel (
+  IN EFI_COMPRESS_CONTEXT  *Context,
+  IN UINT32               Level
   )
 /*++
 
 Routine Description:
 
-  The main compression routine.
+  Select the speed/ratio trade-off used by later EfiCompressWithContext()
+  calls. COMPRESS_LEVEL_MAX (the default) keeps the original match finder
+  and its exact output; lower levels search hash chains of bounded depth,
+  which is faster at the cost of a somewhat larger output. Any level
+  produces a stream that the standard decompressor accepts.
 
 Arguments:
 
+  Context     - The context from EfiCompressCreateContext()
+  Level       - COMPRESS_LEVEL_MIN (fastest) to COMPRESS_LEVEL_MAX (smallest)
+
+Returns:
+
+  EFI_SUCCESS           - The level was set.
+  EFI_OUT_OF_RESOURCES  - No resource for the hash chain tables.
+  EFI_INVALID_PARAMETER - Context is NULL or Level is out of range.
+
+--*/
+{
+  CONST COMPRESS_LEVEL_SETTING  *Setting;
+
+  if (Context == NULL || Level < COMPRESS_LEVEL_MIN || Level > COMPRESS_LEVEL_MAX) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Setting = &mLevelSetting[Level - 1];
+  if (Setting->ChainDepth != 0 && Context->mHashHead == NULL) {
+    Context->mHashHead = malloc (CHAIN_HASH_SIZE * sizeof (*Context->mHashHead));
+    Context->mHashPrev = malloc (WNDSIZ * sizeof (*Context->mHashPrev));
+    if (Context->mHashHead == NULL || Context->mHashPrev == NULL) {
+      if (Context->mHashHead != NULL) {
+        free (Context->mHashHead);
+      }
+
+      if (Context->mHashPrev != NULL) {
+        free (Context->mHashPrev);
+      }
+
+      Context->mHashHead = NULL;
+      Context->mHashPrev = NULL;
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  Context->mChainDepth = Setting->ChainDepth;
+  Context->mNiceMatch  = Setting->NiceMatch;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EfiCompressWithContext (
+  IN      EFI_COMPRESS_CONTEXT  *Context,
+  IN      UINT8                 *SrcBuffer,
+  IN      UINT32                SrcSize,
+  IN      UINT8                 *DstBuffer,
+  IN OUT  UINT32                *DstSize
+  )
+/*++
+
+Routine Description:
+
+  EFI compression using caller supplied state. At the default level the
+  output is identical to EfiCompress(); contexts are independent, so different
+  threads may compress at the same time as long as each one uses its own
+  context.
+
+Arguments:
+
+  Context     - The context from EfiCompressCreateContext()
   SrcBuffer   - The buffer storing the source data
   SrcSize     - The size of source data
   DstBuffer   - The buffer to store the compressed data
@@ -290,78 +553,111 @@ Returns:
   EFI_BUFFER_TOO_SMALL  - The DstBuffer is too small. In this case,
                 DstSize contains the size needed.
   EFI_SUCCESS           - Compression is successful.
+  EFI_INVALID_PARAMETER - Parameter supplied is wrong.
 
 --*/
 {
-  EFI_STATUS Status = EFI_SUCCESS;
-  
+  EFI_COMPRESS_CONTEXT  *Ctx;
+
+  if (Context == NULL || DstSize == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
   //
   // Initializations
   //
-  mBufSiz = 0;
-  mBuf = NULL;
-  mText       = NULL;
-  mLevel      = NULL;
-  mChildCount = NULL;
-  mPosition   = NULL;
-  mParent     = NULL;
-  mPrev       = NULL;
-  mNext       = NULL;
+  Ctx                 = Context;
+  Ctx->mSrc           = SrcBuffer;
+  Ctx->mSrcUpperLimit = Ctx->mSrc + SrcSize;
+  Ctx->mDst           = DstBuffer;
+  Ctx->mDstUpperLimit = Ctx->mDst +*DstSize;
 
-  
-  mSrc = SrcBuffer;
-  mSrcUpperLimit = mSrc + SrcSize;
-  mDst = DstBuffer;
-  mDstUpperLimit = mDst + *DstSize;
+  PutDword (Ctx, 0L);
+  PutDword (Ctx, 0L);
 
-  PutDword(0L);
-  PutDword(0L);
-  
-  MakeCrcTable ();
+  Ctx->mOrigSize      = Ctx->mCompSize = 0;
+  Ctx->mCrc           = INIT_CRC;
 
-  mOrigSize = mCompSize = 0;
-  mCrc = INIT_CRC;
-  
   //
   // Compress it
   //
-  
-  Status = Encode();
-  if (EFI_ERROR (Status)) {
-    return EFI_OUT_OF_RESOURCES;
-  }
-  
+  Encode (Ctx);
+
   //
   // Null terminate the compressed data
   //
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = 0;
+  if (Ctx->mDst < Ctx->mDstUpperLimit) {
+    *Ctx->mDst++ = 0;
   }
-  
   //
   // Fill in compressed size and original size
   //
-  mDst = DstBuffer;
-  PutDword(mCompSize+1);
-  PutDword(mOrigSize);
+  Ctx->mDst = DstBuffer;
+  PutDword (Ctx, Ctx->mCompSize + 1);
+  PutDword (Ctx, Ctx->mOrigSize);
 
   //
   // Return
   //
-  
-  if (mCompSize + 1 + 8 > *DstSize) {
-    *DstSize = mCompSize + 1 + 8;
+  if (Ctx->mCompSize + 1 + 8 > *DstSize) {
+    *DstSize = Ctx->mCompSize + 1 + 8;
     return EFI_BUFFER_TOO_SMALL;
   } else {
-    *DstSize = mCompSize + 1 + 8;
+    *DstSize = Ctx->mCompSize + 1 + 8;
     return EFI_SUCCESS;
   }
 
 }
 
+EFI_STATUS
+EfiCompress (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN OUT  UINT32  *DstSize
+  )
+/*++
+
+Routine Description:
+
+  The main compression routine.
+
+Arguments:
+
+  SrcBuffer   - The buffer storing the source data
+  SrcSize     - The size of source data
+  DstBuffer   - The buffer to store the compressed data
+  DstSize     - On input, the size of DstBuffer; On output,
+                the size of the actual compressed data.
+
+Returns:
+
+  EFI_BUFFER_TOO_SMALL  - The DstBuffer is too small. In this case,
+                DstSize contains the size needed.
+  EFI_SUCCESS           - Compression is successful.
+  EFI_OUT_OF_RESOURCES  - No resource to complete function.
+  EFI_INVALID_PARAMETER - Parameter supplied is wrong.
+
+--*/
+{
+  EFI_COMPRESS_CONTEXT  *Ctx;
+  EFI_STATUS            Status;
+
+  Status = EfiCompressCreateContext (&Ctx);
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = EfiCompressWithContext (Ctx, SrcBuffer, SrcSize, DstBuffer, DstSize);
+  EfiCompressDestroyContext (Ctx);
+
+  return Status;
+}
+
 STATIC 
 VOID 
-PutDword(
+PutDword (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 Data
   )
 /*++
@@ -372,39 +668,44 @@ Routine Description:
   
 Arguments:
 
+  Ctx     - the compression context
   Data    - the dword to put
   
 Returns: (VOID)
   
 --*/
 {
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8)(((UINT8)(Data        )) & 0xff);
+  if (Ctx->mDst < Ctx->mDstUpperLimit) {
+    *Ctx->mDst++ = (UINT8)(((UINT8)(Data        )) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8)(((UINT8)(Data >> 0x08)) & 0xff);
+  if (Ctx->mDst < Ctx->mDstUpperLimit) {
+    *Ctx->mDst++ = (UINT8)(((UINT8)(Data >> 0x08)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8)(((UINT8)(Data >> 0x10)) & 0xff);
+  if (Ctx->mDst < Ctx->mDstUpperLimit) {
+    *Ctx->mDst++ = (UINT8)(((UINT8)(Data >> 0x10)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8)(((UINT8)(Data >> 0x18)) & 0xff);
+  if (Ctx->mDst < Ctx->mDstUpperLimit) {
+    *Ctx->mDst++ = (UINT8)(((UINT8)(Data >> 0x18)) & 0xff);
   }
 }
 
 STATIC
 EFI_STATUS
-AllocateMemory ()
+AllocateMemory (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 /*++
 
 Routine Description:
 
   Allocate memory spaces for data structures used in compression process
   
-Argements: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns:
 
@@ -413,92 +714,108 @@ Returns:
 
 --*/
 {
-  UINT32      i;
-  
-  mText       = malloc (WNDSIZ * 2 + MAXMATCH);
-  for (i = 0 ; i < WNDSIZ * 2 + MAXMATCH; i ++) {
-    mText[i] = 0;
+  Ctx->mText       = malloc (WNDSIZ * 2 + MAXMATCH);
+  Ctx->mLevel      = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*Ctx->mLevel));
+  Ctx->mChildCount = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*Ctx->mChildCount));
+  Ctx->mPosition   = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*Ctx->mPosition));
+  Ctx->mParent     = malloc (WNDSIZ * 2 * sizeof(*Ctx->mParent));
+  Ctx->mPrev       = malloc (WNDSIZ * 2 * sizeof(*Ctx->mPrev));
+  Ctx->mNext       = malloc ((MAX_HASH_VAL + 1) * sizeof(*Ctx->mNext));
+
+  if (Ctx->mText == NULL || Ctx->mLevel == NULL || Ctx->mChildCount == NULL ||
+      Ctx->mPosition == NULL || Ctx->mParent == NULL || Ctx->mPrev == NULL ||
+      Ctx->mNext == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
-
-  mLevel      = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*mLevel));
-  mChildCount = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*mChildCount));
-  mPosition   = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof(*mPosition));
-  mParent     = malloc (WNDSIZ * 2 * sizeof(*mParent));
-  mPrev       = malloc (WNDSIZ * 2 * sizeof(*mPrev));
-  mNext       = malloc ((MAX_HASH_VAL + 1) * sizeof(*mNext));
   
-  mBufSiz = 16 * 1024U;
-  while ((mBuf = malloc(mBufSiz)) == NULL) {
-    mBufSiz = (mBufSiz / 10U) * 9U;
-    if (mBufSiz < 4 * 1024U) {
+  Ctx->mBufSiz = 16 * 1024U;
+  while ((Ctx->mBuf = malloc(Ctx->mBufSiz)) == NULL) {
+    Ctx->mBufSiz = (Ctx->mBufSiz / 10U) * 9U;
+    if (Ctx->mBufSiz < 4 * 1024U) {
       return EFI_OUT_OF_RESOURCES;
     }
   }
-  mBuf[0] = 0;
+  Ctx->mBuf[0] = 0;
   
   return EFI_SUCCESS;
 }
 
 VOID
-FreeMemory ()
+FreeMemory (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 /*++
 
 Routine Description:
 
   Called when compression is completed to free memory previously allocated.
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
 --*/
 {
-  if (mText) {
-    free (mText);
+  if (Ctx->mText) {
+    free (Ctx->mText);
   }
   
-  if (mLevel) {
-    free (mLevel);
+  if (Ctx->mLevel) {
+    free (Ctx->mLevel);
   }
   
-  if (mChildCount) {
-    free (mChildCount);
+  if (Ctx->mChildCount) {
+    free (Ctx->mChildCount);
   }
   
-  if (mPosition) {
-    free (mPosition);
+  if (Ctx->mPosition) {
+    free (Ctx->mPosition);
   }
   
-  if (mParent) {
-    free (mParent);
+  if (Ctx->mParent) {
+    free (Ctx->mParent);
   }
   
-  if (mPrev) {
-    free (mPrev);
+  if (Ctx->mPrev) {
+    free (Ctx->mPrev);
   }
   
-  if (mNext) {
-    free (mNext);
+  if (Ctx->mNext) {
+    free (Ctx->mNext);
   }
   
-  if (mBuf) {
-    free (mBuf);
+  if (Ctx->mBuf) {
+    free (Ctx->mBuf);
   }  
 
+  if (Ctx->mHashHead) {
+    free (Ctx->mHashHead);
+  }
+
+  if (Ctx->mHashPrev) {
+    free (Ctx->mHashPrev);
+  }
+
   return;
 }
 
 
 STATIC 
 VOID 
-InitSlide ()
+InitSlide (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 /*++
 
 Routine Description:
 
   Initialize String Info Log data structures
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
@@ -507,20 +824,20 @@ Returns: (VOID)
   NODE i;
 
   for (i = WNDSIZ; i <= WNDSIZ + UINT8_MAX; i++) {
-    mLevel[i] = 1;
-    mPosition[i] = NIL;  /* sentinel */
+    Ctx->mLevel[i] = 1;
+    Ctx->mPosition[i] = NIL;  /* sentinel */
   }
   for (i = WNDSIZ; i < WNDSIZ * 2; i++) {
-    mParent[i] = NIL;
+    Ctx->mParent[i] = NIL;
   }  
-  mAvail = 1;
+  Ctx->mAvail = 1;
   for (i = 1; i < WNDSIZ - 1; i++) {
-    mNext[i] = (NODE)(i + 1);
+    Ctx->mNext[i] = (NODE)(i + 1);
   }
   
-  mNext[WNDSIZ - 1] = NIL;
+  Ctx->mNext[WNDSIZ - 1] = NIL;
   for (i = WNDSIZ * 2; i <= MAX_HASH_VAL; i++) {
-    mNext[i] = NIL;
+    Ctx->mNext[i] = NIL;
   }  
 }
 
@@ -528,6 +845,7 @@ Returns: (VOID)
 STATIC 
 NODE 
 Child (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN NODE q, 
   IN UINT8 c
   )
@@ -539,6 +857,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx     - the compression context
   q       - the parent node
   c       - the edge character
   
@@ -550,10 +869,10 @@ Returns:
 {
   NODE r;
   
-  r = mNext[HASH(q, c)];
-  mParent[NIL] = q;  /* sentinel */
-  while (mParent[r] != q) {
-    r = mNext[r];
+  r = Ctx->mNext[HASH(q, c)];
+  Ctx->mParent[NIL] = q;  /* sentinel */
+  while (Ctx->mParent[r] != q) {
+    r = Ctx->mNext[r];
   }
   
   return r;
@@ -562,6 +881,7 @@ Returns:
 STATIC 
 VOID 
 MakeChild (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN NODE q, 
   IN UINT8 c, 
   IN NODE r
@@ -574,6 +894,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx     - the compression context
   q       - the parent node
   c       - the edge character
   r       - the child node
@@ -585,18 +906,19 @@ Returns: (VOID)
   NODE h, t;
   
   h = (NODE)HASH(q, c);
-  t = mNext[h];
-  mNext[h] = r;
-  mNext[r] = t;
-  mPrev[t] = r;
-  mPrev[r] = h;
-  mParent[r] = q;
-  mChildCount[q]++;
+  t = Ctx->mNext[h];
+  Ctx->mNext[h] = r;
+  Ctx->mNext[r] = t;
+  Ctx->mPrev[t] = r;
+  Ctx->mPrev[r] = h;
+  Ctx->mParent[r] = q;
+  Ctx->mChildCount[q]++;
 }
 
 STATIC 
 VOID 
 Split (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   NODE Old
   )
 /*++
@@ -607,6 +929,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx     - the compression context
   Old     - the node to split
   
 Returns: (VOID)
@@ -615,32 +938,36 @@ Returns: (VOID)
 {
   NODE New, t;
 
-  New = mAvail;
-  mAvail = mNext[New];
-  mChildCount[New] = 0;
-  t = mPrev[Old];
-  mPrev[New] = t;
-  mNext[t] = New;
-  t = mNext[Old];
-  mNext[New] = t;
-  mPrev[t] = New;
-  mParent[New] = mParent[Old];
-  mLevel[New] = (UINT8)mMatchLen;
-  mPosition[New] = mPos;
-  MakeChild(New, mText[mMatchPos + mMatchLen], Old);
-  MakeChild(New, mText[mPos + mMatchLen], mPos);
+  New = Ctx->mAvail;
+  Ctx->mAvail = Ctx->mNext[New];
+  Ctx->mChildCount[New] = 0;
+  t = Ctx->mPrev[Old];
+  Ctx->mPrev[New] = t;
+  Ctx->mNext[t] = New;
+  t = Ctx->mNext[Old];
+  Ctx->mNext[New] = t;
+  Ctx->mPrev[t] = New;
+  Ctx->mParent[New] = Ctx->mParent[Old];
+  Ctx->mLevel[New] = (UINT8)Ctx->mMatchLen;
+  Ctx->mPosition[New] = Ctx->mPos;
+  MakeChild(Ctx, New, Ctx->mText[Ctx->mMatchPos + Ctx->mMatchLen], Old);
+  MakeChild(Ctx, New, Ctx->mText[Ctx->mPos + Ctx->mMatchLen], Ctx->mPos);
 }
 
 STATIC 
 VOID 
-InsertNode ()
+InsertNode (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 /*++
 
 Routine Description:
 
   Insert string info for current position into the String Info Log
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
@@ -649,31 +976,31 @@ Returns: (VOID)
   NODE q, r, j, t;
   UINT8 c, *t1, *t2;
 
-  if (mMatchLen >= 4) {
+  if (Ctx->mMatchLen >= 4) {
     
     //
     // We have just got a long match, the target tree
     // can be located by MatchPos + 1. Travese the tree
     // from bottom up to get to a proper starting point.
     // The usage of PERC_FLAG ensures proper node deletion
-    // in DeleteNode() later.
+    // in DeleteNode(Ctx) later.
     //
     
-    mMatchLen--;
-    r = (INT16)((mMatchPos + 1) | WNDSIZ);
-    while ((q = mParent[r]) == NIL) {
-      r = mNext[r];
+    Ctx->mMatchLen--;
+    r = (INT16)((Ctx->mMatchPos + 1) | WNDSIZ);
+    while ((q = Ctx->mParent[r]) == NIL) {
+      r = Ctx->mNext[r];
     }
-    while (mLevel[q] >= mMatchLen) {
-      r = q;  q = mParent[q];
+    while (Ctx->mLevel[q] >= Ctx->mMatchLen) {
+      r = q;  q = Ctx->mParent[q];
     }
     t = q;
-    while (mPosition[t] < 0) {
-      mPosition[t] = mPos;
-      t = mParent[t];
+    while (Ctx->mPosition[t] < 0) {
+      Ctx->mPosition[t] = Ctx->mPos;
+      t = Ctx->mParent[t];
     }
     if (t < WNDSIZ) {
-      mPosition[t] = (NODE)(mPos | PERC_FLAG);
+      Ctx->mPosition[t] = (NODE)(Ctx->mPos | PERC_FLAG);
     }    
   } else {
     
@@ -681,14 +1008,14 @@ Returns: (VOID)
     // Locate the target tree
     //
     
-    q = (INT16)(mText[mPos] + WNDSIZ);
-    c = mText[mPos + 1];
-    if ((r = Child(q, c)) == NIL) {
-      MakeChild(q, c, mPos);
-      mMatchLen = 1;
+    q = (INT16)(Ctx->mText[Ctx->mPos] + WNDSIZ);
+    c = Ctx->mText[Ctx->mPos + 1];
+    if ((r = Child(Ctx, q, c)) == NIL) {
+      MakeChild(Ctx, q, c, Ctx->mPos);
+      Ctx->mMatchLen = 1;
       return;
     }
-    mMatchLen = 2;
+    Ctx->mMatchLen = 2;
   }
   
   //
@@ -700,55 +1027,57 @@ Returns: (VOID)
   for ( ; ; ) {
     if (r >= WNDSIZ) {
       j = MAXMATCH;
-      mMatchPos = r;
+      Ctx->mMatchPos = r;
     } else {
-      j = mLevel[r];
-      mMatchPos = (NODE)(mPosition[r] & ~PERC_FLAG);
+      j = Ctx->mLevel[r];
+      Ctx->mMatchPos = (NODE)(Ctx->mPosition[r] & ~PERC_FLAG);
     }
-    if (mMatchPos >= mPos) {
-      mMatchPos -= WNDSIZ;
+    if (Ctx->mMatchPos >= Ctx->mPos) {
+      Ctx->mMatchPos -= WNDSIZ;
     }    
-    t1 = &mText[mPos + mMatchLen];
-    t2 = &mText[mMatchPos + mMatchLen];
-    while (mMatchLen < j) {
+    t1 = &Ctx->mText[Ctx->mPos + Ctx->mMatchLen];
+    t2 = &Ctx->mText[Ctx->mMatchPos + Ctx->mMatchLen];
+    while (Ctx->mMatchLen < j) {
       if (*t1 != *t2) {
-        Split(r);
+        Split(Ctx, r);
         return;
       }
-      mMatchLen++;
+      Ctx->mMatchLen++;
       t1++;
       t2++;
     }
-    if (mMatchLen >= MAXMATCH) {
+    if (Ctx->mMatchLen >= MAXMATCH) {
       break;
     }
-    mPosition[r] = mPos;
+    Ctx->mPosition[r] = Ctx->mPos;
     q = r;
-    if ((r = Child(q, *t1)) == NIL) {
-      MakeChild(q, *t1, mPos);
+    if ((r = Child(Ctx, q, *t1)) == NIL) {
+      MakeChild(Ctx, q, *t1, Ctx->mPos);
       return;
     }
-    mMatchLen++;
+    Ctx->mMatchLen++;
   }
-  t = mPrev[r];
-  mPrev[mPos] = t;
-  mNext[t] = mPos;
-  t = mNext[r];
-  mNext[mPos] = t;
-  mPrev[t] = mPos;
-  mParent[mPos] = q;
-  mParent[r] = NIL;
+  t = Ctx->mPrev[r];
+  Ctx->mPrev[Ctx->mPos] = t;
+  Ctx->mNext[t] = Ctx->mPos;
+  t = Ctx->mNext[r];
+  Ctx->mNext[Ctx->mPos] = t;
+  Ctx->mPrev[t] = Ctx->mPos;
+  Ctx->mParent[Ctx->mPos] = q;
+  Ctx->mParent[r] = NIL;
   
   //
   // Special usage of 'next'
   //
-  mNext[r] = mPos;
+  Ctx->mNext[r] = Ctx->mPos;
   
 }
 
 STATIC 
 VOID 
-DeleteNode ()
+DeleteNode (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 /*++
 
 Routine Description:
@@ -756,7 +1085,9 @@ Routine Description:
   Delete outdated string info. (The Usage of PERC_FLAG
   ensures a clean deletion)
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
@@ -764,65 +1095,112 @@ Returns: (VOID)
 {
   NODE q, r, s, t, u;
 
-  if (mParent[mPos] == NIL) {
+  if (Ctx->mParent[Ctx->mPos] == NIL) {
     return;
   }
   
-  r = mPrev[mPos];
-  s = mNext[mPos];
-  mNext[r] = s;
-  mPrev[s] = r;
-  r = mParent[mPos];
-  mParent[mPos] = NIL;
-  if (r >= WNDSIZ || --mChildCount[r] > 1) {
+  r = Ctx->mPrev[Ctx->mPos];
+  s = Ctx->mNext[Ctx->mPos];
+  Ctx->mNext[r] = s;
+  Ctx->mPrev[s] = r;
+  r = Ctx->mParent[Ctx->mPos];
+  Ctx->mParent[Ctx->mPos] = NIL;
+  if (r >= WNDSIZ || --Ctx->mChildCount[r] > 1) {
     return;
   }
-  t = (NODE)(mPosition[r] & ~PERC_FLAG);
-  if (t >= mPos) {
+  t = (NODE)(Ctx->mPosition[r] & ~PERC_FLAG);
+  if (t >= Ctx->mPos) {
     t -= WNDSIZ;
   }
   s = t;
-  q = mParent[r];
-  while ((u = mPosition[q]) & PERC_FLAG) {
+  q = Ctx->mParent[r];
+  while ((u = Ctx->mPosition[q]) & PERC_FLAG) {
     u &= ~PERC_FLAG;
-    if (u >= mPos) {
+    if (u >= Ctx->mPos) {
       u -= WNDSIZ;
     }
     if (u > s) {
       s = u;
     }
-    mPosition[q] = (INT16)(s | WNDSIZ);
-    q = mParent[q];
+    Ctx->mPosition[q] = (INT16)(s | WNDSIZ);
+    q = Ctx->mParent[q];
   }
   if (q < WNDSIZ) {
-    if (u >= mPos) {
+    if (u >= Ctx->mPos) {
       u -= WNDSIZ;
     }
     if (u > s) {
       s = u;
     }
-    mPosition[q] = (INT16)(s | WNDSIZ | PERC_FLAG);
-  }
-  s = Child(r, mText[t + mLevel[r]]);
-  t = mPrev[s];
-  u = mNext[s];
-  mNext[t] = u;
-  mPrev[u] = t;
-  t = mPrev[r];
-  mNext[t] = s;
-  mPrev[s] = t;
-  t = mNext[r];
-  mPrev[t] = s;
-  mNext[s] = t;
-  mParent[s] = mParent[r];
-  mParent[r] = NIL;
-  mNext[r] = mAvail;
-  mAvail = r;
+    Ctx->mPosition[q] = (INT16)(s | WNDSIZ | PERC_FLAG);
+  }
+  s = Child(Ctx, r, Ctx->mText[t + Ctx->mLevel[r]]);
+  t = Ctx->mPrev[s];
+  u = Ctx->mNext[s];
+  Ctx->mNext[t] = u;
+  Ctx->mPrev[u] = t;
+  t = Ctx->mPrev[r];
+  Ctx->mNext[t] = s;
+  Ctx->mPrev[s] = t;
+  t = Ctx->mNext[r];
+  Ctx->mPrev[t] = s;
+  Ctx->mNext[s] = t;
+  Ctx->mParent[s] = Ctx->mParent[r];
+  Ctx->mParent[r] = NIL;
+  Ctx->mNext[r] = Ctx->mAvail;
+  Ctx->mAvail = r;
 }
 
-STATIC 
-VOID 
-GetNextMatch ()
+STATIC
+VOID
+AdvancePosition (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
+/*++
+
+Routine Description:
+
+  Advance the current position, sliding the window and reading in new
+  data when the end of the text buffer is reached.
+
+Arguments:
+
+  Ctx     - the compression context
+
+Returns: (VOID)
+
+--*/
+{
+  INT32   n;
+  UINT32  Index;
+
+  Ctx->mRemainder--;
+  if (++Ctx->mPos == WNDSIZ * 2) {
+    memmove(&Ctx->mText[0], &Ctx->mText[WNDSIZ], WNDSIZ + MAXMATCH);
+    n = FreadCrc(Ctx, &Ctx->mText[WNDSIZ + MAXMATCH], WNDSIZ);
+    Ctx->mRemainder += n;
+    Ctx->mPos = WNDSIZ;
+    if (Ctx->mChainDepth != 0) {
+      //
+      // Rebase the hash chains along with the text; positions that fall
+      // out of the window become NIL.
+      //
+      for (Index = 0; Index < CHAIN_HASH_SIZE; Index++) {
+        Ctx->mHashHead[Index] = (NODE) (Ctx->mHashHead[Index] > (NODE) WNDSIZ ? Ctx->mHashHead[Index] - WNDSIZ : NIL);
+      }
+
+      for (Index = 0; Index < WNDSIZ; Index++) {
+        Ctx->mHashPrev[Index] = (NODE) (Ctx->mHashPrev[Index] > (NODE) WNDSIZ ? Ctx->mHashPrev[Index] - WNDSIZ : NIL);
+      }
+    }
+  }
+}
+
+STATIC
+VOID
+GetNextMatch (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 /*++
 
 Routine Description:
@@ -830,113 +1208,254 @@ Routine Description:
   Advance the current position (read in new data if needed).
   Delete outdated string info. Find a match string for current position.
 
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
 --*/
 {
-  INT32 n;
+  AdvancePosition (Ctx);
 
-  mRemainder--;
-  if (++mPos == WNDSIZ * 2) {
-    memmove(&mText[0], &mText[WNDSIZ], WNDSIZ + MAXMATCH);
-    n = FreadCrc(&mText[WNDSIZ + MAXMATCH], WNDSIZ);
-    mRemainder += n;
-    mPos = WNDSIZ;
+  if (Ctx->mChainDepth != 0) {
+    ChainInsertNode (Ctx, TRUE);
+    return ;
   }
-  DeleteNode();
-  InsertNode();
+
+  DeleteNode (Ctx);
+  InsertNode (Ctx);
 }
 
 STATIC
-EFI_STATUS
-Encode ()
+VOID
+SkipNextMatch (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 /*++
 
 Routine Description:
 
-  The main controlling routine for compression process.
+  Advance the current position inside a match that has already been
+  output. With hash chains the position only needs to be recorded, so the
+  match search is skipped; the binary tree always needs the full update.
 
-Arguments: (VOID)
+Arguments:
 
-Returns:
-  
-  EFI_SUCCESS           - The compression is successful
-  EFI_OUT_0F_RESOURCES  - Not enough memory for compression process
+  Ctx     - the compression context
+
+Returns: (VOID)
 
 --*/
 {
-  EFI_STATUS  Status;
-  INT32       LastMatchLen;
-  NODE        LastMatchPos;
+  if (Ctx->mChainDepth == 0) {
+    GetNextMatch (Ctx);
+    return ;
+  }
 
-  Status = AllocateMemory();
-  if (EFI_ERROR(Status)) {
-    FreeMemory();
-    return Status;
+  AdvancePosition (Ctx);
+  ChainInsertNode (Ctx, FALSE);
+}
+
+STATIC
+VOID
+InitHashChain (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
+/*++
+
+Routine Description:
+
+  Initialize the hash chain match finder
+
+Arguments:
+
+  Ctx     - the compression context
+
+Returns: (VOID)
+
+--*/
+{
+  memset (Ctx->mHashHead, 0, CHAIN_HASH_SIZE * sizeof (*Ctx->mHashHead));
+  memset (Ctx->mHashPrev, 0, WNDSIZ * sizeof (*Ctx->mHashPrev));
+}
+
+STATIC
+VOID
+ChainInsertNode (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
+  IN BOOLEAN FindMatch
+  )
+/*++
+
+Routine Description:
+
+  Link the current position into its hash chain and, if requested, walk
+  the chain for the longest match within the window. Ties go to the
+  closest candidate, which is visited first.
+
+Arguments:
+
+  Ctx       - the compression context
+  FindMatch - TRUE to search for a match for the current position
+
+Returns: (VOID)
+
+--*/
+{
+  UINT8   *Text;
+  UINT8   *Scan;
+  UINT32  HashValue;
+  UINT32  Depth;
+  INT32   Len;
+  NODE    Candidate;
+  NODE    Next;
+
+  Text      = &Ctx->mText[Ctx->mPos];
+  HashValue = CHAIN_HASH (Text);
+  Candidate = Ctx->mHashHead[HashValue];
+  Ctx->mHashPrev[Ctx->mPos & (WNDSIZ - 1)] = Candidate;
+  Ctx->mHashHead[HashValue] = Ctx->mPos;
+
+  if (!FindMatch) {
+    return ;
   }
 
-  InitSlide();
+  Ctx->mMatchLen = 0;
+  Depth          = Ctx->mChainDepth;
+  while (Candidate != NIL && Depth-- > 0) {
+    if ((UINT32) (Ctx->mPos - Candidate) >= WNDSIZ) {
+      break;
+    }
+
+    Scan = &Ctx->mText[Candidate];
+    if (Scan[Ctx->mMatchLen] == Text[Ctx->mMatchLen] && Scan[0] == Text[0]) {
+      Len = 0;
+      while (Len < MAXMATCH && Scan[Len] == Text[Len]) {
+        Len++;
+      }
+
+      if (Len > Ctx->mMatchLen) {
+        Ctx->mMatchLen = Len;
+        Ctx->mMatchPos = Candidate;
+        if (Len >= Ctx->mNiceMatch) {
+          break;
+        }
+      }
+    }
+
+    Next = Ctx->mHashPrev[Candidate & (WNDSIZ - 1)];
+    if (Next >= Candidate) {
+      break;
+    }
+
+    Candidate = Next;
+  }
+}
+
+STATIC
+VOID
+Encode (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
+/*++
+
+Routine Description:
+
+  The main controlling routine for compression process.
+
+Arguments:
+
+  Ctx     - the compression context
+
+Returns: (VOID)
+
+--*/
+{
+  INT32 LastMatchLen;
+  NODE  LastMatchPos;
+
+  //
+  // The buffers are reused across calls; clear the window so that the
+  // output does not depend on what a previous call left behind.
+  //
+  memset (Ctx->mText, 0, WNDSIZ * 2 + MAXMATCH);
+  Ctx->mBuf[0] = 0;
+
+  if (Ctx->mChainDepth != 0) {
+    InitHashChain (Ctx);
+  } else {
+    InitSlide (Ctx);
+  }
   
-  HufEncodeStart();
+  HufEncodeStart(Ctx);
 
-  mRemainder = FreadCrc(&mText[WNDSIZ], WNDSIZ + MAXMATCH);
+  Ctx->mRemainder = FreadCrc(Ctx, &Ctx->mText[WNDSIZ], WNDSIZ + MAXMATCH);
   
-  mMatchLen = 0;
-  mPos = WNDSIZ;
-  InsertNode();
-  if (mMatchLen > mRemainder) {
-    mMatchLen = mRemainder;
+  Ctx->mMatchLen = 0;
+  Ctx->mPos = WNDSIZ;
+  if (Ctx->mChainDepth != 0) {
+    ChainInsertNode (Ctx, TRUE);
+  } else {
+    InsertNode (Ctx);
   }
-  while (mRemainder > 0) {
-    LastMatchLen = mMatchLen;
-    LastMatchPos = mMatchPos;
-    GetNextMatch();
-    if (mMatchLen > mRemainder) {
-      mMatchLen = mRemainder;
+  if (Ctx->mMatchLen > Ctx->mRemainder) {
+    Ctx->mMatchLen = Ctx->mRemainder;
+  }
+  while (Ctx->mRemainder > 0) {
+    LastMatchLen = Ctx->mMatchLen;
+    LastMatchPos = Ctx->mMatchPos;
+    GetNextMatch(Ctx);
+    if (Ctx->mMatchLen > Ctx->mRemainder) {
+      Ctx->mMatchLen = Ctx->mRemainder;
     }
     
-    if (mMatchLen > LastMatchLen || LastMatchLen < THRESHOLD) {
+    if (Ctx->mMatchLen > LastMatchLen || LastMatchLen < THRESHOLD) {
       
       //
       // Not enough benefits are gained by outputting a pointer,
       // so just output the original character
       //
       
-      Output(mText[mPos - 1], 0);
+      Output(Ctx, Ctx->mText[Ctx->mPos - 1], 0);
     } else {
       
       //
       // Outputting a pointer is beneficial enough, do it.
       //
       
-      Output(LastMatchLen + (UINT8_MAX + 1 - THRESHOLD),
-             (mPos - LastMatchPos - 2) & (WNDSIZ - 1));
+      Output(Ctx, LastMatchLen + (UINT8_MAX + 1 - THRESHOLD),
+             (Ctx->mPos - LastMatchPos - 2) & (WNDSIZ - 1));
       while (--LastMatchLen > 0) {
-        GetNextMatch();
+        if (LastMatchLen > 1) {
+          SkipNextMatch (Ctx);
+        } else {
+          GetNextMatch (Ctx);
+        }
       }
-      if (mMatchLen > mRemainder) {
-        mMatchLen = mRemainder;
+      if (Ctx->mMatchLen > Ctx->mRemainder) {
+        Ctx->mMatchLen = Ctx->mRemainder;
       }
     }
   }
   
-  HufEncodeEnd();
-  FreeMemory();
-  return EFI_SUCCESS;
+  HufEncodeEnd(Ctx);
 }
 
 STATIC 
 VOID 
-CountTFreq ()
+CountTFreq (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 /*++
 
 Routine Description:
 
   Count the frequencies for the Extra Set
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
@@ -945,33 +1464,33 @@ Returns: (VOID)
   INT32 i, k, n, Count;
 
   for (i = 0; i < NT; i++) {
-    mTFreq[i] = 0;
+    Ctx->mTFreq[i] = 0;
   }
   n = NC;
-  while (n > 0 && mCLen[n - 1] == 0) {
+  while (n > 0 && Ctx->mCLen[n - 1] == 0) {
     n--;
   }
   i = 0;
   while (i < n) {
-    k = mCLen[i++];
+    k = Ctx->mCLen[i++];
     if (k == 0) {
       Count = 1;
-      while (i < n && mCLen[i] == 0) {
+      while (i < n && Ctx->mCLen[i] == 0) {
         i++;
         Count++;
       }
       if (Count <= 2) {
-        mTFreq[0] = (UINT16)(mTFreq[0] + Count);
+        Ctx->mTFreq[0] = (UINT16)(Ctx->mTFreq[0] + Count);
       } else if (Count <= 18) {
-        mTFreq[1]++;
+        Ctx->mTFreq[1]++;
       } else if (Count == 19) {
-        mTFreq[0]++;
-        mTFreq[1]++;
+        Ctx->mTFreq[0]++;
+        Ctx->mTFreq[1]++;
       } else {
-        mTFreq[2]++;
+        Ctx->mTFreq[2]++;
       }
     } else {
-      mTFreq[k + 2]++;
+      Ctx->mTFreq[k + 2]++;
     }
   }
 }
@@ -979,6 +1498,7 @@ Returns: (VOID)
 STATIC 
 VOID 
 WritePTLen (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 n, 
   IN INT32 nbit, 
   IN INT32 Special
@@ -991,6 +1511,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx     - the compression context
   n       - the number of symbols
   nbit    - the number of bits needed to represent 'n'
   Special - the special symbol that needs to be take care of
@@ -1001,37 +1522,41 @@ Returns: (VOID)
 {
   INT32 i, k;
 
-  while (n > 0 && mPTLen[n - 1] == 0) {
+  while (n > 0 && Ctx->mPTLen[n - 1] == 0) {
     n--;
   }
-  PutBits(nbit, n);
+  PutBits(Ctx, nbit, n);
   i = 0;
   while (i < n) {
-    k = mPTLen[i++];
+    k = Ctx->mPTLen[i++];
     if (k <= 6) {
-      PutBits(3, k);
+      PutBits(Ctx, 3, k);
     } else {
-      PutBits(k - 3, (1U << (k - 3)) - 2);
+      PutBits(Ctx, k - 3, (1U << (k - 3)) - 2);
     }
     if (i == Special) {
-      while (i < 6 && mPTLen[i] == 0) {
+      while (i < 6 && Ctx->mPTLen[i] == 0) {
         i++;
       }
-      PutBits(2, (i - 3) & 3);
+      PutBits(Ctx, 2, (i - 3) & 3);
     }
   }
 }
 
 STATIC 
 VOID 
-WriteCLen ()
+WriteCLen (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 /*++
 
 Routine Description:
 
   Outputs the code length array for Char&Length Set
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
@@ -1040,36 +1565,36 @@ Returns: (VOID)
   INT32 i, k, n, Count;
 
   n = NC;
-  while (n > 0 && mCLen[n - 1] == 0) {
+  while (n > 0 && Ctx->mCLen[n - 1] == 0) {
     n--;
   }
-  PutBits(CBIT, n);
+  PutBits(Ctx, CBIT, n);
   i = 0;
   while (i < n) {
-    k = mCLen[i++];
+    k = Ctx->mCLen[i++];
     if (k == 0) {
       Count = 1;
-      while (i < n && mCLen[i] == 0) {
+      while (i < n && Ctx->mCLen[i] == 0) {
         i++;
         Count++;
       }
       if (Count <= 2) {
         for (k = 0; k < Count; k++) {
-          PutBits(mPTLen[0], mPTCode[0]);
+          PutBits(Ctx, Ctx->mPTLen[0], Ctx->mPTCode[0]);
         }
       } else if (Count <= 18) {
-        PutBits(mPTLen[1], mPTCode[1]);
-        PutBits(4, Count - 3);
+        PutBits(Ctx, Ctx->mPTLen[1], Ctx->mPTCode[1]);
+        PutBits(Ctx, 4, Count - 3);
       } else if (Count == 19) {
-        PutBits(mPTLen[0], mPTCode[0]);
-        PutBits(mPTLen[1], mPTCode[1]);
-        PutBits(4, 15);
+        PutBits(Ctx, Ctx->mPTLen[0], Ctx->mPTCode[0]);
+        PutBits(Ctx, Ctx->mPTLen[1], Ctx->mPTCode[1]);
+        PutBits(Ctx, 4, 15);
       } else {
-        PutBits(mPTLen[2], mPTCode[2]);
-        PutBits(CBIT, Count - 20);
+        PutBits(Ctx, Ctx->mPTLen[2], Ctx->mPTCode[2]);
+        PutBits(Ctx, CBIT, Count - 20);
       }
     } else {
-      PutBits(mPTLen[k + 2], mPTCode[k + 2]);
+      PutBits(Ctx, Ctx->mPTLen[k + 2], Ctx->mPTCode[k + 2]);
     }
   }
 }
@@ -1077,15 +1602,17 @@ Returns: (VOID)
 STATIC 
 VOID 
 EncodeC (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 c
   )
 {
-  PutBits(mCLen[c], mCCode[c]);
+  PutBits(Ctx, Ctx->mCLen[c], Ctx->mCCode[c]);
 }
 
 STATIC 
 VOID 
 EncodeP (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 p
   )
 {
@@ -1097,22 +1624,26 @@ EncodeP (
     q >>= 1;
     c++;
   }
-  PutBits(mPTLen[c], mPTCode[c]);
+  PutBits(Ctx, Ctx->mPTLen[c], Ctx->mPTCode[c]);
   if (c > 1) {
-    PutBits(c - 1, p & (0xFFFFU >> (17 - c)));
+    PutBits(Ctx, c - 1, p & (0xFFFFU >> (17 - c)));
   }
 }
 
 STATIC 
 VOID 
-SendBlock ()
+SendBlock (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 /*++
 
 Routine Description:
 
   Huffman code the block and output it.
   
-Argument: (VOID)
+Arguments:
+
+  Ctx - the compression context
 
 Returns: (VOID)
 
@@ -1121,53 +1652,53 @@ Returns: (VOID)
   UINT32 i, k, Flags, Root, Pos, Size;
   Flags = 0;
 
-  Root = MakeTree(NC, mCFreq, mCLen, mCCode);
-  Size = mCFreq[Root];
-  PutBits(16, Size);
+  Root = MakeTree(Ctx, NC, Ctx->mCFreq, Ctx->mCLen, Ctx->mCCode);
+  Size = Ctx->mCFreq[Root];
+  PutBits(Ctx, 16, Size);
   if (Root >= NC) {
-    CountTFreq();
-    Root = MakeTree(NT, mTFreq, mPTLen, mPTCode);
+    CountTFreq(Ctx);
+    Root = MakeTree(Ctx, NT, Ctx->mTFreq, Ctx->mPTLen, Ctx->mPTCode);
     if (Root >= NT) {
-      WritePTLen(NT, TBIT, 3);
+      WritePTLen(Ctx, NT, TBIT, 3);
     } else {
-      PutBits(TBIT, 0);
-      PutBits(TBIT, Root);
+      PutBits(Ctx, TBIT, 0);
+      PutBits(Ctx, TBIT, Root);
     }
-    WriteCLen();
+    WriteCLen(Ctx);
   } else {
-    PutBits(TBIT, 0);
-    PutBits(TBIT, 0);
-    PutBits(CBIT, 0);
-    PutBits(CBIT, Root);
+    PutBits(Ctx, TBIT, 0);
+    PutBits(Ctx, TBIT, 0);
+    PutBits(Ctx, CBIT, 0);
+    PutBits(Ctx, CBIT, Root);
   }
-  Root = MakeTree(NP, mPFreq, mPTLen, mPTCode);
+  Root = MakeTree(Ctx, NP, Ctx->mPFreq, Ctx->mPTLen, Ctx->mPTCode);
   if (Root >= NP) {
-    WritePTLen(NP, PBIT, -1);
+    WritePTLen(Ctx, NP, PBIT, -1);
   } else {
-    PutBits(PBIT, 0);
-    PutBits(PBIT, Root);
+    PutBits(Ctx, PBIT, 0);
+    PutBits(Ctx, PBIT, Root);
   }
   Pos = 0;
   for (i = 0; i < Size; i++) {
     if (i % UINT8_BIT == 0) {
-      Flags = mBuf[Pos++];
+      Flags = Ctx->mBuf[Pos++];
     } else {
       Flags <<= 1;
     }
     if (Flags & (1U << (UINT8_BIT - 1))) {
-      EncodeC(mBuf[Pos++] + (1U << UINT8_BIT));
-      k = mBuf[Pos++] << UINT8_BIT;
-      k += mBuf[Pos++];
-      EncodeP(k);
+      EncodeC(Ctx, Ctx->mBuf[Pos++] + (1U << UINT8_BIT));
+      k = Ctx->mBuf[Pos++] << UINT8_BIT;
+      k += Ctx->mBuf[Pos++];
+      EncodeP(Ctx, k);
     } else {
-      EncodeC(mBuf[Pos++]);
+      EncodeC(Ctx, Ctx->mBuf[Pos++]);
     }
   }
   for (i = 0; i < NC; i++) {
-    mCFreq[i] = 0;
+    Ctx->mCFreq[i] = 0;
   }
   for (i = 0; i < NP; i++) {
-    mPFreq[i] = 0;
+    Ctx->mPFreq[i] = 0;
   }
 }
 
@@ -1175,6 +1706,7 @@ Returns: (VOID)
 STATIC 
 VOID 
 Output (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 c, 
   IN UINT32 p
   )
@@ -1186,6 +1718,7 @@ Routine Description:
 
 Arguments:
 
+  Ctx   - the compression context
   c     - The original character or the 'String Length' element of a Pointer
   p     - The 'Position' field of a Pointer
 
@@ -1193,59 +1726,61 @@ Returns: (VOID)
 
 --*/
 {
-  STATIC UINT32 CPos;
-
-  if ((mOutputMask >>= 1) == 0) {
-    mOutputMask = 1U << (UINT8_BIT - 1);
-    if (mOutputPos >= mBufSiz - 3 * UINT8_BIT) {
-      SendBlock();
-      mOutputPos = 0;
+  if ((Ctx->mOutputMask >>= 1) == 0) {
+    Ctx->mOutputMask = 1U << (UINT8_BIT - 1);
+    if (Ctx->mOutputPos >= Ctx->mBufSiz - 3 * UINT8_BIT) {
+      SendBlock(Ctx);
+      Ctx->mOutputPos = 0;
     }
-    CPos = mOutputPos++;  
-    mBuf[CPos] = 0;
+    Ctx->mCPos = Ctx->mOutputPos++;  
+    Ctx->mBuf[Ctx->mCPos] = 0;
   }
-  mBuf[mOutputPos++] = (UINT8) c;
-  mCFreq[c]++;
+  Ctx->mBuf[Ctx->mOutputPos++] = (UINT8) c;
+  Ctx->mCFreq[c]++;
   if (c >= (1U << UINT8_BIT)) {
-    mBuf[CPos] |= mOutputMask;
-    mBuf[mOutputPos++] = (UINT8)(p >> UINT8_BIT);
-    mBuf[mOutputPos++] = (UINT8) p;
+    Ctx->mBuf[Ctx->mCPos] |= Ctx->mOutputMask;
+    Ctx->mBuf[Ctx->mOutputPos++] = (UINT8)(p >> UINT8_BIT);
+    Ctx->mBuf[Ctx->mOutputPos++] = (UINT8) p;
     c = 0;
     while (p) {
       p >>= 1;
       c++;
     }
-    mPFreq[c]++;
+    Ctx->mPFreq[c]++;
   }
 }
 
 STATIC
 VOID
-HufEncodeStart ()
+HufEncodeStart (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 {
   INT32 i;
 
   for (i = 0; i < NC; i++) {
-    mCFreq[i] = 0;
+    Ctx->mCFreq[i] = 0;
   }
   for (i = 0; i < NP; i++) {
-    mPFreq[i] = 0;
+    Ctx->mPFreq[i] = 0;
   }
-  mOutputPos = mOutputMask = 0;
-  InitPutBits();
+  Ctx->mOutputPos = Ctx->mOutputMask = 0;
+  InitPutBits(Ctx);
   return;
 }
 
 STATIC 
 VOID 
-HufEncodeEnd ()
+HufEncodeEnd (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 {
-  SendBlock();
+  SendBlock(Ctx);
   
   //
   // Flush remaining bits
   //
-  PutBits(UINT8_BIT - 1, 0);
+  PutBits(Ctx, UINT8_BIT - 1, 0);
   
   return;
 }
@@ -1253,7 +1788,9 @@ HufEncodeEnd ()
 
 STATIC 
 VOID 
-MakeCrcTable ()
+MakeCrcTable (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 {
   UINT32 i, j, r;
 
@@ -1266,13 +1803,14 @@ MakeCrcTable ()
         r >>= 1;
       }
     }
-    mCrcTable[i] = (UINT16)r;    
+    Ctx->mCrcTable[i] = (UINT16)r;    
   }
 }
 
 STATIC 
 VOID 
 PutBits (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 n, 
   IN UINT32 x
   )
@@ -1284,6 +1822,7 @@ Routine Description:
 
 Argments:
 
+  Ctx - the compression context
   n   - the rightmost n bits of the data is used
   x   - the data 
 
@@ -1293,27 +1832,27 @@ Returns: (VOID)
 {
   UINT8 Temp;  
   
-  if (n < mBitCount) {
-    mSubBitBuf |= x << (mBitCount -= n);
+  if (n < Ctx->mBitCount) {
+    Ctx->mSubBitBuf |= x << (Ctx->mBitCount -= n);
   } else {
       
-    Temp = (UINT8)(mSubBitBuf | (x >> (n -= mBitCount)));
-    if (mDst < mDstUpperLimit) {
-      *mDst++ = Temp;
+    Temp = (UINT8)(Ctx->mSubBitBuf | (x >> (n -= Ctx->mBitCount)));
+    if (Ctx->mDst < Ctx->mDstUpperLimit) {
+      *Ctx->mDst++ = Temp;
     }
-    mCompSize++;
+    Ctx->mCompSize++;
 
     if (n < UINT8_BIT) {
-      mSubBitBuf = x << (mBitCount = UINT8_BIT - n);
+      Ctx->mSubBitBuf = x << (Ctx->mBitCount = UINT8_BIT - n);
     } else {
         
       Temp = (UINT8)(x >> (n - UINT8_BIT));
-      if (mDst < mDstUpperLimit) {
-        *mDst++ = Temp;
+      if (Ctx->mDst < Ctx->mDstUpperLimit) {
+        *Ctx->mDst++ = Temp;
       }
-      mCompSize++;
+      Ctx->mCompSize++;
       
-      mSubBitBuf = x << (mBitCount = 2 * UINT8_BIT - n);
+      Ctx->mSubBitBuf = x << (Ctx->mBitCount = 2 * UINT8_BIT - n);
     }
   }
 }
@@ -1321,6 +1860,7 @@ Returns: (VOID)
 STATIC 
 INT32 
 FreadCrc (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   OUT UINT8 *p, 
   IN  INT32 n
   )
@@ -1332,6 +1872,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx - the compression context
   p   - the buffer to hold the data
   n   - number of bytes to read
 
@@ -1343,13 +1884,13 @@ Returns:
 {
   INT32 i;
 
-  for (i = 0; mSrc < mSrcUpperLimit && i < n; i++) {
-    *p++ = *mSrc++;
+  for (i = 0; Ctx->mSrc < Ctx->mSrcUpperLimit && i < n; i++) {
+    *p++ = *Ctx->mSrc++;
   }
   n = i;
 
   p -= n;
-  mOrigSize += n;
+  Ctx->mOrigSize += n;
   while (--i >= 0) {
     UPDATE_CRC(*p++);
   }
@@ -1359,15 +1900,18 @@ Returns:
 
 STATIC 
 VOID 
-InitPutBits ()
+InitPutBits (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx
+  )
 {
-  mBitCount = UINT8_BIT;  
-  mSubBitBuf = 0;
+  Ctx->mBitCount = UINT8_BIT;  
+  Ctx->mSubBitBuf = 0;
 }
 
 STATIC 
 VOID 
 CountLen (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 i
   )
 /*++
@@ -1378,27 +1922,27 @@ Routine Description:
   
 Arguments:
 
+  Ctx - the compression context
   i   - the top node
   
 Returns: (VOID)
 
 --*/
 {
-  STATIC INT32 Depth = 0;
-
-  if (i < mN) {
-    mLenCnt[(Depth < 16) ? Depth : 16]++;
+  if (i < Ctx->mN) {
+    Ctx->mLenCnt[(Ctx->mDepth < 16) ? Ctx->mDepth : 16]++;
   } else {
-    Depth++;
-    CountLen(mLeft [i]);
-    CountLen(mRight[i]);
-    Depth--;
+    Ctx->mDepth++;
+    CountLen(Ctx, Ctx->mLeft [i]);
+    CountLen(Ctx, Ctx->mRight[i]);
+    Ctx->mDepth--;
   }
 }
 
 STATIC 
 VOID 
 MakeLen (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Root
   )
 /*++
@@ -1409,6 +1953,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx    - the compression context
   Root   - the root of the tree
 
 --*/
@@ -1417,9 +1962,9 @@ Arguments:
   UINT32 Cum;
 
   for (i = 0; i <= 16; i++) {
-    mLenCnt[i] = 0;
+    Ctx->mLenCnt[i] = 0;
   }
-  CountLen(Root);
+  CountLen(Ctx, Root);
   
   //
   // Adjust the length count array so that
@@ -1428,23 +1973,23 @@ Arguments:
   
   Cum = 0;
   for (i = 16; i > 0; i--) {
-    Cum += mLenCnt[i] << (16 - i);
+    Cum += Ctx->mLenCnt[i] << (16 - i);
   }
   while (Cum != (1U << 16)) {
-    mLenCnt[16]--;
+    Ctx->mLenCnt[16]--;
     for (i = 15; i > 0; i--) {
-      if (mLenCnt[i] != 0) {
-        mLenCnt[i]--;
-        mLenCnt[i+1] += 2;
+      if (Ctx->mLenCnt[i] != 0) {
+        Ctx->mLenCnt[i]--;
+        Ctx->mLenCnt[i+1] += 2;
         break;
       }
     }
     Cum--;
   }
   for (i = 16; i > 0; i--) {
-    k = mLenCnt[i];
+    k = Ctx->mLenCnt[i];
     while (--k >= 0) {
-      mLen[*mSortPtr++] = (UINT8)i;
+      Ctx->mLen[*Ctx->mSortPtr++] = (UINT8)i;
     }
   }
 }
@@ -1452,6 +1997,7 @@ Arguments:
 STATIC 
 VOID 
 DownHeap (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN INT32 i
   )
 {
@@ -1461,23 +2007,24 @@ DownHeap (
   // priority queue: send i-th entry down heap
   //
   
-  k = mHeap[i];
-  while ((j = 2 * i) <= mHeapSize) {
-    if (j < mHeapSize && mFreq[mHeap[j]] > mFreq[mHeap[j + 1]]) {
+  k = Ctx->mHeap[i];
+  while ((j = 2 * i) <= Ctx->mHeapSize) {
+    if (j < Ctx->mHeapSize && Ctx->mFreq[Ctx->mHeap[j]] > Ctx->mFreq[Ctx->mHeap[j + 1]]) {
       j++;
     }
-    if (mFreq[k] <= mFreq[mHeap[j]]) {
+    if (Ctx->mFreq[k] <= Ctx->mFreq[Ctx->mHeap[j]]) {
       break;
     }
-    mHeap[i] = mHeap[j];
+    Ctx->mHeap[i] = Ctx->mHeap[j];
     i = j;
   }
-  mHeap[i] = (INT16)k;
+  Ctx->mHeap[i] = (INT16)k;
 }
 
 STATIC 
 VOID 
 MakeCode (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN  INT32 n, 
   IN  UINT8 Len[], 
   OUT UINT16 Code[]
@@ -1490,6 +2037,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx   - the compression context
   n     - number of symbols
   Len   - the code length array
   Code  - stores codes for each symbol
@@ -1503,7 +2051,7 @@ Returns: (VOID)
 
   Start[1] = 0;
   for (i = 1; i <= 16; i++) {
-    Start[i + 1] = (UINT16)((Start[i] + mLenCnt[i]) << 1);
+    Start[i + 1] = (UINT16)((Start[i] + Ctx->mLenCnt[i]) << 1);
   }
   for (i = 0; i < n; i++) {
     Code[i] = Start[Len[i]]++;
@@ -1513,6 +2061,7 @@ Returns: (VOID)
 STATIC 
 INT32 
 MakeTree (
+  IN OUT EFI_COMPRESS_CONTEXT  *Ctx,
   IN  INT32   NParm, 
   IN  UINT16  FreqParm[], 
   OUT UINT8   LenParm[], 
@@ -1526,6 +2075,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx      - the compression context
   NParm    - number of symbols
   FreqParm - frequency of each symbol
   LenParm  - code length for each symbol
@@ -1543,52 +2093,52 @@ Returns:
   // make tree, calculate len[], return root
   //
 
-  mN = NParm;
-  mFreq = FreqParm;
-  mLen = LenParm;
-  Avail = mN;
-  mHeapSize = 0;
-  mHeap[1] = 0;
-  for (i = 0; i < mN; i++) {
-    mLen[i] = 0;
-    if (mFreq[i]) {
-      mHeap[++mHeapSize] = (INT16)i;
+  Ctx->mN = NParm;
+  Ctx->mFreq = FreqParm;
+  Ctx->mLen = LenParm;
+  Avail = Ctx->mN;
+  Ctx->mHeapSize = 0;
+  Ctx->mHeap[1] = 0;
+  for (i = 0; i < Ctx->mN; i++) {
+    Ctx->mLen[i] = 0;
+    if (Ctx->mFreq[i]) {
+      Ctx->mHeap[++Ctx->mHeapSize] = (INT16)i;
     }    
   }
-  if (mHeapSize < 2) {
-    CodeParm[mHeap[1]] = 0;
-    return mHeap[1];
+  if (Ctx->mHeapSize < 2) {
+    CodeParm[Ctx->mHeap[1]] = 0;
+    return Ctx->mHeap[1];
   }
-  for (i = mHeapSize / 2; i >= 1; i--) {
+  for (i = Ctx->mHeapSize / 2; i >= 1; i--) {
     
     //
     // make priority queue 
     //
-    DownHeap(i);
+    DownHeap(Ctx, i);
   }
-  mSortPtr = CodeParm;
+  Ctx->mSortPtr = CodeParm;
   do {
-    i = mHeap[1];
-    if (i < mN) {
-      *mSortPtr++ = (UINT16)i;
+    i = Ctx->mHeap[1];
+    if (i < Ctx->mN) {
+      *Ctx->mSortPtr++ = (UINT16)i;
     }
-    mHeap[1] = mHeap[mHeapSize--];
-    DownHeap(1);
-    j = mHeap[1];
-    if (j < mN) {
-      *mSortPtr++ = (UINT16)j;
+    Ctx->mHeap[1] = Ctx->mHeap[Ctx->mHeapSize--];
+    DownHeap(Ctx, 1);
+    j = Ctx->mHeap[1];
+    if (j < Ctx->mN) {
+      *Ctx->mSortPtr++ = (UINT16)j;
     }
     k = Avail++;
-    mFreq[k] = (UINT16)(mFreq[i] + mFreq[j]);
-    mHeap[1] = (INT16)k;
-    DownHeap(1);
-    mLeft[k] = (UINT16)i;
-    mRight[k] = (UINT16)j;
-  } while (mHeapSize > 1);
-  
-  mSortPtr = CodeParm;
-  MakeLen(k);
-  MakeCode(NParm, LenParm, CodeParm);
+    Ctx->mFreq[k] = (UINT16)(Ctx->mFreq[i] + Ctx->mFreq[j]);
+    Ctx->mHeap[1] = (INT16)k;
+    DownHeap(Ctx, 1);
+    Ctx->mLeft[k] = (UINT16)i;
+    Ctx->mRight[k] = (UINT16)j;
+  } while (Ctx->mHeapSize > 1);
+  
+  Ctx->mSortPtr = CodeParm;
+  MakeLen(Ctx, k);
+  MakeCode(Ctx, NParm, LenParm, CodeParm);
   
   //
   // return root
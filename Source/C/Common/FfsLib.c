@@ -0,0 +1,1069 @@
+/** @file
+
+Copyright (c) 2004 - 2013, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+Module Name:
+
+  FfsLib.c
+
+Abstract:
+
+  Build sections and FFS files per the PI spec from data in memory.
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Common/UefiBaseTypes.h>
+#include <Common/PiFirmwareFile.h>
+#include <Protocol/GuidedSectionExtraction.h>
+#include <IndustryStandard/PeImage.h>
+
+#include "CommonLib.h"
+#include "Compress.h"
+#include "CompressCache.h"
+#include "Crc32.h"
+#include "EfiUtilityMsgs.h"
+#include "FfsLib.h"
+
+STATIC CHAR8      *mSectionTypeName[] = {
+  NULL,                                 // 0x00 - reserved
+  "EFI_SECTION_COMPRESSION",            // 0x01
+  "EFI_SECTION_GUID_DEFINED",           // 0x02
+  NULL,                                 // 0x03 - reserved
+  NULL,                                 // 0x04 - reserved
+  NULL,                                 // 0x05 - reserved
+  NULL,                                 // 0x06 - reserved
+  NULL,                                 // 0x07 - reserved
+  NULL,                                 // 0x08 - reserved
+  NULL,                                 // 0x09 - reserved
+  NULL,                                 // 0x0A - reserved
+  NULL,                                 // 0x0B - reserved
+  NULL,                                 // 0x0C - reserved
+  NULL,                                 // 0x0D - reserved
+  NULL,                                 // 0x0E - reserved
+  NULL,                                 // 0x0F - reserved
+  "EFI_SECTION_PE32",                   // 0x10
+  "EFI_SECTION_PIC",                    // 0x11
+  "EFI_SECTION_TE",                     // 0x12
+  "EFI_SECTION_DXE_DEPEX",              // 0x13
+  "EFI_SECTION_VERSION",                // 0x14
+  "EFI_SECTION_USER_INTERFACE",         // 0x15
+  "EFI_SECTION_COMPATIBILITY16",        // 0x16
+  "EFI_SECTION_FIRMWARE_VOLUME_IMAGE",  // 0x17
+  "EFI_SECTION_FREEFORM_SUBTYPE_GUID",  // 0x18
+  "EFI_SECTION_RAW",                    // 0x19
+  NULL,                                 // 0x1A
+  "EFI_SECTION_PEI_DEPEX",              // 0x1B
+  "EFI_SECTION_SMM_DEPEX"               // 0x1C
+};
+
+STATIC CHAR8      *mFfsFileType[] = {
+  NULL,                                   // 0x00
+  "EFI_FV_FILETYPE_RAW",                  // 0x01
+  "EFI_FV_FILETYPE_FREEFORM",             // 0x02
+  "EFI_FV_FILETYPE_SECURITY_CORE",        // 0x03
+  "EFI_FV_FILETYPE_PEI_CORE",             // 0x04
+  "EFI_FV_FILETYPE_DXE_CORE",             // 0x05
+  "EFI_FV_FILETYPE_PEIM",                 // 0x06
+  "EFI_FV_FILETYPE_DRIVER",               // 0x07
+  "EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER", // 0x08
+  "EFI_FV_FILETYPE_APPLICATION",          // 0x09
+  "EFI_FV_FILETYPE_SMM",                  // 0x0A
+  "EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE",// 0x0B
+  "EFI_FV_FILETYPE_COMBINED_SMM_DXE",     // 0x0C
+  "EFI_FV_FILETYPE_SMM_CORE"              // 0x0D
+};
+
+STATIC UINT32     mFfsValidAlign[] = {0, 8, 16, 128, 512, 1024, 4096, 32768, 65536};
+
+//
+// Crc32 GUID section related definitions.
+//
+typedef struct {
+  EFI_GUID_DEFINED_SECTION  GuidSectionHeader;
+  UINT32                    CRC32Checksum;
+} CRC32_SECTION_HEADER;
+
+typedef struct {
+  EFI_GUID_DEFINED_SECTION2 GuidSectionHeader;
+  UINT32                    CRC32Checksum;
+} CRC32_SECTION_HEADER2;
+
+STATIC EFI_GUID   mZeroGuid                 = {0x0, 0x0, 0x0, {0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0}};
+STATIC EFI_GUID   mEfiCrc32SectionGuid      = EFI_CRC32_GUIDED_SECTION_EXTRACTION_PROTOCOL_GUID;
+
+//
+// The firmware LZMA extractors only decode single LZMA streams, never the
+// block container written by LzmaCompress --block-size.
+//
+STATIC EFI_GUID   mLzmaSectionGuid          = {0xEE4E5898, 0x3914, 0x4259, {0x9D, 0x6E, 0xDC, 0x7B, 0xD7, 0x94, 0x03, 0xCF}};
+STATIC EFI_GUID   mLzmaF86SectionGuid       = {0xD42AE6BD, 0x1352, 0x4BFB, {0x90, 0x9A, 0xCA, 0x72, 0xA6, 0xEA, 0xE8, 0x89}};
+STATIC EFI_GUID   mLzmaBlockContainerGuid   = {0x2E9C5AF3, 0x7B1D, 0x4C61, {0x9A, 0x3E, 0x55, 0xD2, 0x08, 0xC4, 0x6F, 0xB1}};
+
+STATIC
+VOID
+FfsAsciiToUnicode (
+  IN  CHAR8    *String,
+  OUT CHAR16   *UniString
+  )
+/*++
+
+Routine Description:
+
+  Copy an ASCII string to a Unicode string buffer.
+
+Arguments:
+
+  String      - The ASCII string
+  UniString   - Receives the Unicode string and its terminator
+
+Returns:
+
+  None
+
+--*/
+{
+  while (*String != '\0') {
+    *(UniString++) = (CHAR16) *(String++);
+  }
+  *UniString = '\0';
+}
+
+STATIC
+VOID
+FfsSetSectionHeader (
+  IN UINT8                     *Buffer,
+  IN UINT8                     SectionType,
+  IN UINT32                    Size
+  )
+/*++
+
+Routine Description:
+
+  Fill in the common header at the start of a section, using the
+  extended size field for sections of MAX_SECTION_SIZE or more.
+
+Arguments:
+
+  Buffer      - The section
+  SectionType - Type of the section
+  Size        - Total size of the section including its header
+
+Returns:
+
+  None
+
+--*/
+{
+  EFI_COMMON_SECTION_HEADER *CommonSect;
+
+  CommonSect        = (EFI_COMMON_SECTION_HEADER *) Buffer;
+  CommonSect->Type  = SectionType;
+  if (Size < MAX_SECTION_SIZE) {
+    CommonSect->Size[0]  = (UINT8) (Size & 0xff);
+    CommonSect->Size[1]  = (UINT8) ((Size & 0xff00) >> 8);
+    CommonSect->Size[2]  = (UINT8) ((Size & 0xff0000) >> 16);
+  } else {
+    memset (CommonSect->Size, 0xff, sizeof (UINT8) * 3);
+    ((EFI_COMMON_SECTION_HEADER2 *) CommonSect)->ExtendedSize = Size;
+  }
+}
+
+STATIC
+UINT32
+FfsAlignmentToIndex (
+  IN UINT32                    Alignment
+  )
+/*++
+
+Routine Description:
+
+  Find the smallest FFS alignment attribute value that covers Alignment.
+
+Arguments:
+
+  Alignment   - Alignment in bytes
+
+Returns:
+
+  The value of the FFS_ATTRIB_DATA_ALIGNMENT field, 0 for 8 bytes or less.
+
+--*/
+{
+  UINT32  Index;
+
+  if (Alignment <= mFfsValidAlign[1]) {
+    return 0;
+  }
+  for (Index = 0; Index < sizeof (mFfsValidAlign) / sizeof (UINT32) - 1; Index ++) {
+    if ((Alignment > mFfsValidAlign [Index]) && (Alignment <= mFfsValidAlign [Index + 1])) {
+      break;
+    }
+  }
+  return Index;
+}
+
+STATIC
+EFI_STATUS
+FfsEfiCompress (
+  IN  UINT32                   Level,
+  IN  UINT8                    *SrcBuffer,
+  IN  UINT32                   SrcSize,
+  OUT UINT8                    **DstBuffer,
+  OUT UINT32                   *DstSize
+  )
+/*++
+
+Routine Description:
+
+  Compress data with the EFI algorithm at the given level into a new
+  buffer, reusing the result of an earlier build from the compression
+  cache when one is configured.
+
+  The cache must have been initialized by CompressCacheEnabled before this
+  is called from several threads. Entries are only ever added, and their
+  temporary files are named after their content, so a race between two
+  threads storing the same data leaves a valid entry.
+
+Arguments:
+
+  Level       - The compression level
+  SrcBuffer   - The data to compress
+  SrcSize     - The size of SrcBuffer
+  DstBuffer   - Receives the compressed data, released with free()
+  DstSize     - Receives the size of the compressed data
+
+Returns:
+
+  EFI_SUCCESS           - Compression is successful.
+  EFI_OUT_OF_RESOURCES  - No resource to complete function.
+
+--*/
+{
+  EFI_COMPRESS_CONTEXT  *Context;
+  CHAR8                 Params[32];
+  VOID                  *Output;
+  UINTN                 OutputSize;
+  UINT8                 *Buffer;
+  UINT32                Size;
+  EFI_STATUS            Status;
+
+  sprintf (Params, "level=%u", (unsigned) Level);
+  if (CompressCacheLookup (COMPRESS_CACHE_CODEC_EFI, Params, SrcBuffer, SrcSize, &Output, &OutputSize) == EFI_SUCCESS) {
+    if (OutputSize == (UINT32) OutputSize) {
+      *DstBuffer = Output;
+      *DstSize   = (UINT32) OutputSize;
+      return EFI_SUCCESS;
+    }
+    free (Output);
+  }
+
+  Status = EfiCompressCreateContext (&Context);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  Status = EfiCompressSetLevel (Context, Level);
+  if (EFI_ERROR (Status)) {
+    EfiCompressDestroyContext (Context);
+    return Status;
+  }
+
+  //
+  // Start with room for slightly expanded data, so the data is normally
+  // compressed only once. The encoder stops writing at the end of the
+  // buffer and reports the size needed.
+  //
+  Size   = SrcSize + SrcSize / 8 + 64;
+  Buffer = malloc (Size);
+  if (Buffer == NULL) {
+    EfiCompressDestroyContext (Context);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Status = EfiCompressWithContext (Context, SrcBuffer, SrcSize, Buffer, &Size);
+  if (Status == EFI_BUFFER_TOO_SMALL) {
+    free (Buffer);
+    Buffer = malloc (Size);
+    if (Buffer == NULL) {
+      EfiCompressDestroyContext (Context);
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Status = EfiCompressWithContext (Context, SrcBuffer, SrcSize, Buffer, &Size);
+  }
+  EfiCompressDestroyContext (Context);
+
+  if (EFI_ERROR (Status)) {
+    free (Buffer);
+    return Status;
+  }
+
+  CompressCacheStore (COMPRESS_CACHE_CODEC_EFI, Params, SrcBuffer, SrcSize, Buffer, Size);
+  *DstBuffer = Buffer;
+  *DstSize   = Size;
+  return EFI_SUCCESS;
+}
+
+UINT8
+FfsSectionTypeFromString (
+  IN CHAR8                              *String
+  )
+/*++
+
+Routine Description:
+
+  Convert a section type name such as EFI_SECTION_PE32 to its value.
+
+Arguments:
+
+  String      - The section type name, compared without case
+
+Returns:
+
+  The section type, or EFI_SECTION_ALL if the name is unknown.
+
+--*/
+{
+  UINT8 Index;
+
+  if (String == NULL) {
+    return EFI_SECTION_ALL;
+  }
+
+  for (Index = 0; Index < sizeof (mSectionTypeName) / sizeof (CHAR8 *); Index ++) {
+    if (mSectionTypeName [Index] != NULL && (stricmp (String, mSectionTypeName [Index]) == 0)) {
+      return Index;
+    }
+  }
+  return EFI_SECTION_ALL;
+}
+
+EFI_FV_FILETYPE
+FfsFileTypeFromString (
+  IN CHAR8                              *String
+  )
+/*++
+
+Routine Description:
+
+  Convert a file type name such as EFI_FV_FILETYPE_DRIVER to its value.
+
+Arguments:
+
+  String      - The file type name, compared without case
+
+Returns:
+
+  The file type, or EFI_FV_FILETYPE_ALL if the name is unknown.
+
+--*/
+{
+  UINT8 Index;
+
+  if (String == NULL) {
+    return EFI_FV_FILETYPE_ALL;
+  }
+
+  for (Index = 0; Index < sizeof (mFfsFileType) / sizeof (CHAR8 *); Index ++) {
+    if (mFfsFileType [Index] != NULL && (stricmp (String, mFfsFileType [Index]) == 0)) {
+      return Index;
+    }
+  }
+  return EFI_FV_FILETYPE_ALL;
+}
+
+EFI_STATUS
+FfsGetSectionContents (
+  IN     FFS_SECTION_INPUT              *Inputs,
+  IN     UINT32                         InputNum,
+  OUT    UINT8                          *Buffer,       OPTIONAL
+  IN OUT UINT32                         *BufferLength,
+  IN OUT UINT32                         *MaxAlignment, OPTIONAL
+  IN OUT UINT8                          *PeSectionNum  OPTIONAL
+  )
+/*++
+
+Routine Description:
+
+  Concatenate the inputs, starting each one on a DWORD boundary and
+  inserting a RAW pad section where needed to align its section data.
+
+Arguments:
+
+  Inputs        - The sections to concatenate
+  InputNum      - Number of inputs
+  Buffer        - Output buffer, or NULL to query the size
+  BufferLength  - On input, the size of Buffer. On output, the size of the
+                  concatenated data.
+  MaxAlignment  - If not NULL, raised to the largest input alignment
+  PeSectionNum  - If not NULL, increased by the number of PE, TE and
+                  encapsulating sections among the inputs
+
+Returns:
+
+  EFI_SUCCESS               - The data is in Buffer.
+  EFI_BUFFER_TOO_SMALL      - Buffer is too small; BufferLength holds the size needed.
+
+--*/
+{
+  UINT32                     Size;
+  UINT32                     Offset;
+  UINT32                     FileSize;
+  UINT32                     Alignment;
+  UINT32                     Index;
+  UINT8                      *Data;
+  EFI_COMMON_SECTION_HEADER  *SectHeader;
+  EFI_TE_IMAGE_HEADER        *TeHeader;
+  UINT32                     TeOffset;
+  UINT32                     HeaderSize;
+
+  Size = 0;
+  for (Index = 0; Index < InputNum; Index++) {
+    //
+    // make sure section ends on a DWORD boundary
+    //
+    while ((Size & 0x03) != 0) {
+      if (Buffer != NULL && Size < *BufferLength) {
+        Buffer[Size] = 0;
+      }
+      Size++;
+    }
+
+    Data      = Inputs[Index].Data;
+    FileSize  = Inputs[Index].Size;
+    Alignment = Inputs[Index].Alignment;
+    if (MaxAlignment != NULL && *MaxAlignment < Alignment) {
+      *MaxAlignment = Alignment;
+    }
+
+    //
+    // The section might be EFI_COMMON_SECTION_HEADER2
+    // But only Type needs to be checked
+    //
+    TeOffset = 0;
+    if (FileSize >= MAX_SECTION_SIZE) {
+      HeaderSize = sizeof (EFI_COMMON_SECTION_HEADER2);
+    } else {
+      HeaderSize = sizeof (EFI_COMMON_SECTION_HEADER);
+    }
+    if (FileSize >= HeaderSize) {
+      switch (((EFI_COMMON_SECTION_HEADER *) Data)->Type) {
+      case EFI_SECTION_TE:
+        if (FileSize >= HeaderSize + sizeof (EFI_TE_IMAGE_HEADER)) {
+          TeHeader = (EFI_TE_IMAGE_HEADER *) (Data + HeaderSize);
+          if (TeHeader->Signature == EFI_TE_IMAGE_HEADER_SIGNATURE) {
+            TeOffset = TeHeader->StrippedSize - sizeof (EFI_TE_IMAGE_HEADER);
+          }
+        }
+        break;
+
+      case EFI_SECTION_GUID_DEFINED:
+        if (FileSize >= MAX_SECTION_SIZE) {
+          if ((((EFI_GUID_DEFINED_SECTION2 *) Data)->Attributes & EFI_GUIDED_SECTION_PROCESSING_REQUIRED) == 0) {
+            HeaderSize = ((EFI_GUID_DEFINED_SECTION2 *) Data)->DataOffset;
+          }
+        } else if (FileSize >= sizeof (EFI_GUID_DEFINED_SECTION)) {
+          if ((((EFI_GUID_DEFINED_SECTION *) Data)->Attributes & EFI_GUIDED_SECTION_PROCESSING_REQUIRED) == 0) {
+            HeaderSize = ((EFI_GUID_DEFINED_SECTION *) Data)->DataOffset;
+          }
+        }
+        break;
+      }
+
+      if (PeSectionNum != NULL) {
+        //
+        // For the encapsulated section, assume it contains Pe/Te section
+        //
+        switch (((EFI_COMMON_SECTION_HEADER *) Data)->Type) {
+        case EFI_SECTION_TE:
+        case EFI_SECTION_PE32:
+        case EFI_SECTION_GUID_DEFINED:
+        case EFI_SECTION_COMPRESSION:
+        case EFI_SECTION_FIRMWARE_VOLUME_IMAGE:
+          (*PeSectionNum) ++;
+          break;
+        }
+      }
+    }
+
+    if (Alignment > 1) {
+      //
+      // Revert TeOffset to the converse value relative to Alignment
+      // This is to assure the original PeImage Header at Alignment.
+      //
+      if (TeOffset != 0) {
+        TeOffset = Alignment - (TeOffset % Alignment);
+        TeOffset = TeOffset % Alignment;
+      }
+
+      //
+      // make sure section data meet its alignment requirement by adding one raw pad section.
+      //
+      if (((Size + HeaderSize + TeOffset) % Alignment) != 0) {
+        Offset = (Size + sizeof (EFI_COMMON_SECTION_HEADER) + HeaderSize + TeOffset + Alignment - 1) & ~(Alignment - 1);
+        Offset = Offset - Size - HeaderSize - TeOffset;
+
+        if (Buffer != NULL && ((Size + Offset) < *BufferLength)) {
+          //
+          // The maximal alignment is 64K, the raw section size must be less than 0xffffff
+          //
+          memset (Buffer + Size, 0, Offset);
+          SectHeader          = (EFI_COMMON_SECTION_HEADER *) (Buffer + Size);
+          SectHeader->Type    = EFI_SECTION_RAW;
+          SectHeader->Size[0] = (UINT8) (Offset & 0xff);
+          SectHeader->Size[1] = (UINT8) ((Offset & 0xff00) >> 8);
+          SectHeader->Size[2] = (UINT8) ((Offset & 0xff0000) >> 16);
+        }
+        DebugMsg (NULL, 0, 9, "Pad raw section for section data alignment", "Pad Raw section size is %u", (unsigned) Offset);
+
+        Size = Size + Offset;
+      }
+    }
+
+    if ((FileSize > 0) && (Buffer != NULL) && ((Size + FileSize) <= *BufferLength)) {
+      memcpy (Buffer + Size, Data, FileSize);
+    }
+    Size += FileSize;
+  }
+
+  //
+  // Set the real required buffer size.
+  //
+  if (Size > *BufferLength) {
+    *BufferLength = Size;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+  *BufferLength = Size;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+FfsGenLeafSection (
+  IN  UINT8                             SectionType,
+  IN  UINT8                             *Data,
+  IN  UINT32                            DataSize,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Add a section header of the given type in front of Data.
+
+Arguments:
+
+  SectionType - Type of the leaf section
+  Data        - The section data
+  DataSize    - The size of Data
+  OutBuffer   - Receives the section, released with free()
+  OutSize     - Receives the size of the section
+
+Returns:
+
+  EFI_SUCCESS               - The section was created.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+{
+  UINT8   *Buffer;
+  UINT32  TotalLength;
+  UINT32  HeaderLength;
+
+  HeaderLength = sizeof (EFI_COMMON_SECTION_HEADER);
+  TotalLength  = HeaderLength + DataSize;
+  if (TotalLength >= MAX_SECTION_SIZE) {
+    HeaderLength = sizeof (EFI_COMMON_SECTION_HEADER2);
+    TotalLength  = HeaderLength + DataSize;
+  }
+  VerboseMsg ("the size of the created section file is %u bytes", (unsigned) TotalLength);
+
+  Buffer = (UINT8 *) malloc ((size_t) TotalLength);
+  if (Buffer == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allcoated");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  FfsSetSectionHeader (Buffer, SectionType, TotalLength);
+  if (DataSize != 0) {
+    memcpy (Buffer + HeaderLength, Data, DataSize);
+  }
+
+  *OutBuffer = Buffer;
+  *OutSize   = TotalLength;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+FfsGenVersionSection (
+  IN  UINT16                            BuildNumber,
+  IN  CHAR8                             *VersionString,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Create an EFI_SECTION_VERSION section.
+
+Arguments:
+
+  BuildNumber   - The build number
+  VersionString - ASCII version string, stored as a Unicode string
+  OutBuffer     - Receives the section, released with free()
+  OutSize       - Receives the size of the section
+
+Returns:
+
+  EFI_SUCCESS               - The section was created.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+{
+  EFI_VERSION_SECTION *VersionSect;
+  UINT32              Size;
+
+  //
+  // 2 bytes for the build number UINT16, and the string is stored as
+  // Unicode with a terminating null.
+  //
+  Size = sizeof (EFI_COMMON_SECTION_HEADER) + 2 + ((UINT32) strlen (VersionString) * 2) + 2;
+  VersionSect = (EFI_VERSION_SECTION *) malloc (Size);
+  if (VersionSect == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allcoated");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  FfsSetSectionHeader ((UINT8 *) VersionSect, EFI_SECTION_VERSION, Size);
+  VersionSect->BuildNumber = BuildNumber;
+  FfsAsciiToUnicode (VersionString, VersionSect->VersionString);
+  VerboseMsg ("the size of the created section file is %u bytes", (unsigned) Size);
+
+  *OutBuffer = (UINT8 *) VersionSect;
+  *OutSize   = Size;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+FfsGenUserInterfaceSection (
+  IN  CHAR8                             *Name,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Create an EFI_SECTION_USER_INTERFACE section.
+
+Arguments:
+
+  Name        - ASCII name, stored as a Unicode string
+  OutBuffer   - Receives the section, released with free()
+  OutSize     - Receives the size of the section
+
+Returns:
+
+  EFI_SUCCESS               - The section was created.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+{
+  EFI_USER_INTERFACE_SECTION  *UiSect;
+  UINT32                      Size;
+
+  Size = sizeof (EFI_COMMON_SECTION_HEADER) + ((UINT32) strlen (Name) * 2) + 2;
+  UiSect = (EFI_USER_INTERFACE_SECTION *) malloc (Size);
+  if (UiSect == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allcoated");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  FfsSetSectionHeader ((UINT8 *) UiSect, EFI_SECTION_USER_INTERFACE, Size);
+  FfsAsciiToUnicode (Name, UiSect->FileNameString);
+  VerboseMsg ("the size of the created section file is %u bytes", (unsigned) Size);
+
+  *OutBuffer = (UINT8 *) UiSect;
+  *OutSize   = Size;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+FfsGenCompressionSection (
+  IN  FFS_SECTION_INPUT                 *Inputs,
+  IN  UINT32                            InputNum,
+  IN  UINT8                             CompressionType,
+  IN  UINT32                            Level,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Create an EFI_SECTION_COMPRESSION section holding the concatenated
+  inputs. PI_STD data is looked up in, and added to, the compression cache.
+
+Arguments:
+
+  Inputs          - The sections to encapsulate
+  InputNum        - Number of inputs
+  CompressionType - EFI_NOT_COMPRESSED or EFI_STANDARD_COMPRESSION
+  Level           - Compression level, COMPRESS_LEVEL_MIN to COMPRESS_LEVEL_MAX
+  OutBuffer       - Receives the section, released with free()
+  OutSize         - Receives the size of the section
+
+Returns:
+
+  EFI_SUCCESS               - The section was created.
+  EFI_ABORTED               - The compression type is unknown.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+{
+  UINT32                    TotalLength;
+  UINT32                    InputLength;
+  UINT32                    CompressedLength;
+  UINT32                    HeaderLength;
+  UINT8                     *FileBuffer;
+  UINT8                     *CompressedBuffer;
+  UINT8                     *OutputBuffer;
+  EFI_STATUS                Status;
+  EFI_COMPRESSION_SECTION   *CompressionSect;
+  EFI_COMPRESSION_SECTION2  *CompressionSect2;
+
+  if (CompressionType != EFI_NOT_COMPRESSED && CompressionType != EFI_STANDARD_COMPRESSION) {
+    Error (NULL, 0, 2000, "Invalid paramter", "unknown compression type");
+    return EFI_ABORTED;
+  }
+
+  InputLength = 0;
+  FfsGetSectionContents (Inputs, InputNum, NULL, &InputLength, NULL, NULL);
+  FileBuffer = (UINT8 *) malloc (InputLength + 1);
+  if (FileBuffer == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allcoated");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  FfsGetSectionContents (Inputs, InputNum, FileBuffer, &InputLength, NULL, NULL);
+
+  if (CompressionType == EFI_STANDARD_COMPRESSION) {
+    Status = FfsEfiCompress (Level, FileBuffer, InputLength, &CompressedBuffer, &CompressedLength);
+    free (FileBuffer);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  } else {
+    CompressedBuffer = FileBuffer;
+    CompressedLength = InputLength;
+  }
+
+  DebugMsg (NULL, 0, 9, "comprss file size",
+            "the original section size is %d bytes and the compressed section size is %u bytes", (unsigned) InputLength, (unsigned) CompressedLength);
+
+  HeaderLength = sizeof (EFI_COMPRESSION_SECTION);
+  if (CompressedLength + HeaderLength >= MAX_SECTION_SIZE) {
+    HeaderLength = sizeof (EFI_COMPRESSION_SECTION2);
+  }
+  TotalLength = CompressedLength + HeaderLength;
+  VerboseMsg ("the size of the created section file is %u bytes", (unsigned) TotalLength);
+
+  OutputBuffer = (UINT8 *) malloc (TotalLength);
+  if (OutputBuffer == NULL) {
+    free (CompressedBuffer);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  memcpy (OutputBuffer + HeaderLength, CompressedBuffer, CompressedLength);
+  free (CompressedBuffer);
+
+  //
+  // Add the section header for the compressed data
+  //
+  FfsSetSectionHeader (OutputBuffer, EFI_SECTION_COMPRESSION, TotalLength);
+  if (TotalLength >= MAX_SECTION_SIZE) {
+    CompressionSect2 = (EFI_COMPRESSION_SECTION2 *) OutputBuffer;
+    CompressionSect2->CompressionType     = CompressionType;
+    CompressionSect2->UncompressedLength  = InputLength;
+  } else {
+    CompressionSect = (EFI_COMPRESSION_SECTION *) OutputBuffer;
+    CompressionSect->CompressionType      = CompressionType;
+    CompressionSect->UncompressedLength   = InputLength;
+  }
+
+  *OutBuffer = OutputBuffer;
+  *OutSize   = TotalLength;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+FfsGenGuidDefinedSection (
+  IN  FFS_SECTION_INPUT                 *Inputs,
+  IN  UINT32                            InputNum,
+  IN  EFI_GUID                          *VendorGuid,
+  IN  UINT16                            Attributes,
+  IN  UINT32                            DataHeaderSize,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Create an EFI_SECTION_GUID_DEFINED section holding the concatenated
+  inputs. A zero VendorGuid creates a CRC32 guided section.
+
+Arguments:
+
+  Inputs          - The sections to encapsulate
+  InputNum        - Number of inputs
+  VendorGuid      - The section definition GUID
+  Attributes      - The guided section attributes
+  DataHeaderSize  - Size of the vendor data between the header and the data
+  OutBuffer       - Receives the section, released with free()
+  OutSize         - Receives the size of the section
+
+Returns:
+
+  EFI_SUCCESS               - The section was created.
+  EFI_NOT_FOUND             - The inputs are empty.
+  EFI_INVALID_PARAMETER     - An LZMA section holds an LZMA block container.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+{
+  UINT32                    TotalLength;
+  UINT32                    InputLength;
+  UINT32                    Offset;
+  UINT8                     *FileBuffer;
+  UINT32                    Crc32Checksum;
+  BOOLEAN                   IsCrc32;
+  CRC32_SECTION_HEADER      *Crc32GuidSect;
+  CRC32_SECTION_HEADER2     *Crc32GuidSect2;
+  EFI_GUID_DEFINED_SECTION  *VendorGuidSect;
+  EFI_GUID_DEFINED_SECTION2 *VendorGuidSect2;
+
+  InputLength = 0;
+  FfsGetSectionContents (Inputs, InputNum, NULL, &InputLength, NULL, NULL);
+  if (InputLength == 0) {
+    Error (NULL, 0, 2000, "Invalid parameter", "the size of the guided section data can't be zero");
+    return EFI_NOT_FOUND;
+  }
+
+  IsCrc32 = (BOOLEAN) (CompareGuid (VendorGuid, &mZeroGuid) == 0);
+  if (IsCrc32) {
+    Offset = sizeof (CRC32_SECTION_HEADER);
+    if (InputLength + Offset >= MAX_SECTION_SIZE) {
+      Offset = sizeof (CRC32_SECTION_HEADER2);
+    }
+  } else {
+    Offset = sizeof (EFI_GUID_DEFINED_SECTION);
+    if (InputLength + Offset >= MAX_SECTION_SIZE) {
+      Offset = sizeof (EFI_GUID_DEFINED_SECTION2);
+    }
+  }
+  TotalLength = InputLength + Offset;
+
+  FileBuffer = (UINT8 *) malloc (TotalLength);
+  if (FileBuffer == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allcoated");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  FfsGetSectionContents (Inputs, InputNum, FileBuffer + Offset, &InputLength, NULL, NULL);
+  FfsSetSectionHeader (FileBuffer, EFI_SECTION_GUID_DEFINED, TotalLength);
+
+  if ((CompareGuid (VendorGuid, &mLzmaSectionGuid) == 0 || CompareGuid (VendorGuid, &mLzmaF86SectionGuid) == 0) &&
+      InputLength >= DataHeaderSize + sizeof (EFI_GUID) &&
+      CompareGuid ((EFI_GUID *) (FileBuffer + Offset + DataHeaderSize), &mLzmaBlockContainerGuid) == 0) {
+    Error (NULL, 0, 2000, "Invalid parameter", "the data is an LZMA block container, which LZMA sections can't hold; use the section GUID %08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+      (unsigned) mLzmaBlockContainerGuid.Data1,
+      mLzmaBlockContainerGuid.Data2,
+      mLzmaBlockContainerGuid.Data3,
+      mLzmaBlockContainerGuid.Data4[0],
+      mLzmaBlockContainerGuid.Data4[1],
+      mLzmaBlockContainerGuid.Data4[2],
+      mLzmaBlockContainerGuid.Data4[3],
+      mLzmaBlockContainerGuid.Data4[4],
+      mLzmaBlockContainerGuid.Data4[5],
+      mLzmaBlockContainerGuid.Data4[6],
+      mLzmaBlockContainerGuid.Data4[7]);
+    free (FileBuffer);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (IsCrc32) {
+    //
+    // Default Guid section is CRC32.
+    //
+    Crc32Checksum = 0;
+    CalculateCrc32 (FileBuffer + Offset, InputLength, &Crc32Checksum);
+
+    if (TotalLength >= MAX_SECTION_SIZE) {
+      Crc32GuidSect2 = (CRC32_SECTION_HEADER2 *) FileBuffer;
+      memcpy (&(Crc32GuidSect2->GuidSectionHeader.SectionDefinitionGuid), &mEfiCrc32SectionGuid, sizeof (EFI_GUID));
+      Crc32GuidSect2->GuidSectionHeader.Attributes  = EFI_GUIDED_SECTION_AUTH_STATUS_VALID;
+      Crc32GuidSect2->GuidSectionHeader.DataOffset  = sizeof (CRC32_SECTION_HEADER2);
+      Crc32GuidSect2->CRC32Checksum                 = Crc32Checksum;
+      DebugMsg (NULL, 0, 9, "Guided section", "Data offset is %u", Crc32GuidSect2->GuidSectionHeader.DataOffset);
+    } else {
+      Crc32GuidSect = (CRC32_SECTION_HEADER *) FileBuffer;
+      memcpy (&(Crc32GuidSect->GuidSectionHeader.SectionDefinitionGuid), &mEfiCrc32SectionGuid, sizeof (EFI_GUID));
+      Crc32GuidSect->GuidSectionHeader.Attributes   = EFI_GUIDED_SECTION_AUTH_STATUS_VALID;
+      Crc32GuidSect->GuidSectionHeader.DataOffset   = sizeof (CRC32_SECTION_HEADER);
+      Crc32GuidSect->CRC32Checksum                  = Crc32Checksum;
+      DebugMsg (NULL, 0, 9, "Guided section", "Data offset is %u", Crc32GuidSect->GuidSectionHeader.DataOffset);
+    }
+  } else {
+    if (TotalLength >= MAX_SECTION_SIZE) {
+      VendorGuidSect2 = (EFI_GUID_DEFINED_SECTION2 *) FileBuffer;
+      memcpy (&(VendorGuidSect2->SectionDefinitionGuid), VendorGuid, sizeof (EFI_GUID));
+      VendorGuidSect2->Attributes  = Attributes;
+      VendorGuidSect2->DataOffset  = (UINT16) (sizeof (EFI_GUID_DEFINED_SECTION2) + DataHeaderSize);
+      DebugMsg (NULL, 0, 9, "Guided section", "Data offset is %u", VendorGuidSect2->DataOffset);
+    } else {
+      VendorGuidSect = (EFI_GUID_DEFINED_SECTION *) FileBuffer;
+      memcpy (&(VendorGuidSect->SectionDefinitionGuid), VendorGuid, sizeof (EFI_GUID));
+      VendorGuidSect->Attributes  = Attributes;
+      VendorGuidSect->DataOffset  = (UINT16) (sizeof (EFI_GUID_DEFINED_SECTION) + DataHeaderSize);
+      DebugMsg (NULL, 0, 9, "Guided section", "Data offset is %u", VendorGuidSect->DataOffset);
+    }
+  }
+  VerboseMsg ("the size of the created section file is %u bytes", (unsigned) TotalLength);
+
+  *OutBuffer = FileBuffer;
+  *OutSize   = TotalLength;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+FfsGenFile (
+  IN  EFI_FV_FILETYPE                   FileType,
+  IN  EFI_GUID                          *FileGuid,
+  IN  EFI_FFS_FILE_ATTRIBUTES           Attributes,
+  IN  UINT32                            Alignment,
+  IN  FFS_SECTION_INPUT                 *Inputs,
+  IN  UINT32                            InputNum,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Create an FFS file holding the concatenated input sections. The file
+  alignment is raised to cover the largest section alignment.
+
+Arguments:
+
+  FileType    - The FFS file type
+  FileGuid    - The file name
+  Attributes  - FFS_ATTRIB_FIXED and FFS_ATTRIB_CHECKSUM, if wanted
+  Alignment   - The file alignment in bytes, 8 or less for none
+  Inputs      - The sections of the file
+  InputNum    - Number of inputs
+  OutBuffer   - Receives the file, released with free()
+  OutSize     - Receives the size of the file
+
+Returns:
+
+  EFI_SUCCESS               - The file was created.
+  EFI_INVALID_PARAMETER     - The PE or TE sections do not suit the file type.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+{
+  EFI_FFS_FILE_HEADER2  *FfsFileHeader;
+  UINT8                 *FileBuffer;
+  UINT32                DataSize;
+  UINT32                FileSize;
+  UINT32                HeaderSize;
+  UINT32                MaxAlignment;
+  UINT32                FfsAlign;
+  UINT32                Index;
+  UINT8                 PeSectionNum;
+
+  DataSize      = 0;
+  MaxAlignment  = 1;
+  PeSectionNum  = 0;
+  FfsGetSectionContents (Inputs, InputNum, NULL, &DataSize, &MaxAlignment, &PeSectionNum);
+
+  if ((FileType == EFI_FV_FILETYPE_SECURITY_CORE ||
+      FileType == EFI_FV_FILETYPE_PEI_CORE ||
+      FileType == EFI_FV_FILETYPE_DXE_CORE) && (PeSectionNum != 1)) {
+    Error (NULL, 0, 2000, "Invalid parameter", "Fv File type %s must have one and only one Pe or Te section, but %u Pe/Te section are input", mFfsFileType [FileType], PeSectionNum);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((FileType == EFI_FV_FILETYPE_PEIM ||
+      FileType == EFI_FV_FILETYPE_DRIVER ||
+      FileType == EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER ||
+      FileType == EFI_FV_FILETYPE_APPLICATION) && (PeSectionNum < 1)) {
+    Error (NULL, 0, 2000, "Invalid parameter", "Fv File type %s must have at least one Pe or Te section, but no Pe/Te section is input", mFfsFileType [FileType]);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Update FFS Alignment based on the max alignment required by input section files
+  //
+  VerboseMsg ("the max alignment of all input sections is %u", (unsigned) MaxAlignment);
+  FfsAlign = FfsAlignmentToIndex (Alignment);
+  Index    = FfsAlignmentToIndex (MaxAlignment);
+  if (FfsAlign < Index) {
+    FfsAlign = Index;
+  }
+  VerboseMsg ("the alignment of the generated FFS file is %u", (unsigned) mFfsValidAlign [FfsAlign + 1]);
+
+  if (DataSize + sizeof (EFI_FFS_FILE_HEADER) >= MAX_FFS_SIZE) {
+    HeaderSize  = sizeof (EFI_FFS_FILE_HEADER2);
+    Attributes |= FFS_ATTRIB_LARGE_FILE;
+  } else {
+    HeaderSize  = sizeof (EFI_FFS_FILE_HEADER);
+  }
+  FileSize = DataSize + HeaderSize;
+  VerboseMsg ("the size of the generated FFS file is %u bytes", (unsigned) FileSize);
+
+  FileBuffer = (UINT8 *) malloc (FileSize);
+  if (FileBuffer == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  memset (FileBuffer, 0, HeaderSize);
+  FfsGetSectionContents (Inputs, InputNum, FileBuffer + HeaderSize, &DataSize, NULL, NULL);
+
+  //
+  // Create Ffs file header.
+  //
+  FfsFileHeader = (EFI_FFS_FILE_HEADER2 *) FileBuffer;
+  memcpy (&FfsFileHeader->Name, FileGuid, sizeof (EFI_GUID));
+  FfsFileHeader->Type = FileType;
+  if (HeaderSize == sizeof (EFI_FFS_FILE_HEADER2)) {
+    FfsFileHeader->ExtendedSize = FileSize;
+  } else {
+    FfsFileHeader->Size[0]  = (UINT8) (FileSize & 0xFF);
+    FfsFileHeader->Size[1]  = (UINT8) ((FileSize & 0xFF00) >> 8);
+    FfsFileHeader->Size[2]  = (UINT8) ((FileSize & 0xFF0000) >> 16);
+  }
+  FfsFileHeader->Attributes = (EFI_FFS_FILE_ATTRIBUTES) (Attributes | (FfsAlign << 3));
+
+  //
+  // Fill in checksums and state, these must be zero for checksumming
+  //
+  FfsFileHeader->IntegrityCheck.Checksum.Header = CalculateChecksum8 (FileBuffer, HeaderSize);
+  if (FfsFileHeader->Attributes & FFS_ATTRIB_CHECKSUM) {
+    //
+    // Ffs header checksum = zero, so only need to calculate ffs body.
+    //
+    FfsFileHeader->IntegrityCheck.Checksum.File = CalculateChecksum8 (FileBuffer + HeaderSize, DataSize);
+  } else {
+    FfsFileHeader->IntegrityCheck.Checksum.File = FFS_FIXED_CHECKSUM;
+  }
+  FfsFileHeader->State = EFI_FILE_HEADER_CONSTRUCTION | EFI_FILE_HEADER_VALID | EFI_FILE_DATA_VALID;
+
+  *OutBuffer = FileBuffer;
+  *OutSize   = FileSize;
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,311 @@
+/** @file
+
+Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+Module Name:
+
+  FfsLib.h
+
+Abstract:
+
+  Header file for the routines that build sections and FFS files in memory.
+  They hold the section and file layout rules shared by GenSec, GenFfs and
+  GenFfsBatch. Every routine only touches its arguments, so several can run
+  at once on different threads.
+
+**/
+
+#ifndef _FFS_LIB_H
+#define _FFS_LIB_H
+
+#include <Common/UefiBaseTypes.h>
+#include <Common/PiFirmwareFile.h>
+
+//
+// One input of an encapsulating section or FFS file. Data is usually a
+// complete section. Alignment is the alignment required for the section
+// data in bytes, or 0 when there is no requirement.
+//
+typedef struct {
+  UINT8                                 *Data;
+  UINT32                                Size;
+  UINT32                                Alignment;
+} FFS_SECTION_INPUT;
+
+UINT8
+FfsSectionTypeFromString (
+  IN CHAR8                              *String
+  )
+/*++
+
+Routine Description:
+
+  Convert a section type name such as EFI_SECTION_PE32 to its value.
+
+Arguments:
+
+  String      - The section type name, compared without case
+
+Returns:
+
+  The section type, or EFI_SECTION_ALL if the name is unknown.
+
+--*/
+;
+
+EFI_FV_FILETYPE
+FfsFileTypeFromString (
+  IN CHAR8                              *String
+  )
+/*++
+
+Routine Description:
+
+  Convert a file type name such as EFI_FV_FILETYPE_DRIVER to its value.
+
+Arguments:
+
+  String      - The file type name, compared without case
+
+Returns:
+
+  The file type, or EFI_FV_FILETYPE_ALL if the name is unknown.
+
+--*/
+;
+
+EFI_STATUS
+FfsGetSectionContents (
+  IN     FFS_SECTION_INPUT              *Inputs,
+  IN     UINT32                         InputNum,
+  OUT    UINT8                          *Buffer,       OPTIONAL
+  IN OUT UINT32                         *BufferLength,
+  IN OUT UINT32                         *MaxAlignment, OPTIONAL
+  IN OUT UINT8                          *PeSectionNum  OPTIONAL
+  )
+/*++
+
+Routine Description:
+
+  Concatenate the inputs, starting each one on a DWORD boundary and
+  inserting a RAW pad section where needed to align its section data.
+
+Arguments:
+
+  Inputs        - The sections to concatenate
+  InputNum      - Number of inputs
+  Buffer        - Output buffer, or NULL to query the size
+  BufferLength  - On input, the size of Buffer. On output, the size of the
+                  concatenated data.
+  MaxAlignment  - If not NULL, raised to the largest input alignment
+  PeSectionNum  - If not NULL, increased by the number of PE, TE and
+                  encapsulating sections among the inputs
+
+Returns:
+
+  EFI_SUCCESS               - The data is in Buffer.
+  EFI_BUFFER_TOO_SMALL      - Buffer is too small; BufferLength holds the size needed.
+
+--*/
+;
+
+EFI_STATUS
+FfsGenLeafSection (
+  IN  UINT8                             SectionType,
+  IN  UINT8                             *Data,
+  IN  UINT32                            DataSize,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Add a section header of the given type in front of Data.
+
+Arguments:
+
+  SectionType - Type of the leaf section
+  Data        - The section data
+  DataSize    - The size of Data
+  OutBuffer   - Receives the section, released with free()
+  OutSize     - Receives the size of the section
+
+Returns:
+
+  EFI_SUCCESS               - The section was created.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+;
+
+EFI_STATUS
+FfsGenVersionSection (
+  IN  UINT16                            BuildNumber,
+  IN  CHAR8                             *VersionString,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Create an EFI_SECTION_VERSION section.
+
+Arguments:
+
+  BuildNumber   - The build number
+  VersionString - ASCII version string, stored as a Unicode string
+  OutBuffer     - Receives the section, released with free()
+  OutSize       - Receives the size of the section
+
+Returns:
+
+  EFI_SUCCESS               - The section was created.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+;
+
+EFI_STATUS
+FfsGenUserInterfaceSection (
+  IN  CHAR8                             *Name,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Create an EFI_SECTION_USER_INTERFACE section.
+
+Arguments:
+
+  Name        - ASCII name, stored as a Unicode string
+  OutBuffer   - Receives the section, released with free()
+  OutSize     - Receives the size of the section
+
+Returns:
+
+  EFI_SUCCESS               - The section was created.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+;
+
+EFI_STATUS
+FfsGenCompressionSection (
+  IN  FFS_SECTION_INPUT                 *Inputs,
+  IN  UINT32                            InputNum,
+  IN  UINT8                             CompressionType,
+  IN  UINT32                            Level,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Create an EFI_SECTION_COMPRESSION section holding the concatenated
+  inputs. PI_STD data is looked up in, and added to, the compression cache.
+
+Arguments:
+
+  Inputs          - The sections to encapsulate
+  InputNum        - Number of inputs
+  CompressionType - EFI_NOT_COMPRESSED or EFI_STANDARD_COMPRESSION
+  Level           - Compression level, COMPRESS_LEVEL_MIN to COMPRESS_LEVEL_MAX
+  OutBuffer       - Receives the section, released with free()
+  OutSize         - Receives the size of the section
+
+Returns:
+
+  EFI_SUCCESS               - The section was created.
+  EFI_ABORTED               - The compression type is unknown.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+;
+
+EFI_STATUS
+FfsGenGuidDefinedSection (
+  IN  FFS_SECTION_INPUT                 *Inputs,
+  IN  UINT32                            InputNum,
+  IN  EFI_GUID                          *VendorGuid,
+  IN  UINT16                            Attributes,
+  IN  UINT32                            DataHeaderSize,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Create an EFI_SECTION_GUID_DEFINED section holding the concatenated
+  inputs. A zero VendorGuid creates a CRC32 guided section.
+
+Arguments:
+
+  Inputs          - The sections to encapsulate
+  InputNum        - Number of inputs
+  VendorGuid      - The section definition GUID
+  Attributes      - The guided section attributes
+  DataHeaderSize  - Size of the vendor data between the header and the data
+  OutBuffer       - Receives the section, released with free()
+  OutSize         - Receives the size of the section
+
+Returns:
+
+  EFI_SUCCESS               - The section was created.
+  EFI_NOT_FOUND             - The inputs are empty.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+;
+
+EFI_STATUS
+FfsGenFile (
+  IN  EFI_FV_FILETYPE                   FileType,
+  IN  EFI_GUID                          *FileGuid,
+  IN  EFI_FFS_FILE_ATTRIBUTES           Attributes,
+  IN  UINT32                            Alignment,
+  IN  FFS_SECTION_INPUT                 *Inputs,
+  IN  UINT32                            InputNum,
+  OUT UINT8                             **OutBuffer,
+  OUT UINT32                            *OutSize
+  )
+/*++
+
+Routine Description:
+
+  Create an FFS file holding the concatenated input sections. The file
+  alignment is raised to cover the largest section alignment.
+
+Arguments:
+
+  FileType    - The FFS file type
+  FileGuid    - The file name
+  Attributes  - FFS_ATTRIB_FIXED and FFS_ATTRIB_CHECKSUM, if wanted
+  Alignment   - The file alignment in bytes, 8 or less for none
+  Inputs      - The sections of the file
+  InputNum    - Number of inputs
+  OutBuffer   - Receives the file, released with free()
+  OutSize     - Receives the size of the file
+
+Returns:
+
+  EFI_SUCCESS               - The file was created.
+  EFI_INVALID_PARAMETER     - The PE or TE sections do not suit the file type.
+  EFI_OUT_OF_RESOURCES      - Memory allocation failed.
+
+--*/
+;
+
+#endif
@@ -32,6 +32,26 @@ Abstract:
         ) \
     )
 
+//
+// State of a batch of file additions and removals, see FvBufBuilderOpen
+//
+typedef struct {
+  UINTN Offset;
+  BOOLEAN Added;
+  BOOLEAN Removed;
+} FV_BUF_BUILDER_FILE;
+
+struct _FV_BUF_BUILDER {
+  VOID* Fv;
+  UINTN Size;          // Current size of the Fv
+  UINTN Capacity;      // Allocated size of the Fv buffer
+  UINTN End;           // End of the last file
+  FV_BUF_BUILDER_FILE* Files;
+  UINTN FileCount;
+  UINTN MaxFileCount;
+  UINTN RemovedCount;
+};
+
 STATIC
 UINT32
 FvBufGetSecHdrLen(
@@ -162,9 +182,11 @@ Returns:
 {
   EFI_STATUS                  Status;
   EFI_FFS_FILE_HEADER        *NextFile;
-  EFI_FIRMWARE_VOLUME_HEADER *TempFv;
+  EFI_FIRMWARE_VOLUME_HEADER *hdr;
   UINTN                       FileKey;
   UINTN                       FvLength;
+  UINTN                       FileSize;
+  UINTN                       Offset;
 
   Status = FvBufFindFileByName(
     Fv,
@@ -180,20 +202,13 @@ Returns:
     return Status;
   }
 
-  TempFv = NULL;
-  Status = FvBufDuplicate (Fv, (VOID **)&TempFv);
-  if (EFI_ERROR (Status)) {
-    return Status;
-  }
-
-  Status = FvBufClearAllFiles (TempFv);
-  if (EFI_ERROR (Status)) {
-    return Status;
-  }
-
-  // TempFv has been allocated.  It must now be freed
-  // before returning.
-
+  //
+  // Move the other files down in place, to where adding them one by one
+  // to a cleared copy of the Fv would have put them.  A file is never
+  // moved over one that has not been visited yet.
+  //
+  hdr = (EFI_FIRMWARE_VOLUME_HEADER*)Fv;
+  Offset = hdr->HeaderLength;
   FileKey = 0;
   while (TRUE) {
 
@@ -201,24 +216,31 @@ Returns:
     if (Status == EFI_NOT_FOUND) {
       break;
     } else if (EFI_ERROR (Status)) {
-      CommonLibBinderFree (TempFv);
       return Status;
     }
 
     if (CommonLibBinderCompareGuid (Name, &NextFile->Name)) {
       continue;
     }
-    else {
-      Status = FvBufAddFile (TempFv, NextFile);
-      if (EFI_ERROR (Status)) {
-        CommonLibBinderFree (TempFv);
-        return Status;
-      }
+
+    FileSize = FvBufGetFfsFileSize (NextFile);
+    CommonLibBinderSetMem (
+      (UINT8*)hdr + Offset,
+      (UINTN)ALIGN_POINTER (Offset, 8) - Offset,
+      (hdr->Attributes & EFI_FVB2_ERASE_POLARITY) ? 0xFF : 0
+      );
+    Offset = (UINTN)ALIGN_POINTER (Offset, 8);
+    if ((UINT8*)NextFile != (UINT8*)hdr + Offset) {
+      CommonLibBinderCopyMem ((UINT8*)hdr + Offset, NextFile, FileSize);
     }
+    Offset = Offset + FileSize;
   }
 
-  CommonLibBinderCopyMem (Fv, TempFv, FvLength);
-  CommonLibBinderFree (TempFv);
+  CommonLibBinderSetMem (
+    (UINT8*)hdr + Offset,
+    FvLength - Offset,
+    (hdr->Attributes & EFI_FVB2_ERASE_POLARITY) ? 0xFF : 0
+    );
 
   return EFI_SUCCESS;
 }
@@ -816,6 +838,412 @@ Returns:
 }
 
 
+STATIC
+EFI_STATUS
+FvBufBuilderAddEntry (
+  IN OUT FV_BUF_BUILDER *Builder,
+  IN UINTN Offset,
+  IN BOOLEAN Added
+  )
+/*++
+
+Routine Description:
+
+  Records a file of the firmware volume in the builder file table, which
+  grows geometrically.
+
+Arguments:
+
+  Builder - The firmware volume builder
+  Offset - Offset of the file in the Fv
+  Added - TRUE if the file was added through the builder
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_OUT_OF_RESOURCES
+
+--*/
+{
+  FV_BUF_BUILDER_FILE* NewFiles;
+  UINTN NewMaxFileCount;
+
+  if (Builder->FileCount == Builder->MaxFileCount) {
+    NewMaxFileCount = Builder->MaxFileCount * 2 + 16;
+    NewFiles = CommonLibBinderAllocate (NewMaxFileCount * sizeof (FV_BUF_BUILDER_FILE));
+    if (NewFiles == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    if (Builder->Files != NULL) {
+      CommonLibBinderCopyMem (NewFiles, Builder->Files, Builder->FileCount * sizeof (FV_BUF_BUILDER_FILE));
+      CommonLibBinderFree (Builder->Files);
+    }
+    Builder->Files = NewFiles;
+    Builder->MaxFileCount = NewMaxFileCount;
+  }
+
+  Builder->Files[Builder->FileCount].Offset = Offset;
+  Builder->Files[Builder->FileCount].Added = Added;
+  Builder->Files[Builder->FileCount].Removed = FALSE;
+  Builder->FileCount++;
+
+  return EFI_SUCCESS;
+}
+
+
+STATIC
+EFI_STATUS
+FvBufBuilderReserve (
+  IN OUT FV_BUF_BUILDER *Builder,
+  IN UINTN Size
+  )
+/*++
+
+Routine Description:
+
+  Makes sure the builder buffer can hold a firmware volume of the given
+  size.  The buffer grows at least geometrically, so a series of extensions
+  copies each byte of the firmware volume only a few times.
+
+Arguments:
+
+  Builder - The firmware volume builder
+  Size - The size the firmware volume is about to grow to
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_OUT_OF_RESOURCES
+
+--*/
+{
+  UINTN NewCapacity;
+  VOID* NewFv;
+
+  if (Size <= Builder->Capacity) {
+    return EFI_SUCCESS;
+  }
+
+  NewCapacity = Builder->Capacity * 2;
+  if (NewCapacity < Size) {
+    NewCapacity = Size;
+  }
+
+  NewFv = CommonLibBinderAllocate (NewCapacity);
+  if (NewFv == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  CommonLibBinderCopyMem (NewFv, Builder->Fv, Builder->Size);
+  CommonLibBinderFree (Builder->Fv);
+  Builder->Fv = NewFv;
+  Builder->Capacity = NewCapacity;
+
+  return EFI_SUCCESS;
+}
+
+
+EFI_STATUS
+FvBufBuilderOpen (
+  IN VOID *Fv,
+  OUT FV_BUF_BUILDER **Builder
+  )
+/*++
+
+Routine Description:
+
+  Starts a batch of file additions and removals on a firmware volume.
+
+  Files are appended after the last file and removals only mark files as
+  deleted, so each operation costs time in proportion to the file it
+  touches.  The firmware volume is compacted, and the file and header
+  checksums updated, once by FvBufBuilderFinalize.  In between, the FV
+  header checksum is stale and the FvBuf* search routines skip the removed
+  files.
+
+Arguments:
+
+  Fv - Firmware volume allocated with CommonLibBinderAllocate.
+       Note: The builder takes over the buffer, which may be freed!
+             FvBufBuilderFinalize returns the final buffer.
+
+  Builder - Output for the new builder
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_INVALID_PARAMETER
+  EFI_OUT_OF_RESOURCES
+  EFI_VOLUME_CORRUPTED
+
+--*/
+{
+  EFI_STATUS Status;
+  FV_BUF_BUILDER* NewBuilder;
+  EFI_FFS_FILE_HEADER* FileIt;
+  UINTN Size;
+  UINTN Key;
+
+  if (Fv == NULL || Builder == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = FvBufGetSize (Fv, &Size);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  NewBuilder = CommonLibBinderAllocate (sizeof (FV_BUF_BUILDER));
+  if (NewBuilder == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  CommonLibBinderSetMem (NewBuilder, sizeof (FV_BUF_BUILDER), 0);
+  NewBuilder->Fv = Fv;
+  NewBuilder->Size = Size;
+  NewBuilder->Capacity = Size;
+  NewBuilder->End = ((EFI_FIRMWARE_VOLUME_HEADER*)Fv)->HeaderLength;
+
+  //
+  // Record the files already in the Fv, in order.
+  //
+  Key = 0;
+  while (!EFI_ERROR (FvBufFindNextFile (Fv, &Key, (VOID **)&FileIt))) {
+    Status = FvBufBuilderAddEntry (NewBuilder, (UINTN)FileIt - (UINTN)Fv, FALSE);
+    if (EFI_ERROR (Status)) {
+      CommonLibBinderFree (NewBuilder->Files);
+      CommonLibBinderFree (NewBuilder);
+      return Status;
+    }
+    NewBuilder->End = (UINTN)FileIt - (UINTN)Fv + FvBufGetFfsFileSize (FileIt);
+  }
+
+  *Builder = NewBuilder;
+  return EFI_SUCCESS;
+}
+
+
+EFI_STATUS
+FvBufBuilderAddFile (
+  IN OUT FV_BUF_BUILDER *Builder,
+  IN VOID *File
+  )
+/*++
+
+Routine Description:
+
+  Appends a new FFS file after the last file of the firmware volume,
+  extending the firmware volume by whole blocks if needed.  The checksums
+  of the file are computed by FvBufBuilderFinalize, so they need not be
+  valid yet.
+
+  BUGBUG: Does not handle the case where the firmware volume has a
+          VTF (Volume Top File).  The VTF will not be moved to the
+          end of the extended FV.
+
+Arguments:
+
+  Builder - The firmware volume builder
+  File - FFS file to add to the Fv
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_OUT_OF_RESOURCES
+
+--*/
+{
+  EFI_STATUS Status;
+  EFI_FIRMWARE_VOLUME_HEADER* hdr;
+  EFI_FV_BLOCK_MAP_ENTRY* blk;
+  UINTN Offset;
+  UINTN FileSize;
+  UINTN NewSize;
+  UINTN BlockCount;
+
+  FileSize = FvBufGetFfsFileSize ((EFI_FFS_FILE_HEADER*)File);
+  Offset = (UINTN)ALIGN_POINTER (Builder->End, 8);
+
+  if (Offset + FileSize > Builder->Size) {
+    //
+    // Extend the Fv by the number of blocks the file is missing
+    //
+    hdr = (EFI_FIRMWARE_VOLUME_HEADER*)Builder->Fv;
+    blk = hdr->BlockMap;
+    BlockCount = (Offset + FileSize - Builder->Size + (blk->Length - 1)) / blk->Length;
+    NewSize = Builder->Size + BlockCount * blk->Length;
+
+    Status = FvBufBuilderReserve (Builder, NewSize);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    hdr = (EFI_FIRMWARE_VOLUME_HEADER*)Builder->Fv;
+    hdr->FvLength = NewSize;
+    hdr->BlockMap->NumBlocks += (UINT32)BlockCount;
+
+    CommonLibBinderSetMem (
+      (UINT8*)Builder->Fv + Builder->Size,
+      NewSize - Builder->Size,
+      (hdr->Attributes & EFI_FVB2_ERASE_POLARITY) ? 0xFF : 0
+      );
+    Builder->Size = NewSize;
+  }
+
+  Status = FvBufBuilderAddEntry (Builder, Offset, TRUE);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  CommonLibBinderCopyMem ((UINT8*)Builder->Fv + Offset, File, FileSize);
+  Builder->End = Offset + FileSize;
+
+  return EFI_SUCCESS;
+}
+
+
+EFI_STATUS
+FvBufBuilderRemoveFile (
+  IN OUT FV_BUF_BUILDER *Builder,
+  IN EFI_GUID *Name
+  )
+/*++
+
+Routine Description:
+
+  Marks all files with the given name as deleted.  Their space is given
+  back by FvBufBuilderFinalize.
+
+Arguments:
+
+  Builder - The firmware volume builder
+  Name - Guid filename of the files to remove
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_NOT_FOUND
+
+--*/
+{
+  EFI_FIRMWARE_VOLUME_HEADER* hdr;
+  EFI_FFS_FILE_HEADER* File;
+  UINTN Index;
+  BOOLEAN Found;
+
+  hdr = (EFI_FIRMWARE_VOLUME_HEADER*)Builder->Fv;
+  Found = FALSE;
+
+  for (Index = 0; Index < Builder->FileCount; Index++) {
+    if (Builder->Files[Index].Removed) {
+      continue;
+    }
+
+    File = (EFI_FFS_FILE_HEADER*)((UINT8*)hdr + Builder->Files[Index].Offset);
+    if (!CommonLibBinderCompareGuid (Name, &File->Name)) {
+      continue;
+    }
+
+    //
+    // The state is not covered by the file checksums.
+    //
+    if (hdr->Attributes & EFI_FVB2_ERASE_POLARITY) {
+      File->State &= (EFI_FFS_FILE_STATE)~EFI_FILE_DELETED;
+    } else {
+      File->State |= EFI_FILE_DELETED;
+    }
+    Builder->Files[Index].Removed = TRUE;
+    Builder->RemovedCount++;
+    Found = TRUE;
+  }
+
+  return Found ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+
+EFI_STATUS
+FvBufBuilderFinalize (
+  IN FV_BUF_BUILDER *Builder,
+  OUT VOID **Fv
+  )
+/*++
+
+Routine Description:
+
+  Ends a batch of file additions and removals.  The files after the first
+  removed one are moved down in one pass, the freed space is erased, the
+  checksums of the added files and the FV header checksum are updated, and
+  the builder is freed.
+
+Arguments:
+
+  Builder - The firmware volume builder
+  Fv - Output for the firmware volume, which must be freed by the caller
+
+Returns:
+
+  EFI_SUCCESS
+
+--*/
+{
+  EFI_FIRMWARE_VOLUME_HEADER* hdr;
+  FV_BUF_BUILDER_FILE* Entry;
+  UINTN Index;
+  UINTN Offset;
+  UINTN FileSize;
+
+  hdr = (EFI_FIRMWARE_VOLUME_HEADER*)Builder->Fv;
+
+  if (Builder->RemovedCount != 0) {
+    //
+    // Files before the first removed one keep their place.
+    //
+    for (Index = 0; !Builder->Files[Index].Removed; Index++) {
+    }
+
+    Offset = Builder->Files[Index].Offset;
+    for (; Index < Builder->FileCount; Index++) {
+      Entry = &Builder->Files[Index];
+      if (Entry->Removed) {
+        continue;
+      }
+
+      FileSize = FvBufGetFfsFileSize ((EFI_FFS_FILE_HEADER*)((UINT8*)hdr + Entry->Offset));
+      CommonLibBinderSetMem (
+        (UINT8*)hdr + Offset,
+        (UINTN)ALIGN_POINTER (Offset, 8) - Offset,
+        (hdr->Attributes & EFI_FVB2_ERASE_POLARITY) ? 0xFF : 0
+        );
+      Offset = (UINTN)ALIGN_POINTER (Offset, 8);
+      if (Offset != Entry->Offset) {
+        CommonLibBinderCopyMem ((UINT8*)hdr + Offset, (UINT8*)hdr + Entry->Offset, FileSize);
+        Entry->Offset = Offset;
+      }
+      Offset = Offset + FileSize;
+    }
+
+    CommonLibBinderSetMem (
+      (UINT8*)hdr + Offset,
+      Builder->End - Offset,
+      (hdr->Attributes & EFI_FVB2_ERASE_POLARITY) ? 0xFF : 0
+      );
+  }
+
+  for (Index = 0; Index < Builder->FileCount; Index++) {
+    Entry = &Builder->Files[Index];
+    if (Entry->Added && !Entry->Removed) {
+      FvBufChecksumFile ((UINT8*)hdr + Entry->Offset);
+    }
+  }
+  FvBufChecksumHeader (hdr);
+
+  *Fv = hdr;
+  CommonLibBinderFree (Builder->Files);
+  CommonLibBinderFree (Builder);
+
+  return EFI_SUCCESS;
+}
+
+
 VOID
 FvBufCompact3ByteSize (
   OUT VOID* SizeDest,
@@ -26,6 +26,8 @@ Abstract:
 #include "Common/PiFirmwareFile.h"
 #include "Common/PiFirmwareVolume.h"
 
+typedef struct _FV_BUF_BUILDER FV_BUF_BUILDER;
+
 EFI_STATUS
 FvBufAddFile (
   IN OUT VOID *Fv,
@@ -44,6 +46,30 @@ FvBufAddVtfFile (
   IN VOID *File
   );
 
+EFI_STATUS
+FvBufBuilderAddFile (
+  IN OUT FV_BUF_BUILDER *Builder,
+  IN VOID *File
+  );
+
+EFI_STATUS
+FvBufBuilderFinalize (
+  IN FV_BUF_BUILDER *Builder,
+  OUT VOID **Fv
+  );
+
+EFI_STATUS
+FvBufBuilderOpen (
+  IN VOID *Fv,
+  OUT FV_BUF_BUILDER **Builder
+  );
+
+EFI_STATUS
+FvBufBuilderRemoveFile (
+  IN OUT FV_BUF_BUILDER *Builder,
+  IN EFI_GUID *Name
+  );
+
 EFI_STATUS
 FvBufChecksumFile (
   IN OUT VOID *FfsFile
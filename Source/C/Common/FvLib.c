@@ -22,6 +22,7 @@ Abstract:
 //
 // Include files
 //
+#include <stdlib.h>
 #include "FvLib.h"
 #include "CommonLib.h"
 #include "EfiUtilityMsgs.h"
@@ -32,6 +33,45 @@ Abstract:
 EFI_FIRMWARE_VOLUME_HEADER  *mFvHeader  = NULL;
 UINT32                      mFvLength   = 0;
 
+//
+// The index of an FV built by OpenFvIndex. Files lists the files in FV order,
+// NameTable is a hash table of their names holding file indexes plus one, and
+// TypeFiles groups the file indexes by type, TypeStart giving where each type
+// starts. Sections lists the sections of each file, from SectionStart, sorted
+// by type and otherwise in the order GetSectionByType counts them.
+//
+struct _FV_INDEX {
+  EFI_FIRMWARE_VOLUME_HEADER  *FvHeader;
+  UINT32                      FvLength;
+  UINTN                       FileCount;
+  EFI_FFS_FILE_HEADER         **Files;
+  UINTN                       *NameTable;
+  UINTN                       NameTableSize;
+  UINTN                       TypeStart[0x101];
+  UINTN                       *TypeFiles;
+  UINTN                       *SectionStart;
+  EFI_COMMON_SECTION_HEADER   **Sections;
+  UINTN                       SectionCount;
+  UINTN                       MaxSectionCount;
+};
+
+STATIC
+EFI_STATUS
+FindNextFile (
+  IN EFI_FIRMWARE_VOLUME_HEADER   *FvHeader,
+  IN UINT32                       FvLength,
+  IN BOOLEAN                      ErasePolarity,
+  IN EFI_FFS_FILE_HEADER          *CurrentFile,
+  OUT EFI_FFS_FILE_HEADER         **NextFile
+  );
+
+STATIC
+EFI_STATUS
+CheckFfsFile (
+  IN EFI_FFS_FILE_HEADER          *FfsHeader,
+  IN BOOLEAN                      ErasePolarity
+  );
+
 //
 // External function implementations
 //
@@ -141,6 +181,7 @@ Returns:
 --*/
 {
   EFI_STATUS  Status;
+  BOOLEAN     ErasePolarity;
 
   //
   // Verify library has been initialized.
@@ -161,16 +202,56 @@ Returns:
   if (EFI_ERROR (Status)) {
     return EFI_ABORTED;
   }
+  Status = GetErasePolarity (&ErasePolarity);
+  if (EFI_ERROR (Status)) {
+    return EFI_ABORTED;
+  }
+
+  return FindNextFile (mFvHeader, mFvLength, ErasePolarity, CurrentFile, NextFile);
+}
+
+STATIC
+EFI_STATUS
+FindNextFile (
+  IN EFI_FIRMWARE_VOLUME_HEADER   *FvHeader,
+  IN UINT32                       FvLength,
+  IN BOOLEAN                      ErasePolarity,
+  IN EFI_FFS_FILE_HEADER          *CurrentFile,
+  OUT EFI_FFS_FILE_HEADER         **NextFile
+  )
+/*++
+
+Routine Description:
+
+  GetNextFile for a given FV, whose header is already verified.
+
+Arguments:
+
+  FvHeader      The FV.
+  FvLength      Length of the FV
+  ErasePolarity The erase polarity of the FV.
+  CurrentFile   Pointer to the current file, must be within the FV.
+  NextFile      Pointer to the next file in the FV.
+    
+Returns:
+ 
+  EFI_SUCCESS             Function completed successfully.
+  EFI_INVALID_PARAMETER   The current file is out of range.
+
+--*/
+{
+  EFI_STATUS  Status;
+
   //
   // Get first file
   //
   if (CurrentFile == NULL) {
-    CurrentFile = (EFI_FFS_FILE_HEADER *) ((UINTN) mFvHeader + mFvHeader->HeaderLength);
+    CurrentFile = (EFI_FFS_FILE_HEADER *) ((UINTN) FvHeader + FvHeader->HeaderLength);
 
     //
     // Verify file is valid
     //
-    Status = VerifyFfsFile (CurrentFile);
+    Status = CheckFfsFile (CurrentFile, ErasePolarity);
     if (EFI_ERROR (Status)) {
       //
       // no files in this FV
@@ -181,7 +262,7 @@ Returns:
       //
       // Verify file is in this FV.
       //
-      if ((UINTN) CurrentFile + GetFfsFileLength(CurrentFile) > (UINTN) mFvHeader + mFvLength) {
+      if ((UINTN) CurrentFile + GetFfsFileLength(CurrentFile) > (UINTN) FvHeader + FvLength) {
         *NextFile = NULL;
         return EFI_SUCCESS;
       }
@@ -193,21 +274,21 @@ Returns:
   //
   // Verify current file is in range
   //
-  if (((UINTN) CurrentFile < (UINTN) mFvHeader + mFvHeader->HeaderLength) ||
-      ((UINTN) CurrentFile + GetFfsFileLength(CurrentFile) > (UINTN) mFvHeader + mFvLength)
+  if (((UINTN) CurrentFile < (UINTN) FvHeader + FvHeader->HeaderLength) ||
+      ((UINTN) CurrentFile + GetFfsFileLength(CurrentFile) > (UINTN) FvHeader + FvLength)
      ) {
     return EFI_INVALID_PARAMETER;
   }
   //
   // Get next file, compensate for 8 byte alignment if necessary.
   //
-  *NextFile = (EFI_FFS_FILE_HEADER *) ((((UINTN) CurrentFile - (UINTN) mFvHeader + GetFfsFileLength(CurrentFile) + 0x07) & (-1 << 3)) + (UINT8 *) mFvHeader);
+  *NextFile = (EFI_FFS_FILE_HEADER *) ((((UINTN) CurrentFile - (UINTN) FvHeader + GetFfsFileLength(CurrentFile) + 0x07) & (-1 << 3)) + (UINT8 *) FvHeader);
 
   //
   // Verify file is in this FV.
   //
-  if (((UINTN) *NextFile + GetFfsHeaderLength(*NextFile) >= (UINTN) mFvHeader + mFvLength) ||
-      ((UINTN) *NextFile + GetFfsFileLength (*NextFile) > (UINTN) mFvHeader + mFvLength)
+  if (((UINTN) *NextFile + GetFfsHeaderLength(*NextFile) >= (UINTN) FvHeader + FvLength) ||
+      ((UINTN) *NextFile + GetFfsFileLength (*NextFile) > (UINTN) FvHeader + FvLength)
      ) {
     *NextFile = NULL;
     return EFI_SUCCESS;
@@ -215,7 +296,7 @@ Returns:
   //
   // Verify file is valid
   //
-  Status = VerifyFfsFile (*NextFile);
+  Status = CheckFfsFile (*NextFile, ErasePolarity);
   if (EFI_ERROR (Status)) {
     //
     // no more files in this FV
@@ -573,6 +654,562 @@ Returns:
     return EFI_NOT_FOUND;
   }
 }
+STATIC
+UINTN
+HashFileName (
+  IN EFI_GUID                     *FileName,
+  IN UINTN                        TableSize
+  )
+/*++
+
+Routine Description:
+
+  Hash a file name into the name table of an FV index.
+
+Arguments:
+
+  FileName    The GUID file name.
+  TableSize   The size of the table, a power of two.
+
+Returns:
+
+  UINTN       The first slot to look at.
+
+--*/
+{
+  UINT32  Hash;
+
+  Hash = FileName->Data1 ^ ((UINT32) FileName->Data2 << 16 | FileName->Data3);
+  Hash ^= (UINT32) FileName->Data4[4] << 24 | (UINT32) FileName->Data4[5] << 16 | (UINT32) FileName->Data4[6] << 8 | FileName->Data4[7];
+  Hash *= 0x9E3779B1;
+  return (UINTN) (Hash ^ (Hash >> 16)) & (TableSize - 1);
+}
+
+STATIC
+EFI_STATUS
+IndexSections (
+  IN OUT FV_INDEX                 *FvIndex,
+  IN EFI_COMMON_SECTION_HEADER    *FirstSection,
+  IN UINT8                        *SearchEnd,
+  IN BOOLEAN                      Nested
+  )
+/*++
+
+Routine Description:
+
+  Append the sections from FirstSection to SearchEnd to the section list of
+  an FV index, walking them the way SearchSectionByType does. A GUID-defined
+  section within another one is walked but not listed, since searches for
+  GUID-defined sections do not look into GUID-defined sections. The data of
+  a GUID-defined section whose data offset is not past its header or is
+  beyond its end is not walked.
+
+Arguments:
+
+  FvIndex      The FV index.
+  FirstSection The first section.
+  SearchEnd    The end address of the sections.
+  Nested       TRUE if the sections are within a GUID-defined section.
+
+Returns:
+
+  EFI_SUCCESS             The sections are listed.
+  EFI_OUT_OF_RESOURCES    The section list cannot grow.
+
+--*/
+{
+  EFI_FILE_SECTION_POINTER  CurrentSection;
+  EFI_COMMON_SECTION_HEADER **Sections;
+  EFI_STATUS                Status;
+  UINTN                     SectionSize;
+  UINT16                    GuidSecAttr;
+  UINT16                    GuidDataOffset;
+  UINTN                     GuidHeaderSize;
+
+  CurrentSection.CommonHeader = FirstSection;
+
+  while ((UINTN) CurrentSection.CommonHeader + sizeof (EFI_COMMON_SECTION_HEADER) <= (UINTN) SearchEnd) {
+    SectionSize = GetSectionFileLength (CurrentSection.CommonHeader);
+    if (SectionSize < sizeof (EFI_COMMON_SECTION_HEADER)) {
+      break;
+    }
+
+    if (!Nested || CurrentSection.CommonHeader->Type != EFI_SECTION_GUID_DEFINED) {
+      if (FvIndex->SectionCount == FvIndex->MaxSectionCount) {
+        FvIndex->MaxSectionCount = FvIndex->MaxSectionCount == 0 ? 0x100 : FvIndex->MaxSectionCount * 2;
+        Sections = (EFI_COMMON_SECTION_HEADER **) realloc (FvIndex->Sections, FvIndex->MaxSectionCount * sizeof (EFI_COMMON_SECTION_HEADER *));
+        if (Sections == NULL) {
+          return EFI_OUT_OF_RESOURCES;
+        }
+        FvIndex->Sections = Sections;
+      }
+      FvIndex->Sections[FvIndex->SectionCount++] = CurrentSection.CommonHeader;
+    }
+
+    if (CurrentSection.CommonHeader->Type == EFI_SECTION_GUID_DEFINED) {
+      if (GetLength (CurrentSection.CommonHeader->Size) == 0xffffff) {
+        GuidSecAttr    = CurrentSection.GuidDefinedSection2->Attributes;
+        GuidDataOffset = CurrentSection.GuidDefinedSection2->DataOffset;
+        GuidHeaderSize = sizeof (EFI_GUID_DEFINED_SECTION2);
+      } else {
+        GuidSecAttr    = CurrentSection.GuidDefinedSection->Attributes;
+        GuidDataOffset = CurrentSection.GuidDefinedSection->DataOffset;
+        GuidHeaderSize = sizeof (EFI_GUID_DEFINED_SECTION);
+      }
+      if (!(GuidSecAttr & EFI_GUIDED_SECTION_PROCESSING_REQUIRED) &&
+          GuidDataOffset >= GuidHeaderSize && GuidDataOffset <= SectionSize) {
+        Status = IndexSections (
+                   FvIndex,
+                   (EFI_COMMON_SECTION_HEADER *) ((UINTN) CurrentSection.CommonHeader + GuidDataOffset),
+                   (UINT8 *) ((UINTN) CurrentSection.CommonHeader + SectionSize),
+                   TRUE
+                   );
+        if (EFI_ERROR (Status)) {
+          return Status;
+        }
+      }
+    }
+    //
+    // Find next section (including compensating for alignment issues.
+    //
+    CurrentSection.CommonHeader = (EFI_COMMON_SECTION_HEADER *) ((((UINTN) CurrentSection.CommonHeader) + SectionSize + 0x03) & (-1 << 2));
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+IndexFileSections (
+  IN OUT FV_INDEX                 *FvIndex
+  )
+/*++
+
+Routine Description:
+
+  List the sections of each file of an FV index, then sort them by type.
+  The sort is stable, so sections of one type stay in the order they are
+  counted. Raw and pad files have no sections and get an empty list.
+
+Arguments:
+
+  FvIndex      The FV index.
+
+Returns:
+
+  EFI_SUCCESS             The sections are indexed.
+  EFI_OUT_OF_RESOURCES    Memory cannot be allocated for the section list.
+
+--*/
+{
+  EFI_FFS_FILE_HEADER         *CurrentFile;
+  EFI_COMMON_SECTION_HEADER   *Section;
+  EFI_STATUS                  Status;
+  UINTN                       Index;
+  UINTN                       Slot;
+  UINTN                       First;
+  UINTN                       Current;
+
+  FvIndex->SectionStart = (UINTN *) malloc ((FvIndex->FileCount + 1) * sizeof (UINTN));
+  if (FvIndex->SectionStart == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < FvIndex->FileCount; Index++) {
+    FvIndex->SectionStart[Index] = FvIndex->SectionCount;
+    CurrentFile = FvIndex->Files[Index];
+    if (CurrentFile->Type == EFI_FV_FILETYPE_ALL ||
+        CurrentFile->Type == EFI_FV_FILETYPE_RAW ||
+        CurrentFile->Type == EFI_FV_FILETYPE_FFS_PAD) {
+      continue;
+    }
+    Status = IndexSections (
+               FvIndex,
+               (EFI_COMMON_SECTION_HEADER *) ((UINTN) CurrentFile + GetFfsHeaderLength (CurrentFile)),
+               (UINT8 *) ((UINTN) CurrentFile + GetFfsFileLength (CurrentFile)),
+               FALSE
+               );
+    if (EFI_ERROR (Status)) {
+      free (FvIndex->SectionStart);
+      FvIndex->SectionStart = NULL;
+      FvIndex->SectionCount = 0;
+      return Status;
+    }
+    First = FvIndex->SectionStart[Index];
+    for (Current = First + 1; Current < FvIndex->SectionCount; Current++) {
+      Section = FvIndex->Sections[Current];
+      for (Slot = Current; Slot > First && FvIndex->Sections[Slot - 1]->Type > Section->Type; Slot--) {
+        FvIndex->Sections[Slot] = FvIndex->Sections[Slot - 1];
+      }
+      FvIndex->Sections[Slot] = Section;
+    }
+  }
+  FvIndex->SectionStart[FvIndex->FileCount] = FvIndex->SectionCount;
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+OpenFvIndex (
+  IN VOID                         *Fv,
+  IN UINT32                       FvLength,
+  OUT FV_INDEX                    **FvIndex
+  )
+/*++
+
+Routine Description:
+
+  Walk an FV once and index its files by name and type. The sections of
+  each file are indexed by type on the first GetIndexedSectionByType call.
+  The files are those GetNextFile returns. Unlike the functions working on
+  the FV given to InitializeFvLib, an index uses no global state, so several
+  FVs can be indexed at once and an index can be searched from several
+  threads once its sections are indexed. The FV must not change while it is
+  indexed.
+
+Arguments:
+
+  Fv            Buffer containing the FV.
+  FvLength      Length of the FV
+  FvIndex       Receives the index, to be released with CloseFvIndex.
+
+Returns:
+
+  EFI_SUCCESS             Function completed successfully.
+  EFI_INVALID_PARAMETER   A required parameter was NULL.
+  EFI_ABORTED             The FV header is not valid.
+  EFI_OUT_OF_RESOURCES    Memory cannot be allocated for the index.
+
+--*/
+{
+  EFI_FIRMWARE_VOLUME_HEADER  *FvHeader;
+  EFI_FFS_FILE_HEADER         *CurrentFile;
+  EFI_FFS_FILE_HEADER         **Files;
+  FV_INDEX                    *NewIndex;
+  EFI_STATUS                  Status;
+  BOOLEAN                     ErasePolarity;
+  UINTN                       MaxFileCount;
+  UINTN                       Index;
+  UINTN                       Slot;
+  UINTN                       TypeNext[0x100];
+
+  //
+  // Verify input parameters
+  //
+  if (Fv == NULL || FvLength == 0 || FvIndex == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  FvHeader = (EFI_FIRMWARE_VOLUME_HEADER *) Fv;
+  if (EFI_ERROR (VerifyFv (FvHeader))) {
+    return EFI_ABORTED;
+  }
+  ErasePolarity = (BOOLEAN) ((FvHeader->Attributes & EFI_FVB2_ERASE_POLARITY) != 0);
+
+  NewIndex = (FV_INDEX *) calloc (1, sizeof (FV_INDEX));
+  if (NewIndex == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  NewIndex->FvHeader = FvHeader;
+  NewIndex->FvLength = FvLength;
+
+  //
+  // List the files in FV order.
+  //
+  MaxFileCount = 0;
+  Status = FindNextFile (FvHeader, FvLength, ErasePolarity, NULL, &CurrentFile);
+  while (!EFI_ERROR (Status) && CurrentFile != NULL) {
+    if (NewIndex->FileCount == MaxFileCount) {
+      MaxFileCount = MaxFileCount == 0 ? 0x40 : MaxFileCount * 2;
+      Files = (EFI_FFS_FILE_HEADER **) realloc (NewIndex->Files, MaxFileCount * sizeof (EFI_FFS_FILE_HEADER *));
+      if (Files == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Done;
+      }
+      NewIndex->Files = Files;
+    }
+    NewIndex->Files[NewIndex->FileCount++] = CurrentFile;
+    Status = FindNextFile (FvHeader, FvLength, ErasePolarity, CurrentFile, &CurrentFile);
+  }
+  if (EFI_ERROR (Status)) {
+    Status = EFI_ABORTED;
+    goto Done;
+  }
+
+  //
+  // Hash the file names. The first of several files with the same name is
+  // the one found, as GetFileByName does.
+  //
+  NewIndex->NameTableSize = 0x10;
+  while (NewIndex->NameTableSize < NewIndex->FileCount * 2) {
+    NewIndex->NameTableSize *= 2;
+  }
+  NewIndex->NameTable = (UINTN *) calloc (NewIndex->NameTableSize, sizeof (UINTN));
+  NewIndex->TypeFiles = (UINTN *) malloc ((NewIndex->FileCount + 1) * sizeof (UINTN));
+  if (NewIndex->NameTable == NULL || NewIndex->TypeFiles == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+  for (Index = 0; Index < NewIndex->FileCount; Index++) {
+    Slot = HashFileName (&NewIndex->Files[Index]->Name, NewIndex->NameTableSize);
+    while (NewIndex->NameTable[Slot] != 0 &&
+           CompareGuid (&NewIndex->Files[NewIndex->NameTable[Slot] - 1]->Name, &NewIndex->Files[Index]->Name) != 0) {
+      Slot = (Slot + 1) & (NewIndex->NameTableSize - 1);
+    }
+    if (NewIndex->NameTable[Slot] == 0) {
+      NewIndex->NameTable[Slot] = Index + 1;
+    }
+  }
+
+  //
+  // Group the files by type, keeping the FV order within each type.
+  //
+  for (Index = 0; Index < NewIndex->FileCount; Index++) {
+    NewIndex->TypeStart[NewIndex->Files[Index]->Type + 1]++;
+  }
+  for (Index = 0; Index < 0x100; Index++) {
+    NewIndex->TypeStart[Index + 1] += NewIndex->TypeStart[Index];
+    TypeNext[Index] = NewIndex->TypeStart[Index];
+  }
+  for (Index = 0; Index < NewIndex->FileCount; Index++) {
+    NewIndex->TypeFiles[TypeNext[NewIndex->Files[Index]->Type]++] = Index;
+  }
+
+  Status = EFI_SUCCESS;
+
+Done:
+  if (EFI_ERROR (Status)) {
+    CloseFvIndex (NewIndex);
+    return Status;
+  }
+  *FvIndex = NewIndex;
+  return EFI_SUCCESS;
+}
+
+VOID
+CloseFvIndex (
+  IN FV_INDEX                     *FvIndex
+  )
+/*++
+
+Routine Description:
+
+  Release an index built by OpenFvIndex.
+
+Arguments:
+
+  FvIndex     The index, or NULL.
+
+Returns:
+
+  None
+
+--*/
+{
+  if (FvIndex == NULL) {
+    return;
+  }
+  if (FvIndex->Files != NULL) {
+    free (FvIndex->Files);
+  }
+  if (FvIndex->NameTable != NULL) {
+    free (FvIndex->NameTable);
+  }
+  if (FvIndex->TypeFiles != NULL) {
+    free (FvIndex->TypeFiles);
+  }
+  if (FvIndex->SectionStart != NULL) {
+    free (FvIndex->SectionStart);
+  }
+  if (FvIndex->Sections != NULL) {
+    free (FvIndex->Sections);
+  }
+  free (FvIndex);
+}
+
+EFI_STATUS
+GetIndexedFileByName (
+  IN FV_INDEX                     *FvIndex,
+  IN EFI_GUID                     *FileName,
+  OUT EFI_FFS_FILE_HEADER         **File
+  )
+/*++
+
+Routine Description:
+
+  GetFileByName for an indexed FV.
+
+Arguments:
+
+  FvIndex     The FV index.
+  FileName    The GUID file name of the file to search for.
+  File        Return pointer, NULL if the file is not found.
+
+Returns:
+
+  EFI_SUCCESS             The function completed successfully.
+  EFI_INVALID_PARAMETER   One of the parameters was NULL.
+
+--*/
+{
+  UINTN   Slot;
+
+  if (FvIndex == NULL || FileName == NULL || File == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Slot = HashFileName (FileName, FvIndex->NameTableSize);
+  while (FvIndex->NameTable[Slot] != 0) {
+    if (CompareGuid (&FvIndex->Files[FvIndex->NameTable[Slot] - 1]->Name, FileName) == 0) {
+      *File = FvIndex->Files[FvIndex->NameTable[Slot] - 1];
+      return EFI_SUCCESS;
+    }
+    Slot = (Slot + 1) & (FvIndex->NameTableSize - 1);
+  }
+
+  *File = NULL;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+GetIndexedFileByType (
+  IN FV_INDEX                     *FvIndex,
+  IN EFI_FV_FILETYPE              FileType,
+  IN UINTN                        Instance,
+  OUT EFI_FFS_FILE_HEADER         **File
+  )
+/*++
+
+Routine Description:
+
+  GetFileByType for an indexed FV. An instance of 1 is the first instance.
+  File type EFI_FV_FILETYPE_ALL means any file type is valid, in which case
+  the files are returned in FV order.
+
+Arguments:
+
+  FvIndex     The FV index.
+  FileType    Type of file to search for.
+  Instance    Instance of the file type to return.
+  File        Return pointer, NULL if a matching file cannot be found.
+
+Returns:
+
+  EFI_SUCCESS             The function completed successfully.
+  EFI_INVALID_PARAMETER   One of the parameters was NULL.
+
+--*/
+{
+  if (FvIndex == NULL || File == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *File = NULL;
+  if (Instance == 0) {
+    return EFI_SUCCESS;
+  }
+  if (FileType == EFI_FV_FILETYPE_ALL) {
+    if (Instance <= FvIndex->FileCount) {
+      *File = FvIndex->Files[Instance - 1];
+    }
+  } else if (Instance <= FvIndex->TypeStart[FileType + 1] - FvIndex->TypeStart[FileType]) {
+    *File = FvIndex->Files[FvIndex->TypeFiles[FvIndex->TypeStart[FileType] + Instance - 1]];
+  }
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+GetIndexedSectionByType (
+  IN FV_INDEX                     *FvIndex,
+  IN EFI_FFS_FILE_HEADER          *File,
+  IN EFI_SECTION_TYPE             SectionType,
+  IN UINTN                        Instance,
+  OUT EFI_FILE_SECTION_POINTER    *Section
+  )
+/*++
+
+Routine Description:
+
+  GetSectionByType for a file of an indexed FV. The first call indexes the
+  sections of all the files, so it must not run alongside other searches.
+
+Arguments:
+
+  FvIndex     The FV index.
+  File        The file to search, a file of the indexed FV.
+  SectionType Type of section to search for.
+  Instance    Instance of the section to return.
+  Section     Return pointer.  In the case of an error, contents are undefined.
+
+Returns:
+
+  EFI_SUCCESS             The function completed successfully.
+  EFI_INVALID_PARAMETER   One of the parameters was NULL, or File is not
+                          a file of the indexed FV.
+  EFI_NOT_FOUND           No found.
+  EFI_OUT_OF_RESOURCES    The sections cannot be indexed.
+
+--*/
+{
+  EFI_STATUS  Status;
+  UINTN       Low;
+  UINTN       High;
+  UINTN       Middle;
+  UINTN       FileEnd;
+
+  if (FvIndex == NULL || File == NULL || Section == NULL || Instance == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (FvIndex->SectionStart == NULL) {
+    Status = IndexFileSections (FvIndex);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  //
+  // Find the file, the files are in address order.
+  //
+  Low  = 0;
+  High = FvIndex->FileCount;
+  while (Low < High) {
+    Middle = (Low + High) / 2;
+    if ((UINTN) FvIndex->Files[Middle] < (UINTN) File) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
+  }
+  if (Low == FvIndex->FileCount || FvIndex->Files[Low] != File) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Find the first section of the type in the file.
+  //
+  FileEnd = FvIndex->SectionStart[Low + 1];
+  High    = FileEnd;
+  Low     = FvIndex->SectionStart[Low];
+  while (Low < High) {
+    Middle = (Low + High) / 2;
+    if (FvIndex->Sections[Middle]->Type < SectionType) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
+  }
+  if (Instance - 1 < FileEnd - Low && FvIndex->Sections[Low + Instance - 1]->Type == SectionType) {
+    Section->CommonHeader = FvIndex->Sections[Low + Instance - 1];
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Section not found
+  //
+  (*Section).Code16Section = NULL;
+  return EFI_NOT_FOUND;
+}
+
 //
 // will not parse compressed sections
 //
@@ -650,13 +1287,6 @@ Returns:
 {
   BOOLEAN             ErasePolarity;
   EFI_STATUS          Status;
-  EFI_FFS_FILE_HEADER2 BlankHeader;
-  UINT8               Checksum;
-  UINT32              FileLength;
-  UINT8               SavedChecksum;
-  UINT8               SavedState;
-  UINT8               FileGuidString[80];
-  UINT32              FfsHeaderSize;
 
   //
   // Verify library has been initialized.
@@ -679,6 +1309,42 @@ Returns:
     return EFI_ABORTED;
   }
 
+  return CheckFfsFile (FfsHeader, ErasePolarity);
+}
+
+STATIC
+EFI_STATUS
+CheckFfsFile (
+  IN EFI_FFS_FILE_HEADER          *FfsHeader,
+  IN BOOLEAN                      ErasePolarity
+  )
+/*++
+
+Routine Description:
+
+  VerifyFfsFile for a file of an FV with the given erase polarity.
+
+Arguments:
+
+  FfsHeader     Pointer to an alleged FFS file.
+  ErasePolarity The erase polarity of the FV.
+
+Returns:
+
+  EFI_SUCCESS           The Ffs header is valid.
+  EFI_NOT_FOUND         This "file" is the beginning of free space.
+  EFI_ABORTED           The Ffs header is not valid.
+
+--*/
+{
+  EFI_FFS_FILE_HEADER2 BlankHeader;
+  UINT8               Checksum;
+  UINT32              FileLength;
+  UINT8               SavedChecksum;
+  UINT8               SavedState;
+  UINT8               FileGuidString[80];
+  UINT32              FfsHeaderSize;
+
   FfsHeaderSize = GetFfsHeaderLength(FfsHeader);
   //
   // Check if we have free space
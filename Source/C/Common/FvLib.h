@@ -75,6 +75,52 @@ GetSectionByType (
   OUT EFI_FILE_SECTION_POINTER    *Section
   )
 ;
+
+//
+// An index of the files and sections of an FV, see OpenFvIndex.
+//
+typedef struct _FV_INDEX FV_INDEX;
+
+EFI_STATUS
+OpenFvIndex (
+  IN VOID                         *Fv,
+  IN UINT32                       FvLength,
+  OUT FV_INDEX                    **FvIndex
+  )
+;
+
+VOID
+CloseFvIndex (
+  IN FV_INDEX                     *FvIndex
+  )
+;
+
+EFI_STATUS
+GetIndexedFileByName (
+  IN FV_INDEX                     *FvIndex,
+  IN EFI_GUID                     *FileName,
+  OUT EFI_FFS_FILE_HEADER         **File
+  )
+;
+
+EFI_STATUS
+GetIndexedFileByType (
+  IN FV_INDEX                     *FvIndex,
+  IN EFI_FV_FILETYPE              FileType,
+  IN UINTN                        Instance,
+  OUT EFI_FFS_FILE_HEADER         **File
+  )
+;
+
+EFI_STATUS
+GetIndexedSectionByType (
+  IN FV_INDEX                     *FvIndex,
+  IN EFI_FFS_FILE_HEADER          *File,
+  IN EFI_SECTION_TYPE             SectionType,
+  IN UINTN                        Instance,
+  OUT EFI_FILE_SECTION_POINTER    *Section
+  )
+;
 //
 // will not parse compressed sections
 //
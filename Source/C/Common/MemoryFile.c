@@ -19,6 +19,17 @@ Abstract:
 
 **/
 
+#include "WinNtInclude.h"
+
+#ifndef __GNUC__
+#include <windows.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>
@@ -26,6 +37,26 @@ Abstract:
 #include "CommonLib.h"
 #include "MemoryFile.h"
 
+#ifndef __GNUC__
+#define getpid  _getpid
+#endif
+
+//
+// Temporary files of CreateMappedFile are named OutputFileName.Pid.Count.tmp,
+// unique to the process and the call, so that concurrent builds of the same
+// output never share one.
+//
+#define TEMP_FILE_SUFFIX_FORMAT   ".%u.%u.tmp"
+#define TEMP_FILE_SUFFIX_LENGTH   (sizeof (".4294967295.4294967295.tmp") - 1)
+
+#ifdef __GNUC__
+#define NEXT_TEMP_NUMBER()  __sync_fetch_and_add (&mTempFileCount, 1)
+#else
+#define NEXT_TEMP_NUMBER()  InterlockedIncrement ((volatile LONG *) &mTempFileCount)
+#endif
+
+STATIC volatile UINT32 mTempFileCount = 0;
+
 
 //
 // Local (static) function prototypes
@@ -258,3 +289,365 @@ CheckMemoryFileState (
 }
 
 
+STATIC
+EFI_STATUS
+ReadWholeFile (
+  IN CHAR8         *InputFileName,
+  OUT MAPPED_FILE  *MappedFile
+  )
+/*++
+
+Routine Description:
+
+  Fallback for OpenMappedFile that reads the file into allocated memory.
+
+Arguments:
+
+  InputFileName      The file to read.
+  MappedFile         Receives the file contents.
+
+Returns:
+
+  EFI_SUCCESS            The file is read.
+  EFI_NOT_FOUND          The file could not be opened.
+  EFI_ABORTED            The file could not be read.
+  EFI_OUT_OF_RESOURCES   Memory allocation failed.
+
+--*/
+{
+  FILE    *InputFile;
+  UINTN   FileSize;
+
+  InputFile = fopen (InputFileName, "rb");
+  if (InputFile == NULL) {
+    return EFI_NOT_FOUND;
+  }
+  FileSize = _filelength (fileno (InputFile));
+
+  MappedFile->Data = malloc (FileSize + 1);
+  if (MappedFile->Data == NULL) {
+    fclose (InputFile);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  if (fread (MappedFile->Data, 1, FileSize, InputFile) != FileSize) {
+    fclose (InputFile);
+    free (MappedFile->Data);
+    MappedFile->Data = NULL;
+    return EFI_ABORTED;
+  }
+  fclose (InputFile);
+
+  MappedFile->Size   = FileSize;
+  MappedFile->Mapped = FALSE;
+  return EFI_SUCCESS;
+}
+
+
+EFI_STATUS
+OpenMappedFile (
+  IN CHAR8         *InputFileName,
+  OUT MAPPED_FILE  *MappedFile
+  )
+/*++
+
+Routine Description:
+
+  This maps an existing file into memory. The view is copy-on-write:
+  changes made through Data are private to the process and never reach
+  the file, and only the pages written are copied.
+
+Arguments:
+
+  InputFileName      The file to map.
+  MappedFile         Receives the view of the file.
+
+Returns:
+
+  EFI_SUCCESS            The file is mapped.
+  EFI_NOT_FOUND          The file could not be opened.
+  EFI_ABORTED            The file could not be read.
+  EFI_OUT_OF_RESOURCES   Memory allocation failed.
+
+--*/
+{
+#ifndef __GNUC__
+  HANDLE        FileHandle;
+  HANDLE        MapHandle;
+  LARGE_INTEGER FileSize;
+#else
+  int           Fd;
+  struct stat   StatBuf;
+#endif
+  VOID          *View;
+
+  memset (MappedFile, 0, sizeof (MAPPED_FILE));
+
+#ifndef __GNUC__
+  FileHandle = CreateFileA (InputFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (FileHandle == INVALID_HANDLE_VALUE) {
+    return EFI_NOT_FOUND;
+  }
+  if (!GetFileSizeEx (FileHandle, &FileSize) || FileSize.QuadPart == 0 || (UINT64) FileSize.QuadPart != (UINTN) FileSize.QuadPart) {
+    CloseHandle (FileHandle);
+    return ReadWholeFile (InputFileName, MappedFile);
+  }
+  MapHandle = CreateFileMappingA (FileHandle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  View      = NULL;
+  if (MapHandle != NULL) {
+    View = MapViewOfFile (MapHandle, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle (MapHandle);
+  }
+  CloseHandle (FileHandle);
+  if (View == NULL) {
+    return ReadWholeFile (InputFileName, MappedFile);
+  }
+  MappedFile->Size = (UINTN) FileSize.QuadPart;
+#else
+  Fd = open (InputFileName, O_RDONLY);
+  if (Fd < 0) {
+    return EFI_NOT_FOUND;
+  }
+  if (fstat (Fd, &StatBuf) != 0 || !S_ISREG (StatBuf.st_mode) || StatBuf.st_size == 0 ||
+      (UINT64) StatBuf.st_size != (UINTN) StatBuf.st_size) {
+    close (Fd);
+    return ReadWholeFile (InputFileName, MappedFile);
+  }
+  View = mmap (NULL, (size_t) StatBuf.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, Fd, 0);
+  close (Fd);
+  if (View == MAP_FAILED) {
+    return ReadWholeFile (InputFileName, MappedFile);
+  }
+  MappedFile->Size = (UINTN) StatBuf.st_size;
+#endif
+
+  MappedFile->Data   = (UINT8 *) View;
+  MappedFile->Mapped = TRUE;
+  return EFI_SUCCESS;
+}
+
+
+EFI_STATUS
+CreateMappedFile (
+  IN CHAR8         *OutputFileName,
+  IN UINTN         Size,
+  OUT MAPPED_FILE  *MappedFile
+  )
+/*++
+
+Routine Description:
+
+  This creates a file of the given size, with its disk space allocated up
+  front, and maps it into memory for writing. The data is written to a
+  temporary file next to OutputFileName, with a name unique to the process
+  and the call, which replaces OutputFileName only when CloseMappedFile
+  commits it.
+
+Arguments:
+
+  OutputFileName     The file to create.
+  Size               The size of the file.
+  MappedFile         Receives the writable view of the file.
+
+Returns:
+
+  EFI_SUCCESS            The file is created and mapped.
+  EFI_ABORTED            The file could not be created, or its name is
+                         longer than _MAX_PATH.
+  EFI_OUT_OF_RESOURCES   Memory allocation failed.
+
+--*/
+{
+#ifndef __GNUC__
+  HANDLE        FileHandle;
+  HANDLE        MapHandle;
+#else
+  int           Fd;
+#endif
+  VOID          *View;
+  UINTN         NameLength;
+  int           TempNameLength;
+
+  NameLength = strlen (OutputFileName);
+  if (NameLength + TEMP_FILE_SUFFIX_LENGTH >= _MAX_PATH) {
+    return EFI_ABORTED;
+  }
+
+  memset (MappedFile, 0, sizeof (MAPPED_FILE));
+  MappedFile->Output       = TRUE;
+  MappedFile->Size         = Size;
+  MappedFile->FileName     = malloc (NameLength + 1);
+  MappedFile->TempFileName = malloc (NameLength + TEMP_FILE_SUFFIX_LENGTH + 1);
+  if (MappedFile->FileName == NULL || MappedFile->TempFileName == NULL) {
+    free (MappedFile->FileName);
+    free (MappedFile->TempFileName);
+    memset (MappedFile, 0, sizeof (MAPPED_FILE));
+    return EFI_OUT_OF_RESOURCES;
+  }
+  strcpy (MappedFile->FileName, OutputFileName);
+  TempNameLength = sprintf (
+                     MappedFile->TempFileName,
+                     "%s" TEMP_FILE_SUFFIX_FORMAT,
+                     OutputFileName,
+                     (unsigned) getpid (),
+                     (unsigned) NEXT_TEMP_NUMBER ()
+                     );
+  if (TempNameLength < 0 || (UINTN) TempNameLength > NameLength + TEMP_FILE_SUFFIX_LENGTH) {
+    free (MappedFile->FileName);
+    free (MappedFile->TempFileName);
+    memset (MappedFile, 0, sizeof (MAPPED_FILE));
+    return EFI_ABORTED;
+  }
+
+  View = NULL;
+#ifndef __GNUC__
+  FileHandle = CreateFileA (MappedFile->TempFileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (FileHandle == INVALID_HANDLE_VALUE) {
+    free (MappedFile->FileName);
+    free (MappedFile->TempFileName);
+    memset (MappedFile, 0, sizeof (MAPPED_FILE));
+    return EFI_ABORTED;
+  }
+  //
+  // Creating the mapping extends the file to its full size
+  //
+  MapHandle = NULL;
+  if (Size != 0) {
+    MapHandle = CreateFileMappingA (FileHandle, NULL, PAGE_READWRITE, (DWORD) ((UINT64) Size >> 32), (DWORD) Size, NULL);
+  }
+  if (MapHandle != NULL) {
+    View = MapViewOfFile (MapHandle, FILE_MAP_WRITE, 0, 0, Size);
+    CloseHandle (MapHandle);
+  }
+  MappedFile->FileHandle = (UINTN) FileHandle;
+#else
+  Fd = open (MappedFile->TempFileName, O_RDWR | O_CREAT | O_EXCL, 0666);
+  if (Fd < 0) {
+    free (MappedFile->FileName);
+    free (MappedFile->TempFileName);
+    memset (MappedFile, 0, sizeof (MAPPED_FILE));
+    return EFI_ABORTED;
+  }
+  MappedFile->FileHandle = (UINTN) Fd;
+  //
+  // Allocate the blocks now, so that running out of disk space is an error
+  // here rather than a fault while writing through the mapping.
+  //
+#ifdef __linux__
+  if (Size != 0 && posix_fallocate (Fd, 0, (off_t) Size) == 0) {
+#else
+  if (Size != 0 && ftruncate (Fd, (off_t) Size) == 0) {
+#endif
+    View = mmap (NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0);
+    if (View == MAP_FAILED) {
+      View = NULL;
+    }
+  }
+#endif
+
+  if (View != NULL) {
+    MappedFile->Data   = (UINT8 *) View;
+    MappedFile->Mapped = TRUE;
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Build the contents in memory and write them out when committed
+  //
+  MappedFile->Data = malloc (Size + 1);
+  if (MappedFile->Data == NULL) {
+    CloseMappedFile (MappedFile, FALSE);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  return EFI_SUCCESS;
+}
+
+
+EFI_STATUS
+CloseMappedFile (
+  IN OUT MAPPED_FILE  *MappedFile,
+  IN BOOLEAN          Commit
+  )
+/*++
+
+Routine Description:
+
+  This releases a view created by OpenMappedFile or CreateMappedFile.
+  For a file from CreateMappedFile, Commit selects whether the new file
+  replaces the requested output file or is discarded. Closing a view that
+  was never opened, or is already closed, does nothing.
+
+Arguments:
+
+  MappedFile         The view to release.
+  Commit             TRUE to keep a created file, FALSE to delete it.
+
+Returns:
+
+  EFI_SUCCESS            The view is released and the file committed if requested.
+  EFI_ABORTED            The created file could not be written or renamed.
+
+--*/
+{
+  EFI_STATUS  Status;
+  UINTN       Written;
+#ifdef __GNUC__
+  ssize_t     Count;
+#else
+  DWORD       Count;
+#endif
+
+  Status = EFI_SUCCESS;
+
+  if (MappedFile->Output && !MappedFile->Mapped && MappedFile->Data != NULL && Commit) {
+    for (Written = 0; Written < MappedFile->Size; Written += Count) {
+#ifdef __GNUC__
+      Count = write ((int) MappedFile->FileHandle, MappedFile->Data + Written, MappedFile->Size - Written);
+      if (Count <= 0) {
+#else
+      if (!WriteFile ((HANDLE) MappedFile->FileHandle, MappedFile->Data + Written, (DWORD) (MappedFile->Size - Written), &Count, NULL) || Count == 0) {
+#endif
+        Status = EFI_ABORTED;
+        break;
+      }
+    }
+  }
+
+  if (MappedFile->Data != NULL) {
+    if (!MappedFile->Mapped) {
+      free (MappedFile->Data);
+    } else {
+#ifndef __GNUC__
+      UnmapViewOfFile (MappedFile->Data);
+#else
+      munmap (MappedFile->Data, MappedFile->Size);
+#endif
+    }
+  }
+
+  if (MappedFile->Output) {
+#ifndef __GNUC__
+    CloseHandle ((HANDLE) MappedFile->FileHandle);
+#else
+    if (close ((int) MappedFile->FileHandle) != 0) {
+      Status = EFI_ABORTED;
+    }
+#endif
+    if (Commit && Status == EFI_SUCCESS) {
+#ifndef __GNUC__
+      if (!MoveFileExA (MappedFile->TempFileName, MappedFile->FileName, MOVEFILE_REPLACE_EXISTING)) {
+#else
+      if (rename (MappedFile->TempFileName, MappedFile->FileName) != 0) {
+#endif
+        Status = EFI_ABORTED;
+      }
+    }
+    if (!Commit || Status != EFI_SUCCESS) {
+      remove (MappedFile->TempFileName);
+    }
+    free (MappedFile->FileName);
+    free (MappedFile->TempFileName);
+  }
+
+  memset (MappedFile, 0, sizeof (MAPPED_FILE));
+  return Status;
+}
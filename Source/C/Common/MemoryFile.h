@@ -39,6 +39,23 @@ typedef struct {
   CHAR8 *CurrentFilePointer;
 } MEMORY_FILE;
 
+//
+// A file whose contents are accessed in place through a memory mapping.
+// Data and Size describe the contents; the other fields are private to the
+// mapped file functions. Where a file cannot be mapped, its contents are
+// kept in allocated memory instead and callers see no difference.
+//
+typedef struct {
+  UINT8   *Data;
+  UINTN   Size;
+  BOOLEAN Mapped;
+  BOOLEAN Output;
+  UINTN   FileHandle;
+  UINTN   MapHandle;
+  CHAR8   *FileName;
+  CHAR8   *TempFileName;
+} MAPPED_FILE;
+
 
 //
 // Functions declarations
@@ -119,4 +136,92 @@ Returns:
 **/
 
 
+EFI_STATUS
+OpenMappedFile (
+  IN CHAR8         *InputFileName,
+  OUT MAPPED_FILE  *MappedFile
+  )
+;
+/**
+
+Routine Description:
+
+  This maps an existing file into memory. The view is copy-on-write:
+  changes made through Data are private to the process and never reach
+  the file, and only the pages written are copied.
+
+Arguments:
+
+  InputFileName      The file to map.
+  MappedFile         Receives the view of the file.
+
+Returns:
+
+  EFI_SUCCESS            The file is mapped.
+  EFI_NOT_FOUND          The file could not be opened.
+  EFI_ABORTED            The file could not be read.
+  EFI_OUT_OF_RESOURCES   Memory allocation failed.
+
+**/
+
+
+EFI_STATUS
+CreateMappedFile (
+  IN CHAR8         *OutputFileName,
+  IN UINTN         Size,
+  OUT MAPPED_FILE  *MappedFile
+  )
+;
+/**
+
+Routine Description:
+
+  This creates a file of the given size, with its disk space allocated up
+  front, and maps it into memory for writing. The data is written to a
+  temporary file next to OutputFileName, which replaces OutputFileName
+  only when CloseMappedFile commits it.
+
+Arguments:
+
+  OutputFileName     The file to create.
+  Size               The size of the file.
+  MappedFile         Receives the writable view of the file.
+
+Returns:
+
+  EFI_SUCCESS            The file is created and mapped.
+  EFI_ABORTED            The file could not be created.
+  EFI_OUT_OF_RESOURCES   Memory allocation failed.
+
+**/
+
+
+EFI_STATUS
+CloseMappedFile (
+  IN OUT MAPPED_FILE  *MappedFile,
+  IN BOOLEAN          Commit
+  )
+;
+/**
+
+Routine Description:
+
+  This releases a view created by OpenMappedFile or CreateMappedFile.
+  For a file from CreateMappedFile, Commit selects whether the new file
+  replaces the requested output file or is discarded. Closing a view that
+  was never opened, or is already closed, does nothing.
+
+Arguments:
+
+  MappedFile         The view to release.
+  Commit             TRUE to keep a created file, FALSE to delete it.
+
+Returns:
+
+  EFI_SUCCESS            The view is released and the file committed if requested.
+  EFI_ABORTED            The created file could not be written or renamed.
+
+**/
+
+
 #endif
@@ -71,6 +71,14 @@ typedef struct {
   UINT16                            ImageType;
   BOOLEAN                           RelocationsStripped;
   BOOLEAN                           IsTeImage;
+  //
+  // Relocation statistics of the image, set by PeCoffLoaderRelocateImage.
+  // FastFixupCount counts the HIGHLOW and DIR64 entries applied in runs,
+  // GenericFixupCount the entries dispatched one at a time.
+  //
+  UINT32                            RelocBlockCount;
+  UINT32                            FastFixupCount;
+  UINT32                            GenericFixupCount;
 } PE_COFF_LOADER_IMAGE_CONTEXT;
 
 
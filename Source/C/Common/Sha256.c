@@ -0,0 +1,257 @@
+/** @file
+
+Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+Module Name:
+
+  Sha256.c
+
+Abstract:
+
+  Incremental SHA-256 (FIPS 180-4) routines.
+
+**/
+
+#include <string.h>
+#include "Sha256.h"
+
+#define ROTR32(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+
+STATIC CONST UINT32 mSha256K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+STATIC
+VOID
+Sha256Transform (
+  IN OUT UINT32       *State,
+  IN     CONST UINT8  *Block
+  )
+/*++
+
+Routine Description:
+
+  Process one 64 byte block.
+
+Arguments:
+
+  State       - The eight word hash state to update
+  Block       - The next 64 bytes of the message
+
+Returns:
+
+  None
+
+--*/
+{
+  UINT32  W[64];
+  UINT32  A;
+  UINT32  B;
+  UINT32  C;
+  UINT32  D;
+  UINT32  E;
+  UINT32  F;
+  UINT32  G;
+  UINT32  H;
+  UINT32  T1;
+  UINT32  T2;
+  UINTN   Index;
+
+  for (Index = 0; Index < 16; Index++) {
+    W[Index] = ((UINT32) Block[Index * 4] << 24) |
+               ((UINT32) Block[Index * 4 + 1] << 16) |
+               ((UINT32) Block[Index * 4 + 2] << 8) |
+               (UINT32) Block[Index * 4 + 3];
+  }
+  for (; Index < 64; Index++) {
+    T1 = W[Index - 2];
+    T2 = W[Index - 15];
+    W[Index] = (ROTR32 (T1, 17) ^ ROTR32 (T1, 19) ^ (T1 >> 10)) + W[Index - 7] +
+               (ROTR32 (T2, 7) ^ ROTR32 (T2, 18) ^ (T2 >> 3)) + W[Index - 16];
+  }
+
+  A = State[0];
+  B = State[1];
+  C = State[2];
+  D = State[3];
+  E = State[4];
+  F = State[5];
+  G = State[6];
+  H = State[7];
+
+  for (Index = 0; Index < 64; Index++) {
+    T1 = H + (ROTR32 (E, 6) ^ ROTR32 (E, 11) ^ ROTR32 (E, 25)) + ((E & F) ^ (~E & G)) +
+         mSha256K[Index] + W[Index];
+    T2 = (ROTR32 (A, 2) ^ ROTR32 (A, 13) ^ ROTR32 (A, 22)) + ((A & B) ^ (A & C) ^ (B & C));
+    H = G;
+    G = F;
+    F = E;
+    E = D + T1;
+    D = C;
+    C = B;
+    B = A;
+    A = T1 + T2;
+  }
+
+  State[0] += A;
+  State[1] += B;
+  State[2] += C;
+  State[3] += D;
+  State[4] += E;
+  State[5] += F;
+  State[6] += G;
+  State[7] += H;
+}
+
+VOID
+Sha256Init (
+  OUT SHA256_CONTEXT                    *Context
+  )
+/*++
+
+Routine Description:
+
+  Start an incremental SHA-256 calculation.
+
+Arguments:
+
+  Context     - The caller allocated context to initialize
+
+Returns:
+
+  None
+
+--*/
+{
+  Context->State[0]  = 0x6a09e667;
+  Context->State[1]  = 0xbb67ae85;
+  Context->State[2]  = 0x3c6ef372;
+  Context->State[3]  = 0xa54ff53a;
+  Context->State[4]  = 0x510e527f;
+  Context->State[5]  = 0x9b05688c;
+  Context->State[6]  = 0x1f83d9ab;
+  Context->State[7]  = 0x5be0cd19;
+  Context->Length    = 0;
+  Context->BlockUsed = 0;
+}
+
+VOID
+Sha256Update (
+  IN OUT SHA256_CONTEXT                 *Context,
+  IN     CONST VOID                     *Data,
+  IN     UINTN                          DataSize
+  )
+/*++
+
+Routine Description:
+
+  Add a block of data to an incremental SHA-256 calculation.
+
+Arguments:
+
+  Context     - The context started by Sha256Init
+  Data        - The buffer containing the next part of the data
+  DataSize    - The size of Data, which may be zero
+
+Returns:
+
+  None
+
+--*/
+{
+  CONST UINT8 *Ptr;
+  UINTN       Count;
+
+  Ptr = (CONST UINT8 *) Data;
+  Context->Length += DataSize;
+
+  if (Context->BlockUsed != 0) {
+    Count = sizeof (Context->Block) - Context->BlockUsed;
+    if (Count > DataSize) {
+      Count = DataSize;
+    }
+    memcpy (Context->Block + Context->BlockUsed, Ptr, Count);
+    Context->BlockUsed += Count;
+    Ptr      += Count;
+    DataSize -= Count;
+    if (Context->BlockUsed < sizeof (Context->Block)) {
+      return;
+    }
+    Sha256Transform (Context->State, Context->Block);
+    Context->BlockUsed = 0;
+  }
+
+  while (DataSize >= sizeof (Context->Block)) {
+    Sha256Transform (Context->State, Ptr);
+    Ptr      += sizeof (Context->Block);
+    DataSize -= sizeof (Context->Block);
+  }
+
+  if (DataSize != 0) {
+    memcpy (Context->Block, Ptr, DataSize);
+    Context->BlockUsed = DataSize;
+  }
+}
+
+VOID
+Sha256Final (
+  IN OUT SHA256_CONTEXT                 *Context,
+  OUT    UINT8                          *Digest
+  )
+/*++
+
+Routine Description:
+
+  Finish an incremental SHA-256 calculation. The context must be
+  initialized again before it is reused.
+
+Arguments:
+
+  Context     - The context started by Sha256Init
+  Digest      - Caller allocated buffer of SHA256_DIGEST_SIZE bytes that
+                receives the digest of all the data passed to Sha256Update
+
+Returns:
+
+  None
+
+--*/
+{
+  UINT64  BitLength;
+  UINTN   Index;
+
+  BitLength = Context->Length * 8;
+
+  Context->Block[Context->BlockUsed++] = 0x80;
+  if (Context->BlockUsed > sizeof (Context->Block) - 8) {
+    memset (Context->Block + Context->BlockUsed, 0, sizeof (Context->Block) - Context->BlockUsed);
+    Sha256Transform (Context->State, Context->Block);
+    Context->BlockUsed = 0;
+  }
+  memset (Context->Block + Context->BlockUsed, 0, sizeof (Context->Block) - 8 - Context->BlockUsed);
+  for (Index = 0; Index < 8; Index++) {
+    Context->Block[sizeof (Context->Block) - 1 - Index] = (UINT8) (BitLength >> (Index * 8));
+  }
+  Sha256Transform (Context->State, Context->Block);
+
+  for (Index = 0; Index < 8; Index++) {
+    Digest[Index * 4]     = (UINT8) (Context->State[Index] >> 24);
+    Digest[Index * 4 + 1] = (UINT8) (Context->State[Index] >> 16);
+    Digest[Index * 4 + 2] = (UINT8) (Context->State[Index] >> 8);
+    Digest[Index * 4 + 3] = (UINT8) Context->State[Index];
+  }
+}
@@ -0,0 +1,108 @@
+/** @file
+
+Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+Module Name:
+
+  Sha256.h
+
+Abstract:
+
+  Header file for the incremental SHA-256 routines used to identify
+  build tool inputs by content.
+
+**/
+
+#ifndef _SHA256_H
+#define _SHA256_H
+
+#include <Common/UefiBaseTypes.h>
+
+#define SHA256_DIGEST_SIZE  32
+
+typedef struct {
+  UINT32  State[8];
+  UINT64  Length;
+  UINT8   Block[64];
+  UINTN   BlockUsed;
+} SHA256_CONTEXT;
+
+VOID
+Sha256Init (
+  OUT SHA256_CONTEXT                    *Context
+  )
+/*++
+
+Routine Description:
+
+  Start an incremental SHA-256 calculation.
+
+Arguments:
+
+  Context     - The caller allocated context to initialize
+
+Returns:
+
+  None
+
+--*/
+;
+
+VOID
+Sha256Update (
+  IN OUT SHA256_CONTEXT                 *Context,
+  IN     CONST VOID                     *Data,
+  IN     UINTN                          DataSize
+  )
+/*++
+
+Routine Description:
+
+  Add a block of data to an incremental SHA-256 calculation.
+
+Arguments:
+
+  Context     - The context started by Sha256Init
+  Data        - The buffer containing the next part of the data
+  DataSize    - The size of Data, which may be zero
+
+Returns:
+
+  None
+
+--*/
+;
+
+VOID
+Sha256Final (
+  IN OUT SHA256_CONTEXT                 *Context,
+  OUT    UINT8                          *Digest
+  )
+/*++
+
+Routine Description:
+
+  Finish an incremental SHA-256 calculation. The context must be
+  initialized again before it is reused.
+
+Arguments:
+
+  Context     - The context started by Sha256Init
+  Digest      - Caller allocated buffer of SHA256_DIGEST_SIZE bytes that
+                receives the digest of all the data passed to Sha256Update
+
+Returns:
+
+  None
+
+--*/
+;
+
+#endif
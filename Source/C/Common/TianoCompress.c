@@ -44,7 +44,14 @@ typedef INT32 NODE;
 #define MAX_HASH_VAL  (3 * WNDSIZ + (WNDSIZ / 512 + 1) * UINT8_MAX)
 #define HASH(p, c)    ((p) + ((c) << (WNDBIT - 9)) + WNDSIZ * 2)
 #define CRCPOLY       0xA001
-#define UPDATE_CRC(c) mCrc = mCrcTable[(mCrc ^ (c)) & 0xFF] ^ (mCrc >> UINT8_BIT)
+#define UPDATE_CRC(c) Ctx->mCrc = Ctx->mCrcTable[(Ctx->mCrc ^ (c)) & 0xFF] ^ (Ctx->mCrc >> UINT8_BIT)
+
+//
+// Hash chain match finder (compression levels below COMPRESS_LEVEL_MAX)
+//
+#define CHAIN_HASH_BITS   15
+#define CHAIN_HASH_SIZE   (1U << CHAIN_HASH_BITS)
+#define CHAIN_HASH(p)     ((((UINT32) (p)[0] | ((UINT32) (p)[1] << 8) | ((UINT32) (p)[2] << 16)) * 2654435761U) >> (32 - CHAIN_HASH_BITS))
 
 //
 // C: the Char&Len Set; P: the Position Set; T: the exTra Set
@@ -66,31 +73,33 @@ typedef INT32 NODE;
 
 STATIC
 VOID
-PutDword(
+PutDword (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 Data
   );
 
 STATIC
 EFI_STATUS
 AllocateMemory (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 FreeMemory (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 InitSlide (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 NODE
 Child (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN NODE   NodeQ,
   IN UINT8  CharC
   );
@@ -98,6 +107,7 @@ Child (
 STATIC
 VOID
 MakeChild (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN NODE  NodeQ,
   IN UINT8 CharC,
   IN NODE  NodeR
@@ -106,42 +116,69 @@ MakeChild (
 STATIC
 VOID
 Split (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN NODE Old
   );
 
 STATIC
 VOID
 InsertNode (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 DeleteNode (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 GetNextMatch (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
-EFI_STATUS
+VOID
+SkipNextMatch (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
+  );
+
+STATIC
+VOID
+AdvancePosition (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
+  );
+
+STATIC
+VOID
+InitHashChain (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
+  );
+
+STATIC
+VOID
+ChainInsertNode (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
+  IN BOOLEAN FindMatch
+  );
+
+STATIC
+VOID
 Encode (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 CountTFreq (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 WritePTLen (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Number,
   IN INT32 nbit,
   IN INT32 Special
@@ -150,30 +187,33 @@ WritePTLen (
 STATIC
 VOID
 WriteCLen (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 EncodeC (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Value
   );
 
 STATIC
 VOID
 EncodeP (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 Value
   );
 
 STATIC
 VOID
 SendBlock (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 Output (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 c,
   IN UINT32 p
   );
@@ -181,24 +221,25 @@ Output (
 STATIC
 VOID
 HufEncodeStart (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 HufEncodeEnd (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 MakeCrcTable (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 PutBits (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32  Number,
   IN UINT32 Value
   );
@@ -206,6 +247,7 @@ PutBits (
 STATIC
 INT32
 FreadCrc (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   OUT UINT8 *Pointer,
   IN  INT32 Number
   );
@@ -213,30 +255,34 @@ FreadCrc (
 STATIC
 VOID
 InitPutBits (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   );
 
 STATIC
 VOID
 CountLen (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Index
   );
 
 STATIC
 VOID
 MakeLen (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Root
   );
 
 STATIC
 VOID
 DownHeap (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Index
   );
 
 STATIC
 VOID
 MakeCode (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN  INT32       Number,
   IN  UINT8 Len[  ],
   OUT UINT16 Code[]
@@ -245,6 +291,7 @@ MakeCode (
 STATIC
 INT32
 MakeTree (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN  INT32            NParm,
   IN  UINT16  FreqParm[],
   OUT UINT8   LenParm[ ],
@@ -252,122 +299,360 @@ MakeTree (
   );
 
 //
-//  Global Variables
+// Compression context. Everything the encoder used to keep in file scope
+// globals lives here, so independent contexts may run concurrently.
 //
-STATIC UINT8  *mSrc, *mDst, *mSrcUpperLimit, *mDstUpperLimit;
-
-STATIC UINT8  *mLevel, *mText, *mChildCount, *mBuf, mCLen[NC], mPTLen[NPT], *mLen;
-STATIC INT16  mHeap[NC + 1];
-STATIC INT32  mRemainder, mMatchLen, mBitCount, mHeapSize, mN;
-STATIC UINT32 mBufSiz = 0, mOutputPos, mOutputMask, mSubBitBuf, mCrc;
-STATIC UINT32 mCompSize, mOrigSize;
+struct _TIANO_COMPRESS_CONTEXT {
+  UINT8   *mSrc;
+  UINT8   *mDst;
+  UINT8   *mSrcUpperLimit;
+  UINT8   *mDstUpperLimit;
+
+  UINT8   *mLevel;
+  UINT8   *mText;
+  UINT8   *mChildCount;
+  UINT8   *mBuf;
+  UINT8   mCLen[NC];
+  UINT8   mPTLen[NPT];
+  UINT8   *mLen;
+  INT16   mHeap[NC + 1];
+  INT32   mRemainder;
+  INT32   mMatchLen;
+  INT32   mBitCount;
+  INT32   mHeapSize;
+  INT32   mN;
+  INT32   mDepth;
+  UINT32  mBufSiz;
+  UINT32  mOutputPos;
+  UINT32  mOutputMask;
+  UINT32  mSubBitBuf;
+  UINT32  mCrc;
+  UINT32  mCPos;
+  UINT32  mCompSize;
+  UINT32  mOrigSize;
+
+  UINT16  *mFreq;
+  UINT16  *mSortPtr;
+  UINT16  mLenCnt[17];
+  UINT16  mLeft[2 * NC - 1];
+  UINT16  mRight[2 * NC - 1];
+  UINT16  mCrcTable[UINT8_MAX + 1];
+  UINT16  mCFreq[2 * NC - 1];
+  UINT16  mCCode[NC];
+  UINT16  mPFreq[2 * NP - 1];
+  UINT16  mPTCode[NPT];
+  UINT16  mTFreq[2 * NT - 1];
+
+  NODE    mPos;
+  NODE    mMatchPos;
+  NODE    mAvail;
+  NODE    *mPosition;
+  NODE    *mParent;
+  NODE    *mPrev;
+  NODE    *mNext;
+
+  UINT32  mChainDepth;
+  INT32   mNiceMatch;
+  NODE    *mHashHead;
+  NODE    *mHashPrev;
+};
 
-STATIC UINT16 *mFreq, *mSortPtr, mLenCnt[17], mLeft[2 * NC - 1], mRight[2 * NC - 1], mCrcTable[UINT8_MAX + 1],
-  mCFreq[2 * NC - 1], mCCode[NC], mPFreq[2 * NP - 1], mPTCode[NPT], mTFreq[2 * NT - 1];
-
-STATIC NODE   mPos, mMatchPos, mAvail, *mPosition, *mParent, *mPrev, *mNext = NULL;
+//
+// Match finder settings for each compression level. A chain depth of 0
+// selects the original binary tree search; otherwise hash chains are
+// searched for at most ChainDepth candidates, and the search stops as
+// soon as a match of NiceMatch bytes is found.
+//
+typedef struct {
+  UINT32  ChainDepth;
+  INT32   NiceMatch;
+} COMPRESS_LEVEL_SETTING;
+
+STATIC CONST COMPRESS_LEVEL_SETTING mLevelSetting[COMPRESS_LEVEL_MAX] = {
+  {    4,    8 },
+  {    8,   16 },
+  {   12,   32 },
+  {   16,   64 },
+  {   24,  128 },
+  {   32,  256 },
+  {   48,  256 },
+  {   64,  256 },
+  {    0,    0 }
+};
 
 //
 // functions
 //
 EFI_STATUS
-TianoCompress (
-  IN      UINT8   *SrcBuffer,
-  IN      UINT32  SrcSize,
-  IN      UINT8   *DstBuffer,
-  IN OUT  UINT32  *DstSize
+TianoCompressCreateContext (
+  OUT TIANO_COMPRESS_CONTEXT  **Context
   )
 /*++
 
 Routine Description:
 
-  The internal implementation of [Efi/Tiano]Compress().
+  Allocate a Tiano compression context together with the sliding window
+  and tree buffers it needs. The context can be used for any number of
+  TianoCompressWithContext() calls, but only by one thread at a time.
 
 Arguments:
 
+  Context     - On output, the newly created context.
+
+Returns:
+
+  EFI_SUCCESS           - The context was created.
+  EFI_OUT_OF_RESOURCES  - No resource to complete function.
+  EFI_INVALID_PARAMETER - Context is NULL.
+
+--*/
+{
+  TIANO_COMPRESS_CONTEXT  *Ctx;
+  EFI_STATUS              Status;
+
+  if (Context == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Context = NULL;
+  Ctx      = calloc (1, sizeof (TIANO_COMPRESS_CONTEXT));
+  if (Ctx == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = AllocateMemory (Ctx);
+  if (EFI_ERROR (Status)) {
+    FreeMemory (Ctx);
+    free (Ctx);
+    return Status;
+  }
+
+  MakeCrcTable (Ctx);
+
+  *Context = Ctx;
+  return EFI_SUCCESS;
+}
+
+VOID
+TianoCompressDestroyContext (
+  IN TIANO_COMPRESS_CONTEXT  *Context
+  )
+/*++
+
+Routine Description:
+
+  Free a context created by TianoCompressCreateContext().
+
+Arguments:
+
+  Context     - The context to free. NULL is ignored.
+
+Returns: (VOID)
+
+--*/
+{
+  if (Context == NULL) {
+    return ;
+  }
+
+  FreeMemory (Context);
+  free (Context);
+}
+
+EFI_STATUS
+TianoCompressSetLevel (
+  IN TIANO_COMPRESS_CONTEXT  *Context,
+  IN UINT32                 Level
+  )
+/*++
+
+Routine Description:
+
+  Select the speed/ratio trade-off used by later TianoCompressWithContext()
+  calls. COMPRESS_LEVEL_MAX (the default) keeps the original match finder
+  and its exact output; lower levels search hash chains of bounded depth,
+  which is faster at the cost of a somewhat larger output. Any level
+  produces a stream that the standard decompressor accepts.
+
+Arguments:
+
+  Context     - The context from TianoCompressCreateContext()
+  Level       - COMPRESS_LEVEL_MIN (fastest) to COMPRESS_LEVEL_MAX (smallest)
+
+Returns:
+
+  EFI_SUCCESS           - The level was set.
+  EFI_OUT_OF_RESOURCES  - No resource for the hash chain tables.
+  EFI_INVALID_PARAMETER - Context is NULL or Level is out of range.
+
+--*/
+{
+  CONST COMPRESS_LEVEL_SETTING  *Setting;
+
+  if (Context == NULL || Level < COMPRESS_LEVEL_MIN || Level > COMPRESS_LEVEL_MAX) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Setting = &mLevelSetting[Level - 1];
+  if (Setting->ChainDepth != 0 && Context->mHashHead == NULL) {
+    Context->mHashHead = malloc (CHAIN_HASH_SIZE * sizeof (*Context->mHashHead));
+    Context->mHashPrev = malloc (WNDSIZ * sizeof (*Context->mHashPrev));
+    if (Context->mHashHead == NULL || Context->mHashPrev == NULL) {
+      if (Context->mHashHead != NULL) {
+        free (Context->mHashHead);
+      }
+
+      if (Context->mHashPrev != NULL) {
+        free (Context->mHashPrev);
+      }
+
+      Context->mHashHead = NULL;
+      Context->mHashPrev = NULL;
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  Context->mChainDepth = Setting->ChainDepth;
+  Context->mNiceMatch  = Setting->NiceMatch;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+TianoCompressWithContext (
+  IN      TIANO_COMPRESS_CONTEXT  *Context,
+  IN      UINT8                   *SrcBuffer,
+  IN      UINT32                  SrcSize,
+  IN      UINT8                   *DstBuffer,
+  IN OUT  UINT32                  *DstSize
+  )
+/*++
+
+Routine Description:
+
+  Tiano compression using caller supplied state. At the default level the
+  output is identical to TianoCompress(); contexts are independent, so different
+  threads may compress at the same time as long as each one uses its own
+  context.
+
+Arguments:
+
+  Context     - The context from TianoCompressCreateContext()
   SrcBuffer   - The buffer storing the source data
   SrcSize     - The size of source data
   DstBuffer   - The buffer to store the compressed data
   DstSize     - On input, the size of DstBuffer; On output,
                 the size of the actual compressed data.
-  Version     - The version of de/compression algorithm.
-                Version 1 for UEFI 2.0 de/compression algorithm.
-                Version 2 for Tiano de/compression algorithm.
 
 Returns:
 
   EFI_BUFFER_TOO_SMALL  - The DstBuffer is too small. In this case,
                 DstSize contains the size needed.
   EFI_SUCCESS           - Compression is successful.
-  EFI_OUT_OF_RESOURCES  - No resource to complete function.
   EFI_INVALID_PARAMETER - Parameter supplied is wrong.
 
 --*/
 {
-  EFI_STATUS  Status;
+  TIANO_COMPRESS_CONTEXT  *Ctx;
+
+  if (Context == NULL || DstSize == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
 
   //
   // Initializations
   //
-  mBufSiz         = 0;
-  mBuf            = NULL;
-  mText           = NULL;
-  mLevel          = NULL;
-  mChildCount     = NULL;
-  mPosition       = NULL;
-  mParent         = NULL;
-  mPrev           = NULL;
-  mNext           = NULL;
+  Ctx                 = Context;
+  Ctx->mSrc           = SrcBuffer;
+  Ctx->mSrcUpperLimit = Ctx->mSrc + SrcSize;
+  Ctx->mDst           = DstBuffer;
+  Ctx->mDstUpperLimit = Ctx->mDst +*DstSize;
 
-  mSrc            = SrcBuffer;
-  mSrcUpperLimit  = mSrc + SrcSize;
-  mDst            = DstBuffer;
-  mDstUpperLimit  = mDst +*DstSize;
+  PutDword (Ctx, 0L);
+  PutDword (Ctx, 0L);
 
-  PutDword (0L);
-  PutDword (0L);
-
-  MakeCrcTable ();
-
-  mOrigSize             = mCompSize = 0;
-  mCrc                  = INIT_CRC;
+  Ctx->mOrigSize      = Ctx->mCompSize = 0;
+  Ctx->mCrc           = INIT_CRC;
 
   //
   // Compress it
   //
-  Status = Encode ();
-  if (EFI_ERROR (Status)) {
-    return EFI_OUT_OF_RESOURCES;
-  }
+  Encode (Ctx);
+
   //
   // Null terminate the compressed data
   //
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = 0;
+  if (Ctx->mDst < Ctx->mDstUpperLimit) {
+    *Ctx->mDst++ = 0;
   }
   //
   // Fill in compressed size and original size
   //
-  mDst = DstBuffer;
-  PutDword (mCompSize + 1);
-  PutDword (mOrigSize);
+  Ctx->mDst = DstBuffer;
+  PutDword (Ctx, Ctx->mCompSize + 1);
+  PutDword (Ctx, Ctx->mOrigSize);
 
   //
   // Return
   //
-  if (mCompSize + 1 + 8 > *DstSize) {
-    *DstSize = mCompSize + 1 + 8;
+  if (Ctx->mCompSize + 1 + 8 > *DstSize) {
+    *DstSize = Ctx->mCompSize + 1 + 8;
     return EFI_BUFFER_TOO_SMALL;
   } else {
-    *DstSize = mCompSize + 1 + 8;
+    *DstSize = Ctx->mCompSize + 1 + 8;
     return EFI_SUCCESS;
   }
 
 }
 
+EFI_STATUS
+TianoCompress (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN OUT  UINT32  *DstSize
+  )
+/*++
+
+Routine Description:
+
+  The internal implementation of [Efi/Tiano]Compress().
+
+Arguments:
+
+  SrcBuffer   - The buffer storing the source data
+  SrcSize     - The size of source data
+  DstBuffer   - The buffer to store the compressed data
+  DstSize     - On input, the size of DstBuffer; On output,
+                the size of the actual compressed data.
+
+Returns:
+
+  EFI_BUFFER_TOO_SMALL  - The DstBuffer is too small. In this case,
+                DstSize contains the size needed.
+  EFI_SUCCESS           - Compression is successful.
+  EFI_OUT_OF_RESOURCES  - No resource to complete function.
+  EFI_INVALID_PARAMETER - Parameter supplied is wrong.
+
+--*/
+{
+  TIANO_COMPRESS_CONTEXT  *Ctx;
+  EFI_STATUS              Status;
+
+  Status = TianoCompressCreateContext (&Ctx);
+  if (EFI_ERROR (Status)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = TianoCompressWithContext (Ctx, SrcBuffer, SrcSize, DstBuffer, DstSize);
+  TianoCompressDestroyContext (Ctx);
+
+  return Status;
+}
+
 STATIC
 VOID
 PutDword (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 Data
   )
 /*++
@@ -378,33 +663,34 @@ Routine Description:
   
 Arguments:
 
+  Ctx     - the compression context
   Data    - the dword to put
   
 Returns: (VOID)
   
 --*/
 {
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data)) & 0xff);
+  if (Ctx->mDst < Ctx->mDstUpperLimit) {
+    *Ctx->mDst++ = (UINT8) (((UINT8) (Data)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data >> 0x08)) & 0xff);
+  if (Ctx->mDst < Ctx->mDstUpperLimit) {
+    *Ctx->mDst++ = (UINT8) (((UINT8) (Data >> 0x08)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data >> 0x10)) & 0xff);
+  if (Ctx->mDst < Ctx->mDstUpperLimit) {
+    *Ctx->mDst++ = (UINT8) (((UINT8) (Data >> 0x10)) & 0xff);
   }
 
-  if (mDst < mDstUpperLimit) {
-    *mDst++ = (UINT8) (((UINT8) (Data >> 0x18)) & 0xff);
+  if (Ctx->mDst < Ctx->mDstUpperLimit) {
+    *Ctx->mDst++ = (UINT8) (((UINT8) (Data >> 0x18)) & 0xff);
   }
 }
 
 STATIC
 EFI_STATUS
 AllocateMemory (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 /*++
 
@@ -412,8 +698,9 @@ Routine Description:
 
   Allocate memory spaces for data structures used in compression process
   
-Argements: 
-  VOID
+Arguments:
+
+  Ctx     - the compression context
 
 Returns:
 
@@ -422,39 +709,39 @@ Returns:
 
 --*/
 {
-  UINT32  Index;
-
-  mText = malloc (WNDSIZ * 2 + MAXMATCH);
-  for (Index = 0; Index < WNDSIZ * 2 + MAXMATCH; Index++) {
-    mText[Index] = 0;
+  Ctx->mText       = malloc (WNDSIZ * 2 + MAXMATCH);
+  Ctx->mLevel      = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*Ctx->mLevel));
+  Ctx->mChildCount = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*Ctx->mChildCount));
+  Ctx->mPosition   = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*Ctx->mPosition));
+  Ctx->mParent     = malloc (WNDSIZ * 2 * sizeof (*Ctx->mParent));
+  Ctx->mPrev       = malloc (WNDSIZ * 2 * sizeof (*Ctx->mPrev));
+  Ctx->mNext       = malloc ((MAX_HASH_VAL + 1) * sizeof (*Ctx->mNext));
+
+  if (Ctx->mText == NULL || Ctx->mLevel == NULL || Ctx->mChildCount == NULL ||
+      Ctx->mPosition == NULL || Ctx->mParent == NULL || Ctx->mPrev == NULL ||
+      Ctx->mNext == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  mLevel      = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*mLevel));
-  mChildCount = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*mChildCount));
-  mPosition   = malloc ((WNDSIZ + UINT8_MAX + 1) * sizeof (*mPosition));
-  mParent     = malloc (WNDSIZ * 2 * sizeof (*mParent));
-  mPrev       = malloc (WNDSIZ * 2 * sizeof (*mPrev));
-  mNext       = malloc ((MAX_HASH_VAL + 1) * sizeof (*mNext));
-
-  mBufSiz     = BLKSIZ;
-  mBuf        = malloc (mBufSiz);
-  while (mBuf == NULL) {
-    mBufSiz = (mBufSiz / 10U) * 9U;
-    if (mBufSiz < 4 * 1024U) {
+  Ctx->mBufSiz     = BLKSIZ;
+  Ctx->mBuf        = malloc (Ctx->mBufSiz);
+  while (Ctx->mBuf == NULL) {
+    Ctx->mBufSiz = (Ctx->mBufSiz / 10U) * 9U;
+    if (Ctx->mBufSiz < 4 * 1024U) {
       return EFI_OUT_OF_RESOURCES;
     }
 
-    mBuf = malloc (mBufSiz);
+    Ctx->mBuf = malloc (Ctx->mBufSiz);
   }
 
-  mBuf[0] = 0;
+  Ctx->mBuf[0] = 0;
 
   return EFI_SUCCESS;
 }
 
 VOID
 FreeMemory (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 /*++
 
@@ -462,42 +749,52 @@ Routine Description:
 
   Called when compression is completed to free memory previously allocated.
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
 --*/
 {
-  if (mText != NULL) {
-    free (mText);
+  if (Ctx->mText != NULL) {
+    free (Ctx->mText);
+  }
+
+  if (Ctx->mLevel != NULL) {
+    free (Ctx->mLevel);
+  }
+
+  if (Ctx->mChildCount != NULL) {
+    free (Ctx->mChildCount);
   }
 
-  if (mLevel != NULL) {
-    free (mLevel);
+  if (Ctx->mPosition != NULL) {
+    free (Ctx->mPosition);
   }
 
-  if (mChildCount != NULL) {
-    free (mChildCount);
+  if (Ctx->mParent != NULL) {
+    free (Ctx->mParent);
   }
 
-  if (mPosition != NULL) {
-    free (mPosition);
+  if (Ctx->mPrev != NULL) {
+    free (Ctx->mPrev);
   }
 
-  if (mParent != NULL) {
-    free (mParent);
+  if (Ctx->mNext != NULL) {
+    free (Ctx->mNext);
   }
 
-  if (mPrev != NULL) {
-    free (mPrev);
+  if (Ctx->mBuf != NULL) {
+    free (Ctx->mBuf);
   }
 
-  if (mNext != NULL) {
-    free (mNext);
+  if (Ctx->mHashHead != NULL) {
+    free (Ctx->mHashHead);
   }
 
-  if (mBuf != NULL) {
-    free (mBuf);
+  if (Ctx->mHashPrev != NULL) {
+    free (Ctx->mHashPrev);
   }
 
   return ;
@@ -506,7 +803,7 @@ Returns: (VOID)
 STATIC
 VOID
 InitSlide (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 /*++
 
@@ -514,7 +811,9 @@ Routine Description:
 
   Initialize String Info Log data structures
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
@@ -523,28 +822,29 @@ Returns: (VOID)
   NODE  Index;
 
   for (Index = WNDSIZ; Index <= WNDSIZ + UINT8_MAX; Index++) {
-    mLevel[Index]     = 1;
-    mPosition[Index]  = NIL;  /* sentinel */
+    Ctx->mLevel[Index]     = 1;
+    Ctx->mPosition[Index]  = NIL;  /* sentinel */
   }
 
   for (Index = WNDSIZ; Index < WNDSIZ * 2; Index++) {
-    mParent[Index] = NIL;
+    Ctx->mParent[Index] = NIL;
   }
 
-  mAvail = 1;
+  Ctx->mAvail = 1;
   for (Index = 1; Index < WNDSIZ - 1; Index++) {
-    mNext[Index] = (NODE) (Index + 1);
+    Ctx->mNext[Index] = (NODE) (Index + 1);
   }
 
-  mNext[WNDSIZ - 1] = NIL;
+  Ctx->mNext[WNDSIZ - 1] = NIL;
   for (Index = WNDSIZ * 2; Index <= MAX_HASH_VAL; Index++) {
-    mNext[Index] = NIL;
+    Ctx->mNext[Index] = NIL;
   }
 }
 
 STATIC
 NODE
 Child (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN NODE  NodeQ,
   IN UINT8 CharC
   )
@@ -556,6 +856,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx         - the compression context
   NodeQ       - the parent node
   CharC       - the edge character
   
@@ -567,13 +868,13 @@ Returns:
 {
   NODE  NodeR;
 
-  NodeR = mNext[HASH (NodeQ, CharC)];
+  NodeR = Ctx->mNext[HASH (NodeQ, CharC)];
   //
   // sentinel
   //
-  mParent[NIL] = NodeQ;
-  while (mParent[NodeR] != NodeQ) {
-    NodeR = mNext[NodeR];
+  Ctx->mParent[NIL] = NodeQ;
+  while (Ctx->mParent[NodeR] != NodeQ) {
+    NodeR = Ctx->mNext[NodeR];
   }
 
   return NodeR;
@@ -582,6 +883,7 @@ Returns:
 STATIC
 VOID
 MakeChild (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN NODE  Parent,
   IN UINT8 CharC,
   IN NODE  Child
@@ -594,6 +896,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx          - the compression context
   Parent       - the parent node
   CharC   - the edge character
   Child       - the child node
@@ -606,18 +909,19 @@ Returns: (VOID)
   NODE  Node2;
 
   Node1           = (NODE) HASH (Parent, CharC);
-  Node2           = mNext[Node1];
-  mNext[Node1]    = Child;
-  mNext[Child]    = Node2;
-  mPrev[Node2]    = Child;
-  mPrev[Child]    = Node1;
-  mParent[Child]  = Parent;
-  mChildCount[Parent]++;
+  Node2           = Ctx->mNext[Node1];
+  Ctx->mNext[Node1]    = Child;
+  Ctx->mNext[Child]    = Node2;
+  Ctx->mPrev[Node2]    = Child;
+  Ctx->mPrev[Child]    = Node1;
+  Ctx->mParent[Child]  = Parent;
+  Ctx->mChildCount[Parent]++;
 }
 
 STATIC
 VOID
 Split (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   NODE Old
   )
 /*++
@@ -628,6 +932,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx     - the compression context
   Old     - the node to split
   
 Returns: (VOID)
@@ -637,26 +942,26 @@ Returns: (VOID)
   NODE  New;
   NODE  TempNode;
 
-  New               = mAvail;
-  mAvail            = mNext[New];
-  mChildCount[New]  = 0;
-  TempNode          = mPrev[Old];
-  mPrev[New]        = TempNode;
-  mNext[TempNode]   = New;
-  TempNode          = mNext[Old];
-  mNext[New]        = TempNode;
-  mPrev[TempNode]   = New;
-  mParent[New]      = mParent[Old];
-  mLevel[New]       = (UINT8) mMatchLen;
-  mPosition[New]    = mPos;
-  MakeChild (New, mText[mMatchPos + mMatchLen], Old);
-  MakeChild (New, mText[mPos + mMatchLen], mPos);
+  New               = Ctx->mAvail;
+  Ctx->mAvail            = Ctx->mNext[New];
+  Ctx->mChildCount[New]  = 0;
+  TempNode          = Ctx->mPrev[Old];
+  Ctx->mPrev[New]        = TempNode;
+  Ctx->mNext[TempNode]   = New;
+  TempNode          = Ctx->mNext[Old];
+  Ctx->mNext[New]        = TempNode;
+  Ctx->mPrev[TempNode]   = New;
+  Ctx->mParent[New]      = Ctx->mParent[Old];
+  Ctx->mLevel[New]       = (UINT8) Ctx->mMatchLen;
+  Ctx->mPosition[New]    = Ctx->mPos;
+  MakeChild (Ctx, New, Ctx->mText[Ctx->mMatchPos + Ctx->mMatchLen], Old);
+  MakeChild (Ctx, New, Ctx->mText[Ctx->mPos + Ctx->mMatchLen], Ctx->mPos);
 }
 
 STATIC
 VOID
 InsertNode (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 /*++
 
@@ -664,7 +969,9 @@ Routine Description:
 
   Insert string info for current position into the String Info Log
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
@@ -678,50 +985,50 @@ Returns: (VOID)
   UINT8 *t1;
   UINT8 *t2;
 
-  if (mMatchLen >= 4) {
+  if (Ctx->mMatchLen >= 4) {
     //
     // We have just got a long match, the target tree
     // can be located by MatchPos + 1. Travese the tree
     // from bottom up to get to a proper starting point.
     // The usage of PERC_FLAG ensures proper node deletion
-    // in DeleteNode() later.
+    // in DeleteNode(Ctx) later.
     //
-    mMatchLen--;
-    NodeR = (NODE) ((mMatchPos + 1) | WNDSIZ);
-    NodeQ = mParent[NodeR];
+    Ctx->mMatchLen--;
+    NodeR = (NODE) ((Ctx->mMatchPos + 1) | WNDSIZ);
+    NodeQ = Ctx->mParent[NodeR];
     while (NodeQ == NIL) {
-      NodeR = mNext[NodeR];
-      NodeQ = mParent[NodeR];
+      NodeR = Ctx->mNext[NodeR];
+      NodeQ = Ctx->mParent[NodeR];
     }
 
-    while (mLevel[NodeQ] >= mMatchLen) {
+    while (Ctx->mLevel[NodeQ] >= Ctx->mMatchLen) {
       NodeR = NodeQ;
-      NodeQ = mParent[NodeQ];
+      NodeQ = Ctx->mParent[NodeQ];
     }
 
     NodeT = NodeQ;
-    while (mPosition[NodeT] < 0) {
-      mPosition[NodeT]  = mPos;
-      NodeT             = mParent[NodeT];
+    while (Ctx->mPosition[NodeT] < 0) {
+      Ctx->mPosition[NodeT]  = Ctx->mPos;
+      NodeT             = Ctx->mParent[NodeT];
     }
 
     if (NodeT < WNDSIZ) {
-      mPosition[NodeT] = (NODE) (mPos | (UINT32) PERC_FLAG);
+      Ctx->mPosition[NodeT] = (NODE) (Ctx->mPos | (UINT32) PERC_FLAG);
     }
   } else {
     //
     // Locate the target tree
     //
-    NodeQ = (NODE) (mText[mPos] + WNDSIZ);
-    CharC = mText[mPos + 1];
-    NodeR = Child (NodeQ, CharC);
+    NodeQ = (NODE) (Ctx->mText[Ctx->mPos] + WNDSIZ);
+    CharC = Ctx->mText[Ctx->mPos + 1];
+    NodeR = Child (Ctx, NodeQ, CharC);
     if (NodeR == NIL) {
-      MakeChild (NodeQ, CharC, mPos);
-      mMatchLen = 1;
+      MakeChild (Ctx, NodeQ, CharC, Ctx->mPos);
+      Ctx->mMatchLen = 1;
       return ;
     }
 
-    mMatchLen = 2;
+    Ctx->mMatchLen = 2;
   }
   //
   // Traverse down the tree to find a match.
@@ -731,64 +1038,64 @@ Returns: (VOID)
   for (;;) {
     if (NodeR >= WNDSIZ) {
       Index2    = MAXMATCH;
-      mMatchPos = NodeR;
+      Ctx->mMatchPos = NodeR;
     } else {
-      Index2    = mLevel[NodeR];
-      mMatchPos = (NODE) (mPosition[NodeR] & (UINT32)~PERC_FLAG);
+      Index2    = Ctx->mLevel[NodeR];
+      Ctx->mMatchPos = (NODE) (Ctx->mPosition[NodeR] & (UINT32)~PERC_FLAG);
     }
 
-    if (mMatchPos >= mPos) {
-      mMatchPos -= WNDSIZ;
+    if (Ctx->mMatchPos >= Ctx->mPos) {
+      Ctx->mMatchPos -= WNDSIZ;
     }
 
-    t1  = &mText[mPos + mMatchLen];
-    t2  = &mText[mMatchPos + mMatchLen];
-    while (mMatchLen < Index2) {
+    t1  = &Ctx->mText[Ctx->mPos + Ctx->mMatchLen];
+    t2  = &Ctx->mText[Ctx->mMatchPos + Ctx->mMatchLen];
+    while (Ctx->mMatchLen < Index2) {
       if (*t1 != *t2) {
-        Split (NodeR);
+        Split (Ctx, NodeR);
         return ;
       }
 
-      mMatchLen++;
+      Ctx->mMatchLen++;
       t1++;
       t2++;
     }
 
-    if (mMatchLen >= MAXMATCH) {
+    if (Ctx->mMatchLen >= MAXMATCH) {
       break;
     }
 
-    mPosition[NodeR]  = mPos;
+    Ctx->mPosition[NodeR]  = Ctx->mPos;
     NodeQ             = NodeR;
-    NodeR             = Child (NodeQ, *t1);
+    NodeR             = Child (Ctx, NodeQ, *t1);
     if (NodeR == NIL) {
-      MakeChild (NodeQ, *t1, mPos);
+      MakeChild (Ctx, NodeQ, *t1, Ctx->mPos);
       return ;
     }
 
-    mMatchLen++;
+    Ctx->mMatchLen++;
   }
 
-  NodeT           = mPrev[NodeR];
-  mPrev[mPos]     = NodeT;
-  mNext[NodeT]    = mPos;
-  NodeT           = mNext[NodeR];
-  mNext[mPos]     = NodeT;
-  mPrev[NodeT]    = mPos;
-  mParent[mPos]   = NodeQ;
-  mParent[NodeR]  = NIL;
+  NodeT           = Ctx->mPrev[NodeR];
+  Ctx->mPrev[Ctx->mPos]     = NodeT;
+  Ctx->mNext[NodeT]    = Ctx->mPos;
+  NodeT           = Ctx->mNext[NodeR];
+  Ctx->mNext[Ctx->mPos]     = NodeT;
+  Ctx->mPrev[NodeT]    = Ctx->mPos;
+  Ctx->mParent[Ctx->mPos]   = NodeQ;
+  Ctx->mParent[NodeR]  = NIL;
 
   //
   // Special usage of 'next'
   //
-  mNext[NodeR] = mPos;
+  Ctx->mNext[NodeR] = Ctx->mPos;
 
 }
 
 STATIC
 VOID
 DeleteNode (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 /*++
 
@@ -797,7 +1104,9 @@ Routine Description:
   Delete outdated string info. (The Usage of PERC_FLAG
   ensures a clean deletion)
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
@@ -809,36 +1118,36 @@ Returns: (VOID)
   NODE  NodeT;
   NODE  NodeU;
 
-  if (mParent[mPos] == NIL) {
+  if (Ctx->mParent[Ctx->mPos] == NIL) {
     return ;
   }
 
-  NodeR         = mPrev[mPos];
-  NodeS         = mNext[mPos];
-  mNext[NodeR]  = NodeS;
-  mPrev[NodeS]  = NodeR;
-  NodeR         = mParent[mPos];
-  mParent[mPos] = NIL;
+  NodeR         = Ctx->mPrev[Ctx->mPos];
+  NodeS         = Ctx->mNext[Ctx->mPos];
+  Ctx->mNext[NodeR]  = NodeS;
+  Ctx->mPrev[NodeS]  = NodeR;
+  NodeR         = Ctx->mParent[Ctx->mPos];
+  Ctx->mParent[Ctx->mPos] = NIL;
   if (NodeR >= WNDSIZ) {
     return ;
   }
 
-  mChildCount[NodeR]--;
-  if (mChildCount[NodeR] > 1) {
+  Ctx->mChildCount[NodeR]--;
+  if (Ctx->mChildCount[NodeR] > 1) {
     return ;
   }
 
-  NodeT = (NODE) (mPosition[NodeR] & (UINT32)~PERC_FLAG);
-  if (NodeT >= mPos) {
+  NodeT = (NODE) (Ctx->mPosition[NodeR] & (UINT32)~PERC_FLAG);
+  if (NodeT >= Ctx->mPos) {
     NodeT -= WNDSIZ;
   }
 
   NodeS = NodeT;
-  NodeQ = mParent[NodeR];
-  NodeU = mPosition[NodeQ];
+  NodeQ = Ctx->mParent[NodeR];
+  NodeU = Ctx->mPosition[NodeQ];
   while (NodeU & (UINT32) PERC_FLAG) {
     NodeU &= (UINT32)~PERC_FLAG;
-    if (NodeU >= mPos) {
+    if (NodeU >= Ctx->mPos) {
       NodeU -= WNDSIZ;
     }
 
@@ -846,13 +1155,13 @@ Returns: (VOID)
       NodeS = NodeU;
     }
 
-    mPosition[NodeQ]  = (NODE) (NodeS | WNDSIZ);
-    NodeQ             = mParent[NodeQ];
-    NodeU             = mPosition[NodeQ];
+    Ctx->mPosition[NodeQ]  = (NODE) (NodeS | WNDSIZ);
+    NodeQ             = Ctx->mParent[NodeQ];
+    NodeU             = Ctx->mPosition[NodeQ];
   }
 
   if (NodeQ < WNDSIZ) {
-    if (NodeU >= mPos) {
+    if (NodeU >= Ctx->mPos) {
       NodeU -= WNDSIZ;
     }
 
@@ -860,30 +1169,76 @@ Returns: (VOID)
       NodeS = NodeU;
     }
 
-    mPosition[NodeQ] = (NODE) (NodeS | WNDSIZ | (UINT32) PERC_FLAG);
-  }
-
-  NodeS           = Child (NodeR, mText[NodeT + mLevel[NodeR]]);
-  NodeT           = mPrev[NodeS];
-  NodeU           = mNext[NodeS];
-  mNext[NodeT]    = NodeU;
-  mPrev[NodeU]    = NodeT;
-  NodeT           = mPrev[NodeR];
-  mNext[NodeT]    = NodeS;
-  mPrev[NodeS]    = NodeT;
-  NodeT           = mNext[NodeR];
-  mPrev[NodeT]    = NodeS;
-  mNext[NodeS]    = NodeT;
-  mParent[NodeS]  = mParent[NodeR];
-  mParent[NodeR]  = NIL;
-  mNext[NodeR]    = mAvail;
-  mAvail          = NodeR;
+    Ctx->mPosition[NodeQ] = (NODE) (NodeS | WNDSIZ | (UINT32) PERC_FLAG);
+  }
+
+  NodeS           = Child (Ctx, NodeR, Ctx->mText[NodeT + Ctx->mLevel[NodeR]]);
+  NodeT           = Ctx->mPrev[NodeS];
+  NodeU           = Ctx->mNext[NodeS];
+  Ctx->mNext[NodeT]    = NodeU;
+  Ctx->mPrev[NodeU]    = NodeT;
+  NodeT           = Ctx->mPrev[NodeR];
+  Ctx->mNext[NodeT]    = NodeS;
+  Ctx->mPrev[NodeS]    = NodeT;
+  NodeT           = Ctx->mNext[NodeR];
+  Ctx->mPrev[NodeT]    = NodeS;
+  Ctx->mNext[NodeS]    = NodeT;
+  Ctx->mParent[NodeS]  = Ctx->mParent[NodeR];
+  Ctx->mParent[NodeR]  = NIL;
+  Ctx->mNext[NodeR]    = Ctx->mAvail;
+  Ctx->mAvail          = NodeR;
+}
+
+STATIC
+VOID
+AdvancePosition (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
+  )
+/*++
+
+Routine Description:
+
+  Advance the current position, sliding the window and reading in new
+  data when the end of the text buffer is reached.
+
+Arguments:
+
+  Ctx     - the compression context
+
+Returns: (VOID)
+
+--*/
+{
+  INT32   Number;
+  UINT32  Index;
+
+  Ctx->mRemainder--;
+  Ctx->mPos++;
+  if (Ctx->mPos == WNDSIZ * 2) {
+    memmove (&Ctx->mText[0], &Ctx->mText[WNDSIZ], WNDSIZ + MAXMATCH);
+    Number = FreadCrc (Ctx, &Ctx->mText[WNDSIZ + MAXMATCH], WNDSIZ);
+    Ctx->mRemainder += Number;
+    Ctx->mPos = WNDSIZ;
+    if (Ctx->mChainDepth != 0) {
+      //
+      // Rebase the hash chains along with the text; positions that fall
+      // out of the window become NIL.
+      //
+      for (Index = 0; Index < CHAIN_HASH_SIZE; Index++) {
+        Ctx->mHashHead[Index] = (NODE) (Ctx->mHashHead[Index] > (NODE) WNDSIZ ? Ctx->mHashHead[Index] - WNDSIZ : NIL);
+      }
+
+      for (Index = 0; Index < WNDSIZ; Index++) {
+        Ctx->mHashPrev[Index] = (NODE) (Ctx->mHashPrev[Index] > (NODE) WNDSIZ ? Ctx->mHashPrev[Index] - WNDSIZ : NIL);
+      }
+    }
+  }
 }
 
 STATIC
 VOID
 GetNextMatch (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 /*++
 
@@ -892,31 +1247,155 @@ Routine Description:
   Advance the current position (read in new data if needed).
   Delete outdated string info. Find a match string for current position.
 
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
 --*/
 {
-  INT32 Number;
+  AdvancePosition (Ctx);
 
-  mRemainder--;
-  mPos++;
-  if (mPos == WNDSIZ * 2) {
-    memmove (&mText[0], &mText[WNDSIZ], WNDSIZ + MAXMATCH);
-    Number = FreadCrc (&mText[WNDSIZ + MAXMATCH], WNDSIZ);
-    mRemainder += Number;
-    mPos = WNDSIZ;
+  if (Ctx->mChainDepth != 0) {
+    ChainInsertNode (Ctx, TRUE);
+    return ;
   }
 
-  DeleteNode ();
-  InsertNode ();
+  DeleteNode (Ctx);
+  InsertNode (Ctx);
 }
 
 STATIC
-EFI_STATUS
+VOID
+SkipNextMatch (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
+  )
+/*++
+
+Routine Description:
+
+  Advance the current position inside a match that has already been
+  output. With hash chains the position only needs to be recorded, so the
+  match search is skipped; the binary tree always needs the full update.
+
+Arguments:
+
+  Ctx     - the compression context
+
+Returns: (VOID)
+
+--*/
+{
+  if (Ctx->mChainDepth == 0) {
+    GetNextMatch (Ctx);
+    return ;
+  }
+
+  AdvancePosition (Ctx);
+  ChainInsertNode (Ctx, FALSE);
+}
+
+STATIC
+VOID
+InitHashChain (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
+  )
+/*++
+
+Routine Description:
+
+  Initialize the hash chain match finder
+
+Arguments:
+
+  Ctx     - the compression context
+
+Returns: (VOID)
+
+--*/
+{
+  memset (Ctx->mHashHead, 0, CHAIN_HASH_SIZE * sizeof (*Ctx->mHashHead));
+  memset (Ctx->mHashPrev, 0, WNDSIZ * sizeof (*Ctx->mHashPrev));
+}
+
+STATIC
+VOID
+ChainInsertNode (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
+  IN BOOLEAN FindMatch
+  )
+/*++
+
+Routine Description:
+
+  Link the current position into its hash chain and, if requested, walk
+  the chain for the longest match within the window. Ties go to the
+  closest candidate, which is visited first.
+
+Arguments:
+
+  Ctx       - the compression context
+  FindMatch - TRUE to search for a match for the current position
+
+Returns: (VOID)
+
+--*/
+{
+  UINT8   *Text;
+  UINT8   *Scan;
+  UINT32  HashValue;
+  UINT32  Depth;
+  INT32   Len;
+  NODE    Candidate;
+  NODE    Next;
+
+  Text      = &Ctx->mText[Ctx->mPos];
+  HashValue = CHAIN_HASH (Text);
+  Candidate = Ctx->mHashHead[HashValue];
+  Ctx->mHashPrev[Ctx->mPos & (WNDSIZ - 1)] = Candidate;
+  Ctx->mHashHead[HashValue] = Ctx->mPos;
+
+  if (!FindMatch) {
+    return ;
+  }
+
+  Ctx->mMatchLen = 0;
+  Depth          = Ctx->mChainDepth;
+  while (Candidate != NIL && Depth-- > 0) {
+    if ((UINT32) (Ctx->mPos - Candidate) >= WNDSIZ) {
+      break;
+    }
+
+    Scan = &Ctx->mText[Candidate];
+    if (Scan[Ctx->mMatchLen] == Text[Ctx->mMatchLen] && Scan[0] == Text[0]) {
+      Len = 0;
+      while (Len < MAXMATCH && Scan[Len] == Text[Len]) {
+        Len++;
+      }
+
+      if (Len > Ctx->mMatchLen) {
+        Ctx->mMatchLen = Len;
+        Ctx->mMatchPos = Candidate;
+        if (Len >= Ctx->mNiceMatch) {
+          break;
+        }
+      }
+    }
+
+    Next = Ctx->mHashPrev[Candidate & (WNDSIZ - 1)];
+    if (Next >= Candidate) {
+      break;
+    }
+
+    Candidate = Next;
+  }
+}
+
+STATIC
+VOID
 Encode (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 /*++
 
@@ -924,58 +1403,65 @@ Routine Description:
 
   The main controlling routine for compression process.
 
-Arguments: (VOID)
+Arguments:
 
-Returns:
-  
-  EFI_SUCCESS           - The compression is successful
-  EFI_OUT_0F_RESOURCES  - Not enough memory for compression process
+  Ctx     - the compression context
+
+Returns: (VOID)
 
 --*/
 {
-  EFI_STATUS  Status;
-  INT32       LastMatchLen;
-  NODE        LastMatchPos;
+  INT32 LastMatchLen;
+  NODE  LastMatchPos;
 
-  Status = AllocateMemory ();
-  if (EFI_ERROR (Status)) {
-    FreeMemory ();
-    return Status;
-  }
+  //
+  // The buffers are reused across calls; clear the window so that the
+  // output does not depend on what a previous call left behind.
+  //
+  memset (Ctx->mText, 0, WNDSIZ * 2 + MAXMATCH);
+  Ctx->mBuf[0] = 0;
 
-  InitSlide ();
+  if (Ctx->mChainDepth != 0) {
+    InitHashChain (Ctx);
+  } else {
+    InitSlide (Ctx);
+  }
 
-  HufEncodeStart ();
+  HufEncodeStart (Ctx);
 
-  mRemainder  = FreadCrc (&mText[WNDSIZ], WNDSIZ + MAXMATCH);
+  Ctx->mRemainder  = FreadCrc (Ctx, &Ctx->mText[WNDSIZ], WNDSIZ + MAXMATCH);
 
-  mMatchLen   = 0;
-  mPos        = WNDSIZ;
-  InsertNode ();
-  if (mMatchLen > mRemainder) {
-    mMatchLen = mRemainder;
+  Ctx->mMatchLen   = 0;
+  Ctx->mPos        = WNDSIZ;
+  if (Ctx->mChainDepth != 0) {
+    ChainInsertNode (Ctx, TRUE);
+  } else {
+    InsertNode (Ctx);
+  }
+  if (Ctx->mMatchLen > Ctx->mRemainder) {
+    Ctx->mMatchLen = Ctx->mRemainder;
   }
 
-  while (mRemainder > 0) {
-    LastMatchLen  = mMatchLen;
-    LastMatchPos  = mMatchPos;
-    GetNextMatch ();
-    if (mMatchLen > mRemainder) {
-      mMatchLen = mRemainder;
+  while (Ctx->mRemainder > 0) {
+    LastMatchLen  = Ctx->mMatchLen;
+    LastMatchPos  = Ctx->mMatchPos;
+    GetNextMatch (Ctx);
+    if (Ctx->mMatchLen > Ctx->mRemainder) {
+      Ctx->mMatchLen = Ctx->mRemainder;
     }
 
-    if (mMatchLen > LastMatchLen || LastMatchLen < THRESHOLD) {
+    if (Ctx->mMatchLen > LastMatchLen || LastMatchLen < THRESHOLD) {
       //
       // Not enough benefits are gained by outputting a pointer,
       // so just output the original character
       //
-      Output (mText[mPos - 1], 0);
+      Output (Ctx, Ctx->mText[Ctx->mPos - 1], 0);
 
     } else {
 
       if (LastMatchLen == THRESHOLD) {
-        if (((mPos - LastMatchPos - 2) & (WNDSIZ - 1)) > (1U << 11)) {
-          Output (mText[mPos - 1], 0);
+        if (((Ctx->mPos - LastMatchPos - 2) & (WNDSIZ - 1)) > (1U << 11)) {
+          Output (Ctx, Ctx->mText[Ctx->mPos - 1], 0);
           continue;
         }
       }
@@ -983,30 +1469,33 @@ Returns:
       // Outputting a pointer is beneficial enough, do it.
       //
       Output (
+        Ctx,
         LastMatchLen + (UINT8_MAX + 1 - THRESHOLD),
-        (mPos - LastMatchPos - 2) & (WNDSIZ - 1)
+        (Ctx->mPos - LastMatchPos - 2) & (WNDSIZ - 1)
         );
       LastMatchLen--;
       while (LastMatchLen > 0) {
-        GetNextMatch ();
+        if (LastMatchLen > 1) {
+          SkipNextMatch (Ctx);
+        } else {
+          GetNextMatch (Ctx);
+        }
         LastMatchLen--;
       }
 
-      if (mMatchLen > mRemainder) {
-        mMatchLen = mRemainder;
+      if (Ctx->mMatchLen > Ctx->mRemainder) {
+        Ctx->mMatchLen = Ctx->mRemainder;
       }
     }
   }
 
-  HufEncodeEnd ();
-  FreeMemory ();
-  return EFI_SUCCESS;
+  HufEncodeEnd (Ctx);
 }
 
 STATIC
 VOID
 CountTFreq (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 /*++
 
@@ -1014,7 +1503,9 @@ Routine Description:
 
   Count the frequencies for the Extra Set
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
@@ -1026,36 +1517,36 @@ Returns: (VOID)
   INT32 Count;
 
   for (Index = 0; Index < NT; Index++) {
-    mTFreq[Index] = 0;
+    Ctx->mTFreq[Index] = 0;
   }
 
   Number = NC;
-  while (Number > 0 && mCLen[Number - 1] == 0) {
+  while (Number > 0 && Ctx->mCLen[Number - 1] == 0) {
     Number--;
   }
 
   Index = 0;
   while (Index < Number) {
-    Index3 = mCLen[Index++];
+    Index3 = Ctx->mCLen[Index++];
     if (Index3 == 0) {
       Count = 1;
-      while (Index < Number && mCLen[Index] == 0) {
+      while (Index < Number && Ctx->mCLen[Index] == 0) {
         Index++;
         Count++;
       }
 
       if (Count <= 2) {
-        mTFreq[0] = (UINT16) (mTFreq[0] + Count);
+        Ctx->mTFreq[0] = (UINT16) (Ctx->mTFreq[0] + Count);
       } else if (Count <= 18) {
-        mTFreq[1]++;
+        Ctx->mTFreq[1]++;
       } else if (Count == 19) {
-        mTFreq[0]++;
-        mTFreq[1]++;
+        Ctx->mTFreq[0]++;
+        Ctx->mTFreq[1]++;
       } else {
-        mTFreq[2]++;
+        Ctx->mTFreq[2]++;
       }
     } else {
-      mTFreq[Index3 + 2]++;
+      Ctx->mTFreq[Index3 + 2]++;
     }
   }
 }
@@ -1063,6 +1554,7 @@ Returns: (VOID)
 STATIC
 VOID
 WritePTLen (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Number,
   IN INT32 nbit,
   IN INT32 Special
@@ -1075,6 +1567,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx          - the compression context
   Number       - the number of symbols
   nbit    - the number of bits needed to represent 'n'
   Special - the special symbol that needs to be take care of
@@ -1086,26 +1579,26 @@ Returns: (VOID)
   INT32 Index;
   INT32 Index3;
 
-  while (Number > 0 && mPTLen[Number - 1] == 0) {
+  while (Number > 0 && Ctx->mPTLen[Number - 1] == 0) {
     Number--;
   }
 
-  PutBits (nbit, Number);
+  PutBits (Ctx, nbit, Number);
   Index = 0;
   while (Index < Number) {
-    Index3 = mPTLen[Index++];
+    Index3 = Ctx->mPTLen[Index++];
     if (Index3 <= 6) {
-      PutBits (3, Index3);
+      PutBits (Ctx, 3, Index3);
     } else {
-      PutBits (Index3 - 3, (1U << (Index3 - 3)) - 2);
+      PutBits (Ctx, Index3 - 3, (1U << (Index3 - 3)) - 2);
     }
 
     if (Index == Special) {
-      while (Index < 6 && mPTLen[Index] == 0) {
+      while (Index < 6 && Ctx->mPTLen[Index] == 0) {
         Index++;
       }
 
-      PutBits (2, (Index - 3) & 3);
+      PutBits (Ctx, 2, (Index - 3) & 3);
     }
   }
 }
@@ -1113,7 +1606,7 @@ Returns: (VOID)
 STATIC
 VOID
 WriteCLen (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 /*++
 
@@ -1121,7 +1614,9 @@ Routine Description:
 
   Outputs the code length array for Char&Length Set
   
-Arguments: (VOID)
+Arguments:
+
+  Ctx     - the compression context
 
 Returns: (VOID)
 
@@ -1133,38 +1628,38 @@ Returns: (VOID)
   INT32 Count;
 
   Number = NC;
-  while (Number > 0 && mCLen[Number - 1] == 0) {
+  while (Number > 0 && Ctx->mCLen[Number - 1] == 0) {
     Number--;
   }
 
-  PutBits (CBIT, Number);
+  PutBits (Ctx, CBIT, Number);
   Index = 0;
   while (Index < Number) {
-    Index3 = mCLen[Index++];
+    Index3 = Ctx->mCLen[Index++];
     if (Index3 == 0) {
       Count = 1;
-      while (Index < Number && mCLen[Index] == 0) {
+      while (Index < Number && Ctx->mCLen[Index] == 0) {
         Index++;
         Count++;
       }
 
       if (Count <= 2) {
         for (Index3 = 0; Index3 < Count; Index3++) {
-          PutBits (mPTLen[0], mPTCode[0]);
+          PutBits (Ctx, Ctx->mPTLen[0], Ctx->mPTCode[0]);
         }
       } else if (Count <= 18) {
-        PutBits (mPTLen[1], mPTCode[1]);
-        PutBits (4, Count - 3);
+        PutBits (Ctx, Ctx->mPTLen[1], Ctx->mPTCode[1]);
+        PutBits (Ctx, 4, Count - 3);
       } else if (Count == 19) {
-        PutBits (mPTLen[0], mPTCode[0]);
-        PutBits (mPTLen[1], mPTCode[1]);
-        PutBits (4, 15);
+        PutBits (Ctx, Ctx->mPTLen[0], Ctx->mPTCode[0]);
+        PutBits (Ctx, Ctx->mPTLen[1], Ctx->mPTCode[1]);
+        PutBits (Ctx, 4, 15);
       } else {
-        PutBits (mPTLen[2], mPTCode[2]);
-        PutBits (CBIT, Count - 20);
+        PutBits (Ctx, Ctx->mPTLen[2], Ctx->mPTCode[2]);
+        PutBits (Ctx, CBIT, Count - 20);
       }
     } else {
-      PutBits (mPTLen[Index3 + 2], mPTCode[Index3 + 2]);
+      PutBits (Ctx, Ctx->mPTLen[Index3 + 2], Ctx->mPTCode[Index3 + 2]);
     }
   }
 }
@@ -1172,15 +1667,17 @@ Returns: (VOID)
 STATIC
 VOID
 EncodeC (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Value
   )
 {
-  PutBits (mCLen[Value], mCCode[Value]);
+  PutBits (Ctx, Ctx->mCLen[Value], Ctx->mCCode[Value]);
 }
 
 STATIC
 VOID
 EncodeP (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 Value
   )
 {
@@ -1194,16 +1691,16 @@ EncodeP (
     Index++;
   }
 
-  PutBits (mPTLen[Index], mPTCode[Index]);
+  PutBits (Ctx, Ctx->mPTLen[Index], Ctx->mPTCode[Index]);
   if (Index > 1) {
-    PutBits (Index - 1, Value & (0xFFFFFFFFU >> (32 - Index + 1)));
+    PutBits (Ctx, Index - 1, Value & (0xFFFFFFFFU >> (32 - Index + 1)));
   }
 }
 
 STATIC
 VOID
 SendBlock (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 /*++
 
@@ -1212,7 +1709,7 @@ Routine Description:
   Huffman code the block and output it.
   
 Arguments: 
-  (VOID)
+  Ctx - the compression context
 
 Returns: 
   (VOID)
@@ -1228,69 +1725,70 @@ Returns:
   UINT32  Size;
   Flags = 0;
 
-  Root  = MakeTree (NC, mCFreq, mCLen, mCCode);
-  Size  = mCFreq[Root];
-  PutBits (16, Size);
+  Root  = MakeTree (Ctx, NC, Ctx->mCFreq, Ctx->mCLen, Ctx->mCCode);
+  Size  = Ctx->mCFreq[Root];
+  PutBits (Ctx, 16, Size);
   if (Root >= NC) {
-    CountTFreq ();
-    Root = MakeTree (NT, mTFreq, mPTLen, mPTCode);
+    CountTFreq (Ctx);
+    Root = MakeTree (Ctx, NT, Ctx->mTFreq, Ctx->mPTLen, Ctx->mPTCode);
     if (Root >= NT) {
-      WritePTLen (NT, TBIT, 3);
+      WritePTLen (Ctx, NT, TBIT, 3);
     } else {
-      PutBits (TBIT, 0);
-      PutBits (TBIT, Root);
+      PutBits (Ctx, TBIT, 0);
+      PutBits (Ctx, TBIT, Root);
     }
 
-    WriteCLen ();
+    WriteCLen (Ctx);
   } else {
-    PutBits (TBIT, 0);
-    PutBits (TBIT, 0);
-    PutBits (CBIT, 0);
-    PutBits (CBIT, Root);
+    PutBits (Ctx, TBIT, 0);
+    PutBits (Ctx, TBIT, 0);
+    PutBits (Ctx, CBIT, 0);
+    PutBits (Ctx, CBIT, Root);
   }
 
-  Root = MakeTree (NP, mPFreq, mPTLen, mPTCode);
+  Root = MakeTree (Ctx, NP, Ctx->mPFreq, Ctx->mPTLen, Ctx->mPTCode);
   if (Root >= NP) {
-    WritePTLen (NP, PBIT, -1);
+    WritePTLen (Ctx, NP, PBIT, -1);
   } else {
-    PutBits (PBIT, 0);
-    PutBits (PBIT, Root);
+    PutBits (Ctx, PBIT, 0);
+    PutBits (Ctx, PBIT, Root);
   }
 
   Pos = 0;
   for (Index = 0; Index < Size; Index++) {
     if (Index % UINT8_BIT == 0) {
-      Flags = mBuf[Pos++];
+      Flags = Ctx->mBuf[Pos++];
     } else {
       Flags <<= 1;
     }
 
     if (Flags & (1U << (UINT8_BIT - 1))) {
-      EncodeC (mBuf[Pos++] + (1U << UINT8_BIT));
-      Index3 = mBuf[Pos++];
+      EncodeC (Ctx, Ctx->mBuf[Pos++] + (1U << UINT8_BIT));
+      Index3 = Ctx->mBuf[Pos++];
       for (Index2 = 0; Index2 < 3; Index2++) {
         Index3 <<= UINT8_BIT;
-        Index3 += mBuf[Pos++];
+        Index3 += Ctx->mBuf[Pos++];
       }
 
-      EncodeP (Index3);
+      EncodeP (Ctx, Index3);
     } else {
-      EncodeC (mBuf[Pos++]);
+      EncodeC (Ctx, Ctx->mBuf[Pos++]);
     }
   }
 
   for (Index = 0; Index < NC; Index++) {
-    mCFreq[Index] = 0;
+    Ctx->mCFreq[Index] = 0;
   }
 
   for (Index = 0; Index < NP; Index++) {
-    mPFreq[Index] = 0;
+    Ctx->mPFreq[Index] = 0;
   }
 }
 
 STATIC
 VOID
 Output (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN UINT32 CharC,
   IN UINT32 Pos
   )
@@ -1302,6 +1800,7 @@ Routine Description:
 
 Arguments:
 
+  Ctx       - the compression context
   CharC     - The original character or the 'String Length' element of a Pointer
   Pos     - The 'Position' field of a Pointer
 
@@ -1309,75 +1808,73 @@ Returns: (VOID)
 
 --*/
 {
-  STATIC UINT32 CPos;
-
-  if ((mOutputMask >>= 1) == 0) {
-    mOutputMask = 1U << (UINT8_BIT - 1);
+  if ((Ctx->mOutputMask >>= 1) == 0) {
+    Ctx->mOutputMask = 1U << (UINT8_BIT - 1);
     //
     // Check the buffer overflow per outputing UINT8_BIT symbols
     // which is an Original Character or a Pointer. The biggest
     // symbol is a Pointer which occupies 5 bytes.
     //
-    if (mOutputPos >= mBufSiz - 5 * UINT8_BIT) {
-      SendBlock ();
-      mOutputPos = 0;
+    if (Ctx->mOutputPos >= Ctx->mBufSiz - 5 * UINT8_BIT) {
+      SendBlock (Ctx);
+      Ctx->mOutputPos = 0;
     }
 
-    CPos        = mOutputPos++;
-    mBuf[CPos]  = 0;
+    Ctx->mCPos            = Ctx->mOutputPos++;
+    Ctx->mBuf[Ctx->mCPos] = 0;
   }
 
-  mBuf[mOutputPos++] = (UINT8) CharC;
-  mCFreq[CharC]++;
+  Ctx->mBuf[Ctx->mOutputPos++] = (UINT8) CharC;
+  Ctx->mCFreq[CharC]++;
   if (CharC >= (1U << UINT8_BIT)) {
-    mBuf[CPos] |= mOutputMask;
-    mBuf[mOutputPos++]  = (UINT8) (Pos >> 24);
-    mBuf[mOutputPos++]  = (UINT8) (Pos >> 16);
-    mBuf[mOutputPos++]  = (UINT8) (Pos >> (UINT8_BIT));
-    mBuf[mOutputPos++]  = (UINT8) Pos;
+    Ctx->mBuf[Ctx->mCPos] |= Ctx->mOutputMask;
+    Ctx->mBuf[Ctx->mOutputPos++]  = (UINT8) (Pos >> 24);
+    Ctx->mBuf[Ctx->mOutputPos++]  = (UINT8) (Pos >> 16);
+    Ctx->mBuf[Ctx->mOutputPos++]  = (UINT8) (Pos >> (UINT8_BIT));
+    Ctx->mBuf[Ctx->mOutputPos++]  = (UINT8) Pos;
     CharC               = 0;
     while (Pos) {
       Pos >>= 1;
       CharC++;
     }
 
-    mPFreq[CharC]++;
+    Ctx->mPFreq[CharC]++;
   }
 }
 
 STATIC
 VOID
 HufEncodeStart (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 {
   INT32 Index;
 
   for (Index = 0; Index < NC; Index++) {
-    mCFreq[Index] = 0;
+    Ctx->mCFreq[Index] = 0;
   }
 
   for (Index = 0; Index < NP; Index++) {
-    mPFreq[Index] = 0;
+    Ctx->mPFreq[Index] = 0;
   }
 
-  mOutputPos = mOutputMask = 0;
-  InitPutBits ();
+  Ctx->mOutputPos = Ctx->mOutputMask = 0;
+  InitPutBits (Ctx);
   return ;
 }
 
 STATIC
 VOID
 HufEncodeEnd (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 {
-  SendBlock ();
+  SendBlock (Ctx);
 
   //
   // Flush remaining bits
   //
-  PutBits (UINT8_BIT - 1, 0);
+  PutBits (Ctx, UINT8_BIT - 1, 0);
 
   return ;
 }
@@ -1385,7 +1882,7 @@ HufEncodeEnd (
 STATIC
 VOID
 MakeCrcTable (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 {
   UINT32  Index;
@@ -1402,13 +1899,14 @@ MakeCrcTable (
       }
     }
 
-    mCrcTable[Index] = (UINT16) Temp;
+    Ctx->mCrcTable[Index] = (UINT16) Temp;
   }
 }
 
 STATIC
 VOID
 PutBits (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32  Number,
   IN UINT32 Value
   )
@@ -1420,6 +1918,7 @@ Routine Description:
 
 Arguments:
 
+  Ctx      - the compression context
   Number   - the rightmost n bits of the data is used
   x   - the data 
 
@@ -1429,26 +1928,27 @@ Returns: (VOID)
 {
   UINT8 Temp;
 
-  while (Number >= mBitCount) {
+  while (Number >= Ctx->mBitCount) {
     //
-    // Number -= mBitCount should never equal to 32
+    // Number -= Ctx->mBitCount should never equal to 32
     //
-    Temp = (UINT8) (mSubBitBuf | (Value >> (Number -= mBitCount)));
-    if (mDst < mDstUpperLimit) {
-      *mDst++ = Temp;
+    Temp = (UINT8) (Ctx->mSubBitBuf | (Value >> (Number -= Ctx->mBitCount)));
+    if (Ctx->mDst < Ctx->mDstUpperLimit) {
+      *Ctx->mDst++ = Temp;
     }
 
-    mCompSize++;
-    mSubBitBuf  = 0;
-    mBitCount   = UINT8_BIT;
+    Ctx->mCompSize++;
+    Ctx->mSubBitBuf  = 0;
+    Ctx->mBitCount   = UINT8_BIT;
   }
 
-  mSubBitBuf |= Value << (mBitCount -= Number);
+  Ctx->mSubBitBuf |= Value << (Ctx->mBitCount -= Number);
 }
 
 STATIC
 INT32
 FreadCrc (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   OUT UINT8 *Pointer,
   IN  INT32 Number
   )
@@ -1460,6 +1960,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx       - the compression context
   Pointer   - the buffer to hold the data
   Number   - number of bytes to read
 
@@ -1471,14 +1972,14 @@ Returns:
 {
   INT32 Index;
 
-  for (Index = 0; mSrc < mSrcUpperLimit && Index < Number; Index++) {
-    *Pointer++ = *mSrc++;
+  for (Index = 0; Ctx->mSrc < Ctx->mSrcUpperLimit && Index < Number; Index++) {
+    *Pointer++ = *Ctx->mSrc++;
   }
 
   Number = Index;
 
   Pointer -= Number;
-  mOrigSize += Number;
+  Ctx->mOrigSize += Number;
   Index--;
   while (Index >= 0) {
     UPDATE_CRC (*Pointer++);
@@ -1491,16 +1992,17 @@ Returns:
 STATIC
 VOID
 InitPutBits (
-  VOID
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx
   )
 {
-  mBitCount   = UINT8_BIT;
-  mSubBitBuf  = 0;
+  Ctx->mBitCount   = UINT8_BIT;
+  Ctx->mSubBitBuf  = 0;
 }
 
 STATIC
 VOID
 CountLen (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Index
   )
 /*++
@@ -1511,27 +2013,27 @@ Routine Description:
   
 Arguments:
 
+  Ctx     - the compression context
   Index   - the top node
   
 Returns: (VOID)
 
 --*/
 {
-  STATIC INT32  Depth = 0;
-
-  if (Index < mN) {
-    mLenCnt[(Depth < 16) ? Depth : 16]++;
+  if (Index < Ctx->mN) {
+    Ctx->mLenCnt[(Ctx->mDepth < 16) ? Ctx->mDepth : 16]++;
   } else {
-    Depth++;
-    CountLen (mLeft[Index]);
-    CountLen (mRight[Index]);
-    Depth--;
+    Ctx->mDepth++;
+    CountLen (Ctx, Ctx->mLeft[Index]);
+    CountLen (Ctx, Ctx->mRight[Index]);
+    Ctx->mDepth--;
   }
 }
 
 STATIC
 VOID
 MakeLen (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Root
   )
 /*++
@@ -1542,6 +2044,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx    - the compression context
   Root   - the root of the tree
   
 Returns:
@@ -1555,10 +2058,10 @@ Returns:
   UINT32  Cum;
 
   for (Index = 0; Index <= 16; Index++) {
-    mLenCnt[Index] = 0;
+    Ctx->mLenCnt[Index] = 0;
   }
 
-  CountLen (Root);
+  CountLen (Ctx, Root);
 
   //
   // Adjust the length count array so that
@@ -1566,15 +2069,15 @@ Returns:
   //
   Cum = 0;
   for (Index = 16; Index > 0; Index--) {
-    Cum += mLenCnt[Index] << (16 - Index);
+    Cum += Ctx->mLenCnt[Index] << (16 - Index);
   }
 
   while (Cum != (1U << 16)) {
-    mLenCnt[16]--;
+    Ctx->mLenCnt[16]--;
     for (Index = 15; Index > 0; Index--) {
-      if (mLenCnt[Index] != 0) {
-        mLenCnt[Index]--;
-        mLenCnt[Index + 1] += 2;
+      if (Ctx->mLenCnt[Index] != 0) {
+        Ctx->mLenCnt[Index]--;
+        Ctx->mLenCnt[Index + 1] += 2;
         break;
       }
     }
@@ -1583,10 +2086,10 @@ Returns:
   }
 
   for (Index = 16; Index > 0; Index--) {
-    Index3 = mLenCnt[Index];
+    Index3 = Ctx->mLenCnt[Index];
     Index3--;
     while (Index3 >= 0) {
-      mLen[*mSortPtr++] = (UINT8) Index;
+      Ctx->mLen[*Ctx->mSortPtr++] = (UINT8) Index;
       Index3--;
     }
   }
@@ -1595,6 +2098,7 @@ Returns:
 STATIC
 VOID
 DownHeap (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN INT32 Index
   )
 {
@@ -1604,28 +2108,29 @@ DownHeap (
   //
   // priority queue: send Index-th entry down heap
   //
-  Index3  = mHeap[Index];
+  Index3  = Ctx->mHeap[Index];
   Index2  = 2 * Index;
-  while (Index2 <= mHeapSize) {
-    if (Index2 < mHeapSize && mFreq[mHeap[Index2]] > mFreq[mHeap[Index2 + 1]]) {
+  while (Index2 <= Ctx->mHeapSize) {
+    if (Index2 < Ctx->mHeapSize && Ctx->mFreq[Ctx->mHeap[Index2]] > Ctx->mFreq[Ctx->mHeap[Index2 + 1]]) {
       Index2++;
     }
 
-    if (mFreq[Index3] <= mFreq[mHeap[Index2]]) {
+    if (Ctx->mFreq[Index3] <= Ctx->mFreq[Ctx->mHeap[Index2]]) {
       break;
     }
 
-    mHeap[Index]  = mHeap[Index2];
+    Ctx->mHeap[Index]  = Ctx->mHeap[Index2];
     Index         = Index2;
     Index2        = 2 * Index;
   }
 
-  mHeap[Index] = (INT16) Index3;
+  Ctx->mHeap[Index] = (INT16) Index3;
 }
 
 STATIC
 VOID
 MakeCode (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN  INT32       Number,
   IN  UINT8 Len[  ],
   OUT UINT16 Code[]
@@ -1638,6 +2143,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx        - the compression context
   Number     - number of symbols
   Len   - the code length array
   Code  - stores codes for each symbol
@@ -1651,7 +2157,7 @@ Returns: (VOID)
 
   Start[1] = 0;
   for (Index = 1; Index <= 16; Index++) {
-    Start[Index + 1] = (UINT16) ((Start[Index] + mLenCnt[Index]) << 1);
+    Start[Index + 1] = (UINT16) ((Start[Index] + Ctx->mLenCnt[Index]) << 1);
   }
 
   for (Index = 0; Index < Number; Index++) {
@@ -1662,6 +2168,7 @@ Returns: (VOID)
 STATIC
 INT32
 MakeTree (
+  IN OUT TIANO_COMPRESS_CONTEXT  *Ctx,
   IN  INT32            NParm,
   IN  UINT16  FreqParm[],
   OUT UINT8   LenParm[ ],
@@ -1675,6 +2182,7 @@ Routine Description:
   
 Arguments:
 
+  Ctx      - the compression context
   NParm    - number of symbols
   FreqParm - frequency of each symbol
   LenParm  - code length for each symbol
@@ -1694,57 +2202,57 @@ Returns:
   //
   // make tree, calculate len[], return root
   //
-  mN        = NParm;
-  mFreq     = FreqParm;
-  mLen      = LenParm;
-  Avail     = mN;
-  mHeapSize = 0;
-  mHeap[1]  = 0;
-  for (Index = 0; Index < mN; Index++) {
-    mLen[Index] = 0;
-    if (mFreq[Index]) {
-      mHeapSize++;
-      mHeap[mHeapSize] = (INT16) Index;
+  Ctx->mN        = NParm;
+  Ctx->mFreq     = FreqParm;
+  Ctx->mLen      = LenParm;
+  Avail     = Ctx->mN;
+  Ctx->mHeapSize = 0;
+  Ctx->mHeap[1]  = 0;
+  for (Index = 0; Index < Ctx->mN; Index++) {
+    Ctx->mLen[Index] = 0;
+    if (Ctx->mFreq[Index]) {
+      Ctx->mHeapSize++;
+      Ctx->mHeap[Ctx->mHeapSize] = (INT16) Index;
     }
   }
 
-  if (mHeapSize < 2) {
-    CodeParm[mHeap[1]] = 0;
-    return mHeap[1];
+  if (Ctx->mHeapSize < 2) {
+    CodeParm[Ctx->mHeap[1]] = 0;
+    return Ctx->mHeap[1];
   }
 
-  for (Index = mHeapSize / 2; Index >= 1; Index--) {
+  for (Index = Ctx->mHeapSize / 2; Index >= 1; Index--) {
     //
     // make priority queue
     //
-    DownHeap (Index);
+    DownHeap (Ctx, Index);
   }
 
-  mSortPtr = CodeParm;
+  Ctx->mSortPtr = CodeParm;
   do {
-    Index = mHeap[1];
-    if (Index < mN) {
-      *mSortPtr++ = (UINT16) Index;
+    Index = Ctx->mHeap[1];
+    if (Index < Ctx->mN) {
+      *Ctx->mSortPtr++ = (UINT16) Index;
     }
 
-    mHeap[1] = mHeap[mHeapSize--];
-    DownHeap (1);
-    Index2 = mHeap[1];
-    if (Index2 < mN) {
-      *mSortPtr++ = (UINT16) Index2;
+    Ctx->mHeap[1] = Ctx->mHeap[Ctx->mHeapSize--];
+    DownHeap (Ctx, 1);
+    Index2 = Ctx->mHeap[1];
+    if (Index2 < Ctx->mN) {
+      *Ctx->mSortPtr++ = (UINT16) Index2;
     }
 
     Index3        = Avail++;
-    mFreq[Index3] = (UINT16) (mFreq[Index] + mFreq[Index2]);
-    mHeap[1]      = (INT16) Index3;
-    DownHeap (1);
-    mLeft[Index3]   = (UINT16) Index;
-    mRight[Index3]  = (UINT16) Index2;
-  } while (mHeapSize > 1);
-
-  mSortPtr = CodeParm;
-  MakeLen (Index3);
-  MakeCode (NParm, LenParm, CodeParm);
+    Ctx->mFreq[Index3] = (UINT16) (Ctx->mFreq[Index] + Ctx->mFreq[Index2]);
+    Ctx->mHeap[1]      = (INT16) Index3;
+    DownHeap (Ctx, 1);
+    Ctx->mLeft[Index3]   = (UINT16) Index;
+    Ctx->mRight[Index3]  = (UINT16) Index2;
+  } while (Ctx->mHeapSize > 1);
+
+  Ctx->mSortPtr = CodeParm;
+  MakeLen (Ctx, Index3);
+  MakeCode (Ctx, NParm, LenParm, CodeParm);
 
   //
   // return root
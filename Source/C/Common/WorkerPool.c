@@ -0,0 +1,249 @@
+/** @file
+
+Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+Module Name:
+
+  WorkerPool.c
+
+Abstract:
+
+  Minimal worker pool running independent jobs on several threads.
+
+**/
+
+#include "WinNtInclude.h"
+
+#ifndef __GNUC__
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include <stdlib.h>
+#include "WorkerPool.h"
+
+#ifndef __GNUC__
+typedef HANDLE            WORKER_THREAD;
+typedef CRITICAL_SECTION  WORKER_LOCK;
+#else
+typedef pthread_t         WORKER_THREAD;
+typedef pthread_mutex_t   WORKER_LOCK;
+#endif
+
+typedef struct {
+  WORKER_POOL_FUNCTION  Function;
+  VOID                  *Context;
+  UINTN                 JobCount;
+  UINTN                 NextJob;
+  WORKER_LOCK           Lock;
+} WORKER_POOL;
+
+STATIC
+VOID
+WorkerPoolLoop (
+  IN WORKER_POOL  *Pool
+  )
+/*++
+
+Routine Description:
+
+  Take the next unstarted job and run it until none is left.
+
+Arguments:
+
+  Pool        - The pool shared by all threads
+
+Returns:
+
+  None
+
+--*/
+{
+  UINTN   JobIndex;
+
+  for (;;) {
+#ifndef __GNUC__
+    EnterCriticalSection (&Pool->Lock);
+    JobIndex = Pool->NextJob++;
+    LeaveCriticalSection (&Pool->Lock);
+#else
+    pthread_mutex_lock (&Pool->Lock);
+    JobIndex = Pool->NextJob++;
+    pthread_mutex_unlock (&Pool->Lock);
+#endif
+    if (JobIndex >= Pool->JobCount) {
+      break;
+    }
+    Pool->Function (Pool->Context, JobIndex);
+  }
+}
+
+#ifndef __GNUC__
+STATIC
+DWORD
+WINAPI
+WorkerThread (
+  IN LPVOID  Pool
+  )
+{
+  WorkerPoolLoop ((WORKER_POOL *) Pool);
+  return 0;
+}
+#else
+STATIC
+VOID *
+WorkerThread (
+  IN VOID  *Pool
+  )
+{
+  WorkerPoolLoop ((WORKER_POOL *) Pool);
+  return NULL;
+}
+#endif
+
+UINTN
+GetProcessorCount (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Get the number of processors available to the process.
+
+Arguments:
+
+  None
+
+Returns:
+
+  The number of online processors, at least 1.
+
+--*/
+{
+#ifndef __GNUC__
+  SYSTEM_INFO   SystemInfo;
+
+  GetSystemInfo (&SystemInfo);
+  if (SystemInfo.dwNumberOfProcessors > 1) {
+    return SystemInfo.dwNumberOfProcessors;
+  }
+#else
+  long          Count;
+
+  Count = sysconf (_SC_NPROCESSORS_ONLN);
+  if (Count > 1) {
+    return (UINTN) Count;
+  }
+#endif
+  return 1;
+}
+
+EFI_STATUS
+RunWorkerPool (
+  IN UINTN                              JobCount,
+  IN UINTN                              ThreadCount,
+  IN WORKER_POOL_FUNCTION               Function,
+  IN VOID                               *Context
+  )
+/*++
+
+Routine Description:
+
+  Call Function once for every job index below JobCount, using up to
+  ThreadCount threads including the calling one. Jobs are handed out in
+  increasing index order but may complete in any order, so Function must
+  only touch state owned by its job. The routine returns when all jobs are
+  complete. If no extra thread can be started, all jobs run on the calling
+  thread.
+
+Arguments:
+
+  JobCount    - The number of jobs to run
+  ThreadCount - The maximum number of threads, or 0 for one per processor
+  Function    - The routine run for each job
+  Context     - Passed unchanged to Function
+
+Returns:
+
+  EFI_SUCCESS               - All jobs were run.
+  EFI_INVALID_PARAMETER     - Function is NULL.
+
+--*/
+{
+  WORKER_POOL     Pool;
+  WORKER_THREAD   *Threads;
+  UINTN           Started;
+  UINTN           Index;
+
+  if (Function == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (ThreadCount == 0) {
+    ThreadCount = GetProcessorCount ();
+  }
+  if (ThreadCount > JobCount) {
+    ThreadCount = JobCount;
+  }
+
+  Pool.Function = Function;
+  Pool.Context  = Context;
+  Pool.JobCount = JobCount;
+  Pool.NextJob  = 0;
+
+  //
+  // The calling thread is one of the workers, so only ThreadCount - 1
+  // threads are started.
+  //
+  Threads = NULL;
+  Started = 0;
+  if (ThreadCount > 1) {
+    Threads = (WORKER_THREAD *) malloc ((ThreadCount - 1) * sizeof (WORKER_THREAD));
+  }
+
+#ifndef __GNUC__
+  InitializeCriticalSection (&Pool.Lock);
+  if (Threads != NULL) {
+    for (Started = 0; Started < ThreadCount - 1; Started++) {
+      Threads[Started] = CreateThread (NULL, 0, WorkerThread, &Pool, 0, NULL);
+      if (Threads[Started] == NULL) {
+        break;
+      }
+    }
+  }
+  WorkerPoolLoop (&Pool);
+  for (Index = 0; Index < Started; Index++) {
+    WaitForSingleObject (Threads[Index], INFINITE);
+    CloseHandle (Threads[Index]);
+  }
+  DeleteCriticalSection (&Pool.Lock);
+#else
+  pthread_mutex_init (&Pool.Lock, NULL);
+  if (Threads != NULL) {
+    for (Started = 0; Started < ThreadCount - 1; Started++) {
+      if (pthread_create (&Threads[Started], NULL, WorkerThread, &Pool) != 0) {
+        break;
+      }
+    }
+  }
+  WorkerPoolLoop (&Pool);
+  for (Index = 0; Index < Started; Index++) {
+    pthread_join (Threads[Index], NULL);
+  }
+  pthread_mutex_destroy (&Pool.Lock);
+#endif
+
+  if (Threads != NULL) {
+    free (Threads);
+  }
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,90 @@
+/** @file
+
+Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+Module Name:
+
+  WorkerPool.h
+
+Abstract:
+
+  Header file for a minimal worker pool that runs a number of independent
+  jobs on several threads. Tools using it must link the platform thread
+  library (-lpthread on POSIX hosts).
+
+**/
+
+#ifndef _WORKER_POOL_H
+#define _WORKER_POOL_H
+
+#include <Common/UefiBaseTypes.h>
+
+typedef
+VOID
+(*WORKER_POOL_FUNCTION) (
+  IN VOID                               *Context,
+  IN UINTN                              JobIndex
+  );
+
+UINTN
+GetProcessorCount (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Get the number of processors available to the process.
+
+Arguments:
+
+  None
+
+Returns:
+
+  The number of online processors, at least 1.
+
+--*/
+;
+
+EFI_STATUS
+RunWorkerPool (
+  IN UINTN                              JobCount,
+  IN UINTN                              ThreadCount,
+  IN WORKER_POOL_FUNCTION               Function,
+  IN VOID                               *Context
+  )
+/*++
+
+Routine Description:
+
+  Call Function once for every job index below JobCount, using up to
+  ThreadCount threads including the calling one. Jobs are handed out in
+  increasing index order but may complete in any order, so Function must
+  only touch state owned by its job. The routine returns when all jobs are
+  complete. If no extra thread can be started, all jobs run on the calling
+  thread.
+
+Arguments:
+
+  JobCount    - The number of jobs to run
+  ThreadCount - The maximum number of threads, or 0 for one per processor
+  Function    - The routine run for each job
+  Context     - Passed unchanged to Function
+
+Returns:
+
+  EFI_SUCCESS               - All jobs were run.
+  EFI_INVALID_PARAMETER     - Function is NULL.
+
+--*/
+;
+
+#endif
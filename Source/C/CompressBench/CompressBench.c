@@ -0,0 +1,863 @@
+/** @file
+
+Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+Module Name:
+
+  CompressBench.c
+
+Abstract:
+
+  Measure throughput, ratio and memory use of the BaseTools codecs over a
+  corpus of sample files, and report the results as CSV or JSON.
+
+**/
+
+#include "WinNtInclude.h"
+
+#ifndef __GNUC__
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Common/UefiBaseTypes.h>
+
+#include "Sdk/C/LzmaDec.h"
+#include "Sdk/C/LzmaEnc.h"
+#include "Sdk/C/Bra.h"
+#include "CommonLib.h"
+#include "EfiUtilityMsgs.h"
+#include "ParseInf.h"
+#include "Compress.h"
+#include "Decompress.h"
+
+//
+// Utility Name
+//
+#define UTILITY_NAME  "CompressBench"
+
+//
+// Utility version information
+//
+#define UTILITY_MAJOR_VERSION 0
+#define UTILITY_MINOR_VERSION 1
+
+#define DEFAULT_ITERATIONS    3
+#define LZMA_HEADER_SIZE      (LZMA_PROPS_SIZE + 8)
+
+typedef
+EFI_STATUS
+(*CODEC_COMPRESS) (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN OUT  UINT32  *DstSize
+  );
+
+typedef
+EFI_STATUS
+(*CODEC_DECOMPRESS) (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN      UINT32  DstSize
+  );
+
+typedef struct {
+  CHAR8             *Name;
+  CODEC_COMPRESS    Compress;
+  CODEC_DECOMPRESS  Decompress;
+  BOOLEAN           Selected;
+} CODEC;
+
+//
+// Result of one codec on one file
+//
+typedef struct {
+  UINT32    OriginalSize;
+  UINT32    CompressedSize;
+  double    CompressSeconds;
+  double    DecompressSeconds;
+  UINT64    PeakRssKb;
+  INT32     Status;
+} BENCH_RESULT;
+
+#define BENCH_OK            0
+#define BENCH_READ_ERROR    1
+#define BENCH_CODEC_ERROR   2
+#define BENCH_VERIFY_ERROR  3
+
+STATIC CONST CHAR8  *mStatusName[] = { "ok", "read-error", "codec-error", "verify-error" };
+
+STATIC UINT32   mIterations = DEFAULT_ITERATIONS;
+STATIC BOOLEAN  mJson       = FALSE;
+STATIC BOOLEAN  mFirstJson  = TRUE;
+STATIC FILE     *mOut       = NULL;
+
+STATIC void *SzAlloc (void *p, size_t size) { return malloc (size); }
+STATIC void SzFree (void *p, void *address) { free (address); }
+STATIC ISzAlloc mSzAlloc = { SzAlloc, SzFree };
+
+STATIC
+EFI_STATUS
+LzmaCodecCompress (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN OUT  UINT32  *DstSize,
+  IN      BOOLEAN X86Filter
+  )
+/*++
+
+Routine Description:
+
+  Encode like "LzmaCompress -e [--f86]": default properties and a 13 byte
+  properties and size header.
+
+Arguments:
+
+  SrcBuffer   - The data to compress
+  SrcSize     - The size of SrcBuffer
+  DstBuffer   - The output buffer
+  DstSize     - On input the size of DstBuffer, on output the encoded size
+  X86Filter   - Apply the x86 branch converter before encoding
+
+Returns:
+
+  EFI_SUCCESS, EFI_OUT_OF_RESOURCES or EFI_ABORTED
+
+--*/
+{
+  CLzmaEncProps   Props;
+  UINT8           *Filtered;
+  SizeT           OutSize;
+  SizeT           PropsSize;
+  UInt32          X86State;
+  SRes            Res;
+  UINTN           Index;
+
+  if (*DstSize < LZMA_HEADER_SIZE) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  Filtered = NULL;
+  if (X86Filter) {
+    Filtered = malloc (SrcSize);
+    if (Filtered == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    memcpy (Filtered, SrcBuffer, SrcSize);
+    x86_Convert_Init (X86State);
+    x86_Convert (Filtered, SrcSize, 0, &X86State, 1);
+    SrcBuffer = Filtered;
+  }
+
+  LzmaEncProps_Init (&Props);
+  LzmaEncProps_Normalize (&Props);
+
+  for (Index = 0; Index < 8; Index++) {
+    DstBuffer[LZMA_PROPS_SIZE + Index] = (UINT8) (Index < 4 ? SrcSize >> (8 * Index) : 0);
+  }
+  OutSize   = *DstSize - LZMA_HEADER_SIZE;
+  PropsSize = LZMA_PROPS_SIZE;
+  Res = LzmaEncode (
+          DstBuffer + LZMA_HEADER_SIZE,
+          &OutSize,
+          SrcBuffer,
+          SrcSize,
+          &Props,
+          DstBuffer,
+          &PropsSize,
+          0,
+          NULL,
+          &mSzAlloc,
+          &mSzAlloc
+          );
+  if (Filtered != NULL) {
+    free (Filtered);
+  }
+  if (Res != SZ_OK) {
+    return EFI_ABORTED;
+  }
+
+  *DstSize = (UINT32) (OutSize + LZMA_HEADER_SIZE);
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+LzmaCodecDecompress (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN      UINT32  DstSize,
+  IN      BOOLEAN X86Filter
+  )
+/*++
+
+Routine Description:
+
+  Decode the output of LzmaCodecCompress.
+
+Arguments:
+
+  SrcBuffer   - The encoded data
+  SrcSize     - The size of SrcBuffer
+  DstBuffer   - The output buffer
+  DstSize     - The decoded size
+  X86Filter   - Undo the x86 branch converter after decoding
+
+Returns:
+
+  EFI_SUCCESS or EFI_ABORTED
+
+--*/
+{
+  SizeT       OutSize;
+  SizeT       InSize;
+  ELzmaStatus Status;
+  UInt32      X86State;
+
+  if (SrcSize < LZMA_HEADER_SIZE) {
+    return EFI_ABORTED;
+  }
+
+  OutSize = DstSize;
+  InSize  = SrcSize - LZMA_HEADER_SIZE;
+  if (LzmaDecode (
+        DstBuffer,
+        &OutSize,
+        SrcBuffer + LZMA_HEADER_SIZE,
+        &InSize,
+        SrcBuffer,
+        LZMA_PROPS_SIZE,
+        LZMA_FINISH_END,
+        &Status,
+        &mSzAlloc
+        ) != SZ_OK || OutSize != DstSize) {
+    return EFI_ABORTED;
+  }
+
+  if (X86Filter) {
+    x86_Convert_Init (X86State);
+    x86_Convert (DstBuffer, DstSize, 0, &X86State, 0);
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+LzmaCompress (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN OUT  UINT32  *DstSize
+  )
+{
+  return LzmaCodecCompress (SrcBuffer, SrcSize, DstBuffer, DstSize, FALSE);
+}
+
+STATIC
+EFI_STATUS
+LzmaDecompress (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN      UINT32  DstSize
+  )
+{
+  return LzmaCodecDecompress (SrcBuffer, SrcSize, DstBuffer, DstSize, FALSE);
+}
+
+STATIC
+EFI_STATUS
+LzmaF86Compress (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN OUT  UINT32  *DstSize
+  )
+{
+  return LzmaCodecCompress (SrcBuffer, SrcSize, DstBuffer, DstSize, TRUE);
+}
+
+STATIC
+EFI_STATUS
+LzmaF86Decompress (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN      UINT32  DstSize
+  )
+{
+  return LzmaCodecDecompress (SrcBuffer, SrcSize, DstBuffer, DstSize, TRUE);
+}
+
+STATIC
+EFI_STATUS
+EfiCodecDecompress (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN      UINT32  DstSize
+  )
+/*++
+
+Routine Description:
+
+  EfiDecompress with a scratch buffer sized by EfiGetInfo.
+
+--*/
+{
+  EFI_STATUS  Status;
+  UINT32      OrigSize;
+  UINT32      ScratchSize;
+  VOID        *Scratch;
+
+  Status = EfiGetInfo (SrcBuffer, SrcSize, &OrigSize, &ScratchSize);
+  if (EFI_ERROR (Status) || OrigSize != DstSize) {
+    return EFI_ABORTED;
+  }
+  Scratch = malloc (ScratchSize);
+  if (Scratch == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Status = EfiDecompress (SrcBuffer, SrcSize, DstBuffer, DstSize, Scratch, ScratchSize);
+  free (Scratch);
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+TianoCodecDecompress (
+  IN      UINT8   *SrcBuffer,
+  IN      UINT32  SrcSize,
+  IN      UINT8   *DstBuffer,
+  IN      UINT32  DstSize
+  )
+/*++
+
+Routine Description:
+
+  TianoDecompress with a scratch buffer sized by TianoGetInfo.
+
+--*/
+{
+  EFI_STATUS  Status;
+  UINT32      OrigSize;
+  UINT32      ScratchSize;
+  VOID        *Scratch;
+
+  Status = TianoGetInfo (SrcBuffer, SrcSize, &OrigSize, &ScratchSize);
+  if (EFI_ERROR (Status) || OrigSize != DstSize) {
+    return EFI_ABORTED;
+  }
+  Scratch = malloc (ScratchSize);
+  if (Scratch == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  Status = TianoDecompress (SrcBuffer, SrcSize, DstBuffer, DstSize, Scratch, ScratchSize);
+  free (Scratch);
+  return Status;
+}
+
+STATIC CODEC  mCodecs[] = {
+  { "efi",      EfiCompress,     EfiCodecDecompress,   FALSE },
+  { "tiano",    TianoCompress,   TianoCodecDecompress, FALSE },
+  { "lzma",     LzmaCompress,    LzmaDecompress,       FALSE },
+  { "lzma-f86", LzmaF86Compress, LzmaF86Decompress,    FALSE }
+};
+
+#define CODEC_COUNT (sizeof (mCodecs) / sizeof (mCodecs[0]))
+
+STATIC
+double
+GetSeconds (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Read a monotonic high resolution clock.
+
+Returns:
+
+  The current time in seconds.
+
+--*/
+{
+#ifndef __GNUC__
+  LARGE_INTEGER Counter;
+  LARGE_INTEGER Frequency;
+
+  QueryPerformanceCounter (&Counter);
+  QueryPerformanceFrequency (&Frequency);
+  return (double) Counter.QuadPart / (double) Frequency.QuadPart;
+#else
+  struct timeval  Now;
+
+  gettimeofday (&Now, NULL);
+  return (double) Now.tv_sec + (double) Now.tv_usec / 1000000.0;
+#endif
+}
+
+STATIC
+VOID
+RunCodec (
+  IN  CODEC         *Codec,
+  IN  CHAR8         *FileName,
+  OUT BENCH_RESULT  *Result
+  )
+/*++
+
+Routine Description:
+
+  Load a file, then compress and decompress it mIterations times with one
+  codec. The fastest iteration of each phase is reported, and every
+  iteration's output is checked against the original.
+
+Arguments:
+
+  Codec       - The codec to run
+  FileName    - The sample file
+  Result      - Receives the measurements
+
+Returns:
+
+  None
+
+--*/
+{
+  UINT8       *Original;
+  UINT8       *Compressed;
+  UINT8       *Decompressed;
+  UINT32      FileSize;
+  UINT32      BufferSize;
+  UINT32      CompressedSize;
+  UINT32      Iteration;
+  double      Start;
+  double      Elapsed;
+  EFI_STATUS  Status;
+
+  memset (Result, 0, sizeof (*Result));
+  Compressed   = NULL;
+  Decompressed = NULL;
+
+  if (GetFileImage (FileName, (CHAR8 **) &Original, &FileSize) != EFI_SUCCESS) {
+    Result->Status = BENCH_READ_ERROR;
+    return;
+  }
+  Result->OriginalSize = FileSize;
+
+  //
+  // Room for incompressible data plus codec headers
+  //
+  BufferSize   = FileSize + FileSize / 8 + 0x10000;
+  Compressed   = malloc (BufferSize);
+  Decompressed = malloc (FileSize + 1);
+  if (Compressed == NULL || Decompressed == NULL) {
+    Result->Status = BENCH_CODEC_ERROR;
+    goto Done;
+  }
+
+  for (Iteration = 0; Iteration < mIterations; Iteration++) {
+    CompressedSize = BufferSize;
+    Start  = GetSeconds ();
+    Status = Codec->Compress (Original, FileSize, Compressed, &CompressedSize);
+    Elapsed = GetSeconds () - Start;
+    if (EFI_ERROR (Status)) {
+      Result->Status = BENCH_CODEC_ERROR;
+      goto Done;
+    }
+    if (Iteration == 0 || Elapsed < Result->CompressSeconds) {
+      Result->CompressSeconds = Elapsed;
+    }
+    Result->CompressedSize = CompressedSize;
+
+    memset (Decompressed, 0, FileSize);
+    Start  = GetSeconds ();
+    Status = Codec->Decompress (Compressed, CompressedSize, Decompressed, FileSize);
+    Elapsed = GetSeconds () - Start;
+    if (EFI_ERROR (Status)) {
+      Result->Status = BENCH_CODEC_ERROR;
+      goto Done;
+    }
+    if (Iteration == 0 || Elapsed < Result->DecompressSeconds) {
+      Result->DecompressSeconds = Elapsed;
+    }
+
+    if (memcmp (Original, Decompressed, FileSize) != 0) {
+      Result->Status = BENCH_VERIFY_ERROR;
+      goto Done;
+    }
+  }
+
+Done:
+  free (Original);
+  if (Compressed != NULL) {
+    free (Compressed);
+  }
+  if (Decompressed != NULL) {
+    free (Decompressed);
+  }
+}
+
+STATIC
+VOID
+MeasureCodec (
+  IN  CODEC         *Codec,
+  IN  CHAR8         *FileName,
+  OUT BENCH_RESULT  *Result
+  )
+/*++
+
+Routine Description:
+
+  Run one codec on one file and record its peak resident set size. On POSIX
+  hosts the run happens in a child process, so the peak belongs to this
+  codec and file alone. On Windows the process peak working set is
+  reported, which includes earlier runs.
+
+Arguments:
+
+  Codec       - The codec to run
+  FileName    - The sample file
+  Result      - Receives the measurements
+
+Returns:
+
+  None
+
+--*/
+{
+#ifndef __GNUC__
+  PROCESS_MEMORY_COUNTERS Counters;
+
+  RunCodec (Codec, FileName, Result);
+  if (GetProcessMemoryInfo (GetCurrentProcess (), &Counters, sizeof (Counters))) {
+    Result->PeakRssKb = Counters.PeakWorkingSetSize / 1024;
+  }
+#else
+  int           Pipe[2];
+  pid_t         Child;
+  int           ExitStatus;
+  struct rusage Usage;
+  ssize_t       Count;
+
+  if (pipe (Pipe) != 0) {
+    RunCodec (Codec, FileName, Result);
+    return;
+  }
+
+  fflush (NULL);
+  Child = fork ();
+  if (Child == 0) {
+    close (Pipe[0]);
+    RunCodec (Codec, FileName, Result);
+    Count = write (Pipe[1], Result, sizeof (*Result));
+    _exit (Count == sizeof (*Result) ? 0 : 1);
+  }
+
+  close (Pipe[1]);
+  if (Child < 0) {
+    close (Pipe[0]);
+    RunCodec (Codec, FileName, Result);
+    return;
+  }
+
+  Count = read (Pipe[0], Result, sizeof (*Result));
+  close (Pipe[0]);
+  memset (&Usage, 0, sizeof (Usage));
+  wait4 (Child, &ExitStatus, 0, &Usage);
+  if (Count != sizeof (*Result)) {
+    memset (Result, 0, sizeof (*Result));
+    Result->Status = BENCH_CODEC_ERROR;
+  }
+#ifdef __APPLE__
+  Result->PeakRssKb = (UINT64) Usage.ru_maxrss / 1024;
+#else
+  Result->PeakRssKb = (UINT64) Usage.ru_maxrss;
+#endif
+#endif
+}
+
+STATIC
+double
+Throughput (
+  IN UINT32   Size,
+  IN double   Seconds
+  )
+{
+  return Seconds > 0 ? (double) Size / Seconds / (1024.0 * 1024.0) : 0.0;
+}
+
+STATIC
+VOID
+PrintResult (
+  IN CODEC          *Codec,
+  IN CHAR8          *FileName,
+  IN BENCH_RESULT   *Result
+  )
+/*++
+
+Routine Description:
+
+  Write one result row in the selected output format.
+
+--*/
+{
+  double  Ratio;
+  CHAR8   *Char;
+
+  Ratio = Result->OriginalSize != 0 ? (double) Result->CompressedSize / Result->OriginalSize : 0.0;
+
+  if (mJson) {
+    fprintf (mOut, "%s\n  {\"file\": \"", mFirstJson ? "" : ",");
+    for (Char = FileName; *Char != '\0'; Char++) {
+      if (*Char == '"' || *Char == '\\') {
+        fputc ('\\', mOut);
+      }
+      fputc (*Char, mOut);
+    }
+    fprintf (
+      mOut,
+      "\", \"codec\": \"%s\", \"size\": %u, \"compressed\": %u, "
+      "\"ratio\": %.4f, \"compress_ms\": %.3f, \"decompress_ms\": %.3f, "
+      "\"compress_mbps\": %.2f, \"decompress_mbps\": %.2f, \"peak_rss_kb\": %llu, \"status\": \"%s\"}",
+      Codec->Name,
+      (unsigned) Result->OriginalSize,
+      (unsigned) Result->CompressedSize,
+      Ratio,
+      Result->CompressSeconds * 1000.0,
+      Result->DecompressSeconds * 1000.0,
+      Throughput (Result->OriginalSize, Result->CompressSeconds),
+      Throughput (Result->OriginalSize, Result->DecompressSeconds),
+      (unsigned long long) Result->PeakRssKb,
+      mStatusName[Result->Status]
+      );
+    mFirstJson = FALSE;
+  } else {
+    fprintf (
+      mOut,
+      "%s,%s,%u,%u,%.4f,%.3f,%.3f,%.2f,%.2f,%llu,%s\n",
+      FileName,
+      Codec->Name,
+      (unsigned) Result->OriginalSize,
+      (unsigned) Result->CompressedSize,
+      Ratio,
+      Result->CompressSeconds * 1000.0,
+      Result->DecompressSeconds * 1000.0,
+      Throughput (Result->OriginalSize, Result->CompressSeconds),
+      Throughput (Result->OriginalSize, Result->DecompressSeconds),
+      (unsigned long long) Result->PeakRssKb,
+      mStatusName[Result->Status]
+      );
+  }
+}
+
+STATIC
+VOID
+Version (
+  VOID
+  )
+{
+  fprintf (stdout, "%s Version %d.%d %s \n", UTILITY_NAME, UTILITY_MAJOR_VERSION, UTILITY_MINOR_VERSION, __BUILD_VERSION);
+}
+
+STATIC
+VOID
+Usage (
+  VOID
+  )
+{
+  Version ();
+  fprintf (stdout, "Copyright (c) 2026, Intel Corporation. All rights reserved.\n\n");
+  fprintf (stdout, "Usage: %s [options] File [File ...]\n\n", UTILITY_NAME);
+  fprintf (stdout, "Compress and decompress every File with each selected codec and report\n");
+  fprintf (stdout, "ratio, per-phase time, MB/s and peak resident memory.\n\n");
+  fprintf (stdout, "Options:\n");
+  fprintf (stdout, "  -c Codec, --codec Codec\n");
+  fprintf (stdout, "                        Run only this codec; may be repeated. Codecs are\n");
+  fprintf (stdout, "                        efi, tiano, lzma and lzma-f86. Default is all.\n");
+  fprintf (stdout, "  -n Count, --iterations Count\n");
+  fprintf (stdout, "                        Runs per phase; the fastest is reported. Default 3.\n");
+  fprintf (stdout, "  --json                Write JSON instead of CSV.\n");
+  fprintf (stdout, "  -o FileName, --output FileName\n");
+  fprintf (stdout, "                        Write the report to FileName instead of stdout.\n");
+  fprintf (stdout, "  -h, --help            Show this help message and exit.\n");
+  fprintf (stdout, "  --version             Show program's version number and exit.\n");
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+/*++
+
+Routine Description:
+
+  Main entry point of CompressBench.
+
+Arguments:
+
+  argc        - Number of command line arguments
+  argv        - Command line arguments
+
+Returns:
+
+  0 if every run succeeded and round-tripped, 1 otherwise.
+
+--*/
+{
+  CHAR8         *OutputFileName;
+  CHAR8         **Files;
+  UINTN         FileCount;
+  UINTN         FileIndex;
+  UINTN         CodecIndex;
+  BOOLEAN       AnySelected;
+  BENCH_RESULT  Result;
+  UINT64        Value;
+  int           ReturnCode;
+
+  SetUtilityName (UTILITY_NAME);
+
+  argc--;
+  argv++;
+  if (argc == 0) {
+    Usage ();
+    return STATUS_ERROR;
+  }
+
+  OutputFileName = NULL;
+  AnySelected    = FALSE;
+  FileCount      = 0;
+  Files          = malloc (argc * sizeof (CHAR8 *));
+  if (Files == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    return STATUS_ERROR;
+  }
+
+  while (argc > 0) {
+    if (stricmp (argv[0], "-h") == 0 || stricmp (argv[0], "--help") == 0) {
+      Usage ();
+      return STATUS_SUCCESS;
+    }
+    if (stricmp (argv[0], "--version") == 0) {
+      Version ();
+      return STATUS_SUCCESS;
+    }
+    if ((stricmp (argv[0], "-c") == 0 || stricmp (argv[0], "--codec") == 0) && argc > 1) {
+      for (CodecIndex = 0; CodecIndex < CODEC_COUNT; CodecIndex++) {
+        if (stricmp (argv[1], mCodecs[CodecIndex].Name) == 0) {
+          mCodecs[CodecIndex].Selected = TRUE;
+          AnySelected = TRUE;
+          break;
+        }
+      }
+      if (CodecIndex == CODEC_COUNT) {
+        Error (NULL, 0, 1003, "Invalid option value", "unknown codec %s", argv[1]);
+        return STATUS_ERROR;
+      }
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+    if ((stricmp (argv[0], "-n") == 0 || stricmp (argv[0], "--iterations") == 0) && argc > 1) {
+      if (EFI_ERROR (AsciiStringToUint64 (argv[1], FALSE, &Value)) || Value == 0 || Value > 1000) {
+        Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
+        return STATUS_ERROR;
+      }
+      mIterations = (UINT32) Value;
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+    if ((stricmp (argv[0], "-o") == 0 || stricmp (argv[0], "--output") == 0) && argc > 1) {
+      OutputFileName = argv[1];
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+    if (stricmp (argv[0], "--json") == 0) {
+      mJson = TRUE;
+      argc--;
+      argv++;
+      continue;
+    }
+    if (argv[0][0] == '-') {
+      Error (NULL, 0, 1000, "Unknown option", "%s", argv[0]);
+      return STATUS_ERROR;
+    }
+    Files[FileCount++] = argv[0];
+    argc--;
+    argv++;
+  }
+
+  if (FileCount == 0) {
+    Error (NULL, 0, 1001, "Missing option", "no sample files specified");
+    return STATUS_ERROR;
+  }
+  if (!AnySelected) {
+    for (CodecIndex = 0; CodecIndex < CODEC_COUNT; CodecIndex++) {
+      mCodecs[CodecIndex].Selected = TRUE;
+    }
+  }
+
+  mOut = stdout;
+  if (OutputFileName != NULL) {
+    mOut = fopen (OutputFileName, "w");
+    if (mOut == NULL) {
+      Error (NULL, 0, 0001, "Error opening file", OutputFileName);
+      return STATUS_ERROR;
+    }
+  }
+
+  if (mJson) {
+    fprintf (mOut, "[");
+  } else {
+    fprintf (mOut, "file,codec,size,compressed,ratio,compress_ms,decompress_ms,compress_mbps,decompress_mbps,peak_rss_kb,status\n");
+  }
+
+  ReturnCode = 0;
+  for (FileIndex = 0; FileIndex < FileCount; FileIndex++) {
+    for (CodecIndex = 0; CodecIndex < CODEC_COUNT; CodecIndex++) {
+      if (!mCodecs[CodecIndex].Selected) {
+        continue;
+      }
+      MeasureCodec (&mCodecs[CodecIndex], Files[FileIndex], &Result);
+      PrintResult (&mCodecs[CodecIndex], Files[FileIndex], &Result);
+      fflush (mOut);
+      if (Result.Status != BENCH_OK) {
+        ReturnCode = 1;
+      }
+    }
+  }
+
+  if (mJson) {
+    fprintf (mOut, "\n]\n");
+  }
+  if (mOut != stdout) {
+    fclose (mOut);
+  }
+  free (Files);
+
+  return ReturnCode;
+}
@@ -0,0 +1,205 @@
+/** @file
+
+Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+Module Name:
+
+  Crc32Bench.c
+
+Abstract:
+  Check every CRC32 engine against the table engine and report throughput.
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Crc32.h"
+
+#define BENCH_DEFAULT_SIZE        (16 * 1024 * 1024)
+#define BENCH_DEFAULT_ITERATIONS  8
+#define BENCH_CHECK_SIZE          4096
+
+STATIC CONST CHAR8  *mEngineName[Crc32EngineMax] = {
+  "auto",
+  "table",
+  "slice16",
+  "pclmul"
+};
+
+STATIC
+UINT32
+EngineCrc (
+  IN CRC32_ENGINE   Engine,
+  IN UINT8          *Data,
+  IN UINTN          DataSize,
+  IN UINTN          ChunkSize
+  )
+/*++
+
+Routine Description:
+
+  Calculate the CRC32 of Data with the given engine, passing it to
+  Crc32Update in pieces of ChunkSize bytes.
+
+Arguments:
+
+  Engine      - The engine to use
+  Data        - The data to checksum
+  DataSize    - The size of Data
+  ChunkSize   - The size of each Crc32Update call
+
+Returns:
+
+  The CRC32 checksum of Data.
+
+--*/
+{
+  CRC32_CONTEXT Context;
+  UINTN         Size;
+
+  Crc32SetEngine (Engine);
+  Crc32Init (&Context);
+  while (DataSize > 0) {
+    Size = DataSize < ChunkSize ? DataSize : ChunkSize;
+    Crc32Update (&Context, Data, Size);
+    Data     += Size;
+    DataSize -= Size;
+  }
+  return Crc32Final (&Context);
+}
+
+STATIC
+BOOLEAN
+CheckEngine (
+  IN CRC32_ENGINE   Engine,
+  IN UINT8          *Data
+  )
+/*++
+
+Routine Description:
+
+  Compare an engine with the table engine for every length and alignment
+  up to BENCH_CHECK_SIZE, in one piece and in odd sized pieces.
+
+Arguments:
+
+  Engine      - The engine to check
+  Data        - At least BENCH_CHECK_SIZE + 16 bytes of test data
+
+Returns:
+
+  TRUE if the engine matches the table engine.
+
+--*/
+{
+  UINTN   Offset;
+  UINTN   Size;
+  UINT32  Expected;
+
+  for (Offset = 0; Offset < 16; Offset++) {
+    for (Size = 0; Size <= BENCH_CHECK_SIZE; Size += (Size < 256) ? 1 : 61) {
+      Expected = EngineCrc (Crc32EngineTable, Data + Offset, Size, Size + 1);
+      if (EngineCrc (Engine, Data + Offset, Size, Size + 1) != Expected ||
+          EngineCrc (Engine, Data + Offset, Size, 77) != Expected) {
+        fprintf (stderr, "Crc32Bench: %s engine mismatch at offset %u size %u\n",
+          mEngineName[Engine], (unsigned) Offset, (unsigned) Size);
+        return FALSE;
+      }
+    }
+  }
+  return TRUE;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+/*++
+
+Routine Description:
+
+  Crc32Bench [SizeInBytes [Iterations]]
+
+Arguments:
+
+  argc        - Number of command line arguments
+  argv        - Command line arguments
+
+Returns:
+
+  0 if every available engine produced correct results, 1 otherwise.
+
+--*/
+{
+  UINT8         *Buffer;
+  UINTN         Size;
+  UINTN         Iterations;
+  UINTN         Index;
+  UINTN         Iteration;
+  CRC32_ENGINE  Engine;
+  UINT32        Crc;
+  clock_t       Start;
+  double        Seconds;
+  int           Result;
+
+  Size       = (argc > 1) ? (UINTN) strtoul (argv[1], NULL, 0) : BENCH_DEFAULT_SIZE;
+  Iterations = (argc > 2) ? (UINTN) strtoul (argv[2], NULL, 0) : BENCH_DEFAULT_ITERATIONS;
+  if (Size < BENCH_CHECK_SIZE + 16) {
+    Size = BENCH_CHECK_SIZE + 16;
+  }
+  if (Iterations == 0) {
+    Iterations = 1;
+  }
+
+  Buffer = malloc (Size);
+  if (Buffer == NULL) {
+    fprintf (stderr, "Crc32Bench: out of memory\n");
+    return 1;
+  }
+  srand (1);
+  for (Index = 0; Index < Size; Index++) {
+    Buffer[Index] = (UINT8) rand ();
+  }
+
+  Result = 0;
+  printf ("engine,size,iterations,crc,MB/s\n");
+  for (Engine = Crc32EngineTable; Engine < Crc32EngineMax; Engine++) {
+    if (Crc32SetEngine (Engine) != EFI_SUCCESS) {
+      printf ("%s,unsupported\n", mEngineName[Engine]);
+      continue;
+    }
+    if (!CheckEngine (Engine, Buffer)) {
+      Result = 1;
+      continue;
+    }
+
+    Crc   = 0;
+    Start = clock ();
+    for (Iteration = 0; Iteration < Iterations; Iteration++) {
+      Crc = EngineCrc (Engine, Buffer, Size, Size);
+    }
+    Seconds = (double) (clock () - Start) / CLOCKS_PER_SEC;
+    printf (
+      "%s,%u,%u,%08x,%.1f\n",
+      mEngineName[Engine],
+      (unsigned) Size,
+      (unsigned) Iterations,
+      (unsigned) Crc,
+      Seconds > 0 ? (double) Size * Iterations / Seconds / (1024 * 1024) : 0.0
+      );
+  }
+
+  free (Buffer);
+  return Result;
+}
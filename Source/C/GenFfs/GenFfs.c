@@ -31,6 +31,7 @@ Abstract:
 #include "CommonLib.h"
 #include "ParseInf.h"
 #include "EfiUtilityMsgs.h"
+#include "FfsLib.h"
 
 #define UTILITY_NAME            "GenFfs"
 #define UTILITY_MAJOR_VERSION   0
@@ -235,203 +236,125 @@ Returns:
   return EFI_FV_FILETYPE_ALL;
 }
 
+STATIC
+VOID
+FreeInputFiles (
+  IN FFS_SECTION_INPUT  *Inputs,
+  IN UINT32             InputFileNum
+  )
+/*++
+
+Routine Description:
+
+  Free the contents read by ReadInputFiles.
+
+Arguments:
+
+  Inputs         - The input files, may be NULL
+  InputFileNum   - Number of input files
+
+Returns:
+
+  None
+
+--*/
+{
+  UINT32  Index;
+
+  if (Inputs == NULL) {
+    return;
+  }
+  for (Index = 0; Index < InputFileNum; Index++) {
+    if (Inputs[Index].Data != NULL) {
+      free (Inputs[Index].Data);
+    }
+  }
+  free (Inputs);
+}
+
 STATIC
 EFI_STATUS
-GetSectionContents (
-  IN  CHAR8   **InputFileName,
-  IN  UINT32  *InputFileAlign,
-  IN  UINT32  InputFileNum,
-  OUT UINT8   *FileBuffer,
-  OUT UINT32  *BufferLength,
-  OUT UINT32  *MaxAlignment,
-  OUT UINT8   *PESectionNum
+ReadInputFiles (
+  IN  CHAR8              **InputFileName,
+  IN  UINT32             *InputFileAlign,
+  IN  UINT32             InputFileNum,
+  OUT FFS_SECTION_INPUT  **Inputs
   )
 /*++
-        
+
 Routine Description:
-           
-  Get the contents of all section files specified in InputFileName
-  into FileBuffer.
-            
+
+  Read the contents of all input files into memory.
+
 Arguments:
-               
-  InputFileName  - Name of the input file.
-                
-  InputFileAlign - Alignment required by the input file data.
 
-  InputFileNum   - Number of input files. Should be at least 1.
+  InputFileName  - Name of the input section file.
 
-  FileBuffer     - Output buffer to contain data
+  InputFileAlign - Alignment required by the input file data.
 
-  BufferLength   - On input, this is size of the FileBuffer. 
-                   On output, this is the actual length of the data.
+  InputFileNum   - Number of input files. Should be at least 1.
 
-  MaxAlignment   - The max alignment required by all the input file datas.
-  
-  PeSectionNum   - Calculate the number of Pe/Te Section in this FFS file.
+  Inputs         - Receives the contents and alignment of each input file,
+                   released with FreeInputFiles.
 
 Returns:
-                       
+
   EFI_SUCCESS on successful return
-  EFI_INVALID_PARAMETER if InputFileNum is less than 1 or BufferLength point is NULL.
-  EFI_ABORTED if unable to open input file.
-  EFI_BUFFER_TOO_SMALL FileBuffer is not enough to contain all file data.
+  EFI_INVALID_PARAMETER if InputFileNum is less than 1.
+  EFI_ABORTED if unable to read an input file.
+  EFI_OUT_OF_RESOURCES  No resource to complete the operation.
+
 --*/
 {
-  UINT32                     Size;
-  UINT32                     Offset;
-  UINT32                     FileSize;
-  UINT32                     Index;
-  FILE                       *InFile;
-  EFI_COMMON_SECTION_HEADER  *SectHeader;
-  EFI_COMMON_SECTION_HEADER2 TempSectHeader;
-  EFI_TE_IMAGE_HEADER        TeHeader;
-  UINT32                     TeOffset;
-  EFI_GUID_DEFINED_SECTION   GuidSectHeader;
-  EFI_GUID_DEFINED_SECTION2  GuidSectHeader2;
-  UINT32                     HeaderSize;
-
-  Size          = 0;
-  Offset        = 0;
-  TeOffset      = 0;
+  FFS_SECTION_INPUT  *Input;
+  FILE               *InFile;
+  UINT32             Index;
+
+  if (InputFileNum < 1) {
+    Error (NULL, 0, 2000, "Invalid paramter", "must specify at least one input file");
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Inputs = (FFS_SECTION_INPUT *) calloc (InputFileNum, sizeof (FFS_SECTION_INPUT));
+  if (*Inputs == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    return EFI_OUT_OF_RESOURCES;
+  }
 
-  //
-  // Go through our array of file names and copy their contents
-  // to the output buffer.
-  //
   for (Index = 0; Index < InputFileNum; Index++) {
-    //
-    // make sure section ends on a DWORD boundary
-    //
-    while ((Size & 0x03) != 0) {
-      Size++;
-    }
-    
-    //
-    // Get the Max alignment of all input file datas
-    //
-    if (*MaxAlignment < InputFileAlign [Index]) {
-      *MaxAlignment = InputFileAlign [Index];
-    }
+    Input = &(*Inputs)[Index];
+    Input->Alignment = InputFileAlign[Index];
 
-    // 
-    // Open file and read contents
-    //
     InFile = fopen (InputFileName[Index], "rb");
     if (InFile == NULL) {
       Error (NULL, 0, 0001, "Error opening file", InputFileName[Index]);
+      FreeInputFiles (*Inputs, InputFileNum);
       return EFI_ABORTED;
     }
 
     fseek (InFile, 0, SEEK_END);
-    FileSize = ftell (InFile);
-    fseek (InFile, 0, SEEK_SET);
-    DebugMsg (NULL, 0, 9, "Input section files", 
-              "the input section name is %s and the size is %u bytes", InputFileName[Index], (unsigned) FileSize); 
-
-    //
-    // Check this section is Te/Pe section, and Calculate the numbers of Te/Pe section.
-    //
-    TeOffset = 0;
-    if (FileSize >= MAX_FFS_SIZE) {
-      HeaderSize = sizeof (EFI_COMMON_SECTION_HEADER2);
-    } else {
-      HeaderSize = sizeof (EFI_COMMON_SECTION_HEADER);
-    }
-    fread (&TempSectHeader, 1, HeaderSize, InFile);
-    if (TempSectHeader.Type == EFI_SECTION_TE) {
-      (*PESectionNum) ++;
-      fread (&TeHeader, 1, sizeof (TeHeader), InFile);
-      if (TeHeader.Signature == EFI_TE_IMAGE_HEADER_SIGNATURE) {
-        TeOffset = TeHeader.StrippedSize - sizeof (TeHeader);
-      }
-    } else if (TempSectHeader.Type == EFI_SECTION_PE32) {
-      (*PESectionNum) ++;
-    } else if (TempSectHeader.Type == EFI_SECTION_GUID_DEFINED) {
-      fseek (InFile, 0, SEEK_SET);
-      if (FileSize >= MAX_SECTION_SIZE) {
-        fread (&GuidSectHeader2, 1, sizeof (GuidSectHeader2), InFile);
-        if ((GuidSectHeader2.Attributes & EFI_GUIDED_SECTION_PROCESSING_REQUIRED) == 0) {
-          HeaderSize = GuidSectHeader2.DataOffset;
-        }
-      } else {
-        fread (&GuidSectHeader, 1, sizeof (GuidSectHeader), InFile);
-        if ((GuidSectHeader.Attributes & EFI_GUIDED_SECTION_PROCESSING_REQUIRED) == 0) {
-          HeaderSize = GuidSectHeader.DataOffset;
-        }
-      }
-      (*PESectionNum) ++;
-    } else if (TempSectHeader.Type == EFI_SECTION_COMPRESSION || 
-               TempSectHeader.Type == EFI_SECTION_FIRMWARE_VOLUME_IMAGE) {
-      //
-      // for the encapsulated section, assume it contains Pe/Te section 
-      //
-      (*PESectionNum) ++;
-    }
-
+    Input->Size = ftell (InFile);
     fseek (InFile, 0, SEEK_SET);
+    DebugMsg (NULL, 0, 9, "Input section files",
+              "the input section name is %s and the size is %u bytes", InputFileName[Index], (unsigned) Input->Size);
 
-    //
-    // Revert TeOffset to the converse value relative to Alignment
-    // This is to assure the original PeImage Header at Alignment.
-    //
-    if ((TeOffset != 0) && (InputFileAlign [Index] != 0)) {
-      TeOffset = InputFileAlign [Index] - (TeOffset % InputFileAlign [Index]);
-      TeOffset = TeOffset % InputFileAlign [Index];
-    }
-
-    //
-    // make sure section data meet its alignment requirement by adding one raw pad section.
-    // But the different sections have the different section header. Necessary or not?
-    // Based on section type to adjust offset? Todo
-    //
-    if ((InputFileAlign [Index] != 0) && (((Size + HeaderSize + TeOffset) % InputFileAlign [Index]) != 0)) {
-      Offset = (Size + sizeof (EFI_COMMON_SECTION_HEADER) + HeaderSize + TeOffset + InputFileAlign [Index] - 1) & ~(InputFileAlign [Index] - 1);
-      Offset = Offset - Size - HeaderSize - TeOffset;
-       
-      if (FileBuffer != NULL && ((Size + Offset) < *BufferLength)) {
-        //
-        // The maximal alignment is 64K, the raw section size must be less than 0xffffff
-        //
-        memset (FileBuffer + Size, 0, Offset);
-        SectHeader          = (EFI_COMMON_SECTION_HEADER *) (FileBuffer + Size);
-        SectHeader->Type    = EFI_SECTION_RAW;
-        SectHeader->Size[0] = (UINT8) (Offset & 0xff);
-        SectHeader->Size[1] = (UINT8) ((Offset & 0xff00) >> 8);
-        SectHeader->Size[2] = (UINT8) ((Offset & 0xff0000) >> 16);
-      }
-      DebugMsg (NULL, 0, 9, "Pad raw section for section data alignment", 
-                "Pad Raw section size is %u", (unsigned) Offset);
-
-      Size = Size + Offset;
+    Input->Data = (UINT8 *) malloc ((size_t) Input->Size + 1);
+    if (Input->Data == NULL) {
+      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+      fclose (InFile);
+      FreeInputFiles (*Inputs, InputFileNum);
+      return EFI_OUT_OF_RESOURCES;
     }
-
-    //
-    // Now read the contents of the file into the buffer
-    // Buffer must be enough to contain the file content.
-    //
-    if ((FileSize > 0) && (FileBuffer != NULL) && ((Size + FileSize) <= *BufferLength)) {
-      if (fread (FileBuffer + Size, (size_t) FileSize, 1, InFile) != 1) {
-        Error (NULL, 0, 0004, "Error reading file", InputFileName[Index]);
-        fclose (InFile);
-        return EFI_ABORTED;
-      }
+    if (Input->Size != 0 && fread (Input->Data, (size_t) Input->Size, 1, InFile) != 1) {
+      Error (NULL, 0, 0004, "Error reading file", InputFileName[Index]);
+      fclose (InFile);
+      FreeInputFiles (*Inputs, InputFileNum);
+      return EFI_ABORTED;
     }
-
     fclose (InFile);
-    Size += FileSize;
-  }
-  
-  //
-  // Set the actual length of the data.
-  //
-  if (Size > *BufferLength) {
-    *BufferLength = Size;
-    return EFI_BUFFER_TOO_SMALL;
-  } else {
-    *BufferLength = Size;
-    return EFI_SUCCESS;
   }
+
+  return EFI_SUCCESS;
 }
 
 int
@@ -467,13 +390,10 @@ Returns:
   CHAR8                   **InputFileName;
   UINT8                   *FileBuffer;
   UINT32                  FileSize;
-  UINT32                  MaxAlignment;
-  EFI_FFS_FILE_HEADER2    FfsFileHeader;
+  FFS_SECTION_INPUT       *Inputs;
   FILE                    *FfsFile;
   UINT32                  Index;
   UINT64                  LogLevel;
-  UINT8                   PeSectionNum;
-  UINT32                  HeaderSize;
   
   //
   // Init local variables
@@ -489,10 +409,8 @@ Returns:
   InputFileAlign = NULL;
   FileBuffer     = NULL;
   FileSize       = 0;
-  MaxAlignment   = 1;
   FfsFile        = NULL;
   Status         = EFI_SUCCESS;
-  PeSectionNum   = 0;
 
   SetUtilityName (UTILITY_NAME);
 
@@ -776,125 +694,28 @@ Returns:
   }
   
   //
-  // Calculate the size of all input section files.
-  //  
-  Status = GetSectionContents (
-             InputFileName,
-             InputFileAlign,
-             InputFileNum,
-             FileBuffer,
-             &FileSize,
-             &MaxAlignment,
-             &PeSectionNum
-             );
-  
-  if ((FfsFiletype == EFI_FV_FILETYPE_SECURITY_CORE || 
-      FfsFiletype == EFI_FV_FILETYPE_PEI_CORE ||
-      FfsFiletype == EFI_FV_FILETYPE_DXE_CORE) && (PeSectionNum != 1)) {
-    Error (NULL, 0, 2000, "Invalid parameter", "Fv File type %s must have one and only one Pe or Te section, but %u Pe/Te section are input", mFfsFileType [FfsFiletype], PeSectionNum);
+  // Read all input section files into memory.
+  //
+  Status = ReadInputFiles (InputFileName, InputFileAlign, InputFileNum, &Inputs);
+  if (EFI_ERROR (Status)) {
     goto Finish;
   }
-  
-  if ((FfsFiletype == EFI_FV_FILETYPE_PEIM ||
-      FfsFiletype == EFI_FV_FILETYPE_DRIVER ||
-      FfsFiletype == EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER ||
-      FfsFiletype == EFI_FV_FILETYPE_APPLICATION) && (PeSectionNum < 1)) {
-    Error (NULL, 0, 2000, "Invalid parameter", "Fv File type %s must have at least one Pe or Te section, but no Pe/Te section is input", mFfsFileType [FfsFiletype]);
-    goto Finish;   
-  }
-
-  if (Status == EFI_BUFFER_TOO_SMALL) {
-    FileBuffer = (UINT8 *) malloc (FileSize);
-    if (FileBuffer == NULL) {
-      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
-      goto Finish;
-    }
-    memset (FileBuffer, 0, FileSize);
-    
-    //
-    // read all input file contents into a buffer
-    //
-    Status = GetSectionContents (
-               InputFileName,
-               InputFileAlign,
-               InputFileNum,
-               FileBuffer,
-               &FileSize,
-               &MaxAlignment,
-               &PeSectionNum
-               );
-  }
 
+  Status = FfsGenFile (
+             FfsFiletype,
+             &FileGuid,
+             FfsAttrib,
+             mFfsValidAlign[FfsAlign + 1],
+             Inputs,
+             InputFileNum,
+             &FileBuffer,
+             &FileSize
+             );
+  FreeInputFiles (Inputs, InputFileNum);
   if (EFI_ERROR (Status)) {
     goto Finish;
   }
-  
-  //
-  // Create Ffs file header.
-  //
-  memset (&FfsFileHeader, 0, sizeof (EFI_FFS_FILE_HEADER2));
-  memcpy (&FfsFileHeader.Name, &FileGuid, sizeof (EFI_GUID));
-  FfsFileHeader.Type       = FfsFiletype;
-  //
-  // Update FFS Alignment based on the max alignment required by input section files 
-  //
-  VerboseMsg ("the max alignment of all input sections is %u", (unsigned) MaxAlignment); 
-  for (Index = 0; Index < sizeof (mFfsValidAlign) / sizeof (UINT32) - 1; Index ++) {
-    if ((MaxAlignment > mFfsValidAlign [Index]) && (MaxAlignment <= mFfsValidAlign [Index + 1])) {
-      break;
-    }
-  }
-  if (FfsAlign < Index) {
-    FfsAlign = Index;
-  }
-  VerboseMsg ("the alignment of the generated FFS file is %u", (unsigned) mFfsValidAlign [FfsAlign + 1]);  
-  
-  //
-  // Now FileSize includes the EFI_FFS_FILE_HEADER
-  //
-  if (FileSize + sizeof (EFI_FFS_FILE_HEADER) >= MAX_FFS_SIZE) {
-    HeaderSize = sizeof (EFI_FFS_FILE_HEADER2);
-    FileSize += sizeof (EFI_FFS_FILE_HEADER2);
-    FfsFileHeader.ExtendedSize = FileSize;
-    memset(FfsFileHeader.Size, 0, sizeof (UINT8) * 3);
-    FfsAttrib |= FFS_ATTRIB_LARGE_FILE;
-  } else {
-    HeaderSize = sizeof (EFI_FFS_FILE_HEADER);
-    FileSize += sizeof (EFI_FFS_FILE_HEADER);
-    FfsFileHeader.Size[0]  = (UINT8) (FileSize & 0xFF);
-    FfsFileHeader.Size[1]  = (UINT8) ((FileSize & 0xFF00) >> 8);
-    FfsFileHeader.Size[2]  = (UINT8) ((FileSize & 0xFF0000) >> 16);
-  }
-  VerboseMsg ("the size of the generated FFS file is %u bytes", (unsigned) FileSize);
 
-  FfsFileHeader.Attributes = (EFI_FFS_FILE_ATTRIBUTES) (FfsAttrib | (FfsAlign << 3));
-
-  //
-  // Fill in checksums and state, these must be zero for checksumming
-  //
-  // FileHeader.IntegrityCheck.Checksum.Header = 0;
-  // FileHeader.IntegrityCheck.Checksum.File = 0;
-  // FileHeader.State = 0;
-  //
-  FfsFileHeader.IntegrityCheck.Checksum.Header = CalculateChecksum8 (
-                                                   (UINT8 *) &FfsFileHeader,
-                                                   HeaderSize
-                                                   );
-
-  if (FfsFileHeader.Attributes & FFS_ATTRIB_CHECKSUM) {
-    //
-    // Ffs header checksum = zero, so only need to calculate ffs body.
-    //
-    FfsFileHeader.IntegrityCheck.Checksum.File = CalculateChecksum8 (
-                                                   FileBuffer, 
-                                                   FileSize - HeaderSize
-                                                   );    
-  } else {
-    FfsFileHeader.IntegrityCheck.Checksum.File = FFS_FIXED_CHECKSUM;
-  }
-
-  FfsFileHeader.State = EFI_FILE_HEADER_CONSTRUCTION | EFI_FILE_HEADER_VALID | EFI_FILE_DATA_VALID;
-  
   //
   // Open output file to write ffs data.
   //
@@ -904,14 +725,7 @@ Returns:
     Error (NULL, 0, 0001, "Error opening file", OutputFileName);
     goto Finish;
   }
-  //
-  // write header
-  //
-  fwrite (&FfsFileHeader, 1, HeaderSize, FfsFile);
-  //
-  // write data
-  //
-  fwrite (FileBuffer, 1, FileSize - HeaderSize, FfsFile);
+  fwrite (FileBuffer, 1, FileSize, FfsFile);
 
   fclose (FfsFile);
 
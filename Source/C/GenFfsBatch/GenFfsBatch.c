@@ -0,0 +1,1491 @@
+/** @file
+
+Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+Module Name:
+
+  GenFfsBatch.c
+
+Abstract:
+
+  Run a manifest of GenSec and GenFfs command lines in one process. Section
+  files produced by an earlier line are passed to later lines in memory, and
+  independent lines run on several threads.
+
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <Common/UefiBaseTypes.h>
+#include <Common/PiFirmwareFile.h>
+
+#include "CommonLib.h"
+#include "Compress.h"
+#include "CompressCache.h"
+#include "Crc32.h"
+#include "EfiUtilityMsgs.h"
+#include "FfsLib.h"
+#include "MemoryFile.h"
+#include "ParseInf.h"
+#include "WorkerPool.h"
+
+#define UTILITY_NAME            "GenFfsBatch"
+#define UTILITY_MAJOR_VERSION   0
+#define UTILITY_MINOR_VERSION   1
+
+#define BATCH_NO_PRODUCER       ((UINTN) -1)
+#define EFI_GUIDED_SECTION_NONE 0x80
+
+STATIC CHAR8 *mAlignName[] = {
+  "1", "2", "4", "8", "16", "32", "64", "128", "256", "512",
+  "1K", "2K", "4K", "8K", "16K", "32K", "64K"
+};
+
+STATIC CHAR8 *mFfsValidAlignName[] = {
+  "8", "16", "128", "512", "1K", "4K", "32K", "64K"
+};
+
+STATIC UINT32 mFfsValidAlign[] = {8, 16, 128, 512, 1024, 4096, 32768, 65536};
+
+STATIC EFI_GUID mZeroGuid = {0};
+
+//
+// One GenSec or GenFfs line of the manifest. Producer[Index] is the earlier
+// command whose output is InputFileName[Index], or BATCH_NO_PRODUCER when
+// the input is read from disk.
+//
+typedef struct {
+  UINT32                  Line;
+  BOOLEAN                 IsFfs;
+  CHAR8                   *OutputFileName;
+  UINT32                  InputNum;
+  CHAR8                   **InputFileName;
+  UINT32                  *InputFileAlign;
+  UINTN                   *Producer;
+  //
+  // GenSec options
+  //
+  UINT8                   SectionType;
+  UINT8                   CompressionType;
+  UINT32                  CompressLevel;
+  UINT16                  GuidAttributes;
+  UINT32                  GuidHeaderLength;
+  CHAR8                   *Name;
+  UINT16                  BuildNumber;
+  //
+  // GenFfs options
+  //
+  EFI_FV_FILETYPE         FileType;
+  EFI_FFS_FILE_ATTRIBUTES Attributes;
+  UINT32                  Alignment;
+  //
+  // Vendor GUID of a section, or name of an FFS file
+  //
+  EFI_GUID                Guid;
+  //
+  // Schedule and result
+  //
+  UINTN                   Stage;
+  UINTN                   Consumers;
+  UINT8                   *Output;
+  UINT32                  OutputSize;
+  EFI_STATUS              Status;
+} BATCH_COMMAND;
+
+//
+// A file name used by the manifest, with the last command writing it and
+// the last stage that reads or writes it.
+//
+typedef struct _BATCH_PATH BATCH_PATH;
+struct _BATCH_PATH {
+  BATCH_PATH              *Next;
+  CHAR8                   *Name;
+  UINTN                   Writer;
+  UINTN                   LastStage;
+  BOOLEAN                 Used;
+};
+
+typedef struct {
+  BATCH_COMMAND           *Commands;
+  UINTN                   *Jobs;
+} BATCH_CONTEXT;
+
+STATIC
+VOID
+Version (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Print out version information for this utility.
+
+Arguments:
+
+  None
+
+Returns:
+
+  None
+
+--*/
+{
+  fprintf (stdout, "%s Version %d.%d %s \n", UTILITY_NAME, UTILITY_MAJOR_VERSION, UTILITY_MINOR_VERSION, __BUILD_VERSION);
+}
+
+STATIC
+VOID
+Usage (
+  VOID
+  )
+/*++
+
+Routine Description:
+
+  Print Error / Help message.
+
+Arguments:
+
+  VOID
+
+Returns:
+
+  None
+
+--*/
+{
+  //
+  // Summary usage
+  //
+  fprintf (stdout, "\nUsage: %s [options] ManifestFile\n\n", UTILITY_NAME);
+
+  //
+  // Copyright declaration
+  //
+  fprintf (stdout, "Copyright (c) 2026, Intel Corporation. All rights reserved.\n\n");
+
+  //
+  // Details Option
+  //
+  fprintf (stdout, "ManifestFile holds one GenSec or GenFfs command line per line, with\n\
+the same options as the tools. Blank lines and lines starting with #\n\
+are ignored, and arguments containing spaces are put in double quotes.\n\
+An input that is the output of an earlier line is passed in memory;\n\
+other inputs are read from disk. All outputs are written to disk.\n\n");
+  fprintf (stdout, "Options:\n");
+  fprintf (stdout, "  -j Threads, --threads Threads\n\
+                        Threads is the number of threads used to run\n\
+                        independent lines. The default, 0, uses one thread\n\
+                        per processor.\n");
+  fprintf (stdout, "  -v, --verbose         Turn on verbose output with informational messages.\n");
+  fprintf (stdout, "  -q, --quiet           Disable all messages except key message and fatal error\n");
+  fprintf (stdout, "  -d, --debug level     Enable debug messages, at input debug level.\n");
+  fprintf (stdout, "  --version             Show program's version number and exit.\n");
+  fprintf (stdout, "  -h, --help            Show this help message and exit.\n");
+}
+
+STATIC
+EFI_STATUS
+StringtoAlignment (
+  IN  CHAR8  *AlignBuffer,
+  OUT UINT32 *AlignNumber
+  )
+/*++
+
+Routine Description:
+
+  Converts Align String to align value (1~64K).
+
+Arguments:
+
+  AlignBuffer    - Pointer to Align string.
+  AlignNumber    - Pointer to Align value.
+
+Returns:
+
+  EFI_SUCCESS             Successfully convert align string to align value.
+  EFI_INVALID_PARAMETER   Align string is invalid or align value is not in scope.
+
+--*/
+{
+  UINT32 Index;
+
+  if (AlignBuffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  for (Index = 0; Index < sizeof (mAlignName) / sizeof (CHAR8 *); Index ++) {
+    if (stricmp (AlignBuffer, mAlignName [Index]) == 0) {
+      *AlignNumber = 1 << Index;
+      return EFI_SUCCESS;
+    }
+  }
+  return EFI_INVALID_PARAMETER;
+}
+
+STATIC
+UINT32
+SplitCommandLine (
+  IN OUT CHAR8  *Line,
+  OUT    CHAR8  **Argv,
+  IN     UINT32 MaxArgc
+  )
+/*++
+
+Routine Description:
+
+  Split a manifest line into arguments in place. Arguments are separated
+  by white space, and double quotes group an argument containing spaces.
+
+Arguments:
+
+  Line        - The line, which is modified
+  Argv        - Receives the arguments, followed by a NULL entry
+  MaxArgc     - Size of Argv, including the NULL entry
+
+Returns:
+
+  The number of arguments, or MaxArgc if there are too many.
+
+--*/
+{
+  UINT32  Argc;
+  CHAR8   *Src;
+  CHAR8   *Dst;
+  BOOLEAN Quoted;
+
+  Argc = 0;
+  Src  = Line;
+  for (;;) {
+    while (*Src != '\0' && isspace ((int) *Src)) {
+      Src++;
+    }
+    if (*Src == '\0') {
+      break;
+    }
+    if (Argc + 1 >= MaxArgc) {
+      return MaxArgc;
+    }
+
+    Argv[Argc++] = Src;
+    Dst    = Src;
+    Quoted = FALSE;
+    while (*Src != '\0' && (Quoted || !isspace ((int) *Src))) {
+      if (*Src == '"') {
+        Quoted = (BOOLEAN) !Quoted;
+      } else {
+        *Dst++ = *Src;
+      }
+      Src++;
+    }
+    if (*Src != '\0') {
+      Src++;
+    }
+    *Dst = '\0';
+  }
+
+  Argv[Argc] = NULL;
+  return Argc;
+}
+
+STATIC
+EFI_STATUS
+AddCommandInput (
+  IN OUT BATCH_COMMAND  *Command,
+  IN     CHAR8          *FileName
+  )
+/*++
+
+Routine Description:
+
+  Append an input file to a command.
+
+Arguments:
+
+  Command     - The command
+  FileName    - Name of the input file
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_OUT_OF_RESOURCES
+
+--*/
+{
+  CHAR8   **NewName;
+  UINT32  *NewAlign;
+
+  if (Command->InputNum % MAXIMUM_INPUT_FILE_NUM == 0) {
+    NewName = (CHAR8 **) realloc (Command->InputFileName, (Command->InputNum + MAXIMUM_INPUT_FILE_NUM) * sizeof (CHAR8 *));
+    if (NewName == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Command->InputFileName = NewName;
+    NewAlign = (UINT32 *) realloc (Command->InputFileAlign, (Command->InputNum + MAXIMUM_INPUT_FILE_NUM) * sizeof (UINT32));
+    if (NewAlign == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Command->InputFileAlign = NewAlign;
+  }
+
+  Command->InputFileName[Command->InputNum]  = FileName;
+  Command->InputFileAlign[Command->InputNum] = 0;
+  Command->InputNum++;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+ParseGenSecCommand (
+  IN     CHAR8          *ManifestFileName,
+  IN     UINT32         Argc,
+  IN     CHAR8          **Argv,
+  IN OUT BATCH_COMMAND  *Command
+  )
+/*++
+
+Routine Description:
+
+  Parse the arguments of a GenSec line, as GenSec parses its command line.
+
+Arguments:
+
+  ManifestFileName  - Name of the manifest, for error messages
+  Argc              - Number of arguments, not counting the tool name
+  Argv              - The arguments, followed by a NULL entry
+  Command           - The command, with Line set
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_INVALID_PARAMETER   The line is not valid; an error was reported.
+  EFI_OUT_OF_RESOURCES
+
+--*/
+{
+  CHAR8       *SectionName;
+  CHAR8       *CompressionName;
+  UINT32      *Align;
+  UINT32      *NewAlign;
+  UINT32      AlignNum;
+  UINT32      Index;
+  UINT64      Value;
+  int         VersionNumber;
+  EFI_STATUS  Status;
+
+  SectionName               = NULL;
+  CompressionName           = NULL;
+  Align                     = NULL;
+  AlignNum                  = 0;
+  VersionNumber             = 0;
+  Command->Name             = "";
+  Command->CompressLevel    = COMPRESS_LEVEL_DEFAULT;
+  Command->GuidAttributes   = EFI_GUIDED_SECTION_NONE;
+
+  while (Argc > 0) {
+    if ((stricmp (Argv[0], "-s") == 0) || (stricmp (Argv[0], "--SectionType") == 0) ||
+        (stricmp (Argv[0], "-o") == 0) || (stricmp (Argv[0], "--outputfile") == 0) ||
+        (stricmp (Argv[0], "-c") == 0) || (stricmp (Argv[0], "--compress") == 0) ||
+        (stricmp (Argv[0], "-n") == 0) || (stricmp (Argv[0], "--name") == 0) ||
+        (stricmp (Argv[0], "-g") == 0) || (stricmp (Argv[0], "--vendor") == 0) ||
+        (stricmp (Argv[0], "-r") == 0) || (stricmp (Argv[0], "--attributes") == 0) ||
+        (stricmp (Argv[0], "-l") == 0) || (stricmp (Argv[0], "--HeaderLength") == 0) ||
+        (stricmp (Argv[0], "-j") == 0) || (stricmp (Argv[0], "--buildnumber") == 0) ||
+        (stricmp (Argv[0], "-d") == 0) || (stricmp (Argv[0], "--debug") == 0) ||
+        (stricmp (Argv[0], "--level") == 0) || (stricmp (Argv[0], "--sectionalign") == 0)) {
+      if (Argv[1] == NULL) {
+        Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%s value is missing", Argv[0]);
+        Status = EFI_INVALID_PARAMETER;
+        goto Done;
+      }
+    }
+
+    if ((stricmp (Argv[0], "-s") == 0) || (stricmp (Argv[0], "--SectionType") == 0)) {
+      SectionName = Argv[1];
+    } else if ((stricmp (Argv[0], "-o") == 0) || (stricmp (Argv[0], "--outputfile") == 0)) {
+      Command->OutputFileName = Argv[1];
+    } else if ((stricmp (Argv[0], "-c") == 0) || (stricmp (Argv[0], "--compress") == 0)) {
+      CompressionName = Argv[1];
+    } else if ((stricmp (Argv[0], "-n") == 0) || (stricmp (Argv[0], "--name") == 0)) {
+      Command->Name = Argv[1];
+    } else if (stricmp (Argv[0], "--level") == 0) {
+      Status = AsciiStringToUint64 (Argv[1], FALSE, &Value);
+      if (EFI_ERROR (Status) || Value < COMPRESS_LEVEL_MIN || Value > COMPRESS_LEVEL_MAX) {
+        Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%s = %s", Argv[0], Argv[1]);
+        Status = EFI_INVALID_PARAMETER;
+        goto Done;
+      }
+      Command->CompressLevel = (UINT32) Value;
+    } else if ((stricmp (Argv[0], "-g") == 0) || (stricmp (Argv[0], "--vendor") == 0)) {
+      Status = StringToGuid (Argv[1], &Command->Guid);
+      if (EFI_ERROR (Status)) {
+        Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%s = %s", Argv[0], Argv[1]);
+        Status = EFI_INVALID_PARAMETER;
+        goto Done;
+      }
+    } else if ((stricmp (Argv[0], "-r") == 0) || (stricmp (Argv[0], "--attributes") == 0)) {
+      if (stricmp (Argv[1], "PROCESSING_REQUIRED") == 0) {
+        Command->GuidAttributes |= EFI_GUIDED_SECTION_PROCESSING_REQUIRED;
+      } else if (stricmp (Argv[1], "AUTH_STATUS_VALID") == 0) {
+        Command->GuidAttributes |= EFI_GUIDED_SECTION_AUTH_STATUS_VALID;
+      } else if (stricmp (Argv[1], "NONE") == 0) {
+        Command->GuidAttributes |= EFI_GUIDED_SECTION_NONE;
+      } else {
+        Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%s = %s", Argv[0], Argv[1]);
+        Status = EFI_INVALID_PARAMETER;
+        goto Done;
+      }
+    } else if ((stricmp (Argv[0], "-l") == 0) || (stricmp (Argv[0], "--HeaderLength") == 0)) {
+      Status = AsciiStringToUint64 (Argv[1], FALSE, &Value);
+      if (EFI_ERROR (Status)) {
+        Error (ManifestFileName, Command->Line, 1003, "Invalid option value for GuidHeaderLength", "%s = %s", Argv[0], Argv[1]);
+        Status = EFI_INVALID_PARAMETER;
+        goto Done;
+      }
+      Command->GuidHeaderLength = (UINT32) Value;
+    } else if ((stricmp (Argv[0], "-j") == 0) || (stricmp (Argv[0], "--buildnumber") == 0)) {
+      for (Index = 0; Index < strlen (Argv[1]); Index++) {
+        if ((Argv[1][Index] != '-') && (isdigit ((int)Argv[1][Index]) == 0)) {
+          Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%s = %s", Argv[0], Argv[1]);
+          Status = EFI_INVALID_PARAMETER;
+          goto Done;
+        }
+      }
+      sscanf (Argv[1], "%d", &VersionNumber);
+    } else if (stricmp (Argv[0], "--sectionalign") == 0) {
+      //
+      // The alignments apply to the input files in order.
+      //
+      if (AlignNum % MAXIMUM_INPUT_FILE_NUM == 0) {
+        NewAlign = (UINT32 *) realloc (Align, (AlignNum + MAXIMUM_INPUT_FILE_NUM) * sizeof (UINT32));
+        if (NewAlign == NULL) {
+          Status = EFI_OUT_OF_RESOURCES;
+          goto Done;
+        }
+        Align = NewAlign;
+      }
+      Status = StringtoAlignment (Argv[1], &Align[AlignNum]);
+      if (EFI_ERROR (Status)) {
+        Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%s = %s", Argv[0], Argv[1]);
+        Status = EFI_INVALID_PARAMETER;
+        goto Done;
+      }
+      AlignNum++;
+    } else if ((stricmp (Argv[0], "-d") == 0) || (stricmp (Argv[0], "--debug") == 0)) {
+      //
+      // Message levels are set for the whole batch.
+      //
+    } else if ((stricmp (Argv[0], "-v") == 0) || (stricmp (Argv[0], "--verbose") == 0) ||
+               (stricmp (Argv[0], "-q") == 0) || (stricmp (Argv[0], "--quiet") == 0)) {
+      Argc --;
+      Argv ++;
+      continue;
+    } else {
+      Status = AddCommandInput (Command, Argv[0]);
+      if (EFI_ERROR (Status)) {
+        goto Done;
+      }
+      Argc --;
+      Argv ++;
+      continue;
+    }
+    Argc -= 2;
+    Argv += 2;
+  }
+
+  Status = EFI_SUCCESS;
+  if (AlignNum > 0) {
+    if (AlignNum != Command->InputNum) {
+      Error (ManifestFileName, Command->Line, 1003, "Invalid option", "section alignment must be set for each section");
+      Status = EFI_INVALID_PARAMETER;
+    } else {
+      memcpy (Command->InputFileAlign, Align, AlignNum * sizeof (UINT32));
+    }
+  }
+
+Done:
+  if (Align != NULL) {
+    free (Align);
+  }
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Command->SectionType = FfsSectionTypeFromString (SectionName);
+  if (SectionName != NULL && Command->SectionType == EFI_SECTION_ALL) {
+    Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "SectionType = %s", SectionName);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  switch (Command->SectionType) {
+  case EFI_SECTION_COMPRESSION:
+    if (CompressionName == NULL || stricmp (CompressionName, "PI_STD") == 0) {
+      Command->CompressionType = EFI_STANDARD_COMPRESSION;
+    } else if (stricmp (CompressionName, "PI_NONE") == 0) {
+      Command->CompressionType = EFI_NOT_COMPRESSED;
+    } else {
+      Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "--compress = %s", CompressionName);
+      return EFI_INVALID_PARAMETER;
+    }
+    //
+    // The inputs of a compression section are not aligned.
+    //
+    memset (Command->InputFileAlign, 0, Command->InputNum * sizeof (UINT32));
+    break;
+
+  case EFI_SECTION_GUID_DEFINED:
+    Command->GuidAttributes &= ~EFI_GUIDED_SECTION_NONE;
+    if (CompareGuid (&Command->Guid, &mZeroGuid) != 0) {
+      //
+      // Only process alignment for the default known CRC32 guided section.
+      //
+      memset (Command->InputFileAlign, 0, Command->InputNum * sizeof (UINT32));
+    }
+    break;
+
+  case EFI_SECTION_VERSION:
+    if (VersionNumber < 0 || VersionNumber > 65535) {
+      Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%d is not in 0~65535", VersionNumber);
+      return EFI_INVALID_PARAMETER;
+    }
+    Command->BuildNumber = (UINT16) VersionNumber;
+    break;
+
+  case EFI_SECTION_USER_INTERFACE:
+    if (Command->Name[0] == '\0') {
+      Error (ManifestFileName, Command->Line, 1001, "Missing option", "user interface string");
+      return EFI_INVALID_PARAMETER;
+    }
+    break;
+
+  case EFI_SECTION_ALL:
+    break;
+
+  default:
+    if (Command->InputNum > 1) {
+      Error (ManifestFileName, Command->Line, 2000, "Invalid paramter", "more than one input file specified");
+      return EFI_INVALID_PARAMETER;
+    }
+    break;
+  }
+
+  if ((Command->SectionType != EFI_SECTION_VERSION) && (Command->SectionType != EFI_SECTION_USER_INTERFACE)) {
+    if (Command->InputNum == 0) {
+      Error (ManifestFileName, Command->Line, 1001, "Missing options", "Input files");
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+ParseGenFfsCommand (
+  IN     CHAR8          *ManifestFileName,
+  IN     UINT32         Argc,
+  IN     CHAR8          **Argv,
+  IN OUT BATCH_COMMAND  *Command
+  )
+/*++
+
+Routine Description:
+
+  Parse the arguments of a GenFfs line, as GenFfs parses its command line.
+
+Arguments:
+
+  ManifestFileName  - Name of the manifest, for error messages
+  Argc              - Number of arguments, not counting the tool name
+  Argv              - The arguments, followed by a NULL entry
+  Command           - The command, with Line set
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_INVALID_PARAMETER   The line is not valid; an error was reported.
+  EFI_OUT_OF_RESOURCES
+
+--*/
+{
+  UINT32      Index;
+  EFI_STATUS  Status;
+
+  Command->IsFfs     = TRUE;
+  Command->FileType  = EFI_FV_FILETYPE_ALL;
+  Command->Alignment = mFfsValidAlign[0];
+
+  while (Argc > 0) {
+    if ((stricmp (Argv[0], "-t") == 0) || (stricmp (Argv[0], "--filetype") == 0) ||
+        (stricmp (Argv[0], "-o") == 0) || (stricmp (Argv[0], "--outputfile") == 0) ||
+        (stricmp (Argv[0], "-g") == 0) || (stricmp (Argv[0], "--fileguid") == 0) ||
+        (stricmp (Argv[0], "-a") == 0) || (stricmp (Argv[0], "--align") == 0) ||
+        (stricmp (Argv[0], "-i") == 0) || (stricmp (Argv[0], "--sectionfile") == 0) ||
+        (stricmp (Argv[0], "-n") == 0) || (stricmp (Argv[0], "--sectionalign") == 0) ||
+        (stricmp (Argv[0], "-d") == 0) || (stricmp (Argv[0], "--debug") == 0)) {
+      if (Argv[1] == NULL || Argv[1][0] == '-') {
+        Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%s value is missing", Argv[0]);
+        return EFI_INVALID_PARAMETER;
+      }
+    }
+
+    if ((stricmp (Argv[0], "-t") == 0) || (stricmp (Argv[0], "--filetype") == 0)) {
+      Command->FileType = FfsFileTypeFromString (Argv[1]);
+      if (Command->FileType == EFI_FV_FILETYPE_ALL) {
+        Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%s is not a valid file type", Argv[1]);
+        return EFI_INVALID_PARAMETER;
+      }
+    } else if ((stricmp (Argv[0], "-o") == 0) || (stricmp (Argv[0], "--outputfile") == 0)) {
+      Command->OutputFileName = Argv[1];
+    } else if ((stricmp (Argv[0], "-g") == 0) || (stricmp (Argv[0], "--fileguid") == 0)) {
+      Status = StringToGuid (Argv[1], &Command->Guid);
+      if (EFI_ERROR (Status)) {
+        Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%s = %s", Argv[0], Argv[1]);
+        return EFI_INVALID_PARAMETER;
+      }
+    } else if ((stricmp (Argv[0], "-x") == 0) || (stricmp (Argv[0], "--fixed") == 0)) {
+      Command->Attributes |= FFS_ATTRIB_FIXED;
+      Argc --;
+      Argv ++;
+      continue;
+    } else if ((stricmp (Argv[0], "-s") == 0) || (stricmp (Argv[0], "--checksum") == 0)) {
+      Command->Attributes |= FFS_ATTRIB_CHECKSUM;
+      Argc --;
+      Argv ++;
+      continue;
+    } else if ((stricmp (Argv[0], "-a") == 0) || (stricmp (Argv[0], "--align") == 0)) {
+      for (Index = 0; Index < sizeof (mFfsValidAlignName) / sizeof (CHAR8 *); Index ++) {
+        if (stricmp (Argv[1], mFfsValidAlignName[Index]) == 0) {
+          break;
+        }
+      }
+      if (Index == sizeof (mFfsValidAlignName) / sizeof (CHAR8 *)) {
+        if ((stricmp (Argv[1], "1") == 0) || (stricmp (Argv[1], "2") == 0) || (stricmp (Argv[1], "4") == 0)) {
+          //
+          // 1, 2, 4 byte alignment same to 8 byte alignment
+          //
+          Index = 0;
+        } else {
+          Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%s = %s", Argv[0], Argv[1]);
+          return EFI_INVALID_PARAMETER;
+        }
+      }
+      Command->Alignment = mFfsValidAlign[Index];
+    } else if ((stricmp (Argv[0], "-i") == 0) || (stricmp (Argv[0], "--sectionfile") == 0)) {
+      Status = AddCommandInput (Command, Argv[1]);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      //
+      // Section File alignment requirement
+      //
+      if (Argv[2] != NULL && ((stricmp (Argv[2], "-n") == 0) || (stricmp (Argv[2], "--sectionalign") == 0))) {
+        Status = StringtoAlignment (Argv[3], &Command->InputFileAlign[Command->InputNum - 1]);
+        if (EFI_ERROR (Status)) {
+          Error (ManifestFileName, Command->Line, 1003, "Invalid option value", "%s = %s", Argv[2], Argv[3] == NULL ? "" : Argv[3]);
+          return EFI_INVALID_PARAMETER;
+        }
+        Argc -= 2;
+        Argv += 2;
+      }
+    } else if ((stricmp (Argv[0], "-n") == 0) || (stricmp (Argv[0], "--sectionalign") == 0)) {
+      Error (ManifestFileName, Command->Line, 1000, "Unknown option", "SectionAlign option must be specified with section file.");
+      return EFI_INVALID_PARAMETER;
+    } else if ((stricmp (Argv[0], "-d") == 0) || (stricmp (Argv[0], "--debug") == 0)) {
+      //
+      // Message levels are set for the whole batch.
+      //
+    } else if ((stricmp (Argv[0], "-v") == 0) || (stricmp (Argv[0], "--verbose") == 0) ||
+               (stricmp (Argv[0], "-q") == 0) || (stricmp (Argv[0], "--quiet") == 0)) {
+      Argc --;
+      Argv ++;
+      continue;
+    } else {
+      Error (ManifestFileName, Command->Line, 1000, "Unknown option", Argv[0]);
+      return EFI_INVALID_PARAMETER;
+    }
+    Argc -= 2;
+    Argv += 2;
+  }
+
+  if (Command->FileType == EFI_FV_FILETYPE_ALL) {
+    Error (ManifestFileName, Command->Line, 1001, "Missing option", "filetype");
+    return EFI_INVALID_PARAMETER;
+  }
+  if (CompareGuid (&Command->Guid, &mZeroGuid) == 0) {
+    Error (ManifestFileName, Command->Line, 1001, "Missing option", "fileguid");
+    return EFI_INVALID_PARAMETER;
+  }
+  if (Command->InputNum == 0) {
+    Error (ManifestFileName, Command->Line, 1001, "Missing option", "Input files");
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+ParseManifest (
+  IN  CHAR8          *ManifestFileName,
+  OUT CHAR8          **ManifestText,
+  OUT BATCH_COMMAND  **Commands,
+  OUT UINTN          *CommandCount
+  )
+/*++
+
+Routine Description:
+
+  Read the manifest and parse all of its lines. The commands point into
+  ManifestText, which must be kept until they are no longer used.
+
+Arguments:
+
+  ManifestFileName  - Name of the manifest
+  ManifestText      - Receives the manifest contents, released with free()
+  Commands          - Receives the commands, in manifest order
+  CommandCount      - Receives the number of commands
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_ABORTED             The manifest could not be read, or a line is not
+                          valid; errors were reported.
+  EFI_OUT_OF_RESOURCES
+
+--*/
+{
+  FILE          *File;
+  CHAR8         *Text;
+  CHAR8         *Line;
+  CHAR8         *End;
+  CHAR8         *Argv[1024];
+  CHAR8         *ToolName;
+  UINT32        Argc;
+  UINT32        LineNumber;
+  UINTN         Size;
+  UINTN         Count;
+  UINTN         Capacity;
+  BATCH_COMMAND *List;
+  BATCH_COMMAND *NewList;
+  BATCH_COMMAND *Command;
+  EFI_STATUS    Status;
+  BOOLEAN       Failed;
+
+  File = fopen (ManifestFileName, "rb");
+  if (File == NULL) {
+    Error (NULL, 0, 0001, "Error opening file", ManifestFileName);
+    return EFI_ABORTED;
+  }
+  fseek (File, 0, SEEK_END);
+  Size = ftell (File);
+  fseek (File, 0, SEEK_SET);
+  Text = (CHAR8 *) malloc (Size + 1);
+  if (Text == NULL) {
+    fclose (File);
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  if (Size != 0 && fread (Text, Size, 1, File) != 1) {
+    Error (NULL, 0, 0004, "Error reading file", ManifestFileName);
+    fclose (File);
+    free (Text);
+    return EFI_ABORTED;
+  }
+  fclose (File);
+  Text[Size] = '\0';
+
+  List       = NULL;
+  Count      = 0;
+  Capacity   = 0;
+  Failed     = FALSE;
+  LineNumber = 0;
+  for (Line = Text; *Line != '\0'; Line = End) {
+    LineNumber++;
+    End = strchr (Line, '\n');
+    if (End == NULL) {
+      End = Line + strlen (Line);
+    } else {
+      *End++ = '\0';
+    }
+
+    Argc = SplitCommandLine (Line, Argv, sizeof (Argv) / sizeof (Argv[0]));
+    if (Argc == 0 || Argv[0][0] == '#') {
+      continue;
+    }
+    if (Argc == sizeof (Argv) / sizeof (Argv[0])) {
+      Error (ManifestFileName, LineNumber, 2000, "Invalid parameter", "too many arguments");
+      Failed = TRUE;
+      continue;
+    }
+
+    if (Count == Capacity) {
+      Capacity = (Capacity == 0) ? 256 : Capacity * 2;
+      NewList  = (BATCH_COMMAND *) realloc (List, Capacity * sizeof (BATCH_COMMAND));
+      if (NewList == NULL) {
+        Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Fail;
+      }
+      List = NewList;
+    }
+    Command = &List[Count++];
+    memset (Command, 0, sizeof (BATCH_COMMAND));
+    Command->Line = LineNumber;
+
+    //
+    // The tool may be given with a path or an extension.
+    //
+    ToolName = Argv[0] + strlen (Argv[0]);
+    while (ToolName > Argv[0] && ToolName[-1] != '/' && ToolName[-1] != '\\') {
+      ToolName--;
+    }
+    if (strnicmp (ToolName, "GenSec", 6) == 0 && (ToolName[6] == '\0' || ToolName[6] == '.')) {
+      Status = ParseGenSecCommand (ManifestFileName, Argc - 1, Argv + 1, Command);
+    } else if (strnicmp (ToolName, "GenFfs", 6) == 0 && (ToolName[6] == '\0' || ToolName[6] == '.')) {
+      Status = ParseGenFfsCommand (ManifestFileName, Argc - 1, Argv + 1, Command);
+    } else {
+      Error (ManifestFileName, LineNumber, 2000, "Invalid parameter", "%s is not GenSec or GenFfs", Argv[0]);
+      Status = EFI_INVALID_PARAMETER;
+    }
+    if (Status == EFI_OUT_OF_RESOURCES) {
+      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+      goto Fail;
+    }
+    if (!EFI_ERROR (Status) && Command->OutputFileName == NULL) {
+      Error (ManifestFileName, LineNumber, 1001, "Missing options", "Output file");
+      Status = EFI_INVALID_PARAMETER;
+    }
+    if (EFI_ERROR (Status)) {
+      Failed = TRUE;
+    }
+  }
+
+  if (!Failed) {
+    *ManifestText = Text;
+    *Commands     = List;
+    *CommandCount = Count;
+    return EFI_SUCCESS;
+  }
+  Status = EFI_ABORTED;
+
+Fail:
+  while (Count > 0) {
+    Count--;
+    free (List[Count].InputFileName);
+    free (List[Count].InputFileAlign);
+  }
+  free (List);
+  free (Text);
+  return Status;
+}
+
+STATIC
+BATCH_PATH *
+LookupPath (
+  IN BATCH_PATH  **Buckets,
+  IN UINTN       BucketCount,
+  IN CHAR8       *Name
+  )
+/*++
+
+Routine Description:
+
+  Find the entry of a file name, adding it if it is not known yet.
+
+Arguments:
+
+  Buckets     - The hash table
+  BucketCount - Size of the hash table, a power of two
+  Name        - The file name
+
+Returns:
+
+  The entry, or NULL if out of memory.
+
+--*/
+{
+  BATCH_PATH  *Path;
+  UINTN       Hash;
+  CHAR8       *Ptr;
+
+  Hash = 5381;
+  for (Ptr = Name; *Ptr != '\0'; Ptr++) {
+    Hash = Hash * 33 + (UINT8) *Ptr;
+  }
+  Hash &= BucketCount - 1;
+
+  for (Path = Buckets[Hash]; Path != NULL; Path = Path->Next) {
+    if (strcmp (Path->Name, Name) == 0) {
+      return Path;
+    }
+  }
+
+  Path = (BATCH_PATH *) calloc (1, sizeof (BATCH_PATH));
+  if (Path == NULL) {
+    return NULL;
+  }
+  Path->Name    = Name;
+  Path->Writer  = BATCH_NO_PRODUCER;
+  Path->Next    = Buckets[Hash];
+  Buckets[Hash] = Path;
+  return Path;
+}
+
+STATIC
+EFI_STATUS
+ScheduleCommands (
+  IN OUT BATCH_COMMAND  *Commands,
+  IN     UINTN          CommandCount,
+  OUT    UINTN          *StageCount
+  )
+/*++
+
+Routine Description:
+
+  Link each input to the earlier command producing it and split the
+  commands into stages. A command runs in a later stage than the producers
+  of its inputs, and than every earlier command reading or writing its
+  output, so the commands of one stage can run in any order. The result
+  is the same as running the lines one after the other.
+
+Arguments:
+
+  Commands      - The commands, in manifest order
+  CommandCount  - The number of commands
+  StageCount    - Receives the number of stages
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_OUT_OF_RESOURCES
+
+--*/
+{
+  BATCH_PATH    **Buckets;
+  BATCH_PATH    *Path;
+  BATCH_PATH    *Next;
+  BATCH_COMMAND *Command;
+  UINTN         BucketCount;
+  UINTN         Index;
+  UINTN         Input;
+  UINTN         Stage;
+  EFI_STATUS    Status;
+
+  BucketCount = 64;
+  while (BucketCount < CommandCount * 4) {
+    BucketCount *= 2;
+  }
+  Buckets = (BATCH_PATH **) calloc (BucketCount, sizeof (BATCH_PATH *));
+  if (Buckets == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status      = EFI_SUCCESS;
+  *StageCount = 0;
+  for (Index = 0; Index < CommandCount; Index++) {
+    Command = &Commands[Index];
+    Command->Producer = (UINTN *) malloc ((Command->InputNum + 1) * sizeof (UINTN));
+    if (Command->Producer == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+      break;
+    }
+
+    Stage = 0;
+    for (Input = 0; Input < Command->InputNum; Input++) {
+      Path = LookupPath (Buckets, BucketCount, Command->InputFileName[Input]);
+      if (Path == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        break;
+      }
+      Command->Producer[Input] = Path->Writer;
+      if (Path->Writer != BATCH_NO_PRODUCER && Stage <= Commands[Path->Writer].Stage) {
+        Stage = Commands[Path->Writer].Stage + 1;
+      }
+    }
+    Path = LookupPath (Buckets, BucketCount, Command->OutputFileName);
+    if (EFI_ERROR (Status) || Path == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+      break;
+    }
+    if (Path->Used && Stage <= Path->LastStage) {
+      Stage = Path->LastStage + 1;
+    }
+    Command->Stage = Stage;
+    if (*StageCount <= Stage) {
+      *StageCount = Stage + 1;
+    }
+
+    //
+    // Record this command as a reader of its inputs and the writer of its
+    // output. Later readers of the output get the new contents in memory.
+    //
+    for (Input = 0; Input < Command->InputNum; Input++) {
+      Path = LookupPath (Buckets, BucketCount, Command->InputFileName[Input]);
+      if (!Path->Used || Path->LastStage < Stage) {
+        Path->LastStage = Stage;
+      }
+      Path->Used = TRUE;
+      if (Command->Producer[Input] != BATCH_NO_PRODUCER) {
+        Commands[Command->Producer[Input]].Consumers++;
+      }
+    }
+    Path = LookupPath (Buckets, BucketCount, Command->OutputFileName);
+    if (!Path->Used || Path->LastStage < Stage) {
+      Path->LastStage = Stage;
+    }
+    Path->Used   = TRUE;
+    Path->Writer = Index;
+  }
+
+  for (Index = 0; Index < BucketCount; Index++) {
+    for (Path = Buckets[Index]; Path != NULL; Path = Next) {
+      Next = Path->Next;
+      free (Path);
+    }
+  }
+  free (Buckets);
+  return Status;
+}
+
+STATIC
+EFI_STATUS
+WriteOutputFile (
+  IN CHAR8   *FileName,
+  IN UINT8   *Buffer,
+  IN UINT32  Size
+  )
+/*++
+
+Routine Description:
+
+  Write the output of a command.
+
+Arguments:
+
+  FileName    - Name of the output file
+  Buffer      - The data
+  Size        - The size of the data
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_ABORTED   The file could not be written; an error was reported.
+
+--*/
+{
+  FILE    *File;
+  BOOLEAN Written;
+
+  File = fopen (FileName, "wb");
+  if (File == NULL) {
+    Error (NULL, 0, 0001, "Error opening file for writing", FileName);
+    return EFI_ABORTED;
+  }
+  Written = (BOOLEAN) (Size == 0 || fwrite (Buffer, Size, 1, File) == 1);
+  if (fclose (File) != 0 || !Written) {
+    Error (NULL, 0, 0002, "Error writing file", FileName);
+    return EFI_ABORTED;
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+RunBatchCommand (
+  IN VOID   *Context,
+  IN UINTN  JobIndex
+  )
+/*++
+
+Routine Description:
+
+  WORKER_POOL_FUNCTION building one command of the current stage. The
+  producers of its inputs all ran in earlier stages, so their outputs are
+  only read here.
+
+Arguments:
+
+  Context     - The BATCH_CONTEXT
+  JobIndex    - Index into the jobs of the current stage
+
+Returns:
+
+  None
+
+--*/
+{
+  BATCH_CONTEXT       *Batch;
+  BATCH_COMMAND       *Command;
+  BATCH_COMMAND       *Producer;
+  FFS_SECTION_INPUT   *Inputs;
+  MAPPED_FILE         *Mapped;
+  UINT32              Index;
+  UINT32              Length;
+  EFI_STATUS          Status;
+
+  Batch   = (BATCH_CONTEXT *) Context;
+  Command = &Batch->Commands[Batch->Jobs[JobIndex]];
+
+  Inputs = (FFS_SECTION_INPUT *) calloc (Command->InputNum + 1, sizeof (FFS_SECTION_INPUT));
+  Mapped = (MAPPED_FILE *) calloc (Command->InputNum + 1, sizeof (MAPPED_FILE));
+  if (Inputs == NULL || Mapped == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  for (Index = 0; Index < Command->InputNum; Index++) {
+    if (Command->Producer[Index] != BATCH_NO_PRODUCER) {
+      Producer = &Batch->Commands[Command->Producer[Index]];
+      if (EFI_ERROR (Producer->Status)) {
+        Status = EFI_NOT_STARTED;
+        goto Done;
+      }
+      Inputs[Index].Data = Producer->Output;
+      Inputs[Index].Size = Producer->OutputSize;
+    } else {
+      Status = OpenMappedFile (Command->InputFileName[Index], &Mapped[Index]);
+      if (EFI_ERROR (Status)) {
+        Error (NULL, 0, 0001, "Error opening file", Command->InputFileName[Index]);
+        goto Done;
+      }
+      Inputs[Index].Data = Mapped[Index].Data;
+      Inputs[Index].Size = (UINT32) Mapped[Index].Size;
+    }
+    Inputs[Index].Alignment = Command->InputFileAlign[Index];
+  }
+
+  if (Command->IsFfs) {
+    Status = FfsGenFile (
+               Command->FileType,
+               &Command->Guid,
+               Command->Attributes,
+               Command->Alignment,
+               Inputs,
+               Command->InputNum,
+               &Command->Output,
+               &Command->OutputSize
+               );
+  } else {
+    switch (Command->SectionType) {
+    case EFI_SECTION_COMPRESSION:
+      Status = FfsGenCompressionSection (
+                 Inputs,
+                 Command->InputNum,
+                 Command->CompressionType,
+                 Command->CompressLevel,
+                 &Command->Output,
+                 &Command->OutputSize
+                 );
+      break;
+
+    case EFI_SECTION_GUID_DEFINED:
+      Status = FfsGenGuidDefinedSection (
+                 Inputs,
+                 Command->InputNum,
+                 &Command->Guid,
+                 Command->GuidAttributes,
+                 Command->GuidHeaderLength,
+                 &Command->Output,
+                 &Command->OutputSize
+                 );
+      break;
+
+    case EFI_SECTION_VERSION:
+      Status = FfsGenVersionSection (Command->BuildNumber, Command->Name, &Command->Output, &Command->OutputSize);
+      break;
+
+    case EFI_SECTION_USER_INTERFACE:
+      Status = FfsGenUserInterfaceSection (Command->Name, &Command->Output, &Command->OutputSize);
+      break;
+
+    case EFI_SECTION_ALL:
+      Length = 0;
+      FfsGetSectionContents (Inputs, Command->InputNum, NULL, &Length, NULL, NULL);
+      Command->Output = (UINT8 *) malloc (Length + 1);
+      if (Command->Output == NULL) {
+        Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+        Status = EFI_OUT_OF_RESOURCES;
+        break;
+      }
+      Status = FfsGetSectionContents (Inputs, Command->InputNum, Command->Output, &Length, NULL, NULL);
+      Command->OutputSize = Length;
+      break;
+
+    default:
+      Status = FfsGenLeafSection (
+                 Command->SectionType,
+                 Inputs[0].Data,
+                 Inputs[0].Size,
+                 &Command->Output,
+                 &Command->OutputSize
+                 );
+      break;
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = WriteOutputFile (Command->OutputFileName, Command->Output, Command->OutputSize);
+  }
+
+Done:
+  if (Mapped != NULL) {
+    for (Index = 0; Index < Command->InputNum; Index++) {
+      CloseMappedFile (&Mapped[Index], FALSE);
+    }
+    free (Mapped);
+  }
+  if (Inputs != NULL) {
+    free (Inputs);
+  }
+  if (EFI_ERROR (Status) && Command->Output != NULL) {
+    free (Command->Output);
+    Command->Output = NULL;
+  }
+  Command->Status = Status;
+}
+
+int
+main (
+  int   argc,
+  CHAR8 *argv[]
+  )
+/*++
+
+Routine Description:
+
+  Main function.
+
+Arguments:
+
+  argc - Number of command line parameters.
+  argv - Array of pointers to parameter strings.
+
+Returns:
+  STATUS_SUCCESS - Utility exits successfully.
+  STATUS_ERROR   - Some error occurred during execution.
+
+--*/
+{
+  EFI_STATUS      Status;
+  CHAR8           *ManifestFileName;
+  CHAR8           *ManifestText;
+  BATCH_COMMAND   *Commands;
+  BATCH_COMMAND   *Command;
+  BATCH_COMMAND   *Producer;
+  BATCH_CONTEXT   Batch;
+  UINTN           CommandCount;
+  UINTN           StageCount;
+  UINTN           *StageStart;
+  UINTN           Stage;
+  UINTN           Index;
+  UINTN           Job;
+  UINT32          Input;
+  UINT64          LogLevel;
+  UINT64          TempNumber;
+  UINT32          ThreadCount;
+
+  ManifestFileName  = NULL;
+  ManifestText      = NULL;
+  Commands          = NULL;
+  CommandCount      = 0;
+  StageStart        = NULL;
+  ThreadCount       = 0;
+  Batch.Jobs        = NULL;
+
+  SetUtilityName (UTILITY_NAME);
+
+  if (argc == 1) {
+    Error (NULL, 0, 1001, "Missing options", "no options input");
+    Usage ();
+    return STATUS_ERROR;
+  }
+
+  //
+  // Parse command line
+  //
+  argc --;
+  argv ++;
+
+  if ((stricmp (argv[0], "-h") == 0) || (stricmp (argv[0], "--help") == 0)) {
+    Version ();
+    Usage ();
+    return STATUS_SUCCESS;
+  }
+
+  if (stricmp (argv[0], "--version") == 0) {
+    Version ();
+    return STATUS_SUCCESS;
+  }
+
+  while (argc > 0) {
+    if ((strcmp (argv[0], "-j") == 0) || (stricmp (argv[0], "--threads") == 0)) {
+      Status = AsciiStringToUint64 (argv[1], FALSE, &TempNumber);
+      if (EFI_ERROR (Status) || TempNumber > 0xFFFFFFFF) {
+        Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
+        return STATUS_ERROR;
+      }
+      ThreadCount = (UINT32) TempNumber;
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+
+    if ((stricmp (argv[0], "-v") == 0) || (stricmp (argv[0], "--verbose") == 0)) {
+      SetPrintLevel (VERBOSE_LOG_LEVEL);
+      VerboseMsg ("Verbose output Mode Set!");
+      argc --;
+      argv ++;
+      continue;
+    }
+
+    if ((stricmp (argv[0], "-q") == 0) || (stricmp (argv[0], "--quiet") == 0)) {
+      SetPrintLevel (KEY_LOG_LEVEL);
+      KeyMsg ("Quiet output Mode Set!");
+      argc --;
+      argv ++;
+      continue;
+    }
+
+    if ((stricmp (argv[0], "-d") == 0) || (stricmp (argv[0], "--debug") == 0)) {
+      Status = AsciiStringToUint64 (argv[1], FALSE, &LogLevel);
+      if (EFI_ERROR (Status)) {
+        Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
+        return STATUS_ERROR;
+      }
+      if (LogLevel > 9) {
+        Error (NULL, 0, 1003, "Invalid option value", "Debug Level range is 0-9, current input level is %d", (int) LogLevel);
+        return STATUS_ERROR;
+      }
+      SetPrintLevel (LogLevel);
+      DebugMsg (NULL, 0, 9, "Debug Mode Set", "Debug Output Mode Level %s is set!", argv[1]);
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+
+    if (argv[0][0] == '-') {
+      Error (NULL, 0, 1000, "Unknown option", argv[0]);
+      return STATUS_ERROR;
+    }
+
+    if (ManifestFileName != NULL) {
+      Error (NULL, 0, 1000, "Unknown option", "only one manifest file can be given: %s", argv[0]);
+      return STATUS_ERROR;
+    }
+    ManifestFileName = argv[0];
+    argc --;
+    argv ++;
+  }
+
+  VerboseMsg ("%s tool start.", UTILITY_NAME);
+
+  if (ManifestFileName == NULL) {
+    Error (NULL, 0, 1001, "Missing option", "Manifest file");
+    return STATUS_ERROR;
+  }
+  VerboseMsg ("Manifest file name is %s", ManifestFileName);
+
+  Status = ParseManifest (ManifestFileName, &ManifestText, &Commands, &CommandCount);
+  if (EFI_ERROR (Status)) {
+    goto Finish;
+  }
+
+  Status = ScheduleCommands (Commands, CommandCount, &StageCount);
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    goto Finish;
+  }
+  VerboseMsg ("%u commands in %u stages", (unsigned) CommandCount, (unsigned) StageCount);
+
+  //
+  // Sort the commands by stage, keeping the manifest order within a stage.
+  //
+  StageStart = (UINTN *) calloc (StageCount + 1, sizeof (UINTN));
+  Batch.Jobs = (UINTN *) malloc ((CommandCount + 1) * sizeof (UINTN));
+  if (StageStart == NULL || Batch.Jobs == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    goto Finish;
+  }
+  for (Index = 0; Index < CommandCount; Index++) {
+    StageStart[Commands[Index].Stage + 1]++;
+  }
+  for (Stage = 0; Stage < StageCount; Stage++) {
+    StageStart[Stage + 1] += StageStart[Stage];
+  }
+  for (Index = 0; Index < CommandCount; Index++) {
+    Batch.Jobs[StageStart[Commands[Index].Stage]++] = Index;
+  }
+  for (Stage = StageCount; Stage > 0; Stage--) {
+    StageStart[Stage] = StageStart[Stage - 1];
+  }
+  StageStart[0] = 0;
+  Batch.Commands = Commands;
+
+  //
+  // Read the cache settings and select the CRC32 engine before the worker
+  // threads use them.
+  //
+  CompressCacheEnabled ();
+  Crc32SetEngine (Crc32EngineAuto);
+
+  for (Stage = 0; Stage < StageCount; Stage++) {
+    Batch.Jobs += StageStart[Stage];
+    RunWorkerPool (StageStart[Stage + 1] - StageStart[Stage], ThreadCount, RunBatchCommand, &Batch);
+    Batch.Jobs -= StageStart[Stage];
+
+    //
+    // Report the failures in manifest order, and release the outputs that
+    // no later command reads.
+    //
+    for (Job = StageStart[Stage]; Job < StageStart[Stage + 1]; Job++) {
+      Command = &Commands[Batch.Jobs[Job]];
+      if (Command->Status == EFI_NOT_STARTED) {
+        Error (ManifestFileName, Command->Line, 2000, "Command not run", "an input of %s could not be built", Command->OutputFileName);
+      } else if (EFI_ERROR (Command->Status)) {
+        Error (ManifestFileName, Command->Line, 2000, "Command failed", "%s could not be built", Command->OutputFileName);
+      }
+      for (Input = 0; Input < Command->InputNum; Input++) {
+        if (Command->Producer[Input] != BATCH_NO_PRODUCER) {
+          Producer = &Commands[Command->Producer[Input]];
+          Producer->Consumers--;
+          if (Producer->Consumers == 0 && Producer->Output != NULL) {
+            free (Producer->Output);
+            Producer->Output = NULL;
+          }
+        }
+      }
+      if (Command->Consumers == 0 && Command->Output != NULL) {
+        free (Command->Output);
+        Command->Output = NULL;
+      }
+    }
+  }
+
+Finish:
+  for (Index = 0; Index < CommandCount; Index++) {
+    free (Commands[Index].InputFileName);
+    free (Commands[Index].InputFileAlign);
+    free (Commands[Index].Producer);
+    free (Commands[Index].Output);
+  }
+  free (Commands);
+  free (ManifestText);
+  free (StageStart);
+  free (Batch.Jobs);
+
+  VerboseMsg ("%s tool done with return code is 0x%x.", UTILITY_NAME, GetUtilityStatus ());
+
+  return GetUtilityStatus ();
+}
@@ -41,9 +41,6 @@ Abstract:
 #define UTILITY_MAJOR_VERSION 0
 #define UTILITY_MINOR_VERSION 1
 
-EFI_GUID  mEfiFirmwareFileSystem2Guid = EFI_FIRMWARE_FILE_SYSTEM2_GUID;
-EFI_GUID  mEfiFirmwareFileSystem3Guid = EFI_FIRMWARE_FILE_SYSTEM3_GUID;
-
 STATIC
 VOID 
 Version (
@@ -130,6 +127,18 @@ Returns:
                         If value is FALSE, will always not take reabse action\n\
                         If not specified, will take rebase action if rebase address greater than zero, \n\
                         will not take rebase action if rebase address is zero.\n");
+  fprintf (stdout, "  -j Threads, --threads Threads\n\
+                        Threads is the number of threads used to rebase the\n\
+                        files. Zero, the default, uses one per processor.\n\
+                        The FvImage and map file do not depend on it.\n");
+  fprintf (stdout, "  --pack                Reorder the FFS files to reduce the padding needed\n\
+                        for their alignment. Files may be dispatched in a\n\
+                        different order. Apriori files, the VTF file and\n\
+                        files given a FileTakenSize keep their place.\n");
+  fprintf (stdout, "  --incremental         Update the existing FvImage in place when only some\n\
+                        FFS files changed and they still fit in their place.\n\
+                        Otherwise the FvImage is built again from scratch.\n\
+                        The FV report file records what the update needs.\n");
   fprintf (stdout, "  -a AddressFile, --addrfile AddressFile\n\
                         AddressFile is one file used to record the child\n\
                         FV base address when current FV base address is set.\n");
@@ -158,9 +167,6 @@ Returns:
   fprintf (stdout, "  -h, --help            Show this help message and exit.\n");
 }
 
-UINT32 mFvTotalSize;
-UINT32 mFvTakenSize;
-
 int
 main (
   IN int   argc,
@@ -204,6 +210,8 @@ Returns:
   EFI_CAPSULE_HEADER    *CapsuleHeader;
   UINT64                LogLevel, TempNumber;
   UINT32                Index;
+  CHAR8                 *FfsFileName;
+  EFI_FV_BLOCK_MAP_ENTRY *BlockMapEntry;
 
   InfFileName   = NULL;
   AddrFileName  = NULL;
@@ -218,6 +226,8 @@ Returns:
   LogLevel      = 0;
   TempNumber    = 0;
   Index         = 0;
+  FfsFileName   = NULL;
+  BlockMapEntry = NULL;
   mFvTotalSize  = 0;
   mFvTakenSize  = 0;
   Status        = EFI_SUCCESS;
@@ -315,7 +325,11 @@ Returns:
         Error (NULL, 0, 1003, "Invalid option value", "Fv block size can't be be set to zero");
         return STATUS_ERROR;        
       }
-      mFvDataInfo.FvBlocks[0].Length = (UINT32) TempNumber;
+      BlockMapEntry = GetFvBlockMapEntry (&mFvDataInfo, 0);
+      if (BlockMapEntry == NULL) {
+        return STATUS_ERROR;
+      }
+      BlockMapEntry->Length = (UINT32) TempNumber;
       DebugMsg (NULL, 0, 9, "FV Block Size", "%s = 0x%llx", EFI_BLOCK_SIZE_STRING, (unsigned long long) TempNumber);
       argc -= 2;
       argv += 2;
@@ -332,7 +346,11 @@ Returns:
         Error (NULL, 0, 1003, "Invalid option value", "Fv block number can't be set to zero");
         return STATUS_ERROR;        
       }
-      mFvDataInfo.FvBlocks[0].NumBlocks = (UINT32) TempNumber;
+      BlockMapEntry = GetFvBlockMapEntry (&mFvDataInfo, 0);
+      if (BlockMapEntry == NULL) {
+        return STATUS_ERROR;
+      }
+      BlockMapEntry->NumBlocks = (UINT32) TempNumber;
       DebugMsg (NULL, 0, 9, "FV Number Block", "%s = 0x%llx", EFI_NUM_BLOCKS_STRING, (unsigned long long) TempNumber);
       argc -= 2;
       argv += 2;
@@ -344,10 +362,11 @@ Returns:
         Error (NULL, 0, 1003, "Invalid option value", "Input Ffsfile can't be null");
         return STATUS_ERROR;
       }
-      strcpy (mFvDataInfo.FvFiles[Index], argv[1]);
+      FfsFileName = argv[1];
       DebugMsg (NULL, 0, 9, "FV component file", "the %uth name is %s", (unsigned) Index + 1, argv[1]);
       argc -= 2;
       argv += 2;
+      TempNumber = 0;
 
       if (argc > 0) {
 		    if ((stricmp (argv[0], "-s") == 0) || (stricmp (argv[0], "--filetakensize") == 0)) {
@@ -360,12 +379,14 @@ Returns:
 		        Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
 		        return STATUS_ERROR;        
 		      }
-		      mFvDataInfo.SizeofFvFiles[Index] = (UINT32) TempNumber;
 	      	DebugMsg (NULL, 0, 9, "FV component file size", "the %uth size is %s", (unsigned) Index + 1, argv[1]);
 	      	argc -= 2;
 	      	argv += 2;
         }
       }
+      if (AddFvFile (&mFvDataInfo, FfsFileName, (UINT32) TempNumber) != EFI_SUCCESS) {
+        return STATUS_ERROR;
+      }
       Index ++;
       continue; 
     }
@@ -402,6 +423,35 @@ Returns:
       continue; 
     } 
 
+    if ((strcmp (argv[0], "-j") == 0) || (stricmp (argv[0], "--threads") == 0)) {
+      Status = AsciiStringToUint64 (argv[1], FALSE, &TempNumber);
+      if (EFI_ERROR (Status) || TempNumber > 0xFFFFFFFF) {
+        Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
+        return STATUS_ERROR;
+      }
+      mFvRebaseThreadCount = (UINT32) TempNumber;
+      DebugMsg (NULL, 0, 9, "Rebase threads", "%u", (unsigned) mFvRebaseThreadCount);
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+
+    if (stricmp (argv[0], "--pack") == 0) {
+      mFvDataInfo.PackFiles = TRUE;
+      DebugMsg (NULL, 0, 9, "Pack FFS files", NULL);
+      argc --;
+      argv ++;
+      continue;
+    }
+
+    if (stricmp (argv[0], "--incremental") == 0) {
+      mFvDataInfo.Incremental = TRUE;
+      DebugMsg (NULL, 0, 9, "Incremental FV update", NULL);
+      argc --;
+      argv ++;
+      continue;
+    }
+
     if (stricmp (argv[0], "--capheadsize") == 0) {
       //
       // Get Capsule Image Header Size
@@ -631,15 +681,20 @@ Returns:
     //
     // Call the GenerateCapImage to generate Capsule Image
     //
-    for (Index = 0; mFvDataInfo.FvFiles[Index][0] != '\0'; Index ++) {
-      strcpy (mCapDataInfo.CapFiles[Index], mFvDataInfo.FvFiles[Index]);
+    for (Index = 0; Index < mFvDataInfo.FvFileCount; Index ++) {
+      Status = AddCapFile (&mCapDataInfo, mFvDataInfo.FvFiles[Index]);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
     }
 
-    Status = GenerateCapImage (
-              InfFileImage, 
-              InfFileSize,
-              OutFileName
-              );
+    if (!EFI_ERROR (Status)) {
+      Status = GenerateCapImage (
+                InfFileImage, 
+                InfFileSize,
+                OutFileName
+                );
+    }
   } else {
     VerboseMsg ("Create Fv image and its map file");
     //
@@ -667,6 +722,8 @@ Returns:
   if (InfFileImage != NULL) {
     free (InfFileImage);
   }
+  ReleaseFvInfo (&mFvDataInfo);
+  ReleaseCapInfo (&mCapDataInfo);
   
   //
   //  update boot driver address and runtime driver address in address file
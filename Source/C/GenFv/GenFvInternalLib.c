@@ -36,16 +36,25 @@ Abstract:
 #include "GenFvInternalLib.h"
 #include "FvLib.h"
 #include "PeCoffLib.h"
+#include "Sha256.h"
 #include "WinNtInclude.h"
+#include "WorkerPool.h"
 
 BOOLEAN mArm = FALSE;
 STATIC UINT32   MaxFfsAlignment = 0;
 
+EFI_GUID  mEfiFirmwareFileSystem2Guid = EFI_FIRMWARE_FILE_SYSTEM2_GUID;
+EFI_GUID  mEfiFirmwareFileSystem3Guid = EFI_FIRMWARE_FILE_SYSTEM3_GUID;
 EFI_GUID  mEfiFirmwareVolumeTopFileGuid = EFI_FFS_VOLUME_TOP_FILE_GUID;
-EFI_GUID  mFileGuidArray [MAX_NUMBER_OF_FILES_IN_FV];
 EFI_GUID  mZeroGuid                 = {0x0, 0x0, 0x0, {0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0}};
 EFI_GUID  mDefaultCapsuleGuid       = {0x3B6686BD, 0x0D76, 0x4030, { 0xB7, 0x0E, 0xB5, 0x51, 0x9E, 0x2F, 0xC5, 0xA0 }};
 
+//
+// Apriori files are found by name, so PackFvFiles leaves them in place.
+//
+STATIC EFI_GUID mPeiAprioriFileGuid = {0x1B45CC0A, 0x156A, 0x428A, { 0xAF, 0x62, 0x49, 0x86, 0x4D, 0xA0, 0xE6, 0xE6 }};
+STATIC EFI_GUID mDxeAprioriFileGuid = {0xFC510EE7, 0xFFDC, 0x11D4, { 0xBD, 0x41, 0x00, 0x80, 0xC7, 0x3C, 0x88, 0x81 }};
+
 CHAR8      *mFvbAttributeName[] = {
   EFI_FVB2_READ_DISABLED_CAP_STRING, 
   EFI_FVB2_READ_ENABLED_CAP_STRING,  
@@ -160,255 +169,203 @@ UINT8                                   m64kRecoveryStartupApDataArray[SIZEOF_ST
 FV_INFO                     mFvDataInfo;
 CAP_INFO                    mCapDataInfo;
 BOOLEAN                     mIsLargeFfs = FALSE;
+UINT32                      mFvTotalSize;
+UINT32                      mFvTakenSize;
 
-EFI_PHYSICAL_ADDRESS mFvBaseAddress[0x10];
+EFI_PHYSICAL_ADDRESS *mFvBaseAddress = NULL;
 UINT32               mFvBaseAddressNumber = 0;
+STATIC UINTN         mMaxFvBaseAddress = 0;
+//
+// Number of threads rebasing the files of the FV, 0 for one per processor.
+//
+UINT32               mFvRebaseThreadCount = 0;
+
+//
+// A message of a file rebased on a worker thread. The message routines
+// update shared state and print directly, so the messages are kept with the
+// job and printed by RebaseFvFiles in the order of the files.
+//
+#define FFS_REBASE_ERROR      0
+#define FFS_REBASE_WARNING    1
+#define FFS_REBASE_DEBUG      2
+
+typedef struct {
+  UINT8                 Type;
+  UINT64                Code;
+  CHAR8                 *Text;
+  CHAR8                 Message[MAX_LINE_LEN];
+} FFS_REBASE_MESSAGE;
+
+//
+// The rebase of a file placed in the FV. Files are laid out first and
+// rebased afterwards, possibly in parallel, once every address is known.
+//
+typedef struct {
+  UINTN                 Index;
+  CHAR8                 *FileName;
+  EFI_FFS_FILE_HEADER   *FfsFile;
+  UINTN                 XipOffset;
+  FILE                  *MapFile;
+  BOOLEAN               Done;
+  BOOLEAN               IsArm;
+  EFI_STATUS            Status;
+  FFS_REBASE_MESSAGE    *Messages;
+  UINTN                 MessageCount;
+  UINTN                 MaxMessageCount;
+} FFS_REBASE_JOB;
+
+//
+// Size and SHA-256 digest of an FFS file when it was mapped. The FV report
+// file records them so that an incremental build can tell which files
+// changed, independent of the file time resolution.
+//
+typedef struct {
+  UINT64                Size;
+  UINT8                 Digest[SHA256_DIGEST_SIZE];
+} FV_FILE_STAMP;
 
+//
+// Per file tables of the FV being built, allocated by AllocateFvFileTables
+// for the number of files in the FV. The FFS files are each mapped once and
+// shared by the size calculation and the placement into the FV image.
+//
+STATIC EFI_GUID       *mFileGuidArray = NULL;
+STATIC MAPPED_FILE    *mFvFileImages  = NULL;
+STATIC FFS_REBASE_JOB *mRebaseJobs    = NULL;
+STATIC UINTN          mRebaseJobCount = 0;
+STATIC BOOLEAN        *mFileIsArm     = NULL;
+STATIC FV_FILE_STAMP  *mFileStamps    = NULL;
+
+STATIC
 EFI_STATUS
-ParseFvInf (
-  IN  MEMORY_FILE  *InfFile,
-  OUT FV_INFO      *FvInfo
+RebaseFfsFile (
+  IN OUT  FV_INFO               *FvInfo,
+  IN      CHAR8                 *FileName,
+  IN OUT  EFI_FFS_FILE_HEADER   *FfsFile,
+  IN      UINTN                 XipOffset,
+  IN      FILE                  *FvMapFile,
+  OUT     BOOLEAN               *IsArm,
+  IN OUT  FFS_REBASE_JOB        *Job
+  );
+
+STATIC
+EFI_STATUS
+GrowTable (
+  IN OUT VOID     **Table,
+  IN OUT UINTN    *MaxCount,
+  IN     UINTN    EntrySize,
+  IN     UINTN    Count
   )
 /*++
 
 Routine Description:
 
-  This function parses a FV.INF file and copies info into a FV_INFO structure.
+  Make room for at least Count entries in a table allocated with malloc.
+  The capacity doubles on each growth and the new entries are zero.
 
 Arguments:
 
-  InfFile         Memory file image.
-  FvInfo          Information read from INF file.
+  Table         The table, or NULL if there is none yet.
+  MaxCount      The number of entries allocated in Table.
+  EntrySize     The size of an entry.
+  Count         The number of entries needed.
 
 Returns:
 
-  EFI_SUCCESS       INF file information successfully retrieved.
-  EFI_ABORTED       INF file has an invalid format.
-  EFI_NOT_FOUND     A required string was not found in the INF file.
+  EFI_SUCCESS              Table has room for Count entries.
+  EFI_OUT_OF_RESOURCES     The table could not be grown. It is unchanged.
+
 --*/
 {
-  CHAR8       Value[_MAX_PATH];
-  UINT64      Value64;
-  UINTN       Index;
-  UINTN       Number;
-  EFI_STATUS  Status;
-  EFI_GUID    GuidValue;
-
-  //
-  // Read the FV base address
-  //
-  if (!mFvDataInfo.BaseAddressSet) {
-    Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_FV_BASE_ADDRESS_STRING, 0, Value);
-    if (Status == EFI_SUCCESS) {
-      //
-      // Get the base address
-      //
-      Status = AsciiStringToUint64 (Value, FALSE, &Value64);
-      if (EFI_ERROR (Status)) {
-        Error (NULL, 0, 2000, "Invalid parameter", "%s = %s", EFI_FV_BASE_ADDRESS_STRING, Value);
-        return EFI_ABORTED;
-      }
-      DebugMsg (NULL, 0, 9, "rebase address", "%s = %s", EFI_FV_BASE_ADDRESS_STRING, Value);
-
-      FvInfo->BaseAddress = Value64;
-      FvInfo->BaseAddressSet = TRUE;
-    }
-  }
-
-  //
-  // Read the FV File System Guid
-  //
-  if (!FvInfo->FvFileSystemGuidSet) {
-    Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_FV_FILESYSTEMGUID_STRING, 0, Value);
-    if (Status == EFI_SUCCESS) {
-      //
-      // Get the guid value
-      //
-      Status = StringToGuid (Value, &GuidValue);
-      if (EFI_ERROR (Status)) {
-        Error (NULL, 0, 2000, "Invalid parameter", "%s = %s", EFI_FV_FILESYSTEMGUID_STRING, Value);
-        return EFI_ABORTED;
-      }
-      memcpy (&FvInfo->FvFileSystemGuid, &GuidValue, sizeof (EFI_GUID));
-      FvInfo->FvFileSystemGuidSet = TRUE;
-    }
-  }
+  UINTN   NewMaxCount;
+  VOID    *NewTable;
 
-  //
-  // Read the FV Extension Header File Name
-  //
-  Status = FindToken (InfFile, ATTRIBUTES_SECTION_STRING, EFI_FV_EXT_HEADER_FILE_NAME, 0, Value);
-  if (Status == EFI_SUCCESS) {
-    strcpy (FvInfo->FvExtHeaderFile, Value);
+  if (Count <= *MaxCount) {
+    return EFI_SUCCESS;
   }
 
-  //
-  // Read the FV file name
-  //
-  Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_FV_FILE_NAME_STRING, 0, Value);
-  if (Status == EFI_SUCCESS) {
-    //
-    // copy the file name
-    //
-    strcpy (FvInfo->FvName, Value);
-  }
-  
-  //
-  // Read Fv Attribute
-  //
-  for (Index = 0; Index < sizeof (mFvbAttributeName)/sizeof (CHAR8 *); Index ++) {
-    if ((mFvbAttributeName [Index] != NULL) && \
-        (FindToken (InfFile, ATTRIBUTES_SECTION_STRING, mFvbAttributeName [Index], 0, Value) == EFI_SUCCESS)) {
-      if ((strcmp (Value, TRUE_STRING) == 0) || (strcmp (Value, ONE_STRING) == 0)) {
-        FvInfo->FvAttributes |= 1 << Index;
-      } else if ((strcmp (Value, FALSE_STRING) != 0) && (strcmp (Value, ZERO_STRING) != 0)) {
-        Error (NULL, 0, 2000, "Invalid parameter", "%s expected %s | %s", mFvbAttributeName [Index], TRUE_STRING, FALSE_STRING);
-        return EFI_ABORTED;
-      }
-    }
+  NewMaxCount = (*MaxCount == 0) ? 16 : *MaxCount * 2;
+  while (NewMaxCount < Count) {
+    NewMaxCount *= 2;
   }
 
-  //
-  // Read Fv Alignment
-  //
-  for (Index = 0; Index < sizeof (mFvbAlignmentName)/sizeof (CHAR8 *); Index ++) {
-    if (FindToken (InfFile, ATTRIBUTES_SECTION_STRING, mFvbAlignmentName [Index], 0, Value) == EFI_SUCCESS) {
-      if (strcmp (Value, TRUE_STRING) == 0) {
-        FvInfo->FvAttributes |= Index << 16;
-        DebugMsg (NULL, 0, 9, "FV file alignment", "Align = %s", mFvbAlignmentName [Index]);
-        break;
-      }
-    }
+  NewTable = realloc (*Table, NewMaxCount * EntrySize);
+  if (NewTable == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
+  memset ((UINT8 *) NewTable + *MaxCount * EntrySize, 0, (NewMaxCount - *MaxCount) * EntrySize);
 
-  //
-  // Read weak alignment flag
-  //
-  Status = FindToken (InfFile, ATTRIBUTES_SECTION_STRING, EFI_FV_WEAK_ALIGNMENT_STRING, 0, Value);
-  if (Status == EFI_SUCCESS) {
-    if ((strcmp (Value, TRUE_STRING) == 0) || (strcmp (Value, ONE_STRING) == 0)) {
-      FvInfo->FvAttributes |= EFI_FVB2_WEAK_ALIGNMENT;
-    } else if ((strcmp (Value, FALSE_STRING) != 0) && (strcmp (Value, ZERO_STRING) != 0)) {
-      Error (NULL, 0, 2000, "Invalid parameter", "Weak alignment value expected one of TRUE, FALSE, 1 or 0.");
-      return EFI_ABORTED;
-    }
-  }
+  *Table    = NewTable;
+  *MaxCount = NewMaxCount;
+  return EFI_SUCCESS;
+}
 
-  //
-  // Read block maps
-  //
-  for (Index = 0; Index < MAX_NUMBER_OF_FV_BLOCKS; Index++) {
-    if (FvInfo->FvBlocks[Index].Length == 0) {
-      //
-      // Read block size
-      //
-      Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_BLOCK_SIZE_STRING, Index, Value);
+STATIC
+CHAR8 *
+CopyFileName (
+  IN OUT FILE_NAME_ARENA_BLOCK  **Arena,
+  IN     CHAR8                  *FileName
+  )
+/*++
 
-      if (Status == EFI_SUCCESS) {
-        //
-        // Update the size of block
-        //
-        Status = AsciiStringToUint64 (Value, FALSE, &Value64);
-        if (EFI_ERROR (Status)) {
-          Error (NULL, 0, 2000, "Invalid parameter", "%s = %s", EFI_BLOCK_SIZE_STRING, Value);
-          return EFI_ABORTED;
-        }
+Routine Description:
 
-        FvInfo->FvBlocks[Index].Length = (UINT32) Value64;
-        DebugMsg (NULL, 0, 9, "FV Block Size", "%s = %s", EFI_BLOCK_SIZE_STRING, Value);
-      } else {
-        //
-        // If there is no blocks size, but there is the number of block, then we have a mismatched pair
-        // and should return an error.
-        //
-        Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_NUM_BLOCKS_STRING, Index, Value);
-        if (!EFI_ERROR (Status)) {
-          Error (NULL, 0, 2000, "Invalid parameter", "both %s and %s must be specified.", EFI_NUM_BLOCKS_STRING, EFI_BLOCK_SIZE_STRING);
-          return EFI_ABORTED;
-        } else {
-          //
-          // We are done
-          //
-          break;
-        }
-      }
+  Copy a file name into the name blocks of an FV or capsule. The copy
+  lives until the blocks are released with FreeFileNames.
 
-      //
-      // Read blocks number
-      //
-      Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_NUM_BLOCKS_STRING, Index, Value);
+Arguments:
 
-      if (Status == EFI_SUCCESS) {
-        //
-        // Update the number of blocks
-        //
-        Status = AsciiStringToUint64 (Value, FALSE, &Value64);
-        if (EFI_ERROR (Status)) {
-          Error (NULL, 0, 2000, "Invalid parameter", "%s = %s", EFI_NUM_BLOCKS_STRING, Value);
-          return EFI_ABORTED;
-        }
+  Arena         The list of name blocks, most recent first.
+  FileName      The name to copy.
 
-        FvInfo->FvBlocks[Index].NumBlocks = (UINT32) Value64;
-        DebugMsg (NULL, 0, 9, "FV Block Number", "%s = %s", EFI_NUM_BLOCKS_STRING, Value);
-      }
-    }
-  }
+Returns:
 
-  if (Index == 0) {
-    Error (NULL, 0, 2001, "Missing required argument", "block size.");
-    return EFI_ABORTED;
-  }
+  The copy of the name, or NULL if no block could be allocated.
 
-  //
-  // Read files
-  //
-  Number = 0;
-  for (Number = 0; Number < MAX_NUMBER_OF_FILES_IN_FV; Number ++) {
-    if (FvInfo->FvFiles[Number][0] == '\0') {
-      break;
+--*/
+{
+  FILE_NAME_ARENA_BLOCK   *Block;
+  UINTN                   Length;
+  UINTN                   Size;
+  CHAR8                   *Name;
+
+  Length = strlen (FileName) + 1;
+  Block  = *Arena;
+  if (Block == NULL || Block->Size - Block->Used < Length) {
+    Size = FILE_NAME_ARENA_BLOCK_SIZE;
+    if (Size < Length) {
+      Size = Length;
     }
-  }
-
-  for (Index = 0; Index < MAX_NUMBER_OF_FILES_IN_FV; Index++) {
-    //
-    // Read the FFS file list
-    //
-    Status = FindToken (InfFile, FILES_SECTION_STRING, EFI_FILE_NAME_STRING, Index, Value);
-
-    if (Status == EFI_SUCCESS) {
-      //
-      // Add the file
-      //
-      strcpy (FvInfo->FvFiles[Number + Index], Value);
-      DebugMsg (NULL, 0, 9, "FV component file", "the %uth name is %s", (unsigned) Index, Value);
-    } else {
-      break;
+    Block = (FILE_NAME_ARENA_BLOCK *) malloc (sizeof (FILE_NAME_ARENA_BLOCK) + Size);
+    if (Block == NULL) {
+      return NULL;
     }
+    Block->Next = *Arena;
+    Block->Size = Size;
+    Block->Used = 0;
+    *Arena      = Block;
   }
 
-  if ((Index + Number) == 0) {
-    Warning (NULL, 0, 0, "FV components are not specified.", NULL);
-  }
-
-  return EFI_SUCCESS;
+  Name = (CHAR8 *) (Block + 1) + Block->Used;
+  memcpy (Name, FileName, Length);
+  Block->Used += Length;
+  return Name;
 }
 
+STATIC
 VOID
-UpdateFfsFileState (
-  IN EFI_FFS_FILE_HEADER          *FfsFile,
-  IN EFI_FIRMWARE_VOLUME_HEADER   *FvHeader
+FreeFileNames (
+  IN OUT FILE_NAME_ARENA_BLOCK  **Arena
   )
 /*++
 
 Routine Description:
 
-  This function changes the FFS file attributes based on the erase polarity
-  of the FV. Update the reserved bits of State to EFI_FVB2_ERASE_POLARITY. 
+  Free the name blocks of an FV or capsule.
 
 Arguments:
 
-  FfsFile   File header.
-  FvHeader  FV header.
+  Arena         The list of name blocks.
 
 Returns:
 
@@ -416,1647 +373,3559 @@ Returns:
 
 --*/
 {
-  if (FvHeader->Attributes & EFI_FVB2_ERASE_POLARITY) {
-    FfsFile->State = (UINT8)~(FfsFile->State);
-    // FfsFile->State |= ~(UINT8) EFI_FILE_ALL_STATE_BITS;
+  FILE_NAME_ARENA_BLOCK   *Block;
+
+  while (*Arena != NULL) {
+    Block  = *Arena;
+    *Arena = Block->Next;
+    free (Block);
   }
 }
 
 EFI_STATUS
-ReadFfsAlignment (
-  IN EFI_FFS_FILE_HEADER    *FfsFile,
-  IN OUT UINT32             *Alignment
+AddFvFile (
+  IN OUT FV_INFO              *FvInfo,
+  IN     CHAR8                *FileName,
+  IN     UINT32               FileTakenSize
   )
 /*++
 
 Routine Description:
 
-  This function determines the alignment of the FFS input file from the file
-  attributes.
+  Append a file to the list of files placed in the FV.
 
 Arguments:
 
-  FfsFile       FFS file to parse
-  Alignment     The minimum required alignment offset of the FFS file
+  FvInfo         The FV to add the file to.
+  FileName       The name of the FFS file.
+  FileTakenSize  The space the file takes in the FV, or 0 for its size.
 
 Returns:
 
-  EFI_SUCCESS              The function completed successfully.
-  EFI_INVALID_PARAMETER    One of the input parameters was invalid.
-  EFI_ABORTED              An error occurred.
+  EFI_SUCCESS             The file was added.
+  EFI_OUT_OF_RESOURCES    Could not allocate required resources.
 
 --*/
 {
+  UINTN   MaxFiles;
+  UINTN   MaxSizes;
+  CHAR8   *Name;
+
   //
-  // Verify input parameters.
+  // Both tables have MaxFvFiles entries, which only changes once both grew.
   //
-  if (FfsFile == NULL || Alignment == NULL) {
-    return EFI_INVALID_PARAMETER;
+  MaxFiles = FvInfo->MaxFvFiles;
+  MaxSizes = FvInfo->MaxFvFiles;
+  if (EFI_ERROR (GrowTable ((VOID **) &FvInfo->FvFiles, &MaxFiles, sizeof (CHAR8 *), FvInfo->FvFileCount + 1)) ||
+      EFI_ERROR (GrowTable ((VOID **) &FvInfo->SizeofFvFiles, &MaxSizes, sizeof (UINT32), FvInfo->FvFileCount + 1))) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated for the FV file list.");
+    return EFI_OUT_OF_RESOURCES;
   }
+  FvInfo->MaxFvFiles = MaxFiles;
 
-  switch ((FfsFile->Attributes >> 3) & 0x07) {
+  Name = CopyFileName (&FvInfo->FileNames, FileName);
+  if (Name == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated for the FV file list.");
+    return EFI_OUT_OF_RESOURCES;
+  }
 
-  case 0:
-    //
-    // 1 byte alignment
-    //
-    *Alignment = 0;
-    break;
+  FvInfo->FvFiles[FvInfo->FvFileCount]       = Name;
+  FvInfo->SizeofFvFiles[FvInfo->FvFileCount] = FileTakenSize;
+  FvInfo->FvFileCount++;
+  return EFI_SUCCESS;
+}
 
-  case 1:
-    //
-    // 16 byte alignment
-    //
-    *Alignment = 4;
-    break;
+EFI_STATUS
+AddFvFileBuffer (
+  IN OUT FV_INFO              *FvInfo,
+  IN     CHAR8                *FileName,
+  IN     UINT8                *Data,
+  IN     UINTN                Size
+  )
+/*++
 
-  case 2:
-    //
-    // 128 byte alignment
-    //
-    *Alignment = 7;
-    break;
+Routine Description:
 
-  case 3:
-    //
-    // 512 byte alignment
-    //
-    *Alignment = 9;
-    break;
+  Supply the contents of an FFS file in memory. When the FV places a file
+  named FileName, it uses Data instead of reading the file.
 
-  case 4:
-    //
-    // 1K byte alignment
-    //
-    *Alignment = 10;
-    break;
+Arguments:
 
-  case 5:
-    //
-    // 4K byte alignment
-    //
-    *Alignment = 12;
-    break;
+  FvInfo         The FV to add the buffer to.
+  FileName       The name of the FFS file, as listed in the FV.
+  Data           The file contents. They must stay valid until the FV is
+                 generated and are not modified.
+  Size           The size of Data.
 
-  case 6:
-    //
-    // 32K byte alignment
-    //
-    *Alignment = 15;
-    break;
+Returns:
 
-  case 7:
-    //
-    // 64K byte alignment
-    //
-    *Alignment = 16;
-    break;
+  EFI_SUCCESS             The buffer was added.
+  EFI_OUT_OF_RESOURCES    Could not allocate required resources.
 
-  default:
-    break;
+--*/
+{
+  FV_FILE_BUFFER  *Buffer;
+  CHAR8           *Name;
+
+  if (EFI_ERROR (GrowTable ((VOID **) &FvInfo->FvFileBuffers, &FvInfo->MaxFvFileBuffers, sizeof (FV_FILE_BUFFER), FvInfo->FvFileBufferCount + 1))) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated for the FV file buffers.");
+    return EFI_OUT_OF_RESOURCES;
   }
 
+  Name = CopyFileName (&FvInfo->FileNames, FileName);
+  if (Name == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated for the FV file buffers.");
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Buffer       = &FvInfo->FvFileBuffers[FvInfo->FvFileBufferCount++];
+  Buffer->Name = Name;
+  Buffer->Data = Data;
+  Buffer->Size = Size;
   return EFI_SUCCESS;
 }
 
-EFI_STATUS
-AddPadFile (
-  IN OUT MEMORY_FILE  *FvImage,
-  IN UINT32           DataAlignment,
-  IN VOID             *FvEnd,
-  IN EFI_FIRMWARE_VOLUME_EXT_HEADER *ExtHeader,
-  IN UINT32           NextFfsSize
+EFI_FV_BLOCK_MAP_ENTRY *
+GetFvBlockMapEntry (
+  IN OUT FV_INFO              *FvInfo,
+  IN     UINTN                Index
   )
 /*++
 
 Routine Description:
 
-  This function adds a pad file to the FV image if it required to align the
-  data of the next file.
+  Get an entry of the FV block map, growing the map as needed. New entries
+  are zero, and the map always keeps a zero entry after Index.
 
 Arguments:
 
-  FvImage         The memory image of the FV to add it to.
-                  The current offset must be valid.
-  DataAlignment   The data alignment of the next FFS file.
-  FvEnd           End of the empty data in FvImage.
-  ExtHeader       PI FvExtHeader Optional 
+  FvInfo         The FV owning the block map.
+  Index          The block map entry.
 
 Returns:
 
-  EFI_SUCCESS              The function completed successfully.
-  EFI_INVALID_PARAMETER    One of the input parameters was invalid.
-  EFI_OUT_OF_RESOURCES     Insufficient resources exist in the FV to complete
-                           the pad file add.
+  A pointer to the entry, or NULL if the map could not be grown.
 
 --*/
 {
-  EFI_FFS_FILE_HEADER *PadFile;
-  UINTN               PadFileSize;
-  UINT32              NextFfsHeaderSize;
-  UINT32              CurFfsHeaderSize;
-
-  CurFfsHeaderSize = sizeof (EFI_FFS_FILE_HEADER);
-  //
-  // Verify input parameters.
-  //
-  if (FvImage == NULL) {
-    return EFI_INVALID_PARAMETER;
+  if (EFI_ERROR (GrowTable ((VOID **) &FvInfo->FvBlocks, &FvInfo->MaxFvBlocks, sizeof (EFI_FV_BLOCK_MAP_ENTRY), Index + 2))) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated for the FV block map.");
+    return NULL;
   }
+  return &FvInfo->FvBlocks[Index];
+}
 
-  //
-  // Calculate the pad file size
-  //
+EFI_STATUS
+AddCapFile (
+  IN OUT CAP_INFO             *CapInfo,
+  IN     CHAR8                *FileName
+  )
+/*++
 
-  //
-  // Append extension header size
-  //
-  if (ExtHeader != NULL) {
-    PadFileSize = ExtHeader->ExtHeaderSize;
-    if (PadFileSize + sizeof (EFI_FFS_FILE_HEADER) >= MAX_FFS_SIZE) {
-      CurFfsHeaderSize = sizeof (EFI_FFS_FILE_HEADER2);
-    }
-    PadFileSize += CurFfsHeaderSize;
-  } else {
-    NextFfsHeaderSize = sizeof (EFI_FFS_FILE_HEADER);
-    if (NextFfsSize >= MAX_FFS_SIZE) {
-      NextFfsHeaderSize = sizeof (EFI_FFS_FILE_HEADER2);
-    }
-    //
-    // Check if a pad file is necessary
-    //
-    if (((UINTN) FvImage->CurrentFilePointer - (UINTN) FvImage->FileImage + NextFfsHeaderSize) % DataAlignment == 0) {
-      return EFI_SUCCESS;
-    }
-    PadFileSize = (UINTN) FvImage->CurrentFilePointer - (UINTN) FvImage->FileImage + sizeof (EFI_FFS_FILE_HEADER) + NextFfsHeaderSize;
-    //
-    // Add whatever it takes to get to the next aligned address
-    //
-    while ((PadFileSize % DataAlignment) != 0) {
-      PadFileSize++;
-    }
-    //
-    // Subtract the next file header size
-    //
-    PadFileSize -= NextFfsHeaderSize;
-    //
-    // Subtract the starting offset to get size
-    //
-    PadFileSize -= (UINTN) FvImage->CurrentFilePointer - (UINTN) FvImage->FileImage;
+Routine Description:
+
+  Append a file to the list of files placed in the capsule.
+
+Arguments:
+
+  CapInfo        The capsule to add the file to.
+  FileName       The name of the file.
+
+Returns:
+
+  EFI_SUCCESS             The file was added.
+  EFI_OUT_OF_RESOURCES    Could not allocate required resources.
+
+--*/
+{
+  CHAR8   *Name;
+
+  if (EFI_ERROR (GrowTable ((VOID **) &CapInfo->CapFiles, &CapInfo->MaxCapFiles, sizeof (CHAR8 *), CapInfo->CapFileCount + 1))) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated for the capsule file list.");
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  //
-  // Verify that we have enough space for the file header
-  //
-  if (((UINTN) FvImage->CurrentFilePointer + PadFileSize) > (UINTN) FvEnd) {
+  Name = CopyFileName (&CapInfo->FileNames, FileName);
+  if (Name == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated for the capsule file list.");
     return EFI_OUT_OF_RESOURCES;
   }
 
-  //
-  // Write pad file header
-  //
-  PadFile = (EFI_FFS_FILE_HEADER *) FvImage->CurrentFilePointer;
+  CapInfo->CapFiles[CapInfo->CapFileCount++] = Name;
+  return EFI_SUCCESS;
+}
 
-  //
-  // Write PadFile FFS header with PadType, don't need to set PAD file guid in its header.
-  //
-  PadFile->Type       = EFI_FV_FILETYPE_FFS_PAD;
-  PadFile->Attributes = 0;
+VOID
+ReleaseFvInfo (
+  IN OUT FV_INFO              *FvInfo
+  )
+/*++
 
-  //
-  // Write pad file size (calculated size minus next file header size)
-  //
-  if (PadFileSize >= MAX_FFS_SIZE) {
-    memset(PadFile->Size, 0, sizeof(UINT8) * 3);
-    ((EFI_FFS_FILE_HEADER2 *)PadFile)->ExtendedSize = PadFileSize;
-    PadFile->Attributes |= FFS_ATTRIB_LARGE_FILE;
-  } else {
-    PadFile->Size[0]  = (UINT8) (PadFileSize & 0xFF);
-    PadFile->Size[1]  = (UINT8) ((PadFileSize >> 8) & 0xFF);
-    PadFile->Size[2]  = (UINT8) ((PadFileSize >> 16) & 0xFF);
-  }
+Routine Description:
 
-  //
-  // Fill in checksums and state, they must be 0 for checksumming.
-  //
-  PadFile->IntegrityCheck.Checksum.Header = 0;
-  PadFile->IntegrityCheck.Checksum.File   = 0;
-  PadFile->State                          = 0;
-  PadFile->IntegrityCheck.Checksum.Header = CalculateChecksum8 ((UINT8 *) PadFile, CurFfsHeaderSize);
-  PadFile->IntegrityCheck.Checksum.File   = FFS_FIXED_CHECKSUM;
+  Free the tables of an FV_INFO. The file list, file buffers and block map
+  are empty afterwards.
 
-  PadFile->State = EFI_FILE_HEADER_CONSTRUCTION | EFI_FILE_HEADER_VALID | EFI_FILE_DATA_VALID;
-  UpdateFfsFileState (
-    (EFI_FFS_FILE_HEADER *) PadFile,
-    (EFI_FIRMWARE_VOLUME_HEADER *) FvImage->FileImage
-    );
+Arguments:
 
-  //
-  // Update the current FV pointer
-  //
-  FvImage->CurrentFilePointer += PadFileSize;
+  FvInfo         The FV information to release.
 
-  if (ExtHeader != NULL) {
-    //
-    // Copy Fv Extension Header and Set Fv Extension header offset
-    //
-    memcpy ((UINT8 *)PadFile + CurFfsHeaderSize, ExtHeader, ExtHeader->ExtHeaderSize);
-    ((EFI_FIRMWARE_VOLUME_HEADER *) FvImage->FileImage)->ExtHeaderOffset = (UINT16) ((UINTN) ((UINT8 *)PadFile + CurFfsHeaderSize) - (UINTN) FvImage->FileImage);
-	  //
-	  // Make next file start at QWord Boundry
-	  //
-	  while (((UINTN) FvImage->CurrentFilePointer & (EFI_FFS_FILE_HEADER_ALIGNMENT - 1)) != 0) {
-	    FvImage->CurrentFilePointer++;
-	  }
+Returns:
+
+  None
+
+--*/
+{
+  if (FvInfo->FvBlocks != NULL) {
+    free (FvInfo->FvBlocks);
+  }
+  if (FvInfo->FvFiles != NULL) {
+    free (FvInfo->FvFiles);
   }
+  if (FvInfo->SizeofFvFiles != NULL) {
+    free (FvInfo->SizeofFvFiles);
+  }
+  if (FvInfo->FvFileBuffers != NULL) {
+    free (FvInfo->FvFileBuffers);
+  }
+  FreeFileNames (&FvInfo->FileNames);
 
-  return EFI_SUCCESS;
+  FvInfo->FvBlocks      = NULL;
+  FvInfo->MaxFvBlocks   = 0;
+  FvInfo->FvFiles       = NULL;
+  FvInfo->SizeofFvFiles = NULL;
+  FvInfo->FvFileCount   = 0;
+  FvInfo->MaxFvFiles    = 0;
+
+  FvInfo->FvFileBuffers     = NULL;
+  FvInfo->FvFileBufferCount = 0;
+  FvInfo->MaxFvFileBuffers  = 0;
 }
 
-BOOLEAN
-IsVtfFile (
-  IN EFI_FFS_FILE_HEADER    *FileBuffer
+VOID
+ReleaseCapInfo (
+  IN OUT CAP_INFO             *CapInfo
   )
 /*++
 
 Routine Description:
 
-  This function checks the header to validate if it is a VTF file
+  Free the tables of a CAP_INFO. The file list is empty afterwards.
 
 Arguments:
 
-  FileBuffer     Buffer in which content of a file has been read.
+  CapInfo        The capsule information to release.
 
 Returns:
 
-  TRUE    If this is a VTF file
-  FALSE   If this is not a VTF file
+  None
 
 --*/
 {
-  if (!memcmp (&FileBuffer->Name, &mEfiFirmwareVolumeTopFileGuid, sizeof (EFI_GUID))) {
-    return TRUE;
-  } else {
-    return FALSE;
+  if (CapInfo->CapFiles != NULL) {
+    free (CapInfo->CapFiles);
   }
+  FreeFileNames (&CapInfo->FileNames);
+
+  CapInfo->CapFiles     = NULL;
+  CapInfo->CapFileCount = 0;
+  CapInfo->MaxCapFiles  = 0;
 }
 
+STATIC
 EFI_STATUS
-WriteMapFile (
-  IN OUT FILE                  *FvMapFile,
-  IN     CHAR8                 *FileName,
-  IN     EFI_FFS_FILE_HEADER   *FfsFile, 
-  IN     EFI_PHYSICAL_ADDRESS  ImageBaseAddress,
-  IN     PE_COFF_LOADER_IMAGE_CONTEXT *pImageContext
+AllocateFvFileTables (
+  IN UINTN    FileCount
   )
 /*++
 
 Routine Description:
 
-  This function gets the basic debug information (entrypoint, baseaddress, .text, .data section base address)
-  from PE/COFF image and abstracts Pe Map file information and add them into FvMap file for Debug.
+  Allocate the per file tables used while the FV is built.
 
 Arguments:
 
-  FvMapFile             A pointer to FvMap File
-  FileName              Ffs File PathName
-  FfsFile               A pointer to Ffs file image.
-  ImageBaseAddress      PeImage Base Address.
-  pImageContext         Image Context Information.
+  FileCount     The number of files in the FV.
 
 Returns:
 
-  EFI_SUCCESS           Added required map information.
+  EFI_SUCCESS              The tables are allocated.
+  EFI_OUT_OF_RESOURCES     Insufficient resources exist to allocate them.
 
 --*/
 {
-  CHAR8                               PeMapFileName [_MAX_PATH];
-  CHAR8                               *Cptr, *Cptr2;
-  CHAR8                               FileGuidName [MAX_LINE_LEN];
-  FILE                                *PeMapFile;
-  CHAR8                               Line [MAX_LINE_LEN];
-  CHAR8                               KeyWord [MAX_LINE_LEN];
-  CHAR8                               FunctionName [MAX_LINE_LEN];
-  EFI_PHYSICAL_ADDRESS                FunctionAddress;
-  UINT32                              FunctionType;
-  CHAR8                               FunctionTypeName [MAX_LINE_LEN];
-  UINT32                              Index;
-  UINT32                              AddressOfEntryPoint;
-  UINT32                              Offset;
-  EFI_IMAGE_OPTIONAL_HEADER_UNION     *ImgHdr;
-  EFI_TE_IMAGE_HEADER                 *TEImageHeader;
-  EFI_IMAGE_SECTION_HEADER            *SectionHeader;
-  unsigned long long                  TempLongAddress;
-  UINT32                              TextVirtualAddress;
-  UINT32                              DataVirtualAddress;
-  EFI_PHYSICAL_ADDRESS                LinkTimeBaseAddress;
-
-  //
-  // Init local variable
-  //
-  FunctionType = 0;
-  //
-  // Print FileGuid to string buffer. 
-  //
-  PrintGuidToBuffer (&FfsFile->Name, (UINT8 *)FileGuidName, MAX_LINE_LEN, TRUE);
-  
-  //
-  // Construct Map file Name 
-  //
-  strcpy (PeMapFileName, FileName);
-  
-  //
-  // Change '\\' to '/', unified path format.
-  //
-  Cptr = PeMapFileName;
-  while (*Cptr != '\0') {
-    if (*Cptr == '\\') {
-      *Cptr = FILE_SEP_CHAR;
-    }
-    Cptr ++;
-  }
-  
-  //
-  // Get Map file
-  // 
-  Cptr = PeMapFileName + strlen (PeMapFileName);
-  while ((*Cptr != '.') && (Cptr >= PeMapFileName)) {
-    Cptr --;
-  }
-  if (Cptr < PeMapFileName) {
-    return EFI_NOT_FOUND;
-  } else {
-    *(Cptr + 1) = 'm';
-    *(Cptr + 2) = 'a';
-    *(Cptr + 3) = 'p';
-    *(Cptr + 4) = '\0';
+  if (FileCount == 0) {
+    FileCount = 1;
+  }
+  mFileGuidArray  = (EFI_GUID *) calloc (FileCount, sizeof (EFI_GUID));
+  mFvFileImages   = (MAPPED_FILE *) calloc (FileCount, sizeof (MAPPED_FILE));
+  mRebaseJobs     = (FFS_REBASE_JOB *) calloc (FileCount, sizeof (FFS_REBASE_JOB));
+  mFileIsArm      = (BOOLEAN *) calloc (FileCount, sizeof (BOOLEAN));
+  mFileStamps     = (FV_FILE_STAMP *) calloc (FileCount, sizeof (FV_FILE_STAMP));
+  mRebaseJobCount = 0;
+  if (mFileGuidArray == NULL || mFvFileImages == NULL || mRebaseJobs == NULL || mFileIsArm == NULL || mFileStamps == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    return EFI_OUT_OF_RESOURCES;
   }
+  return EFI_SUCCESS;
+}
 
-  //
-  // Get module Name
-  //
-  Cptr2 = Cptr;
-  while ((*Cptr != FILE_SEP_CHAR) && (Cptr >= PeMapFileName)) {
-    Cptr --;
-  }
-	*Cptr2 = '\0';
-	strcpy (KeyWord, Cptr + 1);
-	*Cptr2 = '.';
+STATIC
+VOID
+GetFileStamp (
+  IN  UINT8             *FileImage,
+  IN  UINTN             FileSize,
+  OUT FV_FILE_STAMP     *Stamp
+  )
+/*++
 
-  //
-  // AddressOfEntryPoint and Offset in Image
-  //
-  if (!pImageContext->IsTeImage) {
-  	ImgHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *) ((UINT8 *) pImageContext->Handle + pImageContext->PeCoffHeaderOffset);
-  	AddressOfEntryPoint = ImgHdr->Pe32.OptionalHeader.AddressOfEntryPoint;
-  	Offset = 0;
-    SectionHeader = (EFI_IMAGE_SECTION_HEADER *) (
-                       (UINT8 *) ImgHdr +
-                       sizeof (UINT32) + 
-                       sizeof (EFI_IMAGE_FILE_HEADER) +  
-                       ImgHdr->Pe32.FileHeader.SizeOfOptionalHeader
-                       );
-    Index = ImgHdr->Pe32.FileHeader.NumberOfSections;
-  } else {
-  	TEImageHeader = (EFI_TE_IMAGE_HEADER *) pImageContext->Handle;
-    AddressOfEntryPoint = TEImageHeader->AddressOfEntryPoint;
-    Offset = TEImageHeader->StrippedSize - sizeof (EFI_TE_IMAGE_HEADER);
-    SectionHeader = (EFI_IMAGE_SECTION_HEADER *) (TEImageHeader + 1);
-    Index = TEImageHeader->NumberOfSections;
-  }
+Routine Description:
 
-  //
-  // module information output
-  //
-  if (ImageBaseAddress == 0) {
-    fprintf (FvMapFile, "%s (dummy) (", KeyWord);
-    fprintf (FvMapFile, "BaseAddress=%010llx, ", (unsigned long long) ImageBaseAddress);
-  } else {
-    fprintf (FvMapFile, "%s (Fixed Flash Address, ", KeyWord);
-    fprintf (FvMapFile, "BaseAddress=0x%010llx, ", (unsigned long long) (ImageBaseAddress + Offset));
-  }
+  Get the size and SHA-256 digest of the contents of a file.
 
-  if (FfsFile->Type != EFI_FV_FILETYPE_SECURITY_CORE && pImageContext->Machine == EFI_IMAGE_MACHINE_IA64) {
-    //
-    // Process IPF PLABEL to get the real address after the image has been rebased. 
-    // PLABEL structure is got by AddressOfEntryPoint offset to ImageBuffer stored in pImageContext->Handle.
-    //
-    fprintf (FvMapFile, "EntryPoint=0x%010llx", (unsigned long long) (*(UINT64 *)((UINTN) pImageContext->Handle + (UINTN) AddressOfEntryPoint)));
-  } else {
-    fprintf (FvMapFile, "EntryPoint=0x%010llx", (unsigned long long) (ImageBaseAddress + AddressOfEntryPoint));
-  }
-  fprintf (FvMapFile, ")\n"); 
-  
-  fprintf (FvMapFile, "(GUID=%s", FileGuidName);
-  TextVirtualAddress = 0;
-  DataVirtualAddress = 0;
-  for (; Index > 0; Index --, SectionHeader ++) {
-    if (stricmp ((CHAR8 *)SectionHeader->Name, ".text") == 0) {
-  		TextVirtualAddress = SectionHeader->VirtualAddress;
-  	} else if (stricmp ((CHAR8 *)SectionHeader->Name, ".data") == 0) {
-  	  DataVirtualAddress = SectionHeader->VirtualAddress;
-  	} else if (stricmp ((CHAR8 *)SectionHeader->Name, ".sdata") == 0) {
-  	  DataVirtualAddress = SectionHeader->VirtualAddress;
-  	}
-  }
-  fprintf (FvMapFile, " .textbaseaddress=0x%010llx", (unsigned long long) (ImageBaseAddress + TextVirtualAddress));
-  fprintf (FvMapFile, " .databaseaddress=0x%010llx", (unsigned long long) (ImageBaseAddress + DataVirtualAddress));
-  fprintf (FvMapFile, ")\n\n");
-   
-  //
-  // Open PeMapFile
-  //
-  PeMapFile = fopen (PeMapFileName, "r");
-  if (PeMapFile == NULL) {
-    // fprintf (stdout, "can't open %s file to reading\n", PeMapFileName);
-    return EFI_ABORTED;
-  }
-  VerboseMsg ("The map file is %s", PeMapFileName);
-  
-  //
-  // Output Functions information into Fv Map file
-  //
-  LinkTimeBaseAddress = 0;
-  while (fgets (Line, MAX_LINE_LEN, PeMapFile) != NULL) {
-    //
-    // Skip blank line
-    //
-    if (Line[0] == 0x0a) {
-      FunctionType = 0;
-      continue;
-    }
-    //
-    // By Address and Static keyword
-    //  
-    if (FunctionType == 0) {
-      sscanf (Line, "%s", KeyWord);
-      if (stricmp (KeyWord, "Address") == 0) {
-        //
-        // function list
-        //
-        FunctionType = 1;
-        fgets (Line, MAX_LINE_LEN, PeMapFile);
-      } else if (stricmp (KeyWord, "Static") == 0) {
-        //
-        // static function list
-        //
-        FunctionType = 2;
-        fgets (Line, MAX_LINE_LEN, PeMapFile);
-      } else if (stricmp (KeyWord, "Preferred") ==0) {
-        sscanf (Line + strlen (" Preferred load address is"), "%llx", &TempLongAddress);
-        LinkTimeBaseAddress = (UINT64) TempLongAddress;
-      }
-      continue;
-    }
-    //
-    // Printf Function Information
-    //
-    if (FunctionType == 1) {
-      sscanf (Line, "%s %s %llx %s", KeyWord, FunctionName, &TempLongAddress, FunctionTypeName);
-      FunctionAddress = (UINT64) TempLongAddress;
-      if (FunctionTypeName [1] == '\0' && (FunctionTypeName [0] == 'f' || FunctionTypeName [0] == 'F')) {
-        fprintf (FvMapFile, "  0x%010llx    ", (unsigned long long) (ImageBaseAddress + FunctionAddress - LinkTimeBaseAddress));
-        fprintf (FvMapFile, "%s\n", FunctionName);
-      }
-    } else if (FunctionType == 2) {
-      sscanf (Line, "%s %s %llx %s", KeyWord, FunctionName, &TempLongAddress, FunctionTypeName);
-      FunctionAddress = (UINT64) TempLongAddress;
-      if (FunctionTypeName [1] == '\0' && (FunctionTypeName [0] == 'f' || FunctionTypeName [0] == 'F')) {
-        fprintf (FvMapFile, "  0x%010llx    ", (unsigned long long) (ImageBaseAddress + FunctionAddress - LinkTimeBaseAddress));
-        fprintf (FvMapFile, "%s\n", FunctionName);
-      }
-    }
-  }
-  //
-  // Close PeMap file
-  //
-  fprintf (FvMapFile, "\n\n");
-  fclose (PeMapFile);
-  
-  return EFI_SUCCESS;
+Arguments:
+
+  FileImage     The file contents.
+  FileSize      The file size.
+  Stamp         Receives the stamp.
+
+Returns:
+
+  None
+
+--*/
+{
+  SHA256_CONTEXT  Context;
+
+  Stamp->Size = FileSize;
+  Sha256Init (&Context);
+  Sha256Update (&Context, FileImage, FileSize);
+  Sha256Final (&Context, Stamp->Digest);
 }
 
+STATIC
 EFI_STATUS
-AddFile (
-  IN OUT MEMORY_FILE          *FvImage,
-  IN FV_INFO                  *FvInfo,
-  IN UINTN                    Index,
-  IN OUT EFI_FFS_FILE_HEADER  **VtfFileImage,
-  IN FILE                     *FvMapFile,
-  IN FILE                     *FvReportFile
+GetFvFileImage (
+  IN  FV_INFO   *FvInfo,
+  IN  UINTN     Index,
+  OUT UINT8     **FileImage,
+  OUT UINTN     *FileSize
   )
 /*++
 
 Routine Description:
 
-  This function adds a file to the FV image.  The file will pad to the
-  appropriate alignment if required.
+  Return the contents of an FFS file of the FV, mapping the file on first use.
+  A file supplied with AddFvFileBuffer is copied instead, as the FV build
+  may change the contents.
 
 Arguments:
 
-  FvImage       The memory image of the FV to add it to.  The current offset
-                must be valid.
   FvInfo        Pointer to information about the FV.
-  Index         The file in the FvInfo file list to add.
-  VtfFileImage  A pointer to the VTF file within the FvImage.  If this is equal
-                to the end of the FvImage then no VTF previously found.
-  FvMapFile     Pointer to FvMap File
-  FvReportFile  Pointer to FvReport File
+  Index         The file in the FvInfo file list.
+  FileImage     Receives the file contents. The view is copy-on-write, so
+                changes are not written back to the file.
+  FileSize      Receives the file size.
+
+  For an incremental build the file is stamped when it is mapped, before
+  the FV build changes the view.
 
 Returns:
 
-  EFI_SUCCESS              The function completed successfully.
-  EFI_INVALID_PARAMETER    One of the input parameters was invalid.
-  EFI_ABORTED              An error occurred.
-  EFI_OUT_OF_RESOURCES     Insufficient resources exist to complete the add.
+  EFI_SUCCESS              The file is available.
+  EFI_ABORTED              The file could not be opened or read.
+  EFI_OUT_OF_RESOURCES     Insufficient resources exist to map the file.
 
 --*/
 {
-  FILE                  *NewFile;
-  UINTN                 FileSize;
-  UINT8                 *FileBuffer;
-  UINTN                 NumBytesRead;
-  UINT32                CurrentFileAlignment;
-  EFI_STATUS            Status;
-  UINTN                 Index1;
-  UINT8                 FileGuidString[PRINTED_GUID_BUFFER_SIZE];
-  
-  Index1 = 0;
-  //
-  // Verify input parameters.
-  //
-  if (FvImage == NULL || FvInfo == NULL || FvInfo->FvFiles[Index][0] == 0 || VtfFileImage == NULL) {
-    return EFI_INVALID_PARAMETER;
-  }
-
-  //
-  // Read the file to add
-  //
-  NewFile = fopen (FvInfo->FvFiles[Index], "rb");
+  EFI_STATUS      Status;
+  FV_FILE_BUFFER  *Buffer;
+  UINTN           BufferIndex;
+
+  if (mFvFileImages[Index].Data == NULL) {
+    for (BufferIndex = 0; BufferIndex < FvInfo->FvFileBufferCount; BufferIndex++) {
+      Buffer = &FvInfo->FvFileBuffers[BufferIndex];
+      if (strcmp (Buffer->Name, FvInfo->FvFiles[Index]) == 0) {
+        mFvFileImages[Index].Data = (UINT8 *) malloc (Buffer->Size + 1);
+        if (mFvFileImages[Index].Data == NULL) {
+          Error (NULL, 0, 4001, "Resouce", "memory cannot be allocated!");
+          return EFI_OUT_OF_RESOURCES;
+        }
+        memcpy (mFvFileImages[Index].Data, Buffer->Data, Buffer->Size);
+        mFvFileImages[Index].Size = Buffer->Size;
+        if (FvInfo->Incremental) {
+          GetFileStamp (mFvFileImages[Index].Data, mFvFileImages[Index].Size, &mFileStamps[Index]);
+        }
+        *FileImage = mFvFileImages[Index].Data;
+        *FileSize  = mFvFileImages[Index].Size;
+        return EFI_SUCCESS;
+      }
+    }
 
-  if (NewFile == NULL) {
-    Error (NULL, 0, 0001, "Error opening file", FvInfo->FvFiles[Index]);
-    return EFI_ABORTED;
+    Status = OpenMappedFile (FvInfo->FvFiles[Index], &mFvFileImages[Index]);
+    if (Status == EFI_NOT_FOUND) {
+      Error (NULL, 0, 0001, "Error opening file", FvInfo->FvFiles[Index]);
+      return EFI_ABORTED;
+    } else if (Status == EFI_OUT_OF_RESOURCES) {
+      Error (NULL, 0, 4001, "Resouce", "memory cannot be allocated!");
+      return Status;
+    } else if (EFI_ERROR (Status)) {
+      Error (NULL, 0, 0004, "Error reading file", FvInfo->FvFiles[Index]);
+      return Status;
+    }
+    if (FvInfo->Incremental) {
+      GetFileStamp (mFvFileImages[Index].Data, mFvFileImages[Index].Size, &mFileStamps[Index]);
+    }
   }
 
-  //
-  // Get the file size
-  //
-  FileSize = _filelength (fileno (NewFile));
+  *FileImage = mFvFileImages[Index].Data;
+  *FileSize  = mFvFileImages[Index].Size;
+  return EFI_SUCCESS;
+}
 
-  //
-  // Read the file into a buffer
-  //
-  FileBuffer = malloc (FileSize);
-  if (FileBuffer == NULL) {
-    Error (NULL, 0, 4001, "Resouce", "memory cannot be allocated!");
-    return EFI_OUT_OF_RESOURCES;
-  }
+STATIC
+VOID
+ReleaseFvFileTables (
+  IN UINTN    FileCount
+  )
+/*++
 
-  NumBytesRead = fread (FileBuffer, sizeof (UINT8), FileSize, NewFile);
+Routine Description:
 
-  //
-  // Done with the file, from this point on we will just use the buffer read.
-  //
-  fclose (NewFile);
-  
-  //
-  // Verify read successful
-  //
-  if (NumBytesRead != sizeof (UINT8) * FileSize) {
-    free  (FileBuffer);
-    Error (NULL, 0, 0004, "Error reading file", FvInfo->FvFiles[Index]);
-    return EFI_ABORTED;
-  }
-  
-  //
-  // For None PI Ffs file, directly add them into FvImage.
-  //
-  if (!FvInfo->IsPiFvImage) {
-    memcpy (FvImage->CurrentFilePointer, FileBuffer, FileSize);
-    if (FvInfo->SizeofFvFiles[Index] > FileSize) {
-    	FvImage->CurrentFilePointer += FvInfo->SizeofFvFiles[Index];
-    } else {
-    	FvImage->CurrentFilePointer += FileSize;
-    }
-    goto Done;
-  }
-  
-  //
-  // Verify Ffs file
-  //
-  Status = VerifyFfsFile ((EFI_FFS_FILE_HEADER *)FileBuffer);
-  if (EFI_ERROR (Status)) {
-    free (FileBuffer);
-    Error (NULL, 0, 3000, "Invalid", "%s is not a valid FFS file.", FvInfo->FvFiles[Index]);
-    return EFI_INVALID_PARAMETER;
-  }
+  Unmap all FFS files mapped by GetFvFileImage and free the tables
+  allocated by AllocateFvFileTables.
 
-  //
-  // Verify space exists to add the file
-  //
-  if (FileSize > (UINTN) ((UINTN) *VtfFileImage - (UINTN) FvImage->CurrentFilePointer)) {
-    free (FileBuffer);
-    Error (NULL, 0, 4002, "Resource", "FV space is full, not enough room to add file %s.", FvInfo->FvFiles[Index]);
-    return EFI_OUT_OF_RESOURCES;
-  }
+Arguments:
 
-  //
-  // Verify the input file is the duplicated file in this Fv image
-  //
-  for (Index1 = 0; Index1 < Index; Index1 ++) {
-    if (CompareGuid ((EFI_GUID *) FileBuffer, &mFileGuidArray [Index1]) == 0) {
-      Error (NULL, 0, 2000, "Invalid parameter", "the %dth file and %uth file have the same file GUID.", (unsigned) Index1 + 1, (unsigned) Index + 1);
-      PrintGuid ((EFI_GUID *) FileBuffer);
-      return EFI_INVALID_PARAMETER;
-    }
-  }
-  CopyMem (&mFileGuidArray [Index], FileBuffer, sizeof (EFI_GUID));
+  FileCount     The number of files in the FV.
 
-  //
-  // Update the file state based on polarity of the FV.
-  //
-  UpdateFfsFileState (
-    (EFI_FFS_FILE_HEADER *) FileBuffer,
-    (EFI_FIRMWARE_VOLUME_HEADER *) FvImage->FileImage
-    );
+Returns:
 
-  //
-  // Check if alignment is required
-  //
-  ReadFfsAlignment ((EFI_FFS_FILE_HEADER *) FileBuffer, &CurrentFileAlignment);
-  
-  //
-  // Find the largest alignment of all the FFS files in the FV
-  //
-  if (CurrentFileAlignment > MaxFfsAlignment) {
-    MaxFfsAlignment = CurrentFileAlignment;
-  }
-  //
-  // If we have a VTF file, add it at the top.
-  //
-  if (IsVtfFile ((EFI_FFS_FILE_HEADER *) FileBuffer)) {
-    if ((UINTN) *VtfFileImage == (UINTN) FvImage->Eof) {
-      //
-      // No previous VTF, add this one.
-      //
-      *VtfFileImage = (EFI_FFS_FILE_HEADER *) (UINTN) ((UINTN) FvImage->FileImage + FvInfo->Size - FileSize);
-      //
-      // Sanity check. The file MUST align appropriately
-      //
-      if (((UINTN) *VtfFileImage + GetFfsHeaderLength((EFI_FFS_FILE_HEADER *)FileBuffer) - (UINTN) FvImage->FileImage) % (1 << CurrentFileAlignment)) {
-        Error (NULL, 0, 3000, "Invalid", "VTF file cannot be aligned on a %u-byte boundary.", (unsigned) (1 << CurrentFileAlignment));
-        free (FileBuffer);
-        return EFI_ABORTED;
-      }
-      //
-      // Rebase the PE or TE image in FileBuffer of FFS file for XIP 
-      // Rebase for the debug genfvmap tool
-      //
-      Status = FfsRebase (FvInfo, FvInfo->FvFiles[Index], (EFI_FFS_FILE_HEADER *) FileBuffer, (UINTN) *VtfFileImage - (UINTN) FvImage->FileImage, FvMapFile);
-      if (EFI_ERROR (Status)) {
-        Error (NULL, 0, 3000, "Invalid", "Could not rebase %s.", FvInfo->FvFiles[Index]);
-        return Status;
-      }	  
-      //
-      // copy VTF File
-      //
-      memcpy (*VtfFileImage, FileBuffer, FileSize);
-      
-      PrintGuidToBuffer ((EFI_GUID *) FileBuffer, FileGuidString, sizeof (FileGuidString), TRUE); 
-      fprintf (FvReportFile, "0x%08X %s\n", (unsigned)(UINTN) (((UINT8 *)*VtfFileImage) - (UINTN)FvImage->FileImage), FileGuidString);
+  None
 
-      free (FileBuffer);
-      DebugMsg (NULL, 0, 9, "Add VTF FFS file in FV image", NULL);
-      return EFI_SUCCESS;
-    } else {
-      //
-      // Already found a VTF file.
-      //
-      Error (NULL, 0, 3000, "Invalid", "multiple VTF files are not permitted within a single FV.");
-      free (FileBuffer);
-      return EFI_ABORTED;
+--*/
+{
+  UINTN Index;
+
+  if (mFvFileImages != NULL) {
+    for (Index = 0; Index < FileCount; Index++) {
+      CloseMappedFile (&mFvFileImages[Index], FALSE);
     }
+    free (mFvFileImages);
+    mFvFileImages = NULL;
   }
-
-  //
-  // Add pad file if necessary
-  //
-  Status = AddPadFile (FvImage, 1 << CurrentFileAlignment, *VtfFileImage, NULL, FileSize);
-  if (EFI_ERROR (Status)) {
-    Error (NULL, 0, 4002, "Resource", "FV space is full, could not add pad file for data alignment property.");
-    free (FileBuffer);
-    return EFI_ABORTED;
+  if (mFileGuidArray != NULL) {
+    free (mFileGuidArray);
+    mFileGuidArray = NULL;
   }
-  //
-  // Add file
-  //
-  if ((UINTN) (FvImage->CurrentFilePointer + FileSize) <= (UINTN) (*VtfFileImage)) {
-    //
-    // Rebase the PE or TE image in FileBuffer of FFS file for XIP. 
-    // Rebase Bs and Rt drivers for the debug genfvmap tool.
-    //
-    Status = FfsRebase (FvInfo, FvInfo->FvFiles[Index], (EFI_FFS_FILE_HEADER *) FileBuffer, (UINTN) FvImage->CurrentFilePointer - (UINTN) FvImage->FileImage, FvMapFile);
-	if (EFI_ERROR (Status)) {
-	  Error (NULL, 0, 3000, "Invalid", "Could not rebase %s.", FvInfo->FvFiles[Index]);
-	  return Status;
-	}	  	
-    //
-    // Copy the file
-    //
-    memcpy (FvImage->CurrentFilePointer, FileBuffer, FileSize);
-    PrintGuidToBuffer ((EFI_GUID *) FileBuffer, FileGuidString, sizeof (FileGuidString), TRUE); 
-    fprintf (FvReportFile, "0x%08X %s\n", (unsigned) (FvImage->CurrentFilePointer - FvImage->FileImage), FileGuidString);
-    FvImage->CurrentFilePointer += FileSize;
-  } else {
-    Error (NULL, 0, 4002, "Resource", "FV space is full, cannot add file %s.", FvInfo->FvFiles[Index]);
-    free (FileBuffer);
-    return EFI_ABORTED;
+  if (mRebaseJobs != NULL) {
+    for (Index = 0; Index < mRebaseJobCount; Index++) {
+      if (mRebaseJobs[Index].MapFile != NULL) {
+        fclose (mRebaseJobs[Index].MapFile);
+      }
+      if (mRebaseJobs[Index].Messages != NULL) {
+        free (mRebaseJobs[Index].Messages);
+      }
+    }
+    free (mRebaseJobs);
+    mRebaseJobs = NULL;
   }
-  //
-  // Make next file start at QWord Boundry
-  //
-  while (((UINTN) FvImage->CurrentFilePointer & (EFI_FFS_FILE_HEADER_ALIGNMENT - 1)) != 0) {
-    FvImage->CurrentFilePointer++;
+  if (mFileIsArm != NULL) {
+    free (mFileIsArm);
+    mFileIsArm = NULL;
   }
-
-Done: 
-  //
-  // Free allocated memory.
-  //
-  free (FileBuffer);
-
-  return EFI_SUCCESS;
+  if (mFileStamps != NULL) {
+    free (mFileStamps);
+    mFileStamps = NULL;
+  }
+  mRebaseJobCount = 0;
 }
 
-EFI_STATUS
-PadFvImage (
-  IN MEMORY_FILE          *FvImage,
-  IN EFI_FFS_FILE_HEADER  *VtfFileImage
+STATIC
+BOOLEAN
+IsFvRebaseRequired (
+  IN FV_INFO                  *FvInfo
   )
 /*++
 
 Routine Description:
 
-  This function places a pad file between the last file in the FV and the VTF
-  file if the VTF file exists.
+  Check whether the files of the FV are rebased, using the same conditions
+  as FfsRebase.
 
 Arguments:
 
-  FvImage       Memory file for the FV memory image
-  VtfFileImage  The address of the VTF file.  If this is the end of the FV
-                image, no VTF exists and no pad file is needed.
+  FvInfo        Pointer to information about the FV.
 
 Returns:
 
-  EFI_SUCCESS             Completed successfully.
-  EFI_INVALID_PARAMETER   One of the input parameters was NULL.
+  TRUE          The files are rebased.
+  FALSE         FfsRebase leaves the files unchanged.
 
 --*/
 {
-  EFI_FFS_FILE_HEADER *PadFile;
-  UINTN               FileSize;
-  UINT32              FfsHeaderSize;
-
-  //
-  // If there is no VTF or the VTF naturally follows the previous file without a
-  // pad file, then there's nothing to do
-  //
-  if ((UINTN) VtfFileImage == (UINTN) FvImage->Eof || \
-      ((UINTN) VtfFileImage == (UINTN) FvImage->CurrentFilePointer)) {
-    return EFI_SUCCESS;
+  if ((FvInfo->BaseAddress == 0) && (FvInfo->ForceRebase == -1)) {
+    return FALSE;
   }
+  return (BOOLEAN) (FvInfo->ForceRebase != 0);
+}
 
-  if ((UINTN) VtfFileImage < (UINTN) FvImage->CurrentFilePointer) {
-    return EFI_INVALID_PARAMETER;
-  }
+STATIC
+EFI_STATUS
+AddRebaseJob (
+  IN FV_INFO                  *FvInfo,
+  IN UINTN                    Index,
+  IN EFI_FFS_FILE_HEADER      *FfsFile,
+  IN UINTN                    XipOffset
+  )
+/*++
 
-  //
-  // Pad file starts at beginning of free space
-  //
-  PadFile = (EFI_FFS_FILE_HEADER *) FvImage->CurrentFilePointer;
+Routine Description:
 
-  //
-  // write PadFile FFS header with PadType, don't need to set PAD file guid in its header. 
-  //
-  PadFile->Type       = EFI_FV_FILETYPE_FFS_PAD;
-  PadFile->Attributes = 0;
+  Record that a file placed in the FV image must be rebased. The child FV
+  base addresses of an FV image file are recorded here so that they keep
+  the order of the files in the FV.
 
-  //
-  // FileSize includes the EFI_FFS_FILE_HEADER
-  //
-  FileSize          = (UINTN) VtfFileImage - (UINTN) FvImage->CurrentFilePointer;
-  if (FileSize >= MAX_FFS_SIZE) {
-    PadFile->Attributes |= FFS_ATTRIB_LARGE_FILE;
-    memset(PadFile->Size, 0, sizeof(UINT8) * 3);
-    ((EFI_FFS_FILE_HEADER2 *)PadFile)->ExtendedSize = FileSize;
-    FfsHeaderSize = sizeof(EFI_FFS_FILE_HEADER2);
-    mIsLargeFfs = TRUE;
-  } else {
-    PadFile->Size[0]  = (UINT8) (FileSize & 0x000000FF);
-    PadFile->Size[1]  = (UINT8) ((FileSize & 0x0000FF00) >> 8);
-    PadFile->Size[2]  = (UINT8) ((FileSize & 0x00FF0000) >> 16);
-    FfsHeaderSize = sizeof(EFI_FFS_FILE_HEADER);
-  }
+Arguments:
 
-  //
-  // Fill in checksums and state, must be zero during checksum calculation.
-  //
-  PadFile->IntegrityCheck.Checksum.Header = 0;
-  PadFile->IntegrityCheck.Checksum.File   = 0;
-  PadFile->State                          = 0;
-  PadFile->IntegrityCheck.Checksum.Header = CalculateChecksum8 ((UINT8 *) PadFile, FfsHeaderSize);
-  PadFile->IntegrityCheck.Checksum.File   = FFS_FIXED_CHECKSUM;
+  FvInfo        Pointer to information about the FV.
+  Index         The file in the FvInfo file list.
+  FfsFile       The file copied into the FV image.
+  XipOffset     The offset of the file from the FV base.
 
-  PadFile->State = EFI_FILE_HEADER_CONSTRUCTION | EFI_FILE_HEADER_VALID | EFI_FILE_DATA_VALID;
+Returns:
 
-  UpdateFfsFileState (
-    (EFI_FFS_FILE_HEADER *) PadFile,
-    (EFI_FIRMWARE_VOLUME_HEADER *) FvImage->FileImage
-    );
-  //
-  // Update the current FV pointer
-  //
-  FvImage->CurrentFilePointer = FvImage->Eof;
+  EFI_SUCCESS              The rebase is recorded or not needed.
+  EFI_OUT_OF_RESOURCES     Insufficient resources exist to record a child FV.
+
+--*/
+{
+  EFI_STATUS      Status;
+  FFS_REBASE_JOB  *Job;
+
+  if (!IsFvRebaseRequired (FvInfo)) {
+    return EFI_SUCCESS;
+  }
+
+  if (FfsFile->Type == EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE) {
+    Status = GetChildFvFromFfs (FvInfo, FfsFile, XipOffset);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
 
+  Job = &mRebaseJobs[mRebaseJobCount++];
+  memset (Job, 0, sizeof (FFS_REBASE_JOB));
+  Job->Index     = Index;
+  Job->FileName  = FvInfo->FvFiles[Index];
+  Job->FfsFile   = FfsFile;
+  Job->XipOffset = XipOffset;
   return EFI_SUCCESS;
 }
 
-EFI_STATUS
-UpdateResetVector (
-  IN MEMORY_FILE            *FvImage,
-  IN FV_INFO                *FvInfo,
-  IN EFI_FFS_FILE_HEADER    *VtfFile
+STATIC
+VOID
+RunRebaseJob (
+  IN VOID     *Context,
+  IN UINTN    JobIndex
   )
 /*++
 
 Routine Description:
 
-  This parses the FV looking for the PEI core and then plugs the address into
-  the SALE_ENTRY point of the BSF/VTF for IPF and does BUGBUG TBD action to
-  complete an IA32 Bootstrap FV.
+  Worker pool routine rebasing one file. Its map file entries are kept in
+  the temporary file of the job and its messages in the job until all files
+  are rebased.
 
 Arguments:
 
-  FvImage       Memory file for the FV memory image
-  FvInfo        Information read from INF file.
-  VtfFile       Pointer to the VTF file in the FV image.
+  Context       Pointer to information about the FV.
+  JobIndex      The job in mRebaseJobs.
 
 Returns:
 
-  EFI_SUCCESS             Function Completed successfully.
-  EFI_ABORTED             Error encountered.
-  EFI_INVALID_PARAMETER   A required parameter was NULL.
-  EFI_NOT_FOUND           PEI Core file not found.
+  None
 
 --*/
 {
-  EFI_FFS_FILE_HEADER       *PeiCoreFile;
-  EFI_FFS_FILE_HEADER       *SecCoreFile;
-  EFI_STATUS                Status;
-  EFI_FILE_SECTION_POINTER  Pe32Section;
-  UINT32                    EntryPoint;
-  UINT32                    BaseOfCode;
-  UINT16                    MachineType;
-  EFI_PHYSICAL_ADDRESS      PeiCorePhysicalAddress;
-  EFI_PHYSICAL_ADDRESS      SecCorePhysicalAddress;
-  EFI_PHYSICAL_ADDRESS      *SecCoreEntryAddressPtr;
-  INT32                     Ia32SecEntryOffset;
-  UINT32                    *Ia32ResetAddressPtr;
-  UINT8                     *BytePointer;
-  UINT8                     *BytePointer2;
-  UINT16                    *WordPointer;
-  UINT16                    CheckSum;
-  UINT32                    IpiVector;
-  UINTN                     Index;
-  EFI_FFS_FILE_STATE        SavedState;
-  UINT64                    FitAddress;
-  FIT_TABLE                 *FitTablePtr;
-  BOOLEAN                   Vtf0Detected;
-  UINT32                    FfsHeaderSize;
-  UINT32                    SecHeaderSize;
+  FFS_REBASE_JOB  *Job;
 
-  //
-  // Verify input parameters
-  //
-  if (FvImage == NULL || FvInfo == NULL || VtfFile == NULL) {
-    return EFI_INVALID_PARAMETER;
+  Job = &mRebaseJobs[JobIndex];
+  if (Job->MapFile == NULL) {
+    return;
+  }
+  Job->Status = RebaseFfsFile ((FV_INFO *) Context, Job->FileName, Job->FfsFile, Job->XipOffset, Job->MapFile, &Job->IsArm, Job);
+  Job->Done   = TRUE;
+}
+
+STATIC
+EFI_STATUS
+RebaseFvFiles (
+  IN FV_INFO                  *FvInfo,
+  IN FILE                     *FvMapFile
+  )
+/*++
+
+Routine Description:
+
+  Rebase all files recorded by AddRebaseJob. The files do not overlap in
+  the FV image, so with more than one thread they are rebased in parallel.
+  The map file entries and messages are then reported in the order of the
+  files in the FV, so the output does not depend on the thread count.
+
+Arguments:
+
+  FvInfo        Pointer to information about the FV.
+  FvMapFile     Pointer to FvMap File, or NULL to leave the map file entries
+                of each job in its MapFile. The jobs are then kept for the
+                caller, and ReleaseFvFileTables closes their files.
+
+Returns:
+
+  EFI_SUCCESS              All files were rebased.
+  Other                    The error returned by FfsRebase for the first file
+                           that could not be rebased.
+
+--*/
+{
+  EFI_STATUS          Status;
+  FFS_REBASE_JOB      *Job;
+  FFS_REBASE_MESSAGE  *Message;
+  UINTN               ThreadCount;
+  UINTN               Index;
+  UINTN               MessageIndex;
+  UINTN               Length;
+  CHAR8               Buffer[0x1000];
+
+  ThreadCount = mFvRebaseThreadCount;
+  if (ThreadCount == 0) {
+    ThreadCount = GetProcessorCount ();
   }
-  //
-  // Initialize FV library
-  //
-  InitializeFvLib (FvImage->FileImage, FvInfo->Size);
 
   //
-  // Verify VTF file
+  // Each job run in parallel writes its map entries to its own temporary
+  // file. A job without one is rebased below, in order.
   //
-  Status = VerifyFfsFile (VtfFile);
-  if (EFI_ERROR (Status)) {
-    return EFI_INVALID_PARAMETER;
+  if ((ThreadCount > 1 && mRebaseJobCount > 1) || FvMapFile == NULL) {
+    for (Index = 0; Index < mRebaseJobCount; Index++) {
+      mRebaseJobs[Index].MapFile = tmpfile ();
+      if (mRebaseJobs[Index].MapFile == NULL && FvMapFile == NULL) {
+        Error (NULL, 0, 4001, "Resource", "cannot create a temporary map file.");
+        return EFI_OUT_OF_RESOURCES;
+      }
+    }
+    if (ThreadCount > 1 && mRebaseJobCount > 1) {
+      RunWorkerPool (mRebaseJobCount, ThreadCount, RunRebaseJob, FvInfo);
+    }
   }
 
-  if (
-      (((UINTN)FvImage->Eof - (UINTN)FvImage->FileImage) >=
-        IA32_X64_VTF_SIGNATURE_OFFSET) &&
-      (*(UINT32 *)(VOID*)((UINTN) FvImage->Eof -
-                                  IA32_X64_VTF_SIGNATURE_OFFSET) ==
-        IA32_X64_VTF0_SIGNATURE)
-     ) {
-    Vtf0Detected = TRUE;
-  } else {
-    Vtf0Detected = FALSE;
+  Status = EFI_SUCCESS;
+  for (Index = 0; Index < mRebaseJobCount; Index++) {
+    Job = &mRebaseJobs[Index];
+    if (!EFI_ERROR (Status)) {
+      if (!Job->Done) {
+        Job->Status = FfsRebase (FvInfo, Job->FileName, Job->FfsFile, Job->XipOffset, Job->MapFile != NULL ? Job->MapFile : FvMapFile, &Job->IsArm);
+      } else if (FvMapFile != NULL) {
+        rewind (Job->MapFile);
+        while ((Length = fread (Buffer, 1, sizeof (Buffer), Job->MapFile)) != 0) {
+          fwrite (Buffer, 1, Length, FvMapFile);
+        }
+      }
+      for (MessageIndex = 0; MessageIndex < Job->MessageCount; MessageIndex++) {
+        Message = &Job->Messages[MessageIndex];
+        if (Message->Type == FFS_REBASE_ERROR) {
+          Error (NULL, 0, (UINT32) Message->Code, Message->Text, "%s", Message->Message);
+        } else if (Message->Type == FFS_REBASE_WARNING) {
+          Warning (NULL, 0, (UINT32) Message->Code, Message->Text, "%s", Message->Message);
+        } else {
+          DebugMsg (NULL, 0, Message->Code, Message->Text, "%s", Message->Message);
+        }
+      }
+      if (EFI_ERROR (Job->Status)) {
+        Error (NULL, 0, 3000, "Invalid", "Could not rebase %s.", Job->FileName);
+        Status = Job->Status;
+      }
+      if (Job->IsArm) {
+        mArm = TRUE;
+        mFileIsArm[Job->Index] = TRUE;
+      }
+    }
+    if (Job->MapFile != NULL && FvMapFile != NULL) {
+      fclose (Job->MapFile);
+    }
+    if (Job->Messages != NULL) {
+      free (Job->Messages);
+      Job->Messages        = NULL;
+      Job->MessageCount    = 0;
+      Job->MaxMessageCount = 0;
+    }
+  }
+
+  if (FvMapFile != NULL) {
+    mRebaseJobCount = 0;
   }
+  return Status;
+}
+
+EFI_STATUS
+ParseFvInf (
+  IN  MEMORY_FILE  *InfFile,
+  OUT FV_INFO      *FvInfo
+  )
+/*++
+
+Routine Description:
+
+  This function parses a FV.INF file and copies info into a FV_INFO structure.
+
+Arguments:
+
+  InfFile         Memory file image.
+  FvInfo          Information read from INF file.
+
+Returns:
+
+  EFI_SUCCESS       INF file information successfully retrieved.
+  EFI_ABORTED       INF file has an invalid format.
+  EFI_NOT_FOUND     A required string was not found in the INF file.
+--*/
+{
+  CHAR8                   Value[_MAX_PATH];
+  UINT64                  Value64;
+  UINTN                   Index;
+  EFI_STATUS              Status;
+  EFI_GUID                GuidValue;
+  EFI_FV_BLOCK_MAP_ENTRY  *BlockMapEntry;
 
   //
-  // Find the Sec Core
+  // Read the FV base address
   //
-  Status = GetFileByType (EFI_FV_FILETYPE_SECURITY_CORE, 1, &SecCoreFile);
-  if (EFI_ERROR (Status) || SecCoreFile == NULL) {
-    if (Vtf0Detected) {
+  if (!mFvDataInfo.BaseAddressSet) {
+    Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_FV_BASE_ADDRESS_STRING, 0, Value);
+    if (Status == EFI_SUCCESS) {
       //
-      // If the SEC core file is not found, but the VTF-0 signature
-      // is found, we'll treat it as a VTF-0 'Volume Top File'.
-      // This means no modifications are required to the VTF.
+      // Get the base address
       //
-      return EFI_SUCCESS;
-    }
+      Status = AsciiStringToUint64 (Value, FALSE, &Value64);
+      if (EFI_ERROR (Status)) {
+        Error (NULL, 0, 2000, "Invalid parameter", "%s = %s", EFI_FV_BASE_ADDRESS_STRING, Value);
+        return EFI_ABORTED;
+      }
+      DebugMsg (NULL, 0, 9, "rebase address", "%s = %s", EFI_FV_BASE_ADDRESS_STRING, Value);
 
-    Error (NULL, 0, 3000, "Invalid", "could not find the SEC core file in the FV.");
-    return EFI_ABORTED;
+      FvInfo->BaseAddress = Value64;
+      FvInfo->BaseAddressSet = TRUE;
+    }
   }
+
   //
-  // Sec Core found, now find PE32 section
+  // Read the FV File System Guid
   //
-  Status = GetSectionByType (SecCoreFile, EFI_SECTION_PE32, 1, &Pe32Section);
-  if (Status == EFI_NOT_FOUND) {
-    Status = GetSectionByType (SecCoreFile, EFI_SECTION_TE, 1, &Pe32Section);
+  if (!FvInfo->FvFileSystemGuidSet) {
+    Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_FV_FILESYSTEMGUID_STRING, 0, Value);
+    if (Status == EFI_SUCCESS) {
+      //
+      // Get the guid value
+      //
+      Status = StringToGuid (Value, &GuidValue);
+      if (EFI_ERROR (Status)) {
+        Error (NULL, 0, 2000, "Invalid parameter", "%s = %s", EFI_FV_FILESYSTEMGUID_STRING, Value);
+        return EFI_ABORTED;
+      }
+      memcpy (&FvInfo->FvFileSystemGuid, &GuidValue, sizeof (EFI_GUID));
+      FvInfo->FvFileSystemGuidSet = TRUE;
+    }
   }
 
-  if (EFI_ERROR (Status)) {
-    Error (NULL, 0, 3000, "Invalid", "could not find a PE32 section in the SEC core file.");
-    return EFI_ABORTED;
+  //
+  // Read the FV Extension Header File Name
+  //
+  Status = FindToken (InfFile, ATTRIBUTES_SECTION_STRING, EFI_FV_EXT_HEADER_FILE_NAME, 0, Value);
+  if (Status == EFI_SUCCESS) {
+    strcpy (FvInfo->FvExtHeaderFile, Value);
   }
 
-  SecHeaderSize = GetSectionHeaderLength(Pe32Section.CommonHeader);
-  Status = GetPe32Info (
-            (VOID *) ((UINTN) Pe32Section.Pe32Section + SecHeaderSize),
-            &EntryPoint,
-            &BaseOfCode,
-            &MachineType
-            );
-
-  if (EFI_ERROR (Status)) {
-    Error (NULL, 0, 3000, "Invalid", "could not get the PE32 entry point for the SEC core.");
-    return EFI_ABORTED;
-  }  
-
-  if (
-       Vtf0Detected &&
-       (MachineType == EFI_IMAGE_MACHINE_IA32 ||
-        MachineType == EFI_IMAGE_MACHINE_X64)
-     ) {
+  //
+  // Read the FV file name
+  //
+  Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_FV_FILE_NAME_STRING, 0, Value);
+  if (Status == EFI_SUCCESS) {
     //
-    // If the SEC core code is IA32 or X64 and the VTF-0 signature
-    // is found, we'll treat it as a VTF-0 'Volume Top File'.
-    // This means no modifications are required to the VTF.
+    // copy the file name
     //
-    return EFI_SUCCESS;
+    strcpy (FvInfo->FvName, Value);
   }
-
+  
   //
-  // Physical address is FV base + offset of PE32 + offset of the entry point
+  // Read Fv Attribute
   //
-  SecCorePhysicalAddress = FvInfo->BaseAddress;
-  SecCorePhysicalAddress += (UINTN) Pe32Section.Pe32Section + SecHeaderSize - (UINTN) FvImage->FileImage;
-  SecCorePhysicalAddress += EntryPoint;
-  DebugMsg (NULL, 0, 9, "SecCore physical entry point address", "Address = 0x%llX", (unsigned long long) SecCorePhysicalAddress); 
+  for (Index = 0; Index < sizeof (mFvbAttributeName)/sizeof (CHAR8 *); Index ++) {
+    if ((mFvbAttributeName [Index] != NULL) && \
+        (FindToken (InfFile, ATTRIBUTES_SECTION_STRING, mFvbAttributeName [Index], 0, Value) == EFI_SUCCESS)) {
+      if ((strcmp (Value, TRUE_STRING) == 0) || (strcmp (Value, ONE_STRING) == 0)) {
+        FvInfo->FvAttributes |= 1 << Index;
+      } else if ((strcmp (Value, FALSE_STRING) != 0) && (strcmp (Value, ZERO_STRING) != 0)) {
+        Error (NULL, 0, 2000, "Invalid parameter", "%s expected %s | %s", mFvbAttributeName [Index], TRUE_STRING, FALSE_STRING);
+        return EFI_ABORTED;
+      }
+    }
+  }
 
   //
-  // Find the PEI Core
+  // Read Fv Alignment
   //
-  Status = GetFileByType (EFI_FV_FILETYPE_PEI_CORE, 1, &PeiCoreFile);
-  if (EFI_ERROR (Status) || PeiCoreFile == NULL) {
-    Error (NULL, 0, 3000, "Invalid", "could not find the PEI core in the FV.");
-    return EFI_ABORTED;
+  for (Index = 0; Index < sizeof (mFvbAlignmentName)/sizeof (CHAR8 *); Index ++) {
+    if (FindToken (InfFile, ATTRIBUTES_SECTION_STRING, mFvbAlignmentName [Index], 0, Value) == EFI_SUCCESS) {
+      if (strcmp (Value, TRUE_STRING) == 0) {
+        FvInfo->FvAttributes |= Index << 16;
+        DebugMsg (NULL, 0, 9, "FV file alignment", "Align = %s", mFvbAlignmentName [Index]);
+        break;
+      }
+    }
   }
+
   //
-  // PEI Core found, now find PE32 or TE section
+  // Read weak alignment flag
   //
-  Status = GetSectionByType (PeiCoreFile, EFI_SECTION_PE32, 1, &Pe32Section);
-  if (Status == EFI_NOT_FOUND) {
-    Status = GetSectionByType (PeiCoreFile, EFI_SECTION_TE, 1, &Pe32Section);
-  }
-
-  if (EFI_ERROR (Status)) {
-    Error (NULL, 0, 3000, "Invalid", "could not find either a PE32 or a TE section in PEI core file.");
-    return EFI_ABORTED;
+  Status = FindToken (InfFile, ATTRIBUTES_SECTION_STRING, EFI_FV_WEAK_ALIGNMENT_STRING, 0, Value);
+  if (Status == EFI_SUCCESS) {
+    if ((strcmp (Value, TRUE_STRING) == 0) || (strcmp (Value, ONE_STRING) == 0)) {
+      FvInfo->FvAttributes |= EFI_FVB2_WEAK_ALIGNMENT;
+    } else if ((strcmp (Value, FALSE_STRING) != 0) && (strcmp (Value, ZERO_STRING) != 0)) {
+      Error (NULL, 0, 2000, "Invalid parameter", "Weak alignment value expected one of TRUE, FALSE, 1 or 0.");
+      return EFI_ABORTED;
+    }
   }
 
-  SecHeaderSize = GetSectionHeaderLength(Pe32Section.CommonHeader);
-  Status = GetPe32Info (
-            (VOID *) ((UINTN) Pe32Section.Pe32Section + SecHeaderSize),
-            &EntryPoint,
-            &BaseOfCode,
-            &MachineType
-            );
+  //
+  // Read block maps
+  //
+  for (Index = 0;; Index++) {
+    BlockMapEntry = GetFvBlockMapEntry (FvInfo, Index);
+    if (BlockMapEntry == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    if (BlockMapEntry->Length == 0) {
+      //
+      // Read block size
+      //
+      Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_BLOCK_SIZE_STRING, Index, Value);
 
-  if (EFI_ERROR (Status)) {
-    Error (NULL, 0, 3000, "Invalid", "could not get the PE32 entry point for the PEI core.");
+      if (Status == EFI_SUCCESS) {
+        //
+        // Update the size of block
+        //
+        Status = AsciiStringToUint64 (Value, FALSE, &Value64);
+        if (EFI_ERROR (Status)) {
+          Error (NULL, 0, 2000, "Invalid parameter", "%s = %s", EFI_BLOCK_SIZE_STRING, Value);
+          return EFI_ABORTED;
+        }
+
+        BlockMapEntry->Length = (UINT32) Value64;
+        DebugMsg (NULL, 0, 9, "FV Block Size", "%s = %s", EFI_BLOCK_SIZE_STRING, Value);
+      } else {
+        //
+        // If there is no blocks size, but there is the number of block, then we have a mismatched pair
+        // and should return an error.
+        //
+        Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_NUM_BLOCKS_STRING, Index, Value);
+        if (!EFI_ERROR (Status)) {
+          Error (NULL, 0, 2000, "Invalid parameter", "both %s and %s must be specified.", EFI_NUM_BLOCKS_STRING, EFI_BLOCK_SIZE_STRING);
+          return EFI_ABORTED;
+        } else {
+          //
+          // We are done
+          //
+          break;
+        }
+      }
+
+      //
+      // Read blocks number
+      //
+      Status = FindToken (InfFile, OPTIONS_SECTION_STRING, EFI_NUM_BLOCKS_STRING, Index, Value);
+
+      if (Status == EFI_SUCCESS) {
+        //
+        // Update the number of blocks
+        //
+        Status = AsciiStringToUint64 (Value, FALSE, &Value64);
+        if (EFI_ERROR (Status)) {
+          Error (NULL, 0, 2000, "Invalid parameter", "%s = %s", EFI_NUM_BLOCKS_STRING, Value);
+          return EFI_ABORTED;
+        }
+
+        BlockMapEntry->NumBlocks = (UINT32) Value64;
+        DebugMsg (NULL, 0, 9, "FV Block Number", "%s = %s", EFI_NUM_BLOCKS_STRING, Value);
+      }
+    }
+  }
+
+  if (Index == 0) {
+    Error (NULL, 0, 2001, "Missing required argument", "block size.");
     return EFI_ABORTED;
   }
+
   //
-  // Physical address is FV base + offset of PE32 + offset of the entry point
+  // Read files, after those given on the command line
   //
-  PeiCorePhysicalAddress = FvInfo->BaseAddress;
-  PeiCorePhysicalAddress += (UINTN) Pe32Section.Pe32Section + SecHeaderSize - (UINTN) FvImage->FileImage;
-  PeiCorePhysicalAddress += EntryPoint;
-  DebugMsg (NULL, 0, 9, "PeiCore physical entry point address", "Address = 0x%llX", (unsigned long long) PeiCorePhysicalAddress);
-
-  if (MachineType == EFI_IMAGE_MACHINE_IA64) {
-    //
-    // Update PEI_CORE address
-    //
+  for (Index = 0;; Index++) {
     //
-    // Set the uncached attribute bit in the physical address
+    // Read the FFS file list
     //
-    PeiCorePhysicalAddress |= 0x8000000000000000ULL;
+    Status = FindToken (InfFile, FILES_SECTION_STRING, EFI_FILE_NAME_STRING, Index, Value);
 
-    //
-    // Check if address is aligned on a 16 byte boundary
-    //
-    if (PeiCorePhysicalAddress & 0xF) {
-      Error (NULL, 0, 3000, "Invalid",
-        "PEI_CORE entry point is not aligned on a 16 byte boundary, address specified is %llXh.",
-        (unsigned long long) PeiCorePhysicalAddress
-        );
-      return EFI_ABORTED;
+    if (Status == EFI_SUCCESS) {
+      //
+      // Add the file
+      //
+      Status = AddFvFile (FvInfo, Value, 0);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      DebugMsg (NULL, 0, 9, "FV component file", "the %uth name is %s", (unsigned) Index, Value);
+    } else {
+      break;
     }
-    //
-    // First Get the FIT table address
-    //
-    FitAddress  = (*(UINT64 *) (FvImage->Eof - IPF_FIT_ADDRESS_OFFSET)) & 0xFFFFFFFF;
+  }
 
-    FitTablePtr = (FIT_TABLE *) (FvImage->FileImage + (FitAddress - FvInfo->BaseAddress));
+  if (FvInfo->FvFileCount == 0) {
+    Warning (NULL, 0, 0, "FV components are not specified.", NULL);
+  }
 
-    Status      = UpdatePeiCoreEntryInFit (FitTablePtr, PeiCorePhysicalAddress);
+  return EFI_SUCCESS;
+}
 
-    if (!EFI_ERROR (Status)) {
-      UpdateFitCheckSum (FitTablePtr);
-    }
+VOID
+UpdateFfsFileState (
+  IN EFI_FFS_FILE_HEADER          *FfsFile,
+  IN EFI_FIRMWARE_VOLUME_HEADER   *FvHeader
+  )
+/*++
+
+Routine Description:
+
+  This function changes the FFS file attributes based on the erase polarity
+  of the FV. Update the reserved bits of State to EFI_FVB2_ERASE_POLARITY. 
+
+Arguments:
+
+  FfsFile   File header.
+  FvHeader  FV header.
+
+Returns:
+
+  None
+
+--*/
+{
+  if (FvHeader->Attributes & EFI_FVB2_ERASE_POLARITY) {
+    FfsFile->State = (UINT8)~(FfsFile->State);
+    // FfsFile->State |= ~(UINT8) EFI_FILE_ALL_STATE_BITS;
+  }
+}
+
+EFI_STATUS
+ReadFfsAlignment (
+  IN EFI_FFS_FILE_HEADER    *FfsFile,
+  IN OUT UINT32             *Alignment
+  )
+/*++
+
+Routine Description:
+
+  This function determines the alignment of the FFS input file from the file
+  attributes.
+
+Arguments:
+
+  FfsFile       FFS file to parse
+  Alignment     The minimum required alignment offset of the FFS file
+
+Returns:
+
+  EFI_SUCCESS              The function completed successfully.
+  EFI_INVALID_PARAMETER    One of the input parameters was invalid.
+  EFI_ABORTED              An error occurred.
+
+--*/
+{
+  //
+  // Verify input parameters.
+  //
+  if (FfsFile == NULL || Alignment == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  switch ((FfsFile->Attributes >> 3) & 0x07) {
 
+  case 0:
     //
-    // Update SEC_CORE address
+    // 1 byte alignment
     //
+    *Alignment = 0;
+    break;
+
+  case 1:
     //
-    // Set the uncached attribute bit in the physical address
+    // 16 byte alignment
     //
-    SecCorePhysicalAddress |= 0x8000000000000000ULL;
+    *Alignment = 4;
+    break;
+
+  case 2:
     //
-    // Check if address is aligned on a 16 byte boundary
+    // 128 byte alignment
     //
-    if (SecCorePhysicalAddress & 0xF) {
-      Error (NULL, 0, 3000, "Invalid",
-        "SALE_ENTRY entry point is not aligned on a 16 byte boundary, address specified is %llXh.",
-        (unsigned long long) SecCorePhysicalAddress
-        );
-      return EFI_ABORTED;
-    }
+    *Alignment = 7;
+    break;
+
+  case 3:
     //
-    // Update the address
+    // 512 byte alignment
     //
-    SecCoreEntryAddressPtr  = (EFI_PHYSICAL_ADDRESS *) ((UINTN) FvImage->Eof - IPF_SALE_ENTRY_ADDRESS_OFFSET);
-    *SecCoreEntryAddressPtr = SecCorePhysicalAddress;
+    *Alignment = 9;
+    break;
 
-  } else if (MachineType == EFI_IMAGE_MACHINE_IA32 || MachineType == EFI_IMAGE_MACHINE_X64) {
+  case 4:
     //
-    // Get the location to update
+    // 1K byte alignment
     //
-    Ia32ResetAddressPtr  = (UINT32 *) ((UINTN) FvImage->Eof - IA32_PEI_CORE_ENTRY_OFFSET);
+    *Alignment = 10;
+    break;
 
+  case 5:
     //
-    // Write lower 32 bits of physical address for Pei Core entry
-    //
-    *Ia32ResetAddressPtr = (UINT32) PeiCorePhysicalAddress;
-    
+    // 4K byte alignment
     //
-    // Write SecCore Entry point relative address into the jmp instruction in reset vector.
-    // 
-    Ia32ResetAddressPtr  = (UINT32 *) ((UINTN) FvImage->Eof - IA32_SEC_CORE_ENTRY_OFFSET);
-    
-    Ia32SecEntryOffset   = (INT32) (SecCorePhysicalAddress - (FV_IMAGES_TOP_ADDRESS - IA32_SEC_CORE_ENTRY_OFFSET + 2));
-    if (Ia32SecEntryOffset <= -65536) {
-      Error (NULL, 0, 3000, "Invalid", "The SEC EXE file size is too large, it must be less than 64K.");
-      return STATUS_ERROR;
-    }
-    
-    *(UINT16 *) Ia32ResetAddressPtr = (UINT16) Ia32SecEntryOffset;
+    *Alignment = 12;
+    break;
 
+  case 6:
     //
-    // Update the BFV base address
+    // 32K byte alignment
     //
-    Ia32ResetAddressPtr   = (UINT32 *) ((UINTN) FvImage->Eof - 4);
-    *Ia32ResetAddressPtr  = (UINT32) (FvInfo->BaseAddress);
-    DebugMsg (NULL, 0, 9, "update BFV base address in the top FV image", "BFV base address = 0x%llX.", (unsigned long long) FvInfo->BaseAddress);
+    *Alignment = 15;
+    break;
 
+  case 7:
     //
-    // Update the Startup AP in the FVH header block ZeroVector region.
+    // 64K byte alignment
     //
-    BytePointer   = (UINT8 *) ((UINTN) FvImage->FileImage);
-    if (FvInfo->Size <= 0x10000) {
-      BytePointer2 = m64kRecoveryStartupApDataArray;
-    } else if (FvInfo->Size <= 0x20000) {
-      BytePointer2 = m128kRecoveryStartupApDataArray;
-    } else {
-      BytePointer2 = m128kRecoveryStartupApDataArray;
-      //
-      // Find the position to place Ap reset vector, the offset
-      // between the position and the end of Fvrecovery.fv file
-      // should not exceed 128kB to prevent Ap reset vector from
-      // outside legacy E and F segment
-      //
+    *Alignment = 16;
+    break;
+
+  default:
+    break;
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+AddPadFile (
+  IN OUT MEMORY_FILE  *FvImage,
+  IN UINT32           DataAlignment,
+  IN VOID             *FvEnd,
+  IN EFI_FIRMWARE_VOLUME_EXT_HEADER *ExtHeader,
+  IN UINT32           NextFfsSize
+  )
+/*++
+
+Routine Description:
+
+  This function adds a pad file to the FV image if it required to align the
+  data of the next file.
+
+Arguments:
+
+  FvImage         The memory image of the FV to add it to.
+                  The current offset must be valid.
+  DataAlignment   The data alignment of the next FFS file.
+  FvEnd           End of the empty data in FvImage.
+  ExtHeader       PI FvExtHeader Optional 
+
+Returns:
+
+  EFI_SUCCESS              The function completed successfully.
+  EFI_INVALID_PARAMETER    One of the input parameters was invalid.
+  EFI_OUT_OF_RESOURCES     Insufficient resources exist in the FV to complete
+                           the pad file add.
+
+--*/
+{
+  EFI_FFS_FILE_HEADER *PadFile;
+  UINTN               PadFileSize;
+  UINT32              NextFfsHeaderSize;
+  UINT32              CurFfsHeaderSize;
+
+  CurFfsHeaderSize = sizeof (EFI_FFS_FILE_HEADER);
+  //
+  // Verify input parameters.
+  //
+  if (FvImage == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Calculate the pad file size
+  //
+
+  //
+  // Append extension header size
+  //
+  if (ExtHeader != NULL) {
+    PadFileSize = ExtHeader->ExtHeaderSize;
+    if (PadFileSize + sizeof (EFI_FFS_FILE_HEADER) >= MAX_FFS_SIZE) {
+      CurFfsHeaderSize = sizeof (EFI_FFS_FILE_HEADER2);
+    }
+    PadFileSize += CurFfsHeaderSize;
+  } else {
+    NextFfsHeaderSize = sizeof (EFI_FFS_FILE_HEADER);
+    if (NextFfsSize >= MAX_FFS_SIZE) {
+      NextFfsHeaderSize = sizeof (EFI_FFS_FILE_HEADER2);
+    }
+    //
+    // Check if a pad file is necessary
+    //
+    if (((UINTN) FvImage->CurrentFilePointer - (UINTN) FvImage->FileImage + NextFfsHeaderSize) % DataAlignment == 0) {
+      return EFI_SUCCESS;
+    }
+    PadFileSize = (UINTN) FvImage->CurrentFilePointer - (UINTN) FvImage->FileImage + sizeof (EFI_FFS_FILE_HEADER) + NextFfsHeaderSize;
+    //
+    // Add whatever it takes to get to the next aligned address
+    //
+    while ((PadFileSize % DataAlignment) != 0) {
+      PadFileSize++;
+    }
+    //
+    // Subtract the next file header size
+    //
+    PadFileSize -= NextFfsHeaderSize;
+    //
+    // Subtract the starting offset to get size
+    //
+    PadFileSize -= (UINTN) FvImage->CurrentFilePointer - (UINTN) FvImage->FileImage;
+  }
+
+  //
+  // Verify that we have enough space for the file header
+  //
+  if (((UINTN) FvImage->CurrentFilePointer + PadFileSize) > (UINTN) FvEnd) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Write pad file header
+  //
+  PadFile = (EFI_FFS_FILE_HEADER *) FvImage->CurrentFilePointer;
+
+  //
+  // Write PadFile FFS header with PadType, don't need to set PAD file guid in its header.
+  //
+  PadFile->Type       = EFI_FV_FILETYPE_FFS_PAD;
+  PadFile->Attributes = 0;
+
+  //
+  // Write pad file size (calculated size minus next file header size)
+  //
+  if (PadFileSize >= MAX_FFS_SIZE) {
+    memset(PadFile->Size, 0, sizeof(UINT8) * 3);
+    ((EFI_FFS_FILE_HEADER2 *)PadFile)->ExtendedSize = PadFileSize;
+    PadFile->Attributes |= FFS_ATTRIB_LARGE_FILE;
+  } else {
+    PadFile->Size[0]  = (UINT8) (PadFileSize & 0xFF);
+    PadFile->Size[1]  = (UINT8) ((PadFileSize >> 8) & 0xFF);
+    PadFile->Size[2]  = (UINT8) ((PadFileSize >> 16) & 0xFF);
+  }
+
+  //
+  // Fill in checksums and state, they must be 0 for checksumming.
+  //
+  PadFile->IntegrityCheck.Checksum.Header = 0;
+  PadFile->IntegrityCheck.Checksum.File   = 0;
+  PadFile->State                          = 0;
+  PadFile->IntegrityCheck.Checksum.Header = CalculateChecksum8 ((UINT8 *) PadFile, CurFfsHeaderSize);
+  PadFile->IntegrityCheck.Checksum.File   = FFS_FIXED_CHECKSUM;
+
+  PadFile->State = EFI_FILE_HEADER_CONSTRUCTION | EFI_FILE_HEADER_VALID | EFI_FILE_DATA_VALID;
+  UpdateFfsFileState (
+    (EFI_FFS_FILE_HEADER *) PadFile,
+    (EFI_FIRMWARE_VOLUME_HEADER *) FvImage->FileImage
+    );
+
+  //
+  // Update the current FV pointer
+  //
+  FvImage->CurrentFilePointer += PadFileSize;
+
+  if (ExtHeader != NULL) {
+    //
+    // Copy Fv Extension Header and Set Fv Extension header offset
+    //
+    memcpy ((UINT8 *)PadFile + CurFfsHeaderSize, ExtHeader, ExtHeader->ExtHeaderSize);
+    ((EFI_FIRMWARE_VOLUME_HEADER *) FvImage->FileImage)->ExtHeaderOffset = (UINT16) ((UINTN) ((UINT8 *)PadFile + CurFfsHeaderSize) - (UINTN) FvImage->FileImage);
+	  //
+	  // Make next file start at QWord Boundry
+	  //
+	  while (((UINTN) FvImage->CurrentFilePointer & (EFI_FFS_FILE_HEADER_ALIGNMENT - 1)) != 0) {
+	    FvImage->CurrentFilePointer++;
+	  }
+  }
+
+  return EFI_SUCCESS;
+}
+
+BOOLEAN
+IsVtfFile (
+  IN EFI_FFS_FILE_HEADER    *FileBuffer
+  )
+/*++
+
+Routine Description:
+
+  This function checks the header to validate if it is a VTF file
+
+Arguments:
+
+  FileBuffer     Buffer in which content of a file has been read.
+
+Returns:
+
+  TRUE    If this is a VTF file
+  FALSE   If this is not a VTF file
+
+--*/
+{
+  if (!memcmp (&FileBuffer->Name, &mEfiFirmwareVolumeTopFileGuid, sizeof (EFI_GUID))) {
+    return TRUE;
+  } else {
+    return FALSE;
+  }
+}
+
+EFI_STATUS
+WriteMapFile (
+  IN OUT FILE                  *FvMapFile,
+  IN     CHAR8                 *FileName,
+  IN     EFI_FFS_FILE_HEADER   *FfsFile, 
+  IN     EFI_PHYSICAL_ADDRESS  ImageBaseAddress,
+  IN     PE_COFF_LOADER_IMAGE_CONTEXT *pImageContext
+  )
+/*++
+
+Routine Description:
+
+  This function gets the basic debug information (entrypoint, baseaddress, .text, .data section base address)
+  from PE/COFF image and abstracts Pe Map file information and add them into FvMap file for Debug.
+
+Arguments:
+
+  FvMapFile             A pointer to FvMap File
+  FileName              Ffs File PathName
+  FfsFile               A pointer to Ffs file image.
+  ImageBaseAddress      PeImage Base Address.
+  pImageContext         Image Context Information.
+
+Returns:
+
+  EFI_SUCCESS           Added required map information.
+
+--*/
+{
+  CHAR8                               PeMapFileName [_MAX_PATH];
+  CHAR8                               *Cptr, *Cptr2;
+  CHAR8                               FileGuidName [MAX_LINE_LEN];
+  FILE                                *PeMapFile;
+  CHAR8                               Line [MAX_LINE_LEN];
+  CHAR8                               KeyWord [MAX_LINE_LEN];
+  CHAR8                               FunctionName [MAX_LINE_LEN];
+  EFI_PHYSICAL_ADDRESS                FunctionAddress;
+  UINT32                              FunctionType;
+  CHAR8                               FunctionTypeName [MAX_LINE_LEN];
+  UINT32                              Index;
+  UINT32                              AddressOfEntryPoint;
+  UINT32                              Offset;
+  EFI_IMAGE_OPTIONAL_HEADER_UNION     *ImgHdr;
+  EFI_TE_IMAGE_HEADER                 *TEImageHeader;
+  EFI_IMAGE_SECTION_HEADER            *SectionHeader;
+  unsigned long long                  TempLongAddress;
+  UINT32                              TextVirtualAddress;
+  UINT32                              DataVirtualAddress;
+  EFI_PHYSICAL_ADDRESS                LinkTimeBaseAddress;
+
+  //
+  // Init local variable
+  //
+  FunctionType = 0;
+  //
+  // Print FileGuid to string buffer. 
+  //
+  PrintGuidToBuffer (&FfsFile->Name, (UINT8 *)FileGuidName, MAX_LINE_LEN, TRUE);
+  
+  //
+  // Construct Map file Name 
+  //
+  strcpy (PeMapFileName, FileName);
+  
+  //
+  // Change '\\' to '/', unified path format.
+  //
+  Cptr = PeMapFileName;
+  while (*Cptr != '\0') {
+    if (*Cptr == '\\') {
+      *Cptr = FILE_SEP_CHAR;
+    }
+    Cptr ++;
+  }
+  
+  //
+  // Get Map file
+  // 
+  Cptr = PeMapFileName + strlen (PeMapFileName);
+  while ((*Cptr != '.') && (Cptr >= PeMapFileName)) {
+    Cptr --;
+  }
+  if (Cptr < PeMapFileName) {
+    return EFI_NOT_FOUND;
+  } else {
+    *(Cptr + 1) = 'm';
+    *(Cptr + 2) = 'a';
+    *(Cptr + 3) = 'p';
+    *(Cptr + 4) = '\0';
+  }
+
+  //
+  // Get module Name
+  //
+  Cptr2 = Cptr;
+  while ((*Cptr != FILE_SEP_CHAR) && (Cptr >= PeMapFileName)) {
+    Cptr --;
+  }
+	*Cptr2 = '\0';
+	strcpy (KeyWord, Cptr + 1);
+	*Cptr2 = '.';
+
+  //
+  // AddressOfEntryPoint and Offset in Image
+  //
+  if (!pImageContext->IsTeImage) {
+  	ImgHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *) ((UINT8 *) pImageContext->Handle + pImageContext->PeCoffHeaderOffset);
+  	AddressOfEntryPoint = ImgHdr->Pe32.OptionalHeader.AddressOfEntryPoint;
+  	Offset = 0;
+    SectionHeader = (EFI_IMAGE_SECTION_HEADER *) (
+                       (UINT8 *) ImgHdr +
+                       sizeof (UINT32) + 
+                       sizeof (EFI_IMAGE_FILE_HEADER) +  
+                       ImgHdr->Pe32.FileHeader.SizeOfOptionalHeader
+                       );
+    Index = ImgHdr->Pe32.FileHeader.NumberOfSections;
+  } else {
+  	TEImageHeader = (EFI_TE_IMAGE_HEADER *) pImageContext->Handle;
+    AddressOfEntryPoint = TEImageHeader->AddressOfEntryPoint;
+    Offset = TEImageHeader->StrippedSize - sizeof (EFI_TE_IMAGE_HEADER);
+    SectionHeader = (EFI_IMAGE_SECTION_HEADER *) (TEImageHeader + 1);
+    Index = TEImageHeader->NumberOfSections;
+  }
+
+  //
+  // module information output
+  //
+  if (ImageBaseAddress == 0) {
+    fprintf (FvMapFile, "%s (dummy) (", KeyWord);
+    fprintf (FvMapFile, "BaseAddress=%010llx, ", (unsigned long long) ImageBaseAddress);
+  } else {
+    fprintf (FvMapFile, "%s (Fixed Flash Address, ", KeyWord);
+    fprintf (FvMapFile, "BaseAddress=0x%010llx, ", (unsigned long long) (ImageBaseAddress + Offset));
+  }
+
+  if (FfsFile->Type != EFI_FV_FILETYPE_SECURITY_CORE && pImageContext->Machine == EFI_IMAGE_MACHINE_IA64) {
+    //
+    // Process IPF PLABEL to get the real address after the image has been rebased. 
+    // PLABEL structure is got by AddressOfEntryPoint offset to ImageBuffer stored in pImageContext->Handle.
+    //
+    fprintf (FvMapFile, "EntryPoint=0x%010llx", (unsigned long long) (*(UINT64 *)((UINTN) pImageContext->Handle + (UINTN) AddressOfEntryPoint)));
+  } else {
+    fprintf (FvMapFile, "EntryPoint=0x%010llx", (unsigned long long) (ImageBaseAddress + AddressOfEntryPoint));
+  }
+  fprintf (FvMapFile, ")\n"); 
+  
+  fprintf (FvMapFile, "(GUID=%s", FileGuidName);
+  TextVirtualAddress = 0;
+  DataVirtualAddress = 0;
+  for (; Index > 0; Index --, SectionHeader ++) {
+    if (stricmp ((CHAR8 *)SectionHeader->Name, ".text") == 0) {
+  		TextVirtualAddress = SectionHeader->VirtualAddress;
+  	} else if (stricmp ((CHAR8 *)SectionHeader->Name, ".data") == 0) {
+  	  DataVirtualAddress = SectionHeader->VirtualAddress;
+  	} else if (stricmp ((CHAR8 *)SectionHeader->Name, ".sdata") == 0) {
+  	  DataVirtualAddress = SectionHeader->VirtualAddress;
+  	}
+  }
+  fprintf (FvMapFile, " .textbaseaddress=0x%010llx", (unsigned long long) (ImageBaseAddress + TextVirtualAddress));
+  fprintf (FvMapFile, " .databaseaddress=0x%010llx", (unsigned long long) (ImageBaseAddress + DataVirtualAddress));
+  fprintf (FvMapFile, ")\n\n");
+   
+  //
+  // Open PeMapFile
+  //
+  PeMapFile = fopen (PeMapFileName, "r");
+  if (PeMapFile == NULL) {
+    // fprintf (stdout, "can't open %s file to reading\n", PeMapFileName);
+    return EFI_ABORTED;
+  }
+  VerboseMsg ("The map file is %s", PeMapFileName);
+  
+  //
+  // Output Functions information into Fv Map file
+  //
+  LinkTimeBaseAddress = 0;
+  while (fgets (Line, MAX_LINE_LEN, PeMapFile) != NULL) {
+    //
+    // Skip blank line
+    //
+    if (Line[0] == 0x0a) {
+      FunctionType = 0;
+      continue;
+    }
+    //
+    // By Address and Static keyword
+    //  
+    if (FunctionType == 0) {
+      sscanf (Line, "%s", KeyWord);
+      if (stricmp (KeyWord, "Address") == 0) {
+        //
+        // function list
+        //
+        FunctionType = 1;
+        fgets (Line, MAX_LINE_LEN, PeMapFile);
+      } else if (stricmp (KeyWord, "Static") == 0) {
+        //
+        // static function list
+        //
+        FunctionType = 2;
+        fgets (Line, MAX_LINE_LEN, PeMapFile);
+      } else if (stricmp (KeyWord, "Preferred") ==0) {
+        sscanf (Line + strlen (" Preferred load address is"), "%llx", &TempLongAddress);
+        LinkTimeBaseAddress = (UINT64) TempLongAddress;
+      }
+      continue;
+    }
+    //
+    // Printf Function Information
+    //
+    if (FunctionType == 1) {
+      sscanf (Line, "%s %s %llx %s", KeyWord, FunctionName, &TempLongAddress, FunctionTypeName);
+      FunctionAddress = (UINT64) TempLongAddress;
+      if (FunctionTypeName [1] == '\0' && (FunctionTypeName [0] == 'f' || FunctionTypeName [0] == 'F')) {
+        fprintf (FvMapFile, "  0x%010llx    ", (unsigned long long) (ImageBaseAddress + FunctionAddress - LinkTimeBaseAddress));
+        fprintf (FvMapFile, "%s\n", FunctionName);
+      }
+    } else if (FunctionType == 2) {
+      sscanf (Line, "%s %s %llx %s", KeyWord, FunctionName, &TempLongAddress, FunctionTypeName);
+      FunctionAddress = (UINT64) TempLongAddress;
+      if (FunctionTypeName [1] == '\0' && (FunctionTypeName [0] == 'f' || FunctionTypeName [0] == 'F')) {
+        fprintf (FvMapFile, "  0x%010llx    ", (unsigned long long) (ImageBaseAddress + FunctionAddress - LinkTimeBaseAddress));
+        fprintf (FvMapFile, "%s\n", FunctionName);
+      }
+    }
+  }
+  //
+  // Close PeMap file
+  //
+  fprintf (FvMapFile, "\n\n");
+  fclose (PeMapFile);
+  
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+AddFile (
+  IN OUT MEMORY_FILE          *FvImage,
+  IN FV_INFO                  *FvInfo,
+  IN UINTN                    Index,
+  IN OUT EFI_FFS_FILE_HEADER  **VtfFileImage,
+  IN FILE                     *FvReportFile
+  )
+/*++
+
+Routine Description:
+
+  This function adds a file to the FV image.  The file will pad to the
+  appropriate alignment if required.
+
+Arguments:
+
+  FvImage       The memory image of the FV to add it to.  The current offset
+                must be valid.
+  FvInfo        Pointer to information about the FV.
+  Index         The file in the FvInfo file list to add.
+  VtfFileImage  A pointer to the VTF file within the FvImage.  If this is equal
+                to the end of the FvImage then no VTF previously found.
+  FvReportFile  Pointer to FvReport File
+
+Returns:
+
+  EFI_SUCCESS              The function completed successfully.
+  EFI_INVALID_PARAMETER    One of the input parameters was invalid.
+  EFI_ABORTED              An error occurred.
+  EFI_OUT_OF_RESOURCES     Insufficient resources exist to complete the add.
+
+--*/
+{
+  UINTN                 FileSize;
+  UINT8                 *FileBuffer;
+  EFI_FFS_FILE_HEADER   *FfsFile;
+  UINT32                CurrentFileAlignment;
+  EFI_STATUS            Status;
+  UINTN                 Index1;
+  UINT8                 FileGuidString[PRINTED_GUID_BUFFER_SIZE];
+  
+  Index1 = 0;
+  //
+  // Verify input parameters.
+  //
+  if (FvImage == NULL || FvInfo == NULL || Index >= FvInfo->FvFileCount || VtfFileImage == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Get the file to add. The mapped file is only read; it is copied into
+  // the FV image first and then updated in place there.
+  //
+  Status = GetFvFileImage (FvInfo, Index, &FileBuffer, &FileSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  
+  //
+  // For None PI Ffs file, directly add them into FvImage.
+  //
+  if (!FvInfo->IsPiFvImage) {
+    memcpy (FvImage->CurrentFilePointer, FileBuffer, FileSize);
+    if (FvInfo->SizeofFvFiles[Index] > FileSize) {
+    	FvImage->CurrentFilePointer += FvInfo->SizeofFvFiles[Index];
+    } else {
+    	FvImage->CurrentFilePointer += FileSize;
+    }
+    return EFI_SUCCESS;
+  }
+  
+  //
+  // Verify Ffs file
+  //
+  Status = VerifyFfsFile ((EFI_FFS_FILE_HEADER *)FileBuffer);
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 3000, "Invalid", "%s is not a valid FFS file.", FvInfo->FvFiles[Index]);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Verify space exists to add the file
+  //
+  if (FileSize > (UINTN) ((UINTN) *VtfFileImage - (UINTN) FvImage->CurrentFilePointer)) {
+    Error (NULL, 0, 4002, "Resource", "FV space is full, not enough room to add file %s.", FvInfo->FvFiles[Index]);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Verify the input file is the duplicated file in this Fv image
+  //
+  for (Index1 = 0; Index1 < Index; Index1 ++) {
+    if (CompareGuid ((EFI_GUID *) FileBuffer, &mFileGuidArray [Index1]) == 0) {
+      Error (NULL, 0, 2000, "Invalid parameter", "the %dth file and %uth file have the same file GUID.", (unsigned) Index1 + 1, (unsigned) Index + 1);
+      PrintGuid ((EFI_GUID *) FileBuffer);
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+  CopyMem (&mFileGuidArray [Index], FileBuffer, sizeof (EFI_GUID));
+
+  //
+  // Check if alignment is required
+  //
+  ReadFfsAlignment ((EFI_FFS_FILE_HEADER *) FileBuffer, &CurrentFileAlignment);
+  
+  //
+  // Find the largest alignment of all the FFS files in the FV
+  //
+  if (CurrentFileAlignment > MaxFfsAlignment) {
+    MaxFfsAlignment = CurrentFileAlignment;
+  }
+  //
+  // If we have a VTF file, add it at the top.
+  //
+  if (IsVtfFile ((EFI_FFS_FILE_HEADER *) FileBuffer)) {
+    if ((UINTN) *VtfFileImage == (UINTN) FvImage->Eof) {
+      //
+      // No previous VTF, add this one.
+      //
+      *VtfFileImage = (EFI_FFS_FILE_HEADER *) (UINTN) ((UINTN) FvImage->FileImage + FvInfo->Size - FileSize);
+      //
+      // Sanity check. The file MUST align appropriately
+      //
+      if (((UINTN) *VtfFileImage + GetFfsHeaderLength((EFI_FFS_FILE_HEADER *)FileBuffer) - (UINTN) FvImage->FileImage) % (1 << CurrentFileAlignment)) {
+        Error (NULL, 0, 3000, "Invalid", "VTF file cannot be aligned on a %u-byte boundary.", (unsigned) (1 << CurrentFileAlignment));
+        return EFI_ABORTED;
+      }
+      //
+      // copy VTF File
+      //
+      FfsFile = *VtfFileImage;
+      memcpy (FfsFile, FileBuffer, FileSize);
+
+      //
+      // Update the file state based on polarity of the FV.
+      //
+      UpdateFfsFileState (FfsFile, (EFI_FIRMWARE_VOLUME_HEADER *) FvImage->FileImage);
+
+      //
+      // Rebase the PE or TE image in FileBuffer of FFS file for XIP 
+      // Rebase for the debug genfvmap tool
+      // The rebase is done by RebaseFvFiles once all files are placed.
+      //
+      Status = AddRebaseJob (FvInfo, Index, FfsFile, (UINTN) *VtfFileImage - (UINTN) FvImage->FileImage);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      
+      PrintGuidToBuffer ((EFI_GUID *) FileBuffer, FileGuidString, sizeof (FileGuidString), TRUE); 
+      fprintf (FvReportFile, "0x%08X %s\n", (unsigned)(UINTN) (((UINT8 *)*VtfFileImage) - (UINTN)FvImage->FileImage), FileGuidString);
+
+      DebugMsg (NULL, 0, 9, "Add VTF FFS file in FV image", NULL);
+      return EFI_SUCCESS;
+    } else {
+      //
+      // Already found a VTF file.
+      //
+      Error (NULL, 0, 3000, "Invalid", "multiple VTF files are not permitted within a single FV.");
+      return EFI_ABORTED;
+    }
+  }
+
+  //
+  // Add pad file if necessary
+  //
+  Status = AddPadFile (FvImage, 1 << CurrentFileAlignment, *VtfFileImage, NULL, FileSize);
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 4002, "Resource", "FV space is full, could not add pad file for data alignment property.");
+    return EFI_ABORTED;
+  }
+  //
+  // Add file
+  //
+  if ((UINTN) (FvImage->CurrentFilePointer + FileSize) <= (UINTN) (*VtfFileImage)) {
+    //
+    // Copy the file
+    //
+    FfsFile = (EFI_FFS_FILE_HEADER *) FvImage->CurrentFilePointer;
+    memcpy (FfsFile, FileBuffer, FileSize);
+
+    //
+    // Update the file state based on polarity of the FV.
+    //
+    UpdateFfsFileState (FfsFile, (EFI_FIRMWARE_VOLUME_HEADER *) FvImage->FileImage);
+
+    //
+    // Rebase the PE or TE image in FileBuffer of FFS file for XIP. 
+    // Rebase Bs and Rt drivers for the debug genfvmap tool.
+    // The rebase is done by RebaseFvFiles once all files are placed.
+    //
+    Status = AddRebaseJob (FvInfo, Index, FfsFile, (UINTN) FvImage->CurrentFilePointer - (UINTN) FvImage->FileImage);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    PrintGuidToBuffer ((EFI_GUID *) FileBuffer, FileGuidString, sizeof (FileGuidString), TRUE); 
+    fprintf (FvReportFile, "0x%08X %s\n", (unsigned) (FvImage->CurrentFilePointer - FvImage->FileImage), FileGuidString);
+    FvImage->CurrentFilePointer += FileSize;
+  } else {
+    Error (NULL, 0, 4002, "Resource", "FV space is full, cannot add file %s.", FvInfo->FvFiles[Index]);
+    return EFI_ABORTED;
+  }
+  //
+  // Make next file start at QWord Boundry
+  //
+  while (((UINTN) FvImage->CurrentFilePointer & (EFI_FFS_FILE_HEADER_ALIGNMENT - 1)) != 0) {
+    FvImage->CurrentFilePointer++;
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+PadFvImage (
+  IN MEMORY_FILE          *FvImage,
+  IN EFI_FFS_FILE_HEADER  *VtfFileImage
+  )
+/*++
+
+Routine Description:
+
+  This function places a pad file between the last file in the FV and the VTF
+  file if the VTF file exists.
+
+Arguments:
+
+  FvImage       Memory file for the FV memory image
+  VtfFileImage  The address of the VTF file.  If this is the end of the FV
+                image, no VTF exists and no pad file is needed.
+
+Returns:
+
+  EFI_SUCCESS             Completed successfully.
+  EFI_INVALID_PARAMETER   One of the input parameters was NULL.
+
+--*/
+{
+  EFI_FFS_FILE_HEADER *PadFile;
+  UINTN               FileSize;
+  UINT32              FfsHeaderSize;
+
+  //
+  // If there is no VTF or the VTF naturally follows the previous file without a
+  // pad file, then there's nothing to do
+  //
+  if ((UINTN) VtfFileImage == (UINTN) FvImage->Eof || \
+      ((UINTN) VtfFileImage == (UINTN) FvImage->CurrentFilePointer)) {
+    return EFI_SUCCESS;
+  }
+
+  if ((UINTN) VtfFileImage < (UINTN) FvImage->CurrentFilePointer) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Pad file starts at beginning of free space
+  //
+  PadFile = (EFI_FFS_FILE_HEADER *) FvImage->CurrentFilePointer;
+
+  //
+  // write PadFile FFS header with PadType, don't need to set PAD file guid in its header. 
+  //
+  PadFile->Type       = EFI_FV_FILETYPE_FFS_PAD;
+  PadFile->Attributes = 0;
+
+  //
+  // FileSize includes the EFI_FFS_FILE_HEADER
+  //
+  FileSize          = (UINTN) VtfFileImage - (UINTN) FvImage->CurrentFilePointer;
+  if (FileSize >= MAX_FFS_SIZE) {
+    PadFile->Attributes |= FFS_ATTRIB_LARGE_FILE;
+    memset(PadFile->Size, 0, sizeof(UINT8) * 3);
+    ((EFI_FFS_FILE_HEADER2 *)PadFile)->ExtendedSize = FileSize;
+    FfsHeaderSize = sizeof(EFI_FFS_FILE_HEADER2);
+    mIsLargeFfs = TRUE;
+  } else {
+    PadFile->Size[0]  = (UINT8) (FileSize & 0x000000FF);
+    PadFile->Size[1]  = (UINT8) ((FileSize & 0x0000FF00) >> 8);
+    PadFile->Size[2]  = (UINT8) ((FileSize & 0x00FF0000) >> 16);
+    FfsHeaderSize = sizeof(EFI_FFS_FILE_HEADER);
+  }
+
+  //
+  // Fill in checksums and state, must be zero during checksum calculation.
+  //
+  PadFile->IntegrityCheck.Checksum.Header = 0;
+  PadFile->IntegrityCheck.Checksum.File   = 0;
+  PadFile->State                          = 0;
+  PadFile->IntegrityCheck.Checksum.Header = CalculateChecksum8 ((UINT8 *) PadFile, FfsHeaderSize);
+  PadFile->IntegrityCheck.Checksum.File   = FFS_FIXED_CHECKSUM;
+
+  PadFile->State = EFI_FILE_HEADER_CONSTRUCTION | EFI_FILE_HEADER_VALID | EFI_FILE_DATA_VALID;
+
+  UpdateFfsFileState (
+    (EFI_FFS_FILE_HEADER *) PadFile,
+    (EFI_FIRMWARE_VOLUME_HEADER *) FvImage->FileImage
+    );
+  //
+  // Update the current FV pointer
+  //
+  FvImage->CurrentFilePointer = FvImage->Eof;
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+UpdateResetVector (
+  IN MEMORY_FILE            *FvImage,
+  IN FV_INFO                *FvInfo,
+  IN EFI_FFS_FILE_HEADER    *VtfFile
+  )
+/*++
+
+Routine Description:
+
+  This parses the FV looking for the PEI core and then plugs the address into
+  the SALE_ENTRY point of the BSF/VTF for IPF and does BUGBUG TBD action to
+  complete an IA32 Bootstrap FV.
+
+Arguments:
+
+  FvImage       Memory file for the FV memory image
+  FvInfo        Information read from INF file.
+  VtfFile       Pointer to the VTF file in the FV image.
+
+Returns:
+
+  EFI_SUCCESS             Function Completed successfully.
+  EFI_ABORTED             Error encountered.
+  EFI_INVALID_PARAMETER   A required parameter was NULL.
+  EFI_NOT_FOUND           PEI Core file not found.
+
+--*/
+{
+  EFI_FFS_FILE_HEADER       *PeiCoreFile;
+  EFI_FFS_FILE_HEADER       *SecCoreFile;
+  EFI_STATUS                Status;
+  EFI_FILE_SECTION_POINTER  Pe32Section;
+  UINT32                    EntryPoint;
+  UINT32                    BaseOfCode;
+  UINT16                    MachineType;
+  EFI_PHYSICAL_ADDRESS      PeiCorePhysicalAddress;
+  EFI_PHYSICAL_ADDRESS      SecCorePhysicalAddress;
+  EFI_PHYSICAL_ADDRESS      *SecCoreEntryAddressPtr;
+  INT32                     Ia32SecEntryOffset;
+  UINT32                    *Ia32ResetAddressPtr;
+  UINT8                     *BytePointer;
+  UINT8                     *BytePointer2;
+  UINT16                    *WordPointer;
+  UINT16                    CheckSum;
+  UINT32                    IpiVector;
+  UINTN                     Index;
+  EFI_FFS_FILE_STATE        SavedState;
+  UINT64                    FitAddress;
+  FIT_TABLE                 *FitTablePtr;
+  BOOLEAN                   Vtf0Detected;
+  UINT32                    FfsHeaderSize;
+  UINT32                    SecHeaderSize;
+
+  //
+  // Verify input parameters
+  //
+  if (FvImage == NULL || FvInfo == NULL || VtfFile == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  //
+  // Initialize FV library
+  //
+  InitializeFvLib (FvImage->FileImage, FvInfo->Size);
+
+  //
+  // Verify VTF file
+  //
+  Status = VerifyFfsFile (VtfFile);
+  if (EFI_ERROR (Status)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (
+      (((UINTN)FvImage->Eof - (UINTN)FvImage->FileImage) >=
+        IA32_X64_VTF_SIGNATURE_OFFSET) &&
+      (*(UINT32 *)(VOID*)((UINTN) FvImage->Eof -
+                                  IA32_X64_VTF_SIGNATURE_OFFSET) ==
+        IA32_X64_VTF0_SIGNATURE)
+     ) {
+    Vtf0Detected = TRUE;
+  } else {
+    Vtf0Detected = FALSE;
+  }
+
+  //
+  // Find the Sec Core
+  //
+  Status = GetFileByType (EFI_FV_FILETYPE_SECURITY_CORE, 1, &SecCoreFile);
+  if (EFI_ERROR (Status) || SecCoreFile == NULL) {
+    if (Vtf0Detected) {
+      //
+      // If the SEC core file is not found, but the VTF-0 signature
+      // is found, we'll treat it as a VTF-0 'Volume Top File'.
+      // This means no modifications are required to the VTF.
+      //
+      return EFI_SUCCESS;
+    }
+
+    Error (NULL, 0, 3000, "Invalid", "could not find the SEC core file in the FV.");
+    return EFI_ABORTED;
+  }
+  //
+  // Sec Core found, now find PE32 section
+  //
+  Status = GetSectionByType (SecCoreFile, EFI_SECTION_PE32, 1, &Pe32Section);
+  if (Status == EFI_NOT_FOUND) {
+    Status = GetSectionByType (SecCoreFile, EFI_SECTION_TE, 1, &Pe32Section);
+  }
+
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 3000, "Invalid", "could not find a PE32 section in the SEC core file.");
+    return EFI_ABORTED;
+  }
+
+  SecHeaderSize = GetSectionHeaderLength(Pe32Section.CommonHeader);
+  Status = GetPe32Info (
+            (VOID *) ((UINTN) Pe32Section.Pe32Section + SecHeaderSize),
+            &EntryPoint,
+            &BaseOfCode,
+            &MachineType
+            );
+
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 3000, "Invalid", "could not get the PE32 entry point for the SEC core.");
+    return EFI_ABORTED;
+  }  
+
+  if (
+       Vtf0Detected &&
+       (MachineType == EFI_IMAGE_MACHINE_IA32 ||
+        MachineType == EFI_IMAGE_MACHINE_X64)
+     ) {
+    //
+    // If the SEC core code is IA32 or X64 and the VTF-0 signature
+    // is found, we'll treat it as a VTF-0 'Volume Top File'.
+    // This means no modifications are required to the VTF.
+    //
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Physical address is FV base + offset of PE32 + offset of the entry point
+  //
+  SecCorePhysicalAddress = FvInfo->BaseAddress;
+  SecCorePhysicalAddress += (UINTN) Pe32Section.Pe32Section + SecHeaderSize - (UINTN) FvImage->FileImage;
+  SecCorePhysicalAddress += EntryPoint;
+  DebugMsg (NULL, 0, 9, "SecCore physical entry point address", "Address = 0x%llX", (unsigned long long) SecCorePhysicalAddress); 
+
+  //
+  // Find the PEI Core
+  //
+  Status = GetFileByType (EFI_FV_FILETYPE_PEI_CORE, 1, &PeiCoreFile);
+  if (EFI_ERROR (Status) || PeiCoreFile == NULL) {
+    Error (NULL, 0, 3000, "Invalid", "could not find the PEI core in the FV.");
+    return EFI_ABORTED;
+  }
+  //
+  // PEI Core found, now find PE32 or TE section
+  //
+  Status = GetSectionByType (PeiCoreFile, EFI_SECTION_PE32, 1, &Pe32Section);
+  if (Status == EFI_NOT_FOUND) {
+    Status = GetSectionByType (PeiCoreFile, EFI_SECTION_TE, 1, &Pe32Section);
+  }
+
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 3000, "Invalid", "could not find either a PE32 or a TE section in PEI core file.");
+    return EFI_ABORTED;
+  }
+
+  SecHeaderSize = GetSectionHeaderLength(Pe32Section.CommonHeader);
+  Status = GetPe32Info (
+            (VOID *) ((UINTN) Pe32Section.Pe32Section + SecHeaderSize),
+            &EntryPoint,
+            &BaseOfCode,
+            &MachineType
+            );
+
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 3000, "Invalid", "could not get the PE32 entry point for the PEI core.");
+    return EFI_ABORTED;
+  }
+  //
+  // Physical address is FV base + offset of PE32 + offset of the entry point
+  //
+  PeiCorePhysicalAddress = FvInfo->BaseAddress;
+  PeiCorePhysicalAddress += (UINTN) Pe32Section.Pe32Section + SecHeaderSize - (UINTN) FvImage->FileImage;
+  PeiCorePhysicalAddress += EntryPoint;
+  DebugMsg (NULL, 0, 9, "PeiCore physical entry point address", "Address = 0x%llX", (unsigned long long) PeiCorePhysicalAddress);
+
+  if (MachineType == EFI_IMAGE_MACHINE_IA64) {
+    //
+    // Update PEI_CORE address
+    //
+    //
+    // Set the uncached attribute bit in the physical address
+    //
+    PeiCorePhysicalAddress |= 0x8000000000000000ULL;
+
+    //
+    // Check if address is aligned on a 16 byte boundary
+    //
+    if (PeiCorePhysicalAddress & 0xF) {
+      Error (NULL, 0, 3000, "Invalid",
+        "PEI_CORE entry point is not aligned on a 16 byte boundary, address specified is %llXh.",
+        (unsigned long long) PeiCorePhysicalAddress
+        );
+      return EFI_ABORTED;
+    }
+    //
+    // First Get the FIT table address
+    //
+    FitAddress  = (*(UINT64 *) (FvImage->Eof - IPF_FIT_ADDRESS_OFFSET)) & 0xFFFFFFFF;
+
+    FitTablePtr = (FIT_TABLE *) (FvImage->FileImage + (FitAddress - FvInfo->BaseAddress));
+
+    Status      = UpdatePeiCoreEntryInFit (FitTablePtr, PeiCorePhysicalAddress);
+
+    if (!EFI_ERROR (Status)) {
+      UpdateFitCheckSum (FitTablePtr);
+    }
+
+    //
+    // Update SEC_CORE address
+    //
+    //
+    // Set the uncached attribute bit in the physical address
+    //
+    SecCorePhysicalAddress |= 0x8000000000000000ULL;
+    //
+    // Check if address is aligned on a 16 byte boundary
+    //
+    if (SecCorePhysicalAddress & 0xF) {
+      Error (NULL, 0, 3000, "Invalid",
+        "SALE_ENTRY entry point is not aligned on a 16 byte boundary, address specified is %llXh.",
+        (unsigned long long) SecCorePhysicalAddress
+        );
+      return EFI_ABORTED;
+    }
+    //
+    // Update the address
+    //
+    SecCoreEntryAddressPtr  = (EFI_PHYSICAL_ADDRESS *) ((UINTN) FvImage->Eof - IPF_SALE_ENTRY_ADDRESS_OFFSET);
+    *SecCoreEntryAddressPtr = SecCorePhysicalAddress;
+
+  } else if (MachineType == EFI_IMAGE_MACHINE_IA32 || MachineType == EFI_IMAGE_MACHINE_X64) {
+    //
+    // Get the location to update
+    //
+    Ia32ResetAddressPtr  = (UINT32 *) ((UINTN) FvImage->Eof - IA32_PEI_CORE_ENTRY_OFFSET);
+
+    //
+    // Write lower 32 bits of physical address for Pei Core entry
+    //
+    *Ia32ResetAddressPtr = (UINT32) PeiCorePhysicalAddress;
+    
+    //
+    // Write SecCore Entry point relative address into the jmp instruction in reset vector.
+    // 
+    Ia32ResetAddressPtr  = (UINT32 *) ((UINTN) FvImage->Eof - IA32_SEC_CORE_ENTRY_OFFSET);
+    
+    Ia32SecEntryOffset   = (INT32) (SecCorePhysicalAddress - (FV_IMAGES_TOP_ADDRESS - IA32_SEC_CORE_ENTRY_OFFSET + 2));
+    if (Ia32SecEntryOffset <= -65536) {
+      Error (NULL, 0, 3000, "Invalid", "The SEC EXE file size is too large, it must be less than 64K.");
+      return STATUS_ERROR;
+    }
+    
+    *(UINT16 *) Ia32ResetAddressPtr = (UINT16) Ia32SecEntryOffset;
+
+    //
+    // Update the BFV base address
+    //
+    Ia32ResetAddressPtr   = (UINT32 *) ((UINTN) FvImage->Eof - 4);
+    *Ia32ResetAddressPtr  = (UINT32) (FvInfo->BaseAddress);
+    DebugMsg (NULL, 0, 9, "update BFV base address in the top FV image", "BFV base address = 0x%llX.", (unsigned long long) FvInfo->BaseAddress);
+
+    //
+    // Update the Startup AP in the FVH header block ZeroVector region.
+    //
+    BytePointer   = (UINT8 *) ((UINTN) FvImage->FileImage);
+    if (FvInfo->Size <= 0x10000) {
+      BytePointer2 = m64kRecoveryStartupApDataArray;
+    } else if (FvInfo->Size <= 0x20000) {
+      BytePointer2 = m128kRecoveryStartupApDataArray;
+    } else {
+      BytePointer2 = m128kRecoveryStartupApDataArray;
+      //
+      // Find the position to place Ap reset vector, the offset
+      // between the position and the end of Fvrecovery.fv file
+      // should not exceed 128kB to prevent Ap reset vector from
+      // outside legacy E and F segment
+      //
       Status = FindApResetVectorPosition (FvImage, &BytePointer);
       if (EFI_ERROR (Status)) {
-        Error (NULL, 0, 3000, "Invalid", "FV image does not have enough space to place AP reset vector. The FV image needs to reserve at least 4KB of unused space.");
+        Error (NULL, 0, 3000, "Invalid", "FV image does not have enough space to place AP reset vector. The FV image needs to reserve at least 4KB of unused space.");
+        return EFI_ABORTED;
+      }
+    }
+
+    for (Index = 0; Index < SIZEOF_STARTUP_DATA_ARRAY; Index++) {
+      BytePointer[Index] = BytePointer2[Index];
+    }
+    //
+    // Calculate the checksum
+    //
+    CheckSum              = 0x0000;
+    WordPointer = (UINT16 *) (BytePointer);
+    for (Index = 0; Index < SIZEOF_STARTUP_DATA_ARRAY / 2; Index++) {
+      CheckSum = (UINT16) (CheckSum + ((UINT16) *WordPointer));
+      WordPointer++;
+    }
+    //
+    // Update the checksum field
+    //
+    WordPointer   = (UINT16 *) (BytePointer + SIZEOF_STARTUP_DATA_ARRAY - 2);
+    *WordPointer  = (UINT16) (0x10000 - (UINT32) CheckSum);
+    
+    //
+    // IpiVector at the 4k aligned address in the top 2 blocks in the PEI FV. 
+    //
+    IpiVector  = (UINT32) (FV_IMAGES_TOP_ADDRESS - ((UINTN) FvImage->Eof - (UINTN) BytePointer));
+    DebugMsg (NULL, 0, 9, "Startup AP Vector address", "IpiVector at 0x%X", (unsigned) IpiVector);
+    if ((IpiVector & 0xFFF) != 0) {
+      Error (NULL, 0, 3000, "Invalid", "Startup AP Vector address are not 4K aligned, because the FV size is not 4K aligned");
+      return EFI_ABORTED;
+    }
+    IpiVector  = IpiVector >> 12;
+    IpiVector  = IpiVector & 0xFF;
+
+    //
+    // Write IPI Vector at Offset FvrecoveryFileSize - 8
+    //
+    Ia32ResetAddressPtr   = (UINT32 *) ((UINTN) FvImage->Eof - 8);
+    *Ia32ResetAddressPtr  = IpiVector;
+  } else if (MachineType == EFI_IMAGE_MACHINE_ARMT) {
+    //
+    // Since the ARM reset vector is in the FV Header you really don't need a
+    // Volume Top File, but if you have one for some reason don't crash...
+    //
+  } else if (MachineType == EFI_IMAGE_MACHINE_AARCH64) {
+    //
+    // Since the AArch64 reset vector is in the FV Header you really don't need a
+    // Volume Top File, but if you have one for some reason don't crash...
+    //
+  } else {
+    Error (NULL, 0, 3000, "Invalid", "machine type=0x%X in PEI core.", MachineType);
+    return EFI_ABORTED;
+  }
+
+  //
+  // Now update file checksum
+  //
+  SavedState  = VtfFile->State;
+  VtfFile->IntegrityCheck.Checksum.File = 0;
+  VtfFile->State                        = 0;
+  if (VtfFile->Attributes & FFS_ATTRIB_CHECKSUM) {
+    FfsHeaderSize = GetFfsHeaderLength(VtfFile);
+    VtfFile->IntegrityCheck.Checksum.File = CalculateChecksum8 (
+                                              (UINT8 *) ((UINT8 *)VtfFile + FfsHeaderSize),
+                                              GetFfsFileLength (VtfFile) - FfsHeaderSize
+                                              );
+  } else {
+    VtfFile->IntegrityCheck.Checksum.File = FFS_FIXED_CHECKSUM;
+  }
+
+  VtfFile->State = SavedState;
+
+  return EFI_SUCCESS;
+}
+
+
+EFI_STATUS
+UpdateArmResetVectorIfNeeded (
+  IN MEMORY_FILE            *FvImage,
+  IN FV_INFO                *FvInfo
+  )
+/*++
+
+Routine Description:
+  This parses the FV looking for SEC and patches that address into the 
+  beginning of the FV header.
+
+  For ARM32 the reset vector is at 0x00000000 or 0xFFFF0000.
+  For AArch64 the reset vector is at 0x00000000.
+
+  This would commonly map to the first entry in the ROM. 
+  ARM32 Exceptions:
+  Reset            +0    
+  Undefined        +4
+  SWI              +8
+  Prefetch Abort   +12
+  Data Abort       +16
+  IRQ              +20
+  FIQ              +24
+
+  We support two schemes on ARM.
+  1) Beginning of the FV is the reset vector
+  2) Reset vector is data bytes FDF file and that code branches to reset vector 
+    in the beginning of the FV (fixed size offset).
+
+  Need to have the jump for the reset vector at location zero.
+  We also need to store the address or PEI (if it exists).
+  We stub out a return from interrupt in case the debugger 
+   is using SWI (not done for AArch64, not enough space in struct).
+  The optional entry to the common exception handler is 
+   to support full featured exception handling from ROM and is currently 
+    not support by this tool.
+
+Arguments:
+  FvImage       Memory file for the FV memory image
+  FvInfo        Information read from INF file.
+
+Returns:
+
+  EFI_SUCCESS             Function Completed successfully.
+  EFI_ABORTED             Error encountered.
+  EFI_INVALID_PARAMETER   A required parameter was NULL.
+  EFI_NOT_FOUND           PEI Core file not found.
+
+--*/
+{
+  EFI_FFS_FILE_HEADER       *PeiCoreFile;
+  EFI_FFS_FILE_HEADER       *SecCoreFile;
+  EFI_STATUS                Status;
+  EFI_FILE_SECTION_POINTER  Pe32Section;
+  UINT32                    EntryPoint;
+  UINT32                    BaseOfCode;
+  UINT16                    MachineType;
+  EFI_PHYSICAL_ADDRESS      PeiCorePhysicalAddress;
+  EFI_PHYSICAL_ADDRESS      SecCorePhysicalAddress;
+  INT32                     ResetVector[4]; // ARM32:
+                                            // 0 - is branch relative to SEC entry point
+                                            // 1 - PEI Entry Point
+                                            // 2 - movs pc,lr for a SWI handler
+                                            // 3 - Place holder for Common Exception Handler
+                                            // AArch64: Used as UINT64 ResetVector[2]
+                                            // 0 - is branch relative to SEC entry point
+                                            // 1 - PEI Entry Point
+
+  //
+  // Verify input parameters
+  //
+  if (FvImage == NULL || FvInfo == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  //
+  // Initialize FV library
+  //
+  InitializeFvLib (FvImage->FileImage, FvInfo->Size);
+
+  //
+  // Find the Sec Core
+  //
+  Status = GetFileByType (EFI_FV_FILETYPE_SECURITY_CORE, 1, &SecCoreFile);
+  if (EFI_ERROR (Status) || SecCoreFile == NULL) {
+    //
+    // Maybe hardware does SEC job and we only have PEI Core?
+    //
+
+    //
+    // Find the PEI Core. It may not exist if SEC loads DXE core directly
+    //
+    PeiCorePhysicalAddress = 0;
+    Status = GetFileByType (EFI_FV_FILETYPE_PEI_CORE, 1, &PeiCoreFile);
+    if (!EFI_ERROR (Status) && PeiCoreFile != NULL) {
+      //
+      // PEI Core found, now find PE32 or TE section
+      //
+      Status = GetSectionByType (PeiCoreFile, EFI_SECTION_PE32, 1, &Pe32Section);
+      if (Status == EFI_NOT_FOUND) {
+        Status = GetSectionByType (PeiCoreFile, EFI_SECTION_TE, 1, &Pe32Section);
+      }
+    
+      if (EFI_ERROR (Status)) {
+        Error (NULL, 0, 3000, "Invalid", "could not find either a PE32 or a TE section in PEI core file!");
+        return EFI_ABORTED;
+      }
+    
+      Status = GetPe32Info (
+                (VOID *) ((UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader)),
+                &EntryPoint,
+                &BaseOfCode,
+                &MachineType
+                );
+    
+      if (EFI_ERROR (Status)) {
+        Error (NULL, 0, 3000, "Invalid", "could not get the PE32 entry point for the PEI core!");
         return EFI_ABORTED;
       }
+      //
+      // Physical address is FV base + offset of PE32 + offset of the entry point
+      //
+      PeiCorePhysicalAddress = FvInfo->BaseAddress;
+      PeiCorePhysicalAddress += (UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader) - (UINTN) FvImage->FileImage;
+      PeiCorePhysicalAddress += EntryPoint;
+      DebugMsg (NULL, 0, 9, "PeiCore physical entry point address", "Address = 0x%llX", (unsigned long long) PeiCorePhysicalAddress);
+
+      if (MachineType == EFI_IMAGE_MACHINE_ARMT || MachineType == EFI_IMAGE_MACHINE_AARCH64) {
+        memset (ResetVector, 0, sizeof (ResetVector));
+        // Address of PEI Core, if we have one
+        ResetVector[1] = (UINT32)PeiCorePhysicalAddress;
+      }
+      
+      //
+      // Copy to the beginning of the FV 
+      //
+      memcpy ((UINT8 *) ((UINTN) FvImage->FileImage), ResetVector, sizeof (ResetVector));
+
+    }
+
+    return EFI_SUCCESS;
+  }
+  
+  //
+  // Sec Core found, now find PE32 section
+  //
+  Status = GetSectionByType (SecCoreFile, EFI_SECTION_PE32, 1, &Pe32Section);
+  if (Status == EFI_NOT_FOUND) {
+    Status = GetSectionByType (SecCoreFile, EFI_SECTION_TE, 1, &Pe32Section);
+  }
+
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 3000, "Invalid", "could not find a PE32 section in the SEC core file.");
+    return EFI_ABORTED;
+  }
+
+  Status = GetPe32Info (
+            (VOID *) ((UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader)),
+            &EntryPoint,
+            &BaseOfCode,
+            &MachineType
+            );
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 3000, "Invalid", "could not get the PE32 entry point for the SEC core.");
+    return EFI_ABORTED;
+  }
+  
+  if ((MachineType != EFI_IMAGE_MACHINE_ARMT) && (MachineType != EFI_IMAGE_MACHINE_AARCH64)) {
+    //
+    // If SEC is not ARM we have nothing to do
+    //
+    return EFI_SUCCESS;
+  }
+  
+  //
+  // Physical address is FV base + offset of PE32 + offset of the entry point
+  //
+  SecCorePhysicalAddress = FvInfo->BaseAddress;
+  SecCorePhysicalAddress += (UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader) - (UINTN) FvImage->FileImage;
+  SecCorePhysicalAddress += EntryPoint;
+  DebugMsg (NULL, 0, 9, "SecCore physical entry point address", "Address = 0x%llX", (unsigned long long) SecCorePhysicalAddress); 
+
+  //
+  // Find the PEI Core. It may not exist if SEC loads DXE core directly
+  //
+  PeiCorePhysicalAddress = 0;
+  Status = GetFileByType (EFI_FV_FILETYPE_PEI_CORE, 1, &PeiCoreFile);
+  if (!EFI_ERROR (Status) && PeiCoreFile != NULL) {
+    //
+    // PEI Core found, now find PE32 or TE section
+    //
+    Status = GetSectionByType (PeiCoreFile, EFI_SECTION_PE32, 1, &Pe32Section);
+    if (Status == EFI_NOT_FOUND) {
+      Status = GetSectionByType (PeiCoreFile, EFI_SECTION_TE, 1, &Pe32Section);
+    }
+  
+    if (EFI_ERROR (Status)) {
+      Error (NULL, 0, 3000, "Invalid", "could not find either a PE32 or a TE section in PEI core file!");
+      return EFI_ABORTED;
+    }
+  
+    Status = GetPe32Info (
+              (VOID *) ((UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader)),
+              &EntryPoint,
+              &BaseOfCode,
+              &MachineType
+              );
+  
+    if (EFI_ERROR (Status)) {
+      Error (NULL, 0, 3000, "Invalid", "could not get the PE32 entry point for the PEI core!");
+      return EFI_ABORTED;
+    }
+    //
+    // Physical address is FV base + offset of PE32 + offset of the entry point
+    //
+    PeiCorePhysicalAddress = FvInfo->BaseAddress;
+    PeiCorePhysicalAddress += (UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader) - (UINTN) FvImage->FileImage;
+    PeiCorePhysicalAddress += EntryPoint;
+    DebugMsg (NULL, 0, 9, "PeiCore physical entry point address", "Address = 0x%llX", (unsigned long long) PeiCorePhysicalAddress);
+  }
+  
+  if (MachineType == EFI_IMAGE_MACHINE_ARMT) {
+    // B SecEntryPoint - signed_immed_24 part +/-32MB offset
+    // on ARM, the PC is always 8 ahead, so we're not really jumping from the base address, but from base address + 8
+    ResetVector[0] = (INT32)(SecCorePhysicalAddress - FvInfo->BaseAddress - 8) >> 2;
+
+    if (ResetVector[0] > 0x00FFFFFF) {
+      Error (NULL, 0, 3000, "Invalid", "SEC Entry point must be within 32MB of the start of the FV");
+      return EFI_ABORTED;
+    }
+  
+    // Add opcode for an uncondional branch with no link. AKA B SecEntryPoint
+    ResetVector[0] |= 0xEB000000;
+  
+  
+    // Address of PEI Core, if we have one
+    ResetVector[1] = (UINT32)PeiCorePhysicalAddress;
+  
+    // SWI handler movs   pc,lr. Just in case a debugger uses SWI
+    ResetVector[2] = 0xE1B0F07E;
+  
+    // Place holder to support a common interrupt handler from ROM.
+    // Currently not suppprted. For this to be used the reset vector would not be in this FV
+    // and the exception vectors would be hard coded in the ROM and just through this address
+    // to find a common handler in the a module in the FV.
+    ResetVector[3] = 0;
+  } else if (MachineType == EFI_IMAGE_MACHINE_AARCH64) {
+
+  /* NOTE:
+    ARMT above has an entry in ResetVector[2] for SWI. The way we are using the ResetVector
+    array at the moment, for AArch64, does not allow us space for this as the header only
+    allows for a fixed amount of bytes at the start. If we are sure that UEFI will live
+    within the first 4GB of addressable RAM we could potensioally adopt the same ResetVector
+    layout as above. But for the moment we replace the four 32bit vectors with two 64bit
+    vectors in the same area of the Image heasder. This allows UEFI to start from a 64bit
+    base.
+  */
+
+    ((UINT64*)ResetVector)[0] = (UINT64)(SecCorePhysicalAddress - FvInfo->BaseAddress) >> 2;
+
+    // B SecEntryPoint - signed_immed_26 part +/-128MB offset
+    if ( ((UINT64*)ResetVector)[0] > 0x03FFFFFF) {
+      Error (NULL, 0, 3000, "Invalid", "SEC Entry point must be within 128MB of the start of the FV");
+      return EFI_ABORTED;
     }
+    // Add opcode for an uncondional branch with no link. AKA B SecEntryPoint
+    ((UINT64*)ResetVector)[0] |= 0x14000000;
+
+    // Address of PEI Core, if we have one
+    ((UINT64*)ResetVector)[1] = (UINT64)PeiCorePhysicalAddress;
+
+  } else {
+    Error (NULL, 0, 3000, "Invalid", "Unknown ARM machine type");
+    return EFI_ABORTED;
+  }
+
+  //
+  // Copy to the beginning of the FV 
+  //
+  memcpy ((UINT8 *) ((UINTN) FvImage->FileImage), ResetVector, sizeof (ResetVector));
+
+  DebugMsg (NULL, 0, 9, "Update Reset vector in FV Header", NULL);
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+GetPe32Info (
+  IN UINT8                  *Pe32,
+  OUT UINT32                *EntryPoint,
+  OUT UINT32                *BaseOfCode,
+  OUT UINT16                *MachineType
+  )
+/*++
 
-    for (Index = 0; Index < SIZEOF_STARTUP_DATA_ARRAY; Index++) {
-      BytePointer[Index] = BytePointer2[Index];
-    }
+Routine Description:
+
+  Retrieves the PE32 entry point offset and machine type from PE image or TeImage.  
+  See EfiImage.h for machine types.  The entry point offset is from the beginning 
+  of the PE32 buffer passed in.
+
+Arguments:
+
+  Pe32          Beginning of the PE32.
+  EntryPoint    Offset from the beginning of the PE32 to the image entry point.
+  BaseOfCode    Base address of code.
+  MachineType   Magic number for the machine type.
+
+Returns:
+
+  EFI_SUCCESS             Function completed successfully.
+  EFI_ABORTED             Error encountered.
+  EFI_INVALID_PARAMETER   A required parameter was NULL.
+  EFI_UNSUPPORTED         The operation is unsupported.
+
+--*/
+{
+  EFI_IMAGE_DOS_HEADER             *DosHeader;
+  EFI_IMAGE_OPTIONAL_HEADER_UNION  *ImgHdr;
+  EFI_TE_IMAGE_HEADER              *TeHeader;
+
+  //
+  // Verify input parameters
+  //
+  if (Pe32 == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // First check whether it is one TE Image.
+  //
+  TeHeader = (EFI_TE_IMAGE_HEADER *) Pe32;
+  if (TeHeader->Signature == EFI_TE_IMAGE_HEADER_SIGNATURE) {
     //
-    // Calculate the checksum
+    // By TeImage Header to get output
     //
-    CheckSum              = 0x0000;
-    WordPointer = (UINT16 *) (BytePointer);
-    for (Index = 0; Index < SIZEOF_STARTUP_DATA_ARRAY / 2; Index++) {
-      CheckSum = (UINT16) (CheckSum + ((UINT16) *WordPointer));
-      WordPointer++;
-    }
+    *EntryPoint   = TeHeader->AddressOfEntryPoint + sizeof (EFI_TE_IMAGE_HEADER) - TeHeader->StrippedSize;
+    *BaseOfCode   = TeHeader->BaseOfCode + sizeof (EFI_TE_IMAGE_HEADER) - TeHeader->StrippedSize;
+    *MachineType  = TeHeader->Machine;
+  } else {
+  
     //
-    // Update the checksum field
+    // Then check whether 
+    // First is the DOS header
     //
-    WordPointer   = (UINT16 *) (BytePointer + SIZEOF_STARTUP_DATA_ARRAY - 2);
-    *WordPointer  = (UINT16) (0x10000 - (UINT32) CheckSum);
-    
+    DosHeader = (EFI_IMAGE_DOS_HEADER *) Pe32;
+  
     //
-    // IpiVector at the 4k aligned address in the top 2 blocks in the PEI FV. 
+    // Verify DOS header is expected
     //
-    IpiVector  = (UINT32) (FV_IMAGES_TOP_ADDRESS - ((UINTN) FvImage->Eof - (UINTN) BytePointer));
-    DebugMsg (NULL, 0, 9, "Startup AP Vector address", "IpiVector at 0x%X", (unsigned) IpiVector);
-    if ((IpiVector & 0xFFF) != 0) {
-      Error (NULL, 0, 3000, "Invalid", "Startup AP Vector address are not 4K aligned, because the FV size is not 4K aligned");
-      return EFI_ABORTED;
+    if (DosHeader->e_magic != EFI_IMAGE_DOS_SIGNATURE) {
+      Error (NULL, 0, 3000, "Invalid", "Unknown magic number in the DOS header, 0x%04X.", DosHeader->e_magic);
+      return EFI_UNSUPPORTED;
     }
-    IpiVector  = IpiVector >> 12;
-    IpiVector  = IpiVector & 0xFF;
-
     //
-    // Write IPI Vector at Offset FvrecoveryFileSize - 8
+    // Immediately following is the NT header.
     //
-    Ia32ResetAddressPtr   = (UINT32 *) ((UINTN) FvImage->Eof - 8);
-    *Ia32ResetAddressPtr  = IpiVector;
-  } else if (MachineType == EFI_IMAGE_MACHINE_ARMT) {
+    ImgHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *) ((UINTN) Pe32 + DosHeader->e_lfanew);
+  
     //
-    // Since the ARM reset vector is in the FV Header you really don't need a
-    // Volume Top File, but if you have one for some reason don't crash...
+    // Verify NT header is expected
     //
-  } else if (MachineType == EFI_IMAGE_MACHINE_AARCH64) {
+    if (ImgHdr->Pe32.Signature != EFI_IMAGE_NT_SIGNATURE) {
+      Error (NULL, 0, 3000, "Invalid", "Unrecognized image signature 0x%08X.", (unsigned) ImgHdr->Pe32.Signature);
+      return EFI_UNSUPPORTED;
+    }
     //
-    // Since the AArch64 reset vector is in the FV Header you really don't need a
-    // Volume Top File, but if you have one for some reason don't crash...
+    // Get output
     //
-  } else {
-    Error (NULL, 0, 3000, "Invalid", "machine type=0x%X in PEI core.", MachineType);
-    return EFI_ABORTED;
+    *EntryPoint   = ImgHdr->Pe32.OptionalHeader.AddressOfEntryPoint;
+    *BaseOfCode   = ImgHdr->Pe32.OptionalHeader.BaseOfCode;
+    *MachineType  = ImgHdr->Pe32.FileHeader.Machine;
   }
 
   //
-  // Now update file checksum
+  // Verify machine type is supported
   //
-  SavedState  = VtfFile->State;
-  VtfFile->IntegrityCheck.Checksum.File = 0;
-  VtfFile->State                        = 0;
-  if (VtfFile->Attributes & FFS_ATTRIB_CHECKSUM) {
-    FfsHeaderSize = GetFfsHeaderLength(VtfFile);
-    VtfFile->IntegrityCheck.Checksum.File = CalculateChecksum8 (
-                                              (UINT8 *) ((UINT8 *)VtfFile + FfsHeaderSize),
-                                              GetFfsFileLength (VtfFile) - FfsHeaderSize
-                                              );
-  } else {
-    VtfFile->IntegrityCheck.Checksum.File = FFS_FIXED_CHECKSUM;
+  if ((*MachineType != EFI_IMAGE_MACHINE_IA32) && (*MachineType != EFI_IMAGE_MACHINE_IA64) && (*MachineType != EFI_IMAGE_MACHINE_X64) && (*MachineType != EFI_IMAGE_MACHINE_EBC) && 
+      (*MachineType != EFI_IMAGE_MACHINE_ARMT) && (*MachineType != EFI_IMAGE_MACHINE_AARCH64)) {
+    Error (NULL, 0, 3000, "Invalid", "Unrecognized machine type in the PE32 file.");
+    return EFI_UNSUPPORTED;
+  }
+
+  return EFI_SUCCESS;
+}
+
+//
+// Flags of an FFS file recorded in the FV report file
+//
+#define FV_FILE_STAMP_FLAG_ARM    0x1
+
+//
+// A file of the FV built by a previous run, as listed in its report file,
+// and how it compares with the file given now.
+//
+typedef struct {
+  UINTN     Offset;
+  CHAR8     Guid[PRINTED_GUID_BUFFER_SIZE];
+  UINT64    StampSize;
+  UINT8     StampDigest[SHA256_DIGEST_SIZE];
+  UINT32    StampFlags;
+  UINTN     OldSize;
+  UINTN     NewSize;
+  UINT32    Alignment;
+  BOOLEAN   Changed;
+  UINTN     MapEntryFirst;
+  UINTN     MapEntryEnd;
+  UINTN     DirtyEnd;
+} FV_PREVIOUS_FILE;
+
+//
+// The entries written by WriteMapFile for one image, in a previous FV map
+// file. Guid points to the printed file GUID within Text.
+//
+typedef struct {
+  CHAR8     *Text;
+  UINTN     Length;
+  CHAR8     *Guid;
+} FV_MAP_ENTRY;
+
+STATIC
+VOID
+WriteFvSizeInfo (
+  IN FILE                     *FvMapFile,
+  IN FILE                     *FvReportFile
+  )
+/*++
+
+Routine Description:
+
+  Record the FV size information at the start of the FV map and report files.
+
+Arguments:
+
+  FvMapFile     Pointer to FvMap File
+  FvReportFile  Pointer to FvReport File
+
+Returns:
+
+  None
+
+--*/
+{
+  //
+  // record FV size information into FvMap file.
+  //
+  if (mFvTotalSize != 0) {
+    fprintf (FvMapFile, EFI_FV_TOTAL_SIZE_STRING);
+    fprintf (FvMapFile, " = 0x%x\n", (unsigned) mFvTotalSize);
+  }
+  if (mFvTakenSize != 0) {
+    fprintf (FvMapFile, EFI_FV_TAKEN_SIZE_STRING);
+    fprintf (FvMapFile, " = 0x%x\n", (unsigned) mFvTakenSize);
+  }
+  if (mFvTotalSize != 0 && mFvTakenSize != 0) {
+    fprintf (FvMapFile, EFI_FV_SPACE_SIZE_STRING);
+    fprintf (FvMapFile, " = 0x%x\n\n", (unsigned) (mFvTotalSize - mFvTakenSize));
+  }
+
+  //
+  // record FV size information to FvReportFile.
+  //
+  fprintf (FvReportFile, "%s = 0x%x\n", EFI_FV_TOTAL_SIZE_STRING, (unsigned) mFvTotalSize);
+  fprintf (FvReportFile, "%s = 0x%x\n", EFI_FV_TAKEN_SIZE_STRING, (unsigned) mFvTakenSize);
+}
+
+STATIC
+VOID
+GetFvBuildSignature (
+  IN  FV_INFO                         *FvInfo,
+  IN  EFI_FIRMWARE_VOLUME_EXT_HEADER  *FvExtHeader,
+  OUT UINT8                           *Signature
+  )
+/*++
+
+Routine Description:
+
+  Compute the signature of all the FV depends on except the contents of its
+  FFS files: the FV options, the block map, the extension header and the
+  files in the order they are placed. An FV is only updated in place when
+  its previous build had the same signature.
+
+Arguments:
+
+  FvInfo        Pointer to information about the FV.
+  FvExtHeader   The FV extension header, or NULL if there is none.
+  Signature     Receives the SHA256_DIGEST_SIZE byte signature.
+
+Returns:
+
+  None
+
+--*/
+{
+  SHA256_CONTEXT  Context;
+  UINT64          Values[7];
+  UINTN           Index;
+
+  Values[0] = FvInfo->BaseAddress;
+  Values[1] = (UINT64) (INT64) FvInfo->ForceRebase;
+  Values[2] = FvInfo->FvAttributes;
+  Values[3] = FvInfo->Size;
+  Values[4] = FvInfo->IsPiFvImage;
+  Values[5] = FvInfo->PackFiles;
+  Values[6] = FvInfo->FvNameGuidSet;
+
+  Sha256Init (&Context);
+  Sha256Update (&Context, "GenFv FV build 1", sizeof ("GenFv FV build 1"));
+  Sha256Update (&Context, Values, sizeof (Values));
+  Sha256Update (&Context, &FvInfo->FvFileSystemGuid, sizeof (EFI_GUID));
+  if (FvInfo->FvNameGuidSet) {
+    Sha256Update (&Context, &FvInfo->FvNameGuid, sizeof (EFI_GUID));
+  }
+  for (Index = 0; FvInfo->FvBlocks[Index].Length != 0; Index++) {
+    Sha256Update (&Context, &FvInfo->FvBlocks[Index], sizeof (EFI_FV_BLOCK_MAP_ENTRY));
+  }
+  if (FvExtHeader != NULL) {
+    Sha256Update (&Context, FvExtHeader, FvExtHeader->ExtHeaderSize);
+  }
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    Sha256Update (&Context, FvInfo->FvFiles[Index], strlen (FvInfo->FvFiles[Index]) + 1);
+    Sha256Update (&Context, &FvInfo->SizeofFvFiles[Index], sizeof (UINT32));
+  }
+  Sha256Final (&Context, Signature);
+}
+
+STATIC
+VOID
+GetFvImageDigest (
+  IN  UINT8                   *FvImage,
+  IN  UINTN                   FvSize,
+  OUT UINT8                   *Digest
+  )
+/*++
+
+Routine Description:
+
+  Compute the digest of an emitted FV image, which lets the next
+  incremental build detect an FV file changed behind its back.
+
+Arguments:
+
+  FvImage       The FV image.
+  FvSize        The size of the FV image.
+  Digest        Receives the SHA256_DIGEST_SIZE byte digest.
+
+Returns:
+
+  None
+
+--*/
+{
+  SHA256_CONTEXT  Context;
+
+  Sha256Init (&Context);
+  Sha256Update (&Context, FvImage, FvSize);
+  Sha256Final (&Context, Digest);
+}
+
+STATIC
+BOOLEAN
+ReadHexDigest (
+  IN  CHAR8                   *Text,
+  OUT UINT8                   *Digest
+  )
+/*++
+
+Routine Description:
+
+  Read a SHA256_DIGEST_SIZE byte digest written in hex by WriteFvBuildRecord.
+
+Arguments:
+
+  Text          The hex digits.
+  Digest        Receives the digest.
+
+Returns:
+
+  TRUE if Text starts with a complete digest, FALSE otherwise.
+
+--*/
+{
+  UINTN     Index;
+  unsigned  Number;
+
+  if (strspn (Text, "0123456789abcdefABCDEF") < SHA256_DIGEST_SIZE * 2) {
+    return FALSE;
+  }
+  for (Index = 0; Index < SHA256_DIGEST_SIZE; Index++) {
+    if (sscanf (Text + Index * 2, "%2x", &Number) != 1) {
+      return FALSE;
+    }
+    Digest[Index] = (UINT8) Number;
+  }
+  return TRUE;
+}
+
+STATIC
+VOID
+WriteFvBuildRecord (
+  IN FILE                     *FvReportFile,
+  IN FV_INFO                  *FvInfo,
+  IN UINT8                    *Signature,
+  IN UINT8                    *FvDigest
+  )
+/*++
+
+Routine Description:
+
+  Append the build record used by the next incremental build to the FV
+  report file: the build signature, the digest of the FV image, then the
+  size, digest and flags of each file. The values are not written in hex
+  with a 0x prefix, which would make them look like file offsets to the
+  readers of the report file.
+
+Arguments:
+
+  FvReportFile  Pointer to FvReport File
+  FvInfo        Pointer to information about the FV.
+  Signature     The signature from GetFvBuildSignature.
+  FvDigest      The digest of the FV image from GetFvImageDigest.
+
+Returns:
+
+  None
+
+--*/
+{
+  UINTN   Index;
+  UINTN   Byte;
+
+  fprintf (FvReportFile, "%s = ", EFI_FV_BUILD_SIGNATURE_STRING);
+  for (Index = 0; Index < SHA256_DIGEST_SIZE; Index++) {
+    fprintf (FvReportFile, "%02x", Signature[Index]);
   }
+  fprintf (FvReportFile, "\n");
 
-  VtfFile->State = SavedState;
+  fprintf (FvReportFile, "%s = ", EFI_FV_IMAGE_DIGEST_STRING);
+  for (Index = 0; Index < SHA256_DIGEST_SIZE; Index++) {
+    fprintf (FvReportFile, "%02x", FvDigest[Index]);
+  }
+  fprintf (FvReportFile, "\n");
 
-  return EFI_SUCCESS;
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    fprintf (FvReportFile, "%s = %llu ", EFI_FV_FILE_STAMP_STRING, (unsigned long long) mFileStamps[Index].Size);
+    for (Byte = 0; Byte < SHA256_DIGEST_SIZE; Byte++) {
+      fprintf (FvReportFile, "%02x", mFileStamps[Index].Digest[Byte]);
+    }
+    fprintf (FvReportFile, " %u\n", (unsigned) (mFileIsArm[Index] ? FV_FILE_STAMP_FLAG_ARM : 0));
+  }
 }
 
-
+STATIC
 EFI_STATUS
-UpdateArmResetVectorIfNeeded (
-  IN MEMORY_FILE            *FvImage,
-  IN FV_INFO                *FvInfo
+ReadFvBuildRecord (
+  IN  CHAR8                   *FvReportName,
+  IN  UINTN                   FileCount,
+  OUT FV_PREVIOUS_FILE        *Files,
+  OUT UINT8                   *Signature,
+  OUT UINT8                   *FvDigest
   )
 /*++
 
 Routine Description:
-  This parses the FV looking for SEC and patches that address into the 
-  beginning of the FV header.
-
-  For ARM32 the reset vector is at 0x00000000 or 0xFFFF0000.
-  For AArch64 the reset vector is at 0x00000000.
-
-  This would commonly map to the first entry in the ROM. 
-  ARM32 Exceptions:
-  Reset            +0    
-  Undefined        +4
-  SWI              +8
-  Prefetch Abort   +12
-  Data Abort       +16
-  IRQ              +20
-  FIQ              +24
-
-  We support two schemes on ARM.
-  1) Beginning of the FV is the reset vector
-  2) Reset vector is data bytes FDF file and that code branches to reset vector 
-    in the beginning of the FV (fixed size offset).
 
-  Need to have the jump for the reset vector at location zero.
-  We also need to store the address or PEI (if it exists).
-  We stub out a return from interrupt in case the debugger 
-   is using SWI (not done for AArch64, not enough space in struct).
-  The optional entry to the common exception handler is 
-   to support full featured exception handling from ROM and is currently 
-    not support by this tool.
+  Read the file offsets and GUIDs and the build record from the report file
+  of the previous build of the FV.
 
 Arguments:
-  FvImage       Memory file for the FV memory image
-  FvInfo        Information read from INF file.
+
+  FvReportName  The FV report file.
+  FileCount     The number of files in the FV.
+  Files         Receives the offset, GUID and stamp of each file.
+  Signature     Receives the signature of the previous build.
+  FvDigest      Receives the digest of the FV image the previous build wrote.
 
 Returns:
 
-  EFI_SUCCESS             Function Completed successfully.
-  EFI_ABORTED             Error encountered.
-  EFI_INVALID_PARAMETER   A required parameter was NULL.
-  EFI_NOT_FOUND           PEI Core file not found.
+  EFI_SUCCESS              The report file has a build record for FileCount files.
+  EFI_NOT_FOUND            The report file or its build record is missing or
+                           does not match.
 
 --*/
 {
-  EFI_FFS_FILE_HEADER       *PeiCoreFile;
-  EFI_FFS_FILE_HEADER       *SecCoreFile;
-  EFI_STATUS                Status;
-  EFI_FILE_SECTION_POINTER  Pe32Section;
-  UINT32                    EntryPoint;
-  UINT32                    BaseOfCode;
-  UINT16                    MachineType;
-  EFI_PHYSICAL_ADDRESS      PeiCorePhysicalAddress;
-  EFI_PHYSICAL_ADDRESS      SecCorePhysicalAddress;
-  INT32                     ResetVector[4]; // ARM32:
-                                            // 0 - is branch relative to SEC entry point
-                                            // 1 - PEI Entry Point
-                                            // 2 - movs pc,lr for a SWI handler
-                                            // 3 - Place holder for Common Exception Handler
-                                            // AArch64: Used as UINT64 ResetVector[2]
-                                            // 0 - is branch relative to SEC entry point
-                                            // 1 - PEI Entry Point
-
-  //
-  // Verify input parameters
-  //
-  if (FvImage == NULL || FvInfo == NULL) {
-    return EFI_INVALID_PARAMETER;
+  FILE                *FvReportFile;
+  CHAR8               Line[MAX_LINE_LEN];
+  CHAR8               Value[MAX_LINE_LEN];
+  CHAR8               *Cptr;
+  UINTN               FileIndex;
+  UINTN               StampIndex;
+  BOOLEAN             Valid;
+  BOOLEAN             SignatureFound;
+  BOOLEAN             DigestFound;
+  unsigned            Number;
+  unsigned long long  StampSize;
+  int                 Consumed;
+
+  FvReportFile = fopen (FvReportName, "r");
+  if (FvReportFile == NULL) {
+    return EFI_NOT_FOUND;
   }
-  //
-  // Initialize FV library
-  //
-  InitializeFvLib (FvImage->FileImage, FvInfo->Size);
-
-  //
-  // Find the Sec Core
-  //
-  Status = GetFileByType (EFI_FV_FILETYPE_SECURITY_CORE, 1, &SecCoreFile);
-  if (EFI_ERROR (Status) || SecCoreFile == NULL) {
-    //
-    // Maybe hardware does SEC job and we only have PEI Core?
-    //
 
-    //
-    // Find the PEI Core. It may not exist if SEC loads DXE core directly
-    //
-    PeiCorePhysicalAddress = 0;
-    Status = GetFileByType (EFI_FV_FILETYPE_PEI_CORE, 1, &PeiCoreFile);
-    if (!EFI_ERROR (Status) && PeiCoreFile != NULL) {
-      //
-      // PEI Core found, now find PE32 or TE section
-      //
-      Status = GetSectionByType (PeiCoreFile, EFI_SECTION_PE32, 1, &Pe32Section);
-      if (Status == EFI_NOT_FOUND) {
-        Status = GetSectionByType (PeiCoreFile, EFI_SECTION_TE, 1, &Pe32Section);
-      }
-    
-      if (EFI_ERROR (Status)) {
-        Error (NULL, 0, 3000, "Invalid", "could not find either a PE32 or a TE section in PEI core file!");
-        return EFI_ABORTED;
+  FileIndex      = 0;
+  StampIndex     = 0;
+  Valid          = TRUE;
+  SignatureFound = FALSE;
+  DigestFound    = FALSE;
+  while (Valid && fgets (Line, sizeof (Line), FvReportFile) != NULL) {
+    if (strncmp (Line, "0x", 2) == 0) {
+      if (FileIndex == FileCount ||
+          sscanf (Line, "%x %36s", &Number, Value) != 2 ||
+          strlen (Value) != PRINTED_GUID_BUFFER_SIZE - 1) {
+        Valid = FALSE;
+        break;
       }
-    
-      Status = GetPe32Info (
-                (VOID *) ((UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader)),
-                &EntryPoint,
-                &BaseOfCode,
-                &MachineType
-                );
-    
-      if (EFI_ERROR (Status)) {
-        Error (NULL, 0, 3000, "Invalid", "could not get the PE32 entry point for the PEI core!");
-        return EFI_ABORTED;
+      Files[FileIndex].Offset = Number;
+      strcpy (Files[FileIndex].Guid, Value);
+      FileIndex++;
+    } else if (strncmp (Line, EFI_FV_BUILD_SIGNATURE_STRING " = ", sizeof (EFI_FV_BUILD_SIGNATURE_STRING " = ") - 1) == 0) {
+      Cptr           = Line + sizeof (EFI_FV_BUILD_SIGNATURE_STRING " = ") - 1;
+      Valid          = ReadHexDigest (Cptr, Signature);
+      SignatureFound = TRUE;
+    } else if (strncmp (Line, EFI_FV_IMAGE_DIGEST_STRING " = ", sizeof (EFI_FV_IMAGE_DIGEST_STRING " = ") - 1) == 0) {
+      Cptr        = Line + sizeof (EFI_FV_IMAGE_DIGEST_STRING " = ") - 1;
+      Valid       = ReadHexDigest (Cptr, FvDigest);
+      DigestFound = TRUE;
+    } else if (strncmp (Line, EFI_FV_FILE_STAMP_STRING " = ", sizeof (EFI_FV_FILE_STAMP_STRING " = ") - 1) == 0) {
+      Cptr = Line + sizeof (EFI_FV_FILE_STAMP_STRING " = ") - 1;
+      if (StampIndex == FileCount ||
+          sscanf (Cptr, "%llu %n", &StampSize, &Consumed) != 1) {
+        Valid = FALSE;
+        break;
       }
-      //
-      // Physical address is FV base + offset of PE32 + offset of the entry point
-      //
-      PeiCorePhysicalAddress = FvInfo->BaseAddress;
-      PeiCorePhysicalAddress += (UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader) - (UINTN) FvImage->FileImage;
-      PeiCorePhysicalAddress += EntryPoint;
-      DebugMsg (NULL, 0, 9, "PeiCore physical entry point address", "Address = 0x%llX", (unsigned long long) PeiCorePhysicalAddress);
-
-      if (MachineType == EFI_IMAGE_MACHINE_ARMT || MachineType == EFI_IMAGE_MACHINE_AARCH64) {
-        memset (ResetVector, 0, sizeof (ResetVector));
-        // Address of PEI Core, if we have one
-        ResetVector[1] = (UINT32)PeiCorePhysicalAddress;
+      Files[StampIndex].StampSize = StampSize;
+      Cptr += Consumed;
+      if (strspn (Cptr, "0123456789abcdefABCDEF") != SHA256_DIGEST_SIZE * 2 ||
+          !ReadHexDigest (Cptr, Files[StampIndex].StampDigest) ||
+          sscanf (Cptr + SHA256_DIGEST_SIZE * 2, " %u", &Number) != 1) {
+        Valid = FALSE;
+        break;
       }
-      
-      //
-      // Copy to the beginning of the FV 
-      //
-      memcpy ((UINT8 *) ((UINTN) FvImage->FileImage), ResetVector, sizeof (ResetVector));
-
+      Files[StampIndex].StampFlags = Number;
+      StampIndex++;
     }
-
-    return EFI_SUCCESS;
-  }
-  
-  //
-  // Sec Core found, now find PE32 section
-  //
-  Status = GetSectionByType (SecCoreFile, EFI_SECTION_PE32, 1, &Pe32Section);
-  if (Status == EFI_NOT_FOUND) {
-    Status = GetSectionByType (SecCoreFile, EFI_SECTION_TE, 1, &Pe32Section);
-  }
-
-  if (EFI_ERROR (Status)) {
-    Error (NULL, 0, 3000, "Invalid", "could not find a PE32 section in the SEC core file.");
-    return EFI_ABORTED;
-  }
-
-  Status = GetPe32Info (
-            (VOID *) ((UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader)),
-            &EntryPoint,
-            &BaseOfCode,
-            &MachineType
-            );
-  if (EFI_ERROR (Status)) {
-    Error (NULL, 0, 3000, "Invalid", "could not get the PE32 entry point for the SEC core.");
-    return EFI_ABORTED;
-  }
-  
-  if ((MachineType != EFI_IMAGE_MACHINE_ARMT) && (MachineType != EFI_IMAGE_MACHINE_AARCH64)) {
-    //
-    // If SEC is not ARM we have nothing to do
-    //
-    return EFI_SUCCESS;
   }
-  
-  //
-  // Physical address is FV base + offset of PE32 + offset of the entry point
-  //
-  SecCorePhysicalAddress = FvInfo->BaseAddress;
-  SecCorePhysicalAddress += (UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader) - (UINTN) FvImage->FileImage;
-  SecCorePhysicalAddress += EntryPoint;
-  DebugMsg (NULL, 0, 9, "SecCore physical entry point address", "Address = 0x%llX", (unsigned long long) SecCorePhysicalAddress); 
+  fclose (FvReportFile);
 
-  //
-  // Find the PEI Core. It may not exist if SEC loads DXE core directly
-  //
-  PeiCorePhysicalAddress = 0;
-  Status = GetFileByType (EFI_FV_FILETYPE_PEI_CORE, 1, &PeiCoreFile);
-  if (!EFI_ERROR (Status) && PeiCoreFile != NULL) {
-    //
-    // PEI Core found, now find PE32 or TE section
-    //
-    Status = GetSectionByType (PeiCoreFile, EFI_SECTION_PE32, 1, &Pe32Section);
-    if (Status == EFI_NOT_FOUND) {
-      Status = GetSectionByType (PeiCoreFile, EFI_SECTION_TE, 1, &Pe32Section);
-    }
-  
-    if (EFI_ERROR (Status)) {
-      Error (NULL, 0, 3000, "Invalid", "could not find either a PE32 or a TE section in PEI core file!");
-      return EFI_ABORTED;
-    }
-  
-    Status = GetPe32Info (
-              (VOID *) ((UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader)),
-              &EntryPoint,
-              &BaseOfCode,
-              &MachineType
-              );
-  
-    if (EFI_ERROR (Status)) {
-      Error (NULL, 0, 3000, "Invalid", "could not get the PE32 entry point for the PEI core!");
-      return EFI_ABORTED;
-    }
-    //
-    // Physical address is FV base + offset of PE32 + offset of the entry point
-    //
-    PeiCorePhysicalAddress = FvInfo->BaseAddress;
-    PeiCorePhysicalAddress += (UINTN) Pe32Section.Pe32Section + GetSectionHeaderLength(Pe32Section.CommonHeader) - (UINTN) FvImage->FileImage;
-    PeiCorePhysicalAddress += EntryPoint;
-    DebugMsg (NULL, 0, 9, "PeiCore physical entry point address", "Address = 0x%llX", (unsigned long long) PeiCorePhysicalAddress);
+  if (!Valid || !SignatureFound || !DigestFound || FileIndex != FileCount || StampIndex != FileCount) {
+    return EFI_NOT_FOUND;
   }
-  
-  if (MachineType == EFI_IMAGE_MACHINE_ARMT) {
-    // B SecEntryPoint - signed_immed_24 part +/-32MB offset
-    // on ARM, the PC is always 8 ahead, so we're not really jumping from the base address, but from base address + 8
-    ResetVector[0] = (INT32)(SecCorePhysicalAddress - FvInfo->BaseAddress - 8) >> 2;
+  return EFI_SUCCESS;
+}
 
-    if (ResetVector[0] > 0x00FFFFFF) {
-      Error (NULL, 0, 3000, "Invalid", "SEC Entry point must be within 32MB of the start of the FV");
-      return EFI_ABORTED;
-    }
-  
-    // Add opcode for an uncondional branch with no link. AKA B SecEntryPoint
-    ResetVector[0] |= 0xEB000000;
-  
-  
-    // Address of PEI Core, if we have one
-    ResetVector[1] = (UINT32)PeiCorePhysicalAddress;
-  
-    // SWI handler movs   pc,lr. Just in case a debugger uses SWI
-    ResetVector[2] = 0xE1B0F07E;
-  
-    // Place holder to support a common interrupt handler from ROM.
-    // Currently not suppprted. For this to be used the reset vector would not be in this FV
-    // and the exception vectors would be hard coded in the ROM and just through this address
-    // to find a common handler in the a module in the FV.
-    ResetVector[3] = 0;
-  } else if (MachineType == EFI_IMAGE_MACHINE_AARCH64) {
+STATIC
+EFI_STATUS
+ReadFvMapEntries (
+  IN  CHAR8                   *MapText,
+  IN  UINTN                   MapSize,
+  OUT FV_MAP_ENTRY            **MapEntries,
+  OUT UINTN                   *MapEntryCount
+  )
+/*++
 
-  /* NOTE:
-    ARMT above has an entry in ResetVector[2] for SWI. The way we are using the ResetVector
-    array at the moment, for AArch64, does not allow us space for this as the header only
-    allows for a fixed amount of bytes at the start. If we are sure that UEFI will live
-    within the first 4GB of addressable RAM we could potensioally adopt the same ResetVector
-    layout as above. But for the moment we replace the four 32bit vectors with two 64bit
-    vectors in the same area of the Image heasder. This allows UEFI to start from a 64bit
-    base.
-  */
+Routine Description:
 
-    ((UINT64*)ResetVector)[0] = (UINT64)(SecCorePhysicalAddress - FvInfo->BaseAddress) >> 2;
+  Split a previous FV map file into the entries WriteMapFile wrote for each
+  image. An entry starts with the line before its "(GUID=" line and ends
+  where the next entry starts.
 
-    // B SecEntryPoint - signed_immed_26 part +/-128MB offset
-    if ( ((UINT64*)ResetVector)[0] > 0x03FFFFFF) {
-      Error (NULL, 0, 3000, "Invalid", "SEC Entry point must be within 128MB of the start of the FV");
-      return EFI_ABORTED;
-    }
-    // Add opcode for an uncondional branch with no link. AKA B SecEntryPoint
-    ((UINT64*)ResetVector)[0] |= 0x14000000;
+Arguments:
 
-    // Address of PEI Core, if we have one
-    ((UINT64*)ResetVector)[1] = (UINT64)PeiCorePhysicalAddress;
+  MapText       The contents of the map file.
+  MapSize       The size of the contents.
+  MapEntries    Receives the entries, which the caller frees.
+  MapEntryCount Receives the number of entries.
 
-  } else {
-    Error (NULL, 0, 3000, "Invalid", "Unknown ARM machine type");
-    return EFI_ABORTED;
-  }
+Returns:
 
-  //
-  // Copy to the beginning of the FV 
-  //
-  memcpy ((UINT8 *) ((UINTN) FvImage->FileImage), ResetVector, sizeof (ResetVector));
+  EFI_SUCCESS              The map file is split into entries.
+  EFI_OUT_OF_RESOURCES     The entry table could not be allocated.
 
-  DebugMsg (NULL, 0, 9, "Update Reset vector in FV Header", NULL);
+--*/
+{
+  CHAR8       *Text;
+  CHAR8       *End;
+  CHAR8       *Line;
+  CHAR8       *PreviousLine;
+  UINTN       MaxEntryCount;
+  EFI_STATUS  Status;
 
+  *MapEntries    = NULL;
+  *MapEntryCount = 0;
+  MaxEntryCount  = 0;
+
+  Text         = MapText;
+  End          = Text + MapSize;
+  PreviousLine = NULL;
+  for (Line = Text; Line != NULL && Line < End;) {
+    if (PreviousLine != NULL &&
+        (UINTN) (End - Line) >= sizeof ("(GUID=") - 1 + PRINTED_GUID_BUFFER_SIZE - 1 &&
+        strncmp (Line, "(GUID=", sizeof ("(GUID=") - 1) == 0) {
+      Status = GrowTable ((VOID **) MapEntries, &MaxEntryCount, sizeof (FV_MAP_ENTRY), *MapEntryCount + 1);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      if (*MapEntryCount > 0) {
+        (*MapEntries)[*MapEntryCount - 1].Length = PreviousLine - (*MapEntries)[*MapEntryCount - 1].Text;
+      }
+      (*MapEntries)[*MapEntryCount].Text = PreviousLine;
+      (*MapEntries)[*MapEntryCount].Guid = Line + sizeof ("(GUID=") - 1;
+      (*MapEntryCount)++;
+    }
+    PreviousLine = Line;
+    Line         = memchr (Line, '\n', End - Line);
+    if (Line != NULL) {
+      Line++;
+    }
+  }
+  if (*MapEntryCount > 0) {
+    (*MapEntries)[*MapEntryCount - 1].Length = End - (*MapEntries)[*MapEntryCount - 1].Text;
+  }
   return EFI_SUCCESS;
 }
 
+STATIC
 EFI_STATUS
-GetPe32Info (
-  IN UINT8                  *Pe32,
-  OUT UINT32                *EntryPoint,
-  OUT UINT32                *BaseOfCode,
-  OUT UINT16                *MachineType
+UpdateFvImage (
+  IN FV_INFO                         *FvInfo,
+  IN EFI_FIRMWARE_VOLUME_EXT_HEADER  *FvExtHeader,
+  IN UINT8                           *Signature,
+  IN CHAR8                           *FvFileName,
+  IN CHAR8                           *FvMapName,
+  IN CHAR8                           *FvReportName
   )
 /*++
 
 Routine Description:
 
-  Retrieves the PE32 entry point offset and machine type from PE image or TeImage.  
-  See EfiImage.h for machine types.  The entry point offset is from the beginning 
-  of the PE32 buffer passed in.
+  Update the FV built by a previous run in place, replacing only the FFS
+  files whose stamp changed since. The previous build must have the same
+  signature, see GetFvBuildSignature, its FV file must still have the
+  digest it was written with, and every file must stay at the same
+  offset, so that no other file moves. Each changed file is written again
+  with the pad file that follows it and rebased, then the FV header, the
+  map file and the report file are updated. The result is the FV that a
+  full build produces.
+
+  An FV whose VTF file gets its reset vector updated is built again when a
+  file changed, since that update reaches outside the changed files.
 
 Arguments:
 
-  Pe32          Beginning of the PE32.
-  EntryPoint    Offset from the beginning of the PE32 to the image entry point.
-  BaseOfCode    Base address of code.
-  MachineType   Magic number for the machine type.
+  FvInfo        Pointer to information about the FV.
+  FvExtHeader   The FV extension header, or NULL if there is none.
+  Signature     The signature of this build.
+  FvFileName    The FV file to update.
+  FvMapName     The FV map file.
+  FvReportName  The FV report file.
 
 Returns:
 
-  EFI_SUCCESS             Function completed successfully.
-  EFI_ABORTED             Error encountered.
-  EFI_INVALID_PARAMETER   A required parameter was NULL.
-  EFI_UNSUPPORTED         The operation is unsupported.
+  EFI_SUCCESS              The FV is up to date.
+  EFI_UNSUPPORTED          The FV cannot be updated and must be built again.
+  Other                    An error occurred while updating the FV.
 
 --*/
 {
-  EFI_IMAGE_DOS_HEADER             *DosHeader;
-  EFI_IMAGE_OPTIONAL_HEADER_UNION  *ImgHdr;
-  EFI_TE_IMAGE_HEADER              *TeHeader;
+  EFI_STATUS                  Status;
+  FV_PREVIOUS_FILE            *Files;
+  FV_MAP_ENTRY                *MapEntries;
+  UINTN                       MapEntryCount;
+  UINTN                       MapEntryIndex;
+  MAPPED_FILE                 OldFvFile;
+  MAPPED_FILE                 OldMapFile;
+  UINT8                       OldSignature[SHA256_DIGEST_SIZE];
+  UINT8                       OldFvDigest[SHA256_DIGEST_SIZE];
+  UINT8                       FvDigest[SHA256_DIGEST_SIZE];
+  UINT8                       *OldFvHeader;
+  UINT8                       *DirtyData;
+  UINTN                       DirtyOffset;
+  CHAR8                       *MapText;
+  EFI_FIRMWARE_VOLUME_HEADER  *FvHeader;
+  EFI_FFS_FILE_HEADER         *FfsFile;
+  MEMORY_FILE                 FvImageMemoryFile;
+  UINT8                       *FvImage;
+  UINT8                       *FileImage;
+  UINTN                       FileSize;
+  UINTN                       HeaderLength;
+  UINT32                      FfsHeaderSize;
+  UINT32                      Alignment;
+  UINTN                       CurrentOffset;
+  UINTN                       OldEnd;
+  UINTN                       NewEnd;
+  UINTN                       Limit;
+  UINTN                       VtfIndex;
+  UINT32                      VtfHeaderSize;
+  UINTN                       VtfOffset;
+  UINTN                       ChangedCount;
+  UINTN                       Index;
+  UINTN                       Next;
+  UINTN                       JobIndex;
+  UINTN                       Length;
+  UINT32                      FvBaseAddressNumber;
+  BOOLEAN                     IsArm;
+  BOOLEAN                     WriteError;
+  BOOLEAN                     HeaderChanged;
+  UINT8                       EraseByte;
+  CHAR8                       *Cptr;
+  CHAR8                       *End;
+  CHAR8                       FileGuidString[PRINTED_GUID_BUFFER_SIZE];
+  CHAR8                       Buffer[0x1000];
+  FILE                        *FvFile;
+  FILE                        *FvMapFile;
+  FILE                        *FvReportFile;
+
+  if (!FvInfo->IsPiFvImage || FvInfo->FvFileCount == 0) {
+    VerboseMsg ("The FV is built again, only a PI FV with files is updated in place.");
+    return EFI_UNSUPPORTED;
+  }
+
+  Files = (FV_PREVIOUS_FILE *) calloc (FvInfo->FvFileCount, sizeof (FV_PREVIOUS_FILE));
+  if (Files == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  MapEntries          = NULL;
+  MapEntryCount       = 0;
+  OldFvHeader         = NULL;
+  DirtyData           = NULL;
+  MapText             = NULL;
+  FvMapFile           = NULL;
+  FvReportFile        = NULL;
+  FvBaseAddressNumber = mFvBaseAddressNumber;
+  memset (&OldFvFile, 0, sizeof (OldFvFile));
+  memset (&OldMapFile, 0, sizeof (OldMapFile));
+
+  Status = EFI_UNSUPPORTED;
+  if (EFI_ERROR (ReadFvBuildRecord (FvReportName, FvInfo->FvFileCount, Files, OldSignature, OldFvDigest))) {
+    VerboseMsg ("The FV is built again, %s has no build record for it.", FvReportName);
+    goto Done;
+  }
+  if (memcmp (OldSignature, Signature, SHA256_DIGEST_SIZE) != 0) {
+    VerboseMsg ("The FV is built again, its options or its file list changed.");
+    goto Done;
+  }
+  if (EFI_ERROR (OpenMappedFile (FvFileName, &OldFvFile)) ||
+      EFI_ERROR (OpenMappedFile (FvMapName, &OldMapFile))) {
+    VerboseMsg ("The FV is built again, the previous FV or map file cannot be read.");
+    goto Done;
+  }
 
   //
-  // Verify input parameters
+  // The map file is written again, keep its previous contents in memory.
   //
-  if (Pe32 == NULL) {
-    return EFI_INVALID_PARAMETER;
+  MapText = (CHAR8 *) malloc (OldMapFile.Size + 1);
+  if (MapText == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+  memcpy (MapText, OldMapFile.Data, OldMapFile.Size);
+  MapText[OldMapFile.Size] = '\0';
+  Status = ReadFvMapEntries (MapText, OldMapFile.Size, &MapEntries, &MapEntryCount);
+  CloseMappedFile (&OldMapFile, FALSE);
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    goto Done;
+  }
+  Status = EFI_UNSUPPORTED;
+
+  FvImage  = OldFvFile.Data;
+  FvHeader = (EFI_FIRMWARE_VOLUME_HEADER *) FvImage;
+  for (Index = 0; FvInfo->FvBlocks[Index].Length != 0; Index++) {
+  }
+  HeaderLength = sizeof (EFI_FIRMWARE_VOLUME_HEADER) + Index * sizeof (EFI_FV_BLOCK_MAP_ENTRY);
+  if (OldFvFile.Size != FvInfo->Size || OldFvFile.Size < HeaderLength ||
+      FvHeader->Signature != EFI_FVH_SIGNATURE || FvHeader->FvLength != FvInfo->Size ||
+      FvHeader->HeaderLength != HeaderLength) {
+    VerboseMsg ("The FV is built again, %s does not match its build record.", FvFileName);
+    goto Done;
   }
 
   //
-  // First check whether it is one TE Image.
+  // Only reuse an FV that nothing changed since it was written.
   //
-  TeHeader = (EFI_TE_IMAGE_HEADER *) Pe32;
-  if (TeHeader->Signature == EFI_TE_IMAGE_HEADER_SIGNATURE) {
+  GetFvImageDigest (FvImage, FvInfo->Size, FvDigest);
+  if (memcmp (FvDigest, OldFvDigest, SHA256_DIGEST_SIZE) != 0) {
+    VerboseMsg ("The FV is built again, %s changed since it was built.", FvFileName);
+    goto Done;
+  }
+  InitializeFvLib (FvImage, FvInfo->Size);
+
+  //
+  // Compare each file with the one in the previous FV.
+  //
+  VtfIndex      = FvInfo->FvFileCount;
+  VtfHeaderSize = 0;
+  ChangedCount  = 0;
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    Status = GetFvFileImage (FvInfo, Index, &FileImage, &FileSize);
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
+    Status  = EFI_UNSUPPORTED;
+    FfsFile = (EFI_FFS_FILE_HEADER *) FileImage;
+    if (FileSize < sizeof (EFI_FFS_FILE_HEADER) ||
+        Files[Index].Offset > FvInfo->Size - sizeof (EFI_FFS_FILE_HEADER2)) {
+      VerboseMsg ("The FV is built again, file %s is not in its previous place.", FvInfo->FvFiles[Index]);
+      goto Done;
+    }
+    PrintGuidToBuffer (&FfsFile->Name, (UINT8 *) FileGuidString, sizeof (FileGuidString), TRUE);
+    if (strcmp (FileGuidString, Files[Index].Guid) != 0) {
+      VerboseMsg ("The FV is built again, file %s changed its GUID.", FvInfo->FvFiles[Index]);
+      goto Done;
+    }
+    Files[Index].OldSize = GetFfsFileLength ((EFI_FFS_FILE_HEADER *) (FvImage + Files[Index].Offset));
+    Files[Index].NewSize = FileSize;
+    if (Files[Index].OldSize > FvInfo->Size - Files[Index].Offset) {
+      VerboseMsg ("The FV is built again, %s does not match its build record.", FvFileName);
+      goto Done;
+    }
+    Files[Index].Changed = (BOOLEAN) (Files[Index].StampSize != mFileStamps[Index].Size ||
+                                      memcmp (Files[Index].StampDigest, mFileStamps[Index].Digest, SHA256_DIGEST_SIZE) != 0);
+    if (Files[Index].Changed) {
+      if (EFI_ERROR (VerifyFfsFile (FfsFile))) {
+        VerboseMsg ("The FV is built again, %s is not a valid FFS file.", FvInfo->FvFiles[Index]);
+        goto Done;
+      }
+      ChangedCount++;
+    }
+    ReadFfsAlignment (FfsFile, &Files[Index].Alignment);
+    if (Files[Index].Alignment > MaxFfsAlignment) {
+      MaxFfsAlignment = Files[Index].Alignment;
+    }
+    if (IsVtfFile (FfsFile)) {
+      if (VtfIndex != FvInfo->FvFileCount) {
+        VerboseMsg ("The FV is built again, it has more than one VTF file.");
+        goto Done;
+      }
+      VtfIndex      = Index;
+      VtfHeaderSize = GetFfsHeaderLength (FfsFile);
+    }
+  }
+
+  //
+  // Place the files the way AddFile does. Every file must keep its offset.
+  //
+  VtfOffset = FvInfo->Size;
+  if (VtfIndex != FvInfo->FvFileCount) {
+    VtfOffset = FvInfo->Size - Files[VtfIndex].NewSize;
+    if (Files[VtfIndex].Offset != VtfOffset || (VtfOffset + VtfHeaderSize) % (1 << Files[VtfIndex].Alignment) != 0) {
+      VerboseMsg ("The FV is built again, the VTF file moved.");
+      goto Done;
+    }
+  }
+
+  CurrentOffset = HeaderLength;
+  if (FvExtHeader != NULL) {
+    FfsHeaderSize = sizeof (EFI_FFS_FILE_HEADER);
+    if (FvExtHeader->ExtHeaderSize + sizeof (EFI_FFS_FILE_HEADER) >= MAX_FFS_SIZE) {
+      FfsHeaderSize = sizeof (EFI_FFS_FILE_HEADER2);
+    }
+    CurrentOffset += FfsHeaderSize + FvExtHeader->ExtHeaderSize;
+    CurrentOffset  = (CurrentOffset + EFI_FFS_FILE_HEADER_ALIGNMENT - 1) & ~(EFI_FFS_FILE_HEADER_ALIGNMENT - 1);
+  }
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    if (Index == VtfIndex) {
+      continue;
+    }
+    FfsHeaderSize = Files[Index].NewSize >= MAX_FFS_SIZE ? sizeof (EFI_FFS_FILE_HEADER2) : sizeof (EFI_FFS_FILE_HEADER);
+    Alignment     = 1 << Files[Index].Alignment;
+    if ((CurrentOffset + FfsHeaderSize) % Alignment != 0) {
+      CurrentOffset = (CurrentOffset + sizeof (EFI_FFS_FILE_HEADER) + FfsHeaderSize + Alignment - 1) & ~((UINTN) Alignment - 1);
+      CurrentOffset -= FfsHeaderSize;
+    }
+    if (CurrentOffset != Files[Index].Offset || Files[Index].NewSize > VtfOffset - CurrentOffset) {
+      VerboseMsg ("The FV is built again, its layout changed at file %s.", FvInfo->FvFiles[Index]);
+      goto Done;
+    }
+    CurrentOffset = (CurrentOffset + Files[Index].NewSize + EFI_FFS_FILE_HEADER_ALIGNMENT - 1) & ~(EFI_FFS_FILE_HEADER_ALIGNMENT - 1);
+  }
+  if (VtfIndex != FvInfo->FvFileCount && VtfOffset - CurrentOffset >= MAX_FFS_SIZE) {
     //
-    // By TeImage Header to get output
+    // The pad file before the VTF file is a large file, see PadFvImage.
     //
-    *EntryPoint   = TeHeader->AddressOfEntryPoint + sizeof (EFI_TE_IMAGE_HEADER) - TeHeader->StrippedSize;
-    *BaseOfCode   = TeHeader->BaseOfCode + sizeof (EFI_TE_IMAGE_HEADER) - TeHeader->StrippedSize;
-    *MachineType  = TeHeader->Machine;
+    mIsLargeFfs = TRUE;
+  }
+
+  //
+  // Match the previous map file entries with the files.
+  //
+  MapEntryIndex = 0;
+  IsArm         = FALSE;
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    Files[Index].MapEntryFirst = MapEntryIndex;
+    while (MapEntryIndex < MapEntryCount &&
+           strncmp (MapEntries[MapEntryIndex].Guid, Files[Index].Guid, PRINTED_GUID_BUFFER_SIZE - 1) == 0) {
+      MapEntryIndex++;
+    }
+    Files[Index].MapEntryEnd = MapEntryIndex;
+    if (!Files[Index].Changed && (Files[Index].StampFlags & FV_FILE_STAMP_FLAG_ARM) != 0) {
+      IsArm = TRUE;
+    }
+  }
+  if (MapEntryIndex != MapEntryCount) {
+    VerboseMsg ("The FV is built again, %s does not match its build record.", FvMapName);
+    goto Done;
+  }
+
+  if (ChangedCount != 0 && VtfIndex != FvInfo->FvFileCount && !IsArm &&
+      FvInfo->BaseAddress + FvInfo->Size == FV_IMAGES_TOP_ADDRESS) {
+    VerboseMsg ("The FV is built again, its reset vector is updated.");
+    goto Done;
+  }
+
+  //
+  // Write the changed files and the pad files after them in the private
+  // view of the previous FV. The other files are only needed for the base
+  // addresses of their child FVs.
+  //
+  OldFvHeader = (UINT8 *) malloc (HeaderLength);
+  if (OldFvHeader == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+  memcpy (OldFvHeader, FvImage, HeaderLength);
+
+  EraseByte = (UINT8) ((FvHeader->Attributes & EFI_FVB2_ERASE_POLARITY) ? 0xFF : 0);
+  FvImageMemoryFile.FileImage = (CHAR8 *) FvImage;
+  FvImageMemoryFile.Eof       = (CHAR8 *) FvImage + FvInfo->Size;
+
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    FfsFile = (EFI_FFS_FILE_HEADER *) (FvImage + Files[Index].Offset);
+    if (!Files[Index].Changed) {
+      if (IsFvRebaseRequired (FvInfo) && FfsFile->Type == EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE) {
+        Status = GetChildFvFromFfs (FvInfo, FfsFile, Files[Index].Offset);
+        if (EFI_ERROR (Status)) {
+          goto Done;
+        }
+      }
+      continue;
+    }
+
+    Status = GetFvFileImage (FvInfo, Index, &FileImage, &FileSize);
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
+    if (Index == VtfIndex) {
+      Files[Index].DirtyEnd = FvInfo->Size;
+      memcpy (FfsFile, FileImage, FileSize);
+    } else {
+      //
+      // Only the file and the pad file header after it differ from the
+      // erased space up to the next file.
+      //
+      Next = Index + 1;
+      if (Next == VtfIndex) {
+        Next++;
+      }
+      Limit  = Next < FvInfo->FvFileCount ? Files[Next].Offset : VtfOffset;
+      OldEnd = (Files[Index].Offset + Files[Index].OldSize + EFI_FFS_FILE_HEADER_ALIGNMENT - 1) & ~(EFI_FFS_FILE_HEADER_ALIGNMENT - 1);
+      NewEnd = (Files[Index].Offset + Files[Index].NewSize + EFI_FFS_FILE_HEADER_ALIGNMENT - 1) & ~(EFI_FFS_FILE_HEADER_ALIGNMENT - 1);
+      Files[Index].DirtyEnd = (OldEnd > NewEnd ? OldEnd : NewEnd) + sizeof (EFI_FFS_FILE_HEADER2);
+      if (Files[Index].DirtyEnd > Limit) {
+        Files[Index].DirtyEnd = Limit;
+      }
+      memset (FfsFile, EraseByte, Files[Index].DirtyEnd - Files[Index].Offset);
+      memcpy (FfsFile, FileImage, FileSize);
+
+      FvImageMemoryFile.CurrentFilePointer = (CHAR8 *) FvImage + NewEnd;
+      if (Next < FvInfo->FvFileCount) {
+        Status = AddPadFile (&FvImageMemoryFile, 1 << Files[Next].Alignment, FvImage + VtfOffset, NULL, (UINT32) Files[Next].NewSize);
+      } else {
+        Status = PadFvImage (&FvImageMemoryFile, (EFI_FFS_FILE_HEADER *) (FvImage + VtfOffset));
+      }
+      if (EFI_ERROR (Status)) {
+        Error (NULL, 0, 4002, "Resource", "FV space is full, could not add pad file after file %s.", FvInfo->FvFiles[Index]);
+        Status = EFI_ABORTED;
+        goto Done;
+      }
+    }
+    UpdateFfsFileState (FfsFile, FvHeader);
+
+    Status = AddRebaseJob (FvInfo, Index, FfsFile, Files[Index].Offset);
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
+  }
+
+  if (ChangedCount == 0) {
+    VerboseMsg ("The FV is up to date.");
+    Status = EFI_SUCCESS;
+    goto Done;
+  }
+
+  Status = RebaseFvFiles (FvInfo, NULL);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    if (!Files[Index].Changed) {
+      mFileIsArm[Index] = (BOOLEAN) ((Files[Index].StampFlags & FV_FILE_STAMP_FLAG_ARM) != 0);
+    }
+    if (mFileIsArm[Index]) {
+      IsArm = TRUE;
+    }
+  }
+  if (VtfIndex != FvInfo->FvFileCount && !IsArm &&
+      FvInfo->BaseAddress + FvInfo->Size == FV_IMAGES_TOP_ADDRESS) {
+    VerboseMsg ("The FV is built again, its reset vector is updated.");
+    Status = EFI_UNSUPPORTED;
+    goto Done;
+  }
+
+  //
+  // Update the FV header the way GenerateFvImage completes it.
+  //
+  FvHeader->Attributes = FvInfo->FvAttributes == 0 ? FV_DEFAULT_ATTRIBUTE : FvInfo->FvAttributes;
+  if (((FvHeader->Attributes & EFI_FVB2_WEAK_ALIGNMENT) != EFI_FVB2_WEAK_ALIGNMENT) &&
+      (((FvHeader->Attributes & EFI_FVB2_ALIGNMENT) >> 16)) < MaxFfsAlignment) {
+    FvHeader->Attributes = ((MaxFfsAlignment << 16) | (FvHeader->Attributes & 0xFFFF));
+  }
+  memcpy (&FvHeader->FileSystemGuid, &FvInfo->FvFileSystemGuid, sizeof (EFI_GUID));
+  if (mIsLargeFfs && CompareGuid (&FvHeader->FileSystemGuid, &mEfiFirmwareFileSystem2Guid) == 0) {
+    memcpy (&FvHeader->FileSystemGuid, &mEfiFirmwareFileSystem3Guid, sizeof (EFI_GUID));
+  }
+  memset (FvHeader->ZeroVector, 0, 16);
+  if (IsArm) {
+    mArm = TRUE;
+    Status = UpdateArmResetVectorIfNeeded (&FvImageMemoryFile, FvInfo);
+    if (EFI_ERROR (Status)) {
+      Error (NULL, 0, 3000, "Invalid", "Could not update the reset vector.");
+      goto Done;
+    }
+  }
+  FvHeader->Checksum = 0;
+  FvHeader->Checksum = CalculateChecksum16 ((UINT16 *) FvHeader, FvHeader->HeaderLength / sizeof (UINT16));
+
+  //
+  // Take the changed parts out of the view, which must be closed before the
+  // FV file is written.
+  //
+  Length = HeaderLength;
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    if (Files[Index].Changed) {
+      Length += Files[Index].DirtyEnd - Files[Index].Offset;
+    }
+  }
+  DirtyData = (UINT8 *) malloc (Length);
+  if (DirtyData == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+  HeaderChanged = (BOOLEAN) (memcmp (OldFvHeader, FvImage, HeaderLength) != 0);
+  memcpy (DirtyData, FvImage, HeaderLength);
+  Length = HeaderLength;
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    if (Files[Index].Changed) {
+      memcpy (DirtyData + Length, FvImage + Files[Index].Offset, Files[Index].DirtyEnd - Files[Index].Offset);
+      Length += Files[Index].DirtyEnd - Files[Index].Offset;
+    }
+  }
+  GetFvImageDigest (FvImage, FvInfo->Size, FvDigest);
+  CloseMappedFile (&OldFvFile, FALSE);
+
+  //
+  // Write the changed parts of the FV. The report file goes first, so that
+  // a failure leaves no build record behind and the next build is a full one.
+  //
+  remove (FvReportName);
+  WriteError = FALSE;
+  FvFile     = fopen (FvFileName, "r+b");
+  if (FvFile == NULL) {
+    WriteError = TRUE;
   } else {
-  
-    //
-    // Then check whether 
-    // First is the DOS header
-    //
-    DosHeader = (EFI_IMAGE_DOS_HEADER *) Pe32;
-  
-    //
-    // Verify DOS header is expected
-    //
-    if (DosHeader->e_magic != EFI_IMAGE_DOS_SIGNATURE) {
-      Error (NULL, 0, 3000, "Invalid", "Unknown magic number in the DOS header, 0x%04X.", DosHeader->e_magic);
-      return EFI_UNSUPPORTED;
+    if (HeaderChanged) {
+      WriteError = (BOOLEAN) (fseek (FvFile, 0, SEEK_SET) != 0 || fwrite (DirtyData, 1, HeaderLength, FvFile) != HeaderLength);
     }
-    //
-    // Immediately following is the NT header.
-    //
-    ImgHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *) ((UINTN) Pe32 + DosHeader->e_lfanew);
-  
-    //
-    // Verify NT header is expected
-    //
-    if (ImgHdr->Pe32.Signature != EFI_IMAGE_NT_SIGNATURE) {
-      Error (NULL, 0, 3000, "Invalid", "Unrecognized image signature 0x%08X.", (unsigned) ImgHdr->Pe32.Signature);
-      return EFI_UNSUPPORTED;
+    DirtyOffset = HeaderLength;
+    for (Index = 0; Index < FvInfo->FvFileCount && !WriteError; Index++) {
+      if (Files[Index].Changed) {
+        Length     = Files[Index].DirtyEnd - Files[Index].Offset;
+        WriteError = (BOOLEAN) (fseek (FvFile, (long) Files[Index].Offset, SEEK_SET) != 0 ||
+                                fwrite (DirtyData + DirtyOffset, 1, Length, FvFile) != Length);
+        DirtyOffset += Length;
+      }
     }
-    //
-    // Get output
-    //
-    *EntryPoint   = ImgHdr->Pe32.OptionalHeader.AddressOfEntryPoint;
-    *BaseOfCode   = ImgHdr->Pe32.OptionalHeader.BaseOfCode;
-    *MachineType  = ImgHdr->Pe32.FileHeader.Machine;
+    if (fclose (FvFile) != 0) {
+      WriteError = TRUE;
+    }
+  }
+  if (WriteError) {
+    Error (NULL, 0, 0002, "Error writing file", FvFileName);
+    remove (FvFileName);
+    Status = EFI_ABORTED;
+    goto Done;
+  }
+
+  FvMapFile = fopen (FvMapName, "w");
+  if (FvMapFile == NULL) {
+    Error (NULL, 0, 0001, "Error opening file", FvMapName);
+    Status = EFI_ABORTED;
+    goto Done;
+  }
+  FvReportFile = fopen (FvReportName, "w");
+  if (FvReportFile == NULL) {
+    Error (NULL, 0, 0001, "Error opening file", FvReportName);
+    Status = EFI_ABORTED;
+    goto Done;
   }
 
   //
-  // Verify machine type is supported
+  // Keep the map entries of the unchanged files and take those of the
+  // changed files from their rebase.
   //
-  if ((*MachineType != EFI_IMAGE_MACHINE_IA32) && (*MachineType != EFI_IMAGE_MACHINE_IA64) && (*MachineType != EFI_IMAGE_MACHINE_X64) && (*MachineType != EFI_IMAGE_MACHINE_EBC) && 
-      (*MachineType != EFI_IMAGE_MACHINE_ARMT) && (*MachineType != EFI_IMAGE_MACHINE_AARCH64)) {
-    Error (NULL, 0, 3000, "Invalid", "Unrecognized machine type in the PE32 file.");
-    return EFI_UNSUPPORTED;
+  WriteFvSizeInfo (FvMapFile, FvReportFile);
+  JobIndex = 0;
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    fprintf (FvReportFile, "0x%08X %s\n", (unsigned) Files[Index].Offset, Files[Index].Guid);
+    if (!Files[Index].Changed) {
+      for (MapEntryIndex = Files[Index].MapEntryFirst; MapEntryIndex < Files[Index].MapEntryEnd; MapEntryIndex++) {
+        //
+        // The new map file is written in text mode, as is the previous one.
+        //
+        Cptr = MapEntries[MapEntryIndex].Text;
+        End  = Cptr + MapEntries[MapEntryIndex].Length;
+        while (Cptr < End) {
+          Length = End - Cptr;
+          if (memchr (Cptr, '\r', Length) != NULL) {
+            Length = (CHAR8 *) memchr (Cptr, '\r', Length) - Cptr;
+          }
+          fwrite (Cptr, 1, Length, FvMapFile);
+          Cptr += Length + 1;
+        }
+      }
+    } else if (JobIndex < mRebaseJobCount && mRebaseJobs[JobIndex].Index == Index) {
+      rewind (mRebaseJobs[JobIndex].MapFile);
+      while ((Length = fread (Buffer, 1, sizeof (Buffer), mRebaseJobs[JobIndex].MapFile)) != 0) {
+        fwrite (Buffer, 1, Length, FvMapFile);
+      }
+      JobIndex++;
+    }
   }
+  WriteFvBuildRecord (FvReportFile, FvInfo, Signature, FvDigest);
+  VerboseMsg ("Updated %u of the %u files of the FV in place.", (unsigned) ChangedCount, (unsigned) FvInfo->FvFileCount);
+  Status = EFI_SUCCESS;
 
-  return EFI_SUCCESS;
+Done:
+  if (Status == EFI_UNSUPPORTED) {
+    //
+    // Undo what the full build does again.
+    //
+    for (JobIndex = 0; JobIndex < mRebaseJobCount; JobIndex++) {
+      if (mRebaseJobs[JobIndex].MapFile != NULL) {
+        fclose (mRebaseJobs[JobIndex].MapFile);
+      }
+    }
+    mRebaseJobCount      = 0;
+    mFvBaseAddressNumber = FvBaseAddressNumber;
+    memset (mFileIsArm, 0, FvInfo->FvFileCount * sizeof (BOOLEAN));
+  }
+  if (FvMapFile != NULL) {
+    fclose (FvMapFile);
+  }
+  if (FvReportFile != NULL) {
+    fclose (FvReportFile);
+  }
+  CloseMappedFile (&OldFvFile, FALSE);
+  CloseMappedFile (&OldMapFile, FALSE);
+  if (MapEntries != NULL) {
+    free (MapEntries);
+  }
+  if (OldFvHeader != NULL) {
+    free (OldFvHeader);
+  }
+  if (DirtyData != NULL) {
+    free (DirtyData);
+  }
+  if (MapText != NULL) {
+    free (MapText);
+  }
+  free (Files);
+  return Status;
 }
 
+STATIC
 EFI_STATUS
-GenerateFvImage (
-  IN CHAR8                *InfFileImage,
-  IN UINTN                InfFileSize,
-  IN CHAR8                *FvFileName,
-  IN CHAR8                *MapFileName
+BuildFvImage (
+  IN  CHAR8               *InfFileImage,
+  IN  UINTN               InfFileSize,
+  IN  CHAR8               *FvFileName,
+  IN  CHAR8               *MapFileName,
+  OUT UINT8               **FvImageBuffer,     OPTIONAL
+  OUT UINTN               *FvImageBufferSize   OPTIONAL
   )
 /*++
 
 Routine Description:
 
-  This is the main function which will be called from application.
+  Generate an FV image, either into FvFileName or into memory.
 
 Arguments:
 
-  InfFileImage   Buffer containing the INF file contents.
-  InfFileSize    Size of the contents of the InfFileImage buffer.
-  FvFileName     Requested name for the FV file.
-  MapFileName    Fv map file to log fv driver information.
+  InfFileImage      Buffer containing the INF file contents.
+  InfFileSize       Size of the contents of the InfFileImage buffer.
+  FvFileName        Requested name for the FV file.
+  MapFileName       Fv map file to log fv driver information.
+  FvImageBuffer     If not NULL, receives the FV image instead of FvFileName.
+  FvImageBufferSize Receives the size of the FV image if FvImageBuffer is
+                    not NULL.
 
 Returns:
 
@@ -2073,10 +3942,9 @@ Returns:
   UINTN                           Index;
   EFI_FIRMWARE_VOLUME_HEADER      *FvHeader;
   EFI_FFS_FILE_HEADER             *VtfFileImage;
-  UINT8                           *FvBufferHeader; // to make sure fvimage header 8 type alignment.
+  MAPPED_FILE                     FvOutputFile;
   UINT8                           *FvImage;
   UINTN                           FvImageSize;
-  FILE                            *FvFile;
   CHAR8                           FvMapName [_MAX_PATH];
   FILE                            *FvMapFile;
   EFI_FIRMWARE_VOLUME_EXT_HEADER  *FvExtHeader;
@@ -2084,11 +3952,21 @@ Returns:
   UINTN                           FileSize;
   CHAR8                           FvReportName[_MAX_PATH];
   FILE                            *FvReportFile;
+  UINT8                           Signature[SHA256_DIGEST_SIZE];
+  UINT8                           FvDigest[SHA256_DIGEST_SIZE];
 
-  FvBufferHeader = NULL;
-  FvFile         = NULL;
   FvMapFile      = NULL;
   FvReportFile   = NULL;
+  memset (&FvOutputFile, 0, sizeof (FvOutputFile));
+
+  //
+  // Clear what the previous FV built by this process left behind.
+  //
+  mArm            = FALSE;
+  mIsLargeFfs     = FALSE;
+  MaxFfsAlignment = 0;
+  mFvTotalSize    = 0;
+  mFvTakenSize    = 0;
 
   if (InfFileImage != NULL) {
     //
@@ -2120,7 +3998,7 @@ Returns:
     return EFI_ABORTED;
   }
   
-  if (mFvDataInfo.FvBlocks[0].Length == 0) {
+  if (mFvDataInfo.FvBlocks == NULL || mFvDataInfo.FvBlocks[0].Length == 0) {
     Error (NULL, 0, 1001, "Missing required argument", "Block Size");
     return EFI_ABORTED;
   }
@@ -2234,15 +4112,31 @@ Returns:
   strcpy (FvReportName, FvFileName);
   strcat (FvReportName, ".txt");
 
+  Status = AllocateFvFileTables (mFvDataInfo.FvFileCount);
+  if (EFI_ERROR (Status)) {
+    goto Finish;
+  }
+
   //
   // Calculate the FV size and Update Fv Size based on the actual FFS files.
   // And Update mFvDataInfo data.
   //
   Status = CalculateFvSize (&mFvDataInfo);
   if (EFI_ERROR (Status)) {
-    return Status;    
+    goto Finish;
   }
   VerboseMsg ("the generated FV image size is %u bytes", (unsigned) mFvDataInfo.Size);
+
+  //
+  // Update the previous FV in place if only the contents of its files changed.
+  //
+  if (mFvDataInfo.Incremental && FvImageBuffer == NULL) {
+    GetFvBuildSignature (&mFvDataInfo, FvExtHeader, Signature);
+    Status = UpdateFvImage (&mFvDataInfo, FvExtHeader, Signature, FvFileName, FvMapName, FvReportName);
+    if (Status != EFI_UNSUPPORTED) {
+      goto Finish;
+    }
+  }
   
   //
   // support fv image and empty fv image
@@ -2250,13 +4144,25 @@ Returns:
   FvImageSize = mFvDataInfo.Size;
 
   //
-  // Allocate the FV, assure FvImage Header 8 byte alignment
+  // Build the FV directly in the mapped output file. The file replaces
+  // FvFileName only once the image is complete.
   //
-  FvBufferHeader = malloc (FvImageSize + sizeof (UINT64));
-  if (FvBufferHeader == NULL) {
-    return EFI_OUT_OF_RESOURCES;
+  if (FvImageBuffer != NULL) {
+    FvOutputFile.Data = (UINT8 *) malloc (FvImageSize + 1);
+    FvOutputFile.Size = FvImageSize;
+    if (FvOutputFile.Data == NULL) {
+      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+      Status = EFI_OUT_OF_RESOURCES;
+      goto Finish;
+    }
+  } else {
+    Status = CreateMappedFile (FvFileName, FvImageSize, &FvOutputFile);
+    if (EFI_ERROR (Status)) {
+      Error (NULL, 0, 0001, "Error opening file", FvFileName);
+      goto Finish;
+    }
   }
-  FvImage = (UINT8 *) (((UINTN) FvBufferHeader + 7) & ~7);
+  FvImage = FvOutputFile.Data;
 
   //
   // Initialize the FV to the erase polarity
@@ -2319,7 +4225,7 @@ Returns:
   //
   // If there is no FFS file, generate one empty FV
   //
-  if (mFvDataInfo.FvFiles[0][0] == 0 && !mFvDataInfo.FvNameGuidSet) {
+  if (mFvDataInfo.FvFileCount == 0 && !mFvDataInfo.FvNameGuidSet) {
     goto WriteFile;
   }
 
@@ -2346,7 +4252,8 @@ Returns:
   FvMapFile = fopen (FvMapName, "w");
   if (FvMapFile == NULL) {
     Error (NULL, 0, 0001, "Error opening file", FvMapName);
-    return EFI_ABORTED;
+    Status = EFI_ABORTED;
+    goto Finish;
   }
   
   //
@@ -2355,29 +4262,13 @@ Returns:
   FvReportFile = fopen(FvReportName, "w");
   if (FvReportFile == NULL) {
     Error (NULL, 0, 0001, "Error opening file", FvReportName);
-    return EFI_ABORTED;
-  }
-  //
-  // record FV size information into FvMap file.
-  //
-  if (mFvTotalSize != 0) {
-    fprintf (FvMapFile, EFI_FV_TOTAL_SIZE_STRING);
-    fprintf (FvMapFile, " = 0x%x\n", (unsigned) mFvTotalSize);
-  }
-  if (mFvTakenSize != 0) {
-    fprintf (FvMapFile, EFI_FV_TAKEN_SIZE_STRING);
-    fprintf (FvMapFile, " = 0x%x\n", (unsigned) mFvTakenSize);
-  }
-  if (mFvTotalSize != 0 && mFvTakenSize != 0) {
-    fprintf (FvMapFile, EFI_FV_SPACE_SIZE_STRING);
-    fprintf (FvMapFile, " = 0x%x\n\n", (unsigned) (mFvTotalSize - mFvTakenSize));
+    Status = EFI_ABORTED;
+    goto Finish;
   }
-
   //
-  // record FV size information to FvReportFile.
+  // record FV size information into FvMap and FvReport files.
   //
-  fprintf (FvReportFile, "%s = 0x%x\n", EFI_FV_TOTAL_SIZE_STRING, (unsigned) mFvTotalSize);
-  fprintf (FvReportFile, "%s = 0x%x\n", EFI_FV_TAKEN_SIZE_STRING, (unsigned) mFvTakenSize);
+  WriteFvSizeInfo (FvMapFile, FvReportFile);
 
   //
   // Add PI FV extension header
@@ -2398,11 +4289,11 @@ Returns:
   //
   // Add files to FV
   //
-  for (Index = 0; mFvDataInfo.FvFiles[Index][0] != 0; Index++) {
+  for (Index = 0; Index < mFvDataInfo.FvFileCount; Index++) {
     //
     // Add the file
     //
-    Status = AddFile (&FvImageMemoryFile, &mFvDataInfo, Index, &VtfFileImage, FvMapFile, FvReportFile);
+    Status = AddFile (&FvImageMemoryFile, &mFvDataInfo, Index, &VtfFileImage, FvReportFile);
 
     //
     // Exit if error detected while adding the file
@@ -2412,6 +4303,14 @@ Returns:
     }
   }
 
+  //
+  // Rebase the files now that all of them are placed.
+  //
+  Status = RebaseFvFiles (&mFvDataInfo, FvMapFile);
+  if (EFI_ERROR (Status)) {
+    goto Finish;
+  }
+
   //
   // If there is a VTF file, some special actions need to occur.
   //
@@ -2480,117 +4379,618 @@ Returns:
     FvHeader->Checksum      = CalculateChecksum16 ((UINT16 *) FvHeader, FvHeader->HeaderLength / sizeof (UINT16));
   }
 
+  //
+  // Record what the next incremental build compares with.
+  //
+  if (mFvDataInfo.Incremental && FvImageBuffer == NULL) {
+    GetFvImageDigest (FvImage, FvImageSize, FvDigest);
+    WriteFvBuildRecord (FvReportFile, &mFvDataInfo, Signature, FvDigest);
+  }
+
 WriteFile: 
+  Status = EFI_SUCCESS;
+  if (FvImageBuffer != NULL) {
+    *FvImageBuffer     = FvOutputFile.Data;
+    *FvImageBufferSize = FvOutputFile.Size;
+    memset (&FvOutputFile, 0, sizeof (FvOutputFile));
+  }
+
+Finish:
   //
-  // Write fv file
+  // Commit the fv file if it is complete, otherwise discard it
   //
-  FvFile = fopen (FvFileName, "wb");
-  if (FvFile == NULL) {
-    Error (NULL, 0, 0001, "Error opening file", FvFileName);
+  if (EFI_ERROR (CloseMappedFile (&FvOutputFile, (BOOLEAN) !EFI_ERROR (Status))) && !EFI_ERROR (Status)) {
+    Error (NULL, 0, 0002, "Error writing file", FvFileName);
     Status = EFI_ABORTED;
-    goto Finish;
   }
+  ReleaseFvFileTables (mFvDataInfo.FvFileCount);
+
+  if (FvExtHeader != NULL) {
+    free (FvExtHeader);
+  }
+  
+  if (FvMapFile != NULL) {
+    fflush (FvMapFile);
+    fclose (FvMapFile);
+  }
+
+  if (FvReportFile != NULL) {
+    fflush (FvReportFile);
+    fclose (FvReportFile);
+  }
+
+  //
+  // A failed build leaves no build record behind.
+  //
+  if (EFI_ERROR (Status) && mFvDataInfo.Incremental) {
+    remove (FvReportName);
+  }
+  return Status;
+}
+
+EFI_STATUS
+GenerateFvImage (
+  IN CHAR8                *InfFileImage,
+  IN UINTN                InfFileSize,
+  IN CHAR8                *FvFileName,
+  IN CHAR8                *MapFileName
+  )
+/*++
+
+Routine Description:
+
+  This is the main function which will be called from application.
+
+Arguments:
+
+  InfFileImage   Buffer containing the INF file contents.
+  InfFileSize    Size of the contents of the InfFileImage buffer.
+  FvFileName     Requested name for the FV file.
+  MapFileName    Fv map file to log fv driver information.
+
+Returns:
+
+  EFI_SUCCESS             Function completed successfully.
+  EFI_OUT_OF_RESOURCES    Could not allocate required resources.
+  EFI_ABORTED             Error encountered.
+  EFI_INVALID_PARAMETER   A required parameter was NULL.
+
+--*/
+{
+  return BuildFvImage (InfFileImage, InfFileSize, FvFileName, MapFileName, NULL, NULL);
+}
+
+EFI_STATUS
+GenerateFvImageBuffer (
+  IN  CHAR8               *InfFileImage,
+  IN  UINTN               InfFileSize,
+  IN  CHAR8               *FvFileName,
+  IN  CHAR8               *MapFileName,
+  OUT UINT8               **FvImageBuffer,
+  OUT UINTN               *FvImageBufferSize
+  )
+/*++
+
+Routine Description:
+
+  Generate an FV image like GenerateFvImage, but return it in memory
+  instead of writing FvFileName. FvFileName still names the map and report
+  files, which are written next to it. An incremental build is not done.
+
+Arguments:
+
+  InfFileImage      Buffer containing the INF file contents.
+  InfFileSize       Size of the contents of the InfFileImage buffer.
+  FvFileName        Name of the FV file, used for the map and report files.
+  MapFileName       Fv map file to log fv driver information.
+  FvImageBuffer     Receives the FV image, released with free().
+  FvImageBufferSize Receives the size of the FV image.
+
+Returns:
+
+  EFI_SUCCESS             Function completed successfully.
+  EFI_OUT_OF_RESOURCES    Could not allocate required resources.
+  EFI_ABORTED             Error encountered.
+  EFI_INVALID_PARAMETER   A required parameter was NULL.
+
+--*/
+{
+  if (FvImageBuffer == NULL || FvImageBufferSize == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+  *FvImageBuffer     = NULL;
+  *FvImageBufferSize = 0;
+  return BuildFvImage (InfFileImage, InfFileSize, FvFileName, MapFileName, FvImageBuffer, FvImageBufferSize);
+}
+
+EFI_STATUS
+UpdatePeiCoreEntryInFit (
+  IN FIT_TABLE     *FitTablePtr,
+  IN UINT64        PeiCorePhysicalAddress
+  )
+/*++
+
+Routine Description:
+
+  This function is used to update the Pei Core address in FIT, this can be used by Sec core to pass control from
+  Sec to Pei Core
+
+Arguments:
+
+  FitTablePtr             - The pointer of FIT_TABLE.
+  PeiCorePhysicalAddress  - The address of Pei Core entry.
+
+Returns:
+
+  EFI_SUCCESS             - The PEI_CORE FIT entry was updated successfully.
+  EFI_NOT_FOUND           - Not found the PEI_CORE FIT entry.
+
+--*/
+{
+  FIT_TABLE *TmpFitPtr;
+  UINTN     Index;
+  UINTN     NumFitComponents;
+
+  TmpFitPtr         = FitTablePtr;
+  NumFitComponents  = TmpFitPtr->CompSize;
+
+  for (Index = 0; Index < NumFitComponents; Index++) {
+    if ((TmpFitPtr->CvAndType & FIT_TYPE_MASK) == COMP_TYPE_FIT_PEICORE) {
+      TmpFitPtr->CompAddress = PeiCorePhysicalAddress;
+      return EFI_SUCCESS;
+    }
+
+    TmpFitPtr++;
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+VOID
+UpdateFitCheckSum (
+  IN FIT_TABLE   *FitTablePtr
+  )
+/*++
+
+Routine Description:
+
+  This function is used to update the checksum for FIT.
+
+
+Arguments:
+
+  FitTablePtr             - The pointer of FIT_TABLE.
+
+Returns:
+
+  None.
+
+--*/
+{
+  if ((FitTablePtr->CvAndType & CHECKSUM_BIT_MASK) >> 7) {
+    FitTablePtr->CheckSum = 0;
+    FitTablePtr->CheckSum = CalculateChecksum8 ((UINT8 *) FitTablePtr, FitTablePtr->CompSize * 16);
+  }
+}
+
+//
+// A file placed by PackFvFiles. Size is rounded up to the file alignment
+// of the FV and Alignment is the data alignment in bytes.
+//
+typedef struct {
+  UINTN     Index;
+  UINTN     Size;
+  UINT32    HeaderSize;
+  UINT32    Alignment;
+  BOOLEAN   Fixed;
+} PACK_FILE;
+
+STATIC
+UINTN
+GetPadFileSize (
+  IN UINTN      Offset,
+  IN PACK_FILE  *File
+  )
+/*++
+
+Routine Description:
+
+  Get the size of the pad file AddPadFile inserts before a file, which is
+  either zero or large enough for a pad file header.
+
+Arguments:
+
+  Offset        The offset in the FV where the file would be placed.
+  File          The file.
+
+Returns:
+
+  The size of the pad file.
+
+--*/
+{
+  if ((Offset + File->HeaderSize) % File->Alignment == 0) {
+    return 0;
+  }
+  return ((Offset + File->HeaderSize + sizeof (EFI_FFS_FILE_HEADER) + File->Alignment - 1) & ~((UINTN) File->Alignment - 1))
+         - File->HeaderSize - Offset;
+}
+
+STATIC
+UINTN
+GetPackedPadSize (
+  IN UINTN      Offset,
+  IN PACK_FILE  *Files,
+  IN UINTN      FileCount
+  )
+/*++
 
-  if (fwrite (FvImage, 1, FvImageSize, FvFile) != FvImageSize) {
-    Error (NULL, 0, 0002, "Error writing file", FvFileName);
-    Status = EFI_ABORTED;
-    goto Finish;
-  }
+Routine Description:
 
-Finish:
-  if (FvBufferHeader != NULL) {
-    free (FvBufferHeader);
-  }
+  Get the total size of the pad files needed to place files in order.
 
-  if (FvExtHeader != NULL) {
-    free (FvExtHeader);
-  }
-  
-  if (FvFile != NULL) {
-    fflush (FvFile);
-    fclose (FvFile);
-  }
-  
-  if (FvMapFile != NULL) {
-    fflush (FvMapFile);
-    fclose (FvMapFile);
-  }
+Arguments:
 
-  if (FvReportFile != NULL) {
-    fflush (FvReportFile);
-    fclose (FvReportFile);
+  Offset        The offset in the FV of the first file.
+  Files         The files.
+  FileCount     The number of files.
+
+Returns:
+
+  The total size of the pad files.
+
+--*/
+{
+  UINTN   Index;
+  UINTN   PadSize;
+  UINTN   TotalPadSize;
+
+  TotalPadSize = 0;
+  for (Index = 0; Index < FileCount; Index++) {
+    PadSize       = GetPadFileSize (Offset, &Files[Index]);
+    TotalPadSize += PadSize;
+    Offset       += PadSize + Files[Index].Size;
   }
-  return Status;
+  return TotalPadSize;
 }
 
+STATIC
 EFI_STATUS
-UpdatePeiCoreEntryInFit (
-  IN FIT_TABLE     *FitTablePtr,
-  IN UINT64        PeiCorePhysicalAddress
+PackFileRun (
+  IN     UINTN      Offset,
+  IN OUT PACK_FILE  *Files,
+  IN     UINTN      FileCount
   )
 /*++
 
 Routine Description:
 
-  This function is used to update the Pei Core address in FIT, this can be used by Sec core to pass control from
-  Sec to Pei Core
+  Reorder a run of movable files to reduce the padding between them.
+
+  The aligned file needing the least padding at the current offset is
+  placed next, preferring the largest alignment. Its pad is first filled
+  with unaligned files chosen by a subset sum over their sizes, in units of
+  the FV file alignment. The fill either closes the gap exactly or leaves
+  room for a pad file header, so the aligned file keeps its position. The
+  unaligned files left over are placed last. Files that need no reordering
+  keep their relative order.
 
 Arguments:
 
-  FitTablePtr             - The pointer of FIT_TABLE.
-  PeiCorePhysicalAddress  - The address of Pei Core entry.
+  Offset        The offset in the FV of the first file of the run.
+  Files         The files of the run, reordered on return.
+  FileCount     The number of files.
 
 Returns:
 
-  EFI_SUCCESS             - The PEI_CORE FIT entry was updated successfully.
-  EFI_NOT_FOUND           - Not found the PEI_CORE FIT entry.
+  EFI_SUCCESS              The files were reordered.
+  EFI_OUT_OF_RESOURCES     Insufficient resources exist to reorder them.
 
 --*/
 {
-  FIT_TABLE *TmpFitPtr;
-  UINTN     Index;
-  UINTN     NumFitComponents;
+  PACK_FILE   *Placed;
+  UINT8       *State;
+  UINTN       *First;
+  UINTN       PlacedCount;
+  UINTN       Index;
+  UINTN       Best;
+  UINTN       BestPad;
+  UINTN       PadSize;
+  UINTN       Units;
+  UINTN       Value;
+  UINTN       Weight;
+  EFI_STATUS  Status;
 
-  TmpFitPtr         = FitTablePtr;
-  NumFitComponents  = TmpFitPtr->CompSize;
+  //
+  // The pad before a file is below its alignment plus a pad file header.
+  //
+  Units = 0;
+  for (Index = 0; Index < FileCount; Index++) {
+    if ((Files[Index].Alignment + sizeof (EFI_FFS_FILE_HEADER)) / EFI_FFS_FILE_HEADER_ALIGNMENT > Units) {
+      Units = (Files[Index].Alignment + sizeof (EFI_FFS_FILE_HEADER)) / EFI_FFS_FILE_HEADER_ALIGNMENT;
+    }
+  }
 
-  for (Index = 0; Index < NumFitComponents; Index++) {
-    if ((TmpFitPtr->CvAndType & FIT_TYPE_MASK) == COMP_TYPE_FIT_PEICORE) {
-      TmpFitPtr->CompAddress = PeiCorePhysicalAddress;
-      return EFI_SUCCESS;
+  //
+  // State of each file: 0 not placed, 1 chosen to fill a pad, 2 placed.
+  //
+  Placed = (PACK_FILE *) malloc (FileCount * sizeof (PACK_FILE));
+  State  = (UINT8 *) calloc (FileCount, sizeof (UINT8));
+  First  = (UINTN *) malloc ((Units + 1) * sizeof (UINTN));
+  if (Placed == NULL || State == NULL || First == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  PlacedCount = 0;
+  for (;;) {
+    //
+    // Find the aligned file to place next.
+    //
+    Best    = FileCount;
+    BestPad = 0;
+    for (Index = 0; Index < FileCount; Index++) {
+      if (State[Index] != 0 || Files[Index].Alignment <= EFI_FFS_FILE_HEADER_ALIGNMENT) {
+        continue;
+      }
+      PadSize = GetPadFileSize (Offset, &Files[Index]);
+      if (Best == FileCount || PadSize < BestPad ||
+          (PadSize == BestPad && Files[Index].Alignment > Files[Best].Alignment)) {
+        Best    = Index;
+        BestPad = PadSize;
+      }
+    }
+    if (Best == FileCount) {
+      break;
     }
 
-    TmpFitPtr++;
+    if (BestPad != 0) {
+      //
+      // First[Value] is the first unaligned file reaching a fill of Value
+      // units, each earlier file of that fill being found at First[Value -
+      // its size]. FileCount marks an unreachable fill.
+      //
+      Units = BestPad / EFI_FFS_FILE_HEADER_ALIGNMENT;
+      for (Value = 0; Value <= Units; Value++) {
+        First[Value] = FileCount;
+      }
+      for (Index = 0; Index < FileCount && First[Units] == FileCount; Index++) {
+        if (State[Index] != 0 || Files[Index].Alignment > EFI_FFS_FILE_HEADER_ALIGNMENT) {
+          continue;
+        }
+        Weight = Files[Index].Size / EFI_FFS_FILE_HEADER_ALIGNMENT;
+        for (Value = Units; Value >= Weight && Weight != 0; Value--) {
+          if (First[Value] == FileCount && (Value == Weight || First[Value - Weight] != FileCount)) {
+            First[Value] = Index;
+          }
+        }
+      }
+
+      //
+      // Take an exact fill, or else the largest one leaving room for a pad
+      // file header.
+      //
+      Value = Units;
+      if (First[Value] == FileCount) {
+        Value = 0;
+        if (BestPad > sizeof (EFI_FFS_FILE_HEADER)) {
+          for (Value = (BestPad - sizeof (EFI_FFS_FILE_HEADER)) / EFI_FFS_FILE_HEADER_ALIGNMENT; Value > 0; Value--) {
+            if (First[Value] != FileCount) {
+              break;
+            }
+          }
+        }
+      }
+      while (Value != 0) {
+        Index        = First[Value];
+        State[Index] = 1;
+        Value       -= Files[Index].Size / EFI_FFS_FILE_HEADER_ALIGNMENT;
+      }
+      for (Index = 0; Index < FileCount; Index++) {
+        if (State[Index] == 1) {
+          State[Index] = 2;
+          Offset      += Files[Index].Size;
+          Placed[PlacedCount++] = Files[Index];
+        }
+      }
+    }
+
+    State[Best] = 2;
+    Offset += GetPadFileSize (Offset, &Files[Best]) + Files[Best].Size;
+    Placed[PlacedCount++] = Files[Best];
   }
 
-  return EFI_NOT_FOUND;
+  for (Index = 0; Index < FileCount; Index++) {
+    if (State[Index] == 0) {
+      Placed[PlacedCount++] = Files[Index];
+    }
+  }
+  memcpy (Files, Placed, FileCount * sizeof (PACK_FILE));
+  Status = EFI_SUCCESS;
+
+Done:
+  if (Placed != NULL) {
+    free (Placed);
+  }
+  if (State != NULL) {
+    free (State);
+  }
+  if (First != NULL) {
+    free (First);
+  }
+  return Status;
 }
 
-VOID
-UpdateFitCheckSum (
-  IN FIT_TABLE   *FitTablePtr
+STATIC
+EFI_STATUS
+PackFvFiles (
+  IN OUT FV_INFO  *FvInfo,
+  IN     UINTN    Offset
   )
 /*++
 
 Routine Description:
 
-  This function is used to update the checksum for FIT.
-
+  Reorder the files of a PI FV to reduce the padding needed for their
+  alignment. Apriori files and files given a taken size keep their place
+  in the file list and no file moves across them. The VTF file, which is
+  always placed at the end of the FV, is left where it is in the list.
+  The files are only reordered if that saves space.
 
 Arguments:
 
-  FitTablePtr             - The pointer of FIT_TABLE.
+  FvInfo        Pointer to information about the FV.
+  Offset        The offset in the FV of the first file.
 
 Returns:
 
-  None.
+  EFI_SUCCESS              The files were reordered or left unchanged.
+  EFI_ABORTED              A file could not be read.
+  EFI_OUT_OF_RESOURCES     Insufficient resources exist to reorder them.
 
 --*/
 {
-  if ((FitTablePtr->CvAndType & CHECKSUM_BIT_MASK) >> 7) {
-    FitTablePtr->CheckSum = 0;
-    FitTablePtr->CheckSum = CalculateChecksum8 ((UINT8 *) FitTablePtr, FitTablePtr->CompSize * 16);
+  PACK_FILE             *Files;
+  UINTN                 FileCount;
+  UINTN                 Index;
+  UINTN                 Position;
+  UINTN                 VtfIndex;
+  UINTN                 RunStart;
+  UINTN                 RunOffset;
+  UINTN                 OriginalPadSize;
+  UINTN                 PackedPadSize;
+  UINT8                 *FileImage;
+  UINTN                 FileSize;
+  UINT32                Alignment;
+  EFI_FFS_FILE_HEADER   FfsHeader;
+  CHAR8                 **FvFiles;
+  UINT32                *SizeofFvFiles;
+  MAPPED_FILE           *FvFileImages;
+  FV_FILE_STAMP         *FileStamps;
+  EFI_STATUS            Status;
+
+  Files         = (PACK_FILE *) malloc ((FvInfo->FvFileCount + 1) * sizeof (PACK_FILE));
+  FvFiles       = (CHAR8 **) malloc ((FvInfo->FvFileCount + 1) * sizeof (CHAR8 *));
+  SizeofFvFiles = (UINT32 *) malloc ((FvInfo->FvFileCount + 1) * sizeof (UINT32));
+  FvFileImages  = (MAPPED_FILE *) malloc ((FvInfo->FvFileCount + 1) * sizeof (MAPPED_FILE));
+  FileStamps    = (FV_FILE_STAMP *) malloc ((FvInfo->FvFileCount + 1) * sizeof (FV_FILE_STAMP));
+  if (Files == NULL || FvFiles == NULL || SizeofFvFiles == NULL || FvFileImages == NULL || FileStamps == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  //
+  // Collect the files placed in sequence, in list order.
+  //
+  FileCount = 0;
+  VtfIndex  = FvInfo->FvFileCount;
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    Status = GetFvFileImage (FvInfo, Index, &FileImage, &FileSize);
+    if (EFI_ERROR (Status)) {
+      Status = EFI_ABORTED;
+      goto Done;
+    }
+    memset (&FfsHeader, 0, sizeof (EFI_FFS_FILE_HEADER));
+    memcpy (&FfsHeader, FileImage, FileSize < sizeof (EFI_FFS_FILE_HEADER) ? FileSize : sizeof (EFI_FFS_FILE_HEADER));
+    if (IsVtfFile (&FfsHeader)) {
+      if (VtfIndex != FvInfo->FvFileCount) {
+        //
+        // CalculateFvSize reports the second VTF file.
+        //
+        Status = EFI_SUCCESS;
+        goto Done;
+      }
+      VtfIndex = Index;
+      continue;
+    }
+    if (FvInfo->SizeofFvFiles[Index] > FileSize) {
+      FileSize = FvInfo->SizeofFvFiles[Index];
+    }
+    ReadFfsAlignment (&FfsHeader, &Alignment);
+    Files[FileCount].Index      = Index;
+    Files[FileCount].Size       = (FileSize + EFI_FFS_FILE_HEADER_ALIGNMENT - 1) & ~(EFI_FFS_FILE_HEADER_ALIGNMENT - 1);
+    Files[FileCount].HeaderSize = mFvFileImages[Index].Size >= MAX_FFS_SIZE ? sizeof (EFI_FFS_FILE_HEADER2) : sizeof (EFI_FFS_FILE_HEADER);
+    Files[FileCount].Alignment  = 1 << Alignment;
+    Files[FileCount].Fixed      = (BOOLEAN) (FvInfo->SizeofFvFiles[Index] != 0 ||
+                                             CompareGuid (&FfsHeader.Name, &mPeiAprioriFileGuid) == 0 ||
+                                             CompareGuid (&FfsHeader.Name, &mDxeAprioriFileGuid) == 0);
+    FileCount++;
+  }
+
+  OriginalPadSize = GetPackedPadSize (Offset, Files, FileCount);
+
+  //
+  // Pack each run of movable files between the fixed ones.
+  //
+  RunStart  = 0;
+  RunOffset = Offset;
+  for (Index = 0; Index <= FileCount; Index++) {
+    if (Index < FileCount && !Files[Index].Fixed) {
+      continue;
+    }
+    if (Index > RunStart) {
+      Status = PackFileRun (RunOffset, &Files[RunStart], Index - RunStart);
+      if (EFI_ERROR (Status)) {
+        Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+        goto Done;
+      }
+    }
+    for (; RunStart <= Index && RunStart < FileCount; RunStart++) {
+      RunOffset += GetPadFileSize (RunOffset, &Files[RunStart]) + Files[RunStart].Size;
+    }
+  }
+
+  PackedPadSize = GetPackedPadSize (Offset, Files, FileCount);
+  if (PackedPadSize >= OriginalPadSize) {
+    NormalMsg ("FV file packing saved no padding, %u bytes of padding are needed", (unsigned) OriginalPadSize);
+    Status = EFI_SUCCESS;
+    goto Done;
+  }
+
+  //
+  // Apply the new order to the file tables. The VTF file keeps its place.
+  //
+  Position = 0;
+  for (Index = 0; Index < FvInfo->FvFileCount; Index++) {
+    if (Index == VtfIndex) {
+      FvFiles[Index]       = FvInfo->FvFiles[Index];
+      SizeofFvFiles[Index] = FvInfo->SizeofFvFiles[Index];
+      FvFileImages[Index]  = mFvFileImages[Index];
+      FileStamps[Index]    = mFileStamps[Index];
+      continue;
+    }
+    FvFiles[Index]       = FvInfo->FvFiles[Files[Position].Index];
+    SizeofFvFiles[Index] = FvInfo->SizeofFvFiles[Files[Position].Index];
+    FvFileImages[Index]  = mFvFileImages[Files[Position].Index];
+    FileStamps[Index]    = mFileStamps[Files[Position].Index];
+    Position++;
+  }
+  memcpy (FvInfo->FvFiles, FvFiles, FvInfo->FvFileCount * sizeof (CHAR8 *));
+  memcpy (FvInfo->SizeofFvFiles, SizeofFvFiles, FvInfo->FvFileCount * sizeof (UINT32));
+  memcpy (mFvFileImages, FvFileImages, FvInfo->FvFileCount * sizeof (MAPPED_FILE));
+  memcpy (mFileStamps, FileStamps, FvInfo->FvFileCount * sizeof (FV_FILE_STAMP));
+
+  NormalMsg ("FV file packing saved %u bytes of padding, %u bytes of padding are left", (unsigned) (OriginalPadSize - PackedPadSize), (unsigned) PackedPadSize);
+  Status = EFI_SUCCESS;
+
+Done:
+  if (Files != NULL) {
+    free (Files);
+  }
+  if (FvFiles != NULL) {
+    free (FvFiles);
+  }
+  if (SizeofFvFiles != NULL) {
+    free (SizeofFvFiles);
+  }
+  if (FvFileImages != NULL) {
+    free (FvFileImages);
   }
+  if (FileStamps != NULL) {
+    free (FileStamps);
+  }
+  return Status;
 }
 
 EFI_STATUS
@@ -2620,6 +5020,8 @@ Returns:
   EFI_FFS_FILE_HEADER FfsHeader;
   BOOLEAN             VtfFileFlag;
   UINTN               VtfFileSize;
+  UINT8               *FfsFileImage;
+  EFI_STATUS          Status;
   
   FvExtendHeaderSize = 0;
   VtfFileSize = 0;
@@ -2670,23 +5072,27 @@ Returns:
     CurrentOffset = (CurrentOffset + 7) & (~7);
   }
 
+  //
+  // Reorder the files to reduce the alignment padding when asked to.
+  //
+  if (FvInfoPtr->PackFiles && FvInfoPtr->IsPiFvImage) {
+    Status = PackFvFiles (FvInfoPtr, CurrentOffset);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
   //
   // Accumlate every FFS file size.
   //
-  for (Index = 0; FvInfoPtr->FvFiles[Index][0] != 0; Index++) {
+  for (Index = 0; Index < FvInfoPtr->FvFileCount; Index++) {
     //
-    // Open FFS file
+    // Map FFS file, AddFile uses the same mapping later
     //
-    fpin = NULL;
-    fpin = fopen (FvInfoPtr->FvFiles[Index], "rb");
-    if (fpin == NULL) {
-      Error (NULL, 0, 0001, "Error opening file", FvInfoPtr->FvFiles[Index]);
+    Status = GetFvFileImage (FvInfoPtr, Index, &FfsFileImage, &FfsFileSize);
+    if (EFI_ERROR (Status)) {
       return EFI_ABORTED;
     }
-    //
-    // Get the file size
-    //
-    FfsFileSize = _filelength (fileno (fpin));
     if (FfsFileSize >= MAX_FFS_SIZE) {
       FfsHeaderSize = sizeof(EFI_FFS_FILE_HEADER2);
       mIsLargeFfs = TRUE;
@@ -2694,13 +5100,10 @@ Returns:
       FfsHeaderSize = sizeof(EFI_FFS_FILE_HEADER);
     }
     //
-    // Read Ffs File header
-    //
-    fread (&FfsHeader, sizeof (UINT8), sizeof (EFI_FFS_FILE_HEADER), fpin);
-    //
-    // close file
+    // Get Ffs File header
     //
-    fclose (fpin);
+    memset (&FfsHeader, 0, sizeof (EFI_FFS_FILE_HEADER));
+    memcpy (&FfsHeader, FfsFileImage, FfsFileSize < sizeof (EFI_FFS_FILE_HEADER) ? FfsFileSize : sizeof (EFI_FFS_FILE_HEADER));
     
     if (FvInfoPtr->IsPiFvImage) {
 	    //
@@ -2842,7 +5245,8 @@ Arguments:
 
 Returns:
 
-  EFI_SUCCESS        Base address of child Fv image is recorded.
+  EFI_SUCCESS           Base address of child Fv image is recorded.
+  EFI_OUT_OF_RESOURCES  Insufficient resources exist to record it.
 --*/
 {
   EFI_STATUS                          Status;
@@ -2864,42 +5268,113 @@ Returns:
     // Rebase on Flash
     //
     SubFvBaseAddress = FvInfo->BaseAddress + (UINTN) SubFvImageHeader - (UINTN) FfsFile + XipOffset;
+    Status = GrowTable ((VOID **) &mFvBaseAddress, &mMaxFvBaseAddress, sizeof (EFI_PHYSICAL_ADDRESS), mFvBaseAddressNumber + 1);
+    if (EFI_ERROR (Status)) {
+      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated for the child FV base addresses.");
+      return Status;
+    }
     mFvBaseAddress[mFvBaseAddressNumber ++ ] = SubFvBaseAddress;
   }
 
   return EFI_SUCCESS;
 }
 
+STATIC
+VOID
+FfsRebaseMessage (
+  IN OUT FFS_REBASE_JOB   *Job,
+  IN     UINT8            Type,
+  IN     UINT64           Code,
+  IN     CHAR8            *Text,
+  IN     CHAR8            *MsgFmt,
+  ...
+  )
+/*++
+
+Routine Description:
+
+  Report an error, warning or debug message of a file rebase. A rebase run
+  on a worker thread keeps the message in its job for RebaseFvFiles to
+  print, other rebases print it at once.
+
+Arguments:
+
+  Job           The job of a rebase run on a worker thread, or NULL.
+  Type          FFS_REBASE_ERROR, FFS_REBASE_WARNING or FFS_REBASE_DEBUG.
+  Code          The message code, or the debug level of a debug message.
+  Text          The message text.
+  MsgFmt        The format of the message details.
+
+Returns:
+
+  None
+
+--*/
+{
+  CHAR8               Message[MAX_LINE_LEN];
+  FFS_REBASE_MESSAGE  *Record;
+  va_list             List;
+
+  va_start (List, MsgFmt);
+  vsprintf (Message, MsgFmt, List);
+  va_end (List);
+
+  if (Job == NULL) {
+    if (Type == FFS_REBASE_ERROR) {
+      Error (NULL, 0, (UINT32) Code, Text, "%s", Message);
+    } else if (Type == FFS_REBASE_WARNING) {
+      Warning (NULL, 0, (UINT32) Code, Text, "%s", Message);
+    } else {
+      DebugMsg (NULL, 0, Code, Text, "%s", Message);
+    }
+    return;
+  }
+
+  //
+  // A message that cannot be kept is lost, the job status still tells
+  // RebaseFvFiles whether the rebase failed.
+  //
+  if (EFI_ERROR (GrowTable ((VOID **) &Job->Messages, &Job->MaxMessageCount, sizeof (FFS_REBASE_MESSAGE), Job->MessageCount + 1))) {
+    return;
+  }
+  Record       = &Job->Messages[Job->MessageCount++];
+  Record->Type = Type;
+  Record->Code = Code;
+  Record->Text = Text;
+  strcpy (Record->Message, Message);
+}
+
+STATIC
 EFI_STATUS
-FfsRebase ( 
-  IN OUT  FV_INFO               *FvInfo, 
-  IN      CHAR8                 *FileName,           
+RebaseFfsFile (
+  IN OUT  FV_INFO               *FvInfo,
+  IN      CHAR8                 *FileName,
   IN OUT  EFI_FFS_FILE_HEADER   *FfsFile,
   IN      UINTN                 XipOffset,
-  IN      FILE                  *FvMapFile
+  IN      FILE                  *FvMapFile,
+  OUT     BOOLEAN               *IsArm,
+  IN OUT  FFS_REBASE_JOB        *Job
   )
 /*++
 
 Routine Description:
 
-  This function determines if a file is XIP and should be rebased.  It will
-  rebase any PE32 sections found in the file using the base address.
+  FfsRebase, with the messages kept in Job when the file is rebased on a
+  worker thread.
 
 Arguments:
-  
+
   FvInfo            A pointer to FV_INFO struture.
   FileName          Ffs File PathName
   FfsFile           A pointer to Ffs file image.
   XipOffset         The offset address to use for rebasing the XIP file image.
   FvMapFile         FvMapFile to record the function address in one Fvimage
+  IsArm             Set to TRUE if an ARM or AARCH64 image is found.
+  Job               The job of a rebase run on a worker thread, or NULL.
 
 Returns:
 
-  EFI_SUCCESS             The image was properly rebased.
-  EFI_INVALID_PARAMETER   An input parameter is invalid.
-  EFI_ABORTED             An error occurred while rebasing the input file image.
-  EFI_OUT_OF_RESOURCES    Could not allocate a required resource.
-  EFI_NOT_FOUND           No compressed sections could be found.
+  As FfsRebase.
 
 --*/
 {
@@ -2963,11 +5438,7 @@ Returns:
       break;
     case EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE:
       //
-      // Rebase the inside FvImage.
-      //
-      GetChildFvFromFfs (FvInfo, FfsFile, XipOffset);
-
-      //
+      // The base of the inside FvImage is recorded by AddRebaseJob.
       // Search PE/TE section in FV sectin.
       //
       break;
@@ -3003,13 +5474,13 @@ Returns:
     ImageContext.ImageRead  = (PE_COFF_LOADER_READ_FILE) FfsRebaseImageRead;
     Status                  = PeCoffLoaderGetImageInfo (&ImageContext);
     if (EFI_ERROR (Status)) {
-      Error (NULL, 0, 3000, "Invalid PeImage", "The input file is %s and the return status is %x", FileName, (int) Status);
+      FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid PeImage", "The input file is %s and the return status is %x", FileName, (int) Status);
       return Status;
     }
 
     if ( (ImageContext.Machine == EFI_IMAGE_MACHINE_ARMT) ||
          (ImageContext.Machine == EFI_IMAGE_MACHINE_AARCH64) ) {
-      mArm = TRUE;
+      *IsArm = TRUE;
     }
 
     //
@@ -3042,7 +5513,7 @@ Returns:
           //
           // Xip module has the same section alignment and file alignment.
           //
-          Error (NULL, 0, 3000, "Invalid", "Section-Alignment and File-Alignment do not match : %s.", FileName);
+          FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid", "Section-Alignment and File-Alignment do not match : %s.", FileName);
           return EFI_ABORTED;
         }
         //
@@ -3058,7 +5529,7 @@ Returns:
             Cptr --;
           }
           if (*Cptr != '.') {
-            Error (NULL, 0, 3000, "Invalid", "The file %s has no .reloc section.", FileName);
+            FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid", "The file %s has no .reloc section.", FileName);
             return EFI_ABORTED;
           } else {
             *(Cptr + 1) = 'e';
@@ -3068,7 +5539,7 @@ Returns:
           }
           PeFile = fopen (PeFileName, "rb");
           if (PeFile == NULL) {
-            Warning (NULL, 0, 0, "Invalid", "The file %s has no .reloc section.", FileName);
+            FfsRebaseMessage (Job, FFS_REBASE_WARNING, 0, "Invalid", "The file %s has no .reloc section.", FileName);
             //Error (NULL, 0, 3000, "Invalid", "The file %s has no .reloc section.", FileName);
             //return EFI_ABORTED;
             break;
@@ -3079,7 +5550,7 @@ Returns:
           PeFileSize = _filelength (fileno (PeFile));
           PeFileBuffer = (UINT8 *) malloc (PeFileSize);
           if (PeFileBuffer == NULL) {
-            Error (NULL, 0, 4001, "Resource", "memory cannot be allocated on rebase of %s", FileName);
+            FfsRebaseMessage (Job, FFS_REBASE_ERROR, 4001, "Resource", "memory cannot be allocated on rebase of %s", FileName);
             return EFI_OUT_OF_RESOURCES;
           }
           //
@@ -3096,7 +5567,7 @@ Returns:
           ImageContext.Handle = PeFileBuffer;
           Status              = PeCoffLoaderGetImageInfo (&ImageContext);
           if (EFI_ERROR (Status)) {
-            Error (NULL, 0, 3000, "Invalid PeImage", "The input file is %s and the return status is %x", FileName, (int) Status);
+            FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid PeImage", "The input file is %s and the return status is %x", FileName, (int) Status);
             return Status;
           }
           ImageContext.RelocationsStripped = FALSE;
@@ -3114,7 +5585,7 @@ Returns:
           //
           // Xip module has the same section alignment and file alignment.
           //
-          Error (NULL, 0, 3000, "Invalid", "Section-Alignment and File-Alignment do not match : %s.", FileName);
+          FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid", "Section-Alignment and File-Alignment do not match : %s.", FileName);
           return EFI_ABORTED;
         }
         NewPe32BaseAddress = XipBase + (UINTN) CurrentPe32Section.Pe32Section + CurSecHdrSize - (UINTN)FfsFile;
@@ -3131,7 +5602,7 @@ Returns:
     // Relocation doesn't exist
     //
     if (ImageContext.RelocationsStripped) {
-      Warning (NULL, 0, 0, "Invalid", "The file %s has no .reloc section.", FileName);
+      FfsRebaseMessage (Job, FFS_REBASE_WARNING, 0, "Invalid", "The file %s has no .reloc section.", FileName);
       continue;
     }
 
@@ -3143,7 +5614,7 @@ Returns:
     //
     MemoryImagePointer = (UINT8 *) malloc ((UINTN) ImageContext.ImageSize + ImageContext.SectionAlignment);
     if (MemoryImagePointer == NULL) {
-      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated on rebase of %s", FileName);
+      FfsRebaseMessage (Job, FFS_REBASE_ERROR, 4001, "Resource", "memory cannot be allocated on rebase of %s", FileName);
       return EFI_OUT_OF_RESOURCES;
     }
     memset ((VOID *) MemoryImagePointer, 0, (UINTN) ImageContext.ImageSize + ImageContext.SectionAlignment);
@@ -3151,7 +5622,7 @@ Returns:
     
     Status =  PeCoffLoaderLoadImage (&ImageContext);
     if (EFI_ERROR (Status)) {
-      Error (NULL, 0, 3000, "Invalid", "LocateImage() call failed on rebase of %s", FileName);
+      FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid", "LocateImage() call failed on rebase of %s", FileName);
       free ((VOID *) MemoryImagePointer);
       return Status;
     }
@@ -3159,10 +5630,12 @@ Returns:
     ImageContext.DestinationAddress = NewPe32BaseAddress;
     Status                          = PeCoffLoaderRelocateImage (&ImageContext);
     if (EFI_ERROR (Status)) {
-      Error (NULL, 0, 3000, "Invalid", "RelocateImage() call failed on rebase of %s", FileName);
+      FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid", "RelocateImage() call failed on rebase of %s", FileName);
       free ((VOID *) MemoryImagePointer);
       return Status;
     }
+    FfsRebaseMessage (Job, FFS_REBASE_DEBUG, 9, "relocation info", "%u relocation blocks, %u fixups applied in runs, %u one at a time",
+      (unsigned) ImageContext.RelocBlockCount, (unsigned) ImageContext.FastFixupCount, (unsigned) ImageContext.GenericFixupCount);
 
     //
     // Copy Relocated data to raw image file.
@@ -3197,7 +5670,7 @@ Returns:
     } else if (ImgHdr->Pe32Plus.OptionalHeader.Magic == EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
       ImgHdr->Pe32Plus.OptionalHeader.ImageBase = NewPe32BaseAddress;
     } else {
-      Error (NULL, 0, 3000, "Invalid", "unknown PE magic signature %X in PE32 image %s",
+      FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid", "unknown PE magic signature %X in PE32 image %s",
         ImgHdr->Pe32.OptionalHeader.Magic,
         FileName
         );
@@ -3274,13 +5747,13 @@ Returns:
     ImageContext.ImageRead  = (PE_COFF_LOADER_READ_FILE) FfsRebaseImageRead;
     Status                  = PeCoffLoaderGetImageInfo (&ImageContext);
     if (EFI_ERROR (Status)) {
-      Error (NULL, 0, 3000, "Invalid TeImage", "The input file is %s and the return status is %x", FileName, (int) Status);
+      FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid TeImage", "The input file is %s and the return status is %x", FileName, (int) Status);
       return Status;
     }
 
     if ( (ImageContext.Machine == EFI_IMAGE_MACHINE_ARMT) ||
          (ImageContext.Machine == EFI_IMAGE_MACHINE_AARCH64) ) {
-      mArm = TRUE;
+      *IsArm = TRUE;
     }
 
     //
@@ -3313,7 +5786,7 @@ Returns:
       }
 
       if (*Cptr != '.') {
-        Error (NULL, 0, 3000, "Invalid", "The file %s has no .reloc section.", FileName);
+        FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid", "The file %s has no .reloc section.", FileName);
         return EFI_ABORTED;
       } else {
         *(Cptr + 1) = 'e';
@@ -3324,7 +5797,7 @@ Returns:
 
       PeFile = fopen (PeFileName, "rb");
       if (PeFile == NULL) {
-        Warning (NULL, 0, 0, "Invalid", "The file %s has no .reloc section.", FileName);
+        FfsRebaseMessage (Job, FFS_REBASE_WARNING, 0, "Invalid", "The file %s has no .reloc section.", FileName);
         //Error (NULL, 0, 3000, "Invalid", "The file %s has no .reloc section.", FileName);
         //return EFI_ABORTED;
       } else {
@@ -3334,7 +5807,7 @@ Returns:
         PeFileSize = _filelength (fileno (PeFile));
         PeFileBuffer = (UINT8 *) malloc (PeFileSize);
         if (PeFileBuffer == NULL) {
-          Error (NULL, 0, 4001, "Resource", "memory cannot be allocated on rebase of %s", FileName);
+          FfsRebaseMessage (Job, FFS_REBASE_ERROR, 4001, "Resource", "memory cannot be allocated on rebase of %s", FileName);
           return EFI_OUT_OF_RESOURCES;
         }
         //
@@ -3351,7 +5824,7 @@ Returns:
         ImageContext.Handle = PeFileBuffer;
         Status              = PeCoffLoaderGetImageInfo (&ImageContext);
         if (EFI_ERROR (Status)) {
-          Error (NULL, 0, 3000, "Invalid TeImage", "The input file is %s and the return status is %x", FileName, (int) Status);
+          FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid TeImage", "The input file is %s and the return status is %x", FileName, (int) Status);
           return Status;
         }
         ImageContext.RelocationsStripped = FALSE;
@@ -3361,7 +5834,7 @@ Returns:
     // Relocation doesn't exist
     //
     if (ImageContext.RelocationsStripped) {
-      Warning (NULL, 0, 0, "Invalid", "The file %s has no .reloc section.", FileName);
+      FfsRebaseMessage (Job, FFS_REBASE_WARNING, 0, "Invalid", "The file %s has no .reloc section.", FileName);
       continue;
     }
 
@@ -3373,7 +5846,7 @@ Returns:
     //
     MemoryImagePointer = (UINT8 *) malloc ((UINTN) ImageContext.ImageSize + ImageContext.SectionAlignment);
     if (MemoryImagePointer == NULL) {
-      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated on rebase of %s", FileName);
+      FfsRebaseMessage (Job, FFS_REBASE_ERROR, 4001, "Resource", "memory cannot be allocated on rebase of %s", FileName);
       return EFI_OUT_OF_RESOURCES;
     }
     memset ((VOID *) MemoryImagePointer, 0, (UINTN) ImageContext.ImageSize + ImageContext.SectionAlignment);
@@ -3381,7 +5854,7 @@ Returns:
 
     Status =  PeCoffLoaderLoadImage (&ImageContext);
     if (EFI_ERROR (Status)) {
-      Error (NULL, 0, 3000, "Invalid", "LocateImage() call failed on rebase of %s", FileName);
+      FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid", "LocateImage() call failed on rebase of %s", FileName);
       free ((VOID *) MemoryImagePointer);
       return Status;
     }
@@ -3391,10 +5864,12 @@ Returns:
     ImageContext.DestinationAddress = NewPe32BaseAddress;
     Status                          = PeCoffLoaderRelocateImage (&ImageContext);
     if (EFI_ERROR (Status)) {
-      Error (NULL, 0, 3000, "Invalid", "RelocateImage() call failed on rebase of TE image %s", FileName);
+      FfsRebaseMessage (Job, FFS_REBASE_ERROR, 3000, "Invalid", "RelocateImage() call failed on rebase of TE image %s", FileName);
       free ((VOID *) MemoryImagePointer);
       return Status;
     }
+    FfsRebaseMessage (Job, FFS_REBASE_DEBUG, 9, "relocation info", "%u relocation blocks, %u fixups applied in runs, %u one at a time",
+      (unsigned) ImageContext.RelocBlockCount, (unsigned) ImageContext.FastFixupCount, (unsigned) ImageContext.GenericFixupCount);
     
     //
     // Copy the relocated image into raw image file.
@@ -3467,6 +5942,46 @@ Returns:
   return EFI_SUCCESS;
 }
 
+EFI_STATUS
+FfsRebase ( 
+  IN OUT  FV_INFO               *FvInfo, 
+  IN      CHAR8                 *FileName,           
+  IN OUT  EFI_FFS_FILE_HEADER   *FfsFile,
+  IN      UINTN                 XipOffset,
+  IN      FILE                  *FvMapFile,
+  OUT     BOOLEAN               *IsArm
+  )
+/*++
+
+Routine Description:
+
+  This function determines if a file is XIP and should be rebased.  It will
+  rebase any PE32 sections found in the file using the base address.
+  It only changes the file itself, so different files may be rebased at
+  the same time.
+
+Arguments:
+  
+  FvInfo            A pointer to FV_INFO struture.
+  FileName          Ffs File PathName
+  FfsFile           A pointer to Ffs file image.
+  XipOffset         The offset address to use for rebasing the XIP file image.
+  FvMapFile         FvMapFile to record the function address in one Fvimage
+  IsArm             Set to TRUE if an ARM or AARCH64 image is found.
+
+Returns:
+
+  EFI_SUCCESS             The image was properly rebased.
+  EFI_INVALID_PARAMETER   An input parameter is invalid.
+  EFI_ABORTED             An error occurred while rebasing the input file image.
+  EFI_OUT_OF_RESOURCES    Could not allocate a required resource.
+  EFI_NOT_FOUND           No compressed sections could be found.
+
+--*/
+{
+  return RebaseFfsFile (FvInfo, FileName, FfsFile, XipOffset, FvMapFile, IsArm, NULL);
+}
+
 EFI_STATUS
 FindApResetVectorPosition (
   IN  MEMORY_FILE  *FvImage,
@@ -3495,12 +6010,21 @@ Returns:
   EFI_STATUS            Status;
   UINT8                 *FixPoint;
   UINT32                FileLength;
+  FV_INDEX              *FvIndex;
+
+  //
+  // Index the FV once rather than walk it again for each pad file.
+  //
+  Status = OpenFvIndex (FvImage->FileImage, (UINT32) (FvImage->Eof - FvImage->FileImage), &FvIndex);
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
 
   for (Index = 1; ;Index ++) {
     //
     // Find Pad File to add ApResetVector info
     //
-    Status = GetFileByType (EFI_FV_FILETYPE_FFS_PAD, Index, &PadFile);
+    Status = GetIndexedFileByType (FvIndex, EFI_FV_FILETYPE_FFS_PAD, Index, &PadFile);
     if (EFI_ERROR (Status) || (PadFile == NULL)) {
       //
       // No Pad file to be found.
@@ -3537,10 +6061,12 @@ Returns:
       // Find the position to place ApResetVector
       //
       *Pointer = FixPoint;
+      CloseFvIndex (FvIndex);
       return EFI_SUCCESS;
     }
   }
   
+  CloseFvIndex (FvIndex);
   return EFI_NOT_FOUND;
 }
 
@@ -3569,7 +6095,7 @@ Returns:
 {
   CHAR8       Value[_MAX_PATH];
   UINT64      Value64;
-  UINTN       Index, Number;
+  UINTN       Index;
   EFI_STATUS  Status;
 
   //
@@ -3655,30 +6181,29 @@ Returns:
   }
 
   //
-  // Read the Capsule FileImage
+  // Read the Capsule FileImage, after the files given on the command line
   //
-  Number = 0;
-  for (Index = 0; Index < MAX_NUMBER_OF_FILES_IN_CAP; Index++) {
-    if (CapInfo->CapFiles[Index][0] != '\0') {
-      continue;
-    }
+  for (Index = 0;; Index++) {
     //
     // Read the capsule file name
     //
-    Status = FindToken (InfFile, FILES_SECTION_STRING, EFI_FILE_NAME_STRING, Number++, Value);
+    Status = FindToken (InfFile, FILES_SECTION_STRING, EFI_FILE_NAME_STRING, Index, Value);
 
     if (Status == EFI_SUCCESS) {
       //
       // Add the file
       //
-      strcpy (CapInfo->CapFiles[Index], Value);
-      DebugMsg (NULL, 0, 9, "Capsule component file", "the %uth file name is %s", (unsigned) Index, CapInfo->CapFiles[Index]); 
+      Status = AddCapFile (CapInfo, Value);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      DebugMsg (NULL, 0, 9, "Capsule component file", "the %uth file name is %s", (unsigned) (CapInfo->CapFileCount - 1), Value); 
     } else {
       break;
     }
   }
   
-  if (Index == 0) {
+  if (CapInfo->CapFileCount == 0) {
     Warning (NULL, 0, 0, "Capsule components are not specified.", NULL);
   }
 
@@ -3772,7 +6297,7 @@ Returns:
   Index    = 0;
   FileSize = 0;
   CapSize  = mCapDataInfo.HeaderSize;
-  while (mCapDataInfo.CapFiles [Index][0] != '\0') {
+  while (Index < mCapDataInfo.CapFileCount) {
     fpin = fopen (mCapDataInfo.CapFiles[Index], "rb");
     if (fpin == NULL) {
       Error (NULL, 0, 0001, "Error opening file", mCapDataInfo.CapFiles[Index]);
@@ -3810,7 +6335,7 @@ Returns:
   Index    = 0;
   FileSize = 0;
   CapSize  = CapsuleHeader->HeaderSize;
-  while (mCapDataInfo.CapFiles [Index][0] != '\0') {
+  while (Index < mCapDataInfo.CapFileCount) {
     fpin = fopen (mCapDataInfo.CapFiles[Index], "rb");
     if (fpin == NULL) {
       Error (NULL, 0, 0001, "Error opening file", mCapDataInfo.CapFiles[Index]);
@@ -46,20 +46,12 @@ Abstract:
 #define FILE_SEP_CHAR '/'
 
 //
-// The maximum number of Pad file guid entries.
+// The file, block map and child FV tables grow as needed. The file names
+// are kept in blocks of FILE_NAME_ARENA_BLOCK_SIZE bytes, so that a long
+// file list needs few allocations.
 //
-#define MAX_NUMBER_OF_PAD_FILE_GUIDS    1024
+#define FILE_NAME_ARENA_BLOCK_SIZE      0x4000
 
-//
-// The maximum number of block map entries supported by the library
-//
-#define MAX_NUMBER_OF_FV_BLOCKS         100
-
-//
-// The maximum number of files in the FV supported by the library
-//
-#define MAX_NUMBER_OF_FILES_IN_FV       1000
-#define MAX_NUMBER_OF_FILES_IN_CAP      1000
 #define EFI_FFS_FILE_HEADER_ALIGNMENT   8
 //
 // INF file strings
@@ -89,6 +81,13 @@ Abstract:
 #define EFI_FV_TAKEN_SIZE_STRING    "EFI_FV_TAKEN_SIZE"
 #define EFI_FV_SPACE_SIZE_STRING    "EFI_FV_SPACE_SIZE"
 
+//
+// Build record written to the FV report file for incremental rebuilds
+//
+#define EFI_FV_BUILD_SIGNATURE_STRING "EFI_FV_BUILD_SIGNATURE"
+#define EFI_FV_IMAGE_DIGEST_STRING    "EFI_FV_IMAGE_DIGEST"
+#define EFI_FV_FILE_STAMP_STRING      "EFI_FV_FILE_STAMP"
+
 //
 // Attributes section
 //
@@ -217,9 +216,34 @@ typedef struct {
   CHAR8 ComponentName[_MAX_PATH];
 } COMPONENT_INFO;
 
+//
+// Block of file name storage. The names follow the header.
+//
+typedef struct _FILE_NAME_ARENA_BLOCK {
+  struct _FILE_NAME_ARENA_BLOCK *Next;
+  UINTN                         Size;
+  UINTN                         Used;
+} FILE_NAME_ARENA_BLOCK;
+
+//
+// Contents of an FFS file supplied in memory. The FV uses it in place of
+// the file of the same name.
+//
+typedef struct {
+  CHAR8                   *Name;
+  UINT8                   *Data;
+  UINTN                   Size;
+} FV_FILE_BUFFER;
+
 //
 // FV and capsule information holder
 //
+// FvBlocks always ends with a zero entry once an entry was added with
+// GetFvBlockMapEntry. FvFiles and SizeofFvFiles hold FvFileCount entries
+// added with AddFvFile, FvFileBuffers holds FvFileBufferCount entries added
+// with AddFvFileBuffer, and CapFiles holds CapFileCount entries added with
+// AddCapFile.
+//
 typedef struct {
   BOOLEAN                 BaseAddressSet;
   EFI_PHYSICAL_ADDRESS    BaseAddress;
@@ -231,11 +255,20 @@ typedef struct {
   UINTN                   Size;
   EFI_FVB_ATTRIBUTES_2    FvAttributes;
   CHAR8                   FvName[_MAX_PATH];
-  EFI_FV_BLOCK_MAP_ENTRY  FvBlocks[MAX_NUMBER_OF_FV_BLOCKS];
-  CHAR8                   FvFiles[MAX_NUMBER_OF_FILES_IN_FV][_MAX_PATH];
-  UINT32                  SizeofFvFiles[MAX_NUMBER_OF_FILES_IN_FV];
+  EFI_FV_BLOCK_MAP_ENTRY  *FvBlocks;
+  UINTN                   MaxFvBlocks;
+  CHAR8                   **FvFiles;
+  UINT32                  *SizeofFvFiles;
+  UINTN                   FvFileCount;
+  UINTN                   MaxFvFiles;
+  FV_FILE_BUFFER          *FvFileBuffers;
+  UINTN                   FvFileBufferCount;
+  UINTN                   MaxFvFileBuffers;
+  FILE_NAME_ARENA_BLOCK   *FileNames;
   BOOLEAN                 IsPiFvImage;
   INT8                    ForceRebase;
+  BOOLEAN                 PackFiles;
+  BOOLEAN                 Incremental;
 } FV_INFO;
 
 typedef struct {
@@ -243,7 +276,10 @@ typedef struct {
   UINT32                  HeaderSize;
   UINT32                  Flags;
   CHAR8                   CapName[_MAX_PATH];
-  CHAR8                   CapFiles[MAX_NUMBER_OF_FILES_IN_CAP][_MAX_PATH];
+  CHAR8                   **CapFiles;
+  UINTN                   CapFileCount;
+  UINTN                   MaxCapFiles;
+  FILE_NAME_ARENA_BLOCK   *FileNames;
 } CAP_INFO;
 
 #pragma pack(1)
@@ -266,8 +302,9 @@ extern EFI_GUID   mEfiFirmwareFileSystem3Guid;
 extern UINT32     mFvTotalSize;
 extern UINT32     mFvTakenSize;
 
-extern EFI_PHYSICAL_ADDRESS mFvBaseAddress[];
+extern EFI_PHYSICAL_ADDRESS *mFvBaseAddress;
 extern UINT32               mFvBaseAddressNumber;
+extern UINT32               mFvRebaseThreadCount;
 //
 // Local function prototypes
 //
@@ -350,18 +387,173 @@ CalculateFvSize (
   FV_INFO *FvInfoPtr
   );
 
+EFI_STATUS
+GetChildFvFromFfs (
+  IN      FV_INFO               *FvInfo, 
+  IN      EFI_FFS_FILE_HEADER   *FfsFile,
+  IN      UINTN                 XipOffset
+  );
+
 EFI_STATUS
 FfsRebase ( 
   IN OUT  FV_INFO               *FvInfo, 
   IN      CHAR8                 *FileName,           
   IN OUT  EFI_FFS_FILE_HEADER   *FfsFile,
   IN      UINTN                 XipOffset,
-  IN      FILE                  *FvMapFile
+  IN      FILE                  *FvMapFile,
+  OUT     BOOLEAN               *IsArm
   );
 
 //
 // Exported function prototypes
 //
+EFI_STATUS
+AddFvFile (
+  IN OUT FV_INFO              *FvInfo,
+  IN     CHAR8                *FileName,
+  IN     UINT32               FileTakenSize
+  )
+/*++
+
+Routine Description:
+
+  Append a file to the list of files placed in the FV.
+
+Arguments:
+
+  FvInfo         The FV to add the file to.
+  FileName       The name of the FFS file.
+  FileTakenSize  The space the file takes in the FV, or 0 for its size.
+
+Returns:
+
+  EFI_SUCCESS             The file was added.
+  EFI_OUT_OF_RESOURCES    Could not allocate required resources.
+
+--*/
+;
+
+EFI_STATUS
+AddFvFileBuffer (
+  IN OUT FV_INFO              *FvInfo,
+  IN     CHAR8                *FileName,
+  IN     UINT8                *Data,
+  IN     UINTN                Size
+  )
+/*++
+
+Routine Description:
+
+  Supply the contents of an FFS file in memory. When the FV places a file
+  named FileName, it uses Data instead of reading the file.
+
+Arguments:
+
+  FvInfo         The FV to add the buffer to.
+  FileName       The name of the FFS file, as listed in the FV.
+  Data           The file contents. They must stay valid until the FV is
+                 generated and are not modified.
+  Size           The size of Data.
+
+Returns:
+
+  EFI_SUCCESS             The buffer was added.
+  EFI_OUT_OF_RESOURCES    Could not allocate required resources.
+
+--*/
+;
+
+EFI_FV_BLOCK_MAP_ENTRY *
+GetFvBlockMapEntry (
+  IN OUT FV_INFO              *FvInfo,
+  IN     UINTN                Index
+  )
+/*++
+
+Routine Description:
+
+  Get an entry of the FV block map, growing the map as needed. New entries
+  are zero, and the map always keeps a zero entry after Index.
+
+Arguments:
+
+  FvInfo         The FV owning the block map.
+  Index          The block map entry.
+
+Returns:
+
+  A pointer to the entry, or NULL if the map could not be grown.
+
+--*/
+;
+
+EFI_STATUS
+AddCapFile (
+  IN OUT CAP_INFO             *CapInfo,
+  IN     CHAR8                *FileName
+  )
+/*++
+
+Routine Description:
+
+  Append a file to the list of files placed in the capsule.
+
+Arguments:
+
+  CapInfo        The capsule to add the file to.
+  FileName       The name of the file.
+
+Returns:
+
+  EFI_SUCCESS             The file was added.
+  EFI_OUT_OF_RESOURCES    Could not allocate required resources.
+
+--*/
+;
+
+VOID
+ReleaseFvInfo (
+  IN OUT FV_INFO              *FvInfo
+  )
+/*++
+
+Routine Description:
+
+  Free the tables of an FV_INFO. The file list, file buffers and block map
+  are empty afterwards.
+
+Arguments:
+
+  FvInfo         The FV information to release.
+
+Returns:
+
+  None
+
+--*/
+;
+
+VOID
+ReleaseCapInfo (
+  IN OUT CAP_INFO             *CapInfo
+  )
+/*++
+
+Routine Description:
+
+  Free the tables of a CAP_INFO. The file list is empty afterwards.
+
+Arguments:
+
+  CapInfo        The capsule information to release.
+
+Returns:
+
+  None
+
+--*/
+;
+
 EFI_STATUS
 GenerateCapImage (
   IN CHAR8                *InfFileImage,
@@ -422,4 +614,40 @@ Returns:
 --*/
 ;
 
+EFI_STATUS
+GenerateFvImageBuffer (
+  IN  CHAR8               *InfFileImage,
+  IN  UINTN               InfFileSize,
+  IN  CHAR8               *FvFileName,
+  IN  CHAR8               *MapFileName,
+  OUT UINT8               **FvImageBuffer,
+  OUT UINTN               *FvImageBufferSize
+  )
+/*++
+
+Routine Description:
+
+  Generate an FV image like GenerateFvImage, but return it in memory
+  instead of writing FvFileName. FvFileName still names the map and report
+  files, which are written next to it. An incremental build is not done.
+
+Arguments:
+
+  InfFileImage      Buffer containing the INF file contents.
+  InfFileSize       Size of the contents of the InfFileImage buffer.
+  FvFileName        Name of the FV file, used for the map and report files.
+  MapFileName       Fv map file to log fv driver information.
+  FvImageBuffer     Receives the FV image, released with free().
+  FvImageBufferSize Receives the size of the FV image.
+
+Returns:
+
+  EFI_SUCCESS             Function completed successfully.
+  EFI_OUT_OF_RESOURCES    Could not allocate required resources.
+  EFI_ABORTED             Error encountered.
+  EFI_INVALID_PARAMETER   A required parameter was NULL.
+
+--*/
+;
+
 #endif
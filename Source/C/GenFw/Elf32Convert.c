@@ -36,40 +36,47 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "ElfConvert.h"
 #include "Elf32Convert.h"
 
+STATIC
+BOOLEAN
+ClassifySections32 (
+  ELF_CONVERT_CONTEXT  *Context
+  );
+
 STATIC
 VOID
 ScanSections32 (
-  VOID
+  ELF_CONVERT_CONTEXT  *Context
   );
 
 STATIC
 BOOLEAN
 WriteSections32 (
+  ELF_CONVERT_CONTEXT   *Context,
   SECTION_FILTER_TYPES  FilterType
   );
 
 STATIC
 VOID
 WriteRelocations32 (
-  VOID
+  ELF_CONVERT_CONTEXT  *Context
   );
 
 STATIC
 VOID
 WriteDebug32 (
-  VOID
+  ELF_CONVERT_CONTEXT  *Context
   );
 
 STATIC
 VOID
 SetImageSize32 (
-  VOID
+  ELF_CONVERT_CONTEXT  *Context
   );
 
 STATIC
 VOID
 CleanUp32 (
-  VOID
+  ELF_CONVERT_CONTEXT  *Context
   );
 
 //
@@ -85,13 +92,6 @@ typedef Elf32_Dyn Elf_Dyn;
 #define ELF_R_TYPE(r) ELF32_R_TYPE(r)
 #define ELF_R_SYM(r) ELF32_R_SYM(r)
 
-//
-// Well known ELF structures.
-//
-STATIC Elf_Ehdr *mEhdr;
-STATIC Elf_Shdr *mShdrBase;
-STATIC Elf_Phdr *mPhdrBase;
-
 //
 // Coff information
 //
@@ -102,69 +102,68 @@ STATIC const UINT32 mCoffAlignment = 0x20;
 //
 STATIC const UINT16 mCoffNbrSections = 5;
 
-//
-// ELF sections to offset in Coff file.
-//
-STATIC UINT32 *mCoffSectionsOffset = NULL;
-
-//
-// Offsets in COFF file
-//
-STATIC UINT32 mNtHdrOffset;
-STATIC UINT32 mTextOffset;
-STATIC UINT32 mDataOffset;
-STATIC UINT32 mHiiRsrcOffset;
-STATIC UINT32 mRelocOffset;
-
 //
 // Initialization Function
 //
 BOOLEAN
 InitializeElf32 (
-  UINT8               *FileBuffer,
-  ELF_FUNCTION_TABLE  *ElfFunctions
+  ELF_CONVERT_CONTEXT  *Context,
+  UINT8                *FileBuffer,
+  ELF_FUNCTION_TABLE   *ElfFunctions
   )
 {
+  Elf_Ehdr  *Ehdr;
+
   //
   // Initialize data pointer and structures.
   //
-  mEhdr = (Elf_Ehdr*) FileBuffer;  
+  Ehdr = (Elf_Ehdr*) FileBuffer;
+  Context->Ehdr = Ehdr;
 
   //
   // Check the ELF32 specific header information.
   //
-  if (mEhdr->e_ident[EI_CLASS] != ELFCLASS32) {
-    Error (NULL, 0, 3000, "Unsupported", "ELF EI_DATA not ELFCLASS32");
+  if (Ehdr->e_ident[EI_CLASS] != ELFCLASS32) {
+    ElfConvertError (Context, "Unsupported", "ELF EI_DATA not ELFCLASS32");
     return FALSE;
   }
-  if (mEhdr->e_ident[EI_DATA] != ELFDATA2LSB) {
-    Error (NULL, 0, 3000, "Unsupported", "ELF EI_DATA not ELFDATA2LSB");
+  if (Ehdr->e_ident[EI_DATA] != ELFDATA2LSB) {
+    ElfConvertError (Context, "Unsupported", "ELF EI_DATA not ELFDATA2LSB");
     return FALSE;
   }  
-  if ((mEhdr->e_type != ET_EXEC) && (mEhdr->e_type != ET_DYN)) {
-    Error (NULL, 0, 3000, "Unsupported", "ELF e_type not ET_EXEC or ET_DYN");
+  if ((Ehdr->e_type != ET_EXEC) && (Ehdr->e_type != ET_DYN)) {
+    ElfConvertError (Context, "Unsupported", "ELF e_type not ET_EXEC or ET_DYN");
     return FALSE;
   }
-  if (!((mEhdr->e_machine == EM_386) || (mEhdr->e_machine == EM_ARM))) { 
-    Error (NULL, 0, 3000, "Unsupported", "ELF e_machine not EM_386 or EM_ARM");
+  if (!((Ehdr->e_machine == EM_386) || (Ehdr->e_machine == EM_ARM))) { 
+    ElfConvertError (Context, "Unsupported", "ELF e_machine not EM_386 or EM_ARM");
     return FALSE;
   }
-  if (mEhdr->e_version != EV_CURRENT) {
-    Error (NULL, 0, 3000, "Unsupported", "ELF e_version (%u) not EV_CURRENT (%d)", (unsigned) mEhdr->e_version, EV_CURRENT);
+  if (Ehdr->e_version != EV_CURRENT) {
+    ElfConvertError (Context, "Unsupported", "ELF e_version (%u) not EV_CURRENT (%d)", (unsigned) Ehdr->e_version, EV_CURRENT);
     return FALSE;
   }
   
   //
   // Update section header pointers
   //
-  mShdrBase  = (Elf_Shdr *)((UINT8 *)mEhdr + mEhdr->e_shoff);
-  mPhdrBase = (Elf_Phdr *)((UINT8 *)mEhdr + mEhdr->e_phoff);
+  Context->ShdrBase  = (Elf_Shdr *)((UINT8 *)Ehdr + Ehdr->e_shoff);
+  Context->PhdrBase = (Elf_Phdr *)((UINT8 *)Ehdr + Ehdr->e_phoff);
   
   //
   // Create COFF Section offset buffer and zero.
   //
-  mCoffSectionsOffset = (UINT32 *)malloc(mEhdr->e_shnum * sizeof (UINT32));
-  memset(mCoffSectionsOffset, 0, mEhdr->e_shnum * sizeof(UINT32));
+  Context->CoffSectionsOffset = (UINT32 *)malloc(Ehdr->e_shnum * sizeof (UINT32));
+  memset(Context->CoffSectionsOffset, 0, Ehdr->e_shnum * sizeof(UINT32));
+
+  //
+  // Classify the sections once for all the later passes.
+  //
+  VerboseMsg ("Classify Sections");
+  if (!ClassifySections32 (Context)) {
+    CleanUp32 (Context);
+    return FALSE;
+  }
 
   //
   // Fill in function pointers.
@@ -186,25 +185,33 @@ InitializeElf32 (
 STATIC
 Elf_Shdr*
 GetShdrByIndex (
-  UINT32 Num
+  ELF_CONVERT_CONTEXT  *Context,
+  UINT32               Num
   )
 {
-  if (Num >= mEhdr->e_shnum)
+  Elf_Ehdr  *Ehdr;
+
+  Ehdr = Context->Ehdr;
+  if (Num >= Ehdr->e_shnum)
     return NULL;
-  return (Elf_Shdr*)((UINT8*)mShdrBase + Num * mEhdr->e_shentsize);
+  return (Elf_Shdr*)((UINT8*)Context->ShdrBase + Num * Ehdr->e_shentsize);
 }
 
 STATIC
 Elf_Phdr*
 GetPhdrByIndex (
-  UINT32 num
+  ELF_CONVERT_CONTEXT  *Context,
+  UINT32               num
   )
 {
-  if (num >= mEhdr->e_phnum) {
+  Elf_Ehdr  *Ehdr;
+
+  Ehdr = Context->Ehdr;
+  if (num >= Ehdr->e_phnum) {
     return NULL;
   }
 
-  return (Elf_Phdr *)((UINT8*)mPhdrBase + num * mEhdr->e_phentsize);
+  return (Elf_Phdr *)((UINT8*)Context->PhdrBase + num * Ehdr->e_phentsize);
 }
 
 STATIC
@@ -222,7 +229,8 @@ CoffAlign (
 STATIC
 BOOLEAN
 IsTextShdr (
-  Elf_Shdr *Shdr
+  ELF_CONVERT_CONTEXT  *Context,
+  Elf_Shdr             *Shdr
   )
 {
   return (BOOLEAN) ((Shdr->sh_flags & (SHF_WRITE | SHF_ALLOC)) == SHF_ALLOC);
@@ -231,26 +239,103 @@ IsTextShdr (
 STATIC
 BOOLEAN
 IsHiiRsrcShdr (
-  Elf_Shdr *Shdr
+  ELF_CONVERT_CONTEXT  *Context,
+  Elf_Shdr             *Shdr
   )
 {
-  Elf_Shdr *Namedr = GetShdrByIndex(mEhdr->e_shstrndx);
+  Elf_Ehdr *Ehdr = Context->Ehdr;
+  Elf_Shdr *Namedr = GetShdrByIndex(Context, Ehdr->e_shstrndx);
 
-  return (BOOLEAN) (strcmp((CHAR8*)mEhdr + Namedr->sh_offset + Shdr->sh_name, ELF_HII_SECTION_NAME) == 0);
+  return (BOOLEAN) (strcmp((CHAR8*)Ehdr + Namedr->sh_offset + Shdr->sh_name, ELF_HII_SECTION_NAME) == 0);
 }
 
 STATIC
 BOOLEAN
 IsDataShdr (
-  Elf_Shdr *Shdr
+  ELF_CONVERT_CONTEXT  *Context,
+  Elf_Shdr             *Shdr
   )
 {
-  if (IsHiiRsrcShdr(Shdr)) {
+  if (IsHiiRsrcShdr(Context, Shdr)) {
     return FALSE;
   }
   return (BOOLEAN) (Shdr->sh_flags & (SHF_WRITE | SHF_ALLOC)) == (SHF_ALLOC | SHF_WRITE);
 }
 
+//
+// Sort the sections into the filter and relocation section lists, so the
+// later passes do not have to walk and name-compare every section header.
+//
+STATIC
+BOOLEAN
+ClassifySections32 (
+  ELF_CONVERT_CONTEXT  *Context
+  )
+{
+  Elf_Ehdr  *Ehdr;
+  Elf_Shdr  *Shdr;
+  UINT32    Index;
+  UINT32    FilterType;
+  UINT8     FilterMask;
+
+  Ehdr = Context->Ehdr;
+  if (Ehdr->e_shnum == 0) {
+    ElfConvertError (Context, "Invalid", "%s has no section headers.", Context->InImageName);
+    return FALSE;
+  }
+
+  Context->SectionFilter = (UINT8 *) calloc (Ehdr->e_shnum, sizeof (UINT8));
+  Context->SectionAdjust = (UINT64 *) calloc (Ehdr->e_shnum, sizeof (UINT64));
+  Context->RelocSections = (UINT32 *) malloc (Ehdr->e_shnum * sizeof (UINT32));
+  if (Context->SectionFilter == NULL || Context->SectionAdjust == NULL || Context->RelocSections == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    Context->Status = STATUS_ERROR;
+    return FALSE;
+  }
+  for (FilterType = 0; FilterType < SECTION_FILTER_COUNT; FilterType++) {
+    Context->FilterSections[FilterType] = (UINT32 *) malloc (Ehdr->e_shnum * sizeof (UINT32));
+    if (Context->FilterSections[FilterType] == NULL) {
+      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+      Context->Status = STATUS_ERROR;
+      return FALSE;
+    }
+  }
+
+  for (Index = 0; Index < Ehdr->e_shnum; Index++) {
+    Shdr = GetShdrByIndex(Context, Index);
+
+    //
+    // A section may match several filters, the .hii section is usually
+    // both text and HII.
+    //
+    FilterMask = 0;
+    if (IsTextShdr(Context, Shdr)) {
+      FilterMask |= 1 << SECTION_TEXT;
+    }
+    if (IsHiiRsrcShdr(Context, Shdr)) {
+      FilterMask |= 1 << SECTION_HII;
+    } else if (IsDataShdr(Context, Shdr)) {
+      FilterMask |= 1 << SECTION_DATA;
+    }
+    Context->SectionFilter[Index] = FilterMask;
+    for (FilterType = 0; FilterType < SECTION_FILTER_COUNT; FilterType++) {
+      if ((FilterMask & (1 << FilterType)) != 0) {
+        Context->FilterSections[FilterType][Context->FilterSectionCount[FilterType]++] = Index;
+      }
+    }
+
+    if ((Shdr->sh_type == SHT_REL) || (Shdr->sh_type == SHT_RELA)) {
+      if (Shdr->sh_info >= Ehdr->e_shnum) {
+        ElfConvertError (Context, "Invalid", "%s relocation section %u applies to invalid section %u.", Context->InImageName, (unsigned) Index, (unsigned) Shdr->sh_info);
+        return FALSE;
+      }
+      Context->RelocSections[Context->RelocSectionCount++] = Index;
+    }
+  }
+
+  return TRUE;
+}
+
 //
 // Elf functions interface implementation
 //
@@ -258,177 +343,187 @@ IsDataShdr (
 STATIC
 VOID
 ScanSections32 (
-  VOID
+  ELF_CONVERT_CONTEXT  *Context
   )
 {
   UINT32                          i;
+  UINT32                          Index;
+  Elf_Shdr                        *shdr;
   EFI_IMAGE_DOS_HEADER            *DosHdr;
   EFI_IMAGE_OPTIONAL_HEADER_UNION *NtHdr;
   UINT32                          CoffEntry;
   UINT32                          SectionCount;
   BOOLEAN                         FoundText;
+  Elf_Ehdr                        *Ehdr;
+
+  Ehdr = Context->Ehdr;
 
   CoffEntry = 0;
-  mCoffOffset = 0;
-  mTextOffset = 0;
+  Context->CoffOffset = 0;
+  Context->TextOffset = 0;
   FoundText = FALSE;
 
   //
   // Coff file start with a DOS header.
   //
-  mCoffOffset = sizeof(EFI_IMAGE_DOS_HEADER) + 0x40;
-  mNtHdrOffset = mCoffOffset;
-  switch (mEhdr->e_machine) {
+  Context->CoffOffset = sizeof(EFI_IMAGE_DOS_HEADER) + 0x40;
+  Context->NtHdrOffset = Context->CoffOffset;
+  switch (Ehdr->e_machine) {
   case EM_386:
   case EM_ARM:
-    mCoffOffset += sizeof (EFI_IMAGE_NT_HEADERS32);
+    Context->CoffOffset += sizeof (EFI_IMAGE_NT_HEADERS32);
   break;
   default:
-    VerboseMsg ("%s unknown e_machine type. Assume IA-32", (UINTN)mEhdr->e_machine);
-    mCoffOffset += sizeof (EFI_IMAGE_NT_HEADERS32);
+    VerboseMsg ("%s unknown e_machine type. Assume IA-32", (UINTN)Ehdr->e_machine);
+    Context->CoffOffset += sizeof (EFI_IMAGE_NT_HEADERS32);
   break;
   }
 
-  mTableOffset = mCoffOffset;
-  mCoffOffset += mCoffNbrSections * sizeof(EFI_IMAGE_SECTION_HEADER);
+  Context->TableOffset = Context->CoffOffset;
+  Context->CoffOffset += mCoffNbrSections * sizeof(EFI_IMAGE_SECTION_HEADER);
 
   //
   // First text sections.
   //
-  mCoffOffset = CoffAlign(mCoffOffset);
+  Context->CoffOffset = CoffAlign(Context->CoffOffset);
   SectionCount = 0;
-  for (i = 0; i < mEhdr->e_shnum; i++) {
-    Elf_Shdr *shdr = GetShdrByIndex(i);
-    if (IsTextShdr(shdr)) {
-      if ((shdr->sh_addralign != 0) && (shdr->sh_addralign != 1)) {
-        // the alignment field is valid
-        if ((shdr->sh_addr & (shdr->sh_addralign - 1)) == 0) {
-          // if the section address is aligned we must align PE/COFF
-          mCoffOffset = (mCoffOffset + shdr->sh_addralign - 1) & ~(shdr->sh_addralign - 1);
-        } else if ((shdr->sh_addr % shdr->sh_addralign) != (mCoffOffset % shdr->sh_addralign)) {
-          // ARM RVCT tools have behavior outside of the ELF specification to try
-          // and make images smaller.  If sh_addr is not aligned to sh_addralign
-          // then the section needs to preserve sh_addr MOD sh_addralign.
-          // Normally doing nothing here works great.
-          Error (NULL, 0, 3000, "Invalid", "Unsupported section alignment.");
-        }
-      }
-
-      /* Relocate entry.  */
-      if ((mEhdr->e_entry >= shdr->sh_addr) &&
-          (mEhdr->e_entry < shdr->sh_addr + shdr->sh_size)) {
-        CoffEntry = mCoffOffset + mEhdr->e_entry - shdr->sh_addr;
+  for (Index = 0; Index < Context->FilterSectionCount[SECTION_TEXT]; Index++) {
+    i = Context->FilterSections[SECTION_TEXT][Index];
+    shdr = GetShdrByIndex(Context, i);
+    if ((shdr->sh_addralign != 0) && (shdr->sh_addralign != 1)) {
+      // the alignment field is valid
+      if ((shdr->sh_addr & (shdr->sh_addralign - 1)) == 0) {
+        // if the section address is aligned we must align PE/COFF
+        Context->CoffOffset = (Context->CoffOffset + shdr->sh_addralign - 1) & ~(shdr->sh_addralign - 1);
+      } else if ((shdr->sh_addr % shdr->sh_addralign) != (Context->CoffOffset % shdr->sh_addralign)) {
+        // ARM RVCT tools have behavior outside of the ELF specification to try
+        // and make images smaller.  If sh_addr is not aligned to sh_addralign
+        // then the section needs to preserve sh_addr MOD sh_addralign.
+        // Normally doing nothing here works great.
+        ElfConvertError (Context, "Invalid", "Unsupported section alignment.");
       }
+    }
 
-      //
-      // Set mTextOffset with the offset of the first '.text' section
-      //
-      if (!FoundText) {
-        mTextOffset = mCoffOffset;
-        FoundText = TRUE;
-      }
+    /* Relocate entry.  */
+    if ((Ehdr->e_entry >= shdr->sh_addr) &&
+        (Ehdr->e_entry < shdr->sh_addr + shdr->sh_size)) {
+      CoffEntry = Context->CoffOffset + Ehdr->e_entry - shdr->sh_addr;
+    }
 
-      mCoffSectionsOffset[i] = mCoffOffset;
-      mCoffOffset += shdr->sh_size;
-      SectionCount ++;
+    //
+    // Set TextOffset with the offset of the first '.text' section
+    //
+    if (!FoundText) {
+      Context->TextOffset = Context->CoffOffset;
+      FoundText = TRUE;
     }
+
+    Context->CoffSectionsOffset[i] = Context->CoffOffset;
+    Context->CoffOffset += shdr->sh_size;
+    SectionCount ++;
   }
 
   if (!FoundText) {
-    Error (NULL, 0, 3000, "Invalid", "Did not find any '.text' section.");
+    ElfConvertError (Context, "Invalid", "Did not find any '.text' section.");
     assert (FALSE);
   }
 
-  if (mEhdr->e_machine != EM_ARM) {
-    mCoffOffset = CoffAlign(mCoffOffset);
+  if (Ehdr->e_machine != EM_ARM) {
+    Context->CoffOffset = CoffAlign(Context->CoffOffset);
   }
 
-  if (SectionCount > 1 && mOutImageType == FW_EFI_IMAGE) {
-    Warning (NULL, 0, 0, NULL, "Mulitple sections in %s are merged into 1 text section. Source level debug might not work correctly.", mInImageName);
+  if (SectionCount > 1 && Context->OutImageType == FW_EFI_IMAGE) {
+    Warning (NULL, 0, 0, NULL, "Mulitple sections in %s are merged into 1 text section. Source level debug might not work correctly.", Context->InImageName);
   }
 
   //
   //  Then data sections.
   //
-  mDataOffset = mCoffOffset;
+  Context->DataOffset = Context->CoffOffset;
   SectionCount = 0;
-  for (i = 0; i < mEhdr->e_shnum; i++) {
-    Elf_Shdr *shdr = GetShdrByIndex(i);
-    if (IsDataShdr(shdr)) {
-      if ((shdr->sh_addralign != 0) && (shdr->sh_addralign != 1)) {
-        // the alignment field is valid
-        if ((shdr->sh_addr & (shdr->sh_addralign - 1)) == 0) {
-          // if the section address is aligned we must align PE/COFF
-          mCoffOffset = (mCoffOffset + shdr->sh_addralign - 1) & ~(shdr->sh_addralign - 1);
-        } else if ((shdr->sh_addr % shdr->sh_addralign) != (mCoffOffset % shdr->sh_addralign)) {
-          // ARM RVCT tools have behavior outside of the ELF specification to try
-          // and make images smaller.  If sh_addr is not aligned to sh_addralign
-          // then the section needs to preserve sh_addr MOD sh_addralign.
-          // Normally doing nothing here works great.
-          Error (NULL, 0, 3000, "Invalid", "Unsupported section alignment.");
-        }
+  for (Index = 0; Index < Context->FilterSectionCount[SECTION_DATA]; Index++) {
+    i = Context->FilterSections[SECTION_DATA][Index];
+    shdr = GetShdrByIndex(Context, i);
+    if ((shdr->sh_addralign != 0) && (shdr->sh_addralign != 1)) {
+      // the alignment field is valid
+      if ((shdr->sh_addr & (shdr->sh_addralign - 1)) == 0) {
+        // if the section address is aligned we must align PE/COFF
+        Context->CoffOffset = (Context->CoffOffset + shdr->sh_addralign - 1) & ~(shdr->sh_addralign - 1);
+      } else if ((shdr->sh_addr % shdr->sh_addralign) != (Context->CoffOffset % shdr->sh_addralign)) {
+        // ARM RVCT tools have behavior outside of the ELF specification to try
+        // and make images smaller.  If sh_addr is not aligned to sh_addralign
+        // then the section needs to preserve sh_addr MOD sh_addralign.
+        // Normally doing nothing here works great.
+        ElfConvertError (Context, "Invalid", "Unsupported section alignment.");
       }
-      mCoffSectionsOffset[i] = mCoffOffset;
-      mCoffOffset += shdr->sh_size;
-      SectionCount ++;
     }
+    Context->CoffSectionsOffset[i] = Context->CoffOffset;
+    Context->CoffOffset += shdr->sh_size;
+    SectionCount ++;
   }
-  mCoffOffset = CoffAlign(mCoffOffset);
+  Context->CoffOffset = CoffAlign(Context->CoffOffset);
 
-  if (SectionCount > 1 && mOutImageType == FW_EFI_IMAGE) {
-    Warning (NULL, 0, 0, NULL, "Mulitple sections in %s are merged into 1 data section. Source level debug might not work correctly.", mInImageName);
+  if (SectionCount > 1 && Context->OutImageType == FW_EFI_IMAGE) {
+    Warning (NULL, 0, 0, NULL, "Mulitple sections in %s are merged into 1 data section. Source level debug might not work correctly.", Context->InImageName);
   }
 
   //
   //  The HII resource sections.
   //
-  mHiiRsrcOffset = mCoffOffset;
-  for (i = 0; i < mEhdr->e_shnum; i++) {
-    Elf_Shdr *shdr = GetShdrByIndex(i);
-    if (IsHiiRsrcShdr(shdr)) {
-      if ((shdr->sh_addralign != 0) && (shdr->sh_addralign != 1)) {
-        // the alignment field is valid
-        if ((shdr->sh_addr & (shdr->sh_addralign - 1)) == 0) {
-          // if the section address is aligned we must align PE/COFF
-          mCoffOffset = (mCoffOffset + shdr->sh_addralign - 1) & ~(shdr->sh_addralign - 1);
-        } else if ((shdr->sh_addr % shdr->sh_addralign) != (mCoffOffset % shdr->sh_addralign)) {
-          // ARM RVCT tools have behavior outside of the ELF specification to try
-          // and make images smaller.  If sh_addr is not aligned to sh_addralign
-          // then the section needs to preserve sh_addr MOD sh_addralign.
-          // Normally doing nothing here works great.
-          Error (NULL, 0, 3000, "Invalid", "Unsupported section alignment.");
-        }
-      }
-      if (shdr->sh_size != 0) {
-        mCoffSectionsOffset[i] = mCoffOffset;
-        mCoffOffset += shdr->sh_size;
-        mCoffOffset = CoffAlign(mCoffOffset);
-        SetHiiResourceHeader ((UINT8*) mEhdr + shdr->sh_offset, mHiiRsrcOffset);
+  Context->HiiRsrcOffset = Context->CoffOffset;
+  if (Context->FilterSectionCount[SECTION_HII] != 0) {
+    i = Context->FilterSections[SECTION_HII][0];
+    shdr = GetShdrByIndex(Context, i);
+    if ((shdr->sh_addralign != 0) && (shdr->sh_addralign != 1)) {
+      // the alignment field is valid
+      if ((shdr->sh_addr & (shdr->sh_addralign - 1)) == 0) {
+        // if the section address is aligned we must align PE/COFF
+        Context->CoffOffset = (Context->CoffOffset + shdr->sh_addralign - 1) & ~(shdr->sh_addralign - 1);
+      } else if ((shdr->sh_addr % shdr->sh_addralign) != (Context->CoffOffset % shdr->sh_addralign)) {
+        // ARM RVCT tools have behavior outside of the ELF specification to try
+        // and make images smaller.  If sh_addr is not aligned to sh_addralign
+        // then the section needs to preserve sh_addr MOD sh_addralign.
+        // Normally doing nothing here works great.
+        ElfConvertError (Context, "Invalid", "Unsupported section alignment.");
       }
-      break;
+    }
+    if (shdr->sh_size != 0) {
+      Context->CoffSectionsOffset[i] = Context->CoffOffset;
+      Context->CoffOffset += shdr->sh_size;
+      Context->CoffOffset = CoffAlign(Context->CoffOffset);
+      SetHiiResourceHeader ((UINT8*) Ehdr + shdr->sh_offset, Context->HiiRsrcOffset);
     }
   }
 
-  mRelocOffset = mCoffOffset;
+  Context->RelocOffset = Context->CoffOffset;
+
+  //
+  // Cache the ELF address to Coff offset adjustment of every section for
+  // the symbol lookups done while relocating.
+  //
+  for (i = 0; i < Ehdr->e_shnum; i++) {
+    shdr = GetShdrByIndex(Context, i);
+    Context->SectionAdjust[i] = Context->CoffSectionsOffset[i] - shdr->sh_addr;
+  }
 
   //
   // Allocate base Coff file.  Will be expanded later for relocations.
   //
-  mCoffFile = (UINT8 *)malloc(mCoffOffset);
-  memset(mCoffFile, 0, mCoffOffset);
+  Context->CoffFile = (UINT8 *)malloc(Context->CoffOffset);
+  memset(Context->CoffFile, 0, Context->CoffOffset);
 
   //
   // Fill headers.
   //
-  DosHdr = (EFI_IMAGE_DOS_HEADER *)mCoffFile;
+  DosHdr = (EFI_IMAGE_DOS_HEADER *)Context->CoffFile;
   DosHdr->e_magic = EFI_IMAGE_DOS_SIGNATURE;
-  DosHdr->e_lfanew = mNtHdrOffset;
+  DosHdr->e_lfanew = Context->NtHdrOffset;
 
-  NtHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION*)(mCoffFile + mNtHdrOffset);
+  NtHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION*)(Context->CoffFile + Context->NtHdrOffset);
 
   NtHdr->Pe32.Signature = EFI_IMAGE_NT_SIGNATURE;
 
-  switch (mEhdr->e_machine) {
+  switch (Ehdr->e_machine) {
   case EM_386:
     NtHdr->Pe32.FileHeader.Machine = EFI_IMAGE_MACHINE_IA32;
     NtHdr->Pe32.OptionalHeader.Magic = EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC;
@@ -438,14 +533,14 @@ ScanSections32 (
     NtHdr->Pe32.OptionalHeader.Magic = EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC;
     break;
   default:
-    VerboseMsg ("%s unknown e_machine type. Assume IA-32", (UINTN)mEhdr->e_machine);
+    VerboseMsg ("%s unknown e_machine type. Assume IA-32", (UINTN)Ehdr->e_machine);
     NtHdr->Pe32.FileHeader.Machine = EFI_IMAGE_MACHINE_IA32;
     NtHdr->Pe32.OptionalHeader.Magic = EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC;
   }
 
   NtHdr->Pe32.FileHeader.NumberOfSections = mCoffNbrSections;
   NtHdr->Pe32.FileHeader.TimeDateStamp = (UINT32) time(NULL);
-  mImageTimeStamp = NtHdr->Pe32.FileHeader.TimeDateStamp;
+  Context->ImageTimeStamp = NtHdr->Pe32.FileHeader.TimeDateStamp;
   NtHdr->Pe32.FileHeader.PointerToSymbolTable = 0;
   NtHdr->Pe32.FileHeader.NumberOfSymbols = 0;
   NtHdr->Pe32.FileHeader.SizeOfOptionalHeader = sizeof(NtHdr->Pe32.OptionalHeader);
@@ -454,27 +549,27 @@ ScanSections32 (
     | EFI_IMAGE_FILE_LOCAL_SYMS_STRIPPED
     | EFI_IMAGE_FILE_32BIT_MACHINE;
 
-  NtHdr->Pe32.OptionalHeader.SizeOfCode = mDataOffset - mTextOffset;
-  NtHdr->Pe32.OptionalHeader.SizeOfInitializedData = mRelocOffset - mDataOffset;
+  NtHdr->Pe32.OptionalHeader.SizeOfCode = Context->DataOffset - Context->TextOffset;
+  NtHdr->Pe32.OptionalHeader.SizeOfInitializedData = Context->RelocOffset - Context->DataOffset;
   NtHdr->Pe32.OptionalHeader.SizeOfUninitializedData = 0;
   NtHdr->Pe32.OptionalHeader.AddressOfEntryPoint = CoffEntry;
 
-  NtHdr->Pe32.OptionalHeader.BaseOfCode = mTextOffset;
+  NtHdr->Pe32.OptionalHeader.BaseOfCode = Context->TextOffset;
 
-  NtHdr->Pe32.OptionalHeader.BaseOfData = mDataOffset;
+  NtHdr->Pe32.OptionalHeader.BaseOfData = Context->DataOffset;
   NtHdr->Pe32.OptionalHeader.ImageBase = 0;
   NtHdr->Pe32.OptionalHeader.SectionAlignment = mCoffAlignment;
   NtHdr->Pe32.OptionalHeader.FileAlignment = mCoffAlignment;
   NtHdr->Pe32.OptionalHeader.SizeOfImage = 0;
 
-  NtHdr->Pe32.OptionalHeader.SizeOfHeaders = mTextOffset;
+  NtHdr->Pe32.OptionalHeader.SizeOfHeaders = Context->TextOffset;
   NtHdr->Pe32.OptionalHeader.NumberOfRvaAndSizes = EFI_IMAGE_NUMBER_OF_DIRECTORY_ENTRIES;
 
   //
   // Section headers.
   //
-  if ((mDataOffset - mTextOffset) > 0) {
-    CreateSectionHeader (".text", mTextOffset, mDataOffset - mTextOffset,
+  if ((Context->DataOffset - Context->TextOffset) > 0) {
+    CreateSectionHeader (Context, ".text", Context->TextOffset, Context->DataOffset - Context->TextOffset,
             EFI_IMAGE_SCN_CNT_CODE
             | EFI_IMAGE_SCN_MEM_EXECUTE
             | EFI_IMAGE_SCN_MEM_READ);
@@ -483,8 +578,8 @@ ScanSections32 (
     NtHdr->Pe32.FileHeader.NumberOfSections--;
   }
 
-  if ((mHiiRsrcOffset - mDataOffset) > 0) {
-    CreateSectionHeader (".data", mDataOffset, mHiiRsrcOffset - mDataOffset,
+  if ((Context->HiiRsrcOffset - Context->DataOffset) > 0) {
+    CreateSectionHeader (Context, ".data", Context->DataOffset, Context->HiiRsrcOffset - Context->DataOffset,
             EFI_IMAGE_SCN_CNT_INITIALIZED_DATA
             | EFI_IMAGE_SCN_MEM_WRITE
             | EFI_IMAGE_SCN_MEM_READ);
@@ -493,13 +588,13 @@ ScanSections32 (
     NtHdr->Pe32.FileHeader.NumberOfSections--;
   }
 
-  if ((mRelocOffset - mHiiRsrcOffset) > 0) {
-    CreateSectionHeader (".rsrc", mHiiRsrcOffset, mRelocOffset - mHiiRsrcOffset,
+  if ((Context->RelocOffset - Context->HiiRsrcOffset) > 0) {
+    CreateSectionHeader (Context, ".rsrc", Context->HiiRsrcOffset, Context->RelocOffset - Context->HiiRsrcOffset,
             EFI_IMAGE_SCN_CNT_INITIALIZED_DATA
             | EFI_IMAGE_SCN_MEM_READ);
 
-    NtHdr->Pe32.OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_RESOURCE].Size = mRelocOffset - mHiiRsrcOffset;
-    NtHdr->Pe32.OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_RESOURCE].VirtualAddress = mHiiRsrcOffset;
+    NtHdr->Pe32.OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_RESOURCE].Size = Context->RelocOffset - Context->HiiRsrcOffset;
+    NtHdr->Pe32.OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_RESOURCE].VirtualAddress = Context->HiiRsrcOffset;
   } else {
     // Don't make a section of size 0.
     NtHdr->Pe32.FileHeader.NumberOfSections--;
@@ -510,89 +605,74 @@ ScanSections32 (
 STATIC
 BOOLEAN
 WriteSections32 (
+  ELF_CONVERT_CONTEXT   *Context,
   SECTION_FILTER_TYPES  FilterType
   )
 {
   UINT32      Idx;
   Elf_Shdr    *SecShdr;
   UINT32      SecOffset;
-  BOOLEAN     (*Filter)(Elf_Shdr *);
+  UINT32      SecIndex;
+  Elf_Shdr    *Shdr;
+  Elf_Ehdr    *Ehdr;
 
-  //
-  // Initialize filter pointer
-  //
-  switch (FilterType) {
-    case SECTION_TEXT:
-      Filter = IsTextShdr;
-      break;
-    case SECTION_HII:
-      Filter = IsHiiRsrcShdr;
-      break;
-    case SECTION_DATA:
-      Filter = IsDataShdr;
-      break;
-    default:
-      return FALSE;
+  Ehdr = Context->Ehdr;
+
+  if (FilterType >= SECTION_FILTER_COUNT) {
+    return FALSE;
   }
 
   //
   // First: copy sections.
   //
-  for (Idx = 0; Idx < mEhdr->e_shnum; Idx++) {
-    Elf_Shdr *Shdr = GetShdrByIndex(Idx);
-    if ((*Filter)(Shdr)) {
-      switch (Shdr->sh_type) {
-      case SHT_PROGBITS:
-        /* Copy.  */
-        memcpy(mCoffFile + mCoffSectionsOffset[Idx],
-              (UINT8*)mEhdr + Shdr->sh_offset,
-              Shdr->sh_size);
-        break;
+  for (Idx = 0; Idx < Context->FilterSectionCount[FilterType]; Idx++) {
+    SecIndex = Context->FilterSections[FilterType][Idx];
+    Shdr = GetShdrByIndex(Context, SecIndex);
+    switch (Shdr->sh_type) {
+    case SHT_PROGBITS:
+      /* Copy.  */
+      memcpy(Context->CoffFile + Context->CoffSectionsOffset[SecIndex],
+            (UINT8*)Ehdr + Shdr->sh_offset,
+            Shdr->sh_size);
+      break;
 
-      case SHT_NOBITS:
-        memset(mCoffFile + mCoffSectionsOffset[Idx], 0, Shdr->sh_size);
-        break;
+    case SHT_NOBITS:
+      memset(Context->CoffFile + Context->CoffSectionsOffset[SecIndex], 0, Shdr->sh_size);
+      break;
 
-      default:
-        //
-        //  Ignore for unkown section type.
-        //
-        VerboseMsg ("%s unknown section type %x. We directly copy this section into Coff file", mInImageName, (unsigned)Shdr->sh_type);
-        break;
-      }
+    default:
+      //
+      //  Ignore for unkown section type.
+      //
+      VerboseMsg ("%s unknown section type %x. We directly copy this section into Coff file", Context->InImageName, (unsigned)Shdr->sh_type);
+      break;
     }
   }
 
   //
   // Second: apply relocations.
   //
-  for (Idx = 0; Idx < mEhdr->e_shnum; Idx++) {
-    //
-    // Determine if this is a relocation section.
-    //
-    Elf_Shdr *RelShdr = GetShdrByIndex(Idx);
-    if ((RelShdr->sh_type != SHT_REL) && (RelShdr->sh_type != SHT_RELA)) {
-      continue;
-    }
-    
+  for (Idx = 0; Idx < Context->RelocSectionCount; Idx++) {
+    Elf_Shdr *RelShdr = GetShdrByIndex(Context, Context->RelocSections[Idx]);
+
     //
     // Relocation section found.  Now extract section information that the relocations
     // apply to in the ELF data and the new COFF data.
     //
-    SecShdr = GetShdrByIndex(RelShdr->sh_info);
-    SecOffset = mCoffSectionsOffset[RelShdr->sh_info];
+    SecShdr = GetShdrByIndex(Context, RelShdr->sh_info);
+    SecOffset = Context->CoffSectionsOffset[RelShdr->sh_info];
     
     //
     // Only process relocations for the current filter type.
     //
-    if (RelShdr->sh_type == SHT_REL && (*Filter)(SecShdr)) {
+    if (RelShdr->sh_type == SHT_REL && (Context->SectionFilter[RelShdr->sh_info] & (1 << FilterType)) != 0) {
       UINT32 RelOffset;
       
       //
       // Determine the symbol table referenced by the relocation data.
       //
-      Elf_Shdr *SymtabShdr = GetShdrByIndex(RelShdr->sh_link);
-      UINT8 *Symtab = (UINT8*)mEhdr + SymtabShdr->sh_offset;
+      Elf_Shdr *SymtabShdr = GetShdrByIndex(Context, RelShdr->sh_link);
+      UINT8 *Symtab = (UINT8*)Ehdr + SymtabShdr->sh_offset;
 
       //
       // Process all relocation entries for this section.
@@ -601,27 +681,26 @@ WriteSections32 (
         //
         // Set pointer to relocation entry
         //
-        Elf_Rel *Rel = (Elf_Rel *)((UINT8*)mEhdr + RelShdr->sh_offset + RelOffset);
+        Elf_Rel *Rel = (Elf_Rel *)((UINT8*)Ehdr + RelShdr->sh_offset + RelOffset);
         
         //
         // Set pointer to symbol table entry associated with the relocation entry.
         //
         Elf_Sym *Sym = (Elf_Sym *)(Symtab + ELF_R_SYM(Rel->r_info) * SymtabShdr->sh_entsize);
         
-        Elf_Shdr *SymShdr;
         UINT8 *Targ;
         UINT16 Address;
 
         //
-        // Check section header index found in symbol table and get the section 
-        // header location.
+        // Check section header index found in symbol table, its address
+        // adjustment is looked up in SectionAdjust.
         //
         if (Sym->st_shndx == SHN_UNDEF
             || Sym->st_shndx == SHN_ABS
-            || Sym->st_shndx > mEhdr->e_shnum) {
-          Error (NULL, 0, 3000, "Invalid", "%s bad symbol definition.", mInImageName);
+            || Sym->st_shndx >= Ehdr->e_shnum) {
+          ElfConvertError (Context, "Invalid", "%s bad symbol definition.", Context->InImageName);
+          continue;
         }
-        SymShdr = GetShdrByIndex(Sym->st_shndx);
 
         //
         // Convert the relocation data to a pointer into the coff file.
@@ -630,12 +709,12 @@ WriteSections32 (
         //   r_offset is the virtual address of the storage unit to be relocated.
         //   sh_addr is the virtual address for the base of the section.
         //
-        Targ = mCoffFile + SecOffset + (Rel->r_offset - SecShdr->sh_addr);
+        Targ = Context->CoffFile + SecOffset + (Rel->r_offset - SecShdr->sh_addr);
 
         //
         // Determine how to handle each relocation type based on the machine type.
         //
-        if (mEhdr->e_machine == EM_386) {
+        if (Ehdr->e_machine == EM_386) {
           switch (ELF_R_TYPE(Rel->r_info)) {
           case R_386_NONE:
             break;
@@ -645,21 +724,20 @@ WriteSections32 (
             //  Converts Targ from a absolute virtual address to the absolute
             //  COFF address.
             //
-            *(UINT32 *)Targ = *(UINT32 *)Targ - SymShdr->sh_addr
-              + mCoffSectionsOffset[Sym->st_shndx];
+            *(UINT32 *)Targ = (UINT32) (*(UINT32 *)Targ + Context->SectionAdjust[Sym->st_shndx]);
             break;
           case R_386_PC32:
             //
             // Relative relocation: Symbol - Ip + Addend
             //
-            *(UINT32 *)Targ = *(UINT32 *)Targ
-              + (mCoffSectionsOffset[Sym->st_shndx] - SymShdr->sh_addr)
-              - (SecOffset - SecShdr->sh_addr);
+            *(UINT32 *)Targ = (UINT32) (*(UINT32 *)Targ
+              + Context->SectionAdjust[Sym->st_shndx]
+              - Context->SectionAdjust[RelShdr->sh_info]);
             break;
           default:
-            Error (NULL, 0, 3000, "Invalid", "%s unsupported ELF EM_386 relocation 0x%x.", mInImageName, (unsigned) ELF_R_TYPE(Rel->r_info));
+            ElfConvertError (Context, "Invalid", "%s unsupported ELF EM_386 relocation 0x%x.", Context->InImageName, (unsigned) ELF_R_TYPE(Rel->r_info));
           }
-        } else if (mEhdr->e_machine == EM_ARM) {
+        } else if (Ehdr->e_machine == EM_ARM) {
           switch (ELF32_R_TYPE(Rel->r_info)) {
           case R_ARM_RBASE:
             // No relocation - no action required
@@ -706,13 +784,13 @@ WriteSections32 (
 
           case R_ARM_THM_MOVW_ABS_NC:
             // MOVW is only lower 16-bits of the addres
-            Address = (UINT16)(Sym->st_value - SymShdr->sh_addr + mCoffSectionsOffset[Sym->st_shndx]);
+            Address = (UINT16)(Sym->st_value + Context->SectionAdjust[Sym->st_shndx]);
             ThumbMovtImmediatePatch ((UINT16 *)Targ, Address);
             break;
 
           case R_ARM_THM_MOVT_ABS:
             // MOVT is only upper 16-bits of the addres
-            Address = (UINT16)((Sym->st_value - SymShdr->sh_addr + mCoffSectionsOffset[Sym->st_shndx]) >> 16);
+            Address = (UINT16)((Sym->st_value + Context->SectionAdjust[Sym->st_shndx]) >> 16);
             ThumbMovtImmediatePatch ((UINT16 *)Targ, Address);
             break;
 
@@ -721,11 +799,11 @@ WriteSections32 (
             //
             // Absolute relocation.
             //
-            *(UINT32 *)Targ = *(UINT32 *)Targ - SymShdr->sh_addr + mCoffSectionsOffset[Sym->st_shndx];
+            *(UINT32 *)Targ = (UINT32) (*(UINT32 *)Targ + Context->SectionAdjust[Sym->st_shndx]);
             break;
 
           default:
-            Error (NULL, 0, 3000, "Invalid", "WriteSections (): %s unsupported ELF EM_ARM relocation 0x%x.", mInImageName, (unsigned) ELF32_R_TYPE(Rel->r_info));
+            ElfConvertError (Context, "Invalid", "WriteSections (): %s unsupported ELF EM_ARM relocation 0x%x.", Context->InImageName, (unsigned) ELF32_R_TYPE(Rel->r_info));
           }
         }
       }
@@ -735,12 +813,10 @@ WriteSections32 (
   return TRUE;
 }
 
-UINTN gMovwOffset = 0;
-
 STATIC
 VOID
 WriteRelocations32 (
-  VOID
+  ELF_CONVERT_CONTEXT  *Context
   )
 {
   UINT32                           Index;
@@ -756,131 +832,136 @@ WriteRelocations32 (
   UINT8                            *Targ;
   Elf32_Phdr                       *DynamicSegment;
   Elf32_Phdr                       *TargetSegment;
+  Elf_Ehdr                         *Ehdr;
+  UINTN                            MovwOffset;
 
-  for (Index = 0, FoundRelocations = FALSE; Index < mEhdr->e_shnum; Index++) {
-    Elf_Shdr *RelShdr = GetShdrByIndex(Index);
-    if ((RelShdr->sh_type == SHT_REL) || (RelShdr->sh_type == SHT_RELA)) {
-      Elf_Shdr *SecShdr = GetShdrByIndex (RelShdr->sh_info);
-      if (IsTextShdr(SecShdr) || IsDataShdr(SecShdr)) {
-        UINT32 RelIdx;
-
-        FoundRelocations = TRUE;
-        for (RelIdx = 0; RelIdx < RelShdr->sh_size; RelIdx += RelShdr->sh_entsize) {
-          Elf_Rel  *Rel = (Elf_Rel *)((UINT8*)mEhdr + RelShdr->sh_offset + RelIdx);
-
-          if (mEhdr->e_machine == EM_386) { 
-            switch (ELF_R_TYPE(Rel->r_info)) {
-            case R_386_NONE:
-            case R_386_PC32:
-              //
-              // No fixup entry required.
-              //
-              break;
-            case R_386_32:
-              //
-              // Creates a relative relocation entry from the absolute entry.
-              //
-              CoffAddFixup(mCoffSectionsOffset[RelShdr->sh_info]
-              + (Rel->r_offset - SecShdr->sh_addr),
-              EFI_IMAGE_REL_BASED_HIGHLOW);
-              break;
-            default:
-              Error (NULL, 0, 3000, "Invalid", "%s unsupported ELF EM_386 relocation 0x%x.", mInImageName, (unsigned) ELF_R_TYPE(Rel->r_info));
-            }
-          } else if (mEhdr->e_machine == EM_ARM) {
-            switch (ELF32_R_TYPE(Rel->r_info)) {
-            case R_ARM_RBASE:
-              // No relocation - no action required
-              // break skipped
-
-            case R_ARM_PC24:
-            case R_ARM_XPC25:
-            case R_ARM_THM_PC22:
-            case R_ARM_THM_JUMP19:
-            case R_ARM_CALL:
-            case R_ARM_JMP24:
-            case R_ARM_THM_JUMP24:  
-            case R_ARM_PREL31:  
-            case R_ARM_MOVW_PREL_NC:  
-            case R_ARM_MOVT_PREL:
-            case R_ARM_THM_MOVW_PREL_NC:
-            case R_ARM_THM_MOVT_PREL:
-            case R_ARM_THM_JMP6:
-            case R_ARM_THM_ALU_PREL_11_0:
-            case R_ARM_THM_PC12:
-            case R_ARM_REL32_NOI:
-            case R_ARM_ALU_PC_G0_NC:
-            case R_ARM_ALU_PC_G0:
-            case R_ARM_ALU_PC_G1_NC:
-            case R_ARM_ALU_PC_G1:
-            case R_ARM_ALU_PC_G2:
-            case R_ARM_LDR_PC_G1:
-            case R_ARM_LDR_PC_G2:
-            case R_ARM_LDRS_PC_G0:
-            case R_ARM_LDRS_PC_G1:
-            case R_ARM_LDRS_PC_G2:
-            case R_ARM_LDC_PC_G0:
-            case R_ARM_LDC_PC_G1:
-            case R_ARM_LDC_PC_G2:
-            case R_ARM_GOT_PREL:
-            case R_ARM_THM_JUMP11:
-            case R_ARM_THM_JUMP8:
-            case R_ARM_TLS_GD32:
-            case R_ARM_TLS_LDM32:
-            case R_ARM_TLS_IE32:
-              // Thease are all PC-relative relocations and don't require modification
-              break;
+  Ehdr = Context->Ehdr;
+  MovwOffset = 0;
 
-            case R_ARM_THM_MOVW_ABS_NC:
-              CoffAddFixup (
-                mCoffSectionsOffset[RelShdr->sh_info]
-                + (Rel->r_offset - SecShdr->sh_addr),
-                EFI_IMAGE_REL_BASED_ARM_MOV32T
-                );
+  for (Index = 0, FoundRelocations = FALSE; Index < Context->RelocSectionCount; Index++) {
+    Elf_Shdr *RelShdr = GetShdrByIndex(Context, Context->RelocSections[Index]);
+    Elf_Shdr *SecShdr = GetShdrByIndex (Context, RelShdr->sh_info);
+    if ((Context->SectionFilter[RelShdr->sh_info] & ((1 << SECTION_TEXT) | (1 << SECTION_DATA))) != 0) {
+      UINT32 RelIdx;
 
-              // PE/COFF treats MOVW/MOVT relocation as single 64-bit instruction
-              // Track this address so we can log an error for unsupported sequence of MOVW/MOVT
-              gMovwOffset = mCoffSectionsOffset[RelShdr->sh_info] + (Rel->r_offset - SecShdr->sh_addr);
-              break;
+      FoundRelocations = TRUE;
+      for (RelIdx = 0; RelIdx < RelShdr->sh_size; RelIdx += RelShdr->sh_entsize) {
+        Elf_Rel  *Rel = (Elf_Rel *)((UINT8*)Ehdr + RelShdr->sh_offset + RelIdx);
 
-            case R_ARM_THM_MOVT_ABS:
-              if ((gMovwOffset + 4) !=  (mCoffSectionsOffset[RelShdr->sh_info] + (Rel->r_offset - SecShdr->sh_addr))) {
-                Error (NULL, 0, 3000, "Not Supported", "PE/COFF requires MOVW+MOVT instruction sequence %x +4 != %x.", gMovwOffset, mCoffSectionsOffset[RelShdr->sh_info] + (Rel->r_offset - SecShdr->sh_addr));
-              }
-              break;
+        if (Ehdr->e_machine == EM_386) { 
+          switch (ELF_R_TYPE(Rel->r_info)) {
+          case R_386_NONE:
+          case R_386_PC32:
+            //
+            // No fixup entry required.
+            //
+            break;
+          case R_386_32:
+            //
+            // Creates a relative relocation entry from the absolute entry.
+            //
+            CoffAddFixup(Context, Context->CoffSectionsOffset[RelShdr->sh_info]
+            + (Rel->r_offset - SecShdr->sh_addr),
+            EFI_IMAGE_REL_BASED_HIGHLOW);
+            break;
+          default:
+            ElfConvertError (Context, "Invalid", "%s unsupported ELF EM_386 relocation 0x%x.", Context->InImageName, (unsigned) ELF_R_TYPE(Rel->r_info));
+          }
+        } else if (Ehdr->e_machine == EM_ARM) {
+          switch (ELF32_R_TYPE(Rel->r_info)) {
+          case R_ARM_RBASE:
+            // No relocation - no action required
+            // break skipped
 
-            case R_ARM_ABS32:
-            case R_ARM_RABS32:
-              CoffAddFixup (
-                mCoffSectionsOffset[RelShdr->sh_info]
-                + (Rel->r_offset - SecShdr->sh_addr),
-                EFI_IMAGE_REL_BASED_HIGHLOW
-                );
-              break;
+          case R_ARM_PC24:
+          case R_ARM_XPC25:
+          case R_ARM_THM_PC22:
+          case R_ARM_THM_JUMP19:
+          case R_ARM_CALL:
+          case R_ARM_JMP24:
+          case R_ARM_THM_JUMP24:  
+          case R_ARM_PREL31:  
+          case R_ARM_MOVW_PREL_NC:  
+          case R_ARM_MOVT_PREL:
+          case R_ARM_THM_MOVW_PREL_NC:
+          case R_ARM_THM_MOVT_PREL:
+          case R_ARM_THM_JMP6:
+          case R_ARM_THM_ALU_PREL_11_0:
+          case R_ARM_THM_PC12:
+          case R_ARM_REL32_NOI:
+          case R_ARM_ALU_PC_G0_NC:
+          case R_ARM_ALU_PC_G0:
+          case R_ARM_ALU_PC_G1_NC:
+          case R_ARM_ALU_PC_G1:
+          case R_ARM_ALU_PC_G2:
+          case R_ARM_LDR_PC_G1:
+          case R_ARM_LDR_PC_G2:
+          case R_ARM_LDRS_PC_G0:
+          case R_ARM_LDRS_PC_G1:
+          case R_ARM_LDRS_PC_G2:
+          case R_ARM_LDC_PC_G0:
+          case R_ARM_LDC_PC_G1:
+          case R_ARM_LDC_PC_G2:
+          case R_ARM_GOT_PREL:
+          case R_ARM_THM_JUMP11:
+          case R_ARM_THM_JUMP8:
+          case R_ARM_TLS_GD32:
+          case R_ARM_TLS_LDM32:
+          case R_ARM_TLS_IE32:
+            // Thease are all PC-relative relocations and don't require modification
+            break;
+
+          case R_ARM_THM_MOVW_ABS_NC:
+            CoffAddFixup (
+              Context,
+              Context->CoffSectionsOffset[RelShdr->sh_info]
+              + (Rel->r_offset - SecShdr->sh_addr),
+              EFI_IMAGE_REL_BASED_ARM_MOV32T
+              );
+
+            // PE/COFF treats MOVW/MOVT relocation as single 64-bit instruction
+            // Track this address so we can log an error for unsupported sequence of MOVW/MOVT
+            MovwOffset = Context->CoffSectionsOffset[RelShdr->sh_info] + (Rel->r_offset - SecShdr->sh_addr);
+            break;
 
-           default:
-              Error (NULL, 0, 3000, "Invalid", "WriteRelocations(): %s unsupported ELF EM_ARM relocation 0x%x.", mInImageName, (unsigned) ELF32_R_TYPE(Rel->r_info));
+          case R_ARM_THM_MOVT_ABS:
+            if ((MovwOffset + 4) !=  (Context->CoffSectionsOffset[RelShdr->sh_info] + (Rel->r_offset - SecShdr->sh_addr))) {
+              ElfConvertError (Context, "Not Supported", "PE/COFF requires MOVW+MOVT instruction sequence %x +4 != %x.", MovwOffset, Context->CoffSectionsOffset[RelShdr->sh_info] + (Rel->r_offset - SecShdr->sh_addr));
             }
-          } else {
-            Error (NULL, 0, 3000, "Not Supported", "This tool does not support relocations for ELF with e_machine %u (processor type).", (unsigned) mEhdr->e_machine);
+            break;
+
+          case R_ARM_ABS32:
+          case R_ARM_RABS32:
+            CoffAddFixup (
+              Context,
+              Context->CoffSectionsOffset[RelShdr->sh_info]
+              + (Rel->r_offset - SecShdr->sh_addr),
+              EFI_IMAGE_REL_BASED_HIGHLOW
+              );
+            break;
+
+         default:
+            ElfConvertError (Context, "Invalid", "WriteRelocations(): %s unsupported ELF EM_ARM relocation 0x%x.", Context->InImageName, (unsigned) ELF32_R_TYPE(Rel->r_info));
           }
+        } else {
+          ElfConvertError (Context, "Not Supported", "This tool does not support relocations for ELF with e_machine %u (processor type).", (unsigned) Ehdr->e_machine);
         }
       }
     }
   }
 
-  if (!FoundRelocations && (mEhdr->e_machine == EM_ARM)) {
+  if (!FoundRelocations && (Ehdr->e_machine == EM_ARM)) {
     /* Try again, but look for PT_DYNAMIC instead of SHT_REL */
 
-    for (Index = 0; Index < mEhdr->e_phnum; Index++) {
+    for (Index = 0; Index < Ehdr->e_phnum; Index++) {
       RelElementSize = 0;
       RelSize = 0;
       RelOffset = 0;
 
-      DynamicSegment = GetPhdrByIndex (Index);
+      DynamicSegment = GetPhdrByIndex (Context, Index);
 
       if (DynamicSegment->p_type == PT_DYNAMIC) {
-        Dyn = (Elf32_Dyn *) ((UINT8 *)mEhdr + DynamicSegment->p_offset);
+        Dyn = (Elf32_Dyn *) ((UINT8 *)Ehdr + DynamicSegment->p_offset);
 
         while (Dyn->d_tag != DT_NULL) {
           switch (Dyn->d_tag) {
@@ -902,7 +983,7 @@ WriteRelocations32 (
           Dyn++;
         }
         if (( RelOffset == 0 ) || ( RelSize == 0 ) || ( RelElementSize == 0 )) {
-          Error (NULL, 0, 3000, "Invalid", "%s bad ARM dynamic relocations.", mInImageName);
+          ElfConvertError (Context, "Invalid", "%s bad ARM dynamic relocations.", Context->InImageName);
         }
 
         for (K = 0; K < RelSize; K += RelElementSize) {
@@ -910,10 +991,10 @@ WriteRelocations32 (
           if (DynamicSegment->p_paddr == 0) {
             // Older versions of the ARM ELF (SWS ESPC 0003 B-02) specification define DT_REL
             // as an offset in the dynamic segment. p_paddr is defined to be zero for ARM tools
-            Rel = (Elf32_Rel *) ((UINT8 *) mEhdr + DynamicSegment->p_offset + RelOffset + K);
+            Rel = (Elf32_Rel *) ((UINT8 *) Ehdr + DynamicSegment->p_offset + RelOffset + K);
           } else {
             // This is how it reads in the generic ELF specification
-            Rel = (Elf32_Rel *) ((UINT8 *) mEhdr + RelOffset + K);
+            Rel = (Elf32_Rel *) ((UINT8 *) Ehdr + RelOffset + K);
           }
 
           switch (ELF32_R_TYPE (Rel->r_info)) {
@@ -921,18 +1002,18 @@ WriteRelocations32 (
             break;
 
           case  R_ARM_RABS32:
-            TargetSegment = GetPhdrByIndex (ELF32_R_SYM (Rel->r_info) - 1);
+            TargetSegment = GetPhdrByIndex (Context, ELF32_R_SYM (Rel->r_info) - 1);
 
             // Note: r_offset in a memory address.  Convert it to a pointer in the coff file.
-            Targ = mCoffFile + mCoffSectionsOffset[ ELF32_R_SYM( Rel->r_info ) ] + Rel->r_offset - TargetSegment->p_vaddr;
+            Targ = Context->CoffFile + Context->CoffSectionsOffset[ ELF32_R_SYM( Rel->r_info ) ] + Rel->r_offset - TargetSegment->p_vaddr;
 
-            *(UINT32 *)Targ = *(UINT32 *)Targ + mCoffSectionsOffset [ELF32_R_SYM( Rel->r_info )];
+            *(UINT32 *)Targ = *(UINT32 *)Targ + Context->CoffSectionsOffset [ELF32_R_SYM( Rel->r_info )];
 
-            CoffAddFixup (mCoffSectionsOffset[ELF32_R_SYM (Rel->r_info)] + (Rel->r_offset - TargetSegment->p_vaddr), EFI_IMAGE_REL_BASED_HIGHLOW);
+            CoffAddFixup (Context, Context->CoffSectionsOffset[ELF32_R_SYM (Rel->r_info)] + (Rel->r_offset - TargetSegment->p_vaddr), EFI_IMAGE_REL_BASED_HIGHLOW);
             break;
           
           default:
-            Error (NULL, 0, 3000, "Invalid", "%s bad ARM dynamic relocations, unkown type %d.", mInImageName, ELF32_R_TYPE (Rel->r_info));
+            ElfConvertError (Context, "Invalid", "%s bad ARM dynamic relocations, unkown type %d.", Context->InImageName, ELF32_R_TYPE (Rel->r_info));
             break;
           }
         }
@@ -942,22 +1023,20 @@ WriteRelocations32 (
   }
 
   //
-  // Pad by adding empty entries.
+  // Write the sorted fixups, padded by adding empty entries.
   //
-  while (mCoffOffset & (mCoffAlignment - 1)) {
-    CoffAddFixupEntry(0);
-  }
+  CoffWriteFixups (Context, mCoffAlignment);
 
-  NtHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)(mCoffFile + mNtHdrOffset);
+  NtHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)(Context->CoffFile + Context->NtHdrOffset);
   Dir = &NtHdr->Pe32.OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_BASERELOC];
-  Dir->Size = mCoffOffset - mRelocOffset;
+  Dir->Size = Context->CoffOffset - Context->RelocOffset;
   if (Dir->Size == 0) {
     // If no relocations, null out the directory entry and don't add the .reloc section
     Dir->VirtualAddress = 0;
     NtHdr->Pe32.FileHeader.NumberOfSections--;
   } else {
-    Dir->VirtualAddress = mRelocOffset;
-    CreateSectionHeader (".reloc", mRelocOffset, mCoffOffset - mRelocOffset,
+    Dir->VirtualAddress = Context->RelocOffset;
+    CreateSectionHeader (Context, ".reloc", Context->RelocOffset, Context->CoffOffset - Context->RelocOffset,
             EFI_IMAGE_SCN_CNT_INITIALIZED_DATA
             | EFI_IMAGE_SCN_MEM_DISCARDABLE
             | EFI_IMAGE_SCN_MEM_READ);
@@ -968,7 +1047,7 @@ WriteRelocations32 (
 STATIC
 VOID
 WriteDebug32 (
-  VOID
+  ELF_CONVERT_CONTEXT  *Context
   )
 {
   UINT32                              Len;
@@ -978,18 +1057,18 @@ WriteDebug32 (
   EFI_IMAGE_DEBUG_DIRECTORY_ENTRY     *Dir;
   EFI_IMAGE_DEBUG_CODEVIEW_NB10_ENTRY *Nb10;
 
-  Len = strlen(mInImageName) + 1;
-  DebugOffset = mCoffOffset;
+  Len = strlen(Context->InImageName) + 1;
+  DebugOffset = Context->CoffOffset;
 
-  mCoffOffset += sizeof(EFI_IMAGE_DEBUG_DIRECTORY_ENTRY)
+  Context->CoffOffset += sizeof(EFI_IMAGE_DEBUG_DIRECTORY_ENTRY)
     + sizeof(EFI_IMAGE_DEBUG_CODEVIEW_NB10_ENTRY)
     + Len;
-  mCoffOffset = CoffAlign(mCoffOffset);
+  Context->CoffOffset = CoffAlign(Context->CoffOffset);
 
-  mCoffFile = realloc(mCoffFile, mCoffOffset);
-  memset(mCoffFile + DebugOffset, 0, mCoffOffset - DebugOffset);
+  Context->CoffFile = realloc(Context->CoffFile, Context->CoffOffset);
+  memset(Context->CoffFile + DebugOffset, 0, Context->CoffOffset - DebugOffset);
 
-  Dir = (EFI_IMAGE_DEBUG_DIRECTORY_ENTRY*)(mCoffFile + DebugOffset);
+  Dir = (EFI_IMAGE_DEBUG_DIRECTORY_ENTRY*)(Context->CoffFile + DebugOffset);
   Dir->Type = EFI_IMAGE_DEBUG_TYPE_CODEVIEW;
   Dir->SizeOfData = sizeof(EFI_IMAGE_DEBUG_CODEVIEW_NB10_ENTRY) + Len;
   Dir->RVA = DebugOffset + sizeof(EFI_IMAGE_DEBUG_DIRECTORY_ENTRY);
@@ -997,20 +1076,20 @@ WriteDebug32 (
 
   Nb10 = (EFI_IMAGE_DEBUG_CODEVIEW_NB10_ENTRY*)(Dir + 1);
   Nb10->Signature = CODEVIEW_SIGNATURE_NB10;
-  strcpy ((char *)(Nb10 + 1), mInImageName);
+  strcpy ((char *)(Nb10 + 1), Context->InImageName);
 
 
-  NtHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)(mCoffFile + mNtHdrOffset);
+  NtHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)(Context->CoffFile + Context->NtHdrOffset);
   DataDir = &NtHdr->Pe32.OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_DEBUG];
   DataDir->VirtualAddress = DebugOffset;
-  DataDir->Size = mCoffOffset - DebugOffset;
+  DataDir->Size = Context->CoffOffset - DebugOffset;
   if (DataDir->Size == 0) {
     // If no debug, null out the directory entry and don't add the .debug section
     DataDir->VirtualAddress = 0;
     NtHdr->Pe32.FileHeader.NumberOfSections--;
   } else {
     DataDir->VirtualAddress = DebugOffset;
-    CreateSectionHeader (".debug", DebugOffset, mCoffOffset - DebugOffset,
+    CreateSectionHeader (Context, ".debug", DebugOffset, Context->CoffOffset - DebugOffset,
             EFI_IMAGE_SCN_CNT_INITIALIZED_DATA
             | EFI_IMAGE_SCN_MEM_DISCARDABLE
             | EFI_IMAGE_SCN_MEM_READ);
@@ -1021,7 +1100,7 @@ WriteDebug32 (
 STATIC
 VOID
 SetImageSize32 (
-  VOID
+  ELF_CONVERT_CONTEXT  *Context
   )
 {
   EFI_IMAGE_OPTIONAL_HEADER_UNION *NtHdr;
@@ -1029,18 +1108,34 @@ SetImageSize32 (
   //
   // Set image size
   //
-  NtHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)(mCoffFile + mNtHdrOffset);
-  NtHdr->Pe32.OptionalHeader.SizeOfImage = mCoffOffset;
+  NtHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)(Context->CoffFile + Context->NtHdrOffset);
+  NtHdr->Pe32.OptionalHeader.SizeOfImage = Context->CoffOffset;
 }
 
 STATIC
 VOID
 CleanUp32 (
-  VOID
+  ELF_CONVERT_CONTEXT  *Context
   )
 {
-  if (mCoffSectionsOffset != NULL) {
-    free (mCoffSectionsOffset);
+  UINT32  FilterType;
+
+  if (Context->CoffSectionsOffset != NULL) {
+    free (Context->CoffSectionsOffset);
+  }
+  if (Context->SectionFilter != NULL) {
+    free (Context->SectionFilter);
+  }
+  if (Context->SectionAdjust != NULL) {
+    free (Context->SectionAdjust);
+  }
+  if (Context->RelocSections != NULL) {
+    free (Context->RelocSections);
+  }
+  for (FilterType = 0; FilterType < SECTION_FILTER_COUNT; FilterType++) {
+    if (Context->FilterSections[FilterType] != NULL) {
+      free (Context->FilterSections[FilterType]);
+    }
   }
 }
 
@@ -17,8 +17,9 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 BOOLEAN
 InitializeElf64 (
-  UINT8               *FileBuffer,
-  ELF_FUNCTION_TABLE  *ElfFunctions
+  ELF_CONVERT_CONTEXT  *Context,
+  UINT8                *FileBuffer,
+  ELF_FUNCTION_TABLE   *ElfFunctions
   );
 
 #endif
@@ -20,6 +20,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
@@ -34,27 +35,6 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "Elf32Convert.h"
 #include "Elf64Convert.h"
 
-//
-// Result Coff file in memory.
-//
-UINT8 *mCoffFile = NULL;
-
-//
-// COFF relocation data
-//
-EFI_IMAGE_BASE_RELOCATION *mCoffBaseRel;
-UINT16                    *mCoffEntryRel;
-
-//
-// Current offset in coff file.
-//
-UINT32 mCoffOffset;
-
-//
-// Offset in Coff file of headers and sections.
-//
-UINT32 mTableOffset;
-
 //
 //*****************************************************************************
 // Common ELF Functions
@@ -62,70 +42,167 @@ UINT32 mTableOffset;
 //
 
 VOID
-CoffAddFixupEntry(
-  UINT16 Val
+ElfConvertError (
+  ELF_CONVERT_CONTEXT *Context,
+  CHAR8               *Text,
+  CHAR8               *MsgFmt,
+  ...
   )
 {
-  *mCoffEntryRel = Val;
-  mCoffEntryRel++;
-  mCoffBaseRel->SizeOfBlock += 2;
-  mCoffOffset += 2;
+  CHAR8   Message[MAX_LINE_LEN];
+  va_list List;
+
+  //
+  // Remember the failure in the context, so that an image converted in
+  // batch mode does not depend on the status of the whole utility.
+  //
+  Context->Status = STATUS_ERROR;
+
+  va_start (List, MsgFmt);
+  vsprintf (Message, MsgFmt, List);
+  va_end (List);
+
+  Error (NULL, 0, 3000, Text, "%s", Message);
 }
 
 VOID
 CoffAddFixup(
-  UINT32 Offset,
-  UINT8  Type
+  ELF_CONVERT_CONTEXT *Context,
+  UINT32              Offset,
+  UINT8               Type
   )
 {
-  if (mCoffBaseRel == NULL
-      || mCoffBaseRel->VirtualAddress != (Offset & ~0xfff)) {
-    if (mCoffBaseRel != NULL) {
-      //
-      // Add a null entry (is it required ?)
-      //
-      CoffAddFixupEntry (0);
-      
-      //
-      // Pad for alignment.
-      //
-      if (mCoffOffset % 4 != 0)
-        CoffAddFixupEntry (0);
+  UINT64  *NewFixups;
+
+  if (Context->FixupCount == Context->FixupCapacity) {
+    Context->FixupCapacity = (Context->FixupCapacity == 0) ? 256 : Context->FixupCapacity * 2;
+    NewFixups = realloc (Context->Fixups, Context->FixupCapacity * sizeof (UINT64));
+    if (NewFixups == NULL) {
+      Context->Status = STATUS_ERROR;
+      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+      return;
     }
+    Context->Fixups = NewFixups;
+  }
+
+  Context->Fixups[Context->FixupCount++] = ((UINT64) Offset << 4) | (Type & 0xf);
+}
+
+STATIC
+int
+CompareFixup (
+  const VOID *Left,
+  const VOID *Right
+  )
+{
+  UINT64 LeftFixup;
+  UINT64 RightFixup;
 
-    mCoffFile = realloc (
-      mCoffFile,
-      mCoffOffset + sizeof(EFI_IMAGE_BASE_RELOCATION) + 2*0x1000
-      );
-    memset (
-      mCoffFile + mCoffOffset, 0,
-      sizeof(EFI_IMAGE_BASE_RELOCATION) + 2*0x1000
-      );
-
-    mCoffBaseRel = (EFI_IMAGE_BASE_RELOCATION*)(mCoffFile + mCoffOffset);
-    mCoffBaseRel->VirtualAddress = Offset & ~0xfff;
-    mCoffBaseRel->SizeOfBlock = sizeof(EFI_IMAGE_BASE_RELOCATION);
-
-    mCoffEntryRel = (UINT16 *)(mCoffBaseRel + 1);
-    mCoffOffset += sizeof(EFI_IMAGE_BASE_RELOCATION);
+  LeftFixup  = *(const UINT64 *) Left;
+  RightFixup = *(const UINT64 *) Right;
+  if (LeftFixup < RightFixup) {
+    return -1;
+  }
+  return LeftFixup > RightFixup;
+}
+
+VOID
+CoffWriteFixups (
+  ELF_CONVERT_CONTEXT *Context,
+  UINT32              Alignment
+  )
+{
+  EFI_IMAGE_BASE_RELOCATION *BaseRel;
+  UINT16                    *EntryRel;
+  UINT64                    *Fixups;
+  UINT32                    Count;
+  UINT32                    Index;
+  UINT32                    Page;
+  UINT32                    Offset;
+  BOOLEAN                   Sorted;
+
+  if (Context->FixupCount == 0) {
+    return;
+  }
+
+  //
+  // Sort the fixups by offset, unless the relocations already came in
+  // order, and drop the ones added twice: they would be applied twice
+  // when the image is relocated.
+  //
+  Fixups = Context->Fixups;
+  Sorted = TRUE;
+  for (Index = 1; Index < Context->FixupCount; Index++) {
+    if (Fixups[Index] < Fixups[Index - 1]) {
+      Sorted = FALSE;
+      break;
+    }
+  }
+  if (!Sorted) {
+    qsort (Fixups, Context->FixupCount, sizeof (UINT64), CompareFixup);
+  }
+  Count = 1;
+  for (Index = 1; Index < Context->FixupCount; Index++) {
+    if (Fixups[Index] != Fixups[Count - 1]) {
+      Fixups[Count++] = Fixups[Index];
+    }
   }
 
   //
-  // Fill the entry.
+  // A block per page, each with a null entry and padded to 4 bytes, and
+  // the last one padded with null entries up to Alignment. Size the file
+  // for a block per fixup so that it is grown only once.
   //
-  CoffAddFixupEntry((UINT16) ((Type << 12) | (Offset & 0xfff)));
+  Context->CoffFile = realloc (
+    Context->CoffFile,
+    Context->CoffOffset + Count * (sizeof (EFI_IMAGE_BASE_RELOCATION) + 3 * sizeof (UINT16)) + Alignment
+    );
+  memset (
+    Context->CoffFile + Context->CoffOffset, 0,
+    Count * (sizeof (EFI_IMAGE_BASE_RELOCATION) + 3 * sizeof (UINT16)) + Alignment
+    );
+
+  Offset = Context->CoffOffset;
+  Index  = 0;
+  while (Index < Count) {
+    Page     = (UINT32) (Fixups[Index] >> 4) & ~0xfff;
+    BaseRel  = (EFI_IMAGE_BASE_RELOCATION *) (Context->CoffFile + Offset);
+    EntryRel = (UINT16 *) (BaseRel + 1);
+    BaseRel->VirtualAddress = Page;
+    for (; Index < Count && ((UINT32) (Fixups[Index] >> 4) & ~0xfff) == Page; Index++) {
+      *EntryRel++ = (UINT16) (((Fixups[Index] & 0xf) << 12) | ((Fixups[Index] >> 4) & 0xfff));
+    }
+    Offset = (UINT32) ((UINT8 *) EntryRel - Context->CoffFile);
+    if (Index < Count) {
+      //
+      // Add a null entry (is it required ?) and pad for alignment.
+      //
+      Offset += sizeof (UINT16);
+      if (Offset % 4 != 0) {
+        Offset += sizeof (UINT16);
+      }
+    } else {
+      while (Offset & (Alignment - 1)) {
+        Offset += sizeof (UINT16);
+      }
+    }
+    BaseRel->SizeOfBlock = Offset - (UINT32) ((UINT8 *) BaseRel - Context->CoffFile);
+  }
+
+  Context->CoffOffset = Offset;
 }
 
 VOID
 CreateSectionHeader (
-  const CHAR8 *Name,
-  UINT32      Offset,
-  UINT32      Size,
-  UINT32      Flags
+  ELF_CONVERT_CONTEXT *Context,
+  const CHAR8         *Name,
+  UINT32              Offset,
+  UINT32              Size,
+  UINT32              Flags
   )
 {
   EFI_IMAGE_SECTION_HEADER *Hdr;
-  Hdr = (EFI_IMAGE_SECTION_HEADER*)(mCoffFile + mTableOffset);
+  Hdr = (EFI_IMAGE_SECTION_HEADER*)(Context->CoffFile + Context->TableOffset);
 
   strcpy((char *)Hdr->Name, Name);
   Hdr->Misc.VirtualSize = Size;
@@ -138,7 +215,7 @@ CreateSectionHeader (
   Hdr->NumberOfLinenumbers = 0;
   Hdr->Characteristics = Flags;
 
-  mTableOffset += sizeof (EFI_IMAGE_SECTION_HEADER);
+  Context->TableOffset += sizeof (EFI_IMAGE_SECTION_HEADER);
 }
 
 //
@@ -160,24 +237,34 @@ IsElfHeader (
 
 BOOLEAN
 ConvertElf (
-  UINT8  **FileBuffer,
-  UINT32 *FileLength
+  IN     CHAR8  *InImageName,
+  IN     UINT32 OutImageType,
+  IN     UINT8  *ElfImage,
+  OUT    UINT8  **FileBuffer,
+  OUT    UINT32 *FileLength,
+  OUT    UINT32 *ImageTimeStamp
   )
 {
   ELF_FUNCTION_TABLE              ElfFunctions;
+  ELF_CONVERT_CONTEXT             Context;
   UINT8                           EiClass;
 
+  memset (&Context, 0, sizeof (Context));
+  Context.InImageName  = InImageName;
+  Context.OutImageType = OutImageType;
+  Context.Status       = STATUS_SUCCESS;
+
   //
   // Determine ELF type and set function table pointer correctly.
   //
   VerboseMsg ("Check Elf Image Header");
-  EiClass = (*FileBuffer)[EI_CLASS];
+  EiClass = ElfImage[EI_CLASS];
   if (EiClass == ELFCLASS32) {
-    if (!InitializeElf32 (*FileBuffer, &ElfFunctions)) {
+    if (!InitializeElf32 (&Context, ElfImage, &ElfFunctions)) {
       return FALSE;
     }
   } else if (EiClass == ELFCLASS64) {
-    if (!InitializeElf64 (*FileBuffer, &ElfFunctions)) {
+    if (!InitializeElf64 (&Context, ElfImage, &ElfFunctions)) {
       return FALSE;
     }
   } else {
@@ -189,45 +276,60 @@ ConvertElf (
   // Compute sections new address.
   //  
   VerboseMsg ("Compute sections new address.");
-  ElfFunctions.ScanSections ();
+  ElfFunctions.ScanSections (&Context);
 
   //
   // Write and relocate sections.
   //
   VerboseMsg ("Write and relocate sections.");
-  ElfFunctions.WriteSections (SECTION_TEXT);
-  ElfFunctions.WriteSections (SECTION_DATA);
-  ElfFunctions.WriteSections (SECTION_HII);
+  ElfFunctions.WriteSections (&Context, SECTION_TEXT);
+  ElfFunctions.WriteSections (&Context, SECTION_DATA);
+  ElfFunctions.WriteSections (&Context, SECTION_HII);
 
   //
   // Translate and write relocations.
   //
   VerboseMsg ("Translate and write relocations.");
-  ElfFunctions.WriteRelocations ();
+  ElfFunctions.WriteRelocations (&Context);
 
   //
   // Write debug info.
   //
   VerboseMsg ("Write debug info.");
-  ElfFunctions.WriteDebug ();
+  ElfFunctions.WriteDebug (&Context);
 
   //
   // Make sure image size is correct before returning the new image.
   //
   VerboseMsg ("Set image size.");
-  ElfFunctions.SetImageSize ();
+  ElfFunctions.SetImageSize (&Context);
+
+  if (Context.Fixups != NULL) {
+    free (Context.Fixups);
+  }
+
+  if (Context.Status != STATUS_SUCCESS) {
+    //
+    // An error was reported while converting, keep the input untouched.
+    //
+    if (Context.CoffFile != NULL) {
+      free (Context.CoffFile);
+    }
+    ElfFunctions.CleanUp (&Context);
+    return FALSE;
+  }
 
   //
-  // Replace.
+  // Return the new image. The ELF image stays with the caller.
   //
-  free (*FileBuffer);
-  *FileBuffer = mCoffFile;
-  *FileLength = mCoffOffset;
+  *FileBuffer = Context.CoffFile;
+  *FileLength = Context.CoffOffset;
+  *ImageTimeStamp = Context.ImageTimeStamp;
 
   //
   // Free resources used by ELF functions.
   //
-  ElfFunctions.CleanUp ();
+  ElfFunctions.CleanUp (&Context);
   
   return TRUE;
 }
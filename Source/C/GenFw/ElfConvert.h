@@ -19,16 +19,6 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "elf32.h"
 #include "elf64.h"
 
-//
-// Externally defined variables
-//
-extern UINT32 mCoffOffset;
-extern CHAR8  *mInImageName;
-extern UINT32 mImageTimeStamp;
-extern UINT8  *mCoffFile;
-extern UINT32 mTableOffset;
-extern UINT32 mOutImageType;
-
 //
 // Common EFI specific data.
 //
@@ -40,20 +30,92 @@ extern UINT32 mOutImageType;
 typedef enum {
   SECTION_TEXT,
   SECTION_HII,
-  SECTION_DATA
+  SECTION_DATA,
+  SECTION_FILTER_COUNT
   
 } SECTION_FILTER_TYPES;
 
+//
+// State of one ELF to PE/COFF conversion. Nothing is shared between
+// contexts, so several images can be converted at the same time.
+//
+typedef struct {
+  //
+  // Input image. The ELF headers are Elf32 or Elf64 structures depending
+  // on the class of the image.
+  //
+  CHAR8                     *InImageName;
+  UINT32                    OutImageType;
+  VOID                      *Ehdr;
+  VOID                      *ShdrBase;
+  VOID                      *PhdrBase;
+
+  //
+  // ELF sections to offset in Coff file.
+  //
+  UINT32                    *CoffSectionsOffset;
+
+  //
+  // Section classification, built once before the sections are scanned.
+  // SectionFilter holds a (1 << SECTION_*) bit for each filter a section
+  // matches. FilterSections lists the sections of each filter and
+  // RelocSections the SHT_REL/SHT_RELA sections, in section header order.
+  //
+  UINT8                     *SectionFilter;
+  UINT32                    *FilterSections[SECTION_FILTER_COUNT];
+  UINT32                    FilterSectionCount[SECTION_FILTER_COUNT];
+  UINT32                    *RelocSections;
+  UINT32                    RelocSectionCount;
+
+  //
+  // CoffSectionsOffset[Index] - sh_addr of each section, added to an ELF
+  // address in the section to get its offset in the Coff file.
+  //
+  UINT64                    *SectionAdjust;
+
+  //
+  // Result Coff file in memory, and current offset in it.
+  //
+  UINT8                     *CoffFile;
+  UINT32                    CoffOffset;
+
+  //
+  // Offsets in Coff file of headers and sections.
+  //
+  UINT32                    TableOffset;
+  UINT32                    NtHdrOffset;
+  UINT32                    TextOffset;
+  UINT32                    DataOffset;
+  UINT32                    HiiRsrcOffset;
+  UINT32                    RelocOffset;
+
+  //
+  // COFF relocation fixups, collected by CoffAddFixup and written by
+  // CoffWriteFixups. Each one is the image offset shifted left by 4 and
+  // or'ed with the EFI_IMAGE_REL_BASED_* type.
+  //
+  UINT64                    *Fixups;
+  UINT32                    FixupCount;
+  UINT32                    FixupCapacity;
+
+  //
+  // Time stamp written to the image, and STATUS_ERROR once an error has
+  // been reported for the image.
+  //
+  UINT32                    ImageTimeStamp;
+  STATUS                    Status;
+} ELF_CONVERT_CONTEXT;
+
 //
 // FunctionTalbe
 //
 typedef struct {
-  VOID    (*ScanSections) ();
-  BOOLEAN (*WriteSections) (SECTION_FILTER_TYPES  FilterType);
-  VOID    (*WriteRelocations) ();
-  VOID    (*WriteDebug) ();
-  VOID    (*SetImageSize) ();
-  VOID    (*CleanUp) ();
+  VOID    (*ScanSections) (ELF_CONVERT_CONTEXT *Context);
+  BOOLEAN (*WriteSections) (ELF_CONVERT_CONTEXT *Context, SECTION_FILTER_TYPES  FilterType);
+  VOID    (*WriteRelocations) (ELF_CONVERT_CONTEXT *Context);
+  VOID    (*WriteDebug) (ELF_CONVERT_CONTEXT *Context);
+  VOID    (*SetImageSize) (ELF_CONVERT_CONTEXT *Context);
+  VOID    (*CleanUp) (ELF_CONVERT_CONTEXT *Context);
   
 } ELF_FUNCTION_TABLE;
 
@@ -62,22 +124,33 @@ typedef struct {
 //
 VOID
 CoffAddFixup (
-  UINT32 Offset,
-  UINT8  Type
+  ELF_CONVERT_CONTEXT *Context,
+  UINT32              Offset,
+  UINT8               Type
   );
 
 VOID
-CoffAddFixupEntry (
-  UINT16 Val
+CoffWriteFixups (
+  ELF_CONVERT_CONTEXT *Context,
+  UINT32              Alignment
   );
 
 
 VOID
 CreateSectionHeader (
-  const CHAR8 *Name,
-  UINT32      Offset,
-  UINT32      Size,
-  UINT32      Flags
+  ELF_CONVERT_CONTEXT *Context,
+  const CHAR8         *Name,
+  UINT32              Offset,
+  UINT32              Size,
+  UINT32              Flags
+  );
+
+VOID
+ElfConvertError (
+  ELF_CONVERT_CONTEXT *Context,
+  CHAR8               *Text,
+  CHAR8               *MsgFmt,
+  ...
   );
 
 #endif
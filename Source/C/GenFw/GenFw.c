@@ -50,6 +50,8 @@ Abstract:
 #include "PeCoffLib.h"
 #include "ParseInf.h"
 #include "EfiUtilityMsgs.h"
+#include "MemoryFile.h"
+#include "WorkerPool.h"
 
 #include "GenFw.h"
 
@@ -71,6 +73,8 @@ Abstract:
 #endif
 
 #define STATUS_IGNORE 0xA
+
+#define BATCH_NO_PRODUCER ((UINTN) -1)
 //
 // Structure definition for a microcode header
 //
@@ -87,8 +91,53 @@ typedef struct {
   UINT32  Reserved[3];
 } MICROCODE_IMAGE_HEADER;
 
+//
+// One line of a batch manifest. Producer[Index] is the earlier command
+// writing InputFileName[Index], or BATCH_NO_PRODUCER when the input is not
+// written by the batch. OutputFileName is NULL when the command only
+// prints to the console.
+//
+typedef struct {
+  UINT32                  Line;
+  UINT32                  Argc;
+  CHAR8                   **Argv;
+  UINT32                  InputNum;
+  CHAR8                   **InputFileName;
+  CHAR8                   *OutputFileName;
+  UINTN                   *Producer;
+  UINTN                   Stage;
+  EFI_STATUS              Status;
+} BATCH_COMMAND;
+
+//
+// A file name used by the manifest, with the last command writing it and
+// the last stage that reads or writes it.
+//
+typedef struct _BATCH_PATH BATCH_PATH;
+struct _BATCH_PATH {
+  BATCH_PATH              *Next;
+  CHAR8                   *Name;
+  UINTN                   Writer;
+  UINTN                   LastStage;
+  BOOLEAN                 Used;
+};
+
+typedef struct {
+  BATCH_COMMAND           *Commands;
+  UINTN                   *Jobs;
+} BATCH_CONTEXT;
+
 static EFI_GUID mZeroGuid = {0x0, 0x0, 0x0, {0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0}};
 
+//
+// Options followed by a value, used to find the files of a batch command.
+//
+static const char *mValueOptionName[] = {
+  "-o", "--outputfile", "-e", "--efiImage", "-s", "--stamp", "-a", "--align",
+  "-p", "--pad", "-d", "--debug", "-g", "--hiiguid", "--rebase", "--address",
+  NULL
+};
+
 static const char *gHiiPackageRCFileHeader[] = {
   "//",
   "//  DO NOT EDIT -- auto-generated file",
@@ -96,27 +145,21 @@ static const char *gHiiPackageRCFileHeader[] = {
   NULL
 };
 
-//
-// Module image information
-//
-CHAR8  *mInImageName;
-UINT32 mImageTimeStamp = 0;
-UINT32 mImageSize = 0;
-UINT32 mOutImageType = FW_DUMMY_IMAGE;
-
 
 STATIC
 EFI_STATUS
 ZeroDebugData (
   IN OUT UINT8   *FileBuffer,
-  BOOLEAN        ZeroDebug
+  BOOLEAN        ZeroDebug,
+  OUT    UINT32  *ImageTimeStamp
   );
 
 STATIC
 EFI_STATUS
 SetStamp (
   IN OUT UINT8  *FileBuffer,
-  IN     CHAR8  *TimeStamp
+  IN     CHAR8  *TimeStamp,
+  OUT    UINT32 *ImageTimeStamp
   );
 
 STATIC
@@ -291,6 +334,13 @@ Returns:
                         except for -o or -r option. It is a action option.\n\
                         If it is combined with other action options, the later\n\
                         input action option will override the previous one.\n");
+  fprintf (stdout, "  --batch ManifestFile  Run the GenFw commands of ManifestFile in one process.\n\
+                        Each line holds the options of one command, and may\n\
+                        start with the utility name. Commands that do not\n\
+                        use each other's files run at the same time.\n\
+                        Only --threads, -v, -q and -d can be combined with it.\n");
+  fprintf (stdout, "  --threads Threads     Number of threads used by --batch. The default, 0,\n\
+                        uses one thread per processor.\n");
   fprintf (stdout, "  -v, --verbose         Turn on verbose output with informational messages.\n");
   fprintf (stdout, "  -q, --quiet           Disable all messages except key message and fatal error\n");
   fprintf (stdout, "  -d, --debug level     Enable debug messages, at input debug level.\n");
@@ -993,6 +1043,8 @@ Returns:
     free ((VOID *) MemoryImagePointer);
     return Status;
   }
+  DebugMsg (NULL, 0, 9, "relocation info", "%u relocation blocks, %u fixups applied in runs, %u one at a time",
+    (unsigned) ImageContext.RelocBlockCount, (unsigned) ImageContext.FastFixupCount, (unsigned) ImageContext.GenericFixupCount);
 
   //
   // Copy Relocated data to raw image file.
@@ -1037,25 +1089,70 @@ Returns:
   return Status;
 }
 
-int
-main (
-  int  argc,
-  char *argv[]
+STATIC
+EFI_STATUS
+WriteImageFile (
+  IN CHAR8   *FileName,
+  IN UINT8   *FileBuffer,
+  IN UINT32  FileLength
   )
 /*++
 
 Routine Description:
 
-  Main function.
+  Write an image to a file in a single pass. The file is created with its
+  final size and only replaces FileName once it is completely written, so
+  a failure never leaves a truncated image behind.
 
 Arguments:
 
-  argc - Number of command line parameters.
-  argv - Array of pointers to command line parameter strings.
+  FileName           The file to write.
+  FileBuffer         The image.
+  FileLength         The size of the image.
 
 Returns:
-  STATUS_SUCCESS - Utility exits successfully.
-  STATUS_ERROR   - Some error occurred during execution.
+
+  EFI_SUCCESS            The file is written.
+  EFI_ABORTED            The file could not be created or written.
+  EFI_OUT_OF_RESOURCES   Memory allocation failed.
+
+--*/
+{
+  EFI_STATUS   Status;
+  MAPPED_FILE  OutputFile;
+
+  Status = CreateMappedFile (FileName, FileLength, &OutputFile);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  memcpy (OutputFile.Data, FileBuffer, FileLength);
+  return CloseMappedFile (&OutputFile, TRUE);
+}
+
+STATIC
+STATUS
+RunCommand (
+  IN int     argc,
+  IN char    *argv[],
+  IN BOOLEAN BatchMode
+  )
+/*++
+
+Routine Description:
+
+  Run one GenFw command. All the state of the command is local, so the
+  commands of a batch can run at the same time on different images.
+
+Arguments:
+
+  argc      - Number of parameters, without the utility name.
+  argv      - Array of pointers to parameter strings, followed by NULL.
+  BatchMode - TRUE when the command is a line of a batch manifest. The
+              print level options are then checked but not applied.
+
+Returns:
+  STATUS_SUCCESS - The command completed successfully.
+  STATUS_ERROR   - Some error occurred, and no output file was written.
 
 --*/
 {
@@ -1081,10 +1178,11 @@ Returns:
   UINT32                           AllignedRelocSize;
   UINT8                            *FileBuffer;
   UINT32                           FileLength;
-  UINT8                            *OutputFileBuffer;
-  UINT32                           OutputFileLength;
   UINT8                            *InputFileBuffer;
   UINT32                           InputFileLength;
+  MAPPED_FILE                      InputFile;
+  MAPPED_FILE                      OutputFile;
+  BOOLEAN                          ImageChanged;
   RUNTIME_FUNCTION                 *RuntimeFunction;
   UNWIND_INFO                      *UnwindInfo;
   STATUS                           Status;
@@ -1116,11 +1214,11 @@ Returns:
   FILE                             *ReportFile;
   CHAR8                            *ReportFileName;
   UINTN                            FileLen;
-  time_t                           InputFileTime;
-  time_t                           OutputFileTime;
-  struct stat                      Stat_Buf;
-
-  SetUtilityName (UTILITY_NAME);
+  CHAR8                            *InImageName;
+  UINT32                           OutImageType;
+  UINT32                           ImageTimeStamp;
+  UINT32                           ImageSize;
+  STATUS                           CommandStatus;
 
   //
   // Assign to fix compile warning
@@ -1128,7 +1226,11 @@ Returns:
   FileLen           = 0;
   InputFileNum      = 0;
   InputFileName     = NULL;
-  mInImageName      = NULL;
+  InImageName       = NULL;
+  OutImageType      = FW_DUMMY_IMAGE;
+  ImageTimeStamp    = 0;
+  ImageSize         = 0;
+  CommandStatus     = STATUS_ERROR;
   OutImageName      = NULL;
   ModuleType        = NULL;
   Type              = 0;
@@ -1145,8 +1247,6 @@ Returns:
   CheckSum          = 0;
   ReplaceFlag       = FALSE;
   LogLevel          = 0;
-  OutputFileBuffer  = NULL;
-  OutputFileLength  = 0;
   InputFileBuffer   = NULL;
   InputFileLength   = 0;
   Optional32        = NULL;
@@ -1163,28 +1263,8 @@ Returns:
   HiiSectionHeader       = NULL;
   NewBaseAddress         = 0;
   NegativeAddr           = FALSE;
-  InputFileTime          = 0;
-  OutputFileTime         = 0;
-
-  if (argc == 1) {
-    Error (NULL, 0, 1001, "Missing options", "No input options.");
-    Usage ();
-    return STATUS_ERROR;
-  }
-
-  argc --;
-  argv ++;
-
-  if ((stricmp (argv[0], "-h") == 0) || (stricmp (argv[0], "--help") == 0)) {
-    Version ();
-    Usage ();
-    return STATUS_SUCCESS;
-  }
-
-  if (stricmp (argv[0], "--version") == 0) {
-    Version ();
-    return STATUS_SUCCESS;
-  }
+  memset (&InputFile, 0, sizeof (InputFile));
+  memset (&OutputFile, 0, sizeof (OutputFile));
 
   while (argc > 0) {
     if ((stricmp (argv[0], "-o") == 0) || (stricmp (argv[0], "--outputfile") == 0)) {
@@ -1204,8 +1284,8 @@ Returns:
         goto Finish;
       }
       ModuleType = argv[1];
-      if (mOutImageType != FW_TE_IMAGE) {
-        mOutImageType = FW_EFI_IMAGE;
+      if (OutImageType != FW_TE_IMAGE) {
+        OutImageType = FW_EFI_IMAGE;
       }
       argc -= 2;
       argv += 2;
@@ -1213,49 +1293,49 @@ Returns:
     }
 
     if ((stricmp (argv[0], "-l") == 0) || (stricmp (argv[0], "--stripped") == 0)) {
-      mOutImageType = FW_RELOC_STRIPEED_IMAGE;
+      OutImageType = FW_RELOC_STRIPEED_IMAGE;
       argc --;
       argv ++;
       continue;
     }
 
     if ((stricmp (argv[0], "-c") == 0) || (stricmp (argv[0], "--acpi") == 0)) {
-      mOutImageType = FW_ACPI_IMAGE;
+      OutImageType = FW_ACPI_IMAGE;
       argc --;
       argv ++;
       continue;
     }
 
     if ((stricmp (argv[0], "-t") == 0) || (stricmp (argv[0], "--terse") == 0)) {
-      mOutImageType = FW_TE_IMAGE;
+      OutImageType = FW_TE_IMAGE;
       argc --;
       argv ++;
       continue;
     }
 
     if ((stricmp (argv[0], "-u") == 0) || (stricmp (argv[0], "--dump") == 0)) {
-      mOutImageType = DUMP_TE_HEADER;
+      OutImageType = DUMP_TE_HEADER;
       argc --;
       argv ++;
       continue;
     }
 
     if ((stricmp (argv[0], "-b") == 0) || (stricmp (argv[0], "--exe2bin") == 0)) {
-      mOutImageType = FW_BIN_IMAGE;
+      OutImageType = FW_BIN_IMAGE;
       argc --;
       argv ++;
       continue;
     }
 
     if ((stricmp (argv[0], "-z") == 0) || (stricmp (argv[0], "--zero") == 0)) {
-      mOutImageType = FW_ZERO_DEBUG_IMAGE;
+      OutImageType = FW_ZERO_DEBUG_IMAGE;
       argc --;
       argv ++;
       continue;
     }
 
     if ((stricmp (argv[0], "-s") == 0) || (stricmp (argv[0], "--stamp") == 0)) {
-      mOutImageType = FW_SET_STAMP_IMAGE;
+      OutImageType = FW_SET_STAMP_IMAGE;
       if (argv[1] == NULL || argv[1][0] == '-') {
         Error (NULL, 0, 1003, "Invalid option value", "time stamp is missing for -s option");
         goto Finish;
@@ -1288,14 +1368,14 @@ Returns:
     }
 
     if ((stricmp (argv[0], "-m") == 0) || (stricmp (argv[0], "--mcifile") == 0)) {
-      mOutImageType = FW_MCI_IMAGE;
+      OutImageType = FW_MCI_IMAGE;
       argc --;
       argv ++;
       continue;
     }
 
     if ((stricmp (argv[0], "-j") == 0) || (stricmp (argv[0], "--join") == 0)) {
-      mOutImageType = FW_MERGE_IMAGE;
+      OutImageType = FW_MERGE_IMAGE;
       argc --;
       argv ++;
       continue;
@@ -1324,7 +1404,7 @@ Returns:
         Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
         goto Finish;
       }
-      mOutImageType = FW_REBASE_IMAGE;
+      OutImageType = FW_REBASE_IMAGE;
       NewBaseAddress = (UINT64) Temp64;
       argc -= 2;
       argv += 2;
@@ -1343,7 +1423,7 @@ Returns:
         Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
         goto Finish;
       }
-      mOutImageType = FW_SET_ADDRESS_IMAGE;
+      OutImageType = FW_SET_ADDRESS_IMAGE;
       NewBaseAddress = (UINT64) Temp64;
       argc -= 2;
       argv += 2;
@@ -1362,16 +1442,20 @@ Returns:
     }
 
     if ((stricmp (argv[0], "-v") == 0) || (stricmp (argv[0], "--verbose") == 0)) {
-      SetPrintLevel (VERBOSE_LOG_LEVEL);
-      VerboseMsg ("Verbose output Mode Set!");
+      if (!BatchMode) {
+        SetPrintLevel (VERBOSE_LOG_LEVEL);
+        VerboseMsg ("Verbose output Mode Set!");
+      }
       argc --;
       argv ++;
       continue;
     }
 
     if ((stricmp (argv[0], "-q") == 0) || (stricmp (argv[0], "--quiet") == 0)) {
-      SetPrintLevel (KEY_LOG_LEVEL);
-      KeyMsg ("Quiet output Mode Set!");
+      if (!BatchMode) {
+        SetPrintLevel (KEY_LOG_LEVEL);
+        KeyMsg ("Quiet output Mode Set!");
+      }
       argc --;
       argv ++;
       continue;
@@ -1387,8 +1471,10 @@ Returns:
         Error (NULL, 0, 1003, "Invalid option value", "Debug Level range is 0-9, currnt input level is %d", (int) LogLevel);
         goto Finish;
       }
-      SetPrintLevel (LogLevel);
-      DebugMsg (NULL, 0, 9, "Debug Mode Set", "Debug Output Mode Level %s is set!", argv[1]);
+      if (!BatchMode) {
+        SetPrintLevel (LogLevel);
+        DebugMsg (NULL, 0, 9, "Debug Mode Set", "Debug Output Mode Level %s is set!", argv[1]);
+      }
       argc -= 2;
       argv += 2;
       continue;
@@ -1406,14 +1492,14 @@ Returns:
     }
 
     if (stricmp (argv[0], "--hiipackage") == 0) {
-      mOutImageType = FW_HII_PACKAGE_LIST_RCIMAGE;
+      OutImageType = FW_HII_PACKAGE_LIST_RCIMAGE;
       argc --;
       argv ++;
       continue;
     }
 
     if (stricmp (argv[0], "--hiibinpackage") == 0) {
-      mOutImageType = FW_HII_PACKAGE_LIST_BINIMAGE;
+      OutImageType = FW_HII_PACKAGE_LIST_BINIMAGE;
       argc --;
       argv ++;
       continue;
@@ -1456,9 +1542,11 @@ Returns:
     argv ++;
   }
 
-  VerboseMsg ("%s tool start.", UTILITY_NAME);
+  if (!BatchMode) {
+    VerboseMsg ("%s tool start.", UTILITY_NAME);
+  }
 
-  if (mOutImageType == FW_DUMMY_IMAGE) {
+  if (OutImageType == FW_DUMMY_IMAGE) {
     Error (NULL, 0, 1001, "Missing option", "No create file action specified; pls specify -e, -c or -t option to create efi image, or acpi table or TeImage!");
     if (ReplaceFlag) {
       Error (NULL, 0, 1001, "Missing option", "-r option is not supported as the independent option. It can be used together with other create file option specified at the above.");
@@ -1477,7 +1565,7 @@ Returns:
   //
   // Combine MciBinary files to one file
   //
-  if ((mOutImageType == FW_MERGE_IMAGE) && ReplaceFlag) {
+  if ((OutImageType == FW_MERGE_IMAGE) && ReplaceFlag) {
     Error (NULL, 0, 1002, "Conflicting option", "-r replace option cannot be used with -j merge files option.");
     goto Finish;
   }
@@ -1485,12 +1573,12 @@ Returns:
   //
   // Combine HiiBinary packages to a single package list
   //
-  if ((mOutImageType == FW_HII_PACKAGE_LIST_RCIMAGE) && ReplaceFlag) {
+  if ((OutImageType == FW_HII_PACKAGE_LIST_RCIMAGE) && ReplaceFlag) {
     Error (NULL, 0, 1002, "Conflicting option", "-r replace option cannot be used with --hiipackage merge files option.");
     goto Finish;
   }
 
-  if ((mOutImageType == FW_HII_PACKAGE_LIST_BINIMAGE) && ReplaceFlag) {
+  if ((OutImageType == FW_HII_PACKAGE_LIST_BINIMAGE) && ReplaceFlag) {
     Error (NULL, 0, 1002, "Conflicting option", "-r replace option cannot be used with --hiibinpackage merge files option.");
     goto Finish;
   }
@@ -1498,13 +1586,13 @@ Returns:
   //
   // Input image file
   //
-  mInImageName = InputFileName [InputFileNum - 1];
-  VerboseMsg ("the input file name is %s", mInImageName);
+  InImageName = InputFileName [InputFileNum - 1];
+  VerboseMsg ("the input file name is %s", InImageName);
 
   //
   // Action will be taken for the input file.
   //
-  switch (mOutImageType) {
+  switch (OutImageType) {
   case FW_EFI_IMAGE:
     VerboseMsg ("Create efi image on module type %s based on the input PE image.", ModuleType);
     break;
@@ -1555,69 +1643,29 @@ Returns:
     VerboseMsg ("Overwrite the input file with the output content.");
   }
 
-  //
-  // Open output file and Write image into the output file.
-  //
   if (OutImageName != NULL) {
-    fpOut = fopen (OutImageName, "rb");
-    if (fpOut != NULL) {
-      //
-      // Get Output file time stamp
-      //
-      fstat(fileno (fpOut), &Stat_Buf);
-      OutputFileTime = Stat_Buf.st_mtime;
-      //
-      // Get Output file data
-      //
-      OutputFileLength = _filelength (fileno (fpOut));
-      OutputFileBuffer = malloc (OutputFileLength);
-      if (OutputFileBuffer == NULL) {
-        Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
-        fclose (fpOut);
-        fpOut = NULL;
-        goto Finish;
-      }
-      fread (OutputFileBuffer, 1, OutputFileLength, fpOut);
-      fclose (fpOut);
-      fpOut = NULL;
-    }
     VerboseMsg ("Output file name is %s", OutImageName);
-  } else if (!ReplaceFlag && mOutImageType != DUMP_TE_HEADER) {
+  } else if (!ReplaceFlag && OutImageType != DUMP_TE_HEADER) {
     Error (NULL, 0, 1001, "Missing option", "output file");
     goto Finish;
   }
 
   //
-  // Open input file and read file data into file buffer.
+  // Map the input file. Its view is private, so nothing written through
+  // it reaches the file.
   //
-  fpIn = fopen (mInImageName, "rb");
-  if (fpIn == NULL) {
-    Error (NULL, 0, 0001, "Error opening file", mInImageName);
+  if (EFI_ERROR (OpenMappedFile (InImageName, &InputFile))) {
+    Error (NULL, 0, 0001, "Error opening file", InImageName);
     goto Finish;
   }
-  //
-  // Get Iutput file time stamp
-  //
-  fstat(fileno (fpIn), &Stat_Buf);
-  InputFileTime = Stat_Buf.st_mtime;
-  //
-  // Get Input file data
-  //
-  InputFileLength = _filelength (fileno (fpIn));
-  InputFileBuffer = malloc (InputFileLength);
-  if (InputFileBuffer == NULL) {
-    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
-    fclose (fpIn);
-    goto Finish;
-  }
-  fread (InputFileBuffer, 1, InputFileLength, fpIn);
-  fclose (fpIn);
+  InputFileBuffer = InputFile.Data;
+  InputFileLength = (UINT32) InputFile.Size;
   DebugMsg (NULL, 0, 9, "input file info", "the input file size is %u bytes", (unsigned) InputFileLength);
 
   //
   // Combine multi binary HII package files.
   //
-  if (mOutImageType == FW_HII_PACKAGE_LIST_RCIMAGE || mOutImageType == FW_HII_PACKAGE_LIST_BINIMAGE) {
+  if (OutImageType == FW_HII_PACKAGE_LIST_RCIMAGE || OutImageType == FW_HII_PACKAGE_LIST_BINIMAGE) {
     //
     // Open output file handle.
     //
@@ -1694,7 +1742,7 @@ Returns:
     //
     // write the hii package into the binary package list file with the resource section header
     //
-    if (mOutImageType == FW_HII_PACKAGE_LIST_BINIMAGE) {
+    if (OutImageType == FW_HII_PACKAGE_LIST_BINIMAGE) {
       //
       // Create the resource section header
       //
@@ -1712,13 +1760,14 @@ Returns:
       //
       // Done successfully
       //
+      CommandStatus = STATUS_SUCCESS;
       goto Finish;
     }
 
     //
     // write the hii package into the text package list rc file.
     //
-    if (mOutImageType == FW_HII_PACKAGE_LIST_RCIMAGE) {
+    if (OutImageType == FW_HII_PACKAGE_LIST_RCIMAGE) {
       for (Index = 0; gHiiPackageRCFileHeader[Index] != NULL; Index++) {
         fprintf (fpOut, "%s\n", gHiiPackageRCFileHeader[Index]);
       }
@@ -1746,6 +1795,7 @@ Returns:
       //
       // Done successfully
       //
+      CommandStatus = STATUS_SUCCESS;
       goto Finish;
     }
   }
@@ -1753,7 +1803,7 @@ Returns:
   //
   // Combine MciBinary files to one file
   //
-  if (mOutImageType == FW_MERGE_IMAGE) {
+  if (OutImageType == FW_MERGE_IMAGE) {
     //
     // Open output file handle.
     //
@@ -1798,16 +1848,17 @@ Returns:
     //
     // Done successfully
     //
+    CommandStatus = STATUS_SUCCESS;
     goto Finish;
   }
 
   //
   // Convert MicroCode.txt file to MicroCode.bin file
   //
-  if (mOutImageType == FW_MCI_IMAGE) {
-    fpIn = fopen (mInImageName, "r");
+  if (OutImageType == FW_MCI_IMAGE) {
+    fpIn = fopen (InImageName, "r");
     if (fpIn == NULL) {
-      Error (NULL, 0, 0001, "Error opening file", mInImageName);
+      Error (NULL, 0, 0001, "Error opening file", InImageName);
       goto Finish;
     }
 
@@ -1829,11 +1880,11 @@ Returns:
     // Error if no data.
     //
     if (FileLength == 0) {
-      Error (NULL, 0, 3000, "Invalid", "no parseable data found in file %s", mInImageName);
+      Error (NULL, 0, 3000, "Invalid", "no parseable data found in file %s", InImageName);
       goto Finish;
     }
     if (FileLength < sizeof (MICROCODE_IMAGE_HEADER)) {
-      Error (NULL, 0, 3000, "Invalid", "amount of parseable data in %s is insufficient to contain a microcode header", mInImageName);
+      Error (NULL, 0, 3000, "Invalid", "amount of parseable data in %s is insufficient to contain a microcode header", InImageName);
       goto Finish;
     }
 
@@ -1878,7 +1929,7 @@ Returns:
     }
 
     if (Index != FileLength) {
-      Error (NULL, 0, 3000, "Invalid", "file length of %s (0x%x) does not equal expected TotalSize: 0x%04X.", mInImageName, (unsigned) FileLength, (unsigned) Index);
+      Error (NULL, 0, 3000, "Invalid", "file length of %s (0x%x) does not equal expected TotalSize: 0x%04X.", InImageName, (unsigned) FileLength, (unsigned) Index);
       goto Finish;
     }
 
@@ -1894,7 +1945,7 @@ Returns:
       Index       += sizeof (*DataPointer);
     }
     if (CheckSum != 0) {
-      Error (NULL, 0, 3000, "Invalid", "checksum (0x%x) failed on file %s.", (unsigned) CheckSum, mInImageName);
+      Error (NULL, 0, 3000, "Invalid", "checksum (0x%x) failed on file %s.", (unsigned) CheckSum, InImageName);
       goto Finish;
     }
     //
@@ -1905,32 +1956,35 @@ Returns:
   }
 
   //
-  // Open input file and read file data into file buffer.
+  // An ELF image is converted straight from the mapped input file below.
+  // Other images are edited in place, so they get a copy of the input.
   //
   FileLength = InputFileLength;
-  FileBuffer = malloc (FileLength);
-  if (FileBuffer == NULL) {
-    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
-    goto Finish;
+  if (OutImageType == DUMP_TE_HEADER || !IsElfHeader (InputFileBuffer)) {
+    FileBuffer = malloc (FileLength);
+    if (FileBuffer == NULL) {
+      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+      goto Finish;
+    }
+    memcpy (FileBuffer, InputFileBuffer, InputFileLength);
   }
-  memcpy (FileBuffer, InputFileBuffer, InputFileLength);
 
   //
   // Dump TeImage Header into output file.
   //
-  if (mOutImageType == DUMP_TE_HEADER) {
+  if (OutImageType == DUMP_TE_HEADER) {
     memcpy (&TEImageHeader, FileBuffer, sizeof (TEImageHeader));
     if (TEImageHeader.Signature != EFI_TE_IMAGE_HEADER_SIGNATURE) {
-      Error (NULL, 0, 3000, "Invalid", "TE header signature of file %s is not correct.", mInImageName);
+      Error (NULL, 0, 3000, "Invalid", "TE header signature of file %s is not correct.", InImageName);
       goto Finish;
     }
     //
     // Open the output file handle.
     //
     if (ReplaceFlag) {
-      fpInOut = fopen (mInImageName, "wb");
+      fpInOut = fopen (InImageName, "wb");
       if (fpInOut == NULL) {
-        Error (NULL, 0, 0001, "Error opening file", mInImageName);
+        Error (NULL, 0, 0001, "Error opening file", InImageName);
         goto Finish;
       }
     } else {
@@ -1945,7 +1999,7 @@ Returns:
       }
     }
     if (fpInOut != NULL) {
-      fprintf (fpInOut, "Dump of file %s\n\n", mInImageName);
+      fprintf (fpInOut, "Dump of file %s\n\n", InImageName);
       fprintf (fpInOut, "TE IMAGE HEADER VALUES\n");
       fprintf (fpInOut, "%17X machine\n", TEImageHeader.Machine);
       fprintf (fpInOut, "%17X number of sections\n", TEImageHeader.NumberOfSections);
@@ -1958,7 +2012,7 @@ Returns:
       fprintf (fpInOut, "%17X [%8X] RVA [size] of Debug Directory\n", (unsigned) TEImageHeader.DataDirectory[1].VirtualAddress, (unsigned) TEImageHeader.DataDirectory[1].Size);
     }
     if (fpOut != NULL) {
-      fprintf (fpOut, "Dump of file %s\n\n", mInImageName);
+      fprintf (fpOut, "Dump of file %s\n\n", InImageName);
       fprintf (fpOut, "TE IMAGE HEADER VALUES\n");
       fprintf (fpOut, "%17X machine\n", TEImageHeader.Machine);
       fprintf (fpOut, "%17X number of sections\n", TEImageHeader.NumberOfSections);
@@ -1970,6 +2024,7 @@ Returns:
       fprintf (fpOut, "%17X [%8X] RVA [size] of Base Relocation Directory\n", (unsigned) TEImageHeader.DataDirectory[0].VirtualAddress, (unsigned) TEImageHeader.DataDirectory[0].Size);
       fprintf (fpOut, "%17X [%8X] RVA [size] of Debug Directory\n", (unsigned) TEImageHeader.DataDirectory[1].VirtualAddress, (unsigned) TEImageHeader.DataDirectory[1].Size);
     }
+    CommandStatus = STATUS_SUCCESS;
     goto Finish;
   }
 
@@ -1977,12 +2032,12 @@ Returns:
   // Following code to convert dll to efi image or te image.
   // Get new image type
   //
-  if ((mOutImageType == FW_EFI_IMAGE) || (mOutImageType == FW_TE_IMAGE)) {
+  if ((OutImageType == FW_EFI_IMAGE) || (OutImageType == FW_TE_IMAGE)) {
     if (ModuleType == NULL) {
-      if (mOutImageType == FW_EFI_IMAGE) {
+      if (OutImageType == FW_EFI_IMAGE) {
         Error (NULL, 0, 1001, "Missing option", "EFI_FILETYPE");
         goto Finish;
-      } else if (mOutImageType == FW_TE_IMAGE) {
+      } else if (OutImageType == FW_TE_IMAGE) {
         //
         // Default TE Image Type is Boot service driver
         //
@@ -2032,10 +2087,10 @@ Returns:
   //
   // Convert ELF image to PeImage
   //
-  if (IsElfHeader(FileBuffer)) {
-    VerboseMsg ("Convert %s from ELF to PE/COFF.", mInImageName);
-    if (!ConvertElf(&FileBuffer, &FileLength)) {
-      Error (NULL, 0, 3000, "Invalid", "Unable to convert %s from ELF to PE/COFF.", mInImageName);
+  if (FileBuffer == NULL) {
+    VerboseMsg ("Convert %s from ELF to PE/COFF.", InImageName);
+    if (!ConvertElf (InImageName, OutImageType, InputFileBuffer, &FileBuffer, &FileLength, &ImageTimeStamp)) {
+      Error (NULL, 0, 3000, "Invalid", "Unable to convert %s from ELF to PE/COFF.", InImageName);
       goto Finish;
     }
   }
@@ -2049,7 +2104,7 @@ Returns:
   //
   // Remove reloc section from PE or TE image
   //
-  if (mOutImageType == FW_RELOC_STRIPEED_IMAGE) {
+  if (OutImageType == FW_RELOC_STRIPEED_IMAGE) {
     //
     // Check TeImage
     //
@@ -2083,14 +2138,14 @@ Returns:
       if (DosHdr->e_magic != EFI_IMAGE_DOS_SIGNATURE) {
         PeHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)(FileBuffer);
         if (PeHdr->Pe32.Signature != EFI_IMAGE_NT_SIGNATURE) {
-          Error (NULL, 0, 3000, "Invalid", "TE and DOS header signatures were not found in %s image.", mInImageName);
+          Error (NULL, 0, 3000, "Invalid", "TE and DOS header signatures were not found in %s image.", InImageName);
           goto Finish;
         }
         DosHdr = NULL;
       } else {
         PeHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)(FileBuffer + DosHdr->e_lfanew);
         if (PeHdr->Pe32.Signature != EFI_IMAGE_NT_SIGNATURE) {
-          Error (NULL, 0, 3000, "Invalid", "PE header signature was not found in %s image.", mInImageName);
+          Error (NULL, 0, 3000, "Invalid", "PE header signature was not found in %s image.", InImageName);
           goto Finish;
         }
       }
@@ -2145,7 +2200,7 @@ Returns:
     // NO DOS header, check for PE/COFF header
     PeHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)(FileBuffer);
     if (PeHdr->Pe32.Signature != EFI_IMAGE_NT_SIGNATURE) {
-      Error (NULL, 0, 3000, "Invalid", "DOS header signature was not found in %s image.", mInImageName);
+      Error (NULL, 0, 3000, "Invalid", "DOS header signature was not found in %s image.", InImageName);
       goto Finish;
     }
     DosHdr = NULL;
@@ -2153,7 +2208,7 @@ Returns:
 
     PeHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *)(FileBuffer + DosHdr->e_lfanew);
     if (PeHdr->Pe32.Signature != EFI_IMAGE_NT_SIGNATURE) {
-      Error (NULL, 0, 3000, "Invalid", "PE header signature was not found in %s image.", mInImageName);
+      Error (NULL, 0, 3000, "Invalid", "PE header signature was not found in %s image.", InImageName);
       goto Finish;
     }
   }
@@ -2167,7 +2222,7 @@ Returns:
   //
   // Set new base address into image
   //
-  if (mOutImageType == FW_REBASE_IMAGE || mOutImageType == FW_SET_ADDRESS_IMAGE) {
+  if (OutImageType == FW_REBASE_IMAGE || OutImageType == FW_SET_ADDRESS_IMAGE) {
     if ((PeHdr->Pe32.OptionalHeader.Magic == EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC) && (PeHdr->Pe32.FileHeader.Machine != IMAGE_FILE_MACHINE_IA64)) {
       if (NewBaseAddress >= 0x100000000ULL) {
         Error (NULL, 0, 3000, "Invalid", "New base address is larger than 4G for 32bit PE image");
@@ -2181,16 +2236,16 @@ Returns:
       //
       NewBaseAddress = (UINT64) (0 - NewBaseAddress);
     }
-    if (mOutImageType == FW_REBASE_IMAGE) {
-      Status = RebaseImage (mInImageName, FileBuffer, NewBaseAddress);
+    if (OutImageType == FW_REBASE_IMAGE) {
+      Status = RebaseImage (InImageName, FileBuffer, NewBaseAddress);
     } else {
-      Status = SetAddressToSectionHeader (mInImageName, FileBuffer, NewBaseAddress);
+      Status = SetAddressToSectionHeader (InImageName, FileBuffer, NewBaseAddress);
     }
     if (EFI_ERROR (Status)) {
       if (NegativeAddr) {
-        Error (NULL, 0, 3000, "Invalid", "Rebase/Set Image %s to Base address -0x%llx can't success", mInImageName, 0 - NewBaseAddress);
+        Error (NULL, 0, 3000, "Invalid", "Rebase/Set Image %s to Base address -0x%llx can't success", InImageName, 0 - NewBaseAddress);
       } else {
-        Error (NULL, 0, 3000, "Invalid", "Rebase/Set Image %s to Base address 0x%llx can't success", mInImageName, NewBaseAddress);
+        Error (NULL, 0, 3000, "Invalid", "Rebase/Set Image %s to Base address 0x%llx can't success", InImageName, NewBaseAddress);
       }
       goto Finish;
     }
@@ -2204,9 +2259,9 @@ Returns:
   //
   // Extract bin data from Pe image.
   //
-  if (mOutImageType == FW_BIN_IMAGE) {
+  if (OutImageType == FW_BIN_IMAGE) {
     if (FileLength < PeHdr->Pe32.OptionalHeader.SizeOfHeaders) {
-      Error (NULL, 0, 3000, "Invalid", "FileSize of %s is not a legal size.", mInImageName);
+      Error (NULL, 0, 3000, "Invalid", "FileSize of %s is not a legal size.", InImageName);
       goto Finish;
     }
     //
@@ -2221,8 +2276,8 @@ Returns:
   //
   // Zero Debug Information of Pe Image
   //
-  if (mOutImageType == FW_ZERO_DEBUG_IMAGE) {
-    Status = ZeroDebugData (FileBuffer, TRUE);
+  if (OutImageType == FW_ZERO_DEBUG_IMAGE) {
+    Status = ZeroDebugData (FileBuffer, TRUE, &ImageTimeStamp);
     if (EFI_ERROR (Status)) {
       Error (NULL, 0, 3000, "Invalid", "Zero DebugData Error status is 0x%x", (int) Status);
       goto Finish;
@@ -2238,8 +2293,8 @@ Returns:
   //
   // Set Time Stamp of Pe Image
   //
-  if (mOutImageType == FW_SET_STAMP_IMAGE) {
-    Status = SetStamp (FileBuffer, TimeStamp);
+  if (OutImageType == FW_SET_STAMP_IMAGE) {
+    Status = SetStamp (FileBuffer, TimeStamp, &ImageTimeStamp);
     if (EFI_ERROR (Status)) {
       goto Finish;
     }
@@ -2254,7 +2309,7 @@ Returns:
   //
   // Extract acpi data from pe image.
   //
-  if (mOutImageType == FW_ACPI_IMAGE) {
+  if (OutImageType == FW_ACPI_IMAGE) {
     SectionHeader = (EFI_IMAGE_SECTION_HEADER *) ((UINT8 *) &(PeHdr->Pe32.OptionalHeader) + PeHdr->Pe32.FileHeader.SizeOfOptionalHeader);
     for (Index = 0; Index < PeHdr->Pe32.FileHeader.NumberOfSections; Index ++, SectionHeader ++) {
       if (strcmp ((char *)SectionHeader->Name, ".data") == 0 || strcmp ((char *)SectionHeader->Name, ".sdata") == 0) {
@@ -2268,7 +2323,7 @@ Returns:
         }
 
         if (CheckAcpiTable (FileBuffer + SectionHeader->PointerToRawData, FileLength) != STATUS_SUCCESS) {
-          Error (NULL, 0, 3000, "Invalid", "ACPI table check failed in %s.", mInImageName);
+          Error (NULL, 0, 3000, "Invalid", "ACPI table check failed in %s.", InImageName);
           goto Finish;
         }
 
@@ -2280,7 +2335,7 @@ Returns:
         goto WriteFile;
       }
     }
-    Error (NULL, 0, 3000, "Invalid", "failed to get ACPI table from %s.", mInImageName);
+    Error (NULL, 0, 3000, "Invalid", "failed to get ACPI table from %s.", InImageName);
     goto Finish;
   }
   //
@@ -2512,7 +2567,7 @@ Returns:
       }
     }
   } else {
-    Error (NULL, 0, 3000, "Invalid", "Magic 0x%x of PeImage %s is unknown.", PeHdr->Pe32.OptionalHeader.Magic, mInImageName);
+    Error (NULL, 0, 3000, "Invalid", "Magic 0x%x of PeImage %s is unknown.", PeHdr->Pe32.OptionalHeader.Magic, InImageName);
     goto Finish;
   }
 
@@ -2580,14 +2635,14 @@ Returns:
   //
   // Zero Time/Data field
   //
-  ZeroDebugData (FileBuffer, FALSE);
+  ZeroDebugData (FileBuffer, FALSE, &ImageTimeStamp);
 
-  if (mOutImageType == FW_TE_IMAGE) {
+  if (OutImageType == FW_TE_IMAGE) {
     if ((PeHdr->Pe32.FileHeader.NumberOfSections &~0xFF) || (Type &~0xFF)) {
       //
       // Pack the subsystem and NumberOfSections into 1 byte. Make sure they fit both.
       //
-      Error (NULL, 0, 3000, "Invalid", "Image's subsystem or NumberOfSections of PeImage %s cannot be packed into 1 byte.", mInImageName);
+      Error (NULL, 0, 3000, "Invalid", "Image's subsystem or NumberOfSections of PeImage %s cannot be packed into 1 byte.", InImageName);
       goto Finish;
     }
 
@@ -2595,7 +2650,7 @@ Returns:
       //
       // TeImage has the same section alignment and file alignment.
       //
-      Error (NULL, 0, 3000, "Invalid", "Section-Alignment and File-Alignment of PeImage %s do not match, they must be equal for a TeImage.", mInImageName);
+      Error (NULL, 0, 3000, "Invalid", "Section-Alignment and File-Alignment of PeImage %s do not match, they must be equal for a TeImage.", InImageName);
       goto Finish;
     }
 
@@ -2634,44 +2689,65 @@ Returns:
 
 WriteFile:
   //
-  // Update Image to EfiImage or TE image
+  // Update Image to EfiImage or TE image. A single command that already
+  // reported an error keeps the file it would have overwritten.
+  //
+  if (!BatchMode && GetUtilityStatus () != STATUS_SUCCESS) {
+    goto Finish;
+  }
+  //
+  // The file is only written when its contents change, so an unchanged
+  // image keeps its time stamp and the files built from it stay up to date.
   //
   if (ReplaceFlag) {
-    if ((FileLength != InputFileLength) || (memcmp (FileBuffer, InputFileBuffer, FileLength) != 0)) {
-      //
-      // Update File when File is changed.
-      //
-      fpInOut = fopen (mInImageName, "wb");
-      if (fpInOut == NULL) {
-        Error (NULL, 0, 0001, "Error opening file", mInImageName);
+    ImageChanged = (BOOLEAN) ((FileLength != InputFileLength) || (memcmp (FileBuffer, InputFileBuffer, FileLength) != 0));
+    //
+    // Release the input view before the file is replaced.
+    //
+    CloseMappedFile (&InputFile, FALSE);
+    InputFileBuffer = NULL;
+    if (ImageChanged) {
+      if (EFI_ERROR (WriteImageFile (InImageName, FileBuffer, FileLength))) {
+        Error (NULL, 0, 0002, "Error writing file", InImageName);
         goto Finish;
       }
-      fwrite (FileBuffer, 1, FileLength, fpInOut);
       VerboseMsg ("the size of output file is %u bytes", (unsigned) FileLength);
     }
   } else {
-    if ((OutputFileTime < InputFileTime) || (FileLength != OutputFileLength) || (memcmp (FileBuffer, OutputFileBuffer, FileLength) != 0)) {
-      //
-      // Update File when File is changed or File is old.
-      //
-      fpOut = fopen (OutImageName, "wb");
-      if (fpOut == NULL) {
-        Error (NULL, 0, 0001, "Error opening output file", OutImageName);
+    ImageChanged = TRUE;
+    if (!EFI_ERROR (OpenMappedFile (OutImageName, &OutputFile))) {
+      ImageChanged = (BOOLEAN) ((FileLength != OutputFile.Size) || (memcmp (FileBuffer, OutputFile.Data, FileLength) != 0));
+      CloseMappedFile (&OutputFile, FALSE);
+    }
+    if (ImageChanged) {
+      if (EFI_ERROR (WriteImageFile (OutImageName, FileBuffer, FileLength))) {
+        Error (NULL, 0, 0002, "Error writing file", OutImageName);
         goto Finish;
       }
-      fwrite (FileBuffer, 1, FileLength, fpOut);
       VerboseMsg ("the size of output file is %u bytes", (unsigned) FileLength);
     }
   }
-  mImageSize = FileLength;
+  ImageSize = FileLength;
+  CommandStatus = STATUS_SUCCESS;
 
 Finish:
+  if (!BatchMode && GetUtilityStatus () != STATUS_SUCCESS) {
+    //
+    // A single command also fails on errors and warnings reported by
+    // the helper functions. In a batch the status of the utility is
+    // shared by all the commands.
+    //
+    CommandStatus = STATUS_ERROR;
+  }
+
   if (fpInOut != NULL) {
-    if (GetUtilityStatus () != STATUS_SUCCESS) {
+    if (CommandStatus != STATUS_SUCCESS) {
       //
-      // when file updates failed, original file is still recovered.
+      // when file updates failed, original file is still recovered. The
+      // input file was truncated under its view, but FileBuffer still
+      // holds a copy of it.
       //
-      fwrite (InputFileBuffer, 1, InputFileLength, fpInOut);
+      fwrite (FileBuffer, 1, FileLength, fpInOut);
     }
     //
     // Write converted data into fpInOut file and close input file.
@@ -2687,29 +2763,17 @@ Finish:
     free (InputFileName);
   }
 
-  if (fpOut != NULL) {
+  if (fpOut != NULL && fpOut != stdout) {
     //
     // Write converted data into fpOut file and close output file.
     //
     fclose (fpOut);
-    if (GetUtilityStatus () != STATUS_SUCCESS) {
-      if (OutputFileBuffer == NULL) {
-        remove (OutImageName);
-      } else {
-        fpOut = fopen (OutImageName, "wb");
-        fwrite (OutputFileBuffer, 1, OutputFileLength, fpOut);
-        fclose (fpOut);
-      }
+    if (CommandStatus != STATUS_SUCCESS) {
+      remove (OutImageName);
     }
   }
-  
-  if (InputFileBuffer != NULL) {
-    free (InputFileBuffer);
-  }
 
-  if (OutputFileBuffer != NULL) {
-    free (OutputFileBuffer);
-  }
+  CloseMappedFile (&InputFile, FALSE);
 
   //
   // Write module size and time stamp to report file.
@@ -2724,13 +2788,759 @@ Finish:
       strcpy (ReportFileName + (FileLen - 4), ".txt"); 
       ReportFile = fopen (ReportFileName, "w+");
       if (ReportFile != NULL) {
-        fprintf (ReportFile, "MODULE_SIZE = %u\n", (unsigned) mImageSize);
-        fprintf (ReportFile, "TIME_STAMP = %u\n", (unsigned) mImageTimeStamp);
+        fprintf (ReportFile, "MODULE_SIZE = %u\n", (unsigned) ImageSize);
+        fprintf (ReportFile, "TIME_STAMP = %u\n", (unsigned) ImageTimeStamp);
         fclose(ReportFile);
       }
       free (ReportFileName);
     }
   }
+
+  return CommandStatus;
+}
+
+STATIC
+UINT32
+SplitCommandLine (
+  IN OUT CHAR8  *Line,
+  OUT    CHAR8  **Argv,
+  IN     UINT32 MaxArgc
+  )
+/*++
+
+Routine Description:
+
+  Split a manifest line into arguments in place. Arguments are separated
+  by white space, and double quotes group an argument containing spaces.
+
+Arguments:
+
+  Line        - The line, which is modified
+  Argv        - Receives the arguments, followed by a NULL entry
+  MaxArgc     - Size of Argv, including the NULL entry
+
+Returns:
+
+  The number of arguments, or MaxArgc if there are too many.
+
+--*/
+{
+  UINT32  Argc;
+  CHAR8   *Src;
+  CHAR8   *Dst;
+  BOOLEAN Quoted;
+
+  Argc = 0;
+  Src  = Line;
+  for (;;) {
+    while (*Src != '\0' && isspace ((int) *Src)) {
+      Src++;
+    }
+    if (*Src == '\0') {
+      break;
+    }
+    if (Argc + 1 >= MaxArgc) {
+      return MaxArgc;
+    }
+
+    Argv[Argc++] = Src;
+    Dst    = Src;
+    Quoted = FALSE;
+    while (*Src != '\0' && (Quoted || !isspace ((int) *Src))) {
+      if (*Src == '"') {
+        Quoted = (BOOLEAN) !Quoted;
+      } else {
+        *Dst++ = *Src;
+      }
+      Src++;
+    }
+    if (*Src != '\0') {
+      Src++;
+    }
+    *Dst = '\0';
+  }
+
+  Argv[Argc] = NULL;
+  return Argc;
+}
+
+STATIC
+VOID
+ScanCommandFiles (
+  IN OUT BATCH_COMMAND  *Command
+  )
+/*++
+
+Routine Description:
+
+  Find the files read and written by a command, without checking its
+  options. RunCommand reports the invalid options when the command runs.
+
+Arguments:
+
+  Command     - The command, with Argc and Argv set
+
+Returns:
+
+  None
+
+--*/
+{
+  UINT32  Index;
+  UINT32  Option;
+  BOOLEAN ReplaceFlag;
+  BOOLEAN HasValue;
+
+  ReplaceFlag = FALSE;
+  for (Index = 0; Index < Command->Argc; Index++) {
+    HasValue = FALSE;
+    for (Option = 0; mValueOptionName[Option] != NULL; Option++) {
+      if (stricmp (Command->Argv[Index], mValueOptionName[Option]) == 0) {
+        HasValue = TRUE;
+        break;
+      }
+    }
+    if (HasValue) {
+      if ((stricmp (Command->Argv[Index], "-o") == 0) || (stricmp (Command->Argv[Index], "--outputfile") == 0)) {
+        Command->OutputFileName = Command->Argv[Index + 1];
+      }
+      if (Command->Argv[Index + 1] != NULL) {
+        Index++;
+      }
+      continue;
+    }
+    if (Command->Argv[Index][0] == '-') {
+      if ((stricmp (Command->Argv[Index], "-r") == 0) || (stricmp (Command->Argv[Index], "--replace") == 0)) {
+        ReplaceFlag = TRUE;
+      }
+      continue;
+    }
+    Command->InputFileName[Command->InputNum++] = Command->Argv[Index];
+  }
+
+  //
+  // -r writes the image back to the last input file.
+  //
+  if (ReplaceFlag && Command->InputNum > 0) {
+    Command->OutputFileName = Command->InputFileName[Command->InputNum - 1];
+  }
+}
+
+STATIC
+EFI_STATUS
+ParseManifest (
+  IN  CHAR8          *ManifestFileName,
+  OUT CHAR8          **ManifestText,
+  OUT BATCH_COMMAND  **Commands,
+  OUT UINTN          *CommandCount
+  )
+/*++
+
+Routine Description:
+
+  Read the manifest and split all of its lines. Each line holds the
+  parameters of one GenFw command, optionally preceded by the utility
+  name. The commands point into ManifestText, which must be kept until
+  they are no longer used.
+
+Arguments:
+
+  ManifestFileName  - Name of the manifest
+  ManifestText      - Receives the manifest contents, released with free()
+  Commands          - Receives the commands, in manifest order
+  CommandCount      - Receives the number of commands
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_ABORTED             The manifest could not be read, or a line is not
+                          valid; errors were reported.
+  EFI_OUT_OF_RESOURCES
+
+--*/
+{
+  FILE          *File;
+  CHAR8         *Text;
+  CHAR8         *Line;
+  CHAR8         *End;
+  CHAR8         *Argv[1024];
+  CHAR8         *ToolName;
+  UINT32        Argc;
+  UINT32        FirstArg;
+  UINT32        LineNumber;
+  UINTN         Size;
+  UINTN         Count;
+  UINTN         Capacity;
+  BATCH_COMMAND *List;
+  BATCH_COMMAND *NewList;
+  BATCH_COMMAND *Command;
+  EFI_STATUS    Status;
+  BOOLEAN       Failed;
+
+  File = fopen (ManifestFileName, "rb");
+  if (File == NULL) {
+    Error (NULL, 0, 0001, "Error opening file", ManifestFileName);
+    return EFI_ABORTED;
+  }
+  fseek (File, 0, SEEK_END);
+  Size = ftell (File);
+  fseek (File, 0, SEEK_SET);
+  Text = (CHAR8 *) malloc (Size + 1);
+  if (Text == NULL) {
+    fclose (File);
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    return EFI_OUT_OF_RESOURCES;
+  }
+  if (Size != 0 && fread (Text, Size, 1, File) != 1) {
+    Error (NULL, 0, 0004, "Error reading file", ManifestFileName);
+    fclose (File);
+    free (Text);
+    return EFI_ABORTED;
+  }
+  fclose (File);
+  Text[Size] = '\0';
+
+  List       = NULL;
+  Count      = 0;
+  Capacity   = 0;
+  Failed     = FALSE;
+  LineNumber = 0;
+  for (Line = Text; *Line != '\0'; Line = End) {
+    LineNumber++;
+    End = strchr (Line, '\n');
+    if (End == NULL) {
+      End = Line + strlen (Line);
+    } else {
+      *End++ = '\0';
+    }
+
+    Argc = SplitCommandLine (Line, Argv, sizeof (Argv) / sizeof (Argv[0]));
+    if (Argc == 0 || Argv[0][0] == '#') {
+      continue;
+    }
+    if (Argc == sizeof (Argv) / sizeof (Argv[0])) {
+      Error (ManifestFileName, LineNumber, 2000, "Invalid parameter", "too many arguments");
+      Failed = TRUE;
+      continue;
+    }
+
+    //
+    // The utility name may be given with a path or an extension.
+    //
+    FirstArg = 0;
+    ToolName = Argv[0] + strlen (Argv[0]);
+    while (ToolName > Argv[0] && ToolName[-1] != '/' && ToolName[-1] != '\\') {
+      ToolName--;
+    }
+    if (strnicmp (ToolName, "GenFw", 5) == 0 && (ToolName[5] == '\0' || ToolName[5] == '.')) {
+      FirstArg = 1;
+    }
+    if (Argc == FirstArg) {
+      Error (ManifestFileName, LineNumber, 1001, "Missing options", "No input options.");
+      Failed = TRUE;
+      continue;
+    }
+
+    if (Count == Capacity) {
+      Capacity = (Capacity == 0) ? 256 : Capacity * 2;
+      NewList  = (BATCH_COMMAND *) realloc (List, Capacity * sizeof (BATCH_COMMAND));
+      if (NewList == NULL) {
+        Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+        Status = EFI_OUT_OF_RESOURCES;
+        goto Fail;
+      }
+      List = NewList;
+    }
+    Command = &List[Count++];
+    memset (Command, 0, sizeof (BATCH_COMMAND));
+    Command->Line          = LineNumber;
+    Command->Argc          = Argc - FirstArg;
+    Command->Argv          = (CHAR8 **) malloc ((Command->Argc + 1) * sizeof (CHAR8 *));
+    Command->InputFileName = (CHAR8 **) malloc ((Command->Argc + 1) * sizeof (CHAR8 *));
+    if (Command->Argv == NULL || Command->InputFileName == NULL) {
+      Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+      Status = EFI_OUT_OF_RESOURCES;
+      goto Fail;
+    }
+    memcpy (Command->Argv, Argv + FirstArg, (Command->Argc + 1) * sizeof (CHAR8 *));
+    ScanCommandFiles (Command);
+  }
+
+  if (!Failed) {
+    *ManifestText = Text;
+    *Commands     = List;
+    *CommandCount = Count;
+    return EFI_SUCCESS;
+  }
+  Status = EFI_ABORTED;
+
+Fail:
+  while (Count > 0) {
+    Count--;
+    free (List[Count].Argv);
+    free (List[Count].InputFileName);
+  }
+  free (List);
+  free (Text);
+  return Status;
+}
+
+STATIC
+BATCH_PATH *
+LookupPath (
+  IN BATCH_PATH  **Buckets,
+  IN UINTN       BucketCount,
+  IN CHAR8       *Name
+  )
+/*++
+
+Routine Description:
+
+  Find the entry of a file name, adding it if it is not known yet.
+
+Arguments:
+
+  Buckets     - The hash table
+  BucketCount - Size of the hash table, a power of two
+  Name        - The file name
+
+Returns:
+
+  The entry, or NULL if out of memory.
+
+--*/
+{
+  BATCH_PATH  *Path;
+  UINTN       Hash;
+  CHAR8       *Ptr;
+
+  Hash = 5381;
+  for (Ptr = Name; *Ptr != '\0'; Ptr++) {
+    Hash = Hash * 33 + (UINT8) *Ptr;
+  }
+  Hash &= BucketCount - 1;
+
+  for (Path = Buckets[Hash]; Path != NULL; Path = Path->Next) {
+    if (strcmp (Path->Name, Name) == 0) {
+      return Path;
+    }
+  }
+
+  Path = (BATCH_PATH *) calloc (1, sizeof (BATCH_PATH));
+  if (Path == NULL) {
+    return NULL;
+  }
+  Path->Name    = Name;
+  Path->Writer  = BATCH_NO_PRODUCER;
+  Path->Next    = Buckets[Hash];
+  Buckets[Hash] = Path;
+  return Path;
+}
+
+STATIC
+EFI_STATUS
+ScheduleCommands (
+  IN OUT BATCH_COMMAND  *Commands,
+  IN     UINTN          CommandCount,
+  OUT    UINTN          *StageCount
+  )
+/*++
+
+Routine Description:
+
+  Link each input to the earlier command writing it and split the
+  commands into stages. A command runs in a later stage than the writers
+  of its inputs, and than every earlier command reading or writing its
+  output, so the commands of one stage can run in any order. The result
+  is the same as running the lines one after the other.
+
+Arguments:
+
+  Commands      - The commands, in manifest order
+  CommandCount  - The number of commands
+  StageCount    - Receives the number of stages
+
+Returns:
+
+  EFI_SUCCESS
+  EFI_OUT_OF_RESOURCES
+
+--*/
+{
+  BATCH_PATH    **Buckets;
+  BATCH_PATH    *Path;
+  BATCH_PATH    *Next;
+  BATCH_COMMAND *Command;
+  UINTN         BucketCount;
+  UINTN         Index;
+  UINTN         Input;
+  UINTN         Stage;
+  EFI_STATUS    Status;
+
+  BucketCount = 64;
+  while (BucketCount < CommandCount * 4) {
+    BucketCount *= 2;
+  }
+  Buckets = (BATCH_PATH **) calloc (BucketCount, sizeof (BATCH_PATH *));
+  if (Buckets == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status      = EFI_SUCCESS;
+  *StageCount = 0;
+  for (Index = 0; Index < CommandCount && !EFI_ERROR (Status); Index++) {
+    Command = &Commands[Index];
+    Command->Producer = (UINTN *) malloc ((Command->InputNum + 1) * sizeof (UINTN));
+    if (Command->Producer == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+      break;
+    }
+
+    Stage = 0;
+    for (Input = 0; Input < Command->InputNum; Input++) {
+      Path = LookupPath (Buckets, BucketCount, Command->InputFileName[Input]);
+      if (Path == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        break;
+      }
+      Command->Producer[Input] = Path->Writer;
+      if (Path->Writer != BATCH_NO_PRODUCER && Stage <= Commands[Path->Writer].Stage) {
+        Stage = Commands[Path->Writer].Stage + 1;
+      }
+    }
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+    if (Command->OutputFileName != NULL) {
+      Path = LookupPath (Buckets, BucketCount, Command->OutputFileName);
+      if (Path == NULL) {
+        Status = EFI_OUT_OF_RESOURCES;
+        break;
+      }
+      if (Path->Used && Stage <= Path->LastStage) {
+        Stage = Path->LastStage + 1;
+      }
+    }
+    Command->Stage = Stage;
+    if (*StageCount <= Stage) {
+      *StageCount = Stage + 1;
+    }
+
+    //
+    // Record this command as a reader of its inputs and the writer of its
+    // output.
+    //
+    for (Input = 0; Input < Command->InputNum; Input++) {
+      Path = LookupPath (Buckets, BucketCount, Command->InputFileName[Input]);
+      if (!Path->Used || Path->LastStage < Stage) {
+        Path->LastStage = Stage;
+      }
+      Path->Used = TRUE;
+    }
+    if (Command->OutputFileName != NULL) {
+      Path = LookupPath (Buckets, BucketCount, Command->OutputFileName);
+      if (!Path->Used || Path->LastStage < Stage) {
+        Path->LastStage = Stage;
+      }
+      Path->Used   = TRUE;
+      Path->Writer = Index;
+    }
+  }
+
+  for (Index = 0; Index < BucketCount; Index++) {
+    for (Path = Buckets[Index]; Path != NULL; Path = Next) {
+      Next = Path->Next;
+      free (Path);
+    }
+  }
+  free (Buckets);
+  return Status;
+}
+
+STATIC
+VOID
+RunBatchCommand (
+  IN VOID   *Context,
+  IN UINTN  JobIndex
+  )
+/*++
+
+Routine Description:
+
+  WORKER_POOL_FUNCTION running one command of the current stage. The
+  writers of its inputs all ran in earlier stages.
+
+Arguments:
+
+  Context     - The BATCH_CONTEXT
+  JobIndex    - Index into the jobs of the current stage
+
+Returns:
+
+  None
+
+--*/
+{
+  BATCH_CONTEXT       *Batch;
+  BATCH_COMMAND       *Command;
+  UINT32              Index;
+
+  Batch   = (BATCH_CONTEXT *) Context;
+  Command = &Batch->Commands[Batch->Jobs[JobIndex]];
+
+  for (Index = 0; Index < Command->InputNum; Index++) {
+    if (Command->Producer[Index] != BATCH_NO_PRODUCER &&
+        EFI_ERROR (Batch->Commands[Command->Producer[Index]].Status)) {
+      Command->Status = EFI_NOT_STARTED;
+      return;
+    }
+  }
+
+  if (RunCommand ((int) Command->Argc, Command->Argv, TRUE) != STATUS_SUCCESS) {
+    Command->Status = EFI_ABORTED;
+  } else {
+    Command->Status = EFI_SUCCESS;
+  }
+}
+
+STATIC
+STATUS
+RunBatch (
+  IN int   argc,
+  IN char  *argv[]
+  )
+/*++
+
+Routine Description:
+
+  Run the commands of a batch manifest. Commands that do not depend on
+  each other run at the same time on a worker pool; the files written by
+  a command are read back from disk by the commands using them.
+
+Arguments:
+
+  argc - Number of parameters, without the utility name.
+  argv - Array of pointers to parameter strings.
+
+Returns:
+  STATUS_SUCCESS - All the commands completed successfully.
+  STATUS_ERROR   - Some error occurred during execution.
+
+--*/
+{
+  EFI_STATUS      Status;
+  CHAR8           *ManifestFileName;
+  CHAR8           *ManifestText;
+  BATCH_COMMAND   *Commands;
+  BATCH_COMMAND   *Command;
+  BATCH_CONTEXT   Batch;
+  UINTN           CommandCount;
+  UINTN           StageCount;
+  UINTN           *StageStart;
+  UINTN           Stage;
+  UINTN           Index;
+  UINTN           Job;
+  UINT64          LogLevel;
+  UINT64          TempNumber;
+  UINT32          ThreadCount;
+
+  ManifestFileName  = NULL;
+  ManifestText      = NULL;
+  Commands          = NULL;
+  CommandCount      = 0;
+  StageStart        = NULL;
+  ThreadCount       = 0;
+  Batch.Jobs        = NULL;
+
+  while (argc > 0) {
+    if (stricmp (argv[0], "--batch") == 0) {
+      if (argv[1] == NULL || argv[1][0] == '-') {
+        Error (NULL, 0, 1003, "Invalid option value", "Manifest file name is missing for --batch option");
+        return STATUS_ERROR;
+      }
+      ManifestFileName = argv[1];
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+
+    if (stricmp (argv[0], "--threads") == 0) {
+      Status = AsciiStringToUint64 (argv[1], FALSE, &TempNumber);
+      if (EFI_ERROR (Status) || TempNumber > 0xFFFFFFFF) {
+        Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
+        return STATUS_ERROR;
+      }
+      ThreadCount = (UINT32) TempNumber;
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+
+    if ((stricmp (argv[0], "-v") == 0) || (stricmp (argv[0], "--verbose") == 0)) {
+      SetPrintLevel (VERBOSE_LOG_LEVEL);
+      VerboseMsg ("Verbose output Mode Set!");
+      argc --;
+      argv ++;
+      continue;
+    }
+
+    if ((stricmp (argv[0], "-q") == 0) || (stricmp (argv[0], "--quiet") == 0)) {
+      SetPrintLevel (KEY_LOG_LEVEL);
+      KeyMsg ("Quiet output Mode Set!");
+      argc --;
+      argv ++;
+      continue;
+    }
+
+    if ((stricmp (argv[0], "-d") == 0) || (stricmp (argv[0], "--debug") == 0)) {
+      Status = AsciiStringToUint64 (argv[1], FALSE, &LogLevel);
+      if (EFI_ERROR (Status)) {
+        Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
+        return STATUS_ERROR;
+      }
+      if (LogLevel > 9) {
+        Error (NULL, 0, 1003, "Invalid option value", "Debug Level range is 0-9, currnt input level is %d", (int) LogLevel);
+        return STATUS_ERROR;
+      }
+      SetPrintLevel (LogLevel);
+      DebugMsg (NULL, 0, 9, "Debug Mode Set", "Debug Output Mode Level %s is set!", argv[1]);
+      argc -= 2;
+      argv += 2;
+      continue;
+    }
+
+    Error (NULL, 0, 1000, "Unknown option", "%s cannot be used with --batch", argv[0]);
+    return STATUS_ERROR;
+  }
+
+  VerboseMsg ("%s tool start.", UTILITY_NAME);
+  VerboseMsg ("Manifest file name is %s", ManifestFileName);
+
+  Status = ParseManifest (ManifestFileName, &ManifestText, &Commands, &CommandCount);
+  if (EFI_ERROR (Status)) {
+    goto Finish;
+  }
+
+  Status = ScheduleCommands (Commands, CommandCount, &StageCount);
+  if (EFI_ERROR (Status)) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    goto Finish;
+  }
+  VerboseMsg ("%u commands in %u stages", (unsigned) CommandCount, (unsigned) StageCount);
+
+  //
+  // Sort the commands by stage, keeping the manifest order within a stage.
+  //
+  StageStart = (UINTN *) calloc (StageCount + 1, sizeof (UINTN));
+  Batch.Jobs = (UINTN *) malloc ((CommandCount + 1) * sizeof (UINTN));
+  if (StageStart == NULL || Batch.Jobs == NULL) {
+    Error (NULL, 0, 4001, "Resource", "memory cannot be allocated!");
+    goto Finish;
+  }
+  for (Index = 0; Index < CommandCount; Index++) {
+    StageStart[Commands[Index].Stage + 1]++;
+  }
+  for (Stage = 0; Stage < StageCount; Stage++) {
+    StageStart[Stage + 1] += StageStart[Stage];
+  }
+  for (Index = 0; Index < CommandCount; Index++) {
+    Batch.Jobs[StageStart[Commands[Index].Stage]++] = Index;
+  }
+  for (Stage = StageCount; Stage > 0; Stage--) {
+    StageStart[Stage] = StageStart[Stage - 1];
+  }
+  StageStart[0] = 0;
+  Batch.Commands = Commands;
+
+  for (Stage = 0; Stage < StageCount; Stage++) {
+    Batch.Jobs += StageStart[Stage];
+    RunWorkerPool (StageStart[Stage + 1] - StageStart[Stage], ThreadCount, RunBatchCommand, &Batch);
+    Batch.Jobs -= StageStart[Stage];
+
+    //
+    // Report the failures in manifest order.
+    //
+    for (Job = StageStart[Stage]; Job < StageStart[Stage + 1]; Job++) {
+      Command = &Commands[Batch.Jobs[Job]];
+      if (Command->Status == EFI_NOT_STARTED) {
+        Error (ManifestFileName, Command->Line, 2000, "Command not run", "an input of the command could not be built");
+      } else if (EFI_ERROR (Command->Status)) {
+        Error (ManifestFileName, Command->Line, 2000, "Command failed", NULL);
+      }
+    }
+  }
+
+Finish:
+  for (Index = 0; Index < CommandCount; Index++) {
+    free (Commands[Index].Argv);
+    free (Commands[Index].InputFileName);
+    free (Commands[Index].Producer);
+  }
+  free (Commands);
+  free (ManifestText);
+  free (StageStart);
+  free (Batch.Jobs);
+
+  return GetUtilityStatus ();
+}
+
+int
+main (
+  int  argc,
+  char *argv[]
+  )
+/*++
+
+Routine Description:
+
+  Main function.
+
+Arguments:
+
+  argc - Number of command line parameters.
+  argv - Array of pointers to command line parameter strings.
+
+Returns:
+  STATUS_SUCCESS - Utility exits successfully.
+  STATUS_ERROR   - Some error occurred during execution.
+
+--*/
+{
+  int  Index;
+
+  SetUtilityName (UTILITY_NAME);
+
+  if (argc == 1) {
+    Error (NULL, 0, 1001, "Missing options", "No input options.");
+    Usage ();
+    return STATUS_ERROR;
+  }
+
+  argc --;
+  argv ++;
+
+  if ((stricmp (argv[0], "-h") == 0) || (stricmp (argv[0], "--help") == 0)) {
+    Version ();
+    Usage ();
+    return STATUS_SUCCESS;
+  }
+
+  if (stricmp (argv[0], "--version") == 0) {
+    Version ();
+    return STATUS_SUCCESS;
+  }
+
+  for (Index = 0; Index < argc; Index++) {
+    if (stricmp (argv[Index], "--batch") == 0) {
+      break;
+    }
+  }
+  if (Index < argc) {
+    RunBatch (argc, argv);
+  } else {
+    RunCommand (argc, argv, FALSE);
+  }
+
   VerboseMsg ("%s tool done with return code is 0x%x.", UTILITY_NAME, GetUtilityStatus ());
 
   return GetUtilityStatus ();
@@ -2740,7 +3550,8 @@ STATIC
 EFI_STATUS
 ZeroDebugData (
   IN OUT UINT8   *FileBuffer,
-  BOOLEAN        ZeroDebugFlag
+  BOOLEAN        ZeroDebugFlag,
+  OUT    UINT32  *ImageTimeStamp
   )
 /*++
 
@@ -2752,6 +3563,7 @@ Arguments:
 
   FileBuffer    - Pointer to PeImage.
   ZeroDebugFlag - TRUE to zero Debug information, FALSE to only zero time/stamp
+  ImageTimeStamp - Receives the time stamp now in the image, zero.
 
 Returns:
 
@@ -2865,7 +3677,7 @@ Returns:
   //Zero Debug Data and TimeStamp
   //
   FileHdr->TimeDateStamp = 0;
-  mImageTimeStamp = 0;
+  *ImageTimeStamp = 0;
   if (ExportDirectoryEntryFileOffset != 0) {
     NewTimeStamp  = (UINT32 *) (FileBuffer + ExportDirectoryEntryFileOffset + sizeof (UINT32));
     *NewTimeStamp = 0;
@@ -2879,7 +3691,7 @@ Returns:
   if (DebugDirectoryEntryFileOffset != 0) {
     DebugEntry = (EFI_IMAGE_DEBUG_DIRECTORY_ENTRY *) (FileBuffer + DebugDirectoryEntryFileOffset);
     DebugEntry->TimeDateStamp = 0;
-    mImageTimeStamp = 0;
+    *ImageTimeStamp = 0;
     if (ZeroDebugFlag) {
       memset (FileBuffer + DebugEntry->FileOffset, 0, DebugEntry->SizeOfData);
       memset (DebugEntry, 0, sizeof (EFI_IMAGE_DEBUG_DIRECTORY_ENTRY));
@@ -2893,7 +3705,8 @@ STATIC
 EFI_STATUS
 SetStamp (
   IN OUT UINT8  *FileBuffer,
-  IN     CHAR8  *TimeStamp
+  IN     CHAR8  *TimeStamp,
+  OUT    UINT32 *ImageTimeStamp
   )
 /*++
 
@@ -2906,6 +3719,7 @@ Arguments:
 
   FileBuffer    - Pointer to PeImage.
   TimeStamp     - Time stamp string.
+  ImageTimeStamp - Receives the new time stamp.
 
 Returns:
 
@@ -2981,8 +3795,10 @@ Returns:
     }
 
     //
-    // get the date and time from TimeStamp
+    // get the date and time from TimeStamp. The fields that are not read,
+    // tm_isdst in particular, must not be left uninitialized for mktime.
     //
+    memset (&stime, 0, sizeof (stime));
     if (sscanf (TimeStamp, "%d-%d-%d %d:%d:%d",
             &stime.tm_year,
             &stime.tm_mon,
@@ -3106,7 +3922,7 @@ Returns:
   // Set new stamp
   //
   FileHdr->TimeDateStamp = (UINT32) newtime;
-  mImageTimeStamp = (UINT32) newtime;
+  *ImageTimeStamp = (UINT32) newtime;
   if (ExportDirectoryEntryRva != 0) {
     NewTimeStamp  = (UINT32 *) (FileBuffer + ExportDirectoryEntryFileOffset + sizeof (UINT32));
     *NewTimeStamp = (UINT32) newtime;
@@ -48,8 +48,12 @@ IsElfHeader (
 
 BOOLEAN
 ConvertElf (
-  UINT8  **FileBuffer,
-  UINT32 *FileLength
+  IN     CHAR8  *InImageName,
+  IN     UINT32 OutImageType,
+  IN     UINT8  *ElfImage,
+  OUT    UINT8  **FileBuffer,
+  OUT    UINT32 *FileLength,
+  OUT    UINT32 *ImageTimeStamp
   );
 
 #endif
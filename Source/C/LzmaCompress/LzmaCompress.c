@@ -28,10 +28,54 @@
 #include "Sdk/C/LzmaDec.h"
 #include "Sdk/C/LzmaEnc.h"
 #include "Sdk/C/Bra.h"
+#include "Sdk/C/Threads.h"
 #include "CommonLib.h"
+#include "CompressCache.h"
 
 #define LZMA_HEADER_SIZE (LZMA_PROPS_SIZE + 8)
 
+//
+// Block-parallel container, all fields little endian:
+//
+//   Offset  Size      Field
+//   0       16        mBlockContainerGuid
+//   16      4         Block size, the uncompressed size of every block but
+//                     the last
+//   20      4         Block count
+//   24      8         Total uncompressed size
+//   32      4 * count Compressed size of each block
+//   ...               The blocks, each a complete LZMA stream with its own
+//                     LZMA_HEADER_SIZE header
+//
+// The first GUID byte is larger than any valid LZMA properties byte, so a
+// container can never be mistaken for a single stream. Firmware LZMA
+// extractors only decode single streams: a container belongs in a guided
+// section of its own GUID, whose extractor is LzmaCompress -d, and never
+// in an LZMA custom decompress section. GenSec refuses the latter.
+//
+#define LZMA_BLOCK_GUID_SIZE      16
+#define LZMA_BLOCK_HEADER_SIZE    (LZMA_BLOCK_GUID_SIZE + 4 + 4 + 8)
+#define LZMA_MIN_BLOCK_SIZE       (1 << 16)
+#define LZMA_MAX_THREADS          64
+
+//
+// Like LZMA2, limit lc + lp to 4: the literal probability table of the
+// decoder grows as 0x300 << (lc + lp), beyond what firmware decoders are
+// prepared to allocate.
+//
+#define LZMA_MAX_LC_LP            4
+
+//
+// Input and output chunk size of the streaming decoder
+//
+#define LZMA_STREAM_BUF_SIZE      (1 << 16)
+
+typedef enum {
+  PresetNormal,
+  PresetFast,
+  PresetMax
+} ENCODER_PRESET;
+
 typedef enum {
   NoConverter, 
   X86Converter,
@@ -49,10 +93,45 @@ static ISzAlloc g_Alloc = { SzAlloc, SzFree };
 
 static Bool mQuietMode = False;
 static CONVERTER_TYPE mConType = NoConverter;
+static UInt32 mNumThreads = 1;
+static UInt32 mBlockSize = 0;
+static Bool mVerboseMode = False;
+static ENCODER_PRESET mPreset = PresetNormal;
+
+//
+// Explicit encoder settings from the command line; fields left at their
+// LzmaEncProps_Init values are taken from the preset.
+//
+static CLzmaEncProps mOverrides;
+
+//
+// {2E9C5AF3-7B1D-4C61-9A3E-55D208C46FB1}
+//
+static const Byte mBlockContainerGuid[LZMA_BLOCK_GUID_SIZE] = {
+  0xf3, 0x5a, 0x9c, 0x2e, 0x1d, 0x7b, 0x61, 0x4c,
+  0x9a, 0x3e, 0x55, 0xd2, 0x08, 0xc4, 0x6f, 0xb1
+};
+
+typedef struct {
+  const Byte *inData;
+  size_t inSize;
+  Byte *outData;
+  size_t outSize;
+  SRes res;
+} CBlockJob;
+
+typedef struct {
+  CBlockJob *jobs;
+  UInt32 numJobs;
+  UInt32 nextJob;
+  Bool encodeMode;
+  const CLzmaEncProps *props;
+  CCriticalSection cs;
+} CBlockQueue;
 
 #define UTILITY_NAME "LzmaCompress"
 #define UTILITY_MAJOR_VERSION 0
-#define UTILITY_MINOR_VERSION 2
+#define UTILITY_MINOR_VERSION 3
 #define INTEL_COPYRIGHT \
   "Copyright (c) 2009-2012, Intel Corporation. All rights reserved."
 void PrintHelp(char *buffer)
@@ -65,6 +144,23 @@ void PrintHelp(char *buffer)
              "  -d: decode file\n"
              "  -o FileName, --output FileName: specify the output filename\n"
              "  --f86: enable converter for x86 code\n"
+             "  --preset fast|normal|max: encoder effort (default normal)\n"
+             "      fast: hash chain match finder, 1MB dictionary\n"
+             "      normal: LZMA SDK defaults, 16MB dictionary\n"
+             "      max: 64MB dictionary (at most the input size), 273 byte words\n"
+             "  --dict Size[K|M]: dictionary size, 4K to 1024M\n"
+             "  --fb N: number of fast bytes (word size), 5 to 273\n"
+             "  --mc N: match finder cycles, 1 to 1073741824\n"
+             "  --lc N, --lp N, --pb N: literal context bits (0-8), literal\n"
+             "      position bits (0-4) and position bits (0-4); lc + lp must\n"
+             "      not exceed 4\n"
+             "  --mf hc4|bt2|bt3|bt4: match finder\n"
+             "  -T N, --threads N: use up to N threads (default 1); for a single\n"
+             "      stream, 2 or more enables the multi-threaded match finder\n"
+             "  --block-size Size[K|M]: split the input into blocks of Size bytes\n"
+             "      that are encoded in parallel and stored in a block container;\n"
+             "      the container is not a standard LZMA stream and must be put in\n"
+             "      a guided section of GUID 2E9C5AF3-7B1D-4C61-9A3E-55D208C46FB1\n"
              "  -v, --verbose: increase output messages\n"
              "  -q, --quiet: reduce output messages\n"
              "  --debug [0-9]: set debug level\n"
@@ -97,6 +193,334 @@ void PrintVersion(char *buffer)
   sprintf (buffer, "%s Version %d.%d %s ", UTILITY_NAME, UTILITY_MAJOR_VERSION, UTILITY_MINOR_VERSION, __BUILD_VERSION);
 }
 
+static Bool ParseSize(const char *text, UInt64 *value)
+{
+  char *end;
+  UInt64 result;
+
+  if (*text < '0' || *text > '9')
+    return False;
+  result = (UInt64)strtoul(text, &end, 0);
+  if (*end == 'k' || *end == 'K') {
+    result <<= 10;
+    end++;
+  } else if (*end == 'm' || *end == 'M') {
+    result <<= 20;
+    end++;
+  }
+  if (*end != '\0')
+    return False;
+  *value = result;
+  return True;
+}
+
+static SRes EncodeBuffer(const Byte *inBuffer, size_t inSize, const CLzmaEncProps *props,
+    Byte **outBuffer, size_t *outSize)
+{
+  SRes res;
+  Byte *outData;
+  size_t outSizeProcessed;
+  size_t outPropsSize = LZMA_PROPS_SIZE;
+  size_t outAlloc;
+  int i;
+
+  // we allocate 105% of original size + 64KB for output buffer
+  outAlloc = inSize / 20 * 21 + (1 << 16);
+  outData = (Byte *)MyAlloc(outAlloc);
+  if (outData == 0)
+    return SZ_ERROR_MEM;
+
+  for (i = 0; i < 8; i++)
+    outData[i + LZMA_PROPS_SIZE] = (Byte)((UInt64)inSize >> (8 * i));
+
+  outSizeProcessed = outAlloc - LZMA_HEADER_SIZE;
+  res = LzmaEncode(outData + LZMA_HEADER_SIZE, &outSizeProcessed,
+      inBuffer, inSize,
+      props, outData, &outPropsSize, 0,
+      NULL, &g_Alloc, &g_Alloc);
+
+  if (res != SZ_OK) {
+    MyFree(outData);
+    return res;
+  }
+
+  *outBuffer = outData;
+  *outSize = LZMA_HEADER_SIZE + outSizeProcessed;
+  return SZ_OK;
+}
+
+static SRes DecodeBuffer(const Byte *inBuffer, size_t inSize, Byte *outBuffer, size_t outSize)
+{
+  SRes res;
+  size_t inSizePure;
+  size_t outSizeProcessed;
+  ELzmaStatus status;
+  UInt64 outSize64 = 0;
+  int i;
+
+  if (inSize < LZMA_HEADER_SIZE)
+    return SZ_ERROR_INPUT_EOF;
+
+  for (i = 0; i < 8; i++)
+    outSize64 += ((UInt64)inBuffer[LZMA_PROPS_SIZE + i]) << (i * 8);
+
+  if (outSize64 != (UInt64)outSize)
+    return SZ_ERROR_DATA;
+
+  inSizePure = inSize - LZMA_HEADER_SIZE;
+  outSizeProcessed = outSize;
+  res = LzmaDecode(outBuffer, &outSizeProcessed, inBuffer + LZMA_HEADER_SIZE, &inSizePure,
+      inBuffer, LZMA_PROPS_SIZE, LZMA_FINISH_END, &status, &g_Alloc);
+
+  if (res == SZ_OK && outSizeProcessed != outSize)
+    res = SZ_ERROR_DATA;
+  return res;
+}
+
+static THREAD_FUNC_DECL BlockThreadFunc(void *p)
+{
+  CBlockQueue *queue = (CBlockQueue *)p;
+  CBlockJob *job;
+
+  for (;;) {
+    CriticalSection_Enter(&queue->cs);
+    job = (queue->nextJob < queue->numJobs) ? &queue->jobs[queue->nextJob++] : NULL;
+    CriticalSection_Leave(&queue->cs);
+    if (job == NULL)
+      break;
+
+    if (queue->encodeMode)
+      job->res = EncodeBuffer(job->inData, job->inSize, queue->props, &job->outData, &job->outSize);
+    else
+      job->res = DecodeBuffer(job->inData, job->inSize, job->outData, job->outSize);
+  }
+  return 0;
+}
+
+static SRes RunBlockJobs(CBlockQueue *queue)
+{
+  CThread threads[LZMA_MAX_THREADS];
+  UInt32 numThreads;
+  UInt32 i;
+  SRes res = SZ_OK;
+
+  queue->nextJob = 0;
+  if (CriticalSection_Init(&queue->cs) != 0)
+    return SZ_ERROR_THREAD;
+
+  numThreads = mNumThreads < queue->numJobs ? mNumThreads : queue->numJobs;
+  for (i = 0; i < numThreads; i++)
+    Thread_Construct(&threads[i]);
+
+  //
+  // The calling thread is one of the workers
+  //
+  for (i = 1; i < numThreads; i++) {
+    if (Thread_Create(&threads[i], BlockThreadFunc, queue) != 0) {
+      res = SZ_ERROR_THREAD;
+      break;
+    }
+  }
+  BlockThreadFunc(queue);
+  for (i = 1; i < numThreads; i++) {
+    if (Thread_WasCreated(&threads[i])) {
+      Thread_Wait(&threads[i]);
+      Thread_Close(&threads[i]);
+    }
+  }
+  CriticalSection_Delete(&queue->cs);
+
+  for (i = 0; i < queue->numJobs && res == SZ_OK; i++)
+    res = queue->jobs[i].res;
+  return res;
+}
+
+static void PutUInt32(Byte *p, UInt32 value)
+{
+  int i;
+  for (i = 0; i < 4; i++)
+    p[i] = (Byte)(value >> (8 * i));
+}
+
+static UInt64 GetUInt64(const Byte *p, int n)
+{
+  UInt64 value = 0;
+  int i;
+  for (i = 0; i < n; i++)
+    value |= ((UInt64)p[i]) << (8 * i);
+  return value;
+}
+
+static SRes EncodeBlocks(ISeqOutStream *outStream, const Byte *inBuffer, size_t inSize,
+    const CLzmaEncProps *props)
+{
+  SRes res;
+  CLzmaEncProps blockProps = *props;
+  CBlockQueue queue;
+  Byte *header = 0;
+  size_t headerSize;
+  UInt32 i;
+
+  //
+  // Each block is an independent stream: a dictionary larger than the block
+  // only costs memory, and every worker runs the single-threaded match finder.
+  //
+  blockProps.numThreads = 1;
+  if (blockProps.dictSize > mBlockSize) {
+    blockProps.dictSize = 1 << 12;
+    while (blockProps.dictSize < mBlockSize)
+      blockProps.dictSize <<= 1;
+  }
+
+  queue.numJobs = (UInt32)((inSize + mBlockSize - 1) / mBlockSize);
+  queue.encodeMode = True;
+  queue.props = &blockProps;
+  queue.jobs = (CBlockJob *)MyAlloc(queue.numJobs * sizeof(CBlockJob));
+  if (queue.jobs == 0)
+    return SZ_ERROR_MEM;
+  memset(queue.jobs, 0, queue.numJobs * sizeof(CBlockJob));
+
+  for (i = 0; i < queue.numJobs; i++) {
+    queue.jobs[i].inData = inBuffer + (size_t)i * mBlockSize;
+    queue.jobs[i].inSize = (i + 1 < queue.numJobs) ? mBlockSize : inSize - (size_t)i * mBlockSize;
+  }
+
+  res = RunBlockJobs(&queue);
+  if (res != SZ_OK)
+    goto Done;
+
+  headerSize = LZMA_BLOCK_HEADER_SIZE + (size_t)queue.numJobs * 4;
+  header = (Byte *)MyAlloc(headerSize);
+  if (header == 0) {
+    res = SZ_ERROR_MEM;
+    goto Done;
+  }
+  memcpy(header, mBlockContainerGuid, LZMA_BLOCK_GUID_SIZE);
+  PutUInt32(header + LZMA_BLOCK_GUID_SIZE, mBlockSize);
+  PutUInt32(header + LZMA_BLOCK_GUID_SIZE + 4, queue.numJobs);
+  PutUInt32(header + LZMA_BLOCK_GUID_SIZE + 8, (UInt32)inSize);
+  PutUInt32(header + LZMA_BLOCK_GUID_SIZE + 12, (UInt32)((UInt64)inSize >> 32));
+  for (i = 0; i < queue.numJobs; i++) {
+    if (queue.jobs[i].outSize > 0xFFFFFFFF) {
+      res = SZ_ERROR_PARAM;
+      goto Done;
+    }
+    PutUInt32(header + LZMA_BLOCK_HEADER_SIZE + i * 4, (UInt32)queue.jobs[i].outSize);
+  }
+
+  if (outStream->Write(outStream, header, headerSize) != headerSize) {
+    res = SZ_ERROR_WRITE;
+    goto Done;
+  }
+  for (i = 0; i < queue.numJobs; i++) {
+    if (outStream->Write(outStream, queue.jobs[i].outData, queue.jobs[i].outSize) != queue.jobs[i].outSize) {
+      res = SZ_ERROR_WRITE;
+      goto Done;
+    }
+  }
+
+Done:
+  for (i = 0; i < queue.numJobs; i++)
+    MyFree(queue.jobs[i].outData);
+  MyFree(queue.jobs);
+  MyFree(header);
+
+  return res;
+}
+
+static void SetEncoderProps(CLzmaEncProps *props, UInt64 inSize)
+{
+  LzmaEncProps_Init(props);
+
+  switch (mPreset) {
+  case PresetFast:
+    props->level = 1;
+    props->dictSize = 1 << 20;
+    break;
+  case PresetMax:
+    props->level = 9;
+    props->fb = 273;
+    //
+    // A dictionary larger than the input only costs match finder memory
+    //
+    props->dictSize = 1 << 26;
+    while (props->dictSize > (1 << 12) && (UInt64)(props->dictSize >> 1) >= inSize)
+      props->dictSize >>= 1;
+    break;
+  default:
+    break;
+  }
+
+  if (mOverrides.dictSize != 0) props->dictSize = mOverrides.dictSize;
+  if (mOverrides.fb >= 0) props->fb = mOverrides.fb;
+  if (mOverrides.mc != 0) props->mc = mOverrides.mc;
+  if (mOverrides.lc >= 0) props->lc = mOverrides.lc;
+  if (mOverrides.lp >= 0) props->lp = mOverrides.lp;
+  if (mOverrides.pb >= 0) props->pb = mOverrides.pb;
+  if (mOverrides.btMode >= 0) props->btMode = mOverrides.btMode;
+  if (mOverrides.numHashBytes >= 0) props->numHashBytes = mOverrides.numHashBytes;
+
+  props->numThreads = mNumThreads > 1 ? 2 : 1;
+  LzmaEncProps_Normalize(props);
+
+  if (mVerboseMode) {
+    printf("lc=%d lp=%d pb=%d dict=%u fb=%d mc=%u mf=%s%d algo=%d\n",
+        props->lc, props->lp, props->pb, (unsigned)props->dictSize,
+        props->fb, (unsigned)props->mc, props->btMode ? "bt" : "hc",
+        props->numHashBytes, props->algo);
+  }
+}
+
+//
+// Output stream that keeps a copy of everything written, so that the block
+// container can be added to the compression cache.
+//
+typedef struct
+{
+  ISeqOutStream s;
+  ISeqOutStream *outStream;
+  Byte *data;
+  size_t size;
+  size_t capacity;
+  Bool overflow;
+} CCacheOutStream;
+
+static size_t CacheOutStream_Write(void *pp, const void *buf, size_t size)
+{
+  CCacheOutStream *p = (CCacheOutStream *)pp;
+  Byte *data;
+  size_t capacity;
+
+  if (!p->overflow && p->size + size > p->capacity) {
+    capacity = p->capacity * 2 > p->size + size ? p->capacity * 2 : p->size + size;
+    data = (Byte *)MyAlloc(capacity);
+    if (data == 0) {
+      p->overflow = True;
+    } else {
+      memcpy(data, p->data, p->size);
+      MyFree(p->data);
+      p->data = data;
+      p->capacity = capacity;
+    }
+  }
+  if (!p->overflow) {
+    memcpy(p->data + p->size, buf, size);
+    p->size += size;
+  }
+  return p->outStream->Write(p->outStream, buf, size);
+}
+
+static void GetCacheParams(const CLzmaEncProps *props, char *params)
+{
+  //
+  // Everything that changes the output; the thread count does not
+  //
+  sprintf(params, "lc=%d lp=%d pb=%d dict=%u fb=%d mc=%u bt=%d hb=%d algo=%d f86=%d block=%u",
+      props->lc, props->lp, props->pb, (unsigned)props->dictSize, props->fb,
+      (unsigned)props->mc, props->btMode, props->numHashBytes, props->algo,
+      mConType == X86Converter, (unsigned)mBlockSize);
+}
+
 static SRes Encode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize)
 {
   SRes res;
@@ -106,9 +530,13 @@ static SRes Encode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 file
   Byte *filteredStream = 0;
   size_t outSize;
   CLzmaEncProps props;
+  Bool useCache;
+  char cacheParams[160];
+  void *cachedData;
+  UINTN cachedSize;
+  CCacheOutStream cacheStream;
 
-  LzmaEncProps_Init(&props);
-  LzmaEncProps_Normalize(&props);
+  SetEncoderProps(&props, fileSize);
 
   if (inSize != 0) {
     inBuffer = (Byte *)MyAlloc(inSize);
@@ -123,18 +551,20 @@ static SRes Encode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 file
     goto Done;
   }
 
-  // we allocate 105% of original size + 64KB for output buffer
-  outSize = (size_t)fileSize / 20 * 21 + (1 << 16);
-  outBuffer = (Byte *)MyAlloc(outSize);
-  if (outBuffer == 0) {
-    res = SZ_ERROR_MEM;
-    goto Done;
-  }
-  
-  {
-    int i;
-    for (i = 0; i < 8; i++)
-      outBuffer[i + LZMA_PROPS_SIZE] = (Byte)(fileSize >> (8 * i));
+  useCache = CompressCacheEnabled();
+  if (useCache) {
+    GetCacheParams(&props, cacheParams);
+    if (CompressCacheLookup(COMPRESS_CACHE_CODEC_LZMA, cacheParams, inBuffer, inSize,
+            &cachedData, &cachedSize) == EFI_SUCCESS) {
+      if (mVerboseMode)
+        printf("Using cached compression result\n");
+      if (outStream->Write(outStream, cachedData, cachedSize) != cachedSize)
+        res = SZ_ERROR_WRITE;
+      else
+        res = SZ_OK;
+      free(cachedData);
+      goto Done;
+    }
   }
 
   if (mConType != NoConverter)
@@ -155,23 +585,37 @@ static SRes Encode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 file
     }
   }
 
-  {
-    size_t outSizeProcessed = outSize - LZMA_HEADER_SIZE;
-    size_t outPropsSize = LZMA_PROPS_SIZE;
-    
-    res = LzmaEncode(outBuffer + LZMA_HEADER_SIZE, &outSizeProcessed,
-        mConType != NoConverter ? filteredStream : inBuffer, inSize,
-        &props, outBuffer, &outPropsSize, 0,
-        NULL, &g_Alloc, &g_Alloc);
-    
-    if (res != SZ_OK)
+  if (mBlockSize != 0) {
+    if (!useCache) {
+      res = EncodeBlocks(outStream,
+          mConType != NoConverter ? filteredStream : inBuffer, inSize,
+          &props);
       goto Done;
+    }
 
-    outSize = LZMA_HEADER_SIZE + outSizeProcessed;
+    memset(&cacheStream, 0, sizeof(cacheStream));
+    cacheStream.s.Write = CacheOutStream_Write;
+    cacheStream.outStream = outStream;
+    res = EncodeBlocks(&cacheStream.s,
+        mConType != NoConverter ? filteredStream : inBuffer, inSize,
+        &props);
+    if (res == SZ_OK && !cacheStream.overflow)
+      CompressCacheStore(COMPRESS_CACHE_CODEC_LZMA, cacheParams, inBuffer, inSize,
+          cacheStream.data, cacheStream.size);
+    MyFree(cacheStream.data);
+    goto Done;
   }
 
+  res = EncodeBuffer(mConType != NoConverter ? filteredStream : inBuffer, inSize,
+      &props, &outBuffer, &outSize);
+  if (res != SZ_OK)
+    goto Done;
+
   if (outStream->Write(outStream, outBuffer, outSize) != outSize)
     res = SZ_ERROR_WRITE;
+  else if (useCache)
+    CompressCacheStore(COMPRESS_CACHE_CODEC_LZMA, cacheParams, inBuffer, inSize,
+        outBuffer, outSize);
 
 Done:
   MyFree(outBuffer);
@@ -181,51 +625,271 @@ Done:
   return res;
 }
 
-static SRes Decode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize)
+static SRes DecodeBlocks(const Byte *inBuffer, size_t inSize, Byte **outBuffer, size_t *outSize)
+{
+  SRes res;
+  CBlockQueue queue;
+  UInt32 blockSize;
+  UInt64 totalSize;
+  size_t offset;
+  size_t headerSize;
+  Byte *outData = 0;
+  UInt32 i;
+
+  if (inSize < LZMA_BLOCK_HEADER_SIZE)
+    return SZ_ERROR_INPUT_EOF;
+
+  blockSize = (UInt32)GetUInt64(inBuffer + LZMA_BLOCK_GUID_SIZE, 4);
+  queue.numJobs = (UInt32)GetUInt64(inBuffer + LZMA_BLOCK_GUID_SIZE + 4, 4);
+  totalSize = GetUInt64(inBuffer + LZMA_BLOCK_GUID_SIZE + 8, 8);
+  if (blockSize == 0 || totalSize != (size_t)totalSize ||
+      (UInt64)queue.numJobs != (totalSize + blockSize - 1) / blockSize)
+    return SZ_ERROR_DATA;
+
+  headerSize = LZMA_BLOCK_HEADER_SIZE + (size_t)queue.numJobs * 4;
+  if (inSize < headerSize)
+    return SZ_ERROR_INPUT_EOF;
+  if (totalSize == 0) {
+    *outBuffer = 0;
+    *outSize = 0;
+    return SZ_OK;
+  }
+
+  outData = (Byte *)MyAlloc((size_t)totalSize);
+  queue.jobs = (CBlockJob *)MyAlloc(queue.numJobs * sizeof(CBlockJob));
+  if (outData == 0 || queue.jobs == 0) {
+    res = SZ_ERROR_MEM;
+    goto Done;
+  }
+  memset(queue.jobs, 0, queue.numJobs * sizeof(CBlockJob));
+  queue.encodeMode = False;
+  queue.props = NULL;
+
+  offset = headerSize;
+  for (i = 0; i < queue.numJobs; i++) {
+    queue.jobs[i].inSize = (size_t)GetUInt64(inBuffer + LZMA_BLOCK_HEADER_SIZE + i * 4, 4);
+    if (queue.jobs[i].inSize > inSize - offset) {
+      res = SZ_ERROR_INPUT_EOF;
+      goto Done;
+    }
+    queue.jobs[i].inData = inBuffer + offset;
+    queue.jobs[i].outData = outData + (size_t)i * blockSize;
+    queue.jobs[i].outSize = (i + 1 < queue.numJobs) ? blockSize : (size_t)totalSize - (size_t)i * blockSize;
+    offset += queue.jobs[i].inSize;
+  }
+
+  res = RunBlockJobs(&queue);
+  if (res != SZ_OK)
+    goto Done;
+
+  *outBuffer = outData;
+  *outSize = (size_t)totalSize;
+  outData = 0;
+
+Done:
+  MyFree(queue.jobs);
+  MyFree(outData);
+
+  return res;
+}
+
+//
+// Output sink for the streaming decoder. With the x86 converter enabled,
+// decoded bytes are staged in a rolling buffer; x86_Convert leaves up to four
+// trailing bytes unprocessed, and those are carried into the next chunk.
+//
+typedef struct {
+  ISeqOutStream *outStream;
+  Byte *buffer;
+  size_t used;
+  UInt32 ip;
+  UInt32 x86State;
+} CDecodeWriter;
+
+static SRes WriterFlush(CDecodeWriter *writer, Bool finish)
+{
+  size_t processed;
+
+  processed = x86_Convert(writer->buffer, (SizeT)writer->used, writer->ip, &writer->x86State, 0);
+  if (finish)
+    processed = writer->used;
+  if (processed == 0)
+    return SZ_OK;
+  if (writer->outStream->Write(writer->outStream, writer->buffer, processed) != processed)
+    return SZ_ERROR_WRITE;
+  memmove(writer->buffer, writer->buffer + processed, writer->used - processed);
+  writer->used -= processed;
+  writer->ip += (UInt32)processed;
+  return SZ_OK;
+}
+
+static SRes WriterWrite(CDecodeWriter *writer, const Byte *data, size_t size)
+{
+  size_t chunk;
+
+  if (writer->buffer == 0) {
+    if (writer->outStream->Write(writer->outStream, data, size) != size)
+      return SZ_ERROR_WRITE;
+    return SZ_OK;
+  }
+
+  while (size > 0) {
+    chunk = LZMA_STREAM_BUF_SIZE - writer->used;
+    if (chunk > size)
+      chunk = size;
+    memcpy(writer->buffer + writer->used, data, chunk);
+    writer->used += chunk;
+    data += chunk;
+    size -= chunk;
+    if (writer->used == LZMA_STREAM_BUF_SIZE)
+      RINOK(WriterFlush(writer, False));
+  }
+  return SZ_OK;
+}
+
+static SRes DecodeStream(ISeqOutStream *outStream, ISeqInStream *inStream, const Byte *header)
+{
+  SRes res;
+  CLzmaDec state;
+  CDecodeWriter writer;
+  Byte *inBuffer = 0;
+  size_t inPos = 0;
+  size_t inSize = 0;
+  size_t inProcessed;
+  SizeT dicPos;
+  SizeT outProcessed;
+  UInt64 unpackSize;
+  UInt64 outPos = 0;
+  Bool sizeDefined;
+  ELzmaFinishMode finishMode;
+  ELzmaStatus status;
+
+  unpackSize = GetUInt64(header + LZMA_PROPS_SIZE, 8);
+  sizeDefined = (unpackSize != (UInt64)(Int64)-1);
+  if (unpackSize == 0)
+    return SZ_OK;
+
+  writer.outStream = outStream;
+  writer.buffer = 0;
+  writer.used = 0;
+  writer.ip = 0;
+  x86_Convert_Init(writer.x86State);
+
+  //
+  // The dictionary window never needs to be larger than the whole output
+  //
+  LzmaDec_Construct(&state);
+  RINOK(LzmaDec_AllocateProbs(&state, header, LZMA_PROPS_SIZE, &g_Alloc));
+  state.dicBufSize = state.prop.dicSize;
+  if (sizeDefined && (UInt64)state.dicBufSize > unpackSize)
+    state.dicBufSize = (SizeT)unpackSize;
+  if (state.dicBufSize < (1 << 12))
+    state.dicBufSize = 1 << 12;
+  state.dic = (Byte *)MyAlloc(state.dicBufSize);
+  inBuffer = (Byte *)MyAlloc(LZMA_STREAM_BUF_SIZE);
+  if (mConType == X86Converter)
+    writer.buffer = (Byte *)MyAlloc(LZMA_STREAM_BUF_SIZE);
+  if (state.dic == 0 || inBuffer == 0 || (mConType == X86Converter && writer.buffer == 0)) {
+    res = SZ_ERROR_MEM;
+    goto Done;
+  }
+
+  LzmaDec_Init(&state);
+
+  for (;;) {
+    if (inPos == inSize) {
+      inSize = LZMA_STREAM_BUF_SIZE;
+      res = inStream->Read(inStream, inBuffer, &inSize);
+      if (res != SZ_OK) {
+        res = SZ_ERROR_READ;
+        break;
+      }
+      inPos = 0;
+    }
+
+    //
+    // Decode at most one output chunk so that writes are interleaved with
+    // decoding
+    //
+    dicPos = state.dicPos;
+    outProcessed = state.dicBufSize - dicPos;
+    if (outProcessed > LZMA_STREAM_BUF_SIZE)
+      outProcessed = LZMA_STREAM_BUF_SIZE;
+    finishMode = LZMA_FINISH_ANY;
+    if (sizeDefined && outProcessed > unpackSize - outPos) {
+      outProcessed = (SizeT)(unpackSize - outPos);
+      finishMode = LZMA_FINISH_END;
+    }
+
+    inProcessed = inSize - inPos;
+    res = LzmaDec_DecodeToDic(&state, dicPos + outProcessed,
+        inBuffer + inPos, &inProcessed, finishMode, &status);
+    inPos += inProcessed;
+    outProcessed = state.dicPos - dicPos;
+    outPos += outProcessed;
+
+    if (res == SZ_OK)
+      res = WriterWrite(&writer, state.dic + dicPos, outProcessed);
+    if (state.dicPos == state.dicBufSize)
+      state.dicPos = 0;
+
+    if (res != SZ_OK || (sizeDefined && outPos == unpackSize))
+      break;
+    if (status == LZMA_STATUS_FINISHED_WITH_MARK) {
+      if (sizeDefined)
+        res = SZ_ERROR_DATA;
+      break;
+    }
+    if (inProcessed == 0 && outProcessed == 0) {
+      //
+      // No progress: the input is truncated
+      //
+      res = SZ_ERROR_INPUT_EOF;
+      break;
+    }
+  }
+
+  if (res == SZ_OK && writer.buffer != 0)
+    res = WriterFlush(&writer, True);
+
+Done:
+  MyFree(writer.buffer);
+  MyFree(inBuffer);
+  MyFree(state.dic);
+  LzmaDec_FreeProbs(&state, &g_Alloc);
+
+  return res;
+}
+
+static SRes DecodeContainer(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize,
+    const Byte *header)
 {
   SRes res;
   size_t inSize = (size_t)fileSize;
   Byte *inBuffer = 0;
   Byte *outBuffer = 0;
   size_t outSize = 0;
-  size_t inSizePure;
-  ELzmaStatus status;
-  UInt64 outSize64 = 0;
 
-  int i;
-
-  if (inSize < LZMA_HEADER_SIZE) 
+  if (inSize < LZMA_BLOCK_HEADER_SIZE)
     return SZ_ERROR_INPUT_EOF;
 
   inBuffer = (Byte *)MyAlloc(inSize);
   if (inBuffer == 0)
     return SZ_ERROR_MEM;
-  
-  if (SeqInStream_Read(inStream, inBuffer, inSize) != SZ_OK) {
+
+  memcpy(inBuffer, header, LZMA_HEADER_SIZE);
+  if (SeqInStream_Read(inStream, inBuffer + LZMA_HEADER_SIZE, inSize - LZMA_HEADER_SIZE) != SZ_OK) {
     res = SZ_ERROR_READ;
     goto Done;
   }
 
-  for (i = 0; i < 8; i++)
-    outSize64 += ((UInt64)inBuffer[LZMA_PROPS_SIZE + i]) << (i * 8);
-
-  outSize = (size_t)outSize64;
-  if (outSize != 0) {
-    outBuffer = (Byte *)MyAlloc(outSize);
-    if (outBuffer == 0) {
-      res = SZ_ERROR_MEM;
-      goto Done;
-    }
-  } else {
-    res = SZ_OK;
+  if (memcmp(inBuffer, mBlockContainerGuid, LZMA_BLOCK_GUID_SIZE) != 0) {
+    res = SZ_ERROR_DATA;
     goto Done;
   }
 
-  inSizePure = inSize - LZMA_HEADER_SIZE;
-  res = LzmaDecode(outBuffer, &outSize, inBuffer + LZMA_HEADER_SIZE, &inSizePure,
-      inBuffer, LZMA_PROPS_SIZE, LZMA_FINISH_END, &status, &g_Alloc);
-
-  if (res != SZ_OK)
+  res = DecodeBlocks(inBuffer, inSize, &outBuffer, &outSize);
+  if (res != SZ_OK || outSize == 0)
     goto Done;
 
   if (mConType == X86Converter)
@@ -245,6 +909,26 @@ Done:
   return res;
 }
 
+static SRes Decode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize)
+{
+  Byte header[LZMA_HEADER_SIZE];
+
+  if (fileSize < LZMA_HEADER_SIZE)
+    return SZ_ERROR_INPUT_EOF;
+
+  if (SeqInStream_Read(inStream, header, LZMA_HEADER_SIZE) != SZ_OK)
+    return SZ_ERROR_READ;
+
+  //
+  // A valid LZMA properties byte is always smaller than the first byte of
+  // the block container GUID
+  //
+  if (header[0] == mBlockContainerGuid[0])
+    return DecodeContainer(outStream, inStream, fileSize, header);
+
+  return DecodeStream(outStream, inStream, header);
+}
+
 int main2(int numArgs, const char *args[], char *rs)
 {
   CFileSeqInStream inStream;
@@ -256,6 +940,7 @@ int main2(int numArgs, const char *args[], char *rs)
   const char *outputFile = "file.tmp";
   int param;
   UInt64 fileSize;
+  UInt64 value;
 
   FileSeqInStream_CreateVTable(&inStream);
   File_Construct(&inStream.file);
@@ -269,12 +954,96 @@ int main2(int numArgs, const char *args[], char *rs)
     return 0;
   }
 
+  LzmaEncProps_Init(&mOverrides);
+
   for (param = 1; param < numArgs; param++) {
     if (strcmp(args[param], "-e") == 0 || strcmp(args[param], "-d") == 0) {
       encodeMode = (args[param][1] == 'e');
       modeWasSet = True;
     } else if (strcmp(args[param], "--f86") == 0) {
       mConType = X86Converter;
+    } else if (strcmp(args[param], "-T") == 0 ||
+               strcmp(args[param], "--threads") == 0) {
+      if (numArgs < (param + 2) ||
+          !ParseSize(args[++param], &value) ||
+          value == 0 || value > LZMA_MAX_THREADS) {
+        return PrintUserError(rs);
+      }
+      mNumThreads = (UInt32)value;
+    } else if (strcmp(args[param], "--preset") == 0) {
+      if (numArgs < (param + 2)) {
+        return PrintUserError(rs);
+      }
+      param++;
+      if (strcmp(args[param], "fast") == 0) {
+        mPreset = PresetFast;
+      } else if (strcmp(args[param], "normal") == 0) {
+        mPreset = PresetNormal;
+      } else if (strcmp(args[param], "max") == 0) {
+        mPreset = PresetMax;
+      } else {
+        return PrintUserError(rs);
+      }
+    } else if (strcmp(args[param], "--dict") == 0) {
+      if (numArgs < (param + 2) ||
+          !ParseSize(args[++param], &value) ||
+          value < (1 << 12) || value > (1 << 30)) {
+        return PrintUserError(rs);
+      }
+      mOverrides.dictSize = (UInt32)value;
+    } else if (strcmp(args[param], "--fb") == 0) {
+      if (numArgs < (param + 2) ||
+          !ParseSize(args[++param], &value) ||
+          value < 5 || value > 273) {
+        return PrintUserError(rs);
+      }
+      mOverrides.fb = (int)value;
+    } else if (strcmp(args[param], "--mc") == 0) {
+      if (numArgs < (param + 2) ||
+          !ParseSize(args[++param], &value) ||
+          value < 1 || value > (1 << 30)) {
+        return PrintUserError(rs);
+      }
+      mOverrides.mc = (UInt32)value;
+    } else if (strcmp(args[param], "--lc") == 0 ||
+               strcmp(args[param], "--lp") == 0 ||
+               strcmp(args[param], "--pb") == 0) {
+      if (numArgs < (param + 2) ||
+          !ParseSize(args[param + 1], &value) ||
+          value > (UInt64)(args[param][3] == 'c' ? 8 : 4)) {
+        return PrintUserError(rs);
+      }
+      if (args[param][3] == 'c') {
+        mOverrides.lc = (int)value;
+      } else if (args[param][2] == 'l') {
+        mOverrides.lp = (int)value;
+      } else {
+        mOverrides.pb = (int)value;
+      }
+      param++;
+    } else if (strcmp(args[param], "--mf") == 0) {
+      if (numArgs < (param + 2)) {
+        return PrintUserError(rs);
+      }
+      param++;
+      if (strcmp(args[param], "hc4") == 0) {
+        mOverrides.btMode = 0;
+        mOverrides.numHashBytes = 4;
+      } else if (strcmp(args[param], "bt2") == 0 ||
+                 strcmp(args[param], "bt3") == 0 ||
+                 strcmp(args[param], "bt4") == 0) {
+        mOverrides.btMode = 1;
+        mOverrides.numHashBytes = args[param][2] - '0';
+      } else {
+        return PrintUserError(rs);
+      }
+    } else if (strcmp(args[param], "--block-size") == 0) {
+      if (numArgs < (param + 2) ||
+          !ParseSize(args[++param], &value) ||
+          value < LZMA_MIN_BLOCK_SIZE || value > 0x80000000) {
+        return PrintUserError(rs);
+      }
+      mBlockSize = (UInt32)value;
     } else if (strcmp(args[param], "-o") == 0 ||
                strcmp(args[param], "--output") == 0) {
       if (numArgs < (param + 2)) {
@@ -300,10 +1069,7 @@ int main2(int numArgs, const char *args[], char *rs)
                 strcmp(args[param], "-v") == 0 ||
                 strcmp(args[param], "--verbose") == 0
               ) {
-      //
-      // For now we silently ignore this parameter to achieve command line
-      // parameter compatibility with other build tools.
-      //
+      mVerboseMode = True;
     } else if (
                 strcmp(args[param], "-q") == 0 ||
                 strcmp(args[param], "--quiet") == 0
@@ -323,6 +1089,13 @@ int main2(int numArgs, const char *args[], char *rs)
     return PrintUserError(rs);
   }
 
+  {
+    CLzmaEncProps props = mOverrides;
+    LzmaEncProps_Normalize(&props);
+    if (encodeMode && props.lc + props.lp > LZMA_MAX_LC_LP)
+      return PrintError(rs, "lc + lp must not exceed 4");
+  }
+
   {
     size_t t4 = sizeof(UInt32);
     size_t t8 = sizeof(UInt64);
@@ -373,7 +1146,7 @@ int main2(int numArgs, const char *args[], char *rs)
 
 int MY_CDECL main(int numArgs, const char *args[])
 {
-  char rs[2000] = { 0 };
+  char rs[4000] = { 0 };
   int res = main2(numArgs, args, rs);
   if (strlen(rs) > 0) {
     puts(rs);
@@ -2191,7 +2191,8 @@ SRes LzmaEnc_Encode(CLzmaEncHandle pp, ISeqOutStream *outStream, ISeqInStream *i
   CLzmaEnc *p = (CLzmaEnc *)pp;
   SRes res = SZ_OK;
 
-  #ifdef COMPRESS_MF_MT
+  /* EDK II local modification: the stack probe is only needed on Windows */
+  #if defined(COMPRESS_MF_MT) && defined(_WIN32)
   Byte allocaDummy[0x300];
   int i = 0;
   for (i = 0; i < 16; i++)
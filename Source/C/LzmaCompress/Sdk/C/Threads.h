@@ -6,6 +6,12 @@
 
 #include "Types.h"
 
+/* EDK II local modification: hosts other than Windows use the POSIX port
+   in LzmaCompress/PosixThreads.h instead of the Win32 code below. */
+#ifndef _WIN32
+#include "../../PosixThreads.h"
+#else
+
 typedef struct _CThread
 {
   HANDLE handle;
@@ -64,5 +70,7 @@ WRes CriticalSection_Init(CCriticalSection *p);
 #define CriticalSection_Enter(p) EnterCriticalSection(p)
 #define CriticalSection_Leave(p) LeaveCriticalSection(p)
 
+#endif /* _WIN32 */
+
 #endif
 
@@ -0,0 +1,582 @@
+/** @file
+
+Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+This program and the accompanying materials are licensed and made available
+under the terms and conditions of the BSD License which accompanies this
+distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+//
+// Sizes returned by the s# format are Py_ssize_t
+//
+#define PY_SSIZE_T_CLEAN
+
+#include <Python.h>
+#include <Common/UefiBaseTypes.h>
+#include <Common/PiFirmwareFile.h>
+
+#include "CommonLib.h"
+#include "Compress.h"
+#include "CompressCache.h"
+#include "Crc32.h"
+#include "EfiUtilityMsgs.h"
+#include "FfsLib.h"
+#include "GenFvInternalLib.h"
+#include "ParseInf.h"
+
+STATIC CHAR8 *mAlignName[] = {
+  "1", "2", "4", "8", "16", "32", "64", "128", "256", "512",
+  "1K", "2K", "4K", "8K", "16K", "32K", "64K"
+};
+
+STATIC CHAR8 *mFfsValidAlignName[] = {
+  "8", "16", "128", "512", "1K", "4K", "32K", "64K"
+};
+
+STATIC UINT32 mFfsValidAlign[] = {8, 16, 128, 512, 1024, 4096, 32768, 65536};
+
+/*
+ Convert an alignment string such as "4K" to bytes; 0 if it is not valid.
+*/
+STATIC
+UINT32
+AlignmentFromString (
+  CHAR8       *String
+  )
+{
+  UINT32      Index;
+
+  for (Index = 0; Index < sizeof (mAlignName) / sizeof (CHAR8 *); Index++) {
+    if (stricmp (String, mAlignName[Index]) == 0) {
+      return 1 << Index;
+    }
+  }
+  return 0;
+}
+
+/*
+ Convert a sequence of section data strings, or (data, alignment) tuples,
+ to FFS_SECTION_INPUT entries. The data stays owned by Sequence.
+*/
+STATIC
+FFS_SECTION_INPUT*
+GetSectionInputs (
+  PyObject    *Sequence,
+  UINT32      *InputNum
+  )
+{
+  FFS_SECTION_INPUT *Inputs;
+  PyObject          *Item;
+  CHAR8             *Data;
+  CHAR8             *Align;
+  Py_ssize_t        Size;
+  Py_ssize_t        Count;
+  Py_ssize_t        Index;
+
+  Count = PySequence_Fast_GET_SIZE(Sequence);
+  Inputs = PyMem_Malloc((Count + 1) * sizeof (FFS_SECTION_INPUT));
+  if (Inputs == NULL) {
+    PyErr_SetString(PyExc_Exception, "Not enough memory\n");
+    return NULL;
+  }
+
+  for (Index = 0; Index < Count; ++Index) {
+    Item  = PySequence_Fast_GET_ITEM(Sequence, Index);
+    Align = NULL;
+    if (PyTuple_Check(Item)) {
+      if (!PyArg_ParseTuple(Item, "s#s", &Data, &Size, &Align)) {
+        PyMem_Free(Inputs);
+        return NULL;
+      }
+    } else if (PyString_AsStringAndSize(Item, &Data, &Size) != 0) {
+      PyMem_Free(Inputs);
+      return NULL;
+    }
+
+    Inputs[Index].Data      = (UINT8 *)Data;
+    Inputs[Index].Size      = (UINT32)Size;
+    Inputs[Index].Alignment = 0;
+    if (Align != NULL) {
+      Inputs[Index].Alignment = AlignmentFromString(Align);
+      if (Inputs[Index].Alignment == 0) {
+        PyErr_Format(PyExc_Exception, "Invalid section alignment %s\n", Align);
+        PyMem_Free(Inputs);
+        return NULL;
+      }
+    }
+  }
+
+  *InputNum = (UINT32)Count;
+  return Inputs;
+}
+
+/*
+ Return the buffer allocated by the library as a string and free it.
+*/
+STATIC
+PyObject*
+ReturnBuffer (
+  EFI_STATUS  Status,
+  UINT8       *Buffer,
+  UINTN       BufferSize,
+  CONST CHAR8 *Message
+  )
+{
+  PyObject      *ReturnValue;
+
+  if (EFI_ERROR (Status)) {
+    if (Buffer != NULL) {
+      free(Buffer);
+    }
+    PyErr_SetString(PyExc_Exception, Message);
+    return NULL;
+  }
+
+  ReturnValue = PyString_FromStringAndSize((CONST CHAR8*)Buffer, (Py_ssize_t)BufferSize);
+  free(Buffer);
+  return ReturnValue;
+}
+
+/*
+ GenLeafSection(SectionType, Data)
+*/
+STATIC
+PyObject*
+GenLeafSection (
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  CHAR8         *SectionName;
+  CHAR8         *Data;
+  Py_ssize_t    DataSize;
+  UINT8         SectionType;
+  UINT8         *OutBuffer;
+  UINT32        OutSize;
+  EFI_STATUS    Status;
+
+  if (!PyArg_ParseTuple(Args, "ss#", &SectionName, &Data, &DataSize)) {
+    return NULL;
+  }
+
+  SectionType = FfsSectionTypeFromString(SectionName);
+  if (SectionType == EFI_SECTION_ALL ||
+      SectionType == EFI_SECTION_COMPRESSION ||
+      SectionType == EFI_SECTION_GUID_DEFINED ||
+      SectionType == EFI_SECTION_VERSION ||
+      SectionType == EFI_SECTION_USER_INTERFACE) {
+    PyErr_Format(PyExc_Exception, "%s is not a leaf section type\n", SectionName);
+    return NULL;
+  }
+
+  OutBuffer = NULL;
+  Py_BEGIN_ALLOW_THREADS
+  Status = FfsGenLeafSection(SectionType, (UINT8 *)Data, (UINT32)DataSize, &OutBuffer, &OutSize);
+  Py_END_ALLOW_THREADS
+
+  return ReturnBuffer(Status, OutBuffer, OutSize, "Failed to generate section\n");
+}
+
+/*
+ GenVersionSection(BuildNumber, VersionString)
+*/
+STATIC
+PyObject*
+GenVersionSection (
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  INT32         BuildNumber;
+  CHAR8         *VersionString;
+  UINT8         *OutBuffer;
+  UINT32        OutSize;
+  EFI_STATUS    Status;
+
+  if (!PyArg_ParseTuple(Args, "is", &BuildNumber, &VersionString)) {
+    return NULL;
+  }
+  if (BuildNumber < 0 || BuildNumber > 65535) {
+    PyErr_SetString(PyExc_Exception, "Build number is not in 0~65535\n");
+    return NULL;
+  }
+
+  OutBuffer = NULL;
+  Status = FfsGenVersionSection((UINT16)BuildNumber, VersionString, &OutBuffer, &OutSize);
+
+  return ReturnBuffer(Status, OutBuffer, OutSize, "Failed to generate section\n");
+}
+
+/*
+ GenUserInterfaceSection(Name)
+*/
+STATIC
+PyObject*
+GenUserInterfaceSection (
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  CHAR8         *Name;
+  UINT8         *OutBuffer;
+  UINT32        OutSize;
+  EFI_STATUS    Status;
+
+  if (!PyArg_ParseTuple(Args, "s", &Name)) {
+    return NULL;
+  }
+
+  OutBuffer = NULL;
+  Status = FfsGenUserInterfaceSection(Name, &OutBuffer, &OutSize);
+
+  return ReturnBuffer(Status, OutBuffer, OutSize, "Failed to generate section\n");
+}
+
+/*
+ GenCompressionSection(Sections, CompressionType = "PI_STD", Level = default)
+*/
+STATIC
+PyObject*
+GenCompressionSection (
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  PyObject          *SectionList;
+  PyObject          *Sequence;
+  CHAR8             *CompressionName;
+  INT32             Level;
+  UINT8             CompressionType;
+  FFS_SECTION_INPUT *Inputs;
+  UINT32            InputNum;
+  UINT32            Index;
+  UINT8             *OutBuffer;
+  UINT32            OutSize;
+  EFI_STATUS        Status;
+
+  CompressionName = "PI_STD";
+  Level           = COMPRESS_LEVEL_DEFAULT;
+  if (!PyArg_ParseTuple(Args, "O|si", &SectionList, &CompressionName, &Level)) {
+    return NULL;
+  }
+
+  if (stricmp(CompressionName, "PI_STD") == 0) {
+    CompressionType = EFI_STANDARD_COMPRESSION;
+  } else if (stricmp(CompressionName, "PI_NONE") == 0) {
+    CompressionType = EFI_NOT_COMPRESSED;
+  } else {
+    PyErr_Format(PyExc_Exception, "Invalid compression type %s\n", CompressionName);
+    return NULL;
+  }
+  if (Level < COMPRESS_LEVEL_MIN || Level > COMPRESS_LEVEL_MAX) {
+    PyErr_Format(PyExc_Exception, "Compression level %d is not in %d~%d\n", Level, COMPRESS_LEVEL_MIN, COMPRESS_LEVEL_MAX);
+    return NULL;
+  }
+
+  Sequence = PySequence_Fast(SectionList, "First argument is not a sequence\n");
+  if (Sequence == NULL) {
+    return NULL;
+  }
+  Inputs = GetSectionInputs(Sequence, &InputNum);
+  if (Inputs == NULL) {
+    Py_DECREF(Sequence);
+    return NULL;
+  }
+
+  //
+  // The sections of a compression section are not aligned
+  //
+  for (Index = 0; Index < InputNum; Index++) {
+    Inputs[Index].Alignment = 0;
+  }
+
+  OutBuffer = NULL;
+  Py_BEGIN_ALLOW_THREADS
+  Status = FfsGenCompressionSection(Inputs, InputNum, CompressionType, (UINT32)Level, &OutBuffer, &OutSize);
+  Py_END_ALLOW_THREADS
+
+  PyMem_Free(Inputs);
+  Py_DECREF(Sequence);
+  return ReturnBuffer(Status, OutBuffer, OutSize, "Failed to generate section\n");
+}
+
+/*
+ GenGuidDefinedSection(Sections, VendorGuid = "", Attributes = 0, HeaderLength = 0)
+*/
+STATIC
+PyObject*
+GenGuidDefinedSection (
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  PyObject          *SectionList;
+  PyObject          *Sequence;
+  CHAR8             *GuidString;
+  INT32             Attributes;
+  UINT32            HeaderLength;
+  EFI_GUID          VendorGuid;
+  FFS_SECTION_INPUT *Inputs;
+  UINT32            InputNum;
+  UINT32            Index;
+  UINT8             *OutBuffer;
+  UINT32            OutSize;
+  EFI_STATUS        Status;
+
+  GuidString   = "";
+  Attributes   = 0;
+  HeaderLength = 0;
+  if (!PyArg_ParseTuple(Args, "O|siI", &SectionList, &GuidString, &Attributes, &HeaderLength)) {
+    return NULL;
+  }
+
+  memset (&VendorGuid, 0, sizeof (VendorGuid));
+  if (GuidString[0] != '\0' && EFI_ERROR (StringToGuid(GuidString, &VendorGuid))) {
+    PyErr_Format(PyExc_Exception, "Invalid GUID %s\n", GuidString);
+    return NULL;
+  }
+
+  Sequence = PySequence_Fast(SectionList, "First argument is not a sequence\n");
+  if (Sequence == NULL) {
+    return NULL;
+  }
+  Inputs = GetSectionInputs(Sequence, &InputNum);
+  if (Inputs == NULL) {
+    Py_DECREF(Sequence);
+    return NULL;
+  }
+
+  //
+  // Only the CRC32 guided section keeps the section alignments
+  //
+  if (GuidString[0] != '\0') {
+    for (Index = 0; Index < InputNum; Index++) {
+      Inputs[Index].Alignment = 0;
+    }
+  }
+
+  OutBuffer = NULL;
+  Py_BEGIN_ALLOW_THREADS
+  Status = FfsGenGuidDefinedSection(Inputs, InputNum, &VendorGuid, (UINT16)Attributes, HeaderLength, &OutBuffer, &OutSize);
+  Py_END_ALLOW_THREADS
+
+  PyMem_Free(Inputs);
+  Py_DECREF(Sequence);
+  return ReturnBuffer(Status, OutBuffer, OutSize, "Failed to generate section\n");
+}
+
+/*
+ GenFfs(FileType, FileGuid, Sections, Fixed = 0, Checksum = 0, Alignment = "1")
+*/
+STATIC
+PyObject*
+GenFfs (
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  PyObject                *SectionList;
+  PyObject                *Sequence;
+  CHAR8                   *FileTypeName;
+  CHAR8                   *GuidString;
+  CHAR8                   *AlignName;
+  INT32                   Fixed;
+  INT32                   Checksum;
+  EFI_FV_FILETYPE         FileType;
+  EFI_GUID                FileGuid;
+  EFI_FFS_FILE_ATTRIBUTES Attributes;
+  UINT32                  Alignment;
+  UINT32                  Index;
+  FFS_SECTION_INPUT       *Inputs;
+  UINT32                  InputNum;
+  UINT8                   *OutBuffer;
+  UINT32                  OutSize;
+  EFI_STATUS              Status;
+
+  Fixed     = 0;
+  Checksum  = 0;
+  AlignName = "1";
+  if (!PyArg_ParseTuple(Args, "ssO|iis", &FileTypeName, &GuidString, &SectionList, &Fixed, &Checksum, &AlignName)) {
+    return NULL;
+  }
+
+  FileType = FfsFileTypeFromString(FileTypeName);
+  if (FileType == EFI_FV_FILETYPE_ALL) {
+    PyErr_Format(PyExc_Exception, "%s is not a valid file type\n", FileTypeName);
+    return NULL;
+  }
+  if (EFI_ERROR (StringToGuid(GuidString, &FileGuid))) {
+    PyErr_Format(PyExc_Exception, "Invalid GUID %s\n", GuidString);
+    return NULL;
+  }
+
+  //
+  // 1, 2, 4 byte alignment same to 8 byte alignment
+  //
+  Alignment = mFfsValidAlign[0];
+  for (Index = 0; Index < sizeof (mFfsValidAlignName) / sizeof (CHAR8 *); Index++) {
+    if (stricmp(AlignName, mFfsValidAlignName[Index]) == 0) {
+      Alignment = mFfsValidAlign[Index];
+      break;
+    }
+  }
+  if (Index == sizeof (mFfsValidAlignName) / sizeof (CHAR8 *) &&
+      stricmp(AlignName, "1") != 0 && stricmp(AlignName, "2") != 0 && stricmp(AlignName, "4") != 0) {
+    PyErr_Format(PyExc_Exception, "Invalid file alignment %s\n", AlignName);
+    return NULL;
+  }
+
+  Attributes = 0;
+  if (Fixed) {
+    Attributes |= FFS_ATTRIB_FIXED;
+  }
+  if (Checksum) {
+    Attributes |= FFS_ATTRIB_CHECKSUM;
+  }
+
+  Sequence = PySequence_Fast(SectionList, "Third argument is not a sequence\n");
+  if (Sequence == NULL) {
+    return NULL;
+  }
+  Inputs = GetSectionInputs(Sequence, &InputNum);
+  if (Inputs == NULL) {
+    Py_DECREF(Sequence);
+    return NULL;
+  }
+
+  OutBuffer = NULL;
+  Py_BEGIN_ALLOW_THREADS
+  Status = FfsGenFile(FileType, &FileGuid, Attributes, Alignment, Inputs, InputNum, &OutBuffer, &OutSize);
+  Py_END_ALLOW_THREADS
+
+  PyMem_Free(Inputs);
+  Py_DECREF(Sequence);
+  return ReturnBuffer(Status, OutBuffer, OutSize, "Failed to generate FFS file\n");
+}
+
+/*
+ GenFv(InfContents, FvFileName, MapFileName = None, Files = None)
+
+ Files maps FFS file names listed in the INF to their contents. The FV is
+ returned; its map and report files are written next to FvFileName.
+*/
+STATIC
+PyObject*
+GenFv (
+  PyObject    *Self,
+  PyObject    *Args
+  )
+{
+  CHAR8         *InfData;
+  Py_ssize_t    InfSize;
+  CHAR8         *FvFileName;
+  CHAR8         *MapFileName;
+  PyObject      *Files;
+  PyObject      *Key;
+  PyObject      *Value;
+  Py_ssize_t    Position;
+  CHAR8         *Name;
+  CHAR8         *Data;
+  Py_ssize_t    DataSize;
+  CHAR8         *InfImage;
+  UINT8         *OutBuffer;
+  UINTN         OutSize;
+  EFI_STATUS    Status;
+
+  MapFileName = NULL;
+  Files       = NULL;
+  if (!PyArg_ParseTuple(Args, "s#s|zO", &InfData, &InfSize, &FvFileName, &MapFileName, &Files)) {
+    return NULL;
+  }
+  if (Files != NULL && Files != Py_None && !PyDict_Check(Files)) {
+    PyErr_SetString(PyExc_Exception, "Files is not a dictionary\n");
+    return NULL;
+  }
+
+  //
+  // The INF parser needs a terminated copy of the contents
+  //
+  InfImage = PyMem_Malloc(InfSize + 1);
+  if (InfImage == NULL) {
+    PyErr_SetString(PyExc_Exception, "Not enough memory\n");
+    return NULL;
+  }
+  memcpy(InfImage, InfData, InfSize);
+  InfImage[InfSize] = '\0';
+
+  memset (&mFvDataInfo, 0, sizeof (FV_INFO));
+  memcpy (&mFvDataInfo.FvFileSystemGuid, &mEfiFirmwareFileSystem2Guid, sizeof (EFI_GUID));
+  mFvDataInfo.ForceRebase = -1;
+
+  Status = EFI_SUCCESS;
+  if (Files != NULL && Files != Py_None) {
+    Position = 0;
+    while (PyDict_Next(Files, &Position, &Key, &Value)) {
+      Name = PyString_AsString(Key);
+      if (Name == NULL || PyString_AsStringAndSize(Value, &Data, &DataSize) != 0) {
+        ReleaseFvInfo(&mFvDataInfo);
+        PyMem_Free(InfImage);
+        return NULL;
+      }
+      Status = AddFvFileBuffer(&mFvDataInfo, Name, (UINT8 *)Data, (UINTN)DataSize);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+    }
+  }
+
+  OutBuffer = NULL;
+  OutSize   = 0;
+  if (!EFI_ERROR (Status)) {
+    Status = GenerateFvImageBuffer(InfImage, (UINTN)InfSize, FvFileName, MapFileName, &OutBuffer, &OutSize);
+  }
+
+  ReleaseFvInfo(&mFvDataInfo);
+  PyMem_Free(InfImage);
+  return ReturnBuffer(Status, OutBuffer, OutSize, "Failed to generate FV image\n");
+}
+
+STATIC CHAR8 GenLeafSectionDocs[] = "GenLeafSection(): Add a section header of the given type to data\n";
+STATIC CHAR8 GenVersionSectionDocs[] = "GenVersionSection(): Generate a version section\n";
+STATIC CHAR8 GenUserInterfaceSectionDocs[] = "GenUserInterfaceSection(): Generate a user interface section\n";
+STATIC CHAR8 GenCompressionSectionDocs[] = "GenCompressionSection(): Generate a compression section holding sections\n";
+STATIC CHAR8 GenGuidDefinedSectionDocs[] = "GenGuidDefinedSection(): Generate a GUID defined section holding sections\n";
+STATIC CHAR8 GenFfsDocs[] = "GenFfs(): Generate an FFS file holding sections\n";
+STATIC CHAR8 GenFvDocs[] = "GenFv(): Generate an FV image from an FV INF description\n";
+
+STATIC PyMethodDef GenFdsLib_Funcs[] = {
+  {"GenLeafSection", (PyCFunction)GenLeafSection, METH_VARARGS, GenLeafSectionDocs},
+  {"GenVersionSection", (PyCFunction)GenVersionSection, METH_VARARGS, GenVersionSectionDocs},
+  {"GenUserInterfaceSection", (PyCFunction)GenUserInterfaceSection, METH_VARARGS, GenUserInterfaceSectionDocs},
+  {"GenCompressionSection", (PyCFunction)GenCompressionSection, METH_VARARGS, GenCompressionSectionDocs},
+  {"GenGuidDefinedSection", (PyCFunction)GenGuidDefinedSection, METH_VARARGS, GenGuidDefinedSectionDocs},
+  {"GenFfs", (PyCFunction)GenFfs, METH_VARARGS, GenFfsDocs},
+  {"GenFv", (PyCFunction)GenFv, METH_VARARGS, GenFvDocs},
+  {NULL, NULL, 0, NULL}
+};
+
+PyMODINIT_FUNC
+initGenFdsLib(VOID) {
+  PyObject  *Module;
+
+  SetUtilityName ("GenFdsLib");
+
+  //
+  // Read the cache settings and select the CRC32 engine now, as sections
+  // are built without the interpreter lock and may run on several threads.
+  //
+  CompressCacheEnabled ();
+  Crc32SetEngine (Crc32EngineAuto);
+
+  Module = Py_InitModule3("GenFdsLib", GenFdsLib_Funcs, "Section, FFS and FV Generation Extension Module");
+  if (Module == NULL) {
+    return;
+  }
+  PyModule_AddIntConstant(Module, "PROCESSING_REQUIRED", EFI_GUIDED_SECTION_PROCESSING_REQUIRED);
+  PyModule_AddIntConstant(Module, "AUTH_STATUS_VALID", EFI_GUIDED_SECTION_AUTH_STATUS_VALID);
+}
@@ -0,0 +1,64 @@
+## @file
+# package and install GenFdsLib extension
+#
+#  Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+from distutils.core import setup, Extension
+import glob
+import os
+import struct
+
+if 'BASE_TOOLS_PATH' not in os.environ:
+    raise "Please define BASE_TOOLS_PATH to the root of base tools tree"
+
+BaseToolsDir = os.environ['BASE_TOOLS_PATH']
+SourceDir = os.path.join(BaseToolsDir, 'Source', 'C')
+
+#
+# UINTN must match the pointer size of the interpreter
+#
+if struct.calcsize('P') == 8:
+    ArchDir = 'X64'
+else:
+    ArchDir = 'Ia32'
+
+Libraries = []
+if os.name == 'posix':
+    Libraries.append('pthread')
+
+setup(
+    name="GenFdsLib",
+    version="0.01",
+    ext_modules=[
+        Extension(
+            'GenFdsLib',
+            sources=
+                sorted(glob.glob(os.path.join(SourceDir, 'Common', '*.c'))) + [
+                os.path.join(SourceDir, 'GenFv', 'GenFvInternalLib.c'),
+                'GenFdsLib.c'
+                ],
+            include_dirs=[
+                os.path.join(SourceDir, 'Include'),
+                os.path.join(SourceDir, 'Include', 'Common'),
+                os.path.join(SourceDir, 'Include', 'IndustryStandard'),
+                os.path.join(SourceDir, 'Include', ArchDir),
+                os.path.join(SourceDir, 'Common'),
+                os.path.join(SourceDir, 'GenFv')
+                ],
+            libraries=Libraries,
+            )
+        ],
+  )
+
@@ -42,7 +42,10 @@ Abstract:
 #include "FirmwareVolumeBufferLib.h"
 #include "OsPath.h"
 #include "ParseGuidedSectionTools.h"
+#include "ParseInf.h"
 #include "StringFuncs.h"
+#include "Sha256.h"
+#include "WorkerPool.h"
 
 //
 // Utility global variables
@@ -70,6 +73,45 @@ typedef struct _GUID_TO_BASENAME {
 
 static GUID_TO_BASENAME *mGuidBaseNameList = NULL;
 
+//
+// Inventory of an FV built for the --json option. Every FV, FFS file and
+// section is a node; the children of an FV are its files, the children of a
+// file or encapsulation section are its sections, and the child of an FV
+// image section is the FV.
+//
+#define INVENTORY_FV        0
+#define INVENTORY_FILE      1
+#define INVENTORY_SECTION   2
+
+typedef struct _INVENTORY_NODE {
+  struct _INVENTORY_NODE  *Next;
+  struct _INVENTORY_NODE  *Child;
+  struct _INVENTORY_NODE  *LastChild;
+  struct _INVENTORY_NODE  *Same;        // Earlier section with the same bytes
+  struct _INVENTORY_NODE  *CacheNext;   // Next section in the decode cache
+  UINT8                   Kind;
+  UINT8                   Type;
+  UINT8                   State;
+  UINT8                   CompressionType;
+  BOOLEAN                 Pending;      // Section still has to be decoded
+  BOOLEAN                 HasGuid;
+  BOOLEAN                 HasName;
+  BOOLEAN                 OwnsDecoded;
+  UINT16                  BuildNumber;
+  UINT32                  Attributes;
+  UINT32                  Offset;
+  UINT32                  Size;
+  UINT32                  EncodedSize;
+  UINT32                  DecodedSize;
+  UINT8                   *Data;
+  UINT8                   *Decoded;
+  EFI_GUID                Guid;
+  EFI_GUID                Name;
+  CHAR8                   *Text;
+  CHAR8                   *Error;
+  UINT8                   Digest[SHA256_DIGEST_SIZE];
+} INVENTORY_NODE;
+
 //
 // Store GUIDed Section guid->tool mapping
 //
@@ -133,6 +175,16 @@ LoadGuidedSectionToolsTxt (
   IN CHAR8* FirmwareVolumeFilename
   );
 
+STATIC
+EFI_STATUS
+WriteFvInventory (
+  IN VOID     *Fv,
+  IN UINT32   FvSize,
+  IN CHAR8    *ImageName,
+  IN CHAR8    *JsonFileName,
+  IN UINTN    ThreadCount
+  );
+
 void
 Usage (
   VOID
@@ -167,6 +219,8 @@ Returns:
   EFI_STATUS                  Status;
   int                         Offset;
   BOOLEAN                     ErasePolarity;
+  CHAR8                       *JsonFileName;
+  UINT64                      ThreadCount;
 
   SetUtilityName (UTILITY_NAME);
   //
@@ -187,7 +241,9 @@ Returns:
   argc--;
   argv++;
 
-  Offset = 0;
+  Offset       = 0;
+  JsonFileName = NULL;
+  ThreadCount  = 0;
 
   //
   // If they specified -x xref guid/basename cross-reference files, process it.
@@ -223,6 +279,18 @@ Returns:
         }
       }
 
+      argc -= 2;
+      argv += 2;
+    } else if (strcmp(argv[0], "--json") == 0) {
+      JsonFileName = argv[1];
+      argc -= 2;
+      argv += 2;
+    } else if ((strcmp(argv[0], "-j") == 0) || (strcmp(argv[0], "--threads") == 0)) {
+      Status = AsciiStringToUint64 (argv[1], FALSE, &ThreadCount);
+      if (EFI_ERROR (Status) || ThreadCount > 0xFFFFFFFF) {
+        Error (NULL, 0, 1003, "Invalid option value", "%s = %s", argv[0], argv[1]);
+        return GetUtilityStatus ();
+      }
       argc -= 2;
       argv += 2;
     } else {
@@ -293,7 +361,11 @@ Returns:
 
   LoadGuidedSectionToolsTxt (argv[0]);
 
-  PrintFvInfo (FvImage, FALSE);
+  if (JsonFileName != NULL) {
+    WriteFvInventory (FvImage, FvSize, argv[0], JsonFileName, (UINTN) ThreadCount);
+  } else {
+    PrintFvInfo (FvImage, FALSE);
+  }
 
   //
   // Clean up
@@ -580,6 +652,62 @@ Returns:
   return SectionStr;
 }
 
+STATIC
+CHAR8 *
+FileTypeToStr (
+  IN EFI_FV_FILETYPE    Type
+  )
+/*++
+
+Routine Description:
+
+  Converts FFS file types to Strings
+
+Arguments:
+
+  Type  - The FFS file type
+
+Returns:
+
+  CHAR8* - Pointer to a constant string with the file type name, or NULL
+           if the type is not recognized.
+
+--*/
+{
+  switch (Type) {
+  case EFI_FV_FILETYPE_RAW:
+    return "EFI_FV_FILETYPE_RAW";
+  case EFI_FV_FILETYPE_FREEFORM:
+    return "EFI_FV_FILETYPE_FREEFORM";
+  case EFI_FV_FILETYPE_SECURITY_CORE:
+    return "EFI_FV_FILETYPE_SECURITY_CORE";
+  case EFI_FV_FILETYPE_PEI_CORE:
+    return "EFI_FV_FILETYPE_PEI_CORE";
+  case EFI_FV_FILETYPE_DXE_CORE:
+    return "EFI_FV_FILETYPE_DXE_CORE";
+  case EFI_FV_FILETYPE_PEIM:
+    return "EFI_FV_FILETYPE_PEIM";
+  case EFI_FV_FILETYPE_DRIVER:
+    return "EFI_FV_FILETYPE_DRIVER";
+  case EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER:
+    return "EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER";
+  case EFI_FV_FILETYPE_APPLICATION:
+    return "EFI_FV_FILETYPE_APPLICATION";
+  case EFI_FV_FILETYPE_SMM:
+    return "EFI_FV_FILETYPE_SMM";
+  case EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE:
+    return "EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE";
+  case EFI_FV_FILETYPE_COMBINED_SMM_DXE:
+    return "EFI_FV_FILETYPE_COMBINED_SMM_DXE";
+  case EFI_FV_FILETYPE_SMM_CORE:
+    return "EFI_FV_FILETYPE_SMM_CORE";
+  case EFI_FV_FILETYPE_FFS_PAD:
+    return "EFI_FV_FILETYPE_FFS_PAD";
+  default:
+    return NULL;
+  }
+}
+
 STATIC
 EFI_STATUS
 ReadHeader (
@@ -979,6 +1107,7 @@ Returns:
   EFI_STATUS          Status;
   UINT8               GuidBuffer[PRINTED_GUID_BUFFER_SIZE];
   UINT32              HeaderSize;
+  CHAR8               *FileTypeName;
 #if (PI_SPECIFICATION_VERSION < 0x00010000) 
   UINT16              *Tail;
 #endif
@@ -1106,69 +1235,12 @@ Returns:
 
   printf ("File Type:        0x%02X  ", FileHeader->Type);
 
-  switch (FileHeader->Type) {
-
-  case EFI_FV_FILETYPE_RAW:
-    printf ("EFI_FV_FILETYPE_RAW\n");
-    break;
-
-  case EFI_FV_FILETYPE_FREEFORM:
-    printf ("EFI_FV_FILETYPE_FREEFORM\n");
-    break;
-
-  case EFI_FV_FILETYPE_SECURITY_CORE:
-    printf ("EFI_FV_FILETYPE_SECURITY_CORE\n");
-    break;
-
-  case EFI_FV_FILETYPE_PEI_CORE:
-    printf ("EFI_FV_FILETYPE_PEI_CORE\n");
-    break;
-
-  case EFI_FV_FILETYPE_DXE_CORE:
-    printf ("EFI_FV_FILETYPE_DXE_CORE\n");
-    break;
-
-  case EFI_FV_FILETYPE_PEIM:
-    printf ("EFI_FV_FILETYPE_PEIM\n");
-    break;
-
-  case EFI_FV_FILETYPE_DRIVER:
-    printf ("EFI_FV_FILETYPE_DRIVER\n");
-    break;
-
-  case EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER:
-    printf ("EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER\n");
-    break;
-
-  case EFI_FV_FILETYPE_APPLICATION:
-    printf ("EFI_FV_FILETYPE_APPLICATION\n");
-    break;
-
-  case EFI_FV_FILETYPE_SMM:
-    printf ("EFI_FV_FILETYPE_SMM\n");
-    break;
-
-  case EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE:
-    printf ("EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE\n");
-    break;
-
-  case EFI_FV_FILETYPE_COMBINED_SMM_DXE:
-    printf ("EFI_FV_FILETYPE_COMBINED_SMM_DXE\n");
-    break;
-
-  case EFI_FV_FILETYPE_SMM_CORE:
-    printf ("EFI_FV_FILETYPE_SMM_CORE\n");
-    break;
-
-  case EFI_FV_FILETYPE_FFS_PAD:
-    printf ("EFI_FV_FILETYPE_FFS_PAD\n");
-    break;
-
-  default:
+  FileTypeName = FileTypeToStr (FileHeader->Type);
+  if (FileTypeName == NULL) {
     printf ("\nERROR: Unrecognized file type %X.\n", FileHeader->Type);
     return EFI_ABORTED;
-    break;
   }
+  printf ("%s\n", FileTypeName);
 
   switch (FileHeader->Type) {
 
@@ -1197,6 +1269,69 @@ Returns:
   return EFI_SUCCESS;
 }
 
+STATIC
+EFI_STATUS
+DecompressSectionData (
+  IN  UINT8   *Source,
+  IN  UINT32  SrcSize,
+  OUT UINT8   *Destination,
+  IN  UINT32  DstSize
+  )
+/*++
+
+Routine Description:
+
+  Decompress the data of an EFI_STANDARD_COMPRESSION section with the
+  streaming decompressor, which needs no scratch buffer.
+
+Arguments:
+
+  Source      - The compressed data
+  SrcSize     - The size of Source
+  Destination - Receives the decompressed data
+  DstSize     - The uncompressed length from the section header
+
+Returns:
+
+  EFI_SUCCESS           - The data was decompressed.
+  EFI_BAD_BUFFER_SIZE   - The data does not decompress to DstSize bytes.
+  EFI_INVALID_PARAMETER - The data is corrupted or truncated.
+  EFI_OUT_OF_RESOURCES  - Memory allocation failed.
+
+--*/
+{
+  DECOMPRESS_STREAM   *Stream;
+  UINT32              InOffset;
+  UINT32              OutOffset;
+  UINT32              InSize;
+  UINT32              OutSize;
+  UINT32              OrigSize;
+  EFI_STATUS          Status;
+
+  Status = DecompressStreamCreate (1, &Stream);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  InOffset  = 0;
+  OutOffset = 0;
+  do {
+    InSize     = SrcSize - InOffset;
+    OutSize    = DstSize - OutOffset;
+    Status     = DecompressStreamProcess (Stream, Source + InOffset, &InSize, Destination + OutOffset, &OutSize);
+    InOffset  += InSize;
+    OutOffset += OutSize;
+  } while (Status == EFI_NOT_READY && (InSize != 0 || OutSize != 0));
+
+  if (DecompressStreamGetInfo (Stream, &OrigSize) == EFI_SUCCESS && OrigSize != DstSize) {
+    Status = EFI_BAD_BUFFER_SIZE;
+  } else if (Status == EFI_NOT_READY) {
+    Status = EFI_INVALID_PARAMETER;
+  }
+  DecompressStreamDestroy (Stream);
+  return Status;
+}
+
 EFI_STATUS
 ParseSection (
   IN UINT8  *SectionBuffer,
@@ -1238,11 +1373,6 @@ Returns:
   UINT8               *ToolOutputBuffer;
   UINT32              ToolOutputLength;
   UINT8               CompressionType;
-  UINT32              DstSize;
-  UINT32              ScratchSize;
-  UINT8               *ScratchBuffer;
-  DECOMPRESS_FUNCTION DecompressFunction;
-  GETINFO_FUNCTION    GetInfoFunction;
   // CHAR16              *name;
   CHAR8               *ExtractionTool;
   CHAR8               *ToolInputFile;
@@ -1350,37 +1480,24 @@ Returns:
 
         UncompressedBuffer = Ptr + RealHdrLen;
       } else if (CompressionType == EFI_STANDARD_COMPRESSION) {
-        GetInfoFunction     = EfiGetInfo;
-        DecompressFunction  = EfiDecompress;
         printf ("  Compression Type:  EFI_STANDARD_COMPRESSION\n");
 
-        CompressedBuffer  = Ptr + RealHdrLen;
-
-        Status            = GetInfoFunction (CompressedBuffer, CompressedLength, &DstSize, &ScratchSize);
-        if (EFI_ERROR (Status)) {
-          Error (NULL, 0, 0003, "error getting compression info from compression section", NULL);
-          return EFI_SECTION_ERROR;
-        }
-
-        if (DstSize != UncompressedLength) {
-          Error (NULL, 0, 0003, "compression error in the compression section", NULL);
-          return EFI_SECTION_ERROR;
-        }
-
-        ScratchBuffer       = malloc (ScratchSize);
+        CompressedBuffer    = Ptr + RealHdrLen;
         UncompressedBuffer  = malloc (UncompressedLength);
-        if ((ScratchBuffer == NULL) || (UncompressedBuffer == NULL)) {
+        if (UncompressedBuffer == NULL) {
           return EFI_OUT_OF_RESOURCES;
         }
-        Status = DecompressFunction (
+        Status = DecompressSectionData (
                   CompressedBuffer,
                   CompressedLength,
                   UncompressedBuffer,
-                  UncompressedLength,
-                  ScratchBuffer,
-                  ScratchSize
+                  UncompressedLength
                   );
-        free (ScratchBuffer);
+        if (Status == EFI_BAD_BUFFER_SIZE) {
+          Error (NULL, 0, 0003, "compression error in the compression section", NULL);
+          free (UncompressedBuffer);
+          return EFI_SECTION_ERROR;
+        }
         if (EFI_ERROR (Status)) {
           Error (NULL, 0, 0003, "decompress failed", NULL);
           free (UncompressedBuffer);
@@ -1810,6 +1927,1072 @@ LoadGuidedSectionToolsTxt (
 }
 
 
+STATIC
+INVENTORY_NODE *
+AddInventoryNode (
+  IN INVENTORY_NODE   *Parent,
+  IN UINT8            Kind,
+  IN UINT8            *Data,
+  IN UINT32           Offset,
+  IN UINT32           Size
+  )
+/*++
+
+Routine Description:
+
+  Allocate an inventory node and append it to the children of Parent.
+
+Arguments:
+
+  Parent  - The parent node, or NULL for the root FV
+  Kind    - INVENTORY_FV, INVENTORY_FILE or INVENTORY_SECTION
+  Data    - The bytes the node describes
+  Offset  - Offset of Data in the contents of the parent
+  Size    - Size of Data in bytes
+
+Returns:
+
+  The new node, or NULL if out of memory.
+
+--*/
+{
+  INVENTORY_NODE  *Node;
+
+  Node = malloc (sizeof (INVENTORY_NODE));
+  if (Node == NULL) {
+    if (Parent != NULL && Parent->Error == NULL) {
+      Parent->Error = "out of memory";
+    }
+    return NULL;
+  }
+  memset (Node, 0, sizeof (INVENTORY_NODE));
+  Node->Kind    = Kind;
+  Node->Data    = Data;
+  Node->Offset  = Offset;
+  Node->Size    = Size;
+
+  if (Parent != NULL) {
+    if (Parent->LastChild == NULL) {
+      Parent->Child = Node;
+    } else {
+      Parent->LastChild->Next = Node;
+    }
+    Parent->LastChild = Node;
+  }
+  return Node;
+}
+
+STATIC
+VOID
+FreeInventoryNode (
+  IN INVENTORY_NODE   *Node
+  )
+/*++
+
+Routine Description:
+
+  Free an inventory node, its children and the buffers it decoded.
+
+Arguments:
+
+  Node  - The node to free
+
+Returns:
+
+  None
+
+--*/
+{
+  INVENTORY_NODE  *Child;
+  INVENTORY_NODE  *Next;
+
+  for (Child = Node->Child; Child != NULL; Child = Next) {
+    Next = Child->Next;
+    FreeInventoryNode (Child);
+  }
+  if (Node->OwnsDecoded) {
+    free (Node->Decoded);
+  }
+  free (Node->Text);
+  free (Node);
+}
+
+STATIC
+CHAR8 *
+Ucs2ToAsciiString (
+  IN CHAR16   *String,
+  IN UINTN    MaxLength
+  )
+/*++
+
+Routine Description:
+
+  Make an ASCII copy of a UCS-2 string stored in a section. Characters
+  outside of the printable ASCII range are replaced by '?'.
+
+Arguments:
+
+  String    - The UCS-2 string, which need not be aligned
+  MaxLength - The maximum number of characters to read
+
+Returns:
+
+  The allocated ASCII string, or NULL if out of memory.
+
+--*/
+{
+  CHAR8   *Ascii;
+  UINTN   Index;
+  UINT16  Char;
+
+  Ascii = malloc (MaxLength + 1);
+  if (Ascii == NULL) {
+    return NULL;
+  }
+  for (Index = 0; Index < MaxLength; Index++) {
+    memcpy (&Char, &String[Index], sizeof (Char));
+    if (Char == 0) {
+      break;
+    }
+    Ascii[Index] = (CHAR8) ((Char >= 0x20 && Char < 0x7F) ? Char : '?');
+  }
+  Ascii[Index] = 0;
+  return Ascii;
+}
+
+STATIC
+VOID
+AddInventorySections (
+  IN INVENTORY_NODE   *Parent,
+  IN UINT8            *Buffer,
+  IN UINT32           Start,
+  IN UINT32           Length
+  )
+/*++
+
+Routine Description:
+
+  Add a node for every section found in Buffer to the children of Parent.
+  Encapsulation sections are not decoded here. They are marked pending and
+  hashed, so that identical ones are decoded once by a later job.
+
+Arguments:
+
+  Parent  - The file or encapsulation section holding the sections
+  Buffer  - The contents of Parent
+  Start   - Offset of the first section in Buffer
+  Length  - Size of Buffer in bytes
+
+Returns:
+
+  None. Problems are recorded in the Error field of the nodes.
+
+--*/
+{
+  INVENTORY_NODE      *Node;
+  UINT8               *Ptr;
+  UINT32              ParsedLength;
+  UINT32              SectionLength;
+  UINT32              SectionHeaderLen;
+  UINT32              StringLength;
+  SHA256_CONTEXT      Context;
+
+  ParsedLength = Start;
+  while (ParsedLength < Length) {
+    Ptr = Buffer + ParsedLength;
+    if (Length - ParsedLength < sizeof (EFI_COMMON_SECTION_HEADER)) {
+      Parent->Error = "sections do not completely fill the sectioned buffer being parsed";
+      return;
+    }
+
+    //
+    // FFS files are padded to a QWORD boundary, so there may be a whole
+    // section header worth of 0xFF bytes.
+    //
+    if (GetLength (((EFI_COMMON_SECTION_HEADER *) Ptr)->Size) == 0xffffff &&
+        ((EFI_COMMON_SECTION_HEADER *) Ptr)->Type == 0xff) {
+      ParsedLength += 4;
+      continue;
+    }
+
+    SectionHeaderLen = GetSectionHeaderLength ((EFI_COMMON_SECTION_HEADER *) Ptr);
+    SectionLength    = GetSectionFileLength ((EFI_COMMON_SECTION_HEADER *) Ptr);
+    if (SectionHeaderLen > Length - ParsedLength ||
+        SectionLength < SectionHeaderLen ||
+        SectionLength > Length - ParsedLength) {
+      Parent->Error = "section size is outside of the sectioned buffer being parsed";
+      return;
+    }
+
+    Node = AddInventoryNode (Parent, INVENTORY_SECTION, Ptr, ParsedLength, SectionLength);
+    if (Node == NULL) {
+      return;
+    }
+    Node->Type = ((EFI_COMMON_SECTION_HEADER *) Ptr)->Type;
+
+    switch (Node->Type) {
+    case EFI_SECTION_RAW:
+    case EFI_SECTION_PE32:
+    case EFI_SECTION_PIC:
+    case EFI_SECTION_TE:
+    case EFI_SECTION_COMPATIBILITY16:
+    case EFI_SECTION_PEI_DEPEX:
+    case EFI_SECTION_DXE_DEPEX:
+    case EFI_SECTION_SMM_DEPEX:
+      break;
+
+    case EFI_SECTION_USER_INTERFACE:
+      StringLength = (SectionLength - SectionHeaderLen) / sizeof (CHAR16);
+      Node->Text   = Ucs2ToAsciiString ((CHAR16 *) (Ptr + SectionHeaderLen), StringLength);
+      break;
+
+    case EFI_SECTION_VERSION:
+      if (SectionLength - SectionHeaderLen < sizeof (UINT16)) {
+        Node->Error = "version section is too small";
+        break;
+      }
+      memcpy (&Node->BuildNumber, Ptr + SectionHeaderLen, sizeof (UINT16));
+      StringLength = (SectionLength - SectionHeaderLen - sizeof (UINT16)) / sizeof (CHAR16);
+      Node->Text   = Ucs2ToAsciiString ((CHAR16 *) (Ptr + SectionHeaderLen + sizeof (UINT16)), StringLength);
+      break;
+
+    case EFI_SECTION_FREEFORM_SUBTYPE_GUID:
+      if (SectionLength - SectionHeaderLen < sizeof (EFI_GUID)) {
+        Node->Error = "freeform subtype GUID section is too small";
+        break;
+      }
+      memcpy (&Node->Guid, Ptr + SectionHeaderLen, sizeof (EFI_GUID));
+      Node->HasGuid = TRUE;
+      break;
+
+    case EFI_SECTION_COMPRESSION:
+    case EFI_SECTION_GUID_DEFINED:
+    case EFI_SECTION_FIRMWARE_VOLUME_IMAGE:
+      Sha256Init (&Context);
+      Sha256Update (&Context, Ptr, SectionLength);
+      Sha256Final (&Context, Node->Digest);
+      Node->Pending = TRUE;
+      break;
+
+    default:
+      Node->Error = "unrecognized section type found";
+      break;
+    }
+
+    ParsedLength += SectionLength;
+    //
+    // We make then next section begin on a 4-byte boundary
+    //
+    ParsedLength = GetOccupiedSize (ParsedLength, 4);
+  }
+}
+
+STATIC
+VOID
+AddInventoryFiles (
+  IN INVENTORY_NODE   *FvNode
+  )
+/*++
+
+Routine Description:
+
+  Add a node for every file of an FV, and nodes for the sections of the
+  files that have sections.
+
+Arguments:
+
+  FvNode  - The FV node. Its Data and Size give the FV image and the
+            number of bytes available for it.
+
+Returns:
+
+  None. Problems are recorded in the Error field of the nodes.
+
+--*/
+{
+  EFI_FIRMWARE_VOLUME_HEADER      *FvHeader;
+  EFI_FIRMWARE_VOLUME_EXT_HEADER  *ExtHeader;
+  EFI_FFS_FILE_HEADER             *FileHeader;
+  INVENTORY_NODE                  *Node;
+  EFI_STATUS                      Status;
+  UINTN                           Key;
+  UINT32                          HeaderSize;
+  UINT32                          FileLength;
+  UINT8                           Checksum;
+
+  FvHeader = (EFI_FIRMWARE_VOLUME_HEADER *) FvNode->Data;
+  if (FvNode->Size < sizeof (EFI_FIRMWARE_VOLUME_HEADER) ||
+      FvHeader->Signature != EFI_FVH_SIGNATURE ||
+      FvHeader->HeaderLength > FvNode->Size ||
+      FvHeader->FvLength > FvNode->Size) {
+    FvNode->Error = "invalid firmware volume header";
+    return;
+  }
+
+  FvNode->Size       = (UINT32) FvHeader->FvLength;
+  FvNode->Attributes = FvHeader->Attributes;
+  memcpy (&FvNode->Guid, &FvHeader->FileSystemGuid, sizeof (EFI_GUID));
+  FvNode->HasGuid    = TRUE;
+  if (FvHeader->ExtHeaderOffset != 0 &&
+      FvHeader->ExtHeaderOffset + sizeof (EFI_FIRMWARE_VOLUME_EXT_HEADER) <= FvNode->Size) {
+    ExtHeader = (EFI_FIRMWARE_VOLUME_EXT_HEADER *) (FvNode->Data + FvHeader->ExtHeaderOffset);
+    memcpy (&FvNode->Name, &ExtHeader->FvName, sizeof (EFI_GUID));
+    FvNode->HasName = TRUE;
+  }
+
+  Key    = 0;
+  Status = FvBufFindNextFile (FvHeader, &Key, (VOID **) &FileHeader);
+  while (!EFI_ERROR (Status)) {
+    HeaderSize = FvBufGetFfsHeaderSize (FileHeader);
+    FileLength = FvBufGetFfsFileSize (FileHeader);
+    if (FileLength < HeaderSize ||
+        (UINTN) FileHeader - (UINTN) FvHeader + FileLength > FvNode->Size) {
+      FvNode->Error = "FFS file size is outside of the firmware volume";
+      return;
+    }
+
+    Node = AddInventoryNode (FvNode, INVENTORY_FILE, (UINT8 *) FileHeader, (UINT32) ((UINTN) FileHeader - (UINTN) FvHeader), FileLength);
+    if (Node == NULL) {
+      return;
+    }
+    memcpy (&Node->Name, &FileHeader->Name, sizeof (EFI_GUID));
+    Node->HasName    = TRUE;
+    Node->Type       = FileHeader->Type;
+    Node->Attributes = FileHeader->Attributes;
+    Node->State      = FileHeader->State;
+
+    //
+    // Check the header and file checksums
+    //
+    Checksum  = CalculateSum8 ((UINT8 *) FileHeader, HeaderSize);
+    Checksum  = (UINT8) (Checksum - FileHeader->IntegrityCheck.Checksum.File);
+    Checksum  = (UINT8) (Checksum - FileHeader->State);
+    if (Checksum != 0) {
+      Node->Error = "invalid header checksum";
+    } else if (FileHeader->Attributes & FFS_ATTRIB_CHECKSUM) {
+      Checksum  = CalculateSum8 ((UINT8 *) FileHeader + HeaderSize, FileLength - HeaderSize);
+      Checksum  = (UINT8) (Checksum + FileHeader->IntegrityCheck.Checksum.File);
+      if (Checksum != 0) {
+        Node->Error = "invalid file checksum";
+      }
+    } else if (FileHeader->IntegrityCheck.Checksum.File != FFS_FIXED_CHECKSUM) {
+      Node->Error = "invalid header checksum -- not set to fixed value of 0xAA";
+    }
+
+    if (Node->Error == NULL) {
+      switch (FileHeader->Type) {
+      case EFI_FV_FILETYPE_ALL:
+      case EFI_FV_FILETYPE_RAW:
+      case EFI_FV_FILETYPE_FFS_PAD:
+        break;
+
+      default:
+        if (FileTypeToStr (FileHeader->Type) == NULL) {
+          Node->Error = "unrecognized file type";
+        } else {
+          AddInventorySections (Node, (UINT8 *) FileHeader, HeaderSize, FileLength);
+        }
+        break;
+      }
+    }
+
+    Status = FvBufFindNextFile (FvHeader, &Key, (VOID **) &FileHeader);
+  }
+
+  if (Status != EFI_NOT_FOUND) {
+    FvNode->Error = "cannot find the next file in the FV image";
+  }
+}
+
+STATIC
+VOID
+RunGuidedSectionTool (
+  IN INVENTORY_NODE   *Node,
+  IN CHAR8            *ExtractionTool,
+  IN UINT8            *Data,
+  IN UINT32           DataLength
+  )
+/*++
+
+Routine Description:
+
+  Decode the data of a GUID defined section with the external tool listed
+  for it in GuidedSectionTools.txt. Each call uses its own temporary files,
+  so several tools may run at the same time.
+
+Arguments:
+
+  Node            - The GUID defined section node, which receives the
+                    decoded buffer
+  ExtractionTool  - The path of the tool
+  Data            - The encoded data of the section
+  DataLength      - Size of Data in bytes
+
+Returns:
+
+  None. A failure is recorded in the Error field of Node.
+
+--*/
+{
+  CHAR8       ToolInputFile[L_tmpnam];
+  CHAR8       ToolOutputFile[L_tmpnam];
+  CHAR8       *SystemCommandFormatString;
+  CHAR8       *SystemCommand;
+  EFI_STATUS  Status;
+
+  if (tmpnam (ToolInputFile) == NULL || tmpnam (ToolOutputFile) == NULL) {
+    Node->Error = "unable to create a temporary file name";
+    return;
+  }
+
+  SystemCommandFormatString = "%s -d -o %s %s";
+  SystemCommand = malloc (
+    strlen (SystemCommandFormatString) +
+    strlen (ExtractionTool) +
+    strlen (ToolInputFile) +
+    strlen (ToolOutputFile) +
+    1
+    );
+  if (SystemCommand == NULL) {
+    Node->Error = "out of memory";
+    return;
+  }
+  sprintf (
+    SystemCommand,
+    SystemCommandFormatString,
+    ExtractionTool,
+    ToolOutputFile,
+    ToolInputFile
+    );
+
+  Status = PutFileImage (ToolInputFile, (CHAR8 *) Data, DataLength);
+  if (!EFI_ERROR (Status)) {
+    system (SystemCommand);
+    Status = GetFileImage (ToolOutputFile, (CHAR8 **) &Node->Decoded, &Node->DecodedSize);
+  }
+  remove (ToolInputFile);
+  remove (ToolOutputFile);
+  free (SystemCommand);
+
+  if (EFI_ERROR (Status)) {
+    Node->Error = "unable to read decoded GUIDED section";
+    return;
+  }
+  Node->OwnsDecoded = TRUE;
+}
+
+STATIC
+VOID
+DecodeInventorySection (
+  IN INVENTORY_NODE   *Node
+  )
+/*++
+
+Routine Description:
+
+  Decode a pending encapsulation section and add nodes for its contents.
+  This runs as a worker pool job, and only touches Node and the nodes it
+  creates below it.
+
+Arguments:
+
+  Node  - The compression, GUID defined or FV image section node
+
+Returns:
+
+  None. Problems are recorded in the Error field of the nodes.
+
+--*/
+{
+  UINT8           *Ptr;
+  UINT32          SectionHeaderLen;
+  UINT32          RealHdrLen;
+  CHAR8           *ExtractionTool;
+  UINT16          DataOffset;
+  EFI_STATUS      Status;
+  INVENTORY_NODE  *FvNode;
+
+  Ptr              = Node->Data;
+  SectionHeaderLen = GetSectionHeaderLength ((EFI_COMMON_SECTION_HEADER *) Ptr);
+
+  switch (Node->Type) {
+  case EFI_SECTION_FIRMWARE_VOLUME_IMAGE:
+    FvNode = AddInventoryNode (Node, INVENTORY_FV, Ptr + SectionHeaderLen, SectionHeaderLen, Node->Size - SectionHeaderLen);
+    if (FvNode != NULL) {
+      AddInventoryFiles (FvNode);
+    }
+    return;
+
+  case EFI_SECTION_COMPRESSION:
+    if (SectionHeaderLen == sizeof (EFI_COMMON_SECTION_HEADER)) {
+      RealHdrLen            = sizeof (EFI_COMPRESSION_SECTION);
+      Node->DecodedSize     = ((EFI_COMPRESSION_SECTION *) Ptr)->UncompressedLength;
+      Node->CompressionType = ((EFI_COMPRESSION_SECTION *) Ptr)->CompressionType;
+    } else {
+      RealHdrLen            = sizeof (EFI_COMPRESSION_SECTION2);
+      Node->DecodedSize     = ((EFI_COMPRESSION_SECTION2 *) Ptr)->UncompressedLength;
+      Node->CompressionType = ((EFI_COMPRESSION_SECTION2 *) Ptr)->CompressionType;
+    }
+    if (Node->Size < RealHdrLen) {
+      Node->Error = "compression section is too small";
+      return;
+    }
+    Node->EncodedSize = Node->Size - RealHdrLen;
+
+    if (Node->CompressionType == EFI_NOT_COMPRESSED) {
+      if (Node->EncodedSize != Node->DecodedSize) {
+        Node->Error = "file is not compressed, but the compressed length does not match the uncompressed length";
+        return;
+      }
+      Node->Decoded = Ptr + RealHdrLen;
+    } else if (Node->CompressionType == EFI_STANDARD_COMPRESSION) {
+      Node->Decoded = malloc (Node->DecodedSize);
+      if (Node->Decoded == NULL) {
+        Node->Error = "out of memory";
+        return;
+      }
+      Node->OwnsDecoded = TRUE;
+      Status = DecompressSectionData (Ptr + RealHdrLen, Node->EncodedSize, Node->Decoded, Node->DecodedSize);
+      if (Status == EFI_BAD_BUFFER_SIZE) {
+        Node->Error = "compression error in the compression section";
+        return;
+      }
+      if (EFI_ERROR (Status)) {
+        Node->Error = "decompress failed";
+        return;
+      }
+    } else {
+      Node->Error = "unrecognized compression type";
+      return;
+    }
+    break;
+
+  case EFI_SECTION_GUID_DEFINED:
+    if (SectionHeaderLen == sizeof (EFI_COMMON_SECTION_HEADER)) {
+      RealHdrLen       = sizeof (EFI_GUID_DEFINED_SECTION);
+    } else {
+      RealHdrLen       = sizeof (EFI_GUID_DEFINED_SECTION2);
+    }
+    if (Node->Size < RealHdrLen) {
+      Node->Error = "GUID defined section is too small";
+      return;
+    }
+    if (SectionHeaderLen == sizeof (EFI_COMMON_SECTION_HEADER)) {
+      memcpy (&Node->Guid, &((EFI_GUID_DEFINED_SECTION *) Ptr)->SectionDefinitionGuid, sizeof (EFI_GUID));
+      DataOffset       = ((EFI_GUID_DEFINED_SECTION *) Ptr)->DataOffset;
+      Node->Attributes = ((EFI_GUID_DEFINED_SECTION *) Ptr)->Attributes;
+    } else {
+      memcpy (&Node->Guid, &((EFI_GUID_DEFINED_SECTION2 *) Ptr)->SectionDefinitionGuid, sizeof (EFI_GUID));
+      DataOffset       = ((EFI_GUID_DEFINED_SECTION2 *) Ptr)->DataOffset;
+      Node->Attributes = ((EFI_GUID_DEFINED_SECTION2 *) Ptr)->Attributes;
+    }
+    Node->HasGuid = TRUE;
+    if (DataOffset < RealHdrLen || DataOffset > Node->Size) {
+      Node->Error = "GUID defined section data offset is outside of the section";
+      return;
+    }
+    Node->EncodedSize = Node->Size - DataOffset;
+
+    ExtractionTool = LookupGuidedSectionToolPath (mParsedGuidedSectionTools, &Node->Guid);
+    if (ExtractionTool != NULL) {
+      RunGuidedSectionTool (Node, ExtractionTool, Ptr + DataOffset, Node->EncodedSize);
+      free (ExtractionTool);
+      if (Node->Error != NULL) {
+        return;
+      }
+    } else if (!CompareGuid (&Node->Guid, &gEfiCrc32GuidedSectionExtractionProtocolGuid)) {
+      //
+      // CRC32 guided section
+      //
+      Node->Decoded     = Ptr + DataOffset;
+      Node->DecodedSize = Node->EncodedSize;
+    } else {
+      Node->Error = "EFI_SECTION_GUID_DEFINED cannot be parsed at this time. Tool to decode this section should have been defined in GuidedSectionTools.txt (built in the FV directory).";
+      return;
+    }
+    break;
+
+  default:
+    return;
+  }
+
+  AddInventorySections (Node, Node->Decoded, 0, Node->DecodedSize);
+}
+
+STATIC
+VOID
+RunInventoryJob (
+  IN VOID     *Context,
+  IN UINTN    JobIndex
+  )
+/*++
+
+Routine Description:
+
+  Worker pool routine expanding one pending inventory node.
+
+Arguments:
+
+  Context   - The array of pending nodes
+  JobIndex  - Index of the node to expand
+
+Returns:
+
+  None
+
+--*/
+{
+  INVENTORY_NODE  *Node;
+
+  Node = ((INVENTORY_NODE **) Context)[JobIndex];
+  if (Node->Kind == INVENTORY_FV) {
+    AddInventoryFiles (Node);
+  } else {
+    DecodeInventorySection (Node);
+  }
+}
+
+STATIC
+EFI_STATUS
+CollectPendingNodes (
+  IN     INVENTORY_NODE   *Node,
+  IN OUT INVENTORY_NODE   ***Pending,
+  IN OUT UINTN            *PendingCount,
+  IN OUT UINTN            *PendingMax,
+  IN OUT INVENTORY_NODE   **Cache
+  )
+/*++
+
+Routine Description:
+
+  Collect the pending encapsulation sections below Node for the next wave
+  of jobs. A section whose bytes match an already collected one is not
+  decoded again; it refers to the first one through its Same field.
+
+Arguments:
+
+  Node          - The node to search below
+  Pending       - The growable array of pending nodes
+  PendingCount  - Number of nodes in Pending
+  PendingMax    - Number of nodes Pending has room for
+  Cache         - Hash table of the sections collected so far, indexed by
+                  the first byte of their digest
+
+Returns:
+
+  EFI_SUCCESS           - The pending nodes were collected.
+  EFI_OUT_OF_RESOURCES  - Pending could not be grown.
+
+--*/
+{
+  INVENTORY_NODE  *Child;
+  INVENTORY_NODE  *Cached;
+  INVENTORY_NODE  **NewPending;
+  EFI_STATUS      Status;
+
+  for (Child = Node->Child; Child != NULL; Child = Child->Next) {
+    if (!Child->Pending) {
+      Status = CollectPendingNodes (Child, Pending, PendingCount, PendingMax, Cache);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      continue;
+    }
+
+    for (Cached = Cache[Child->Digest[0]]; Cached != NULL; Cached = Cached->CacheNext) {
+      if (Cached->Size == Child->Size &&
+          memcmp (Cached->Digest, Child->Digest, SHA256_DIGEST_SIZE) == 0) {
+        break;
+      }
+    }
+    if (Cached != NULL) {
+      Child->Same    = Cached;
+      Child->Pending = FALSE;
+      continue;
+    }
+    Child->CacheNext              = Cache[Child->Digest[0]];
+    Cache[Child->Digest[0]]       = Child;
+
+    if (*PendingCount == *PendingMax) {
+      NewPending = realloc (*Pending, (*PendingMax * 2 + 16) * sizeof (INVENTORY_NODE *));
+      if (NewPending == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+      *Pending    = NewPending;
+      *PendingMax = *PendingMax * 2 + 16;
+    }
+    (*Pending)[(*PendingCount)++] = Child;
+  }
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+ReportInventoryErrors (
+  IN INVENTORY_NODE   *Node,
+  IN CHAR8            *FileName
+  )
+/*++
+
+Routine Description:
+
+  Report the problems recorded in the inventory, in the order of the image.
+
+Arguments:
+
+  Node      - The node to report on, with its children
+  FileName  - The printed name of the FFS file holding Node, or NULL
+
+Returns:
+
+  None
+
+--*/
+{
+  INVENTORY_NODE  *Child;
+  CHAR8           GuidBuffer[PRINTED_GUID_BUFFER_SIZE];
+
+  if (Node->Kind == INVENTORY_FILE) {
+    PrintGuidToBuffer (&Node->Name, (UINT8 *) GuidBuffer, sizeof (GuidBuffer), TRUE);
+    FileName = GuidBuffer;
+  }
+  if (Node->Error != NULL) {
+    if (FileName != NULL) {
+      Error (NULL, 0, 0003, "error parsing FFS file", "FFS file with Guid %s: %s", FileName, Node->Error);
+    } else {
+      Error (NULL, 0, 0003, "error parsing FV image", "%s", Node->Error);
+    }
+  }
+  for (Child = Node->Child; Child != NULL; Child = Child->Next) {
+    ReportInventoryErrors (Child, FileName);
+  }
+}
+
+STATIC
+VOID
+WriteJsonString (
+  IN FILE     *JsonFile,
+  IN CHAR8    *String
+  )
+/*++
+
+Routine Description:
+
+  Write a quoted and escaped JSON string.
+
+Arguments:
+
+  JsonFile  - The output file
+  String    - The ASCII string to write
+
+Returns:
+
+  None
+
+--*/
+{
+  fputc ('"', JsonFile);
+  for (; *String != 0; String++) {
+    if (*String == '"' || *String == '\\') {
+      fputc ('\\', JsonFile);
+      fputc (*String, JsonFile);
+    } else if ((UINT8) *String < 0x20) {
+      fprintf (JsonFile, "\\u%04x", (unsigned) (UINT8) *String);
+    } else {
+      fputc (*String, JsonFile);
+    }
+  }
+  fputc ('"', JsonFile);
+}
+
+STATIC
+VOID
+WriteJsonGuid (
+  IN FILE     *JsonFile,
+  IN UINTN    Indent,
+  IN CHAR8    *Key,
+  IN EFI_GUID *Guid
+  )
+/*++
+
+Routine Description:
+
+  Write a "Key": "GUID" member of a JSON object.
+
+Arguments:
+
+  JsonFile  - The output file
+  Indent    - Indentation of the member
+  Key       - The member name
+  Guid      - The GUID to print
+
+Returns:
+
+  None
+
+--*/
+{
+  UINT8   GuidBuffer[PRINTED_GUID_BUFFER_SIZE];
+
+  PrintGuidToBuffer (Guid, GuidBuffer, sizeof (GuidBuffer), TRUE);
+  fprintf (JsonFile, ",\n%*s\"%s\": \"%s\"", (int) Indent, "", Key, (CHAR8 *) GuidBuffer);
+}
+
+STATIC
+VOID
+WriteInventoryNode (
+  IN FILE             *JsonFile,
+  IN INVENTORY_NODE   *Node,
+  IN UINTN            Indent
+  )
+/*++
+
+Routine Description:
+
+  Write an inventory node and its children as a JSON object. Offsets are
+  relative to the contents of the parent: the enclosing FV for files, the
+  FFS file (from its header) or the decoded data of an encapsulation
+  section for sections.
+
+Arguments:
+
+  JsonFile  - The output file
+  Node      - The node to write
+  Indent    - Indentation of the object members
+
+Returns:
+
+  None
+
+--*/
+{
+  INVENTORY_NODE    *Contents;
+  INVENTORY_NODE    *Child;
+  GUID_TO_BASENAME  *GPtr;
+  CHAR8             *Name;
+  CHAR8             *Key;
+  UINTN             Length;
+  UINT8             GuidBuffer[PRINTED_GUID_BUFFER_SIZE];
+
+  fprintf (JsonFile, "{\n%*s\"offset\": %u,\n%*s\"size\": %u", (int) Indent, "", (unsigned) Node->Offset, (int) Indent, "", (unsigned) Node->Size);
+
+  //
+  // A section decoded to the same contents as an earlier one shares its
+  // decoded children.
+  //
+  Contents = (Node->Same != NULL) ? Node->Same : Node;
+
+  switch (Node->Kind) {
+  case INVENTORY_FV:
+    WriteJsonGuid (JsonFile, Indent, "fileSystemGuid", &Node->Guid);
+    if (Node->HasName) {
+      WriteJsonGuid (JsonFile, Indent, "name", &Node->Name);
+    }
+    fprintf (JsonFile, ",\n%*s\"attributes\": \"0x%08X\"", (int) Indent, "", (unsigned) Node->Attributes);
+    Key = "files";
+    break;
+
+  case INVENTORY_FILE:
+    WriteJsonGuid (JsonFile, Indent, "name", &Node->Name);
+    PrintGuidToBuffer (&Node->Name, GuidBuffer, sizeof (GuidBuffer), TRUE);
+    for (GPtr = mGuidBaseNameList; GPtr != NULL; GPtr = GPtr->Next) {
+      if (_stricmp ((CHAR8 *) GuidBuffer, (CHAR8 *) GPtr->Guid) == 0) {
+        fprintf (JsonFile, ",\n%*s\"baseName\": ", (int) Indent, "");
+        WriteJsonString (JsonFile, (CHAR8 *) GPtr->BaseName);
+        break;
+      }
+    }
+    Name = FileTypeToStr (Node->Type);
+    if (Name != NULL) {
+      fprintf (JsonFile, ",\n%*s\"type\": \"%s\"", (int) Indent, "", Name);
+    } else {
+      fprintf (JsonFile, ",\n%*s\"type\": \"0x%02X\"", (int) Indent, "", (unsigned) Node->Type);
+    }
+    fprintf (JsonFile, ",\n%*s\"attributes\": \"0x%02X\"", (int) Indent, "", (unsigned) Node->Attributes);
+    fprintf (JsonFile, ",\n%*s\"state\": \"0x%02X\"", (int) Indent, "", (unsigned) Node->State);
+    Key = "sections";
+    break;
+
+  default:
+    Name = SectionNameToStr (Node->Type);
+    if (Name != NULL) {
+      //
+      // Some of the section names end with a space.
+      //
+      Length = strlen (Name);
+      while (Length > 0 && Name[Length - 1] == ' ') {
+        Name[--Length] = 0;
+      }
+      fprintf (JsonFile, ",\n%*s\"type\": \"%s\"", (int) Indent, "", Name);
+      free (Name);
+    }
+    if (Contents->HasGuid) {
+      WriteJsonGuid (JsonFile, Indent, Node->Type == EFI_SECTION_GUID_DEFINED ? "sectionDefinitionGuid" : "subTypeGuid", &Contents->Guid);
+    }
+    if (Node->Type == EFI_SECTION_GUID_DEFINED) {
+      fprintf (JsonFile, ",\n%*s\"attributes\": \"0x%04X\"", (int) Indent, "", (unsigned) Contents->Attributes);
+    }
+    if (Node->Type == EFI_SECTION_COMPRESSION) {
+      fprintf (
+        JsonFile,
+        ",\n%*s\"compressionType\": \"%s\"",
+        (int) Indent,
+        "",
+        Contents->CompressionType == EFI_NOT_COMPRESSED ? "EFI_NOT_COMPRESSED" :
+        Contents->CompressionType == EFI_STANDARD_COMPRESSION ? "EFI_STANDARD_COMPRESSION" : "unknown"
+        );
+    }
+    if (Contents->Decoded != NULL) {
+      fprintf (JsonFile, ",\n%*s\"encodedSize\": %u", (int) Indent, "", (unsigned) Contents->EncodedSize);
+      fprintf (JsonFile, ",\n%*s\"decodedSize\": %u", (int) Indent, "", (unsigned) Contents->DecodedSize);
+      if (Contents->DecodedSize != 0) {
+        fprintf (JsonFile, ",\n%*s\"compressionRatio\": %.4f", (int) Indent, "", (double) Contents->EncodedSize / Contents->DecodedSize);
+      }
+    }
+    if (Node->Type == EFI_SECTION_VERSION) {
+      fprintf (JsonFile, ",\n%*s\"buildNumber\": %u", (int) Indent, "", (unsigned) Node->BuildNumber);
+    }
+    if (Node->Text != NULL) {
+      fprintf (JsonFile, ",\n%*s\"%s\": ", (int) Indent, "", Node->Type == EFI_SECTION_VERSION ? "version" : "name");
+      WriteJsonString (JsonFile, Node->Text);
+    }
+    Key = (Node->Type == EFI_SECTION_FIRMWARE_VOLUME_IMAGE) ? "fv" : "sections";
+    break;
+  }
+
+  if (Contents->Error != NULL) {
+    fprintf (JsonFile, ",\n%*s\"error\": ", (int) Indent, "");
+    WriteJsonString (JsonFile, Contents->Error);
+  }
+
+  if (Node->Kind != INVENTORY_SECTION || Contents->Child != NULL) {
+    if (strcmp (Key, "fv") == 0) {
+      fprintf (JsonFile, ",\n%*s\"fv\": ", (int) Indent, "");
+      WriteInventoryNode (JsonFile, Contents->Child, Indent + 2);
+    } else {
+      fprintf (JsonFile, ",\n%*s\"%s\": [", (int) Indent, "", Key);
+      for (Child = Contents->Child; Child != NULL; Child = Child->Next) {
+        fprintf (JsonFile, "%s\n%*s", Child == Contents->Child ? "" : ",", (int) Indent + 2, "");
+        WriteInventoryNode (JsonFile, Child, Indent + 4);
+      }
+      if (Contents->Child != NULL) {
+        fprintf (JsonFile, "\n%*s", (int) Indent, "");
+      }
+      fprintf (JsonFile, "]");
+    }
+  }
+
+  fprintf (JsonFile, "\n%*s}", (int) Indent - 2, "");
+}
+
+STATIC
+EFI_STATUS
+WriteFvInventory (
+  IN VOID     *Fv,
+  IN UINT32   FvSize,
+  IN CHAR8    *ImageName,
+  IN CHAR8    *JsonFileName,
+  IN UINTN    ThreadCount
+  )
+/*++
+
+Routine Description:
+
+  Decode an FV with all of its nested FVs, compressed sections and GUID
+  defined sections, and write the result as a JSON inventory.
+
+  The FV is decoded in waves: each wave decodes the encapsulation sections
+  found by the previous one, running one job per section on a worker pool.
+  Sections with the same bytes are decoded once. The JSON file is written
+  after all waves, in image order, so it does not depend on the thread
+  count.
+
+Arguments:
+
+  Fv            - The FV image
+  FvSize        - Size of the FV image in bytes
+  ImageName     - The input file name, recorded in the inventory
+  JsonFileName  - The JSON file to create
+  ThreadCount   - The number of decoding threads, or 0 for one per processor
+
+Returns:
+
+  EFI_SUCCESS           - The inventory was written.
+  EFI_ABORTED           - The JSON file could not be written.
+  EFI_OUT_OF_RESOURCES  - Memory allocation failed.
+
+--*/
+{
+  INVENTORY_NODE  *Root;
+  INVENTORY_NODE  **Jobs;
+  INVENTORY_NODE  **Pending;
+  INVENTORY_NODE  *Cache[256];
+  UINTN           JobCount;
+  UINTN           PendingCount;
+  UINTN           PendingMax;
+  UINTN           Wave;
+  UINTN           Index;
+  EFI_STATUS      Status;
+  FILE            *JsonFile;
+
+  Root = AddInventoryNode (NULL, INVENTORY_FV, Fv, 0, FvSize);
+  Jobs = malloc (sizeof (INVENTORY_NODE *));
+  if (Root == NULL || Jobs == NULL) {
+    free (Root);
+    free (Jobs);
+    Error (NULL, 0, 4001, "Resource: Memory can't be allocated", NULL);
+    return EFI_OUT_OF_RESOURCES;
+  }
+  memset (Cache, 0, sizeof (Cache));
+  Jobs[0]  = Root;
+  JobCount = 1;
+  Status   = EFI_SUCCESS;
+
+  for (Wave = 0; JobCount != 0; Wave++) {
+    DebugMsg (NULL, 0, 9, "Decoding wave", "%u: %u jobs", (unsigned) Wave, (unsigned) JobCount);
+    RunWorkerPool (JobCount, ThreadCount, RunInventoryJob, Jobs);
+
+    Pending      = NULL;
+    PendingCount = 0;
+    PendingMax   = 0;
+    for (Index = 0; Index < JobCount && !EFI_ERROR (Status); Index++) {
+      Jobs[Index]->Pending = FALSE;
+      Status = CollectPendingNodes (Jobs[Index], &Pending, &PendingCount, &PendingMax, Cache);
+    }
+    free (Jobs);
+    Jobs     = Pending;
+    JobCount = PendingCount;
+    if (EFI_ERROR (Status)) {
+      Error (NULL, 0, 4001, "Resource: Memory can't be allocated", NULL);
+      free (Jobs);
+      FreeInventoryNode (Root);
+      return Status;
+    }
+  }
+  free (Jobs);
+
+  ReportInventoryErrors (Root, NULL);
+
+  JsonFile = fopen (JsonFileName, "w");
+  if (JsonFile == NULL) {
+    Error (NULL, 0, 0001, "Error opening file", JsonFileName);
+    FreeInventoryNode (Root);
+    return EFI_ABORTED;
+  }
+  fprintf (JsonFile, "{\n  \"image\": ");
+  WriteJsonString (JsonFile, ImageName);
+  fprintf (JsonFile, ",\n  \"fv\": ");
+  WriteInventoryNode (JsonFile, Root, 4);
+  fprintf (JsonFile, "\n}\n");
+  if (fclose (JsonFile) != 0) {
+    Error (NULL, 0, 0002, "Error writing file", JsonFileName);
+    Status = EFI_ABORTED;
+  }
+
+  FreeInventoryNode (Root);
+  return Status;
+}
+
 void
 Usage (
   VOID
@@ -1848,6 +3031,13 @@ Returns:
             Parse basename to file-guid cross reference file(s).\n");
   fprintf (stdout, "  --offset offset\n\
             Offset of file to start processing FV at.\n");
+  fprintf (stdout, "  --json JsonFile\n\
+            Decode the FV with its nested FVs, compressed and GUIDed sections\n\
+            and write an inventory of it to JsonFile instead of listing the\n\
+            files on stdout.\n");
+  fprintf (stdout, "  -j Threads, --threads Threads\n\
+            Number of threads used to decode sections with --json.\n\
+            The default is one thread per processor.\n");
   fprintf (stdout, "  -h, --help\n\
             Show this help message and exit.\n");
 
@@ -19,9 +19,23 @@ import os
 import sys
 import unittest
 
+import GenCrc32
+import GenFfsBatch
+import GenFv
+import GenFw
+import LzmaCompress
+import PyGenFdsLib
 import TianoCompress
+import VolInfo
 modules = (
+    GenCrc32,
+    GenFfsBatch,
+    GenFv,
+    GenFw,
+    LzmaCompress,
+    PyGenFdsLib,
     TianoCompress,
+    VolInfo,
     )
 
 
@@ -0,0 +1,91 @@
+## @file
+# Unit tests for GenCrc32 utility
+#
+#  Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+import os
+import random
+import struct
+import sys
+import unittest
+import zlib
+
+import TestTools
+
+class Tests(TestTools.BaseToolsTest):
+
+    def setUp(self):
+        TestTools.BaseToolsTest.setUp(self)
+        self.toolName = 'GenCrc32'
+
+    def testHelp(self):
+        result = self.RunTool('--help', logFile='help')
+        self.assertTrue(result == 0)
+
+    def crcTestCycle(self, data):
+        self.WriteTmpFile('input', data)
+        result = self.RunTool(
+            '-e',
+            '-o', self.GetTmpFilePath('output'),
+            self.GetTmpFilePath('input'),
+            logFile='encode'
+            )
+        self.assertTrue(result == 0)
+        output = self.ReadTmpFile('output')
+        self.assertTrue(output[4:] == data)
+        crc = struct.unpack('<I', output[:4])[0]
+        expected = zlib.crc32(data) & 0xffffffff
+        if crc != expected:
+            print
+            print 'CRC 0x%08x does not match zlib CRC 0x%08x' % (crc, expected)
+            self.DisplayBinaryData('data', data)
+        self.assertTrue(crc == expected)
+        result = self.RunTool(
+            '-d',
+            '-o', self.GetTmpFilePath('decoded'),
+            self.GetTmpFilePath('output'),
+            logFile='decode'
+            )
+        self.assertTrue(result == 0)
+        self.assertTrue(self.ReadTmpFile('decoded') == data)
+
+    def testRandomDataCycles(self):
+        #
+        # Short inputs, inputs around the 16 byte folding granule and
+        # inputs large enough for the folding engine
+        #
+        for size in (1, 15, 16, 17, 63, 64, 65, 127, 128, 129, 1000, 65537):
+            self.crcTestCycle(self.GetRandomString(size))
+            self.CleanUpTmpDir()
+
+    def testEnginesMatch(self):
+        result = self.RunTool('0x10000', '1', logFile='bench', toolName='Crc32Bench')
+        if result != 0:
+            self.DisplayFile('bench')
+        self.assertTrue(result == 0)
+        crcs = []
+        for line in self.ReadTmpFile('bench').splitlines()[1:]:
+            fields = line.split(',')
+            if fields[1] != 'unsupported':
+                crcs.append(fields[3])
+        self.assertTrue(len(crcs) >= 2)
+        self.assertTrue(crcs.count(crcs[0]) == len(crcs))
+
+TheTestSuite = TestTools.MakeTheTestSuite(locals())
+
+if __name__ == '__main__':
+    allTests = TheTestSuite()
+    unittest.TextTestRunner().run(allTests)
+
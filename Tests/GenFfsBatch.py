@@ -0,0 +1,97 @@
+## @file
+# Unit tests for GenFfsBatch utility
+#
+#  Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+import os
+import random
+import sys
+import unittest
+
+import TestTools
+
+class Tests(TestTools.BaseToolsTest):
+
+    def setUp(self):
+        TestTools.BaseToolsTest.setUp(self)
+        self.toolName = 'GenFfsBatch'
+
+    def testHelp(self):
+        result = self.RunTool('--help', logFile='help')
+        self.assertTrue(result == 0)
+
+    def fileCommands(self, index, prefix):
+        data = self.GetTmpFilePath('data%d' % index)
+        out = self.GetTmpFilePath(prefix + 'file%d' % index)
+        guid = '%08X-2222-3333-4444-555555555555' % index
+        return [
+            ['GenSec', '-s', 'EFI_SECTION_RAW', '-o', out + '.raw', data],
+            ['GenSec', '-s', 'EFI_SECTION_USER_INTERFACE', '-n', 'File%d' % index, '-o', out + '.ui'],
+            ['GenSec', '-s', 'EFI_SECTION_COMPRESSION', '-c', 'PI_STD', '-o', out + '.cmp', out + '.raw'],
+            ['GenFfs', '-t', 'EFI_FV_FILETYPE_FREEFORM', '-g', guid, '-a', '16',
+             '-o', out + '.ffs', '-i', out + '.cmp', '-i', out + '.ui'],
+            ]
+
+    def runBatch(self, manifest, *options):
+        self.WriteTmpFile('manifest.txt', manifest)
+        args = list(options) + [self.GetTmpFilePath('manifest.txt')]
+        return self.RunTool(*args, logFile='batch')
+
+    def testBatchMatchesTools(self):
+        manifest = '# GenFfsBatch test\n'
+        for index in range(6):
+            self.WriteTmpFile('data%d' % index, self.GetRandomString(1000, 20000))
+            for command in self.fileCommands(index, 'batch.'):
+                manifest += ' '.join(command) + '\n'
+            manifest += '\n'
+            for command in self.fileCommands(index, 'single.'):
+                result = self.RunTool(*command[1:], toolName=command[0])
+                self.assertTrue(result == 0)
+        for threads in ('1', '4'):
+            result = self.runBatch(manifest, '-j', threads)
+            if result != 0:
+                self.DisplayFile('batch')
+            self.assertTrue(result == 0)
+            for index in range(6):
+                for suffix in ('.raw', '.ui', '.cmp', '.ffs'):
+                    name = 'file%d%s' % (index, suffix)
+                    self.assertTrue(self.ReadTmpFile('batch.' + name) == self.ReadTmpFile('single.' + name))
+                    os.remove(self.GetTmpFilePath('batch.' + name))
+
+    def testBatchFailure(self):
+        self.WriteTmpFile('data0', self.GetRandomString(1000, 2000))
+        manifest = ''
+        for command in self.fileCommands(0, 'good.') + self.fileCommands(1, 'bad.'):
+            manifest += ' '.join(command) + '\n'
+        result = self.runBatch(manifest)
+        self.assertTrue(result != 0)
+        #
+        # The lines that need the missing data are not run, the others are
+        #
+        self.assertTrue(os.path.exists(self.GetTmpFilePath('good.file0.ffs')))
+        self.assertTrue(os.path.exists(self.GetTmpFilePath('bad.file1.ui')))
+        self.assertTrue(not os.path.exists(self.GetTmpFilePath('bad.file1.cmp')))
+        self.assertTrue(not os.path.exists(self.GetTmpFilePath('bad.file1.ffs')))
+
+    def testUnknownTool(self):
+        result = self.runBatch('GenFv -i fv.inf -o fv.fv\n')
+        self.assertTrue(result != 0)
+
+TheTestSuite = TestTools.MakeTheTestSuite(locals())
+
+if __name__ == '__main__':
+    allTests = TheTestSuite()
+    unittest.TextTestRunner().run(allTests)
+
@@ -0,0 +1,242 @@
+## @file
+# Unit tests for GenFv utility
+#
+#  Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+import os
+import random
+import sys
+import unittest
+
+import TestTools
+
+ModuleSource = \
+    'static int tbl[64] = {1, 2, 3};\n' \
+    'int *ptrs[16] = {&tbl[0], &tbl[1], &tbl[2], &tbl[5]};\n' \
+    'char *names[] = {"alpha", "beta", "gamma"};\n' \
+    'int counter;\n' \
+    'int helper (int x) { return tbl[x & 63] + (int)(long)names[x %% 3][0]; }\n' \
+    'int _ModuleEntryPoint (void *a, void *b) { counter++; return helper (counter) + *ptrs[counter & 3] + %d; }\n'
+
+AprioriGuid = '1B45CC0A-156A-428A-AF62-49864DA0E6E6'
+
+class Tests(TestTools.BaseToolsTest):
+
+    def setUp(self):
+        TestTools.BaseToolsTest.setUp(self)
+        self.toolName = 'GenFv'
+
+    def testHelp(self):
+        result = self.RunTool('--help', logFile='help')
+        self.assertTrue(result == 0)
+
+    def makeFfs(self, name, data, alignment=None, guid=None):
+        self.WriteTmpFile(name + '.bin', data)
+        result = self.RunTool(
+            '-s', 'EFI_SECTION_RAW',
+            '-o', self.GetTmpFilePath(name + '.sec'),
+            self.GetTmpFilePath(name + '.bin'),
+            toolName='GenSec'
+            )
+        self.assertTrue(result == 0)
+        return self.makeFfsFromSection(name, 'EFI_FV_FILETYPE_FREEFORM', alignment, guid)
+
+    def makePeimFfs(self, name, value, guid=None):
+        image = self.BuildEfiImage(name, ModuleSource % value)
+        result = self.RunTool(
+            '-s', 'EFI_SECTION_PE32',
+            '-o', self.GetTmpFilePath(name + '.sec'),
+            image,
+            toolName='GenSec'
+            )
+        self.assertTrue(result == 0)
+        return self.makeFfsFromSection(name, 'EFI_FV_FILETYPE_PEIM', '16', guid)
+
+    def makeFfsFromSection(self, name, fileType, alignment, guid=None):
+        if guid is None:
+            guid = '%08X-2222-3333-4444-555555555555' % random.randint(0, 0xffffffff)
+        args = [
+            '-t', fileType, '-g', guid,
+            '-o', self.GetTmpFilePath(name + '.ffs'),
+            '-i', self.GetTmpFilePath(name + '.sec')
+            ]
+        if alignment is not None:
+            args += ['-a', alignment]
+        result = self.RunTool(*args, toolName='GenFfs')
+        self.assertTrue(result == 0)
+        return guid
+
+    def writeFvInf(self, names, baseAddress=None):
+        inf = '[options]\n'
+        if baseAddress is not None:
+            inf += 'EFI_BASE_ADDRESS = %s\n' % baseAddress
+        inf += \
+            'EFI_BLOCK_SIZE = 0x1000\n' \
+            'EFI_NUM_BLOCKS = 0x40\n' \
+            '[attributes]\n' \
+            'EFI_ERASE_POLARITY = 1\n' \
+            '[files]\n'
+        for name in names:
+            inf += 'EFI_FILE_NAME = %s\n' % self.GetTmpFilePath(name + '.ffs')
+        self.WriteTmpFile('fv.inf', inf)
+
+    def buildFv(self, name, *options):
+        args = [
+            '-i', self.GetTmpFilePath('fv.inf'),
+            '-o', self.GetTmpFilePath(name)
+            ] + list(options)
+        result = self.RunTool(*args, logFile=name + '.log')
+        if result != 0:
+            self.DisplayFile(name + '.log')
+        self.assertTrue(result == 0)
+        return self.ReadTmpFile(name)
+
+    def testRebaseThreads(self):
+        names = []
+        for index in range(6):
+            names.append('peim%d' % index)
+            self.makePeimFfs(names[-1], index)
+        self.writeFvInf(names, '0xFFF00000')
+        image = self.ReadTmpFile('peim0.efi')
+        first = self.buildFv('j1.fv', '-j', '1')
+        firstMap = self.ReadTmpFile('j1.fv.map')
+        #
+        # The images are rebased to their place in the FV
+        #
+        self.assertTrue(image not in first)
+        self.assertTrue('peim0' in firstMap)
+        for threads in ('2', '4', '0'):
+            name = 'j%s.fv' % threads
+            self.assertTrue(self.buildFv(name, '-j', threads) == first)
+            self.assertTrue(self.ReadTmpFile(name + '.map') == firstMap)
+
+    def readFvReport(self, name):
+        takenSize = None
+        files = []
+        for line in self.ReadTmpFile(name + '.txt').splitlines():
+            if line.startswith('EFI_FV_TAKEN_SIZE'):
+                takenSize = int(line.split('=')[1], 16)
+            elif line.startswith('0x'):
+                offset, guid = line.split()
+                files.append((int(offset, 16), guid))
+        return takenSize, files
+
+    def testPack(self):
+        alignments = ('16', '4K', '8', '1K', '128', '4K', '16')
+        names = []
+        guids = {}
+        for index in range(len(alignments)):
+            names.append('file%d' % index)
+            guid = self.makeFfs(names[-1], self.GetRandomString(500, 3000), alignments[index])
+            guids[guid] = alignments[index]
+        self.writeFvInf(names)
+        self.buildFv('plain.fv')
+        self.buildFv('packed.fv', '--pack')
+        plainSize, plainFiles = self.readFvReport('plain.fv')
+        packedSize, packedFiles = self.readFvReport('packed.fv')
+        self.assertTrue(packedSize <= plainSize)
+        #
+        # Every file is still there and its data is still aligned
+        #
+        self.assertTrue(sorted([guid for offset, guid in packedFiles]) == sorted(guids.keys()))
+        for offset, guid in packedFiles:
+            alignment = int(guids[guid].replace('K', '')) * (1024 if 'K' in guids[guid] else 1)
+            self.assertTrue((offset + 0x18) % alignment == 0)
+        result = self.RunTool(self.GetTmpFilePath('packed.fv'), logFile='info', toolName='VolInfo')
+        self.assertTrue(result == 0)
+
+    def testPackKeepsAprioriPlace(self):
+        names = []
+        for index in range(5):
+            names.append('file%d' % index)
+            if index == 1:
+                guid = AprioriGuid
+            else:
+                guid = None
+            self.makeFfs(names[-1], self.GetRandomString(500, 3000), ('16', '8', '4K', '16', '1K')[index], guid)
+        self.writeFvInf(names)
+        packed = self.buildFv('packed.fv', '--pack')
+        takenSize, files = self.readFvReport('packed.fv')
+        self.assertTrue(files[1][1] == AprioriGuid)
+        #
+        # Packing is deterministic
+        #
+        self.assertTrue(self.buildFv('packed2.fv', '--pack') == packed)
+
+    def incrementalTestCycle(self, change):
+        names = []
+        guids = []
+        for index in range(4):
+            names.append('file%d' % index)
+            guids.append(self.makeFfs(names[-1], self.GetRandomString(1000, 1000), ('16', '8', '4K', '16')[index]))
+        for index in range(2):
+            names.append('peim%d' % index)
+            guids.append(self.makePeimFfs(names[-1], index))
+        self.writeFvInf(names, '0xFFF00000')
+        self.buildFv('inc.fv', '--incremental')
+        change(guids)
+        incremental = self.buildFv('inc.fv', '--incremental', '-v')
+        full = self.buildFv('full.fv')
+        #
+        # The update must give what a full build gives, apart from the
+        # build record the incremental mode adds to the report
+        #
+        self.assertTrue(incremental == full)
+        self.assertTrue(self.ReadTmpFile('inc.fv.map') == self.ReadTmpFile('full.fv.map'))
+        report = [
+            line for line in self.ReadTmpFile('inc.fv.txt').splitlines()
+            if not line.startswith(('EFI_FV_B', 'EFI_FV_I', 'EFI_FV_FILE_S'))
+            ]
+        self.assertTrue(report == self.ReadTmpFile('full.fv.txt').splitlines())
+        return self.ReadTmpFile('inc.fv.log')
+
+    def testIncrementalUpToDate(self):
+        log = self.incrementalTestCycle(lambda guids: None)
+        self.assertTrue('The FV is up to date.' in log)
+
+    def testIncrementalSameSizeChange(self):
+        def change(guids):
+            self.makeFfs('file1', self.GetRandomString(1000, 1000), '8', guids[1])
+            self.makeFfs('file3', self.GetRandomString(1000, 1000), '16', guids[3])
+        log = self.incrementalTestCycle(change)
+        self.assertTrue('Updated 2 of the 6 files of the FV in place.' in log)
+
+    def testIncrementalPeimChange(self):
+        def change(guids):
+            self.makePeimFfs('peim1', 7, guids[5])
+        log = self.incrementalTestCycle(change)
+        self.assertTrue('Updated 1 of the 6 files of the FV in place.' in log)
+
+    def testIncrementalGrownFile(self):
+        def change(guids):
+            self.makeFfs('file1', self.GetRandomString(6000, 6000), '8', guids[1])
+        log = self.incrementalTestCycle(change)
+        self.assertTrue('Updated' not in log)
+
+    def testIncrementalChangedFv(self):
+        def change(guids):
+            self.makeFfs('file1', self.GetRandomString(1000, 1000), '8', guids[1])
+            fv = self.ReadTmpFile('inc.fv')
+            offset = len(fv) // 2
+            self.WriteTmpFile('inc.fv', fv[:offset] + chr(ord(fv[offset]) ^ 0xff) + fv[offset + 1:])
+        log = self.incrementalTestCycle(change)
+        self.assertTrue('Updated' not in log)
+
+TheTestSuite = TestTools.MakeTheTestSuite(locals())
+
+if __name__ == '__main__':
+    allTests = TheTestSuite()
+    unittest.TextTestRunner().run(allTests)
+
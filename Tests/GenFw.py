@@ -0,0 +1,238 @@
+## @file
+# Unit tests for GenFw utility
+#
+#  Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+import os
+import random
+import struct
+import sys
+import unittest
+
+import TestTools
+
+ModuleSource = \
+    'static int tbl[64] = {1, 2, 3};\n' \
+    'int *ptrs[16] = {&tbl[0], &tbl[1], &tbl[2], &tbl[5]};\n' \
+    'char *names[] = {"alpha", "beta", "gamma"};\n' \
+    'int counter;\n' \
+    'int helper (int x) { return tbl[x & 63] + (int)(long)names[x %% 3][0]; }\n' \
+    'int _ModuleEntryPoint (void *a, void *b) { counter++; return helper (counter) + *ptrs[counter & 3] + %d; }\n'
+
+def RebaseImage(image, newBase):
+    #
+    # What GenFw --rebase does to a PE32 or PE32+ image, with the base
+    # relocations applied the simple way, one fixup at a time
+    #
+    peOffset = struct.unpack_from('<I', image, 0x3c)[0]
+    sectionCount, = struct.unpack_from('<H', image, peOffset + 6)
+    optionalSize, = struct.unpack_from('<H', image, peOffset + 20)
+    optional = peOffset + 24
+    magic, = struct.unpack_from('<H', image, optional)
+    if magic == 0x20b:
+        baseFormat = '<Q'
+        baseOffset = optional + 24
+        directories = optional + 112
+    else:
+        baseFormat = '<I'
+        baseOffset = optional + 28
+        directories = optional + 96
+    oldBase, = struct.unpack_from(baseFormat, image, baseOffset)
+    relocRva, relocSize = struct.unpack_from('<II', image, directories + 5 * 8)
+    sections = []
+    baseHeader = None
+    for index in range(sectionCount):
+        header = optional + optionalSize + index * 40
+        virtualSize, virtualAddress, rawSize, rawOffset = struct.unpack_from('<IIII', image, header + 8)
+        sections.append((virtualAddress, max(virtualSize, rawSize), rawOffset))
+        characteristics, = struct.unpack_from('<I', image, header + 36)
+        if baseHeader is None and (characteristics & 0x20) == 0:
+            baseHeader = header
+
+    def FileOffset(rva):
+        for virtualAddress, size, rawOffset in sections:
+            if virtualAddress <= rva < virtualAddress + size:
+                return rawOffset + rva - virtualAddress
+        raise ValueError('RVA 0x%x is not in a section' % rva)
+
+    delta = newBase - oldBase
+    result = bytearray(image)
+    struct.pack_into(baseFormat, result, baseOffset, newBase)
+    #
+    # The new base is also recorded in the first section that is not code
+    #
+    struct.pack_into('<Q', result, baseHeader + 24, newBase)
+    counts = {}
+    block = FileOffset(relocRva)
+    end = block + relocSize
+    while block < end:
+        pageRva, blockSize = struct.unpack_from('<II', image, block)
+        if blockSize == 0:
+            break
+        for entry in struct.unpack_from('<%dH' % ((blockSize - 8) // 2), image, block + 8):
+            fixupType = entry >> 12
+            counts[fixupType] = counts.get(fixupType, 0) + 1
+            if fixupType == 0:
+                continue
+            fixup = FileOffset(pageRva + (entry & 0xfff))
+            if fixupType == 3:
+                value, = struct.unpack_from('<I', result, fixup)
+                struct.pack_into('<I', result, fixup, (value + delta) & 0xffffffff)
+            elif fixupType == 10:
+                value, = struct.unpack_from('<Q', result, fixup)
+                struct.pack_into('<Q', result, fixup, (value + delta) & 0xffffffffffffffff)
+            else:
+                raise ValueError('unexpected relocation type %d' % fixupType)
+        block += blockSize
+    return str(result), counts
+
+class Tests(TestTools.BaseToolsTest):
+
+    def setUp(self):
+        TestTools.BaseToolsTest.setUp(self)
+        self.toolName = 'GenFw'
+
+    def testHelp(self):
+        result = self.RunTool('--help', logFile='help')
+        self.assertTrue(result == 0)
+
+    def runGenFw(self, *args):
+        result = self.RunTool(*args, logFile='genfw')
+        if result != 0:
+            self.DisplayFile('genfw')
+        self.assertTrue(result == 0)
+
+    def batchCommands(self, name, prefix):
+        elf = self.GetTmpFilePath(name + '.elf')
+        out = self.GetTmpFilePath(prefix + name)
+        return [
+            ['-e', 'DXE_DRIVER', '-o', out + '.efi', elf],
+            ['-t', '-o', out + '.te', elf],
+            ['--rebase', '0x10000', '-o', out + '.rb.efi', out + '.efi'],
+            ['-l', '-o', out + '.l.efi', out + '.rb.efi'],
+            ['-z', '-o', out + '.z.efi', out + '.efi'],
+            ]
+
+    def testBatchMatchesSingleCommands(self):
+        names = []
+        for index in range(4):
+            names.append('module%d' % index)
+            self.BuildEfiImage(names[-1], ModuleSource % index)
+        manifest = '# GenFw batch test\n'
+        for name in names:
+            for command in self.batchCommands(name, 'batch.'):
+                manifest += 'GenFw ' + ' '.join(['"%s"' % arg for arg in command]) + '\n'
+            manifest += '\n'
+            for command in self.batchCommands(name, 'single.'):
+                self.runGenFw(*command)
+        self.WriteTmpFile('manifest.txt', manifest)
+        for threads in ('1', '4'):
+            self.runGenFw('--batch', self.GetTmpFilePath('manifest.txt'), '--threads', threads)
+            for name in names:
+                for suffix in ('.efi', '.te', '.rb.efi', '.l.efi', '.z.efi'):
+                    single = self.ReadTmpFile('single.' + name + suffix)
+                    self.assertTrue(self.ReadTmpFile('batch.' + name + suffix) == single)
+                    os.remove(self.GetTmpFilePath('batch.' + name + suffix))
+
+    def testBatchFailure(self):
+        self.BuildEfiImage('module', ModuleSource % 0)
+        elf = self.GetTmpFilePath('module.elf')
+        missing = self.GetTmpFilePath('missing.elf')
+        self.WriteTmpFile(
+            'manifest.txt',
+            '-e DXE_DRIVER -o "%s" "%s"\n' % (self.GetTmpFilePath('bad.efi'), missing) +
+            '--rebase 0x10000 -o "%s" "%s"\n' % (self.GetTmpFilePath('bad.rb.efi'), self.GetTmpFilePath('bad.efi')) +
+            '-e DXE_DRIVER -o "%s" "%s"\n' % (self.GetTmpFilePath('good.efi'), elf)
+            )
+        result = self.RunTool('--batch', self.GetTmpFilePath('manifest.txt'), logFile='batch')
+        self.assertTrue(result != 0)
+        #
+        # The command that reads the failed command's output does not run,
+        # independent commands still do
+        #
+        self.assertTrue(not os.path.exists(self.GetTmpFilePath('bad.efi')))
+        self.assertTrue(not os.path.exists(self.GetTmpFilePath('bad.rb.efi')))
+        self.assertTrue(os.path.exists(self.GetTmpFilePath('good.efi')))
+
+    def ageFile(self, path):
+        os.utime(path, (1000000000, 1000000000))
+
+    def testUnchangedOutputIsNotWritten(self):
+        self.BuildEfiImage('module0', ModuleSource % 0)
+        self.BuildEfiImage('module1', ModuleSource % 1)
+        output = self.GetTmpFilePath('output.efi')
+        self.runGenFw('-e', 'DXE_DRIVER', '-o', output, self.GetTmpFilePath('module0.elf'))
+        image = self.ReadTmpFile('output.efi')
+        self.ageFile(output)
+        self.runGenFw('-e', 'DXE_DRIVER', '-o', output, self.GetTmpFilePath('module0.elf'))
+        self.assertTrue(os.path.getmtime(output) == 1000000000)
+        self.assertTrue(self.ReadTmpFile('output.efi') == image)
+        #
+        # A different image is written
+        #
+        self.runGenFw('-e', 'DXE_DRIVER', '-o', output, self.GetTmpFilePath('module1.elf'))
+        self.assertTrue(os.path.getmtime(output) != 1000000000)
+        self.assertTrue(self.ReadTmpFile('output.efi') != image)
+
+    def testUnchangedReplacedFileIsNotWritten(self):
+        self.BuildEfiImage('module', ModuleSource % 0)
+        path = self.GetTmpFilePath('module.efi')
+        self.runGenFw('-z', '-r', path)
+        image = self.ReadTmpFile('module.efi')
+        self.ageFile(path)
+        self.runGenFw('-z', '-r', path)
+        self.assertTrue(os.path.getmtime(path) == 1000000000)
+        self.assertTrue(self.ReadTmpFile('module.efi') == image)
+
+    def rebaseTestCycle(self, fixupType, *options):
+        #
+        # Enough pointers for long runs of fixups across several pages
+        #
+        source = 'int tbl[3000];\nint *ptrs[3000] = {%s};\n' % \
+            ', '.join(['&tbl[%d]' % index for index in range(3000)])
+        source += 'int _ModuleEntryPoint (void *a, void *b) { return *ptrs[(long) a]; }\n'
+        self.BuildEfiImage('module', source, *options)
+        image = self.ReadTmpFile('module.efi')
+        for newBase in (0x10000, 0xFFF40000):
+            result = self.RunTool(
+                '--rebase', '0x%X' % newBase,
+                '-o', self.GetTmpFilePath('rebased.efi'),
+                '--debug', '9',
+                self.GetTmpFilePath('module.efi'),
+                logFile='rebase'
+                )
+            self.assertTrue(result == 0)
+            expected, counts = RebaseImage(image, newBase)
+            self.assertTrue(counts.get(fixupType, 0) >= 3000)
+            self.assertTrue(self.ReadTmpFile('rebased.efi') == expected)
+            #
+            # The fixups went through the bulk path
+            #
+            log = self.ReadTmpFile('rebase')
+            self.assertTrue(' 0 fixups applied in runs' not in log)
+            self.assertTrue('fixups applied in runs' in log)
+
+    def testRebaseDir64(self):
+        self.rebaseTestCycle(10, '-m64')
+
+    def testRebaseHighLow(self):
+        self.rebaseTestCycle(3, '-m32')
+
+TheTestSuite = TestTools.MakeTheTestSuite(locals())
+
+if __name__ == '__main__':
+    allTests = TheTestSuite()
+    unittest.TextTestRunner().run(allTests)
+
@@ -0,0 +1,147 @@
+## @file
+# Unit tests for LzmaCompress utility
+#
+#  Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+import os
+import random
+import sys
+import unittest
+
+import TestTools
+
+class Tests(TestTools.BaseToolsTest):
+
+    def setUp(self):
+        TestTools.BaseToolsTest.setUp(self)
+        self.toolName = 'LzmaCompress'
+
+    def testHelp(self):
+        result = self.RunTool('--help', logFile='help')
+        self.assertTrue(result == 0)
+
+    def compressionTestCycle(self, data, *options):
+        self.WriteTmpFile('input', data)
+        args = ['-e'] + list(options) + [
+            '-o', self.GetTmpFilePath('output1'),
+            self.GetTmpFilePath('input')
+            ]
+        result = self.RunTool(*args, logFile='encode')
+        if result != 0:
+            self.DisplayFile('encode')
+        self.assertTrue(result == 0)
+        result = self.RunTool(
+            '-d',
+            '-o', self.GetTmpFilePath('output2'),
+            self.GetTmpFilePath('output1'),
+            logFile='decode'
+            )
+        if result != 0:
+            self.DisplayFile('decode')
+        self.assertTrue(result == 0)
+        finish = self.ReadTmpFile('output2')
+        startEqualsFinish = data == finish
+        if not startEqualsFinish:
+            print
+            print 'Options:', ' '.join(options)
+            print 'Original data did not match decompress(compress(data))'
+            self.DisplayBinaryData('original data', data)
+            self.DisplayBinaryData('after compression', self.ReadTmpFile('output1'))
+            self.DisplayBinaryData('after decompression', finish)
+        self.assertTrue(startEqualsFinish)
+        return self.ReadTmpFile('output1')
+
+    def testRandomDataCycles(self):
+        for i in range(8):
+            data = self.GetRandomString(1024, 2048)
+            self.compressionTestCycle(data)
+            self.CleanUpTmpDir()
+
+    def testThreadsCycles(self):
+        data = self.GetRandomString(1024, 2048) * 128
+        for threads in ('1', '2', '4'):
+            self.compressionTestCycle(data, '-T', threads)
+
+    def testBlockCycles(self):
+        #
+        # Several blocks plus a short final block
+        #
+        data = self.GetRandomString(1024, 2048) * 200 + self.GetRandomString(100, 200)
+        for threads in ('1', '4'):
+            encoded = self.compressionTestCycle(data, '--block-size', '64K', '-T', threads)
+            if threads == '1':
+                first = encoded
+            else:
+                #
+                # The block container does not depend on the thread count
+                #
+                self.assertTrue(encoded == first)
+
+    def testBlockSingleBlockCycle(self):
+        data = self.GetRandomString(100, 200)
+        self.compressionTestCycle(data, '--block-size', '64K', '-T', '4')
+
+    def testPresetCycles(self):
+        data = self.GetRandomString(1024, 2048) * 64
+        for preset in ('fast', 'normal', 'max'):
+            self.compressionTestCycle(data, '--preset', preset)
+
+    def testOverrideCycles(self):
+        data = self.GetRandomString(1024, 2048) * 64
+        for options in (
+              ('--dict', '64K', '--fb', '273'),
+              ('--preset', 'fast', '--mf', 'bt4', '--mc', '8'),
+              ('--lc', '0', '--lp', '4', '--pb', '0'),
+              ('--lc', '4', '--lp', '0', '--pb', '4'),
+              ):
+            self.compressionTestCycle(data, *options)
+
+    def testDefaultMatchesNormalPreset(self):
+        data = self.GetRandomString(1024, 2048) * 16
+        default = self.compressionTestCycle(data)
+        self.assertTrue(self.compressionTestCycle(data, '--preset', 'normal') == default)
+
+    def testInvalidOverrides(self):
+        self.WriteTmpFile('input', self.GetRandomString(100, 200))
+        for options in (
+              ('--lc', '4', '--lp', '1'),
+              ('--lc', '9'),
+              ('--fb', '4'),
+              ('--preset', 'slow'),
+              ('--mf', 'bt5'),
+              ):
+            args = ['-e'] + list(options) + [
+                '-o', self.GetTmpFilePath('output1'),
+                self.GetTmpFilePath('input')
+                ]
+            result = self.RunTool(*args, logFile='encode')
+            self.assertTrue(result != 0)
+
+    def testInvalidThreads(self):
+        self.WriteTmpFile('input', self.GetRandomString(100, 200))
+        result = self.RunTool(
+            '-e', '-T', '0',
+            '-o', self.GetTmpFilePath('output1'),
+            self.GetTmpFilePath('input'),
+            logFile='encode'
+            )
+        self.assertTrue(result != 0)
+
+TheTestSuite = TestTools.MakeTheTestSuite(locals())
+
+if __name__ == '__main__':
+    allTests = TheTestSuite()
+    unittest.TextTestRunner().run(allTests)
+
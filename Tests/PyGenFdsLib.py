@@ -0,0 +1,131 @@
+## @file
+# Unit tests for the GenFdsLib Python extension
+#
+#  Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+import glob
+import os
+import random
+import sys
+import unittest
+
+import TestTools
+
+#
+# Use the extension from a "setup.py build" in Source/C/PyGenFdsLib when it
+# is not installed
+#
+sys.path += glob.glob(os.path.join(TestTools.CSourceDir, 'PyGenFdsLib', 'build', 'lib.*-%d.%d' % sys.version_info[:2]))
+try:
+    import GenFdsLib
+except ImportError:
+    GenFdsLib = None
+
+FileGuid = '11111111-2222-3333-4444-555555555555'
+
+FvInf = \
+    '[options]\n' \
+    'EFI_BLOCK_SIZE = 0x1000\n' \
+    'EFI_NUM_BLOCKS = 0x40\n' \
+    '[attributes]\n' \
+    'EFI_ERASE_POLARITY = 1\n' \
+    '[files]\n'
+
+class Tests(TestTools.BaseToolsTest):
+
+    def setUp(self):
+        TestTools.BaseToolsTest.setUp(self)
+        if GenFdsLib is None:
+            self.skipTest('the GenFdsLib extension is not built')
+
+    def genSec(self, name, *args):
+        args = list(args) + ['-o', self.GetTmpFilePath(name)]
+        result = self.RunTool(*args, toolName='GenSec')
+        self.assertTrue(result == 0)
+        return self.ReadTmpFile(name)
+
+    def makeSections(self):
+        data = self.GetRandomString(1000, 20000)
+        self.WriteTmpFile('data', data)
+        raw = GenFdsLib.GenLeafSection('EFI_SECTION_RAW', data)
+        ui = GenFdsLib.GenUserInterfaceSection('Test')
+        version = GenFdsLib.GenVersionSection(3, '1.0')
+        compressed = GenFdsLib.GenCompressionSection([raw, ui])
+        self.WriteTmpFile('sections', raw + ui)
+        return raw, ui, version, compressed
+
+    def testSectionsMatchGenSec(self):
+        raw, ui, version, compressed = self.makeSections()
+        self.assertTrue(raw == self.genSec('raw.sec', '-s', 'EFI_SECTION_RAW', self.GetTmpFilePath('data')))
+        self.assertTrue(ui == self.genSec('ui.sec', '-s', 'EFI_SECTION_USER_INTERFACE', '-n', 'Test'))
+        self.assertTrue(version == self.genSec('ver.sec', '-s', 'EFI_SECTION_VERSION', '-j', '3', '-n', '1.0'))
+        self.assertTrue(
+            compressed ==
+            self.genSec(
+                'cmp.sec', '-s', 'EFI_SECTION_COMPRESSION', '-c', 'PI_STD',
+                self.GetTmpFilePath('raw.sec'), self.GetTmpFilePath('ui.sec')
+                )
+            )
+
+    def testFfsMatchesGenFfs(self):
+        raw, ui, version, compressed = self.makeSections()
+        self.WriteTmpFile('cmp.sec', compressed)
+        self.WriteTmpFile('ui.sec', ui)
+        ffs = GenFdsLib.GenFfs('EFI_FV_FILETYPE_FREEFORM', FileGuid, [compressed, ui], 0, 0, '16')
+        result = self.RunTool(
+            '-t', 'EFI_FV_FILETYPE_FREEFORM', '-g', FileGuid, '-a', '16',
+            '-o', self.GetTmpFilePath('file.ffs'),
+            '-i', self.GetTmpFilePath('cmp.sec'),
+            '-i', self.GetTmpFilePath('ui.sec'),
+            toolName='GenFfs'
+            )
+        self.assertTrue(result == 0)
+        self.assertTrue(ffs == self.ReadTmpFile('file.ffs'))
+
+    def testFvMatchesGenFv(self):
+        files = {}
+        inf = FvInf
+        for index in range(4):
+            data = GenFdsLib.GenLeafSection('EFI_SECTION_RAW', self.GetRandomString(1000, 5000))
+            guid = '%08X-2222-3333-4444-555555555555' % index
+            name = self.GetTmpFilePath('file%d.ffs' % index)
+            files[name] = GenFdsLib.GenFfs('EFI_FV_FILETYPE_FREEFORM', guid, [data], 0, 0, ('8', '4K', '16', '1K')[index])
+            inf += 'EFI_FILE_NAME = %s\n' % name
+        #
+        # The FFS files only exist in memory
+        #
+        fv = GenFdsLib.GenFv(inf, self.GetTmpFilePath('lib.fv'), None, files)
+        for name, data in files.items():
+            self.WriteTmpFile(os.path.basename(name), data)
+        self.WriteTmpFile('fv.inf', inf)
+        result = self.RunTool(
+            '-i', self.GetTmpFilePath('fv.inf'),
+            '-o', self.GetTmpFilePath('tool.fv'),
+            toolName='GenFv'
+            )
+        self.assertTrue(result == 0)
+        self.assertTrue(fv == self.ReadTmpFile('tool.fv'))
+
+    def testInvalidArguments(self):
+        self.assertRaises(Exception, GenFdsLib.GenLeafSection, 'EFI_SECTION_BOGUS', 'data')
+        self.assertRaises(Exception, GenFdsLib.GenFfs, 'EFI_FV_FILETYPE_FREEFORM', 'not-a-guid', [])
+        self.assertRaises(Exception, GenFdsLib.GenFv, FvInf + 'EFI_FILE_NAME = missing.ffs\n', 'bad.fv')
+
+TheTestSuite = TestTools.MakeTheTestSuite(locals())
+
+if __name__ == '__main__':
+    allTests = TheTestSuite()
+    unittest.TextTestRunner().run(allTests)
+
@@ -157,6 +157,37 @@ class BaseToolsTest(unittest.TestCase):
              for x in xrange(random.randint(minlen, maxlen))
             ])
 
+    def BuildEfiImage(self, name, source, *options):
+        #
+        # Link a freestanding ELF image with relocations the way the GCC
+        # tool chains do and convert it with GenFw.  Tests that need EFI
+        # images are skipped where gcc cannot build them.
+        #
+        self.WriteTmpFile(name + '.c', source)
+        args = ['gcc'] + list(options) + [
+            '-O2', '-fno-pic', '-fno-pie', '-no-pie',
+            '-fno-asynchronous-unwind-tables', '-nostdlib',
+            '-Wl,-q', '-Wl,-e,_ModuleEntryPoint',
+            '-o', self.GetTmpFilePath(name + '.elf'),
+            self.GetTmpFilePath(name + '.c')
+            ]
+        log = self.OpenTmpFile(name + '.gcc', 'w')
+        try:
+            result = subprocess.call(args, stdout=log, stderr=subprocess.STDOUT)
+        except OSError:
+            result = None
+        log.close()
+        if result != 0:
+            self.skipTest('gcc cannot build %s ELF images' % ' '.join(options))
+        result = self.RunTool(
+            '-e', 'PEIM',
+            '-o', self.GetTmpFilePath(name + '.efi'),
+            self.GetTmpFilePath(name + '.elf'),
+            toolName='GenFw'
+            )
+        self.assertTrue(result == 0)
+        return self.GetTmpFilePath(name + '.efi')
+
     def setUp(self):
         self.savedEnvPath = os.environ['PATH']
         self.savedSysPath = sys.path[:]
@@ -33,14 +33,17 @@ class Tests(TestTools.BaseToolsTest):
         #self.DisplayFile('help')
         self.assertTrue(result == 0)
 
-    def compressionTestCycle(self, data):
+    def compressionTestCycle(self, data, level=None):
         path = self.GetTmpFilePath('input')
         self.WriteTmpFile('input', data)
-        result = self.RunTool(
-            '-e',
+        args = ['-e']
+        if level is not None:
+            args += ['--level', str(level)]
+        args += [
             '-o', self.GetTmpFilePath('output1'),
             self.GetTmpFilePath('input')
-            )
+            ]
+        result = self.RunTool(*args)
         self.assertTrue(result == 0)
         result = self.RunTool(
             '-d',
@@ -65,6 +68,19 @@ class Tests(TestTools.BaseToolsTest):
             self.compressionTestCycle(data)
             self.CleanUpTmpDir()
 
+    def testLevelCycles(self):
+        data = self.GetRandomString(256, 512) * 64
+        for level in range(1, 10):
+            self.compressionTestCycle(data, level)
+            self.CleanUpTmpDir()
+
+    def testLargeDataCycles(self):
+        #
+        # Much larger than the chunks that -d feeds to the streaming decoder
+        #
+        data = self.GetRandomString(1024, 2048) * 512
+        self.compressionTestCycle(data)
+
 TheTestSuite = TestTools.MakeTheTestSuite(locals())
 
 if __name__ == '__main__':
@@ -0,0 +1,154 @@
+## @file
+# Unit tests for VolInfo utility
+#
+#  Copyright (c) 2026, Intel Corporation. All rights reserved.<BR>
+#
+#  This program and the accompanying materials
+#  are licensed and made available under the terms and conditions of the BSD License
+#  which accompanies this distribution.  The full text of the license may be found at
+#  http://opensource.org/licenses/bsd-license.php
+#
+#  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+
+##
+# Import Modules
+#
+import json
+import os
+import random
+import sys
+import unittest
+
+import TestTools
+
+FileGuid = '11111111-2222-3333-4444-555555555555'
+RawFileGuid = '22222222-2222-3333-4444-555555555555'
+FvFileGuid = '33333333-2222-3333-4444-555555555555'
+
+FvInf = \
+    '[options]\n' \
+    'EFI_BLOCK_SIZE = 0x1000\n' \
+    'EFI_NUM_BLOCKS = %s\n' \
+    '[attributes]\n' \
+    'EFI_ERASE_POLARITY = 1\n' \
+    '[files]\n' \
+    'EFI_FILE_NAME = %s\n'
+
+class Tests(TestTools.BaseToolsTest):
+
+    def setUp(self):
+        TestTools.BaseToolsTest.setUp(self)
+        self.toolName = 'VolInfo'
+
+    def makeSection(self, name, input, *options):
+        args = list(options) + ['-o', self.GetTmpFilePath(name), self.GetTmpFilePath(input)]
+        result = self.RunTool(*args, toolName='GenSec')
+        self.assertTrue(result == 0)
+
+    def makeFfs(self, name, section, guid, fileType='EFI_FV_FILETYPE_FREEFORM'):
+        result = self.RunTool(
+            '-t', fileType, '-g', guid,
+            '-o', self.GetTmpFilePath(name),
+            '-i', self.GetTmpFilePath(section),
+            toolName='GenFfs'
+            )
+        self.assertTrue(result == 0)
+
+    def makeFv(self, name, blocks, *files):
+        self.WriteTmpFile(
+            name + '.inf',
+            FvInf % (blocks, '\nEFI_FILE_NAME = '.join([self.GetTmpFilePath(f) for f in files]))
+            )
+        result = self.RunTool(
+            '-i', self.GetTmpFilePath(name + '.inf'),
+            '-o', self.GetTmpFilePath(name),
+            toolName='GenFv'
+            )
+        self.assertTrue(result == 0)
+
+    def makeCompressedFv(self, data):
+        self.WriteTmpFile('data', data)
+        self.makeSection('raw.sec', 'data', '-s', 'EFI_SECTION_RAW')
+        self.makeSection('compressed.sec', 'raw.sec', '-s', 'EFI_SECTION_COMPRESSION', '-c', 'PI_STD')
+        self.makeFfs('file.ffs', 'compressed.sec', FileGuid)
+        self.makeFv('test.fv', '0x40', 'file.ffs')
+
+    def testCompressedSection(self):
+        #
+        # Larger than the input staging buffer of the streaming decompressor
+        #
+        data = self.GetRandomString(512, 1024) * 256
+        self.makeCompressedFv(data)
+        result = self.RunTool(self.GetTmpFilePath('test.fv'), logFile='info')
+        self.assertTrue(result == 0)
+        info = self.ReadTmpFile('info')
+        self.assertTrue('EFI_STANDARD_COMPRESSION' in info)
+        self.assertTrue('Size:  0x%08X' % (len(data) + 4) in info)
+
+    def testCorruptCompressedSection(self):
+        data = self.GetRandomString(512, 1024) * 64
+        self.makeCompressedFv(data)
+        fv = self.ReadTmpFile('test.fv')
+        offset = fv.find(self.ReadTmpFile('compressed.sec')[:64])
+        self.assertTrue(offset > 0)
+        #
+        # Damage the compressed data after the section and data headers
+        #
+        offset += 64
+        fv = fv[:offset] + ''.join([chr(ord(c) ^ 0xA5) for c in fv[offset:offset + 64]]) + fv[offset + 64:]
+        self.WriteTmpFile('test.fv', fv)
+        result = self.RunTool(self.GetTmpFilePath('test.fv'), logFile='info')
+        self.assertTrue(result != 0)
+        info = self.ReadTmpFile('info')
+        self.assertTrue('decompress failed' in info or 'compression error' in info)
+
+    def makeNestedFv(self):
+        self.makeCompressedFv(self.GetRandomString(512, 1024) * 32)
+        self.WriteTmpFile('rawdata', self.GetRandomString(100, 200))
+        self.makeSection('rawfile.sec', 'rawdata', '-s', 'EFI_SECTION_RAW')
+        self.makeFfs('rawfile.ffs', 'rawfile.sec', RawFileGuid)
+        self.makeSection('fv.sec', 'test.fv', '-s', 'EFI_SECTION_FIRMWARE_VOLUME_IMAGE')
+        self.makeFfs('fv.ffs', 'fv.sec', FvFileGuid, 'EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE')
+        self.makeFv('outer.fv', '0x100', 'fv.ffs', 'rawfile.ffs', 'file.ffs')
+
+    def readInventory(self, *options):
+        args = list(options) + [
+            '--json', self.GetTmpFilePath('inventory.json'),
+            self.GetTmpFilePath('outer.fv')
+            ]
+        result = self.RunTool(*args, logFile='info')
+        self.assertTrue(result == 0)
+        return self.ReadTmpFile('inventory.json')
+
+    def testJsonInventory(self):
+        self.makeNestedFv()
+        inventory = json.loads(self.readInventory())
+        files = inventory['fv']['files']
+        self.assertTrue([f['name'] for f in files] == [FvFileGuid, RawFileGuid, FileGuid])
+        #
+        # The nested FV and the compressed section are decoded
+        #
+        nested = files[0]['sections'][0]['fv']['files']
+        self.assertTrue([f['name'] for f in nested] == [FileGuid])
+        rawSize = len(self.ReadTmpFile('raw.sec'))
+        for compressed in (nested[0]['sections'][0], files[2]['sections'][0]):
+            self.assertTrue(compressed['type'] == 'EFI_SECTION_COMPRESSION')
+            self.assertTrue(compressed['decodedSize'] == rawSize)
+            self.assertTrue(compressed['sections'][0]['type'] == 'EFI_SECTION_RAW')
+            self.assertTrue(compressed['sections'][0]['size'] == rawSize)
+        self.assertTrue(files[1]['sections'][0]['size'] == len(self.ReadTmpFile('rawfile.sec')))
+
+    def testJsonThreads(self):
+        self.makeNestedFv()
+        first = self.readInventory('-j', '1')
+        for threads in ('2', '4'):
+            self.assertTrue(self.readInventory('-j', threads) == first)
+
+TheTestSuite = TestTools.MakeTheTestSuite(locals())
+
+if __name__ == '__main__':
+    allTests = TheTestSuite()
+    unittest.TextTestRunner().run(allTests)
+